@@ -0,0 +1,320 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee --- Eudoxus Batch Benchmarker
+ *
+ * Compares executing many short inputs one after the other with executing
+ * them in batches via ia_eudoxus_execute_batch().  Each line of the input is
+ * a separate stream, as each field of a collection is in the fast module.
+ */
+
+#include <ironautomata/eudoxus.h>
+
+#ifdef __clang__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter"
+#endif
+#include <boost/chrono.hpp>
+#include <boost/format.hpp>
+#include <boost/program_options.hpp>
+#ifdef __clang__
+#pragma clang diagnostic pop
+#endif
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+//! Clock we are using.
+typedef boost::chrono::high_resolution_clock clock_type;
+//! Milliseconds as double.
+typedef boost::chrono::duration<double, boost::milli> ms_t;
+
+extern "C" {
+
+//! Eudoxus callback.  Counts outputs.
+ia_eudoxus_command_t c_count_callback(
+    ia_eudoxus_t*,
+    const char*,
+    size_t,
+    const uint8_t*,
+    void* data
+)
+{
+    ++*reinterpret_cast<size_t*>(data);
+    return IA_EUDOXUS_CMD_CONTINUE;
+}
+
+}
+
+/**
+ * Output a eudoxus result code with error message to cerr.
+ *
+ * @param[in] eudoxus Eudoxus.
+ * @param[in] rc      Result code to output.
+ */
+void output_eudoxus_result(const ia_eudoxus_t* eudoxus, ia_eudoxus_result_t rc)
+{
+    const char* message = NULL;
+    if (eudoxus) {
+        message = ia_eudoxus_error(eudoxus);
+    }
+    if (! message) {
+        message = "No message.";
+    }
+
+    cerr << "Eudoxus Reported " << rc << ": " << message << endl;
+}
+
+/**
+ * Execute each of @a records in turn.
+ *
+ * @param[in]  eudoxus Engine.
+ * @param[in]  records Inputs.
+ * @param[out] outputs Incremented for each output.
+ * @return true on success.
+ */
+bool run_sequential(
+    ia_eudoxus_t*         eudoxus,
+    const vector<string>& records,
+    size_t&               outputs
+)
+{
+    for (size_t i = 0; i < records.size(); ++i) {
+        ia_eudoxus_state_t* state;
+        ia_eudoxus_result_t rc = ia_eudoxus_create_state(
+            &state, eudoxus, c_count_callback, &outputs
+        );
+        if (rc == IA_EUDOXUS_OK) {
+            rc = ia_eudoxus_execute(
+                state,
+                reinterpret_cast<const uint8_t*>(records[i].data()),
+                records[i].length()
+            );
+        }
+        ia_eudoxus_destroy_state(state);
+        if (rc != IA_EUDOXUS_OK && rc != IA_EUDOXUS_END) {
+            output_eudoxus_result(eudoxus, rc);
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Execute @a records in batches of @a batch_size.
+ *
+ * @param[in]  eudoxus    Engine.
+ * @param[in]  records    Inputs.
+ * @param[in]  batch_size Number of records per batch.
+ * @param[out] outputs    Incremented for each output.
+ * @return true on success.
+ */
+bool run_batch(
+    ia_eudoxus_t*         eudoxus,
+    const vector<string>& records,
+    size_t                batch_size,
+    size_t&               outputs
+)
+{
+    vector<ia_eudoxus_stream_t> streams(batch_size);
+
+    for (size_t first = 0; first < records.size(); first += batch_size) {
+        size_t n = min(batch_size, records.size() - first);
+        ia_eudoxus_result_t rc = IA_EUDOXUS_OK;
+
+        for (size_t i = 0; i < n; ++i) {
+            rc = ia_eudoxus_create_state(
+                &streams[i].state, eudoxus, c_count_callback, &outputs
+            );
+            if (rc != IA_EUDOXUS_OK) {
+                output_eudoxus_result(eudoxus, rc);
+                return false;
+            }
+            streams[i].input =
+                reinterpret_cast<const uint8_t*>(records[first + i].data());
+            streams[i].input_length = records[first + i].length();
+        }
+
+        rc = ia_eudoxus_execute_batch(&streams[0], n);
+        for (size_t i = 0; i < n; ++i) {
+            if (
+                rc == IA_EUDOXUS_OK &&
+                streams[i].result != IA_EUDOXUS_OK &&
+                streams[i].result != IA_EUDOXUS_END
+            ) {
+                rc = streams[i].result;
+            }
+            ia_eudoxus_destroy_state(streams[i].state);
+        }
+        if (rc != IA_EUDOXUS_OK) {
+            output_eudoxus_result(eudoxus, rc);
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+//! Main.
+int main(int argc, char **argv)
+{
+    namespace po = boost::program_options;
+
+    string input_s;
+    string automata_s;
+    size_t batch_size = 32;
+    size_t n = 10;
+    bool use_mmap = false;
+
+    po::options_description desc("Options:");
+    desc.add_options()
+        ("help", "display help and exit")
+        ("input,i", po::value<string>(&input_s),
+            "where to read input from, one stream per line; "
+            "defaults to STDIN"
+        )
+        ("automata,a", po::value<string>(&automata_s),
+            "where to read automata from; required, but -a is optional"
+        )
+        ("batch,b", po::value<size_t>(&batch_size),
+            "streams per batch; default = 32"
+        )
+        ("num-runs,n", po::value<size_t>(&n),
+            "number of times to run input through; default = 10"
+        )
+        ("mmap,m", po::bool_switch(&use_mmap),
+            "map automata read-only instead of reading it"
+        )
+        ;
+
+    po::positional_options_description pd;
+    pd.add("automata", 1);
+
+    po::variables_map vm;
+    po::store(
+        po::command_line_parser(argc, argv)
+            .options(desc)
+            .positional(pd)
+            .run(),
+        vm
+    );
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return 1;
+    }
+
+    if (! vm.count("automata")) {
+        cout << "automata is required." << endl;
+        cout << desc << endl;
+        return 1;
+    }
+
+    if (batch_size == 0 || n == 0) {
+        cout << "batch and num-runs must be positive." << endl;
+        return 1;
+    }
+
+    // Read input.
+    vector<string> records;
+    {
+        ifstream input_file;
+        istream* input = &cin;
+        if (! input_s.empty()) {
+            input_file.open(input_s.c_str());
+            input = &input_file;
+            if (! input_file) {
+                cout << "Error: Could not open " << input_s << " for reading."
+                     << endl;
+                return 1;
+            }
+        }
+        string line;
+        while (getline(*input, line)) {
+            records.push_back(line);
+        }
+    }
+
+    // Load automata
+    ia_eudoxus_result_t rc;
+    ia_eudoxus_t* eudoxus;
+    if (use_mmap) {
+        rc = ia_eudoxus_create_from_path_mapped(
+            &eudoxus,
+            automata_s.c_str(),
+            false
+        );
+    }
+    else {
+        rc = ia_eudoxus_create_from_path(&eudoxus, automata_s.c_str());
+    }
+    if (rc != IA_EUDOXUS_OK) {
+        output_eudoxus_result(NULL, rc);
+        return 1;
+    }
+
+    // Run, alternating to even out cache and frequency effects.
+    clock_type::duration sequential_time(0);
+    clock_type::duration batch_time(0);
+    size_t sequential_outputs = 0;
+    size_t batch_outputs = 0;
+    for (size_t i = 0; i < n; ++i) {
+        clock_type::time_point start = clock_type::now();
+        if (! run_sequential(eudoxus, records, sequential_outputs)) {
+            return 1;
+        }
+        clock_type::time_point middle = clock_type::now();
+        if (! run_batch(eudoxus, records, batch_size, batch_outputs)) {
+            return 1;
+        }
+        batch_time += clock_type::now() - middle;
+        sequential_time += middle - start;
+    }
+
+    if (sequential_outputs != batch_outputs) {
+        cout << "Error: Sequential found " << sequential_outputs
+             << " outputs but batch found " << batch_outputs << "." << endl;
+        return 1;
+    }
+
+    double sequential_ms = ms_t(sequential_time).count();
+    double batch_ms = ms_t(batch_time).count();
+    cout << boost::format(
+        "%d streams x %d runs, %d outputs per run\n"
+        "sequential: %.3f ms\n"
+        "batch %d:   %.3f ms (%.2fx)\n"
+    )
+        % records.size() % n % (sequential_outputs / n)
+        % sequential_ms
+        % batch_size % batch_ms
+        % (batch_ms > 0 ? sequential_ms / batch_ms : 0);
+
+    ia_eudoxus_destroy(eudoxus);
+
+    return 0;
+}
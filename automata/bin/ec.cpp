@@ -55,6 +55,7 @@ int main(int argc, char **argv)
     size_t id_width = 0;
     size_t align_to = 1;
     double high_node_weight = 1.0;
+    size_t padded_low_degree = 0;
 
     po::options_description desc("Options:");
     desc.add_options()
@@ -77,6 +78,10 @@ int main(int argc, char **argv)
             "> 1 favors low nodes; < 1 favors high nodes; 1.0 = smallest; "
             "default 1.0"
         )
+        ("padded-low-degree,p", po::value<size_t>(&padded_low_degree),
+            "use padded, vector searchable edges for low nodes with at "
+            "least this many edges; 0 = never; default 0"
+        )
         ;
 
     po::positional_options_description pd;
@@ -149,6 +154,7 @@ int main(int argc, char **argv)
         configuration.id_width = id_width;
         configuration.align_to = align_to;
         configuration.high_node_weight = high_node_weight;
+        configuration.padded_low_degree = padded_low_degree;
         try {
             result = EudoxusCompiler::compile(automata, configuration);
         }
@@ -166,6 +172,7 @@ int main(int argc, char **argv)
         cout << "padding          = " << result.padding << endl;
         cout << "low_nodes        = " << result.low_nodes << endl;
         cout << "low_nodes_bytes  = " << result.low_nodes_bytes << endl;
+        cout << "padded_low_nodes = " << result.padded_low_nodes << endl;
         cout << "high_nodes       = " << result.high_nodes << endl;
         cout << "high_nodes_bytes = " << result.high_nodes_bytes << endl;
         cout << "pc_nodes         = " << result.pc_nodes << endl;
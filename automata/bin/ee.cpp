@@ -358,6 +358,8 @@ int main(int argc, char **argv)
     bool no_output = false;
     bool final = false;
     bool list_output = false;
+    bool use_mmap = false;
+    bool populate = false;
     size_t n = 1;
 
     po::options_description desc("Options:");
@@ -393,6 +395,12 @@ int main(int argc, char **argv)
         ("list-output,L", po::bool_switch(&list_output),
             "list all outputs of automata and exit"
         )
+        ("mmap,m", po::bool_switch(&use_mmap),
+            "map automata read-only instead of reading it"
+        )
+        ("populate,p", po::bool_switch(&populate),
+            "with --mmap, prefault the mapped automata"
+        )
         ;
 
     po::positional_options_description pd;
@@ -445,7 +453,16 @@ int main(int argc, char **argv)
     ia_eudoxus_t* eudoxus;
 
     TimingInfo ti;
-    rc = ia_eudoxus_create_from_path(&eudoxus, automata_s.c_str());
+    if (use_mmap) {
+        rc = ia_eudoxus_create_from_path_mapped(
+            &eudoxus,
+            automata_s.c_str(),
+            populate
+        );
+    }
+    else {
+        rc = ia_eudoxus_create_from_path(&eudoxus, automata_s.c_str());
+    }
     if (rc != IA_EUDOXUS_OK) {
         output_eudoxus_result(NULL, rc);
         return 1;
@@ -46,11 +46,40 @@
 #include <ironautomata/vls.h>
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+/* Vector edge search requires function target attributes and x86. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || \
+     (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define IA_EUDOXUS_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+ * Find an input in the edge values of a padded low degree node.
+ *
+ * @param[in] values Edge values; padded to a multiple of
+ *                   IA_EUDOXUS_EDGE_ALIGN.
+ * @param[in] degree Number of edge values, not including padding.
+ * @param[in] c      Input to find.
+ * @return Index of @a c in @a values or @a degree if not present.
+ */
+typedef unsigned (*ia_eudoxus_find_edge_t)(
+    const uint8_t *values,
+    unsigned       degree,
+    uint8_t        c
+);
 
 struct ia_eudoxus_t
 {
@@ -59,6 +88,23 @@ struct ia_eudoxus_t
      */
     const ia_eudoxus_automata_t *automata;
 
+    /**
+     * Edge search for padded low degree nodes.
+     *
+     * Selected for the running CPU when the engine is created.
+     */
+    ia_eudoxus_find_edge_t find_edge;
+
+    /**
+     * Length of the mapping holding @c automata.
+     *
+     * If 0, @c automata was allocated with malloc() and is freed rather
+     * than unmapped.
+     *
+     * @sa ia_eudoxus_create_from_path_mapped()
+     */
+    size_t mapped_length;
+
     /**
      * Most recent error message.
      *
@@ -170,6 +216,146 @@ enum ia_eudoxus_extended_command_t
     IA_EUDOXUS_EXT_INSANITY
 };
 
+/* Edge Search */
+
+/**
+ * Find edge with a linear search.
+ *
+ * @sa ia_eudoxus_find_edge_t
+ */
+static
+unsigned ia_eudoxus_find_edge_scalar(
+    const uint8_t *values,
+    unsigned       degree,
+    uint8_t        c
+)
+{
+    unsigned i = 0;
+    while (i < degree && values[i] != c) {
+        ++i;
+    }
+    return i;
+}
+
+#ifdef IA_EUDOXUS_SIMD
+
+/**
+ * Find edge comparing 16 values at a time.
+ *
+ * A match in the padding is reported as no match.
+ *
+ * @sa ia_eudoxus_find_edge_t
+ */
+static __attribute__((target("sse2")))
+unsigned ia_eudoxus_find_edge_sse2(
+    const uint8_t *values,
+    unsigned       degree,
+    uint8_t        c
+)
+{
+    const __m128i needle = _mm_set1_epi8((char)c);
+    unsigned i;
+
+    for (i = 0; i < degree; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(values + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            i += __builtin_ctz(mask);
+            return i < degree ? i : degree;
+        }
+    }
+    return degree;
+}
+
+/**
+ * Find edge comparing 32 values at a time.
+ *
+ * Padding is only to 16 bytes, so a final partial block is compared with
+ * a 16 byte load.
+ *
+ * @sa ia_eudoxus_find_edge_t
+ */
+static __attribute__((target("avx2")))
+unsigned ia_eudoxus_find_edge_avx2(
+    const uint8_t *values,
+    unsigned       degree,
+    uint8_t        c
+)
+{
+    const __m256i needle = _mm256_set1_epi8((char)c);
+    unsigned i;
+
+    for (i = 0; i + 16 < degree; i += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(values + i));
+        unsigned mask =
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            i += __builtin_ctz(mask);
+            return i < degree ? i : degree;
+        }
+    }
+    if (i < degree) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(values + i));
+        unsigned mask = _mm_movemask_epi8(
+            _mm_cmpeq_epi8(block, _mm256_castsi256_si128(needle))
+        );
+        if (mask != 0) {
+            i += __builtin_ctz(mask);
+            return i < degree ? i : degree;
+        }
+    }
+    return degree;
+}
+
+#endif
+
+/**
+ * Select the fastest edge search supported by the running CPU.
+ *
+ * @return Edge search function.
+ */
+static
+ia_eudoxus_find_edge_t ia_eudoxus_select_find_edge(void)
+{
+#ifdef IA_EUDOXUS_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ia_eudoxus_find_edge_avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return ia_eudoxus_find_edge_sse2;
+    }
+#endif
+    return ia_eudoxus_find_edge_scalar;
+}
+
+/**
+ * Check that @a automata is compatible with this engine.
+ *
+ * @param[in] automata Automata to check.
+ * @return
+ * - IA_EUDOXUS_OK if compatible.
+ * - IA_EUDOXUS_EINCOMPAT if the version or endianness do not match.
+ */
+static
+ia_eudoxus_result_t ia_eudoxus_check_automata(
+    const ia_eudoxus_automata_t *automata
+)
+{
+    if (
+        automata->version < IA_EUDOXUS_MIN_VERSION ||
+        automata->version > IA_EUDOXUS_VERSION
+    ) {
+        return IA_EUDOXUS_EINCOMPAT;
+    }
+
+    if (automata->is_big_endian != ia_eudoxus_is_big_endian()) {
+        return IA_EUDOXUS_EINCOMPAT;
+    }
+
+    return IA_EUDOXUS_OK;
+}
+
 ia_eudoxus_result_t ia_eudoxus_create(
     ia_eudoxus_t **out_eudoxus,
     char          *data
@@ -188,20 +374,13 @@ ia_eudoxus_result_t ia_eudoxus_create(
     }
 
     eudoxus->automata           = (ia_eudoxus_automata_t *)data;
+    eudoxus->find_edge          = ia_eudoxus_select_find_edge();
+    eudoxus->mapped_length      = 0;
     eudoxus->error_message      = NULL;
     eudoxus->free_error_message = false;
 
-    if (eudoxus->automata->version != IA_EUDOXUS_VERSION) {
-        rc = IA_EUDOXUS_EINCOMPAT;
-        goto finish;
-    }
-
-    if (eudoxus->automata->is_big_endian != ia_eudoxus_is_big_endian()) {
-        rc = IA_EUDOXUS_EINCOMPAT;
-        goto finish;
-    }
+    rc = ia_eudoxus_check_automata(eudoxus->automata);
 
-finish:
     if (rc != IA_EUDOXUS_OK) {
         if (eudoxus != NULL) {
             free(eudoxus);
@@ -253,6 +432,93 @@ ia_eudoxus_result_t ia_eudoxus_create_from_path(
     return ia_eudoxus_create_from_file(out_eudoxus, fp);
 }
 
+ia_eudoxus_result_t ia_eudoxus_create_from_path_mapped(
+    ia_eudoxus_t **out_eudoxus,
+    const char    *path,
+    bool           populate
+)
+{
+#ifdef HAVE_SYS_MMAN_H
+    ia_eudoxus_t                *eudoxus  = NULL;
+    const ia_eudoxus_automata_t *automata = NULL;
+    ia_eudoxus_result_t          rc       = IA_EUDOXUS_OK;
+    struct stat                  st;
+    size_t                       length;
+    void                        *data;
+    int                          flags    = MAP_SHARED;
+    int                          fd;
+
+    if (out_eudoxus == NULL || path == NULL) {
+        return IA_EUDOXUS_EINVAL;
+    }
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return IA_EUDOXUS_EINVAL;
+    }
+    if (
+        fstat(fd, &st) != 0 ||
+        st.st_size < (off_t)sizeof(ia_eudoxus_automata_t)
+    ) {
+        close(fd);
+        return IA_EUDOXUS_EINVAL;
+    }
+    length = (size_t)st.st_size;
+
+#ifdef MAP_POPULATE
+    if (populate) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    data = mmap(NULL, length, PROT_READ, flags, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return IA_EUDOXUS_EALLOC;
+    }
+#ifdef HAVE_MADVISE
+    if (populate) {
+        madvise(data, length, MADV_WILLNEED);
+    }
+#endif
+
+    automata = (const ia_eudoxus_automata_t *)data;
+    rc = ia_eudoxus_check_automata(automata);
+    if (rc == IA_EUDOXUS_OK && automata->data_length > length) {
+        rc = IA_EUDOXUS_EINVAL;
+    }
+    if (rc == IA_EUDOXUS_OK) {
+        eudoxus = (ia_eudoxus_t *)malloc(sizeof(*eudoxus));
+        if (eudoxus == NULL) {
+            rc = IA_EUDOXUS_EALLOC;
+        }
+    }
+    if (rc != IA_EUDOXUS_OK) {
+        munmap(data, length);
+        return rc;
+    }
+
+    eudoxus->automata           = automata;
+    eudoxus->find_edge          = ia_eudoxus_select_find_edge();
+    eudoxus->mapped_length      = length;
+    eudoxus->error_message      = NULL;
+    eudoxus->free_error_message = false;
+
+    *out_eudoxus = eudoxus;
+
+    return IA_EUDOXUS_OK;
+#else
+    (void)populate;
+    return ia_eudoxus_create_from_path(out_eudoxus, path);
+#endif
+}
+
+bool ia_eudoxus_is_mapped(
+    const ia_eudoxus_t *eudoxus
+)
+{
+    return eudoxus->mapped_length > 0;
+}
+
 void ia_eudoxus_destroy(
     ia_eudoxus_t *eudoxus
 )
@@ -264,7 +530,15 @@ void ia_eudoxus_destroy(
     /* Better to cast away const here than to not have const checks for
      * all uses. */
     if (eudoxus->automata) {
-        free((void *)eudoxus->automata);
+#ifdef HAVE_SYS_MMAN_H
+        if (eudoxus->mapped_length > 0) {
+            munmap((void *)eudoxus->automata, eudoxus->mapped_length);
+        }
+        else
+#endif
+        {
+            free((void *)eudoxus->automata);
+        }
     }
     if (eudoxus->error_message != NULL && eudoxus->free_error_message) {
         free((void *)eudoxus->error_message);
@@ -399,6 +673,23 @@ void ia_eudoxus_set_error_printf(
     va_end(ap);
 }
 
+/**
+ * Number of streams ia_eudoxus_execute_batch() advances in lockstep.
+ *
+ * Enough to hide the latency of a cache miss behind the steps of the other
+ * streams.
+ */
+#define IA_EUDOXUS_BATCH_WIDTH 8
+
+/**
+ * Prefetch node at @a p for reading.
+ */
+#ifdef __GNUC__
+#define IA_EUDOXUS_PREFETCH(p) __builtin_prefetch((p), 0, 3)
+#else
+#define IA_EUDOXUS_PREFETCH(p) ((void)(p))
+#endif
+
 /* Specific Subengine Code */
 
 #define IA_EUDOXUS(a) ia_eudoxus8_ ## a
@@ -467,6 +758,53 @@ ia_eudoxus_result_t ia_eudoxus_execute_without_output(
     return ia_eudoxus_execute_impl(state, input, input_length, false);
 }
 
+ia_eudoxus_result_t ia_eudoxus_execute_batch(
+    ia_eudoxus_stream_t *streams,
+    size_t               num_streams
+)
+{
+    ia_eudoxus_t *eudoxus;
+
+    if (num_streams == 0) {
+        return IA_EUDOXUS_OK;
+    }
+    if (streams == NULL || streams[0].state == NULL) {
+        return IA_EUDOXUS_EINVAL;
+    }
+
+    eudoxus = streams[0].state->eudoxus;
+    for (size_t i = 0; i < num_streams; ++i) {
+        if (
+            streams[i].state == NULL ||
+            streams[i].state->eudoxus != eudoxus
+        ) {
+            return IA_EUDOXUS_EINVAL;
+        }
+        assert(streams[i].state->node != NULL);
+    }
+
+    ia_eudoxus_set_error(eudoxus, NULL);
+
+    switch (eudoxus->automata->id_width) {
+    case 8:
+        ia_eudoxus8_execute_batch(streams, num_streams, true);
+        break;
+    case 4:
+        ia_eudoxus4_execute_batch(streams, num_streams, true);
+        break;
+    case 2:
+        ia_eudoxus2_execute_batch(streams, num_streams, true);
+        break;
+    case 1:
+        ia_eudoxus1_execute_batch(streams, num_streams, true);
+        break;
+    default:
+        return IA_EUDOXUS_EINCOMPAT;
+    }
+
+    return IA_EUDOXUS_OK;
+}
+
 ia_eudoxus_result_t ia_eudoxus_metadata(
     ia_eudoxus_t                   *eudoxus,
     ia_eudoxus_metadata_callback_t  callback,
@@ -38,7 +38,7 @@ using namespace std;
 namespace IronAutomata {
 namespace EudoxusCompiler {
 
-#define CPP_EUDOXUS_VERSION 10
+#define CPP_EUDOXUS_VERSION 11
 #if CPP_EUDOXUS_VERSION != IA_EUDOXUS_VERSION
 #error "Mismatch between compiler version and automata version."
 #endif
@@ -111,9 +111,18 @@ private:
         //! use_ali will be set if num_consecutive > c_ali_threshold.
         static const size_t c_ali_threshold = 32;
 
-        //! Constructor.
-        explicit
-        NodeOracle(const Intermediate::node_p& node)
+        /**
+         * Constructor.
+         *
+         * @param[in] node              Node to answer questions about.
+         * @param[in] index             Index @a node will be placed at.
+         * @param[in] padded_low_degree See configuration_t.
+         */
+        NodeOracle(
+            const Intermediate::node_p& node,
+            size_t                      index,
+            size_t                      padded_low_degree
+        )
         {
             has_nonadvancing = (
                 find_if(node->edges().begin(), node->edges().end(), is_nonadvancing)
@@ -146,6 +155,13 @@ private:
 
             use_ali = (num_consecutive > c_ali_threshold);
 
+            edge_padding = 0;
+            use_padded_edges = (
+                padded_low_degree > 0 &&
+                out_degree > 0 &&
+                out_degree >= padded_low_degree
+            );
+
             low_node_cost = 0;
 
             low_node_cost += sizeof(e_low_node_t);
@@ -154,7 +170,6 @@ private:
             }
             if (! node->edges().empty()) {
                 low_node_cost += sizeof(uint8_t);
-                low_node_cost += sizeof(typename traits_t::low_edge_t) * out_degree;
             }
             if (node->default_target()) {
                 low_node_cost += sizeof(e_id_t);
@@ -162,6 +177,16 @@ private:
             if (has_nonadvancing) {
                 low_node_cost += (out_degree + 7) / 8;
             }
+            if (use_padded_edges) {
+                edge_padding = pad_to_edge_align(index + low_node_cost);
+                low_node_cost += edge_padding;
+                low_node_cost +=
+                    out_degree + pad_to_edge_align(out_degree);
+                low_node_cost += sizeof(e_id_t) * out_degree;
+            }
+            else if (! node->edges().empty()) {
+                low_node_cost += sizeof(typename traits_t::low_edge_t) * out_degree;
+            }
 
             high_node_cost = 0;
 
@@ -205,6 +230,11 @@ private:
         //! True if a high degree node should use an ALI.
         bool use_ali;
 
+        //! True if a low degree node should use padded edges.
+        bool use_padded_edges;
+        //! Padding before edge values of a padded low degree node.
+        size_t edge_padding;
+
         //! Cost in bytes of representing with a low node.
         size_t low_node_cost;
         //! Cost in bytes of representing with a high node.
@@ -214,6 +244,14 @@ private:
         Intermediate::Node::targets_by_input_t targets_by_input;
     };
 
+    //! Bytes needed to pad @a n to a multiple of IA_EUDOXUS_EDGE_ALIGN.
+    static
+    size_t pad_to_edge_align(size_t n)
+    {
+        return (IA_EUDOXUS_EDGE_ALIGN - n % IA_EUDOXUS_EDGE_ALIGN)
+            % IA_EUDOXUS_EDGE_ALIGN;
+    }
+
     //! Set of nodes.
     typedef set<Intermediate::node_p> node_set_t;
     //! Map of nodes to set of nodes: it's parents.
@@ -293,7 +331,11 @@ private:
     //! Compile node into a demux (high or low) node.
     void demux_node(const Intermediate::node_p& node)
     {
-        NodeOracle oracle(node);
+        NodeOracle oracle(
+            node,
+            m_assembler.size(),
+            m_configuration.padded_low_degree
+        );
 
         if (! oracle.deterministic) {
             throw runtime_error(
@@ -365,6 +407,9 @@ private:
             if (oracle.out_degree > 0) {
                 header->header = ia_setbit8(header->header, 4 + IA_EUDOXUS_TYPE_WIDTH);
             }
+            if (oracle.use_padded_edges) {
+                header->header = ia_setbit8(header->header, 5 + IA_EUDOXUS_TYPE_WIDTH);
+            }
         }
 
         if (node.first_output()) {
@@ -391,6 +436,19 @@ private:
             advance_index = m_assembler.index(advance);
         }
 
+        size_t values_index = 0;
+        if (oracle.use_padded_edges) {
+            m_assembler.template append_array<uint8_t>(oracle.edge_padding);
+            m_result.padding += oracle.edge_padding;
+            uint8_t* values =
+                m_assembler.template append_array<uint8_t>(
+                    oracle.out_degree + pad_to_edge_align(oracle.out_degree)
+                );
+            values_index = m_assembler.index(values);
+            assert(values_index % IA_EUDOXUS_EDGE_ALIGN == 0);
+            ++m_result.padded_low_nodes;
+        }
+
         size_t edge_i = 0;
         BOOST_FOREACH(const Intermediate::Edge& edge, node.edges()) {
             if (edge.epsilon()) {
@@ -407,15 +465,24 @@ private:
                         edge_i
                     );
                 }
-                ++edge_i;
 
-                e_low_edge_t* e_edge =
-                    m_assembler.append_object(e_low_edge_t());
-                e_edge->c = value;
-                register_node_ref(
-                    m_assembler.index(&(e_edge->next_node)),
-                    edge.target()
-                );
+                if (oracle.use_padded_edges) {
+                    assert(edge_i < oracle.out_degree);
+                    *m_assembler.template ptr<uint8_t>(
+                        values_index + edge_i
+                    ) = value;
+                    append_node_ref(edge.target());
+                }
+                else {
+                    e_low_edge_t* e_edge =
+                        m_assembler.append_object(e_low_edge_t());
+                    e_edge->c = value;
+                    register_node_ref(
+                        m_assembler.index(&(e_edge->next_node)),
+                        edge.target()
+                    );
+                }
+                ++edge_i;
             }
         }
     }
@@ -816,6 +883,7 @@ void Compiler<id_width>::compile(
     m_result.ids_used = 0;
     m_result.padding = 0;
     m_result.low_nodes = 0;
+    m_result.padded_low_nodes = 0;
     m_result.low_nodes_bytes = 0;
     m_result.high_nodes = 0;
     m_result.high_nodes_bytes = 0;
@@ -1017,7 +1085,8 @@ result_t compile_minimal(
 configuration_t::configuration_t() :
     id_width(0),
     align_to(1),
-    high_node_weight(1.0)
+    high_node_weight(1.0),
+    padded_low_degree(0)
 {
     // nop
 }
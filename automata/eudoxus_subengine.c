@@ -74,6 +74,7 @@ ia_eudoxus_result_t IA_EUDOXUS(next_low)(
     bool has_default        = IA_EUDOXUS_FLAG(state->node->header, 2);
     bool advance_on_default = IA_EUDOXUS_FLAG(state->node->header, 3);
     bool has_edges          = IA_EUDOXUS_FLAG(state->node->header, 4);
+    bool has_padded_edges   = IA_EUDOXUS_FLAG(state->node->header, 5);
     const IA_EUDOXUS(low_node_t) *node
         = (const IA_EUDOXUS(low_node_t) *)(state->node);
     if (has_nonadvancing & ! has_edges) {
@@ -94,28 +95,53 @@ ia_eudoxus_result_t IA_EUDOXUS(next_low)(
     const uint8_t *advance = IA_VLS_VARRAY_IF(
         vls,
         const uint8_t,
-        out_degree / 8,
+        (out_degree + 7) / 8,
         has_nonadvancing & has_edges
     );
-    const IA_EUDOXUS(low_edge_t) *edges = IA_VLS_FINAL(
-        vls,
-        const IA_EUDOXUS(low_edge_t)
-    );
 
     IA_EUDOXUS_ID_T next_node            = 0;
     bool            advance_on_next_node = true;
 
     if (has_edges) {
-        int i = 0;
-        while (i < out_degree && edges[i].c != c) {
-            ++i;
+        unsigned i;
+
+        if (has_padded_edges) {
+            const char *automata = (const char *)(state->eudoxus->automata);
+            size_t index = (const char *)vls - automata;
+            size_t padded_degree;
+
+            index = (index + IA_EUDOXUS_EDGE_ALIGN - 1) &
+                ~(size_t)(IA_EUDOXUS_EDGE_ALIGN - 1);
+            padded_degree = (out_degree + IA_EUDOXUS_EDGE_ALIGN - 1) &
+                ~(size_t)(IA_EUDOXUS_EDGE_ALIGN - 1);
+
+            const uint8_t *values = (const uint8_t *)(automata + index);
+            const IA_EUDOXUS_ID_T *targets = (const IA_EUDOXUS_ID_T *)(
+                values + padded_degree
+            );
+
+            i = state->eudoxus->find_edge(values, out_degree, c);
+            if (i != out_degree) {
+                next_node = targets[i];
+            }
         }
+        else {
+            const IA_EUDOXUS(low_edge_t) *edges = IA_VLS_FINAL(
+                vls,
+                const IA_EUDOXUS(low_edge_t)
+            );
 
-        if (i != out_degree) {
-            next_node = edges[i].next_node;
-            if (has_nonadvancing) {
-                advance_on_next_node = ia_bitv(advance, i);
+            i = 0;
+            while (i < out_degree && edges[i].c != c) {
+                ++i;
             }
+            if (i != out_degree) {
+                next_node = edges[i].next_node;
+            }
+        }
+
+        if (i != out_degree && has_nonadvancing) {
+            advance_on_next_node = ia_bitv(advance, i);
         }
     }
 
@@ -520,6 +546,41 @@ ia_eudoxus_result_t IA_EUDOXUS(output)(
     return IA_EUDOXUS_OK;
 }
 
+/**
+ * Step function.  Advance by one step and run output callbacks.
+ *
+ * @param[in, out] state       State of automata; must have remaining input.
+ * @param[in]      with_output If true, generate output on transitions.
+ * @return See ia_eudoxus_execute() for return codes meanings.
+ */
+static inline
+ia_eudoxus_result_t IA_EUDOXUS(step)(
+    ia_eudoxus_state_t *state,
+    bool                with_output
+)
+{
+    ia_eudoxus_result_t result = IA_EUDOXUS_OK;
+
+    /* Update state, including state->remaining_bytes */
+    const uint8_t* old_input_location = state->input_location;
+    result = IA_EUDOXUS(next)(state);
+    if (result != IA_EUDOXUS_OK) {
+        return result;
+    }
+
+    /* Call callback. */
+    if (
+        with_output &&
+        state->callback != NULL &&
+        ( ! state->eudoxus->automata->no_advance_no_output ||
+          state->input_location != old_input_location )
+    ) {
+        result = IA_EUDOXUS(output)(state);
+    }
+
+    return result;
+}
+
 /**
  * Execute function.  Process a block of input.
  *
@@ -571,30 +632,89 @@ ia_eudoxus_result_t IA_EUDOXUS(execute)(
     }
 
     while (state->remaining_bytes > 0) {
-        ia_eudoxus_result_t result = IA_EUDOXUS_OK;
-
-        /* Update state, including state->remaining_bytes */
-        const uint8_t* old_input_location = state->input_location;
-        result = IA_EUDOXUS(next)(state);
+        ia_eudoxus_result_t result = IA_EUDOXUS(step)(state, with_output);
         if (result != IA_EUDOXUS_OK) {
             return result;
         }
+    }
 
-        /* Call callback. */
-        if (
-            with_output &&
-            state->callback != NULL &&
-            ( ! state->eudoxus->automata->no_advance_no_output ||
-              state->input_location != old_input_location )
+    return IA_EUDOXUS_OK;
+}
+
+/**
+ * Batch execute function.  Process several streams in lockstep.
+ *
+ * This is the subengine specific version of ia_eudoxus_execute_batch().
+ * Up to IA_EUDOXUS_BATCH_WIDTH streams are active at once.  Each active
+ * stream is advanced one step in turn and the node it moved to is
+ * prefetched, so that the node loads of different streams overlap instead
+ * of each step waiting on the load of the previous one.  A finished stream
+ * is replaced by the next waiting stream.
+ *
+ * Arguments must have been validated by the caller.
+ *
+ * @param[in, out] streams     Streams to execute; results are set.
+ * @param[in]      num_streams Number of streams.
+ * @param[in]      with_output If true, generate output on transitions.
+ */
+static
+void IA_EUDOXUS(execute_batch)(
+    ia_eudoxus_stream_t *streams,
+    size_t               num_streams,
+    bool                 with_output
+)
+{
+    size_t active[IA_EUDOXUS_BATCH_WIDTH];
+    size_t num_active  = 0;
+    size_t next_stream = 0;
+
+    while (num_active > 0 || next_stream < num_streams) {
+        /* Start waiting streams. */
+        while (
+            num_active < IA_EUDOXUS_BATCH_WIDTH &&
+            next_stream < num_streams
         ) {
-            result = IA_EUDOXUS(output)(state);
-            if (result != IA_EUDOXUS_OK) {
-                return result;
+            ia_eudoxus_stream_t *stream = &streams[next_stream];
+            ia_eudoxus_state_t  *state  = stream->state;
+
+            ++next_stream;
+            if (stream->input == NULL) {
+                /* Rerun of output; not worth interleaving. */
+                stream->result = IA_EUDOXUS(execute)(
+                    state, NULL, 0, with_output
+                );
+                continue;
+            }
+
+            stream->result         = IA_EUDOXUS_OK;
+            state->input_location  = stream->input;
+            state->remaining_bytes = stream->input_length;
+            if (state->remaining_bytes > 0) {
+                IA_EUDOXUS_PREFETCH(state->node);
+                active[num_active] = stream - streams;
+                ++num_active;
             }
         }
-    }
 
-    return IA_EUDOXUS_OK;
+        /* Advance every active stream by one step. */
+        for (size_t i = 0; i < num_active;) {
+            ia_eudoxus_stream_t *stream = &streams[active[i]];
+            ia_eudoxus_state_t  *state  = stream->state;
+
+            stream->result = IA_EUDOXUS(step)(state, with_output);
+            if (
+                stream->result != IA_EUDOXUS_OK ||
+                state->remaining_bytes == 0
+            ) {
+                --num_active;
+                active[i] = active[num_active];
+            }
+            else {
+                IA_EUDOXUS_PREFETCH(state->node);
+                ++i;
+            }
+        }
+    }
 }
 
 /** @} IronAutomataEudoxusAutomata */
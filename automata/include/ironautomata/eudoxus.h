@@ -80,7 +80,8 @@ typedef enum ia_eudoxus_result_t ia_eudoxus_result_t;
  * A Eudoxus automata engine.
  *
  * An opaque data structure representing a Eudoxus engine.  It can be created
- * from file system (ia_eudoxus_create_from_path()), a FILE
+ * from file system (ia_eudoxus_create_from_path() or
+ * ia_eudoxus_create_from_path_mapped()), a FILE
  * (ia_eudoxus_create_from_file()), or a chunk of memory
  * (ia_eudoxus_create()).  When finished, it should be destroyed with
  * ia_eudoxus_destroy().  It can be used via ia_eudoxus_create_state().
@@ -154,6 +155,50 @@ ia_eudoxus_result_t ia_eudoxus_create_from_path(
     const char    *path
 );
 
+/**
+ * As above, but map the automata read-only instead of reading it.
+ *
+ * The file is mapped shared, so processes which load the same automata
+ * share its pages in the page cache rather than each holding a private
+ * copy, and pages are only read as they are used.  The engine makes the
+ * same checks of the automata as ia_eudoxus_create() and also checks that
+ * the file holds the whole automata.
+ *
+ * The file must not be modified while mapped; replace it by renaming a new
+ * file over it instead.  On platforms without @c mmap(), this is the same
+ * as ia_eudoxus_create_from_path().
+ *
+ * @param[out] out_eudoxus Variable to hold pointer to created engine.
+ * @param[in]  path        Path to file on disk holding automata.
+ * @param[in]  populate    If true, read the whole automata in now (e.g.,
+ *                         with @c MAP_POPULATE) rather than as it is used.
+ * @return
+ * - IA_EUDOXUS_OK on success.
+ * - IA_EUDOXUS_EINVAL if @a out_eudoxus or @a path is NULL, the file can
+ *   not be opened, or the file is smaller than the automata.
+ * - IA_EUDOXUS_EALLOC on allocation or mapping failure.
+ * - IA_EINCOMPAT if automata is not compatible with engine.
+ *
+ * @sa ia_eudoxus_t
+ * @sa ia_eudoxus_is_mapped()
+ */
+ia_eudoxus_result_t ia_eudoxus_create_from_path_mapped(
+    ia_eudoxus_t **out_eudoxus,
+    const char    *path,
+    bool           populate
+);
+
+/**
+ * Is the automata of @a eudoxus mapped from a file?
+ *
+ * @param[in] eudoxus Engine to query.
+ * @return true iff @a eudoxus was created by
+ *         ia_eudoxus_create_from_path_mapped() and the automata is mapped.
+ */
+bool ia_eudoxus_is_mapped(
+    const ia_eudoxus_t *eudoxus
+);
+
 /**
  * Destroy engine @a eudoxus, releasing associated memory.
  *
@@ -379,6 +424,50 @@ ia_eudoxus_result_t ia_eudoxus_execute_without_output(
     size_t              input_length
 );
 
+/**
+ * Input stream for ia_eudoxus_execute_batch().
+ */
+typedef struct ia_eudoxus_stream_t ia_eudoxus_stream_t;
+struct ia_eudoxus_stream_t
+{
+    /** State of automata; updated. */
+    ia_eudoxus_state_t *state;
+    /** Input to execute on; NULL as in ia_eudoxus_execute(). */
+    const uint8_t      *input;
+    /** Length of input. */
+    size_t              input_length;
+    /** Set to what ia_eudoxus_execute() would return for this stream. */
+    ia_eudoxus_result_t result;
+};
+
+/**
+ * Execute automata on several independent streams.
+ *
+ * Each stream is executed on its input exactly as by ia_eudoxus_execute(),
+ * but the streams are interleaved a step at a time so that their memory
+ * accesses overlap.  For automata that do not fit in cache, this is faster
+ * than executing the streams one after the other.
+ *
+ * Callbacks of different streams are interleaved; those of any one stream
+ * are in input order.  A stream that stops or fails does not affect the
+ * others.
+ *
+ * All states must belong to the same engine.  Error messages are stored on
+ * that engine, so only one is available if several streams fail.
+ *
+ * @param[in, out] streams     Streams to execute; @c result of each is set.
+ * @param[in]      num_streams Number of streams.
+ * @return
+ * - IA_EUDOXUS_OK if every stream was executed; see the stream results.
+ * - IA_EUDOXUS_EINVAL if @a streams is NULL, any state is NULL, or the
+ *   states do not all belong to the same engine.
+ * - IA_EUDOXUS_EINCOMPAT if the automata is not supported.
+ */
+ia_eudoxus_result_t ia_eudoxus_execute_batch(
+    ia_eudoxus_stream_t *streams,
+    size_t               num_streams
+);
+
 /**
  * Set error for @a eudoxus to @a message (claim ownership version).
  *
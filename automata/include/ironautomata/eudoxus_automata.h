@@ -53,8 +53,28 @@ extern "C" {
  *
  * This is checked by @c ia_eudoxus_create_ methods to insure that an automata
  * was generated for the current engine.
+ *
+ * Version 11 added padded low degree nodes (see @c low_node_t).
+ */
+#define IA_EUDOXUS_VERSION 11
+
+/**
+ * Oldest automata version the engine can execute.
+ *
+ * Automata from @c IA_EUDOXUS_MIN_VERSION to @c IA_EUDOXUS_VERSION are
+ * accepted.  Older versions differ only in lacking node features added
+ * since.
+ */
+#define IA_EUDOXUS_MIN_VERSION 10
+
+/**
+ * Alignment and padding of edge values in padded low degree nodes.
+ *
+ * The edge values of a padded low degree node start at an index that is
+ * 0 mod this and are padded to a multiple of this so that they can be
+ * compared against an input in blocks of this many bytes.
  */
-#define IA_EUDOXUS_VERSION 10
+#define IA_EUDOXUS_EDGE_ALIGN 16
 
 /**
  * A Eudoxus Automata.
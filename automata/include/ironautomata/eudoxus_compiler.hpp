@@ -52,6 +52,7 @@ struct configuration_t
      * - id_width = 0, i.e., minimal.
      * - align_to = 1, i.e., no alignment
      * - high_node_weight = 1.0, i.e., optimize space
+     * - padded_low_degree = 0, i.e., no padded low nodes
      */
     configuration_t();
 
@@ -107,6 +108,20 @@ struct configuration_t
      * for very low degree.
      */
     double high_node_weight;
+
+    /**
+     * Minimum out degree of padded low nodes.
+     *
+     * Low nodes with at least this many edges store their edge values in
+     * an aligned array padded to IA_EUDOXUS_EDGE_ALIGN bytes, which the
+     * engine searches with vector instructions where the CPU supports
+     * them.  This costs up to 2 * (IA_EUDOXUS_EDGE_ALIGN - 1) bytes of
+     * padding per node.  The padding is included in the low node cost, so
+     * it also shifts the choice between low and high nodes.
+     *
+     * A value of 0 disables padded low nodes.
+     */
+    size_t padded_low_degree;
 };
 
 /**
@@ -135,6 +150,9 @@ struct result_t
     //! Number of low nodes.
     size_t low_nodes;
 
+    //! Number of padded low nodes (included in low_nodes).
+    size_t padded_low_nodes;
+
     //! Bytes of low nodes.
     size_t low_nodes_bytes;
 
@@ -67,6 +67,7 @@ struct IA_EUDOXUS(low_node_t)
      * flag2: has_default
      * flag3: advance_on_default
      * flag4: has_edges
+     * flag5: has_padded_edges -- version 11 and later.
      */
     uint8_t header;
 
@@ -91,8 +92,21 @@ struct IA_EUDOXUS(low_node_t)
 
     /*
     IA_EUDOXUS_ID_T default_node          if has_defaults
-    uint8_t         advance[out_degree/8] if has_nonadvancing & has_edges
-    low_edge_t      edges[]
+    uint8_t         advance[(out_degree+7)/8]
+                                          if has_nonadvancing & has_edges
+    low_edge_t      edges[]               if ! has_padded_edges
+    */
+
+    /*
+     * Padded edges store the edge values and targets in separate arrays
+     * so that the values can be searched with vector instructions.  The
+     * values begin at the next index (relative to the start of the
+     * automata) that is 0 mod IA_EUDOXUS_EDGE_ALIGN, skipping padding, and
+     * are padded to a multiple of IA_EUDOXUS_EDGE_ALIGN bytes.
+     */
+    /*
+    uint8_t         values[pad(out_degree)] if has_padded_edges
+    IA_EUDOXUS_ID_T targets[out_degree]     if has_padded_edges
     */
 } __attribute((packed));
 
@@ -0,0 +1,383 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronAutomata --- Eudoxus loader test.
+ **/
+
+#include <ironautomata/eudoxus.h>
+#include <ironautomata/eudoxus_compiler.hpp>
+#include <ironautomata/generator/aho_corasick.hpp>
+#include <ironautomata/intermediate.hpp>
+
+#include <boost/foreach.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+using namespace std;
+using namespace IronAutomata;
+
+namespace {
+
+ia_eudoxus_command_t collect(
+    ia_eudoxus_t*,
+    const char*    output,
+    size_t         output_length,
+    const uint8_t*,
+    void*          callback_data
+)
+{
+    vector<string>& outputs = *reinterpret_cast<vector<string>*>(
+        callback_data
+    );
+    outputs.push_back(string(output, output_length));
+    return IA_EUDOXUS_CMD_CONTINUE;
+}
+
+vector<string> execute(ia_eudoxus_t* eudoxus, const string& input)
+{
+    vector<string> outputs;
+    ia_eudoxus_state_t* state;
+
+    EXPECT_EQ(
+        IA_EUDOXUS_OK,
+        ia_eudoxus_create_state(&state, eudoxus, collect, &outputs)
+    );
+    EXPECT_EQ(
+        IA_EUDOXUS_OK,
+        ia_eudoxus_execute(
+            state,
+            reinterpret_cast<const uint8_t*>(input.data()),
+            input.length()
+        )
+    );
+    ia_eudoxus_destroy_state(state);
+
+    return outputs;
+}
+
+class TestEudoxus : public ::testing::Test
+{
+protected:
+    void SetUp()
+    {
+        char path[] = "test_eudoxus.XXXXXX";
+        int fd = mkstemp(path);
+        ASSERT_NE(-1, fd);
+        close(fd);
+        m_path = path;
+
+        Intermediate::Automata automata;
+        Generator::aho_corasick_begin(automata);
+        add(automata, "he");
+        add(automata, "she");
+        add(automata, "his");
+        add(automata, "hers");
+        Generator::aho_corasick_finish(automata);
+
+        m_compiled = EudoxusCompiler::compile(automata).buffer;
+        write(m_compiled);
+    }
+
+    void TearDown()
+    {
+        unlink(m_path.c_str());
+    }
+
+    void add(Intermediate::Automata& automata, const string& s)
+    {
+        Generator::aho_corasick_add_data(
+            automata, s,
+            Intermediate::byte_vector_t(s.begin(), s.end())
+        );
+    }
+
+    void write(const buffer_t& data)
+    {
+        ofstream out(m_path.c_str(), ios::binary | ios::trunc);
+        out.write(reinterpret_cast<const char*>(&data[0]), data.size());
+    }
+
+    string   m_path;
+    buffer_t m_compiled;
+};
+
+}
+
+TEST_F(TestEudoxus, Mapped)
+{
+    ia_eudoxus_t* read_eudoxus;
+    ia_eudoxus_t* mapped_eudoxus;
+    const string input = "ushers and his hers";
+
+    ASSERT_EQ(
+        IA_EUDOXUS_OK,
+        ia_eudoxus_create_from_path(&read_eudoxus, m_path.c_str())
+    );
+    ASSERT_EQ(
+        IA_EUDOXUS_OK,
+        ia_eudoxus_create_from_path_mapped(
+            &mapped_eudoxus, m_path.c_str(), false
+        )
+    );
+    EXPECT_FALSE(ia_eudoxus_is_mapped(read_eudoxus));
+#ifdef HAVE_SYS_MMAN_H
+    EXPECT_TRUE(ia_eudoxus_is_mapped(mapped_eudoxus));
+#endif
+
+    vector<string> expected = execute(read_eudoxus, input);
+    EXPECT_EQ(6UL, expected.size());
+    EXPECT_EQ(expected, execute(mapped_eudoxus, input));
+
+    ia_eudoxus_destroy(mapped_eudoxus);
+    ia_eudoxus_destroy(read_eudoxus);
+}
+
+TEST_F(TestEudoxus, MappedPopulate)
+{
+    ia_eudoxus_t* eudoxus;
+
+    ASSERT_EQ(
+        IA_EUDOXUS_OK,
+        ia_eudoxus_create_from_path_mapped(&eudoxus, m_path.c_str(), true)
+    );
+    EXPECT_EQ(2UL, execute(eudoxus, "she").size());
+    ia_eudoxus_destroy(eudoxus);
+}
+
+TEST_F(TestEudoxus, MappedInvalid)
+{
+    ia_eudoxus_t* eudoxus;
+
+    EXPECT_EQ(
+        IA_EUDOXUS_EINVAL,
+        ia_eudoxus_create_from_path_mapped(
+            &eudoxus, "/nonexistent/automata.e", false
+        )
+    );
+
+    // Truncated automata.
+    write(buffer_t(m_compiled.begin(), m_compiled.begin() + 4));
+    EXPECT_EQ(
+        IA_EUDOXUS_EINVAL,
+        ia_eudoxus_create_from_path_mapped(&eudoxus, m_path.c_str(), false)
+    );
+    write(buffer_t(m_compiled.begin(), m_compiled.end() - 1));
+    EXPECT_EQ(
+        IA_EUDOXUS_EINVAL,
+        ia_eudoxus_create_from_path_mapped(&eudoxus, m_path.c_str(), false)
+    );
+
+    // Incompatible version.
+    buffer_t bad = m_compiled;
+    ++bad[0];
+    write(bad);
+    EXPECT_EQ(
+        IA_EUDOXUS_EINCOMPAT,
+        ia_eudoxus_create_from_path_mapped(&eudoxus, m_path.c_str(), false)
+    );
+}
+
+namespace {
+
+//! Words varied enough to give nodes of many degrees.
+vector<string> words(size_t num_words, string word)
+{
+    vector<string> result;
+    for (size_t i = 0; i < num_words; ++i) {
+        result.push_back(word);
+        word[i % word.length()] = 'a' + (i * 7 + word.length()) % 26;
+        if (i % 5 == 0) {
+            word += char('a' + i % 26);
+        }
+    }
+    return result;
+}
+
+Intermediate::Automata word_automata(const vector<string>& patterns)
+{
+    Intermediate::Automata automata;
+    Generator::aho_corasick_begin(automata);
+    BOOST_FOREACH(const string& word, patterns) {
+        Generator::aho_corasick_add_data(
+            automata, word,
+            Intermediate::byte_vector_t(word.begin(), word.end())
+        );
+    }
+    Generator::aho_corasick_finish(automata);
+    return automata;
+}
+
+//! Load a copy of @a buffer; engine frees the copy when destroyed.
+ia_eudoxus_t* load(const buffer_t& buffer)
+{
+    ia_eudoxus_t* eudoxus = NULL;
+    char* data = reinterpret_cast<char*>(malloc(buffer.size()));
+    copy(buffer.begin(), buffer.end(), data);
+    EXPECT_EQ(IA_EUDOXUS_OK, ia_eudoxus_create(&eudoxus, data));
+    return eudoxus;
+}
+
+}
+
+TEST(TestEudoxusPadded, MatchesUnpadded)
+{
+    vector<string> patterns = words(300, "abcdef");
+    Intermediate::Automata automata = word_automata(patterns);
+    EudoxusCompiler::configuration_t configuration;
+    configuration.high_node_weight = 2.0;
+
+    EudoxusCompiler::result_t plain =
+        EudoxusCompiler::compile(automata, configuration);
+    EXPECT_EQ(0UL, plain.padded_low_nodes);
+
+    configuration.padded_low_degree = 1;
+    EudoxusCompiler::result_t padded =
+        EudoxusCompiler::compile(automata, configuration);
+    EXPECT_LT(0UL, padded.padded_low_nodes);
+
+    string input;
+    for (size_t i = 0; i < 2000; ++i) {
+        input += patterns[(i * 37) % patterns.size()];
+        input += char('a' + (i * i + i / 3) % 26);
+    }
+
+    ia_eudoxus_t* plain_eudoxus = load(plain.buffer);
+    ia_eudoxus_t* padded_eudoxus = load(padded.buffer);
+    ASSERT_TRUE(plain_eudoxus);
+    ASSERT_TRUE(padded_eudoxus);
+
+    vector<string> expected = execute(plain_eudoxus, input);
+    EXPECT_LT(0UL, expected.size());
+    EXPECT_EQ(expected, execute(padded_eudoxus, input));
+
+    ia_eudoxus_destroy(padded_eudoxus);
+    ia_eudoxus_destroy(plain_eudoxus);
+}
+
+TEST(TestEudoxusPadded, OldVersion)
+{
+    Intermediate::Automata automata = word_automata(words(20, "abc"));
+    buffer_t buffer = EudoxusCompiler::compile(automata).buffer;
+    ia_eudoxus_t* eudoxus;
+
+    // Automata without padded nodes are valid in the previous version.
+    ASSERT_EQ(11, buffer[0]);
+    buffer[0] = 10;
+    eudoxus = load(buffer);
+    ASSERT_TRUE(eudoxus);
+    EXPECT_EQ(1UL, execute(eudoxus, "abc").size());
+    ia_eudoxus_destroy(eudoxus);
+
+    buffer[0] = 9;
+    char* data = reinterpret_cast<char*>(malloc(buffer.size()));
+    copy(buffer.begin(), buffer.end(), data);
+    EXPECT_EQ(IA_EUDOXUS_EINCOMPAT, ia_eudoxus_create(&eudoxus, data));
+    free(data);
+}
+
+TEST(TestEudoxusBatch, MatchesSequential)
+{
+    vector<string> patterns = words(200, "abcdef");
+    ia_eudoxus_t* eudoxus =
+        load(EudoxusCompiler::compile(word_automata(patterns)).buffer);
+    ASSERT_TRUE(eudoxus);
+
+    // Streams of different lengths, including an empty one, so that
+    // streams finish at different times and waiting ones are started.
+    const size_t num_streams = 21;
+    vector<string> inputs(num_streams);
+    for (size_t i = 0; i < num_streams; ++i) {
+        for (size_t j = 0; j < (i * 5) % 17; ++j) {
+            inputs[i] += patterns[(i * 31 + j * 7) % patterns.size()];
+            inputs[i] += char('a' + (i + j) % 26);
+        }
+    }
+
+    vector<vector<string> > outputs(num_streams);
+    vector<ia_eudoxus_stream_t> streams(num_streams);
+    for (size_t i = 0; i < num_streams; ++i) {
+        ASSERT_EQ(
+            IA_EUDOXUS_OK,
+            ia_eudoxus_create_state(
+                &streams[i].state, eudoxus, collect, &outputs[i]
+            )
+        );
+        streams[i].input =
+            reinterpret_cast<const uint8_t*>(inputs[i].data());
+        streams[i].input_length = inputs[i].length();
+    }
+
+    ASSERT_EQ(
+        IA_EUDOXUS_OK,
+        ia_eudoxus_execute_batch(&streams[0], streams.size())
+    );
+
+    size_t total = 0;
+    for (size_t i = 0; i < num_streams; ++i) {
+        EXPECT_EQ(IA_EUDOXUS_OK, streams[i].result);
+        EXPECT_EQ(execute(eudoxus, inputs[i]), outputs[i]);
+        total += outputs[i].size();
+        ia_eudoxus_destroy_state(streams[i].state);
+    }
+    EXPECT_LT(0UL, total);
+
+    ia_eudoxus_destroy(eudoxus);
+}
+
+TEST(TestEudoxusBatch, Invalid)
+{
+    ia_eudoxus_t* a = load(
+        EudoxusCompiler::compile(word_automata(words(5, "abc"))).buffer
+    );
+    ia_eudoxus_t* b = load(
+        EudoxusCompiler::compile(word_automata(words(5, "xyz"))).buffer
+    );
+    ASSERT_TRUE(a);
+    ASSERT_TRUE(b);
+
+    vector<string> outputs;
+    ia_eudoxus_stream_t streams[2] = {};
+    EXPECT_EQ(IA_EUDOXUS_OK, ia_eudoxus_execute_batch(NULL, 0));
+    EXPECT_EQ(IA_EUDOXUS_EINVAL, ia_eudoxus_execute_batch(NULL, 1));
+    EXPECT_EQ(IA_EUDOXUS_EINVAL, ia_eudoxus_execute_batch(streams, 2));
+
+    // States of different engines.
+    ASSERT_EQ(
+        IA_EUDOXUS_OK,
+        ia_eudoxus_create_state(&streams[0].state, a, collect, &outputs)
+    );
+    ASSERT_EQ(
+        IA_EUDOXUS_OK,
+        ia_eudoxus_create_state(&streams[1].state, b, collect, &outputs)
+    );
+    EXPECT_EQ(IA_EUDOXUS_EINVAL, ia_eudoxus_execute_batch(streams, 2));
+
+    ia_eudoxus_destroy_state(streams[1].state);
+    ia_eudoxus_destroy_state(streams[0].state);
+    ia_eudoxus_destroy(b);
+    ia_eudoxus_destroy(a);
+}
@@ -314,8 +314,9 @@ void help()
     "\n"
     "Consumers:\n"
     "  ironbee:<path>  -- Internal IronBee using <path> as configuration.\n"
-    "  ironbee_threaded:<path>:<n> -- Internal IronBee using <n> threads\n"
-    "                                 and <path> as configuration.\n"
+    "  ironbee_threaded:<path>:<n>[:<option>...] --\n"
+    "    Internal IronBee using <n> threads and <path> as configuration.\n"
+    "    Options: queue=<slots>, batch=<inputs>, affinity.\n"
     "  writepb:<path>  -- Output to protobuf file at <path>.\n"
     "  writehtp:<path> -- Output in HTP test format at <path>.\n"
     "                     Best with unparsed format and only 1 connection.\n"
@@ -1030,17 +1031,44 @@ component_t construct_ironbee_threaded_consumer(const string& arg)
 {
     string config_path;
     size_t num_workers;
+    size_t queue_size = 1024;
+    size_t batch_size = 1;
+    bool   affinity   = false;
 
     vector<string> subargs = split_on_char(arg, ':');
-    if (subargs.size() == 2) {
-        config_path = subargs[0];
-        num_workers = boost::lexical_cast<size_t>(subargs[1]);
-    }
-    else {
+    if (subargs.size() < 2) {
         throw runtime_error("Could not parse ironbee_threaded arg: " + arg);
     }
+    config_path = subargs[0];
+    num_workers = boost::lexical_cast<size_t>(subargs[1]);
 
-    return IronBeeThreadedConsumer(config_path, num_workers);
+    for (size_t i = 2; i < subargs.size(); ++i) {
+        vector<string> subsubargs = split_on_char(subargs[i], '=');
+        if (subsubargs.size() == 1 && subsubargs[0] == "affinity") {
+            affinity = true;
+        }
+        else if (subsubargs.size() == 2 && subsubargs[0] == "queue") {
+            queue_size = boost::lexical_cast<size_t>(subsubargs[1]);
+        }
+        else if (subsubargs.size() == 2 && subsubargs[0] == "batch") {
+            batch_size = boost::lexical_cast<size_t>(subsubargs[1]);
+        }
+        else {
+            throw runtime_error(
+                "Could not parse ironbee_threaded option: " + subargs[i]
+            );
+        }
+    }
+    if (num_workers == 0 || queue_size == 0 || batch_size == 0) {
+        throw runtime_error(
+            "ironbee_threaded workers, queue, and batch must be positive: " +
+            arg
+        );
+    }
+
+    return IronBeeThreadedConsumer(
+        config_path, num_workers, queue_size, batch_size, affinity
+    );
 }
 
 component_t construct_ironbee_modifier(const string& arg)
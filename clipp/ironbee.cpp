@@ -24,9 +24,13 @@
 
 #include "ironbee.hpp"
 #include "control.hpp"
+#include "worker_pool.hpp"
 
 #include <ironbeepp/all.hpp>
 #include <ironbee/action.h>
+#include <boost/foreach.hpp>
+#include <boost/format.hpp>
+#include <boost/functional/hash.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/thread.hpp>
 
@@ -493,109 +497,40 @@ ib_status_t clipp_header(
 
 } // extern "C"
 
-// Move to new file?
-template <typename WorkType>
-class FunctionWorkerPool :
-    private boost::noncopyable
+/**
+ * Key for routing @a input to a worker.
+ *
+ * Inputs from the same connection, i.e., the same addresses and ports,
+ * have the same key.
+ *
+ * @param[in] input Input.
+ * @return Key of @a input.
+ **/
+size_t connection_key(const Input::input_p& input)
 {
-    typedef boost::unique_lock<boost::mutex> lock_t;
-
-    void do_work()
-    {
-        WorkType local_work;
-        for (;;) {
-            {
-                lock_t lock(m_mutex);
-                ++m_num_workers_available;
-
-            }
-            m_worker_available_cv.notify_one();
-
-            {
-                lock_t lock(m_mutex);
-                while (! m_work_available) {
-                    m_work_available_cv.wait(lock);
-                    if (m_shutdown) {
-                        return;
-                    }
-                }
-
-                local_work = m_work;
-                m_work_available = false;
-                --m_num_workers_available;
-            }
-            m_work_accepted_barrier.wait();
-
-            m_work_function(local_work);
-        }
-    }
-
-public:
-    FunctionWorkerPool(
-        size_t                          num_workers,
-        boost::function<void(WorkType)> work_function
-    ) :
-        m_num_workers(num_workers),
-        m_work_function(work_function),
-        m_work_accepted_barrier(2),
-        m_num_workers_available(0),
-        m_work_available(false),
-        m_shutdown(false)
-    {
-        for (size_t i = 0; i < num_workers; ++i) {
-            m_thread_group.create_thread(boost::bind(
-                &FunctionWorkerPool::do_work,
-                this
-            ));
-        }
-    }
-
-    void operator()(WorkType work)
-    {
-        {
-            lock_t lock(m_mutex);
-
-            while (m_num_workers_available == 0) {
-                m_worker_available_cv.wait(lock);
-            }
-
-            m_work           = work;
-            m_work_available = true;
-
-            m_work_available_cv.notify_one();
-        }
-        m_work_accepted_barrier.wait();
-    }
+    size_t key = 0;
 
-    void shutdown()
-    {
-        {
-            lock_t lock(m_mutex);
-            while (m_num_workers_available < m_num_workers) {
-                m_worker_available_cv.wait(lock);
-            }
+    if (! input) {
+        return key;
+    }
+
+    BOOST_FOREACH(
+        const Input::event_p& event,
+        input->connection.pre_transaction_events
+    ) {
+        const Input::ConnectionEvent* opened =
+            dynamic_cast<const Input::ConnectionEvent*>(event.get());
+        if (opened) {
+            boost::hash_combine(key, opened->local_ip.to_s());
+            boost::hash_combine(key, opened->local_port);
+            boost::hash_combine(key, opened->remote_ip.to_s());
+            boost::hash_combine(key, opened->remote_port);
+            break;
         }
-
-        m_shutdown = true;
-        m_work_available_cv.notify_all();
-
-        m_thread_group.join_all();
     }
 
-private:
-    size_t                          m_num_workers;
-    boost::function<void(WorkType)> m_work_function;
-
-    boost::mutex                    m_mutex;
-    boost::condition_variable       m_worker_available_cv;
-    boost::condition_variable       m_work_available_cv;
-    boost::barrier                  m_work_accepted_barrier;
-    boost::thread_group             m_thread_group;
-    size_t                          m_num_workers_available;
-    bool                            m_work_available;
-    bool                            m_shutdown;
-    WorkType                        m_work;
-};
+    return key;
+}
 
 } // Anonymous
 
@@ -724,16 +659,24 @@ struct IronBeeThreadedConsumer::State
         input->connection.dispatch(delegate, true);
     }
 
-    explicit
-    State(size_t num_workers) :
+    State(
+        size_t num_workers,
+        size_t queue_size,
+        size_t batch_size,
+        bool   affinity_
+    ) :
         worker_pool(
             num_workers,
             boost::bind(
                 &IronBeeThreadedConsumer::State::process_input,
                 this,
                 _1
-            )
+            ),
+            queue_size,
+            batch_size,
+            affinity_
         ),
+        affinity(affinity_),
         server_value(__FILE__, "clipp")
 
     {
@@ -744,29 +687,73 @@ struct IronBeeThreadedConsumer::State
     ~State()
     {
         worker_pool.shutdown();
+        report();
 
         engine.destroy();
         IronBee::shutdown();
     }
 
+    //! Output throughput and latency to stdout.
+    void report() const
+    {
+        FunctionWorkerPool<Input::input_p>::stats_t stats =
+            worker_pool.stats();
+
+        if (stats.items == 0) {
+            return;
+        }
+
+        double seconds = stats.elapsed / 1e6;
+        cout << boost::format(
+            "ironbee_threaded: %d inputs in %.3f s: %.1f inputs/sec\n"
+            "ironbee_threaded: input latency (usec): "
+            "p50=%d p90=%d p99=%d p99.9=%d max=%d\n"
+            "ironbee_threaded: input service time (usec): "
+            "p50=%d p90=%d p99=%d p99.9=%d max=%d\n"
+            "ironbee_threaded: queue full %d times\n"
+        )
+            % stats.items
+            % seconds
+            % (seconds > 0 ? stats.items / seconds : 0)
+            % stats.latency[0]
+            % stats.latency[1]
+            % stats.latency[2]
+            % stats.latency[3]
+            % stats.latency_max
+            % stats.service[0]
+            % stats.service[1]
+            % stats.service[2]
+            % stats.service[3]
+            % stats.service_max
+            % stats.producer_waits;
+    }
 
     FunctionWorkerPool<Input::input_p> worker_pool;
+    bool                 affinity;
     IronBee::Engine      engine;
     IronBee::ServerValue server_value;
 };
 
 IronBeeThreadedConsumer::IronBeeThreadedConsumer(
     const string& config_path,
-    size_t        num_workers
+    size_t        num_workers,
+    size_t        queue_size,
+    size_t        batch_size,
+    bool          affinity
 ) :
-    m_state(make_shared<State>(num_workers))
+    m_state(make_shared<State>(num_workers, queue_size, batch_size, affinity))
 {
     load_configuration(m_state->engine, config_path);
 }
 
 bool IronBeeThreadedConsumer::operator()(const Input::input_p& input)
 {
-    m_state->worker_pool(input);
+    if (m_state->affinity) {
+        m_state->worker_pool(input, connection_key(input));
+    }
+    else {
+        m_state->worker_pool(input);
+    }
 
     return true;
 }
@@ -61,15 +61,34 @@ private:
  * CLIPP consumer that feeds inputs to an internal threaded IronBee Engine.
  *
  * This consumer is as IronBeeConsumer except that it will spawn multiple
- * threads to feed data to IronBee.  It will wait until at least one thread
- * is free, and then pass on the input and return.
+ * threads to feed data to IronBee.  Inputs are passed to the threads
+ * through bounded lock-free queues; the consumer returns as soon as the
+ * input is queued, waiting only if the queue is full.
+ *
+ * When destroyed, the consumer outputs the number of inputs per second
+ * and percentiles of the latency and service time of each input to
+ * stdout.
  **/
 class IronBeeThreadedConsumer
 {
 public:
+    /**
+     * Constructor.
+     *
+     * @param[in] config_path Path to configuration file.
+     * @param[in] num_workers Number of worker threads.
+     * @param[in] queue_size  Slots per queue.
+     * @param[in] batch_size  Inputs a worker takes from its queue at once.
+     * @param[in] affinity    If true, each worker has its own queue and
+     *                        inputs of the same connection always go to the
+     *                        same worker.
+     **/
     IronBeeThreadedConsumer(
         const std::string& config_path,
-        size_t             num_inputs
+        size_t             num_workers,
+        size_t             queue_size = 1024,
+        size_t             batch_size = 1,
+        bool               affinity   = false
     );
 
     bool operator()(const Input::input_p& input);
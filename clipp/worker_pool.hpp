@@ -0,0 +1,516 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee --- CLIPP Worker Pool
+ *
+ * A pool of worker threads fed through bounded lock-free queues, used by
+ * the threaded IronBee consumer.
+ */
+
+#ifndef __IRONBEE_CLIPP__WORKER_POOL__
+#define __IRONBEE_CLIPP__WORKER_POOL__
+
+#include <ironbee/clock.h>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+namespace IronBee {
+namespace CLIPP {
+
+/**
+ * Bounded lock-free multi-producer multi-consumer queue.
+ *
+ * The slot at position @e pos is free for a producer when its sequence
+ * number is @e pos and holds a value for a consumer when it is @e pos + 1.
+ * Producers and consumers claim positions with a compare-and-swap on the
+ * tail and head respectively, so neither ever takes a lock.
+ *
+ * @tparam T Value type; must be default constructible and assignable.
+ **/
+template <typename T>
+class BoundedQueue :
+    private boost::noncopyable
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param[in] size Number of slots; rounded up to a power of two.
+     **/
+    explicit
+    BoundedQueue(size_t size) :
+        m_head(0),
+        m_tail(0)
+    {
+        size_t capacity = 2;
+        while (capacity < size) {
+            capacity *= 2;
+        }
+        m_mask = capacity - 1;
+        m_slots.reset(new slot_t[capacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            m_slots[i].seq = i;
+        }
+    }
+
+    //! Number of slots.
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    /**
+     * Add @a value to the queue.
+     *
+     * @param[in] value Value to add.
+     * @return true if added, false if the queue is full.
+     **/
+    bool push(const T& value)
+    {
+        slot_t* slot;
+        size_t pos = __atomic_load_n(&m_tail, __ATOMIC_RELAXED);
+
+        for (;;) {
+            slot = &m_slots[pos & m_mask];
+            size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+            if (seq == pos) {
+                // On failure, pos is set to the current tail.
+                if (__atomic_compare_exchange_n(
+                    &m_tail, &pos, pos + 1,
+                    true, __ATOMIC_RELAXED, __ATOMIC_RELAXED
+                )) {
+                    break;
+                }
+            }
+            else if (static_cast<ssize_t>(seq - pos) < 0) {
+                return false;
+            }
+            else {
+                pos = __atomic_load_n(&m_tail, __ATOMIC_RELAXED);
+            }
+        }
+
+        slot->value = value;
+        __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+        return true;
+    }
+
+    /**
+     * Remove the next value from the queue.
+     *
+     * @param[out] value Value removed.
+     * @return true if a value was removed, false if the queue is empty.
+     **/
+    bool pop(T& value)
+    {
+        slot_t* slot;
+        size_t pos = __atomic_load_n(&m_head, __ATOMIC_RELAXED);
+
+        for (;;) {
+            slot = &m_slots[pos & m_mask];
+            size_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+            if (seq == pos + 1) {
+                // On failure, pos is set to the current head.
+                if (__atomic_compare_exchange_n(
+                    &m_head, &pos, pos + 1,
+                    true, __ATOMIC_RELAXED, __ATOMIC_RELAXED
+                )) {
+                    break;
+                }
+            }
+            else if (static_cast<ssize_t>(seq - (pos + 1)) < 0) {
+                return false;
+            }
+            else {
+                pos = __atomic_load_n(&m_head, __ATOMIC_RELAXED);
+            }
+        }
+
+        value = slot->value;
+        // Release our reference now rather than when the slot is reused.
+        slot->value = T();
+        __atomic_store_n(&slot->seq, pos + m_mask + 1, __ATOMIC_RELEASE);
+
+        return true;
+    }
+
+    //! True if the queue appears empty.
+    bool empty() const
+    {
+        return
+            __atomic_load_n(&m_head, __ATOMIC_SEQ_CST) ==
+            __atomic_load_n(&m_tail, __ATOMIC_SEQ_CST);
+    }
+
+private:
+    //! Padding to keep the head and tail on separate cache lines.
+    static const size_t c_cache_line = 64;
+
+    //! A queue slot.
+    struct slot_t
+    {
+        size_t seq;
+        T      value;
+    };
+
+    boost::scoped_array<slot_t> m_slots;
+    size_t                      m_mask;
+    char                        m_pad1[c_cache_line];
+    size_t                      m_head;
+    char                        m_pad2[c_cache_line];
+    size_t                      m_tail;
+    char                        m_pad3[c_cache_line];
+};
+
+/**
+ * Pool of worker threads that each call a function on work items.
+ *
+ * Work is handed to the workers through bounded lock-free queues.  With
+ * one shard, all workers share a single queue.  With one shard per worker,
+ * each worker has its own queue and work is routed to a shard by a key,
+ * so that all work with the same key is done, in order, by one worker.
+ *
+ * Workers take up to @c batch_size items from their queue at a time.
+ * Taking one at a time (the default) gives the lowest latency, as a worker
+ * busy with a long item never holds back items other workers could take.
+ * Larger batches touch the queue less often, which helps throughput when
+ * items are short and many workers share one queue, at the cost of items
+ * waiting behind the rest of their batch.  A worker that finds its queue
+ * empty spins briefly and then sleeps until a
+ * producer wakes it.  A producer that finds a queue full yields until
+ * there is space.
+ *
+ * The pool keeps, for each work item, its latency (from being queued to
+ * being done) and its service time (the work function alone), and can
+ * summarize them with stats() once shut down.
+ *
+ * @tparam WorkType Type of work items.
+ **/
+template <typename WorkType>
+class FunctionWorkerPool :
+    private boost::noncopyable
+{
+public:
+    //! Work function.
+    typedef boost::function<void(WorkType)> work_function_t;
+
+    //! Statistics; see stats().
+    struct stats_t
+    {
+        //! Work items done.
+        size_t    items;
+        //! Time from first item submitted to last item done, in usec.
+        ib_time_t elapsed;
+        //! Latency percentiles (usec): 50, 90, 99, 99.9.
+        ib_time_t latency[4];
+        //! Largest latency (usec).
+        ib_time_t latency_max;
+        //! Service time percentiles (usec): 50, 90, 99, 99.9.
+        ib_time_t service[4];
+        //! Largest service time (usec).
+        ib_time_t service_max;
+        //! Times a producer found a queue full.
+        size_t    producer_waits;
+    };
+
+    /**
+     * Constructor.
+     *
+     * Starts the workers.
+     *
+     * @param[in] num_workers   Number of worker threads.
+     * @param[in] work_function Function to call on each work item.
+     * @param[in] queue_size    Slots per queue.
+     * @param[in] batch_size    Items a worker takes from its queue at once.
+     * @param[in] affinity      If true, each worker has its own queue and
+     *                          work is routed by key; otherwise all workers
+     *                          share one queue.
+     **/
+    FunctionWorkerPool(
+        size_t          num_workers,
+        work_function_t work_function,
+        size_t          queue_size = 1024,
+        size_t          batch_size = 1,
+        bool            affinity   = false
+    ) :
+        m_work_function(work_function),
+        m_batch_size(std::max(batch_size, size_t(1))),
+        m_start(0),
+        m_finish(0),
+        m_producer_waits(0),
+        m_shutdown(0)
+    {
+        if (num_workers == 0) {
+            throw std::runtime_error("Worker pool needs at least one worker.");
+        }
+
+        size_t num_shards = affinity ? num_workers : 1;
+        for (size_t i = 0; i < num_shards; ++i) {
+            m_shards.push_back(boost::shared_ptr<shard_t>(
+                new shard_t(queue_size)
+            ));
+        }
+        m_workers.resize(num_workers);
+
+        for (size_t i = 0; i < num_workers; ++i) {
+            m_thread_group.create_thread(boost::bind(
+                &FunctionWorkerPool::do_work,
+                this,
+                boost::ref(*m_shards[i % num_shards]),
+                boost::ref(m_workers[i])
+            ));
+        }
+    }
+
+    /**
+     * Submit work.
+     *
+     * Returns once the work is queued; waits while the queue is full.
+     *
+     * @param[in] work Work item.
+     * @param[in] key  Selects the worker when using affinity; ignored
+     *                 otherwise.
+     **/
+    void operator()(const WorkType& work, size_t key = 0)
+    {
+        shard_t& shard = *m_shards[key % m_shards.size()];
+        item_t item;
+
+        item.work   = work;
+        item.queued = ib_clock_get_time();
+        if (__atomic_load_n(&m_start, __ATOMIC_RELAXED) == 0) {
+            ib_time_t expected = 0;
+            __atomic_compare_exchange_n(
+                &m_start, &expected, item.queued,
+                false, __ATOMIC_RELAXED, __ATOMIC_RELAXED
+            );
+        }
+
+        if (! shard.queue.push(item)) {
+            __atomic_add_fetch(&m_producer_waits, 1, __ATOMIC_RELAXED);
+            do {
+                boost::this_thread::yield();
+            } while (! shard.queue.push(item));
+        }
+
+        // Workers check the queue again after announcing they sleep; see
+        // do_work().
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&shard.sleeping, __ATOMIC_SEQ_CST) > 0) {
+            wake(shard);
+        }
+    }
+
+    /**
+     * Wait for all queued work to be done and stop the workers.
+     **/
+    void shutdown()
+    {
+        __atomic_store_n(&m_shutdown, 1, __ATOMIC_SEQ_CST);
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            boost::lock_guard<boost::mutex> lock(m_shards[i]->mutex);
+            m_shards[i]->work_available_cv.notify_all();
+        }
+
+        m_thread_group.join_all();
+        m_finish = ib_clock_get_time();
+    }
+
+    /**
+     * Statistics.
+     *
+     * Only valid after shutdown().
+     *
+     * @return Statistics of all work done.
+     **/
+    stats_t stats() const
+    {
+        stats_t result;
+        std::vector<ib_time_t> latencies;
+        std::vector<ib_time_t> service_times;
+
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            latencies.insert(
+                latencies.end(),
+                m_workers[i].latencies.begin(),
+                m_workers[i].latencies.end()
+            );
+            service_times.insert(
+                service_times.end(),
+                m_workers[i].service_times.begin(),
+                m_workers[i].service_times.end()
+            );
+        }
+
+        result.items          = latencies.size();
+        result.elapsed        = (m_start == 0) ? 0 : m_finish - m_start;
+        result.producer_waits = m_producer_waits;
+        result.latency_max    = summarize(latencies, result.latency);
+        result.service_max    = summarize(service_times, result.service);
+
+        return result;
+    }
+
+private:
+    //! Queued work.
+    struct item_t
+    {
+        WorkType  work;
+        //! When the item was queued.
+        ib_time_t queued;
+    };
+
+    //! Queue and the means to wake its sleeping workers.
+    struct shard_t
+    {
+        explicit
+        shard_t(size_t queue_size) :
+            queue(queue_size),
+            sleeping(0)
+        {
+            // nop
+        }
+
+        BoundedQueue<item_t>      queue;
+        int                       sleeping;
+        boost::mutex              mutex;
+        boost::condition_variable work_available_cv;
+    };
+
+    //! Per worker data; only touched by its worker until shutdown.
+    struct worker_t
+    {
+        std::vector<ib_time_t> latencies;
+        std::vector<ib_time_t> service_times;
+    };
+
+    //! Spins before a worker with an empty queue sleeps.
+    static const size_t c_idle_spins = 64;
+
+    //! Longest a worker sleeps before checking its queue again (msec).
+    static const long c_idle_msec = 10;
+
+    /**
+     * Sort @a times and store their percentiles in @a percentiles.
+     *
+     * @param[in]  times       Times to summarize; sorted in place.
+     * @param[out] percentiles Percentiles 50, 90, 99 and 99.9.
+     * @return Largest time.
+     **/
+    static ib_time_t summarize(
+        std::vector<ib_time_t>& times,
+        ib_time_t               percentiles[4]
+    )
+    {
+        static const double c_percentiles[4] = { 0.5, 0.9, 0.99, 0.999 };
+
+        std::sort(times.begin(), times.end());
+        for (size_t i = 0; i < 4; ++i) {
+            size_t rank = static_cast<size_t>(
+                c_percentiles[i] * (times.size() - 1)
+            );
+            percentiles[i] = times.empty() ? 0 : times[rank];
+        }
+
+        return times.empty() ? 0 : times.back();
+    }
+
+    //! Wake a sleeping worker of @a shard.
+    void wake(shard_t& shard)
+    {
+        boost::lock_guard<boost::mutex> lock(shard.mutex);
+        shard.work_available_cv.notify_one();
+    }
+
+    void do_work(shard_t& shard, worker_t& worker)
+    {
+        std::vector<item_t> batch(m_batch_size);
+        size_t idle = 0;
+
+        for (;;) {
+            size_t n = 0;
+            while (n < m_batch_size && shard.queue.pop(batch[n])) {
+                ++n;
+            }
+
+            if (n > 0) {
+                idle = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    ib_time_t start = ib_clock_get_time();
+                    m_work_function(batch[i].work);
+                    ib_time_t finish = ib_clock_get_time();
+                    worker.latencies.push_back(finish - batch[i].queued);
+                    worker.service_times.push_back(finish - start);
+                    batch[i] = item_t();
+                }
+                continue;
+            }
+
+            if (__atomic_load_n(&m_shutdown, __ATOMIC_SEQ_CST)) {
+                return;
+            }
+
+            if (++idle < c_idle_spins) {
+                boost::this_thread::yield();
+                continue;
+            }
+
+            // Producers wake us if they see sleeping set after queueing;
+            // check the queue again after setting it.
+            boost::unique_lock<boost::mutex> lock(shard.mutex);
+            __atomic_add_fetch(&shard.sleeping, 1, __ATOMIC_SEQ_CST);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (
+                shard.queue.empty() &&
+                ! __atomic_load_n(&m_shutdown, __ATOMIC_SEQ_CST)
+            ) {
+                shard.work_available_cv.timed_wait(
+                    lock,
+                    boost::posix_time::milliseconds(c_idle_msec)
+                );
+            }
+            __atomic_sub_fetch(&shard.sleeping, 1, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    work_function_t                         m_work_function;
+    size_t                                  m_batch_size;
+    std::vector<boost::shared_ptr<shard_t> > m_shards;
+    std::vector<worker_t>                   m_workers;
+    boost::thread_group                     m_thread_group;
+    ib_time_t                               m_start;
+    ib_time_t                               m_finish;
+    size_t                                  m_producer_waits;
+    int                                     m_shutdown;
+};
+
+} // CLIPP
+} // IronBee
+
+#endif
@@ -99,7 +99,8 @@ ib_status_t ib_cfgparser_create(ib_cfgparser_t **pcp,
     *pcp = NULL;
 
     /* Create parser memory pool */
-    rc = ib_mpool_create(&pool, "cfgparser", ib->mp);
+    rc = ib_engine_pool_create(ib, IB_ENGINE_POOL_CONFIG, "cfgparser", ib->mp,
+                               &pool);
     if (rc != IB_OK) {
         rc = IB_EALLOC;
         goto failed;
@@ -46,6 +46,7 @@
 #include <ironbee/logevent.h>
 #include <ironbee/collection_manager.h>
 #include <ironbee/mpool.h>
+#include <ironbee/pcre_cache.h>
 #include <ironbee/provider.h>
 #include <ironbee/rule_defs.h>
 #include <ironbee/rule_engine.h>
@@ -502,7 +503,9 @@ static ib_status_t audit_api_write_log(ib_provider_inst_t *lpi)
     IB_PROVIDER_IFACE_TYPE(audit) *iface =
         (IB_PROVIDER_IFACE_TYPE(audit) *)lpi->pr->iface;
     ib_auditlog_t *log = (ib_auditlog_t *)lpi->data;
+    core_audit_cfg_t *cfg = (core_audit_cfg_t *)log->cfg_data;
     ib_list_node_t *node;
+    bool lock;
     ib_status_t rc;
 
     if (ib_list_elements(log->parts) == 0) {
@@ -521,8 +524,10 @@ static ib_status_t audit_api_write_log(ib_provider_inst_t *lpi)
         }
     }
 
-    /* Lock to write. */
-    if (log->ctx->auditlog->index != NULL) {
+    /* Lock to write.  Logs for the asynchronous writer are written to
+     * memory, and need no lock. */
+    lock = (log->ctx->auditlog->index != NULL) && (cfg->writer == NULL);
+    if (lock) {
         rc = ib_lock_lock(&log->ctx->auditlog->index_fp_lock);
         if (rc != IB_OK) {
             ib_log_error(lpi->pr->ib, "Cannot lock %s for write.",
@@ -535,7 +540,9 @@ static ib_status_t audit_api_write_log(ib_provider_inst_t *lpi)
     if (iface->write_header != NULL) {
         rc = iface->write_header(lpi, log);
         if (rc != IB_OK) {
-            ib_lock_unlock(&log->ctx->auditlog->index_fp_lock);
+            if (lock) {
+                ib_lock_unlock(&log->ctx->auditlog->index_fp_lock);
+            }
             return rc;
         }
     }
@@ -555,7 +562,7 @@ static ib_status_t audit_api_write_log(ib_provider_inst_t *lpi)
     if (iface->write_footer != NULL) {
         rc = iface->write_footer(lpi, log);
         if (rc != IB_OK) {
-            if (log->ctx->auditlog->index != NULL) {
+            if (lock) {
                 ib_lock_unlock(&log->ctx->auditlog->index_fp_lock);
             }
             return rc;
@@ -563,7 +570,7 @@ static ib_status_t audit_api_write_log(ib_provider_inst_t *lpi)
     }
 
     /* Writing is done. Unlock. Close is thread-safe. */
-    if (log->ctx->auditlog->index != NULL) {
+    if (lock) {
         ib_lock_unlock(&log->ctx->auditlog->index_fp_lock);
     }
 
@@ -1954,6 +1961,16 @@ static ib_status_t logevent_hook_postprocess(ib_engine_t *ib,
     cfg->boundary = boundary;
     log->cfg_data = cfg;
 
+    /* Queue core audit logs for the asynchronous writer, if it's running. */
+    if (corecfg->pr.audit->iface == (void *)&core_audit_iface) {
+        ib_core_module_data_t *core_data;
+
+        rc = ib_core_module_data(NULL, &core_data);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        cfg->writer = core_data->audit_writer;
+    }
 
     /* Add all the parts to the log. */
     if (corecfg->auditlog_parts & IB_ALPART_HEADER) {
@@ -2727,6 +2744,26 @@ ib_status_t ib_core_module_data(ib_module_t **core_module,
     return IB_OK;
 }
 
+ib_status_t ib_core_audit_stats(const ib_engine_t *ib,
+                                ib_core_audit_stats_t *stats)
+{
+    assert(stats != NULL);
+
+    ib_core_module_data_t *core_data;
+    ib_status_t rc;
+
+    memset(stats, 0, sizeof(*stats));
+    rc = ib_core_module_data(NULL, &core_data);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    if (core_data->audit_writer != NULL) {
+        core_audit_writer_stats(core_data->audit_writer, stats);
+    }
+
+    return IB_OK;
+}
+
 
 /* -- Directive Handlers -- */
 
@@ -3767,6 +3804,72 @@ static ib_status_t core_dir_param1(ib_cfgparser_t *cp,
         rc = ib_context_set_num(ctx, "buffer_res", 0);
         return rc;
     }
+    else if (strcasecmp("RegexJit", name) == 0) {
+        ib_log_debug2(ib, "%s: %s", name, p1_unescaped);
+        if (strcasecmp("On", p1_unescaped) == 0) {
+            ib_pcre_cache_jit_set(ib_engine_pcre_cache(ib), true);
+        }
+        else if (strcasecmp("Off", p1_unescaped) == 0) {
+            ib_pcre_cache_jit_set(ib_engine_pcre_cache(ib), false);
+        }
+        else {
+            ib_cfg_log_error(cp, "Invalid value for %s: %s",
+                             name, p1_unescaped);
+            return IB_EINVAL;
+        }
+        return IB_OK;
+    }
+    else if (strcasecmp("TxIdFormat", name) == 0) {
+        ib_log_debug2(ib, "%s: %s", name, p1_unescaped);
+        if (ctx != ib_context_main(ib)) {
+            ib_cfg_log_error(cp, "%s: Only valid in the main context.", name);
+            return IB_EINVAL;
+        }
+        rc = ib_context_module_config(ctx, ib_core_module(), (void *)&corecfg);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        if (strcasecmp("Random", p1_unescaped) == 0) {
+            corecfg->tx_id_format = IB_TX_ID_RANDOM;
+        }
+        else if (strcasecmp("Sortable", p1_unescaped) == 0) {
+            corecfg->tx_id_format = IB_TX_ID_SORTABLE;
+        }
+        else {
+            ib_cfg_log_error(cp, "Invalid value for %s: %s",
+                             name, p1_unescaped);
+            return IB_EINVAL;
+        }
+        return IB_OK;
+    }
+    else if (strcasecmp("RulePrefilter", name) == 0) {
+        ib_log_debug2(ib, "%s: %s", name, p1_unescaped);
+        if (strcasecmp("On", p1_unescaped) == 0) {
+            rc = ib_context_set_num(ctx, "rule_prefilter", 1);
+        }
+        else if (strcasecmp("Off", p1_unescaped) == 0) {
+            rc = ib_context_set_num(ctx, "rule_prefilter", 0);
+        }
+        else {
+            ib_cfg_log_error(cp, "Invalid value for %s: %s",
+                             name, p1_unescaped);
+            return IB_EINVAL;
+        }
+        return rc;
+    }
+    else if (strcasecmp("RuleBodyLimit", name) == 0) {
+        ib_num_t limit;
+
+        rc = ib_string_to_num(p1_unescaped, 0, &limit);
+        if ( (rc != IB_OK) || (limit < 0) ) {
+            ib_cfg_log_error(cp, "Invalid value for %s: %s",
+                             name, p1_unescaped);
+            return IB_EINVAL;
+        }
+        ib_log_debug2(ib, "%s: %s", name, p1_unescaped);
+        rc = ib_context_set_num(ctx, "rule_body_limit", limit);
+        return rc;
+    }
     else if (strcasecmp("SensorId", name) == 0) {
         union {
             uint64_t uint64;
@@ -4216,6 +4319,264 @@ static ib_status_t core_set_value(ib_cfgparser_t *cp,
 }
 
 
+/**
+ * Handle the MemPoolPolicy directive.
+ *
+ * MemPoolPolicy <role> [PageSize=<n>] [LargeThreshold=<n>] [HugePages=On|Off]
+ *
+ * Only the conn and tx roles can be set, as the pools of the other roles
+ * are created before the configuration is read.  Options not given keep
+ * their current values.
+ *
+ * @param[in] cp Config parser
+ * @param[in] directive Directive name
+ * @param[in] vars List of directive parameters
+ * @param[in] cbdata Callback data (from directive registration)
+ *
+ * @returns Status code
+ */
+static ib_status_t core_dir_mempoolpolicy(ib_cfgparser_t *cp,
+                                          const char *directive,
+                                          const ib_list_t *vars,
+                                          void *cbdata)
+{
+    assert(cp != NULL);
+    assert(directive != NULL);
+    assert(vars != NULL);
+
+    ib_engine_t           *ib = cp->ib;
+    const ib_list_node_t  *node;
+    const char            *role_name;
+    ib_engine_pool_role_t  role;
+    ib_mpool_policy_t      policy;
+
+    if ( (cp->cur_ctx != NULL) && (cp->cur_ctx != ib_context_main(ib)) ) {
+        ib_cfg_log_error(cp, "%s: Only valid in the main context.",
+                         directive);
+        return IB_EINVAL;
+    }
+
+    node = ib_list_first_const(vars);
+    if ( (node == NULL) || (node->data == NULL) ) {
+        ib_cfg_log_error(cp, "%s: No role specified.", directive);
+        return IB_EINVAL;
+    }
+    role_name = (const char *)node->data;
+    if (strcasecmp(role_name, "conn") == 0) {
+        role = IB_ENGINE_POOL_CONN;
+    }
+    else if (strcasecmp(role_name, "tx") == 0) {
+        role = IB_ENGINE_POOL_TX;
+    }
+    else {
+        ib_cfg_log_error(cp, "%s: Invalid role \"%s\" (expected conn or tx).",
+                         directive, role_name);
+        return IB_EINVAL;
+    }
+
+    policy = *ib_engine_pool_policy_get(ib, role);
+    while ( (node = ib_list_node_next_const(node)) != NULL) {
+        const char *param = (const char *)node->data;
+        const char *value = strchr(param, '=');
+        size_t      nlen;
+        ib_num_t    num = 0;
+
+        if (value == NULL) {
+            ib_cfg_log_error(cp, "%s: Invalid option \"%s\".",
+                             directive, param);
+            return IB_EINVAL;
+        }
+        nlen = value - param;
+        ++value;
+
+        if ( (nlen == 9) && (strncasecmp(param, "HugePages", nlen) == 0) ) {
+            if (strcasecmp(value, "On") == 0) {
+                policy.huge_pages = true;
+            }
+            else if (strcasecmp(value, "Off") == 0) {
+                policy.huge_pages = false;
+            }
+            else {
+                ib_cfg_log_error(cp, "%s: Invalid value for HugePages: %s",
+                                 directive, value);
+                return IB_EINVAL;
+            }
+            continue;
+        }
+
+        if ( (ib_string_to_num(value, 0, &num) != IB_OK) || (num < 0) ) {
+            ib_cfg_log_error(cp, "%s: Invalid value for option \"%s\".",
+                             directive, param);
+            return IB_EINVAL;
+        }
+        if ( (nlen == 8) && (strncasecmp(param, "PageSize", nlen) == 0) ) {
+            policy.pagesize = (size_t)num;
+        }
+        else if ( (nlen == 14) &&
+                  (strncasecmp(param, "LargeThreshold", nlen) == 0) )
+        {
+            policy.large_threshold = (size_t)num;
+        }
+        else {
+            ib_cfg_log_error(cp, "%s: Invalid option \"%s\".",
+                             directive, param);
+            return IB_EINVAL;
+        }
+    }
+
+    ib_cfg_log_debug2(cp,
+                      "%s: %s PageSize=%zd LargeThreshold=%zd HugePages=%s",
+                      directive, role_name, policy.pagesize,
+                      policy.large_threshold,
+                      (policy.huge_pages ? "On" : "Off"));
+
+    return ib_engine_pool_policy_set(ib, role, &policy);
+}
+
+
+/**
+ * Handle the AuditLogAsync directive.
+ *
+ * AuditLogAsync On|Off [QueueSize=n] [Overflow=Block|Drop] [Sync=On|Off]
+ *
+ * With AuditLogAsync On, workers render audit logs into memory and queue
+ * them for a writer thread, which writes them in batches.  When the queue
+ * is full, workers wait for space (Block, the default) or drop the log.
+ *
+ * @param[in] cp Config parser
+ * @param[in] directive Directive name
+ * @param[in] vars List of directive parameters
+ * @param[in] cbdata Callback data (from directive registration)
+ *
+ * @returns Status code
+ */
+static ib_status_t core_dir_auditlogasync(ib_cfgparser_t *cp,
+                                          const char *directive,
+                                          const ib_list_t *vars,
+                                          void *cbdata)
+{
+    assert(cp != NULL);
+    assert(directive != NULL);
+    assert(vars != NULL);
+
+    ib_engine_t           *ib = cp->ib;
+    ib_core_module_data_t *core_data;
+    const ib_list_node_t  *node;
+    const char            *mode;
+    bool                   async;
+    size_t                 queue_size = 0;
+    bool                   drop = false;
+    bool                   sync = false;
+    ib_status_t            rc;
+
+    if ( (cp->cur_ctx != NULL) && (cp->cur_ctx != ib_context_main(ib)) ) {
+        ib_cfg_log_error(cp, "%s: Only valid in the main context.",
+                         directive);
+        return IB_EINVAL;
+    }
+
+    node = ib_list_first_const(vars);
+    if ( (node == NULL) || (node->data == NULL) ) {
+        ib_cfg_log_error(cp, "%s: No mode specified.", directive);
+        return IB_EINVAL;
+    }
+    mode = (const char *)node->data;
+    if (strcasecmp(mode, "On") == 0) {
+        async = true;
+    }
+    else if (strcasecmp(mode, "Off") == 0) {
+        async = false;
+    }
+    else {
+        ib_cfg_log_error(cp, "%s: Invalid mode \"%s\" (expected On or Off).",
+                         directive, mode);
+        return IB_EINVAL;
+    }
+
+    while ( (node = ib_list_node_next_const(node)) != NULL) {
+        const char *param = (const char *)node->data;
+        const char *value = strchr(param, '=');
+        size_t      nlen;
+        ib_num_t    num = 0;
+
+        if (value == NULL) {
+            ib_cfg_log_error(cp, "%s: Invalid option \"%s\".",
+                             directive, param);
+            return IB_EINVAL;
+        }
+        nlen = value - param;
+        ++value;
+
+        if ( (nlen == 9) && (strncasecmp(param, "QueueSize", nlen) == 0) ) {
+            if ( (ib_string_to_num(value, 0, &num) != IB_OK) ||
+                 (num < 1) || (num > (1 << 20)) )
+            {
+                ib_cfg_log_error(cp, "%s: Invalid value for QueueSize: %s",
+                                 directive, value);
+                return IB_EINVAL;
+            }
+            queue_size = (size_t)num;
+        }
+        else if ( (nlen == 8) &&
+                  (strncasecmp(param, "Overflow", nlen) == 0) )
+        {
+            if (strcasecmp(value, "Block") == 0) {
+                drop = false;
+            }
+            else if (strcasecmp(value, "Drop") == 0) {
+                drop = true;
+            }
+            else {
+                ib_cfg_log_error(cp, "%s: Invalid value for Overflow: %s",
+                                 directive, value);
+                return IB_EINVAL;
+            }
+        }
+        else if ( (nlen == 4) && (strncasecmp(param, "Sync", nlen) == 0) ) {
+            if (strcasecmp(value, "On") == 0) {
+                sync = true;
+            }
+            else if (strcasecmp(value, "Off") == 0) {
+                sync = false;
+            }
+            else {
+                ib_cfg_log_error(cp, "%s: Invalid value for Sync: %s",
+                                 directive, value);
+                return IB_EINVAL;
+            }
+        }
+        else {
+            ib_cfg_log_error(cp, "%s: Invalid option \"%s\".",
+                             directive, param);
+            return IB_EINVAL;
+        }
+    }
+
+#ifndef HAVE_OPEN_MEMSTREAM
+    if (async) {
+        ib_cfg_log_error(cp, "%s: Not supported on this platform.",
+                         directive);
+        return IB_ENOTIMPL;
+    }
+#endif
+
+    rc = ib_core_module_data(NULL, &core_data);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    core_data->audit_async = async;
+    core_data->audit_queue_size = queue_size;
+    core_data->audit_drop = drop;
+    core_data->audit_sync = sync;
+
+    ib_cfg_log_debug2(cp, "%s: %s QueueSize=%zd Overflow=%s Sync=%s",
+                      directive, (async ? "On" : "Off"), queue_size,
+                      (drop ? "Drop" : "Block"), (sync ? "On" : "Off"));
+
+    return IB_OK;
+}
+
+
 /**
  * Handle two parameter directives.
  *
@@ -4486,6 +4847,30 @@ static IB_DIRMAP_INIT_STRUCTURE(core_directive_map) = {
         NULL
     ),
 
+    /* Regular expressions */
+    IB_DIRMAP_INIT_PARAM1(
+        "RegexJit",
+        core_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_PARAM1(
+        "RulePrefilter",
+        core_dir_param1,
+        NULL
+    ),
+    IB_DIRMAP_INIT_PARAM1(
+        "RuleBodyLimit",
+        core_dir_param1,
+        NULL
+    ),
+
+    /* Transaction IDs */
+    IB_DIRMAP_INIT_PARAM1(
+        "TxIdFormat",
+        core_dir_param1,
+        NULL
+    ),
+
     /* Blocking */
     IB_DIRMAP_INIT_PARAM1(
         "DefaultBlockStatus",
@@ -4585,6 +4970,11 @@ static IB_DIRMAP_INIT_STRUCTURE(core_directive_map) = {
         NULL,
         core_auditlog_parts_map
     ),
+    IB_DIRMAP_INIT_LIST(
+        "AuditLogAsync",
+        core_dir_auditlogasync,
+        NULL
+    ),
 
     /* Search Paths - Modules */
     IB_DIRMAP_INIT_PARAM1(
@@ -4627,6 +5017,13 @@ static IB_DIRMAP_INIT_STRUCTURE(core_directive_map) = {
         NULL
     ),
 
+    /* Memory pools */
+    IB_DIRMAP_INIT_LIST(
+        "MemPoolPolicy",
+        core_dir_mempoolpolicy,
+        NULL
+    ),
+
     /* End */
     IB_DIRMAP_INIT_LAST
 };
@@ -4697,7 +5094,10 @@ static ib_status_t core_init(ib_engine_t *ib,
     corecfg->rule_log_level       = IB_LOG_INFO;
     corecfg->rule_debug_str       = "error";
     corecfg->rule_debug_level     = IB_RULE_DLOG_ERROR;
+    corecfg->rule_prefilter       = 0;
+    corecfg->rule_body_limit      = 1024 * 1024;
     corecfg->block_status         = 403;
+    corecfg->tx_id_format         = IB_TX_ID_RANDOM;
 
     /* Register logger functions. */
     ib_log_set_logger_fn(ib, core_vlogmsg, NULL);
@@ -4876,6 +5276,52 @@ static ib_status_t core_init(ib_engine_t *ib,
     return IB_OK;
 }
 
+/**
+ * Start the asynchronous audit log writer, if AuditLogAsync is On.
+ *
+ * @param[in] ib Engine
+ *
+ * @returns Status code
+ */
+static ib_status_t core_audit_writer_start(ib_engine_t *ib)
+{
+    ib_core_module_data_t *core_data;
+    ib_status_t rc;
+
+    rc = ib_core_module_data(NULL, &core_data);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    if ( (! core_data->audit_async) || (core_data->audit_writer != NULL) ) {
+        return IB_OK;
+    }
+
+    return core_audit_writer_create(ib,
+                                    core_data->audit_queue_size,
+                                    core_data->audit_drop,
+                                    core_data->audit_sync,
+                                    &(core_data->audit_writer));
+}
+
+/**
+ * Stop the asynchronous audit log writer, if it's running.
+ *
+ * Queued logs refer to their contexts' index files, so this is done
+ * before any context is destroyed.
+ */
+static void core_audit_writer_stop(void)
+{
+    ib_core_module_data_t *core_data;
+
+    if (ib_core_module_data(NULL, &core_data) != IB_OK) {
+        return;
+    }
+    if (core_data->audit_writer != NULL) {
+        core_audit_writer_destroy(core_data->audit_writer);
+        core_data->audit_writer = NULL;
+    }
+}
+
 /**
  * Shutdown the core module on exit.
  *
@@ -4894,6 +5340,9 @@ ib_status_t core_finish(
 {
     ib_status_t rc;
 
+    /* Stop the audit log writer, if it's still running */
+    core_audit_writer_stop();
+
     /* Shut down the core collection managers */
     rc = ib_core_collection_managers_finish(ib, m);
     if (rc != IB_OK) {
@@ -4954,6 +5403,18 @@ static IB_CFGMAP_INIT_STRUCTURE(core_config_map) = {
         ib_core_cfg_t,
         rule_debug_level
     ),
+    IB_CFGMAP_INIT_ENTRY(
+        "rule_prefilter",
+        IB_FTYPE_NUM,
+        ib_core_cfg_t,
+        rule_prefilter
+    ),
+    IB_CFGMAP_INIT_ENTRY(
+        "rule_body_limit",
+        IB_FTYPE_NUM,
+        ib_core_cfg_t,
+        rule_body_limit
+    ),
 
     /* Parser */
     IB_CFGMAP_INIT_ENTRY(
@@ -5113,6 +5574,11 @@ static ib_status_t core_ctx_close(ib_engine_t  *ib,
         if (rc != IB_OK) {
             return rc;
         }
+
+        rc = core_audit_writer_start(ib);
+        if (rc != IB_OK) {
+            return rc;
+        }
     }
 
     return IB_OK;
@@ -5182,6 +5648,9 @@ static ib_status_t core_ctx_destroy(ib_engine_t *ib,
     ib_core_cfg_t *main_config;
     ib_status_t rc;
 
+    /* Write any queued audit logs while their contexts still exist. */
+    core_audit_writer_stop();
+
     /* Get the current context config. */
     rc = ib_context_module_config(ctx, mod, (void *)&config);
     if (rc != IB_OK) {
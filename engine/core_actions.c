@@ -153,6 +153,10 @@ typedef struct {
     bool             name_expand; /**< Field name should be expanded */
     ib_ftype_t       type;        /**< Data type */
     setvar_value_t   value;       /**< Value. value.num, flt, or bstr. */
+    /** Compiled @c name if @c name_expand is set, or NULL */
+    const ib_expand_template_t *name_template;
+    /** Compiled string value if it should be expanded, or NULL */
+    const ib_expand_template_t *value_template;
 } setvar_data_t;
 
 /**
@@ -505,7 +509,20 @@ static ib_status_t act_event_execute(
     ib_rule_log_debug(rule_exec, "Creating event via action");
 
     /* Expand the message string */
-    if ( (rule->meta.flags & IB_RULEMD_FLAG_EXPAND_MSG) != 0) {
+    if (rule->meta.msg_template != NULL) {
+        char *tmp;
+        size_t len;
+        rc = ib_data_expand_template_str(tx->data, rule->meta.msg_template,
+                                         true, &tmp, &len);
+        if (rc != IB_OK) {
+            ib_rule_log_error(rule_exec,
+                              "event: Failed to expand string '%s': %s",
+                              rule->meta.msg, ib_status_to_string(rc));
+            return rc;
+        }
+        expanded = tmp;
+    }
+    else if ( (rule->meta.flags & IB_RULEMD_FLAG_EXPAND_MSG) != 0) {
         char *tmp;
         rc = ib_data_expand_str(tx->data, rule->meta.msg, false, &tmp);
         if (rc != IB_OK) {
@@ -540,7 +557,21 @@ static ib_status_t act_event_execute(
 
     /* Set the data */
     if (rule->meta.data != NULL) {
-        if ( (rule->meta.flags & IB_RULEMD_FLAG_EXPAND_DATA) != 0) {
+        size_t len;
+        if (rule->meta.data_template != NULL) {
+            char *tmp;
+            rc = ib_data_expand_template_str(tx->data,
+                                             rule->meta.data_template,
+                                             true, &tmp, &len);
+            if (rc != IB_OK) {
+                ib_rule_log_error(rule_exec,
+                                  "event: Failed to expand data '%s': %s",
+                                  rule->meta.data, ib_status_to_string(rc));
+                return rc;
+            }
+            expanded = tmp;
+        }
+        else if ( (rule->meta.flags & IB_RULEMD_FLAG_EXPAND_DATA) != 0) {
             char *tmp;
             rc = ib_data_expand_str(tx->data, rule->meta.data, false, &tmp);
             if (rc != IB_OK) {
@@ -550,11 +581,13 @@ static ib_status_t act_event_execute(
                 return rc;
             }
             expanded = tmp;
+            len = strlen(expanded);
         }
         else {
             expanded = rule->meta.data;
+            len = strlen(expanded);
         }
-        rc = ib_logevent_data_set(event, expanded, strlen(expanded));
+        rc = ib_logevent_data_set(event, expanded, len);
         if (rc != IB_OK) {
             ib_rule_log_error(rule_exec, "event: Failed to set data: %s",
                               ib_status_to_string(rc));
@@ -691,6 +724,19 @@ static ib_status_t act_setvar_create(
         return IB_EALLOC;
     }
 
+    /* Compile the name so that it isn't parsed on every execution */
+    data->name_template = NULL;
+    data->value_template = NULL;
+    if (data->name_expand) {
+        ib_expand_template_t *tmpl;
+
+        rc = ib_data_expand_template_create(mp, params, nlen, &tmpl);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        data->name_template = tmpl;
+    }
+
     /* Create the value */
     rc = ib_string_to_num_ex(value, vlen, 0, &(data->value.num));
     if (rc == IB_OK) {
@@ -747,6 +793,13 @@ static ib_status_t act_setvar_create(
             return rc;
         }
         else if (expand) {
+            ib_expand_template_t *tmpl;
+
+            rc = ib_data_expand_template_create(mp, value, vlen, &tmpl);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            data->value_template = tmpl;
             inst->flags |= IB_ACTINST_FLAG_EXPAND;
         }
 
@@ -797,10 +850,17 @@ static ib_status_t expand_name(const ib_rule_exec_t *rule_exec,
         size_t len;
         ib_status_t rc;
 
-        rc = ib_data_expand_str_ex(tx->data,
-                                   name, strlen(name),
-                                   false, false,
-                                   &tmp, &len);
+        if (setvar_data->name_template != NULL) {
+            rc = ib_data_expand_template_str(tx->data,
+                                             setvar_data->name_template,
+                                             false, &tmp, &len);
+        }
+        else {
+            rc = ib_data_expand_str_ex(tx->data,
+                                       name, strlen(name),
+                                       false, false,
+                                       &tmp, &len);
+        }
         if (rc != IB_OK) {
             ib_rule_log_error(rule_exec,
                               "%s: Failed to expand name \"%s\": %s",
@@ -956,8 +1016,15 @@ static ib_status_t expand_data(
         /* Expand the string */
         if (flags & IB_ACTINST_FLAG_EXPAND) {
 
-            rc = ib_data_expand_str_ex(
-                tx->data, bsdata, bslen, false, false, expanded, exlen);
+            if (setvar_data->value_template != NULL) {
+                rc = ib_data_expand_template_str(
+                    tx->data, setvar_data->value_template, false,
+                    expanded, exlen);
+            }
+            else {
+                rc = ib_data_expand_str_ex(
+                    tx->data, bsdata, bslen, false, false, expanded, exlen);
+            }
             if (rc != IB_OK) {
                 ib_rule_log_debug(
                     rule_exec,
@@ -38,9 +38,12 @@
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 
 /* POSIX doesn't define O_BINARY */
@@ -60,6 +63,70 @@ typedef struct {
 static const char * const ib_pipe_shell = "/bin/sh";
 const size_t LOGFORMAT_MAX_LINE_LENGTH = 8192;
 
+#ifdef HAVE_OPEN_MEMSTREAM
+/**
+ * Free an audit log's memory stream, if it was not handed to the writer.
+ *
+ * @param[in] data Core audit configuration
+ */
+static void core_audit_memstream_cleanup(void *data)
+{
+    core_audit_cfg_t *cfg = (core_audit_cfg_t *)data;
+
+    if (cfg->fp != NULL) {
+        fclose(cfg->fp);
+        cfg->fp = NULL;
+    }
+    if (cfg->buf != NULL) {
+        free(cfg->buf);
+        cfg->buf = NULL;
+    }
+}
+#endif
+
+/**
+ * Open a memory stream to write an audit log to before it is queued for
+ * the asynchronous writer.
+ *
+ * @param[in] log Audit log
+ * @param[in,out] cfg Core audit configuration
+ * @param[in] dn Audit log directory
+ *
+ * @returns Status code
+ */
+static ib_status_t core_audit_open_memstream(ib_auditlog_t *log,
+                                             core_audit_cfg_t *cfg,
+                                             const char *dn)
+{
+#ifdef HAVE_OPEN_MEMSTREAM
+    ib_status_t rc;
+
+    cfg->dn = ib_mpool_strdup(cfg->tx->mp, dn);
+    if (cfg->dn == NULL) {
+        return IB_EALLOC;
+    }
+
+    cfg->fp = open_memstream(&cfg->buf, &cfg->buf_len);
+    if (cfg->fp == NULL) {
+        ib_log_error(log->ib, "Failed to open audit log memory stream: %s",
+                     strerror(errno));
+        return IB_EALLOC;
+    }
+
+    /* Free the stream if the log is never closed. */
+    rc = ib_mpool_cleanup_register(cfg->tx->mp,
+                                   core_audit_memstream_cleanup, cfg);
+    if (rc != IB_OK) {
+        core_audit_memstream_cleanup(cfg);
+        return rc;
+    }
+
+    return IB_OK;
+#else
+    return IB_ENOTIMPL;
+#endif
+}
+
 ib_status_t core_audit_open_auditfile(ib_provider_inst_t *lpi,
                                       ib_auditlog_t *log,
                                       core_audit_cfg_t *cfg,
@@ -155,15 +222,6 @@ ib_status_t core_audit_open_auditfile(ib_provider_inst_t *lpi,
         return IB_EINVAL;
     }
 
-    ib_rc = ib_util_mkpath(dn, corecfg->auditlog_dmode);
-    if (ib_rc != IB_OK) {
-        ib_log_error(log->ib,
-                     "Could not create audit log dir: %s", dn);
-        free(dtmp);
-        free(dn);
-        return ib_rc;
-    }
-
     // Create temporary filename to use while writing the audit log
     temp_filename_sz = strlen(audit_filename) + 6;
     temp_filename = (char *)ib_mpool_alloc(cfg->tx->mp, temp_filename_sz);
@@ -179,24 +237,45 @@ ib_status_t core_audit_open_auditfile(ib_provider_inst_t *lpi,
         return IB_EINVAL;
     }
 
-    /* Open the file.  Use open() & fdopen() to avoid chmod() */
-    fd = open(temp_filename,
-              (O_WRONLY|O_APPEND|O_CREAT|O_BINARY),
-              corecfg->auditlog_fmode);
-    if (fd >= 0) {
-        cfg->fp = fdopen(fd, "ab");
-        if (cfg->fp == NULL) {
-            close(fd);
+    /* The asynchronous writer creates the directory and file; write the
+     * log to memory until then. */
+    if (cfg->writer != NULL) {
+        ib_rc = core_audit_open_memstream(log, cfg, dn);
+        if (ib_rc != IB_OK) {
+            free(dtmp);
+            free(dn);
+            return ib_rc;
         }
     }
-    if ( (fd < 0) || (cfg->fp == NULL) ) {
-        sys_rc = errno;
-        ib_log_error(log->ib,
-                     "Failed to open audit log \"%s\": %s (%d)",
-                     temp_filename, strerror(sys_rc), sys_rc);
-        free(dtmp);
-        free(dn);
-        return IB_EINVAL;
+    else {
+        ib_rc = ib_util_mkpath(dn, corecfg->auditlog_dmode);
+        if (ib_rc != IB_OK) {
+            ib_log_error(log->ib,
+                         "Could not create audit log dir: %s", dn);
+            free(dtmp);
+            free(dn);
+            return ib_rc;
+        }
+
+        /* Open the file.  Use open() & fdopen() to avoid chmod() */
+        fd = open(temp_filename,
+                  (O_WRONLY|O_APPEND|O_CREAT|O_BINARY),
+                  corecfg->auditlog_fmode);
+        if (fd >= 0) {
+            cfg->fp = fdopen(fd, "ab");
+            if (cfg->fp == NULL) {
+                close(fd);
+            }
+        }
+        if ( (fd < 0) || (cfg->fp == NULL) ) {
+            sys_rc = errno;
+            ib_log_error(log->ib,
+                         "Failed to open audit log \"%s\": %s (%d)",
+                         temp_filename, strerror(sys_rc), sys_rc);
+            free(dtmp);
+            free(dn);
+            return IB_EINVAL;
+        }
     }
 
     /* Track the relative audit log filename. */
@@ -643,6 +722,705 @@ static ib_status_t core_audit_get_index_line(ib_provider_inst_t *lpi,
     return rc;
 }
 
+/* -- Asynchronous Writer -- */
+
+/** Default number of queue slots */
+#define CORE_AUDIT_QUEUE_DEFAULT 1024
+
+/** Maximum number of logs written in a batch */
+#define CORE_AUDIT_BATCH_MAX 64
+
+/** How long the idle writer sleeps between checks of the queue (msec) */
+#define CORE_AUDIT_IDLE_MSEC 100
+
+/** How long a blocked worker sleeps between checks of the queue (msec) */
+#define CORE_AUDIT_BLOCK_MSEC 10
+
+/** Padding to keep the queue positions on separate cache lines */
+#define CORE_AUDIT_CACHE_LINE 64
+
+/** Atomic load with acquire ordering */
+#define CORE_AUDIT_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+
+/** Atomic store with release ordering */
+#define CORE_AUDIT_STORE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/** Atomic counter increment */
+#define CORE_AUDIT_ADD(p, v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+
+/**
+ * An audit log rendered by a worker, to be written by the writer.
+ *
+ * The record and its strings are a single allocation.
+ */
+typedef struct {
+    ib_auditlog_cfg_t  *index;          /**< Index file, if line is set */
+    const char         *dn;             /**< Audit log directory */
+    const char         *full_path;      /**< Audit log full path */
+    const char         *temp_path;      /**< Full path of temporary file */
+    const char         *line;           /**< Index line or NULL */
+    size_t              line_len;       /**< Length of line */
+    char               *data;           /**< Audit log (malloc) */
+    size_t              data_len;       /**< Length of data */
+    mode_t              dmode;          /**< Directory create mode */
+    mode_t              fmode;          /**< File create mode */
+} core_audit_record_t;
+
+/**
+ * A queue slot.
+ *
+ * The slot at position @e pos is free for a worker when seq is @e pos,
+ * and holds a record for the writer when seq is @e pos + 1.
+ */
+typedef struct {
+    size_t               seq;           /**< Sequence number */
+    core_audit_record_t *record;        /**< Queued record */
+} core_audit_slot_t;
+
+struct core_audit_writer_t {
+    ib_engine_t        *ib;             /**< IronBee engine */
+    core_audit_slot_t  *slots;          /**< Queue slots */
+    size_t              mask;           /**< Number of slots - 1 */
+    bool                drop;           /**< Drop records when full? */
+    bool                sync;           /**< Sync each batch? */
+    char                pad1[CORE_AUDIT_CACHE_LINE];
+    size_t              head;           /**< Next position to enqueue */
+    char                pad2[CORE_AUDIT_CACHE_LINE];
+    size_t              tail;           /**< Next position to dequeue */
+    char                pad3[CORE_AUDIT_CACHE_LINE];
+    int                 sleeping;       /**< Is the writer waiting? */
+    int                 waiting;        /**< Number of blocked workers */
+    int                 stop;           /**< Should the writer stop? */
+    pthread_t           thread;         /**< Writer thread */
+    pthread_mutex_t     mutex;          /**< Protects the conditions */
+    pthread_cond_t      wake;           /**< Signals the writer */
+    pthread_cond_t      space;          /**< Signals blocked workers */
+    size_t              high_water;     /**< Largest depth seen */
+    uint64_t            queued;         /**< Records queued */
+    uint64_t            written;        /**< Records written */
+    uint64_t            dropped;        /**< Records dropped */
+    uint64_t            blocked;        /**< Times a worker blocked */
+    uint64_t            batches;        /**< Batches written */
+    uint64_t            errors;         /**< Records not written */
+};
+
+/**
+ * Add a record to the queue.
+ *
+ * Any number of workers may call this at once.
+ *
+ * @param[in] writer Writer
+ * @param[in] record Record to add
+ *
+ * @returns true if the record was added, false if the queue is full.
+ */
+static bool core_audit_queue_push(core_audit_writer_t *writer,
+                                  core_audit_record_t *record)
+{
+    core_audit_slot_t *slot;
+    size_t pos = __atomic_load_n(&(writer->head), __ATOMIC_RELAXED);
+
+    for (;;) {
+        size_t seq;
+
+        slot = &(writer->slots[pos & writer->mask]);
+        seq = CORE_AUDIT_LOAD(&(slot->seq));
+        if (seq == pos) {
+            /* On failure, pos is set to the current head. */
+            if (__atomic_compare_exchange_n(&(writer->head), &pos, pos + 1,
+                                            true, __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if ((ssize_t)(seq - pos) < 0) {
+            return false;
+        }
+        else {
+            pos = __atomic_load_n(&(writer->head), __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->record = record;
+    CORE_AUDIT_STORE(&(slot->seq), pos + 1);
+
+    return true;
+}
+
+/**
+ * Remove the next record from the queue.
+ *
+ * Only the writer calls this.
+ *
+ * @param[in] writer Writer
+ *
+ * @returns The record, or NULL if the queue is empty.
+ */
+static core_audit_record_t *core_audit_queue_pop(core_audit_writer_t *writer)
+{
+    size_t pos = writer->tail;
+    core_audit_slot_t *slot = &(writer->slots[pos & writer->mask]);
+    core_audit_record_t *record;
+
+    if (CORE_AUDIT_LOAD(&(slot->seq)) != pos + 1) {
+        return NULL;
+    }
+    record = slot->record;
+    slot->record = NULL;
+    CORE_AUDIT_STORE(&(slot->seq), pos + writer->mask + 1);
+    CORE_AUDIT_STORE(&(writer->tail), pos + 1);
+
+    return record;
+}
+
+/**
+ * Is the queue empty?
+ *
+ * @param[in] writer Writer
+ *
+ * @returns true if the writer has nothing to dequeue.
+ */
+static bool core_audit_queue_empty(const core_audit_writer_t *writer)
+{
+    size_t pos = writer->tail;
+
+    return CORE_AUDIT_LOAD(&(writer->slots[pos & writer->mask].seq)) !=
+           pos + 1;
+}
+
+/**
+ * Wait on a condition for at most @a msec milliseconds.
+ *
+ * @param[in] cond Condition
+ * @param[in] mutex Locked mutex
+ * @param[in] msec Time to wait
+ */
+static void core_audit_timedwait(pthread_cond_t *cond,
+                                 pthread_mutex_t *mutex,
+                                 long msec)
+{
+    struct timeval tv;
+    struct timespec ts;
+
+    gettimeofday(&tv, NULL);
+    ts.tv_sec = tv.tv_sec + (msec / 1000);
+    ts.tv_nsec = (tv.tv_usec * 1000) + ((msec % 1000) * 1000000);
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000;
+    }
+    pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+/**
+ * Free a record.
+ *
+ * @param[in] record Record to free
+ */
+static void core_audit_record_free(core_audit_record_t *record)
+{
+    free(record->data);
+    free(record);
+}
+
+/**
+ * Create a record's temporary file and write the audit log to it.
+ *
+ * The directory is only created if the file cannot be.
+ *
+ * @param[in] writer Writer
+ * @param[in] record Record to write
+ *
+ * @returns The open file descriptor, or -1 on failure.
+ */
+static int core_audit_record_write(core_audit_writer_t *writer,
+                                   const core_audit_record_t *record)
+{
+    const char *data = record->data;
+    size_t left = record->data_len;
+    int fd;
+    int sys_rc;
+
+    fd = open(record->temp_path, (O_WRONLY|O_APPEND|O_CREAT|O_BINARY),
+              record->fmode);
+    if ( (fd < 0) && (errno == ENOENT) ) {
+        if (ib_util_mkpath(record->dn, record->dmode) != IB_OK) {
+            ib_log_error(writer->ib,
+                         "Could not create audit log dir: %s", record->dn);
+            return -1;
+        }
+        fd = open(record->temp_path, (O_WRONLY|O_APPEND|O_CREAT|O_BINARY),
+                  record->fmode);
+    }
+    if (fd < 0) {
+        sys_rc = errno;
+        ib_log_error(writer->ib, "Failed to open audit log \"%s\": %s (%d)",
+                     record->temp_path, strerror(sys_rc), sys_rc);
+        return -1;
+    }
+
+    while (left > 0) {
+        ssize_t len = write(fd, data, left);
+
+        if (len < 0) {
+            sys_rc = errno;
+            if (sys_rc == EINTR) {
+                continue;
+            }
+            ib_log_error(writer->ib,
+                         "Failed to write audit log \"%s\": %s (%d)",
+                         record->temp_path, strerror(sys_rc), sys_rc);
+            close(fd);
+            return -1;
+        }
+        data += len;
+        left -= len;
+    }
+
+    return fd;
+}
+
+/**
+ * Write a batch of records.
+ *
+ * Each audit log is written with as few writes as possible, and if the
+ * writer syncs, all of the batch's logs are synced before any is renamed.
+ * The index lines of the batch are then written with one lock and one
+ * flush per index file.
+ *
+ * @param[in] writer Writer
+ * @param[in] batch Records to write; these are freed
+ * @param[in] num Number of records in @a batch
+ */
+static void core_audit_writer_batch(core_audit_writer_t *writer,
+                                    core_audit_record_t **batch,
+                                    size_t num)
+{
+    int fds[CORE_AUDIT_BATCH_MAX];
+    uint64_t written = 0;
+    size_t i;
+    size_t j;
+    int sys_rc;
+
+    assert(num <= CORE_AUDIT_BATCH_MAX);
+
+    for (i = 0;  i < num;  ++i) {
+        fds[i] = core_audit_record_write(writer, batch[i]);
+    }
+
+    if (writer->sync) {
+        for (i = 0;  i < num;  ++i) {
+            if ( (fds[i] >= 0) && (fsync(fds[i]) != 0) ) {
+                sys_rc = errno;
+                ib_log_error(writer->ib,
+                             "Failed to sync audit log \"%s\": %s (%d)",
+                             batch[i]->temp_path, strerror(sys_rc), sys_rc);
+                close(fds[i]);
+                fds[i] = -1;
+            }
+        }
+    }
+
+    for (i = 0;  i < num;  ++i) {
+        if (fds[i] < 0) {
+            continue;
+        }
+        close(fds[i]);
+        if (rename(batch[i]->temp_path, batch[i]->full_path) != 0) {
+            sys_rc = errno;
+            ib_log_error(writer->ib,
+                         "Error renaming auditlog %s: %s (%d)",
+                         batch[i]->temp_path, strerror(sys_rc), sys_rc);
+            fds[i] = -1;
+            continue;
+        }
+        ++written;
+    }
+
+    for (i = 0;  i < num;  ++i) {
+        ib_auditlog_cfg_t *index = batch[i]->index;
+
+        if ( (fds[i] < 0) || (batch[i]->line == NULL) ) {
+            continue;
+        }
+
+        ib_lock_lock(&(index->index_fp_lock));
+        for (j = i;  j < num;  ++j) {
+            if ( (fds[j] < 0) ||
+                 (batch[j]->line == NULL) ||
+                 (batch[j]->index != index) )
+            {
+                continue;
+            }
+            if ( (index->index_fp != NULL) &&
+                 (fwrite(batch[j]->line, batch[j]->line_len, 1,
+                         index->index_fp) != 1) )
+            {
+                ib_log_error(writer->ib,
+                             "Could not write to audit log index.");
+            }
+            batch[j]->line = NULL;
+        }
+        if (index->index_fp != NULL) {
+            fflush(index->index_fp);
+            if (writer->sync) {
+                fsync(fileno(index->index_fp));
+            }
+        }
+        ib_lock_unlock(&(index->index_fp_lock));
+    }
+
+    for (i = 0;  i < num;  ++i) {
+        core_audit_record_free(batch[i]);
+    }
+
+    CORE_AUDIT_ADD(&(writer->written), written);
+    CORE_AUDIT_ADD(&(writer->errors), (uint64_t)num - written);
+    CORE_AUDIT_ADD(&(writer->batches), 1);
+}
+
+/**
+ * Writer thread.
+ *
+ * @param[in] arg Writer
+ *
+ * @returns NULL
+ */
+static void *core_audit_writer_thread(void *arg)
+{
+    core_audit_writer_t *writer = (core_audit_writer_t *)arg;
+    core_audit_record_t *batch[CORE_AUDIT_BATCH_MAX];
+    size_t num;
+
+    for (;;) {
+        for (num = 0;  num < CORE_AUDIT_BATCH_MAX;  ++num) {
+            batch[num] = core_audit_queue_pop(writer);
+            if (batch[num] == NULL) {
+                break;
+            }
+        }
+
+        if (num > 0) {
+            if (CORE_AUDIT_LOAD(&(writer->waiting)) > 0) {
+                pthread_mutex_lock(&(writer->mutex));
+                pthread_cond_broadcast(&(writer->space));
+                pthread_mutex_unlock(&(writer->mutex));
+            }
+            core_audit_writer_batch(writer, batch, num);
+            continue;
+        }
+
+        if (CORE_AUDIT_LOAD(&(writer->stop))) {
+            break;
+        }
+
+        /* Workers signal wake if they see sleeping set after queueing;
+         * check the queue again after setting it. */
+        pthread_mutex_lock(&(writer->mutex));
+        __atomic_store_n(&(writer->sleeping), 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (core_audit_queue_empty(writer) && ! writer->stop) {
+            core_audit_timedwait(&(writer->wake), &(writer->mutex),
+                                 CORE_AUDIT_IDLE_MSEC);
+        }
+        CORE_AUDIT_STORE(&(writer->sleeping), 0);
+        pthread_mutex_unlock(&(writer->mutex));
+    }
+
+    return NULL;
+}
+
+/**
+ * Queue a record for the writer.
+ *
+ * If the queue is full, the record is dropped or the worker waits for
+ * space, depending on the writer's overflow policy.
+ *
+ * @param[in] writer Writer
+ * @param[in] record Record; freed if it is not queued
+ *
+ * @returns
+ *   - IB_OK if the record was queued.
+ *   - IB_EAGAIN if the record was dropped.
+ *   - IB_EOTHER if the writer stopped while waiting.
+ */
+static ib_status_t core_audit_writer_submit(core_audit_writer_t *writer,
+                                            core_audit_record_t *record)
+{
+    size_t tail;
+    size_t depth;
+    size_t high_water;
+
+    if (! core_audit_queue_push(writer, record)) {
+        if (writer->drop) {
+            CORE_AUDIT_ADD(&(writer->dropped), 1);
+            core_audit_record_free(record);
+            return IB_EAGAIN;
+        }
+
+        CORE_AUDIT_ADD(&(writer->blocked), 1);
+        pthread_mutex_lock(&(writer->mutex));
+        CORE_AUDIT_ADD(&(writer->waiting), 1);
+        while (! core_audit_queue_push(writer, record)) {
+            if (writer->stop) {
+                CORE_AUDIT_ADD(&(writer->waiting), -1);
+                pthread_mutex_unlock(&(writer->mutex));
+                CORE_AUDIT_ADD(&(writer->errors), 1);
+                core_audit_record_free(record);
+                return IB_EOTHER;
+            }
+            pthread_cond_signal(&(writer->wake));
+            core_audit_timedwait(&(writer->space), &(writer->mutex),
+                                 CORE_AUDIT_BLOCK_MSEC);
+        }
+        CORE_AUDIT_ADD(&(writer->waiting), -1);
+        pthread_mutex_unlock(&(writer->mutex));
+    }
+
+    CORE_AUDIT_ADD(&(writer->queued), 1);
+    tail = CORE_AUDIT_LOAD(&(writer->tail));
+    depth = CORE_AUDIT_LOAD(&(writer->head)) - tail;
+    if (depth > writer->mask + 1) {
+        depth = writer->mask + 1;
+    }
+    high_water = CORE_AUDIT_LOAD(&(writer->high_water));
+    while ( (depth > high_water) &&
+            ! __atomic_compare_exchange_n(&(writer->high_water),
+                                          &high_water, depth, true,
+                                          __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED) )
+    {
+        /* high_water was updated to the current value. */
+    }
+
+    /* The writer checks the queue after setting sleeping; see
+     * core_audit_writer_thread(). */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(writer->sleeping), __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&(writer->mutex));
+        pthread_cond_signal(&(writer->wake));
+        pthread_mutex_unlock(&(writer->mutex));
+    }
+
+    return IB_OK;
+}
+
+ib_status_t core_audit_writer_create(ib_engine_t *ib,
+                                     size_t queue_size,
+                                     bool drop,
+                                     bool sync,
+                                     core_audit_writer_t **writer)
+{
+    assert(ib != NULL);
+    assert(writer != NULL);
+
+#ifdef HAVE_OPEN_MEMSTREAM
+    core_audit_writer_t *w;
+    size_t size = 2;
+    size_t n;
+
+    if (queue_size == 0) {
+        queue_size = CORE_AUDIT_QUEUE_DEFAULT;
+    }
+    while (size < queue_size) {
+        size <<= 1;
+    }
+
+    w = calloc(1, sizeof(*w));
+    if (w == NULL) {
+        return IB_EALLOC;
+    }
+    w->slots = calloc(size, sizeof(*w->slots));
+    if (w->slots == NULL) {
+        free(w);
+        return IB_EALLOC;
+    }
+    for (n = 0;  n < size;  ++n) {
+        w->slots[n].seq = n;
+    }
+    w->ib = ib;
+    w->mask = size - 1;
+    w->drop = drop;
+    w->sync = sync;
+
+    if ( (pthread_mutex_init(&(w->mutex), NULL) != 0) ||
+         (pthread_cond_init(&(w->wake), NULL) != 0) ||
+         (pthread_cond_init(&(w->space), NULL) != 0) ||
+         (pthread_create(&(w->thread), NULL,
+                         core_audit_writer_thread, w) != 0) )
+    {
+        ib_log_error(ib, "Failed to start the audit log writer.");
+        free(w->slots);
+        free(w);
+        return IB_EUNKNOWN;
+    }
+
+    ib_log_debug(ib, "Started the audit log writer: %zd slots, %s, %s.",
+                 size, (drop ? "drop" : "block"),
+                 (sync ? "sync" : "no sync"));
+
+    *writer = w;
+    return IB_OK;
+#else
+    ib_log_error(ib, "Asynchronous audit logs are not supported.");
+    return IB_ENOTIMPL;
+#endif
+}
+
+void core_audit_writer_destroy(core_audit_writer_t *writer)
+{
+    core_audit_record_t *batch[CORE_AUDIT_BATCH_MAX];
+    size_t num;
+
+    if (writer == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&(writer->mutex));
+    CORE_AUDIT_STORE(&(writer->stop), 1);
+    pthread_cond_signal(&(writer->wake));
+    pthread_cond_broadcast(&(writer->space));
+    pthread_mutex_unlock(&(writer->mutex));
+    pthread_join(writer->thread, NULL);
+
+    /* Write anything queued after the writer's last look. */
+    do {
+        for (num = 0;  num < CORE_AUDIT_BATCH_MAX;  ++num) {
+            batch[num] = core_audit_queue_pop(writer);
+            if (batch[num] == NULL) {
+                break;
+            }
+        }
+        if (num > 0) {
+            core_audit_writer_batch(writer, batch, num);
+        }
+    } while (num == CORE_AUDIT_BATCH_MAX);
+
+    ib_log_debug(writer->ib,
+                 "Stopped the audit log writer: %" PRIu64 " queued, "
+                 "%" PRIu64 " written, %" PRIu64 " dropped, "
+                 "%" PRIu64 " errors.",
+                 writer->queued, writer->written, writer->dropped,
+                 writer->errors);
+
+    pthread_cond_destroy(&(writer->space));
+    pthread_cond_destroy(&(writer->wake));
+    pthread_mutex_destroy(&(writer->mutex));
+    free(writer->slots);
+    free(writer);
+}
+
+void core_audit_writer_stats(const core_audit_writer_t *writer,
+                             ib_core_audit_stats_t *stats)
+{
+    assert(writer != NULL);
+    assert(stats != NULL);
+
+    size_t tail = CORE_AUDIT_LOAD(&(writer->tail));
+
+    stats->async = true;
+    stats->queue_size = writer->mask + 1;
+    stats->depth = CORE_AUDIT_LOAD(&(writer->head)) - tail;
+    stats->depth_high_water = CORE_AUDIT_LOAD(&(writer->high_water));
+    stats->queued = CORE_AUDIT_LOAD(&(writer->queued));
+    stats->written = CORE_AUDIT_LOAD(&(writer->written));
+    stats->dropped = CORE_AUDIT_LOAD(&(writer->dropped));
+    stats->blocked = CORE_AUDIT_LOAD(&(writer->blocked));
+    stats->batches = CORE_AUDIT_LOAD(&(writer->batches));
+    stats->errors = CORE_AUDIT_LOAD(&(writer->errors));
+}
+
+/**
+ * Queue a closed audit log for the asynchronous writer.
+ *
+ * The index line is formatted here, while the transaction still exists.
+ *
+ * @param[in] lpi Log provider instance
+ * @param[in] log Audit log
+ * @param[in] corecfg Core configuration
+ * @param[in] line Buffer of LOGFORMAT_MAX_LINE_LENGTH + 2 bytes
+ *
+ * @returns Status code
+ */
+static ib_status_t core_audit_close_async(ib_provider_inst_t *lpi,
+                                          ib_auditlog_t *log,
+                                          const ib_core_cfg_t *corecfg,
+                                          char *line)
+{
+    core_audit_cfg_t *cfg = (core_audit_cfg_t *)log->cfg_data;
+    core_audit_record_t *record;
+    size_t line_len = 0;
+    size_t dn_len;
+    size_t full_len;
+    size_t temp_len;
+    char *p;
+    ib_status_t rc = IB_OK;
+    ib_status_t line_rc = IB_OK;
+
+    /* Closing the stream sets buf and buf_len. */
+    if (cfg->fp != NULL) {
+        fclose(cfg->fp);
+        cfg->fp = NULL;
+    }
+    if (cfg->buf == NULL) {
+        return IB_EALLOC;
+    }
+
+    if ((cfg->index_fp != NULL) && (cfg->parts_written > 0)) {
+        line_rc = core_audit_get_index_line(lpi, log, line,
+                                            LOGFORMAT_MAX_LINE_LENGTH,
+                                            &line_len);
+        if ( (line_rc == IB_OK) || (line_rc == IB_ETRUNC) ) {
+            line[line_len++] = '\n';
+            line_rc = IB_OK;
+        }
+        else {
+            line_len = 0;
+        }
+    }
+
+    dn_len = strlen(cfg->dn) + 1;
+    full_len = strlen(cfg->full_path) + 1;
+    temp_len = strlen(cfg->temp_path) + 1;
+    record = malloc(sizeof(*record) + dn_len + full_len + temp_len + line_len);
+    if (record == NULL) {
+        return IB_EALLOC;
+    }
+    p = (char *)(record + 1);
+    record->dn = memcpy(p, cfg->dn, dn_len);
+    p += dn_len;
+    record->full_path = memcpy(p, cfg->full_path, full_len);
+    p += full_len;
+    record->temp_path = memcpy(p, cfg->temp_path, temp_len);
+    p += temp_len;
+    if (line_len > 0) {
+        record->index = log->ctx->auditlog;
+        record->line = memcpy(p, line, line_len);
+    }
+    else {
+        record->index = NULL;
+        record->line = NULL;
+    }
+    record->line_len = line_len;
+    record->data = cfg->buf;
+    record->data_len = cfg->buf_len;
+    record->dmode = (mode_t)corecfg->auditlog_dmode;
+    record->fmode = (mode_t)corecfg->auditlog_fmode;
+    cfg->buf = NULL;
+
+    rc = core_audit_writer_submit(cfg->writer, record);
+    if (rc == IB_EAGAIN) {
+        ib_log_debug(log->ib,
+                     "Audit log queue full: dropped audit log %s.", cfg->fn);
+    }
+    else if (rc != IB_OK) {
+        ib_log_error(log->ib, "Failed to queue audit log %s.", cfg->fn);
+    }
+
+    return (rc == IB_OK) ? line_rc : rc;
+}
+
 ib_status_t core_audit_close(ib_provider_inst_t *lpi, ib_auditlog_t *log)
 {
     core_audit_cfg_t *cfg = (core_audit_cfg_t *)log->cfg_data;
@@ -667,6 +1445,12 @@ ib_status_t core_audit_close(ib_provider_inst_t *lpi, ib_auditlog_t *log)
         goto cleanup;
     }
 
+    /* Hand the log to the asynchronous writer. */
+    if (cfg->writer != NULL) {
+        ib_rc = core_audit_close_async(lpi, log, corecfg, line);
+        goto cleanup;
+    }
+
     /* Close the audit log. */
     if (cfg->fp != NULL) {
         fclose(cfg->fp);
@@ -700,9 +1484,9 @@ ib_status_t core_audit_close(ib_provider_inst_t *lpi, ib_auditlog_t *log)
             goto cleanup;
         }
 
-        sys_rc = fwrite(line, len, 1, cfg->index_fp);
+        sys_rc = fwrite(line, len + 1, 1, cfg->index_fp);
 
-        if (sys_rc < 0) {
+        if (sys_rc != 1) {
             sys_rc = errno;
             ib_log_error(log->ib,
                          "Could not write to audit log index: %s (%d)",
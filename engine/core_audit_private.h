@@ -27,6 +27,7 @@
 
 #include <ironbee/core.h>
 
+#include <stdbool.h>
 #include <stdio.h>
 
 /* -- Audit Provider -- */
@@ -49,6 +50,14 @@
 /* Forward define this structure. */
 typedef struct core_audit_cfg_t core_audit_cfg_t;
 
+/**
+ * Asynchronous audit log writer.
+ *
+ * Workers render each audit log into memory and queue it; a writer
+ * thread writes the queued logs in batches.
+ */
+typedef struct core_audit_writer_t core_audit_writer_t;
+
 /**
  * Core audit configuration structure
  */
@@ -61,6 +70,10 @@ struct core_audit_cfg_t {
     int             parts_written;  /**< Parts written so far */
     const char     *boundary;       /**< Audit log boundary */
     ib_tx_t        *tx;             /**< Transaction being logged */
+    core_audit_writer_t *writer;    /**< Asynchronous writer or NULL */
+    const char     *dn;             /**< Audit log directory (async) */
+    char           *buf;            /**< Memory stream buffer (async) */
+    size_t          buf_len;        /**< Length of buf (async) */
 };
 
 /**
@@ -129,6 +142,55 @@ ib_status_t core_audit_write_part(ib_provider_inst_t *lpi,
 ib_status_t core_audit_write_footer(ib_provider_inst_t *lpi,
                                     ib_auditlog_t *log);
 
+/**
+ * Close the audit log, and write its line to the index file.
+ *
+ * If @a log has an asynchronous writer, the log is queued for the writer
+ * instead.
+ *
+ * @param[in] lpi Log provider interface.
+ * @param[in] log The log record.
+ * @return IB_OK or other. See log file for details of failure.
+ */
 ib_status_t core_audit_close(ib_provider_inst_t *lpi, ib_auditlog_t *log);
 
+/**
+ * Create and start an asynchronous audit log writer.
+ *
+ * @param[in] ib IronBee engine
+ * @param[in] queue_size Number of queue slots (rounded up to a power of 2)
+ * @param[in] drop Drop logs when the queue is full, rather than block?
+ * @param[in] sync Sync each batch of logs to disk?
+ * @param[out] writer New writer
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC on allocation failure.
+ *   - IB_ENOTIMPL if the platform has no memory streams.
+ *   - IB_EUNKNOWN if the thread could not be started.
+ */
+ib_status_t core_audit_writer_create(ib_engine_t *ib,
+                                     size_t queue_size,
+                                     bool drop,
+                                     bool sync,
+                                     core_audit_writer_t **writer);
+
+/**
+ * Stop an asynchronous audit log writer, writing any queued logs first.
+ *
+ * No logs may be queued once this is called.
+ *
+ * @param[in] writer Writer to destroy
+ */
+void core_audit_writer_destroy(core_audit_writer_t *writer);
+
+/**
+ * Get the metrics of an asynchronous audit log writer.
+ *
+ * @param[in] writer Writer
+ * @param[out] stats Metrics
+ */
+void core_audit_writer_stats(const core_audit_writer_t *writer,
+                             ib_core_audit_stats_t *stats);
+
 #endif // _IB_CORE_AUDIT_PRIVATE_H_
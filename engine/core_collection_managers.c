@@ -35,11 +35,10 @@
 #include <ironbee/json.h>
 #include <ironbee/collection_manager.h>
 #include <ironbee/mpool.h>
+#include <ironbee/pcre_cache.h>
 #include <ironbee/string.h>
 #include <ironbee/util.h>
 
-#include <pcre.h>
-
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
@@ -49,7 +48,7 @@
 
 /** Name/value Pair static data */
 typedef struct {
-    const pcre                    *pattern;   /**< Compiled PCRE */
+    const ib_pcre_t               *pattern;   /**< Compiled PCRE */
     const ib_collection_manager_t *manager;   /**< The manager object */
 } core_vars_manager_t;
 static core_vars_manager_t core_vars_manager = { NULL, NULL };
@@ -132,9 +131,9 @@ static ib_status_t core_managed_collection_vars_register_fn(
         core_vars_t *vars;
         int pcre_rc;
 
-        pcre_rc = pcre_exec(core_vars_manager.pattern, NULL,
-                            param, strlen(param),
-                            0, 0, ovector, ovecsize);
+        pcre_rc = ib_pcre_exec(core_vars_manager.pattern,
+                               param, strlen(param),
+                               0, ovector, ovecsize);
         if (pcre_rc < 0) {
             return IB_DECLINED;
         }
@@ -563,9 +562,14 @@ ib_status_t ib_core_collection_managers_register(
     assert(module != NULL);
 
     const char *pattern = "^(\\w+)=(.*)$";
-    const int compile_flags = PCRE_DOTALL | PCRE_DOLLAR_ENDONLY;
-    pcre *compiled;
-    const char *error;
+    const ib_pcre_params_t params = {
+        PCRE_DOTALL | PCRE_DOLLAR_ENDONLY,  /* options */
+        true,                               /* study */
+        true,                               /* jit */
+        0, 0, 0, 0                          /* limits & JIT stack */
+    };
+    const ib_pcre_t *compiled;
+    const char *error = NULL;
     int eoff;
     ib_status_t rc;
     const ib_collection_manager_t *manager;
@@ -585,8 +589,9 @@ ib_status_t ib_core_collection_managers_register(
     }
 
     /* Compile the name/value pair pattern */
-    compiled = pcre_compile(pattern, compile_flags, &error, &eoff, NULL);
-    if (compiled == NULL) {
+    rc = ib_pcre_cache_compile(ib_engine_pcre_cache(ib), pattern, &params,
+                               &compiled, &error, &eoff);
+    if (rc != IB_OK) {
         ib_log_error(ib, "Failed to compile pattern \"%s\": %s", pattern,
                      error ? error : "(null)");
         return IB_EUNKNOWN;
@@ -620,9 +625,7 @@ ib_status_t ib_core_collection_managers_finish(
     assert(ib != NULL);
     assert(module != NULL);
 
-    if (core_vars_manager.pattern != NULL) {
-        pcre_free((void *)core_vars_manager.pattern);
-        core_vars_manager.pattern = NULL;
-    }
+    /* The pattern is owned by the engine's pattern cache */
+    core_vars_manager.pattern = NULL;
     return IB_OK;
 }
@@ -36,11 +36,13 @@
 
 #include <ironbee/context_selection.h>
 #include <ironbee/field.h>
+#include <ironbee/hash.h>
 #include <ironbee/mpool.h>
 #include <ironbee/string.h>
 #include <ironbee/util.h>
 
 #include <assert.h>
+#include <ctype.h>
 #include <inttypes.h>
 #include <unistd.h>
 
@@ -66,6 +68,14 @@
  *    allows the selection to avoid looking at the other fields in the
  *    structure.
  *
+ * 4. At finalize, the selectors are compiled into a core_ctxsel_index_t.  A
+ *    transaction's candidate selectors are found with one lookup of its host
+ *    name in a hash of full host names, and one walk of its reversed host
+ *    name through a radix tree of wildcard suffixes.  Each site's locations
+ *    are in a radix tree of paths.  Selection is then proportional to the
+ *    length of the host name and path rather than to the number of sites,
+ *    but still selects the first matching selector in configuration order.
+ *
  * Note that the code does not enforce that the last item in the lists be
  * a default; it is possible to create a configuration without a default site,
  * or with a default site in the middle of the list, or a default service /
@@ -73,12 +83,23 @@
  * do that.  If you do, the site selection will not do what you expect.
  */
 
+/** Radix tree node */
+typedef struct core_radix_node_t core_radix_node_t;
+struct core_radix_node_t {
+    const uint8_t         *label;        /**< Label of the edge to node */
+    size_t                 label_len;    /**< Length of label */
+    core_radix_node_t    **children;     /**< Children */
+    size_t                 num_children; /**< Number of children */
+    void                  *data;         /**< Data for key ending here */
+};
+
 /** Core context selection site structure */
 typedef struct core_site_t {
     ib_site_t              site;         /**< Site data */
     ib_list_t             *hosts;        /**< List of core_host_t* */
     ib_list_t             *services;     /**< List of core_service_t* */
     ib_list_t             *locations;    /**< List of core_location_t* */
+    core_radix_node_t     *location_tree;/**< Path -> core_location_t* */
 } core_site_t;
 
 /** Core context selection host name entity */
@@ -101,6 +122,7 @@ typedef struct core_location_t {
     ib_site_location_t     location;     /**< Site location data */
     size_t                 path_len;     /**< Length of path string */
     bool                   match_any;    /** Is this a 'match any' location? */
+    size_t                 order;        /**< Position in site's locations */
 } core_location_t;
 
 /** Core site selection data */
@@ -109,8 +131,31 @@ typedef struct core_site_selector_t {
     const core_service_t  *service;      /**< Service (IP/Port) */
     const ib_list_t       *hosts;        /**< List of core_host_t* */
     const ib_list_t       *locations;    /**< List of core_location_t* */
+    size_t                 order;        /**< Position in selector list */
 } core_site_selector_t;
 
+/** Selectors matching a host name key */
+typedef struct core_hits_t {
+    ib_list_t             *list;         /**< core_site_selector_t* (build) */
+    const core_site_selector_t **selectors; /**< Selectors, in order */
+    size_t                 num;          /**< Number of selectors */
+} core_hits_t;
+
+/** Compiled site selectors */
+struct core_ctxsel_index_t {
+    const core_site_selector_t **selectors; /**< All selectors, in order */
+    size_t                 num_selectors;/**< Number of selectors */
+    ib_hash_t             *exact_hosts;  /**< Host name -> core_hits_t* */
+    core_radix_node_t     *suffix_hosts; /**< Reversed suffix -> core_hits_t* */
+    core_hits_t           *any_host;     /**< Selectors matching any host */
+    ib_list_t             *all_hits;     /**< List of all core_hits_t* */
+};
+
+/**
+ * Host names up to this length are looked up without allocating.
+ */
+#define CORE_CTXSEL_HOST_MAX 256
+
 
 /**
  * Find the first 'match any' location for the given site
@@ -140,127 +185,709 @@ static const core_location_t *core_ctxsel_matchany_location(
 }
 
 /**
- * Check for a matching host within a host list
+ * Create a radix tree node.
  *
- * This function takes a list of hosts, and attempts to find the first
- * host that matches the transaction.  This function is intended to aid in
- * the development of context selection functions, but it's use is optional.
- * It is used by the core site selector.
+ * @param[in] mp Memory pool for allocations
+ * @param[in] label Edge label (not copied)
+ * @param[in] label_len Length of @a label
  *
- * @param[in] ib IronBee engine
- * @param[in] tx Transaction to match
- * @param[in] hosts List of ib_core_host_t
- * @param[out] match true if a match was found, else false
+ * @returns New node, or NULL on allocation failure
+ */
+static core_radix_node_t *core_radix_node_create(
+    ib_mpool_t *mp,
+    const uint8_t *label,
+    size_t label_len)
+{
+    assert(mp != NULL);
+
+    core_radix_node_t *node = ib_mpool_calloc(mp, 1, sizeof(*node));
+    if (node == NULL) {
+        return NULL;
+    }
+    node->label = label;
+    node->label_len = label_len;
+    return node;
+}
+
+/**
+ * Find the child of a radix tree node whose label starts with @a c.
+ *
+ * @param[in] node Parent node
+ * @param[in] c First byte of the child's label
  *
- * @returns IB_OK
+ * @returns Index of the child, or @a node->num_children if none
  */
-static ib_status_t core_ctxsel_match_host(
-    const ib_engine_t *ib,
+static size_t core_radix_child(
+    const core_radix_node_t *node,
+    uint8_t c)
+{
+    size_t n;
+
+    for (n = 0;  n < node->num_children;  ++n) {
+        if (node->children[n]->label[0] == c) {
+            break;
+        }
+    }
+    return n;
+}
+
+/**
+ * Find or create the radix tree node for a key.
+ *
+ * @param[in] mp Memory pool for allocations
+ * @param[in] root Root of the tree
+ * @param[in] key Key (copied)
+ * @param[in] len Length of @a key
+ * @param[out] pnode Node for @a key
+ *
+ * @returns IB_OK or IB_EALLOC
+ */
+static ib_status_t core_radix_insert(
+    ib_mpool_t *mp,
+    core_radix_node_t *root,
+    const uint8_t *key,
+    size_t len,
+    core_radix_node_t **pnode)
+{
+    assert(mp != NULL);
+    assert(root != NULL);
+    assert( (key != NULL) || (len == 0) );
+    assert(pnode != NULL);
+
+    core_radix_node_t *node = root;
+
+    while (len > 0) {
+        size_t n = core_radix_child(node, key[0]);
+        core_radix_node_t *child;
+        size_t common;
+
+        /* No child shares a prefix with the key: add a leaf. */
+        if (n == node->num_children) {
+            core_radix_node_t **children;
+            uint8_t *label;
+
+            label = ib_mpool_memdup(mp, key, len);
+            children = ib_mpool_alloc(mp, (n + 1) * sizeof(*children));
+            if ( (label == NULL) || (children == NULL) ) {
+                return IB_EALLOC;
+            }
+            child = core_radix_node_create(mp, label, len);
+            if (child == NULL) {
+                return IB_EALLOC;
+            }
+            if (n > 0) {
+                memcpy(children, node->children, n * sizeof(*children));
+            }
+            children[n] = child;
+            node->children = children;
+            node->num_children = n + 1;
+            *pnode = child;
+            return IB_OK;
+        }
+
+        child = node->children[n];
+        for (common = 1;
+             (common < child->label_len) && (common < len) &&
+                 (child->label[common] == key[common]);
+             ++common)
+        {
+            /* nop */
+        }
+
+        /* Split the child's edge where the key leaves it. */
+        if (common < child->label_len) {
+            core_radix_node_t *split;
+
+            split = core_radix_node_create(mp, child->label, common);
+            if (split == NULL) {
+                return IB_EALLOC;
+            }
+            split->children = ib_mpool_alloc(mp, sizeof(*split->children));
+            if (split->children == NULL) {
+                return IB_EALLOC;
+            }
+            split->children[0] = child;
+            split->num_children = 1;
+            child->label += common;
+            child->label_len -= common;
+            node->children[n] = split;
+            child = split;
+        }
+
+        node = child;
+        key += common;
+        len -= common;
+    }
+
+    *pnode = node;
+    return IB_OK;
+}
+
+/**
+ * Radix tree visitor function.
+ *
+ * @param[in] data Data of a node whose key is a prefix of the walked key
+ * @param[in] cbdata Callback data
+ */
+typedef void (*core_radix_visit_fn_t)(void *data, void *cbdata);
+
+/**
+ * Visit the data of every key in a radix tree which is a prefix of @a key.
+ *
+ * Keys are visited from shortest to longest.
+ *
+ * @param[in] root Root of the tree
+ * @param[in] key Key to walk
+ * @param[in] len Length of @a key
+ * @param[in] visit Function called with each key's data
+ * @param[in] cbdata Callback data for @a visit
+ */
+static void core_radix_walk(
+    const core_radix_node_t *root,
+    const uint8_t *key,
+    size_t len,
+    core_radix_visit_fn_t visit,
+    void *cbdata)
+{
+    assert(root != NULL);
+    assert( (key != NULL) || (len == 0) );
+    assert(visit != NULL);
+
+    const core_radix_node_t *node = root;
+
+    for (;;) {
+        const core_radix_node_t *child;
+        size_t n;
+
+        if (node->data != NULL) {
+            visit(node->data, cbdata);
+        }
+        if (len == 0) {
+            return;
+        }
+
+        n = core_radix_child(node, key[0]);
+        if (n == node->num_children) {
+            return;
+        }
+        child = node->children[n];
+        if ( (child->label_len > len) ||
+             (memcmp(child->label, key, child->label_len) != 0) )
+        {
+            return;
+        }
+        node = child;
+        key += child->label_len;
+        len -= child->label_len;
+    }
+}
+
+/**
+ * Check if a connection matches a selector's service
+ *
+ * @param[in] service Service (or NULL)
+ * @param[in] conn Connection to match
+ * @param[in] ip_len Length of @a conn's local IP address string
+ *
+ * @returns true if the service matches
+ */
+static bool core_ctxsel_match_service(
+    const core_service_t *service,
+    const ib_conn_t *conn,
+    size_t ip_len)
+{
+    assert(conn != NULL);
+
+    /*
+     * If there is no service or it's a "match any", match is automatic.
+     */
+    if ( (service == NULL) || service->match_any ) {
+        return true;
+    }
+
+    /* Check that the port matches the service (if specified) */
+    if ( (service->service.port >= 0) &&
+         (service->service.port != conn->local_port) ) {
+        return false;
+    }
+    /* Check that the host name matches the service (if specified) */
+    if ( (service->service.ipstr != NULL) &&
+         (service->ip_len == ip_len) &&
+         (strcmp(service->service.ipstr, conn->local_ipstr) != 0) )
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Location tree visitor: keep the first declared location.
+ *
+ * @param[in] data Location (core_location_t *)
+ * @param[in,out] cbdata Best location so far (const core_location_t **)
+ */
+static void core_ctxsel_visit_location(
+    void *data,
+    void *cbdata)
+{
+    const core_location_t *location = (const core_location_t *)data;
+    const core_location_t **best = (const core_location_t **)cbdata;
+
+    if ( (*best == NULL) || (location->order < (*best)->order) ) {
+        *best = location;
+    }
+}
+
+/**
+ * Find the first of a site's locations which matches a path
+ *
+ * A location matches if it is a "match any" location, or if its path is a
+ * prefix of @a path.
+ *
+ * @param[in] site Site
+ * @param[in] path Path to match
+ *
+ * @returns Matching location or NULL
+ */
+static const core_location_t *core_ctxsel_match_location(
+    const core_site_t *site,
+    const char *path)
+{
+    assert(site != NULL);
+    assert(path != NULL);
+
+    const core_location_t *location = NULL;
+
+    if (site->location_tree != NULL) {
+        core_radix_walk(site->location_tree,
+                        (const uint8_t *)path, strlen(path),
+                        core_ctxsel_visit_location, &location);
+    }
+    return location;
+}
+
+/**
+ * Host name candidates collected while walking the suffix tree.
+ */
+typedef struct {
+    const core_hits_t    **sets;         /**< Matching selector sets */
+    size_t                 num;          /**< Number of sets */
+} core_ctxsel_candidates_t;
+
+/**
+ * Suffix tree visitor: add the selectors of a matching suffix.
+ *
+ * @param[in] data Selectors (core_hits_t *)
+ * @param[in,out] cbdata Candidates (core_ctxsel_candidates_t *)
+ */
+static void core_ctxsel_visit_hits(
+    void *data,
+    void *cbdata)
+{
+    core_ctxsel_candidates_t *candidates = (core_ctxsel_candidates_t *)cbdata;
+
+    candidates->sets[candidates->num++] = (const core_hits_t *)data;
+}
+
+/**
+ * Select the site selector and location for a transaction.
+ *
+ * The candidate selectors are those which match the transaction's host name
+ * fully, by suffix, or match any host.  They are merged in selector order,
+ * and the first whose service and location match is selected.
+ *
+ * @param[in] index Compiled selectors
+ * @param[in] conn Connection
+ * @param[in] tx Transaction
+ * @param[in] ip_len Length of @a conn's local IP address string
+ * @param[out] pselector Matching selector (or NULL)
+ * @param[out] plocation Matching location (or NULL)
+ *
+ * @returns IB_OK or IB_EALLOC
+ */
+static ib_status_t core_ctxsel_select_tx(
+    const core_ctxsel_index_t *index,
+    const ib_conn_t *conn,
     const ib_tx_t *tx,
-    const ib_list_t *hosts,
-    bool *match)
+    size_t ip_len,
+    const core_site_selector_t **pselector,
+    const core_location_t **plocation)
 {
-    assert(ib != NULL);
+    assert(index != NULL);
+    assert(conn != NULL);
     assert(tx != NULL);
-    assert(match != NULL);
+    assert(pselector != NULL);
+    assert(plocation != NULL);
+
+    uint8_t key_buf[CORE_CTXSEL_HOST_MAX];
+    const core_hits_t *sets_buf[CORE_CTXSEL_HOST_MAX + 2];
+    size_t pos_buf[CORE_CTXSEL_HOST_MAX + 2];
+    uint8_t *key = key_buf;
+    size_t *pos = pos_buf;
+    core_ctxsel_candidates_t candidates = { sets_buf, 0 };
+    const core_hits_t *exact;
+    size_t len = strlen(tx->hostname);
+    size_t n;
+
+    *pselector = NULL;
+    *plocation = NULL;
+
+    /* The suffix tree can match up to one suffix per byte of the name. */
+    if (len > CORE_CTXSEL_HOST_MAX) {
+        key = ib_mpool_alloc(tx->mp, len);
+        candidates.sets = ib_mpool_alloc(tx->mp, (len + 2) * sizeof(*sets_buf));
+        pos = ib_mpool_alloc(tx->mp, (len + 2) * sizeof(*pos));
+        if ( (key == NULL) || (candidates.sets == NULL) || (pos == NULL) ) {
+            return IB_EALLOC;
+        }
+    }
 
-    const ib_list_node_t *node;
-    size_t len;
+    /* Collect the candidate selector sets */
+    if (ib_hash_get_ex(index->exact_hosts, &exact, tx->hostname, len) == IB_OK)
+    {
+        candidates.sets[candidates.num++] = exact;
+    }
+    for (n = 0;  n < len;  ++n) {
+        key[n] = tolower((unsigned char)tx->hostname[len - n - 1]);
+    }
+    core_radix_walk(index->suffix_hosts, key, len,
+                    core_ctxsel_visit_hits, &candidates);
+    if (index->any_host->num > 0) {
+        candidates.sets[candidates.num++] = index->any_host;
+    }
+    memset(pos, 0, candidates.num * sizeof(*pos));
+
+    /* Merge the candidates in selector order */
+    for (;;) {
+        const core_site_selector_t *selector = NULL;
+        const core_location_t *location;
+
+        for (n = 0;  n < candidates.num;  ++n) {
+            const core_hits_t *hits = candidates.sets[n];
+
+            if ( (pos[n] < hits->num) &&
+                 ( (selector == NULL) ||
+                   (hits->selectors[pos[n]]->order < selector->order) ) )
+            {
+                selector = hits->selectors[pos[n]];
+            }
+        }
+        if (selector == NULL) {
+            return IB_OK;
+        }
+        for (n = 0;  n < candidates.num;  ++n) {
+            const core_hits_t *hits = candidates.sets[n];
+
+            if ( (pos[n] < hits->num) &&
+                 (hits->selectors[pos[n]] == selector) )
+            {
+                ++pos[n];
+            }
+        }
 
-    /* If no hosts in the list, we have an automatic match */
-    if (hosts == NULL) {
-        *match = true;
+        if (! core_ctxsel_match_service(selector->service, conn, ip_len)) {
+            continue;
+        }
+        location = core_ctxsel_match_location(selector->site, tx->path);
+        if (location == NULL) {
+            continue;
+        }
+
+        *pselector = selector;
+        *plocation = location;
         return IB_OK;
     }
+}
+
+/**
+ * Create a set of selectors matching a host name key.
+ *
+ * @param[in] mp Memory pool for allocations
+ * @param[in,out] index Index to add the set to
+ * @param[out] phits New set
+ *
+ * @returns IB_OK or IB_EALLOC
+ */
+static ib_status_t core_ctxsel_hits_create(
+    ib_mpool_t *mp,
+    core_ctxsel_index_t *index,
+    core_hits_t **phits)
+{
+    assert(mp != NULL);
+    assert(index != NULL);
+    assert(phits != NULL);
+
+    core_hits_t *hits;
+    ib_status_t rc;
 
-    /* Now, loop through the list of hostnames */
-    len = strlen(tx->hostname);
-    IB_LIST_LOOP_CONST(hosts, node) {
+    hits = ib_mpool_calloc(mp, 1, sizeof(*hits));
+    if (hits == NULL) {
+        return IB_EALLOC;
+    }
+    rc = ib_list_create(&(hits->list), mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_list_push(index->all_hits, hits);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    *phits = hits;
+    return IB_OK;
+}
+
+/**
+ * Add a selector to a set of selectors.
+ *
+ * Selectors are added in order, so a selector with several hosts matching
+ * the same key is only added once.
+ *
+ * @param[in,out] hits Set of selectors
+ * @param[in] selector Selector to add
+ *
+ * @returns Status code
+ */
+static ib_status_t core_ctxsel_hits_add(
+    core_hits_t *hits,
+    const core_site_selector_t *selector)
+{
+    assert(hits != NULL);
+    assert(selector != NULL);
+
+    const ib_list_node_t *last = ib_list_last_const(hits->list);
+
+    if ( (last != NULL) && (last->data == selector) ) {
+        return IB_OK;
+    }
+    return ib_list_push(hits->list, (void *)selector);
+}
+
+/**
+ * Add a selector to the index for each of its site's hosts.
+ *
+ * @param[in] mp Memory pool for allocations
+ * @param[in,out] index Index
+ * @param[in] selector Selector to add
+ *
+ * @returns Status code
+ */
+static ib_status_t core_ctxsel_index_add(
+    ib_mpool_t *mp,
+    core_ctxsel_index_t *index,
+    const core_site_selector_t *selector)
+{
+    assert(mp != NULL);
+    assert(index != NULL);
+    assert(selector != NULL);
+
+    const ib_list_node_t *node;
+    ib_status_t rc;
+
+    /* No hosts: an automatic match */
+    if (selector->hosts == NULL) {
+        return core_ctxsel_hits_add(index->any_host, selector);
+    }
+
+    IB_LIST_LOOP_CONST(selector->hosts, node) {
         const core_host_t *core_host = (const core_host_t *)node->data;
         const ib_site_host_t *host = &(core_host->host);
+        core_hits_t *hits;
 
-        /* If this is a "match any" host entry? */
         if (core_host->match_any) {
-            *match = true;
-            return IB_OK;
+            rc = core_ctxsel_hits_add(index->any_host, selector);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            continue;
         }
 
-        /* Check the suffix */
-        if ( (host->suffix != NULL) && (len >= core_host->suffix_len) ) {
-            const char *suffix = tx->hostname + len - core_host->suffix_len;
-            if (strcasecmp(host->suffix, suffix) == 0) {
-                *match = true;
-                return IB_OK;
+        /* Full host name */
+        rc = ib_hash_get_ex(index->exact_hosts, &hits,
+                            host->hostname, core_host->hostname_len);
+        if (rc == IB_ENOENT) {
+            rc = core_ctxsel_hits_create(mp, index, &hits);
+            if (rc != IB_OK) {
+                return rc;
             }
+            rc = ib_hash_set_ex(index->exact_hosts,
+                                host->hostname, core_host->hostname_len,
+                                hits);
+        }
+        if (rc != IB_OK) {
+            return rc;
+        }
+        rc = core_ctxsel_hits_add(hits, selector);
+        if (rc != IB_OK) {
+            return rc;
         }
 
-        /* Finally, do a full hostname match */
-        if ( (core_host->hostname_len == len) &&
-             (strcasecmp(host->hostname, tx->hostname) == 0) )
-        {
-            *match = true;
-            return IB_OK;
+        /* Suffix, reversed and lower cased */
+        if (host->suffix != NULL) {
+            core_radix_node_t *tree_node;
+            uint8_t *key;
+            size_t n;
+
+            key = ib_mpool_alloc(mp, core_host->suffix_len + 1);
+            if (key == NULL) {
+                return IB_EALLOC;
+            }
+            for (n = 0;  n < core_host->suffix_len;  ++n) {
+                key[n] = tolower(
+                    (unsigned char)host->suffix[core_host->suffix_len - n - 1]);
+            }
+            rc = core_radix_insert(mp, index->suffix_hosts,
+                                   key, core_host->suffix_len, &tree_node);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            if (tree_node->data == NULL) {
+                rc = core_ctxsel_hits_create(mp, index, &hits);
+                if (rc != IB_OK) {
+                    return rc;
+                }
+                tree_node->data = hits;
+            }
+            rc = core_ctxsel_hits_add(tree_node->data, selector);
+            if (rc != IB_OK) {
+                return rc;
+            }
         }
     }
 
-    /* No matches */
-    *match = false;
     return IB_OK;
 }
 
 /**
- * Check for a matching location within a location list
+ * Build the location tree of a site.
  *
- * This function takes a list of locations, and attempts to find the first
- * location that matches the transaction.  This function is intended to aid in
- * the development of context selection functions, but it's use is optional.
- * It is used by the core site selector.
+ * "Match any" locations match every path, so are stored at the root.
  *
- * @param[in] ib IronBee engine
- * @param[in] tx Transaction to match
- * @param[in] locations List of ib_ctxsel_location_t
- * @param[out] match Pointer to matched location (or NULL)
+ * @param[in] mp Memory pool for allocations
+ * @param[in,out] site Site
  *
- * @returns IB_OK
+ * @returns IB_OK or IB_EALLOC
  */
-static ib_status_t core_ctxsel_match_location(
-    const ib_engine_t *ib,
-    const ib_tx_t *tx,
-    const ib_list_t *locations,
-    const core_location_t **match)
+static ib_status_t core_ctxsel_site_compile(
+    ib_mpool_t *mp,
+    core_site_t *site)
 {
-    assert(ib != NULL);
-    assert(tx != NULL);
-    assert(locations != NULL);
-    assert(match != NULL);
+    assert(mp != NULL);
+    assert(site != NULL);
 
     const ib_list_node_t *node;
-    size_t len;
-
-    /* Now, loop through the list of locations */
-    len = strlen(tx->path);
-    IB_LIST_LOOP_CONST(locations, node) {
-        const core_location_t *core_location =
-            (const core_location_t *)node->data;
-        const ib_site_location_t *location = &(core_location->location);
-
-        /* Is this a "match any" location? */
-        if (core_location->match_any) {
-            *match = core_location;
-            return IB_OK;
+    ib_status_t rc;
+
+    site->location_tree = core_radix_node_create(mp, NULL, 0);
+    if (site->location_tree == NULL) {
+        return IB_EALLOC;
+    }
+    if (site->locations == NULL) {
+        return IB_OK;
+    }
+
+    IB_LIST_LOOP_CONST(site->locations, node) {
+        const core_location_t *location = (const core_location_t *)node->data;
+        core_radix_node_t *tree_node;
+
+        if (location->match_any) {
+            tree_node = site->location_tree;
+        }
+        else {
+            rc = core_radix_insert(mp, site->location_tree,
+                                   (const uint8_t *)location->location.path,
+                                   location->path_len, &tree_node);
+            if (rc != IB_OK) {
+                return rc;
+            }
         }
 
-        /* Check the path */
-        if ( (core_location->path_len <= len) &&
-             (strncmp(location->path, tx->path, core_location->path_len) == 0) )
-        {
-            *match = core_location;
-            return IB_OK;
+        /* Keep the first location with a given path. */
+        if (tree_node->data == NULL) {
+            tree_node->data = (void *)location;
+        }
+    }
+
+    return IB_OK;
+}
+
+/**
+ * Compile the site selector list.
+ *
+ * @param[in] mp Memory pool for allocations
+ * @param[in] selector_list List of core_site_selector_t*
+ * @param[out] pindex New index
+ *
+ * @returns Status code
+ */
+static ib_status_t core_ctxsel_index_create(
+    ib_mpool_t *mp,
+    const ib_list_t *selector_list,
+    core_ctxsel_index_t **pindex)
+{
+    assert(mp != NULL);
+    assert(selector_list != NULL);
+    assert(pindex != NULL);
+
+    core_ctxsel_index_t *index;
+    const ib_list_node_t *node;
+    ib_status_t rc;
+
+    index = ib_mpool_calloc(mp, 1, sizeof(*index));
+    if (index == NULL) {
+        return IB_EALLOC;
+    }
+    index->num_selectors = ib_list_elements(selector_list);
+    index->selectors = ib_mpool_alloc(
+        mp, index->num_selectors * sizeof(*index->selectors));
+    index->suffix_hosts = core_radix_node_create(mp, NULL, 0);
+    if ( (index->selectors == NULL) || (index->suffix_hosts == NULL) ) {
+        return IB_EALLOC;
+    }
+    rc = ib_hash_create_nocase(&(index->exact_hosts), mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_list_create(&(index->all_hits), mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = core_ctxsel_hits_create(mp, index, &(index->any_host));
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    IB_LIST_LOOP_CONST(selector_list, node) {
+        const core_site_selector_t *selector =
+            (const core_site_selector_t *)node->data;
+
+        index->selectors[selector->order] = selector;
+        rc = core_ctxsel_index_add(mp, index, selector);
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    /* Flatten the selector sets into arrays */
+    IB_LIST_LOOP_CONST(index->all_hits, node) {
+        core_hits_t *hits = (core_hits_t *)node->data;
+        const ib_list_node_t *hit_node;
+        size_t n = 0;
+
+        hits->num = ib_list_elements(hits->list);
+        hits->selectors = ib_mpool_alloc(
+            mp, (hits->num + 1) * sizeof(*hits->selectors));
+        if (hits->selectors == NULL) {
+            return IB_EALLOC;
         }
+        IB_LIST_LOOP_CONST(hits->list, hit_node) {
+            hits->selectors[n++] = (const core_site_selector_t *)hit_node->data;
+        }
+        hits->list = NULL;
     }
 
-    /* No matches */
-    *match = NULL;
+    *pindex = index;
     return IB_OK;
 }
 
@@ -295,6 +922,7 @@ static ib_status_t core_create_site_selector(
     object->hosts = site->hosts;
     object->locations = site->locations;
     object->site = site;
+    object->order = ib_list_elements(core_data->selector_list);
 
     /* Add it to the site selector list */
     rc = ib_list_push(core_data->selector_list, object);
@@ -313,7 +941,8 @@ static ib_status_t core_create_site_selector(
  *
  * This functions creates the site selector list which is used during the site
  * selection process.  It walks through the list of sites / locations, and
- * creates corresponding site selector objects.
+ * creates corresponding site selector objects, then compiles them into the
+ * selector index.
  *
  * @param[in] ib IronBee engine
  * @param[in] common_cb_data Common callback data
@@ -339,6 +968,8 @@ static ib_status_t core_ctxsel_finalize(
         return IB_OK;
     }
 
+    core_data->selector_index = NULL;
+
     /* If there are no sites, do nothing */
     if (core_data->site_list == NULL) {
         ib_log_alert(ib, "No site list");
@@ -366,9 +997,15 @@ static ib_status_t core_ctxsel_finalize(
 
     /* Walk through all of the sites, and it's locations & services */
     IB_LIST_LOOP_CONST(core_data->site_list, site_node) {
-        const core_site_t *site = (const core_site_t *)site_node->data;
+        core_site_t *site = (core_site_t *)site_node->data;
         const ib_list_node_t *service_node;
 
+        /* Build the site's location tree */
+        rc = core_ctxsel_site_compile(ib->mp, site);
+        if (rc != IB_OK) {
+            return rc;
+        }
+
         /* If no services defined, just create a single selector with
          * a default service */
         if (site->services == NULL) {
@@ -391,6 +1028,15 @@ static ib_status_t core_ctxsel_finalize(
         }
     }
 
+    /* Compile the selector list */
+    rc = core_ctxsel_index_create(ib->mp, core_data->selector_list,
+                                  &(core_data->selector_index));
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to compile core site selectors: %s",
+                     ib_status_to_string(rc));
+        return rc;
+    }
+
     return IB_OK;
 }
 
@@ -419,8 +1065,14 @@ static ib_status_t core_ctxsel_select(
     assert(common_cb_data != NULL);
     assert(pctx != NULL);
 
-    const ib_list_node_t *node;
+    const core_ctxsel_index_t *index;
+    const core_site_selector_t *selector = NULL;
+    const core_location_t *location = NULL;
+    const core_site_t *site;
+    ib_context_t *ctx;
+    const char *ctx_type;
     size_t ip_len;
+    size_t n;
     ib_status_t rc;
     ib_core_module_data_t *core_data = (ib_core_module_data_t *)common_cb_data;
 
@@ -429,7 +1081,8 @@ static ib_status_t core_ctxsel_select(
         return IB_EINVAL;
     }
 
-    if (core_data->selector_list == NULL) {
+    index = core_data->selector_index;
+    if (index == NULL) {
         ib_log_alert(ib, "No site selection list: Using main context");
         goto select_main_context;
     }
@@ -437,80 +1090,41 @@ static ib_status_t core_ctxsel_select(
     /* Get the length of the IP address string before the main loop */
     ip_len = strlen(conn->local_ipstr);
 
-    /*
-     * Walk through the list of site selectors, return when the first matching
-     * selector is found.  At any point in the loop if a non-match is found,
-     * we continue to the top of the loop, and try the next selector.
-     */
-    IB_LIST_LOOP_CONST(core_data->selector_list, node) {
-        const core_site_selector_t *selector =
-            (const core_site_selector_t *)node->data;
-        const core_service_t *service = selector->service;
-        const core_site_t *site = selector->site;
-        const core_location_t *location;
-        ib_context_t *ctx;
-        const char *ctx_type;
-        bool match;
-
+    if (tx == NULL) {
         /*
-         * If there is no service or it's a "match any", match is automatic.
+         * If we're looking for a connection context, there is no hostname
+         * or location, so go with the first selector whose service matches.
          */
-        if ( (service != NULL) && (! service->match_any) ) {
-            /* Check that the port matches the service (if specified) */
-            if ( (service->service.port >= 0) &&
-                 (service->service.port != conn->local_port) ) {
-                continue;
-            }
-            /* Check that the host name matches the service (if specified) */
-            if ( (service->service.ipstr != NULL) &&
-                 (service->ip_len == ip_len) &&
-                 (strcmp(service->service.ipstr, conn->local_ipstr) != 0) )
+        for (n = 0;  n < index->num_selectors;  ++n) {
+            if (core_ctxsel_match_service(index->selectors[n]->service,
+                                          conn, ip_len))
             {
-                continue;
+                selector = index->selectors[n];
+                break;
             }
         }
-
-        /*
-         * If we're looking for a connection context, there is no hostname or
-         * location, so go with this selector.
-         */
-        if (tx == NULL) {
-            ctx = selector->site->site.context;
+        if (selector != NULL) {
+            site = selector->site;
+            ctx = site->site.context;
             ctx_type = "site";
             goto found;
         }
-
-        /* Check if the hostname matches */
-        rc = core_ctxsel_match_host(ib, tx, selector->hosts, &match);
-        if (rc != IB_OK) {
-            /* todo: What is the right thing to do here? */
-            continue;
-        }
-        if (! match) {
-            continue;
-        }
-
-        /* Check if the location matches */
-        rc = core_ctxsel_match_location(ib, tx, selector->locations, &location);
+    }
+    else {
+        rc = core_ctxsel_select_tx(index, conn, tx, ip_len,
+                                   &selector, &location);
         if (rc != IB_OK) {
-            /* todo: What is the right thing to do here? */
-            continue;
+            ib_log_error(ib, "Error selecting site for transaction: %s",
+                         ib_status_to_string(rc));
+            goto select_main_context;
         }
-        if (location == NULL) {
-            continue;
+        if (selector != NULL) {
+            /* Everything matches.  Use this selector's context */
+            site = selector->site;
+            ctx = location->location.context;
+            ctx_type = "location";
+            goto found;
         }
-
-        /* Everything matches.  Use this selector's context */
-        ctx = location->location.context;
-        ctx_type = "location";
-
-  found:
-        ib_log_debug2(ib, "Selected %s context %p \"%s\" site=%s(%s)",
-                      ctx_type, ctx, ib_context_full_get(ctx),
-                      (site ? site->site.id_str : "none"),
-                      (site ? site->site.name : "none"));
-        *pctx = ctx;
-        return IB_OK;
     }
 
     /*
@@ -532,6 +1146,13 @@ select_main_context:
     *pctx = ib_context_main(ib);
 
     return IB_OK;
+
+found:
+    ib_log_debug2(ib, "Selected %s context %p \"%s\" site=%s(%s)",
+                  ctx_type, ctx, ib_context_full_get(ctx),
+                  site->site.id_str, site->site.name);
+    *pctx = ctx;
+    return IB_OK;
 }
 
 /**
@@ -646,6 +1267,7 @@ static ib_status_t core_ctxsel_location_create(
     /* Fill in the context selection specific parts */
     core_location->path_len = strlen(location_str);
     core_location->match_any = (strcmp(location_str, "/") == 0);
+    core_location->order = ib_list_elements(core_site->locations);
 
     /* And, add it to the locations list */
     rc = ib_list_push(core_site->locations, core_location);
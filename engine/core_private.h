@@ -39,13 +39,22 @@ typedef struct {
     bool             default_value; /**< The flag's default value? */
 } ib_tx_flag_map_t;
 
+/** Compiled core site selectors (see core_context_selection.c) */
+typedef struct core_ctxsel_index_t core_ctxsel_index_t;
+
 /** Core-module-specific non-context-aware data accessed via module->data */
 typedef struct {
     ib_list_t            *site_list;      /**< List: ib_site_t */
     ib_list_t            *selector_list;  /**< List: core_site_selector_t */
+    core_ctxsel_index_t  *selector_index; /**< Compiled selector_list */
     ib_context_t         *cur_ctx;        /**< Current context */
     ib_site_t            *cur_site;       /**< Current site */
     ib_site_location_t   *cur_location;   /**< Current location */
+    bool                  audit_async;    /**< Use the audit log writer? */
+    size_t                audit_queue_size; /**< Writer queue size */
+    bool                  audit_drop;     /**< Drop logs if queue is full? */
+    bool                  audit_sync;     /**< Sync written logs? */
+    core_audit_writer_t  *audit_writer;   /**< Audit log writer or NULL */
 } ib_core_module_data_t;
 
 /**
@@ -176,6 +176,22 @@ static ib_status_t tfn_lowercase(ib_engine_t *ib,
     return rc;
 }
 
+/**
+ * Holdback function for transformations which work a byte at a time.
+ *
+ * @param[in] data Data
+ * @param[in] dlen Length of @a data
+ * @param[in] fndata Function specific data.
+ *
+ * @returns 0: no bytes need to be held back.
+ */
+static size_t tfn_holdback_none(const uint8_t *data,
+                                size_t dlen,
+                                void *fndata)
+{
+    return 0;
+}
+
 /**
  * Simple ASCII trim (left) transformation.
  *
@@ -779,6 +795,35 @@ static ib_status_t tfn_url_decode(ib_engine_t *ib,
     return IB_OK;
 }
 
+/**
+ * URL decode holdback function.
+ *
+ * A percent sign in the last two bytes may start an escape which is
+ * completed by the next chunk, so it and anything after it is held back.
+ * A percent sign is never part of an escape, so a held back percent sign
+ * can't change how the bytes before it are decoded.
+ *
+ * @param[in] data Data
+ * @param[in] dlen Length of @a data
+ * @param[in] fndata Function specific data.
+ *
+ * @returns Number of bytes to hold back
+ */
+static size_t tfn_url_decode_holdback(const uint8_t *data,
+                                      size_t dlen,
+                                      void *fndata)
+{
+    assert(data != NULL || dlen == 0);
+
+    if ( (dlen >= 2) && (data[dlen - 2] == '%') ) {
+        return 2;
+    }
+    if ( (dlen >= 1) && (data[dlen - 1] == '%') ) {
+        return 1;
+    }
+    return 0;
+}
+
 /**
  * HTML entity decode transformation
  *
@@ -1059,13 +1104,15 @@ ib_status_t ib_core_transformations_init(ib_engine_t *ib, ib_module_t *mod)
     ib_status_t rc;
 
     /* Define transformations. */
-    rc = ib_tfn_register(ib, "lowercase", tfn_lowercase,
-                         IB_TFN_FLAG_NONE, NULL);
+    rc = ib_tfn_register_ex(ib, "lowercase",
+                            tfn_lowercase, tfn_holdback_none,
+                            IB_TFN_FLAG_NONE, NULL);
     if (rc != IB_OK) {
         return rc;
     }
-    rc = ib_tfn_register(ib, "lc", tfn_lowercase,
-                         IB_TFN_FLAG_NONE, NULL);
+    rc = ib_tfn_register_ex(ib, "lc",
+                            tfn_lowercase, tfn_holdback_none,
+                            IB_TFN_FLAG_NONE, NULL);
     if (rc != IB_OK) {
         return rc;
     }
@@ -1088,8 +1135,9 @@ ib_status_t ib_core_transformations_init(ib_engine_t *ib, ib_module_t *mod)
         return rc;
     }
 
-    rc = ib_tfn_register(ib, "removeWhitespace", tfn_wspc_remove,
-                         IB_TFN_FLAG_NONE, NULL);
+    rc = ib_tfn_register_ex(ib, "removeWhitespace",
+                            tfn_wspc_remove, tfn_holdback_none,
+                            IB_TFN_FLAG_NONE, NULL);
     if (rc != IB_OK) {
         return rc;
     }
@@ -1124,8 +1172,9 @@ ib_status_t ib_core_transformations_init(ib_engine_t *ib, ib_module_t *mod)
         return rc;
     }
 
-    rc = ib_tfn_register(ib, "urlDecode", tfn_url_decode,
-                         IB_TFN_FLAG_NONE, NULL);
+    rc = ib_tfn_register_ex(ib, "urlDecode",
+                            tfn_url_decode, tfn_url_decode_holdback,
+                            IB_TFN_FLAG_NONE, NULL);
     if (rc != IB_OK) {
         return rc;
     }
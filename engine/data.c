@@ -32,14 +32,14 @@
 #include <ironbee/expand.h>
 #include <ironbee/field.h>
 #include <ironbee/mpool.h>
+#include <ironbee/pcre_cache.h>
 #include <ironbee/provider.h>
 #include <ironbee/string.h>
 #include <ironbee/transformation.h>
 #include <ironbee/util.h>
 
-#include <pcre.h>
-
 #include <assert.h>
+#include <ctype.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -62,10 +62,290 @@ struct ib_data_t
 {
     ib_mpool_t *mp;    /**< Memory pool. */
     ib_hash_t  *hash;  /**< Hash of data fields. */
+    const ib_data_filter_cache_t *filters; /**< Compiled filters or NULL. */
+    size_t      generation; /**< Bumped when a top level field is set. */
+    /** Core fields by ID; the same fields as in @c hash. */
+    ib_field_t *core[IB_DATA_FIELD_ID_COUNT];
+};
+
+/** A core field name. */
+typedef struct {
+    const char *name;  /**< Name. */
+    size_t      nlen;  /**< Length of @c name. */
+} ib_data_core_name_t;
+
+/** Define the name of core field ID @a id. */
+#define IB_DATA_CORE_NAME(id, name) \
+    [IB_DATA_FIELD_ID_ ## id] = { name, sizeof(name) - 1 }
+
+/** Core field names by ID. */
+static const ib_data_core_name_t ib_data_core_names[] = {
+    IB_DATA_CORE_NAME(ARGS,                  "ARGS"),
+    IB_DATA_CORE_NAME(FLAGS,                 "FLAGS"),
+    IB_DATA_CORE_NAME(FIELD,                 "FIELD"),
+    IB_DATA_CORE_NAME(FIELD_TFN,             "FIELD_TFN"),
+    IB_DATA_CORE_NAME(FIELD_TARGET,          "FIELD_TARGET"),
+    IB_DATA_CORE_NAME(FIELD_NAME,            "FIELD_NAME"),
+    IB_DATA_CORE_NAME(FIELD_NAME_FULL,       "FIELD_NAME_FULL"),
+    IB_DATA_CORE_NAME(REQUEST_LINE,          "request_line"),
+    IB_DATA_CORE_NAME(REQUEST_METHOD,        "request_method"),
+    IB_DATA_CORE_NAME(REQUEST_PROTOCOL,      "request_protocol"),
+    IB_DATA_CORE_NAME(REQUEST_URI,           "request_uri"),
+    IB_DATA_CORE_NAME(REQUEST_URI_RAW,       "request_uri_raw"),
+    IB_DATA_CORE_NAME(REQUEST_URI_SCHEME,    "request_uri_scheme"),
+    IB_DATA_CORE_NAME(REQUEST_URI_USERNAME,  "request_uri_username"),
+    IB_DATA_CORE_NAME(REQUEST_URI_PASSWORD,  "request_uri_password"),
+    IB_DATA_CORE_NAME(REQUEST_URI_HOST,      "request_uri_host"),
+    IB_DATA_CORE_NAME(REQUEST_HOST,          "request_host"),
+    IB_DATA_CORE_NAME(REQUEST_URI_PORT,      "request_uri_port"),
+    IB_DATA_CORE_NAME(REQUEST_URI_PATH,      "request_uri_path"),
+    IB_DATA_CORE_NAME(REQUEST_URI_QUERY,     "request_uri_query"),
+    IB_DATA_CORE_NAME(REQUEST_URI_FRAGMENT,  "request_uri_fragment"),
+    IB_DATA_CORE_NAME(REQUEST_CONTENT_TYPE,  "request_content_type"),
+    IB_DATA_CORE_NAME(REQUEST_FILENAME,      "request_filename"),
+    IB_DATA_CORE_NAME(AUTH_TYPE,             "auth_type"),
+    IB_DATA_CORE_NAME(AUTH_USERNAME,         "auth_username"),
+    IB_DATA_CORE_NAME(AUTH_PASSWORD,         "auth_password"),
+    IB_DATA_CORE_NAME(REQUEST_HEADERS,       "request_headers"),
+    IB_DATA_CORE_NAME(REQUEST_COOKIES,       "request_cookies"),
+    IB_DATA_CORE_NAME(REQUEST_URI_PARAMS,    "request_uri_params"),
+    IB_DATA_CORE_NAME(REQUEST_BODY_PARAMS,   "request_body_params"),
+    IB_DATA_CORE_NAME(REQUEST_BODY,          "request_body"),
+    IB_DATA_CORE_NAME(RESPONSE_LINE,         "response_line"),
+    IB_DATA_CORE_NAME(RESPONSE_PROTOCOL,     "response_protocol"),
+    IB_DATA_CORE_NAME(RESPONSE_STATUS,       "response_status"),
+    IB_DATA_CORE_NAME(RESPONSE_MESSAGE,      "response_message"),
+    IB_DATA_CORE_NAME(RESPONSE_CONTENT_TYPE, "response_content_type"),
+    IB_DATA_CORE_NAME(RESPONSE_HEADERS,      "response_headers"),
+    IB_DATA_CORE_NAME(RESPONSE_COOKIES,      "response_cookies"),
+    IB_DATA_CORE_NAME(RESPONSE_BODY,         "response_body"),
+    IB_DATA_CORE_NAME(SERVER_ADDR,           "server_addr"),
+    IB_DATA_CORE_NAME(SERVER_PORT,           "server_port"),
+    IB_DATA_CORE_NAME(REMOTE_ADDR,           "remote_addr"),
+    IB_DATA_CORE_NAME(REMOTE_PORT,           "remote_port"),
+};
+
+/** Length of the longest core field name. */
+#define IB_DATA_CORE_NAME_MAX 21
+
+/** Most core field names of the same length. */
+#define IB_DATA_CORE_BUCKET_MAX 8
+
+/** Core field IDs whose names have the same length. */
+typedef struct {
+    size_t             num;                          /**< Number of IDs. */
+    ib_data_field_id_t ids[IB_DATA_CORE_BUCKET_MAX]; /**< IDs. */
+} ib_data_core_bucket_t;
+
+/** Define the core field IDs, @a ..., whose names have length @a len. */
+#define IB_DATA_CORE_BUCKET(len, ...)                  \
+    [len] = {                                          \
+        sizeof((ib_data_field_id_t[]){ __VA_ARGS__ }) / \
+            sizeof(ib_data_field_id_t),                \
+        { __VA_ARGS__ }                                \
+    }
+
+/**
+ * Core field IDs by name length.
+ *
+ * Must list every ID of ib_data_core_names under the length of its name.
+ */
+static const ib_data_core_bucket_t
+ib_data_core_buckets[IB_DATA_CORE_NAME_MAX + 1] = {
+    IB_DATA_CORE_BUCKET(4,
+        IB_DATA_FIELD_ID_ARGS),
+    IB_DATA_CORE_BUCKET(5,
+        IB_DATA_FIELD_ID_FLAGS,
+        IB_DATA_FIELD_ID_FIELD),
+    IB_DATA_CORE_BUCKET(9,
+        IB_DATA_FIELD_ID_FIELD_TFN,
+        IB_DATA_FIELD_ID_AUTH_TYPE),
+    IB_DATA_CORE_BUCKET(10,
+        IB_DATA_FIELD_ID_FIELD_NAME),
+    IB_DATA_CORE_BUCKET(11,
+        IB_DATA_FIELD_ID_REQUEST_URI,
+        IB_DATA_FIELD_ID_SERVER_ADDR,
+        IB_DATA_FIELD_ID_SERVER_PORT,
+        IB_DATA_FIELD_ID_REMOTE_ADDR,
+        IB_DATA_FIELD_ID_REMOTE_PORT),
+    IB_DATA_CORE_BUCKET(12,
+        IB_DATA_FIELD_ID_FIELD_TARGET,
+        IB_DATA_FIELD_ID_REQUEST_LINE,
+        IB_DATA_FIELD_ID_REQUEST_HOST,
+        IB_DATA_FIELD_ID_REQUEST_BODY),
+    IB_DATA_CORE_BUCKET(13,
+        IB_DATA_FIELD_ID_AUTH_USERNAME,
+        IB_DATA_FIELD_ID_AUTH_PASSWORD,
+        IB_DATA_FIELD_ID_RESPONSE_LINE,
+        IB_DATA_FIELD_ID_RESPONSE_BODY),
+    IB_DATA_CORE_BUCKET(14,
+        IB_DATA_FIELD_ID_REQUEST_METHOD),
+    IB_DATA_CORE_BUCKET(15,
+        IB_DATA_FIELD_ID_FIELD_NAME_FULL,
+        IB_DATA_FIELD_ID_REQUEST_URI_RAW,
+        IB_DATA_FIELD_ID_REQUEST_HEADERS,
+        IB_DATA_FIELD_ID_REQUEST_COOKIES,
+        IB_DATA_FIELD_ID_RESPONSE_STATUS),
+    IB_DATA_CORE_BUCKET(16,
+        IB_DATA_FIELD_ID_REQUEST_PROTOCOL,
+        IB_DATA_FIELD_ID_REQUEST_URI_HOST,
+        IB_DATA_FIELD_ID_REQUEST_URI_PORT,
+        IB_DATA_FIELD_ID_REQUEST_URI_PATH,
+        IB_DATA_FIELD_ID_REQUEST_FILENAME,
+        IB_DATA_FIELD_ID_RESPONSE_MESSAGE,
+        IB_DATA_FIELD_ID_RESPONSE_HEADERS,
+        IB_DATA_FIELD_ID_RESPONSE_COOKIES),
+    IB_DATA_CORE_BUCKET(17,
+        IB_DATA_FIELD_ID_REQUEST_URI_QUERY,
+        IB_DATA_FIELD_ID_RESPONSE_PROTOCOL),
+    IB_DATA_CORE_BUCKET(18,
+        IB_DATA_FIELD_ID_REQUEST_URI_SCHEME,
+        IB_DATA_FIELD_ID_REQUEST_URI_PARAMS),
+    IB_DATA_CORE_BUCKET(19,
+        IB_DATA_FIELD_ID_REQUEST_BODY_PARAMS),
+    IB_DATA_CORE_BUCKET(20,
+        IB_DATA_FIELD_ID_REQUEST_URI_USERNAME,
+        IB_DATA_FIELD_ID_REQUEST_URI_PASSWORD,
+        IB_DATA_FIELD_ID_REQUEST_URI_FRAGMENT,
+        IB_DATA_FIELD_ID_REQUEST_CONTENT_TYPE),
+    IB_DATA_CORE_BUCKET(21,
+        IB_DATA_FIELD_ID_RESPONSE_CONTENT_TYPE),
+};
+
+struct ib_data_filter_cache_t
+{
+    ib_mpool_t      *mp;    /**< Memory pool. */
+    ib_hash_t       *hash;  /**< Hash of ib_pcre_t by filter pattern. */
+    ib_pcre_cache_t *pcre;  /**< Shared pattern cache. */
+};
+
+/** Compile parameters of list filter patterns. */
+static const ib_pcre_params_t ib_data_filter_params = {
+    0,      /* options */
+    true,   /* study */
+    true,   /* jit */
+    0,      /* match_limit */
+    0,      /* match_limit_recursion */
+    0,      /* jit_stack_start */
+    0       /* jit_stack_max */
 };
 
 /* Internal helper functions */
 
+/**
+ * Locate the regex pattern of a list filter expression (FOO:/pattern/).
+ *
+ * @param[in] name Name as byte string.
+ * @param[in] name_len Length of @a name.
+ * @param[out] pattern Start of the pattern inside @a name.
+ * @param[out] pattern_len Length of @a pattern.
+ *
+ * @returns
+ *  - IB_OK if @a name is a valid pattern filter expression.
+ *  - IB_ENOENT if @a name has no pattern filter.
+ *  - IB_EINVAL if the pattern filter is malformed.
+ */
+static
+ib_status_t ib_data_filter_pattern(
+    const char   *name,
+    size_t        name_len,
+    const char  **pattern,
+    size_t       *pattern_len
+)
+{
+    assert(name != NULL);
+    assert(pattern != NULL);
+    assert(pattern_len != NULL);
+
+    const char *filter_marker = memchr(name, DPI_LIST_FILTER_MARKER, name_len);
+    const char *filter_start;
+    const char *filter_end = NULL;
+
+    if (filter_marker == NULL) {
+        return IB_ENOENT;
+    }
+
+    filter_start = memchr(name, DPI_LIST_FILTER_PREFIX, name_len);
+    if ( filter_start && filter_start + 1 < name + name_len ) {
+        filter_end = memchr(filter_start+1,
+                            DPI_LIST_FILTER_SUFFIX,
+                            name_len - (filter_start+1-name));
+    }
+    if ( (filter_start == NULL) || (filter_end == NULL) ) {
+        return IB_ENOENT;
+    }
+
+    /* Bad filter: FOO/: */
+    if (filter_marker != filter_start-1) {
+        return IB_EINVAL;
+    }
+
+    /* Bad filter: FOO:// */
+    if (filter_start == filter_end-1) {
+        return IB_EINVAL;
+    }
+
+    *pattern = filter_start + 1;
+    *pattern_len = filter_end - filter_start - 1;
+    return IB_OK;
+}
+
+/**
+ * Compile a list filter pattern.
+ *
+ * @param[in] mp Memory pool for the compiled pattern if it is not cached.
+ * @param[in] pcre Pattern cache to compile into (or NULL).  If NULL, the
+ *                 pattern is for a single lookup and is not JIT compiled.
+ * @param[in] pattern The regex pattern.
+ * @param[in] pattern_len The length of @a pattern.
+ * @param[out] cpatt The compiled pattern.
+ *
+ * @returns
+ *  - IB_OK on success.
+ *  - IB_EALLOC on allocation failure.
+ *  - IB_EINVAL if the pattern cannot compile.
+ */
+static
+ib_status_t ib_data_filter_compile(
+    ib_mpool_t       *mp,
+    ib_pcre_cache_t  *pcre,
+    const char       *pattern,
+    size_t            pattern_len,
+    const ib_pcre_t **cpatt
+)
+{
+    assert(mp != NULL);
+    assert(pattern != NULL);
+    assert(cpatt != NULL);
+
+    char *pattern_str; /* NULL terminated string to pass to pcre. */
+    ib_status_t rc;
+
+    /* Build a string to hand to the pcre library. */
+    pattern_str = (char *)malloc(pattern_len+1);
+    if (pattern_str == NULL) {
+        return IB_EALLOC;
+    }
+    memcpy(pattern_str, pattern, pattern_len);
+    pattern_str[pattern_len] = '\0';
+
+    /* The cache declines new patterns once configuration is finished. */
+    rc = IB_DECLINED;
+    if (pcre != NULL) {
+        rc = ib_pcre_cache_compile(pcre, pattern_str, &ib_data_filter_params,
+                                   cpatt, NULL, NULL);
+    }
+    if (rc == IB_DECLINED) {
+        rc = ib_pcre_compile(mp,
+                             (pcre != NULL) && ib_pcre_cache_jit_enabled(pcre),
+                             pattern_str, &ib_data_filter_params,
+                             cpatt, NULL, NULL);
+    }
+    free(pattern_str);
+
+    return rc;
+}
+
 /**
  * Get a subfield from @a data.
  *
@@ -205,10 +485,8 @@ ib_status_t ib_data_get_filtered_list(
     assert(result_field != NULL);
 
     ib_status_t rc;
-    char *pattern_str = NULL; /* NULL terminated string to pass to pcre. */
-    pcre *pcre_pattern = NULL; /* PCRE pattern. */
-    const char *errptr = NULL; /* PCRE Error reporter. */
-    int erroffset; /* PCRE Error offset into subject reporter. */
+    const ib_pcre_t *filter = NULL; /* Compiled pattern. */
+    ib_mpool_t *local_mp = NULL; /* Pool of a pattern compiled for this call */
     ib_list_t *list = NULL; /* Holds the value of field when fetched. */
     ib_list_node_t *list_node = NULL; /* A node in list. */
     ib_list_t *result_list = NULL; /* Holds matched list_node values. */
@@ -219,30 +497,28 @@ ib_status_t ib_data_get_filtered_list(
         goto exit_label;
     }
 
-    /* Allocate pattern_str to hold null terminated string. */
-    pattern_str = (char *)malloc(pattern_len+1);
-    if (pattern_str == NULL) {
-        rc = IB_EALLOC;
-        goto exit_label;
-    }
-
-    /* Build a string to hand to the pcre library. */
-    memcpy(pattern_str, pattern, pattern_len);
-    pattern_str[pattern_len] = '\0';
-
     rc = ib_field_value(parent_field, &list);
     if (rc != IB_OK) {
         goto exit_label;
     }
 
-    pcre_pattern = pcre_compile(pattern_str, 0, &errptr, &erroffset, NULL);
-    if (pcre_pattern == NULL) {
-        rc = IB_EINVAL;
-        goto exit_label;
+    /* Use the pre-compiled pattern if there is one, otherwise compile it
+     * for this call only.  Patterns seen at runtime may come from anywhere,
+     * so they are not added to the engine wide cache. */
+    if (data->filters != NULL) {
+        rc = ib_hash_get_ex(data->filters->hash, &filter,
+                            pattern, pattern_len);
     }
-    if (errptr) {
-        rc = IB_EINVAL;
-        goto exit_label;
+    if (filter == NULL) {
+        rc = ib_mpool_create(&local_mp, "data filter", data->mp);
+        if (rc != IB_OK) {
+            goto exit_label;
+        }
+        rc = ib_data_filter_compile(local_mp, NULL,
+                                    pattern, pattern_len, &filter);
+        if (rc != IB_OK) {
+            goto exit_label;
+        }
     }
 
     rc = ib_list_create(&result_list, data->mp);
@@ -253,14 +529,12 @@ ib_status_t ib_data_get_filtered_list(
     IB_LIST_LOOP(list, list_node) {
         int pcre_rc;
         ib_field_t *list_field = (ib_field_t *)list_node->data;
-        pcre_rc = pcre_exec(pcre_pattern,
-                            NULL,
-                            list_field->name,
-                            list_field->nlen,
-                            0,
-                            0,
-                            NULL,
-                            0);
+        pcre_rc = ib_pcre_exec(filter,
+                               list_field->name,
+                               list_field->nlen,
+                               0,
+                               NULL,
+                               0);
 
         if (pcre_rc == 0) {
             rc = ib_list_push(result_list, list_node->data);
@@ -279,15 +553,106 @@ ib_status_t ib_data_get_filtered_list(
 
 
 exit_label:
-    if (pattern_str) {
-        free(pattern_str);
+    if (local_mp != NULL) {
+        ib_mpool_destroy(local_mp);
+    }
+    return rc;
+}
+
+/**
+ * Look up the ID of exactly @a name, without any list filter.
+ *
+ * @param[in] name Name.
+ * @param[in] nlen Length of @a name.
+ *
+ * @returns ID of @a name, or IB_DATA_FIELD_ID_NONE if it is not the name
+ *          of a core field.
+ */
+static
+ib_data_field_id_t ib_data_core_id(
+    const char *name,
+    size_t      nlen
+)
+{
+    assert(name != NULL);
+
+    const ib_data_core_bucket_t *bucket;
+    size_t                       n;
+
+    if ( (nlen == 0) || (nlen > IB_DATA_CORE_NAME_MAX) ) {
+        return IB_DATA_FIELD_ID_NONE;
+    }
+
+    /* Names of the same length mostly differ at the end. */
+    bucket = &ib_data_core_buckets[nlen];
+    for (n = 0; n < bucket->num; ++n) {
+        const char *core_name = ib_data_core_names[bucket->ids[n]].name;
+
+        if ( (tolower(core_name[nlen - 1]) == tolower(name[nlen - 1])) &&
+             (strncasecmp(core_name, name, nlen) == 0) )
+        {
+            return bucket->ids[n];
+        }
     }
-    if (pcre_pattern) {
-        pcre_free(pcre_pattern);
+
+    return IB_DATA_FIELD_ID_NONE;
+}
+
+/**
+ * Set a top level field, keeping the core field slots in step.
+ *
+ * @param[in] data Data.
+ * @param[in] id ID of @a name, or IB_DATA_FIELD_ID_NONE if it has none.
+ * @param[in] name Name.
+ * @param[in] nlen Length of @a name.
+ * @param[in] f Field, or NULL to remove the field.
+ *
+ * @returns Status code of ib_hash_set_ex().
+ */
+static
+ib_status_t ib_data_set_top_id(
+    ib_data_t          *data,
+    ib_data_field_id_t  id,
+    const char         *name,
+    size_t              nlen,
+    ib_field_t         *f
+)
+{
+    assert(data != NULL);
+    assert(name != NULL);
+
+    ib_status_t rc;
+
+    rc = ib_hash_set_ex(data->hash, name, nlen, f);
+    if ( (rc == IB_OK) && (id != IB_DATA_FIELD_ID_NONE) ) {
+        data->core[id] = f;
     }
+
     return rc;
 }
 
+/**
+ * Set a top level field, keeping the core field slots in step.
+ *
+ * @param[in] data Data.
+ * @param[in] name Name.
+ * @param[in] nlen Length of @a name.
+ * @param[in] f Field, or NULL to remove the field.
+ *
+ * @returns Status code of ib_hash_set_ex().
+ */
+static
+ib_status_t ib_data_set_top(
+    ib_data_t  *data,
+    const char *name,
+    size_t      nlen,
+    ib_field_t *f
+)
+{
+    return ib_data_set_top_id(data, ib_data_core_id(name, nlen),
+                              name, nlen, f);
+}
+
 /**
  * Add a field to the @a data allowing for subfield notation.
  *
@@ -382,12 +747,89 @@ ib_status_t ib_data_add_internal(
 
     /* Normal add. */
     else {
-        return ib_hash_set_ex(data->hash, name, nlen, field);
+        ++data->generation;
+        return ib_data_set_top(data, name, nlen, field);
     }
 
     return IB_OK;
 }
 
+/**
+ * Get a subfield or the filtered members of a list.
+ *
+ * @param[in] data Data.
+ * @param[in] parent_field The field before the filter marker.
+ * @param[in] name Full name, e.g. @c ARGS:foo or @c ARGS:/^foo/
+ * @param[in] name_len Length of @a name.
+ * @param[in] filter_marker The filter marker in @a name.
+ * @param[out] pf Result.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EINVAL if the filter is malformed.
+ *   - Other as ib_data_get_filtered_list() and ib_data_get_subfields().
+ */
+static
+ib_status_t ib_data_get_child(
+    const ib_data_t  *data,
+    ib_field_t       *parent_field,
+    const char       *name,
+    size_t            name_len,
+    const char       *filter_marker,
+    ib_field_t      **pf
+)
+{
+    const char *filter_start = memchr(name, DPI_LIST_FILTER_PREFIX, name_len);
+    const char *filter_end;
+
+    if ( filter_start && filter_start + 1 < name + name_len ) {
+        filter_end = memchr(filter_start+1,
+                            DPI_LIST_FILTER_SUFFIX,
+                            name_len - (filter_start+1-name));
+    }
+    else {
+        filter_end = NULL;
+    }
+
+    /* Does the expansions use a pattern match or not? */
+    if (filter_start && filter_end) {
+
+        /* Bad filter: FOO/: */
+        if (filter_marker != filter_start-1) {
+            return IB_EINVAL;
+        }
+
+        /* Bad filter: FOO:/ */
+        if (filter_start == filter_end) {
+            return IB_EINVAL;
+        }
+
+        /* Bad filter: FOO:// */
+        if (filter_start == filter_end-1) {
+            return IB_EINVAL;
+        }
+
+        /* Validated that filter_start and filter_end are sane. */
+        return ib_data_get_filtered_list(
+            data,
+            parent_field,
+            filter_start+1,
+            filter_end - filter_start - 1,
+            pf
+        );
+    }
+
+    /* No pattern match. Just extract the sub-field. */
+    /* Handle extracting a subfield for a list of a dynamic field. */
+    return ib_data_get_subfields(
+        data,
+        parent_field,
+        filter_marker+1,
+        name_len - (filter_marker+1-name),
+        pf
+    );
+}
+
 static
 ib_status_t expand_lookup_fn(
     const void  *raw_data,
@@ -407,6 +849,52 @@ ib_status_t expand_lookup_fn(
     return rc;
 }
 
+/**
+ * Resolve a name of an expansion template to a field ID.
+ *
+ * @param[in] name Name.
+ * @param[in] nlen Length of @a name.
+ *
+ * @returns Field ID of @a name.
+ */
+static
+int expand_resolve_fn(
+    const char *name,
+    size_t      nlen
+)
+{
+    return ib_data_field_id(name, nlen);
+}
+
+/**
+ * Lookup function for expansion templates.
+ *
+ * @param[in] raw_data Data.
+ * @param[in] id Field ID of @a name.
+ * @param[in] name Name.
+ * @param[in] nlen Length of @a name.
+ * @param[out] pf Field.
+ *
+ * @returns Status code of ib_data_get_id().
+ */
+static
+ib_status_t expand_template_lookup_fn(
+    const void  *raw_data,
+    int          id,
+    const char  *name,
+    size_t       nlen,
+    ib_field_t **pf
+)
+{
+    assert(raw_data != NULL);
+    assert(name != NULL);
+    assert(pf != NULL);
+
+    const ib_data_t *data = (const ib_data_t *)raw_data;
+
+    return ib_data_get_id(data, (ib_data_field_id_t)id, name, nlen, pf);
+}
+
 /* -- Exported Data Access Routines -- */
 
 ib_status_t ib_data_create(
@@ -434,6 +922,87 @@ ib_status_t ib_data_create(
     return IB_OK;
 }
 
+void ib_data_set_filter_cache(
+    ib_data_t                    *data,
+    const ib_data_filter_cache_t *cache
+)
+{
+    assert(data != NULL);
+
+    data->filters = cache;
+}
+
+ib_status_t ib_data_filter_cache_create(
+    ib_mpool_t              *mp,
+    ib_pcre_cache_t         *pcre,
+    ib_data_filter_cache_t **cache
+)
+{
+    assert(mp != NULL);
+    assert(pcre != NULL);
+    assert(cache != NULL);
+
+    ib_status_t rc;
+
+    *cache = ib_mpool_calloc(mp, 1, sizeof(**cache));
+    if (*cache == NULL) {
+        return IB_EALLOC;
+    }
+
+    (*cache)->mp = mp;
+    (*cache)->pcre = pcre;
+    rc = ib_hash_create(&(*cache)->hash, mp);
+    if (rc != IB_OK) {
+        *cache = NULL;
+        return rc;
+    }
+
+    return IB_OK;
+}
+
+ib_status_t ib_data_filter_cache_add(
+    ib_data_filter_cache_t *cache,
+    const char             *name,
+    size_t                  nlen
+)
+{
+    assert(cache != NULL);
+    assert(name != NULL);
+
+    ib_status_t       rc;
+    const char       *pattern;
+    size_t            pattern_len;
+    const ib_pcre_t  *filter;
+    char             *key;
+
+    rc = ib_data_filter_pattern(name, nlen, &pattern, &pattern_len);
+    if (rc == IB_ENOENT) {
+        return IB_OK;
+    }
+    else if (rc != IB_OK) {
+        return rc;
+    }
+
+    /* Already compiled? */
+    rc = ib_hash_get_ex(cache->hash, &filter, pattern, pattern_len);
+    if (rc == IB_OK) {
+        return IB_OK;
+    }
+
+    key = ib_mpool_memdup(cache->mp, pattern, pattern_len);
+    if (key == NULL) {
+        return IB_EALLOC;
+    }
+
+    rc = ib_data_filter_compile(cache->mp, cache->pcre,
+                                pattern, pattern_len, &filter);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    return ib_hash_set_ex(cache->hash, key, pattern_len, (void *)filter);
+}
+
 ib_mpool_t *ib_data_pool(
     const ib_data_t *data
 )
@@ -626,6 +1195,22 @@ ib_status_t ib_data_add_stream_ex(
     return rc;
 }
 
+ib_data_field_id_t ib_data_field_id(
+    const char *name,
+    size_t      nlen
+)
+{
+    assert(name != NULL);
+
+    const char *filter_marker = memchr(name, DPI_LIST_FILTER_MARKER, nlen);
+
+    if (filter_marker != NULL) {
+        nlen = filter_marker - name;
+    }
+
+    return ib_data_core_id(name, nlen);
+}
+
 ib_status_t ib_data_get_ex(
     const ib_data_t  *data,
     const char       *name,
@@ -636,9 +1221,8 @@ ib_status_t ib_data_get_ex(
     assert(data != NULL);
 
     ib_status_t rc;
-    char *name_str = NULL;
 
-    char *filter_marker = memchr(name, DPI_LIST_FILTER_MARKER, name_len);
+    const char *filter_marker = memchr(name, DPI_LIST_FILTER_MARKER, name_len);
 
     /*
      * If there is a filter_marker then we are going to
@@ -653,9 +1237,6 @@ ib_status_t ib_data_get_ex(
         /* If there is a filter mark (':') get the parent field. */
         ib_field_t *parent_field;
 
-        char *filter_start = memchr(name, DPI_LIST_FILTER_PREFIX, name_len);
-        char *filter_end;
-
         /* Fetch the field name, but the length is (filter_mark - name).
          * That is, the string before the ':' we found. */
         rc = ib_hash_get_ex(data->hash, &parent_field, name, filter_marker - name);
@@ -663,59 +1244,8 @@ ib_status_t ib_data_get_ex(
             return rc;
         }
 
-        if ( filter_start && filter_start + 1 < name + name_len ) {
-            filter_end = memchr(filter_start+1,
-                                DPI_LIST_FILTER_SUFFIX,
-                                name_len - (filter_start+1-name));
-        }
-        else {
-            filter_end = NULL;
-        }
-
-
-        /* Does the expansions use a pattern match or not? */
-        if (filter_start && filter_end) {
-
-            /* Bad filter: FOO/: */
-            if (filter_marker != filter_start-1) {
-                rc = IB_EINVAL;
-                goto error_handler;
-            }
-
-            /* Bad filter: FOO:/ */
-            if (filter_start == filter_end) {
-                rc = IB_EINVAL;
-                goto error_handler;
-            }
-
-            /* Bad filter: FOO:// */
-            if (filter_start == filter_end-1) {
-                rc = IB_EINVAL;
-                goto error_handler;
-            }
-
-            /* Validated that filter_start and filter_end are sane. */
-            rc = ib_data_get_filtered_list(
-                data,
-                parent_field,
-                filter_start+1,
-                filter_end - filter_start - 1,
-                pf
-            );
-        }
-
-        /* No pattern match. Just extract the sub-field. */
-        else {
-
-            /* Handle extracting a subfield for a list of a dynamic field. */
-            rc = ib_data_get_subfields(
-                data,
-                parent_field,
-                filter_marker+1,
-                name_len - (filter_marker+1-name),
-                pf
-            );
-        }
+        rc = ib_data_get_child(data, parent_field, name, name_len,
+                               filter_marker, pf);
     }
 
     /* Typical no-expansion fetch of a value. */
@@ -724,19 +1254,48 @@ ib_status_t ib_data_get_ex(
     }
 
     return rc;
+}
 
-    /* Error handling routine. */
-error_handler:
-    name_str = malloc(name_len+1);
-    if ( name_str == NULL ) {
-        return IB_EALLOC;
+ib_status_t ib_data_get_id(
+    const ib_data_t    *data,
+    ib_data_field_id_t  id,
+    const char         *name,
+    size_t              nlen,
+    ib_field_t        **pf
+)
+{
+    assert(data != NULL);
+    assert(name != NULL);
+    assert(pf != NULL);
+
+    ib_field_t *field;
+
+    if ( (id < 0) || (id >= IB_DATA_FIELD_ID_COUNT) ) {
+        return ib_data_get_ex(data, name, nlen, pf);
     }
 
-    memcpy(name_str, name, name_len);
-    name_str[name_len] = '\0';
-    free(name_str);
+    field = data->core[id];
+    if (field == NULL) {
+        return IB_ENOENT;
+    }
 
-    return rc;
+    /* A name longer than the core name has a list filter. */
+    if (nlen > ib_data_core_names[id].nlen) {
+        return ib_data_get_child(data, field, name, nlen,
+                                 name + ib_data_core_names[id].nlen, pf);
+    }
+
+    *pf = field;
+    return IB_OK;
+}
+
+size_t ib_data_generation(
+    const ib_data_t *data
+)
+{
+    assert(data != NULL);
+
+    return data->generation;
 }
 
 ib_status_t ib_data_get_all(
@@ -824,7 +1383,43 @@ ib_status_t ib_data_remove_ex(ib_data_t *data,
 {
     assert(data != NULL);
 
-    return ib_hash_remove_ex(data->hash, pf, name, nlen);
+    ib_status_t        rc;
+    ib_data_field_id_t id;
+
+    rc = ib_hash_remove_ex(data->hash, pf, name, nlen);
+    if (rc == IB_OK) {
+        id = ib_data_core_id(name, nlen);
+        if (id != IB_DATA_FIELD_ID_NONE) {
+            data->core[id] = NULL;
+        }
+    }
+
+    return rc;
+}
+
+ib_status_t ib_data_remove_id(
+    ib_data_t           *data,
+    ib_data_field_id_t   id,
+    ib_field_t         **pf
+)
+{
+    assert(data != NULL);
+    assert( (id >= 0) && (id < IB_DATA_FIELD_ID_COUNT) );
+
+    ib_status_t rc;
+
+    if (data->core[id] == NULL) {
+        return IB_ENOENT;
+    }
+
+    rc = ib_hash_remove_ex(data->hash, pf,
+                           ib_data_core_names[id].name,
+                           ib_data_core_names[id].nlen);
+    if (rc == IB_OK) {
+        data->core[id] = NULL;
+    }
+
+    return rc;
 }
 
 ib_status_t ib_data_set(
@@ -835,7 +1430,26 @@ ib_status_t ib_data_set(
 )
 {
     assert(data != NULL);
-    return ib_hash_set_ex(data->hash, name, nlen, f);
+
+    ++data->generation;
+    return ib_data_set_top(data, name, nlen, f);
+}
+
+ib_status_t ib_data_set_id(
+    ib_data_t          *data,
+    ib_data_field_id_t  id,
+    ib_field_t         *f
+)
+{
+    assert(data != NULL);
+    assert( (id >= 0) && (id < IB_DATA_FIELD_ID_COUNT) );
+    assert(f != NULL);
+
+    ++data->generation;
+    return ib_data_set_top_id(data, id,
+                              ib_data_core_names[id].name,
+                              ib_data_core_names[id].nlen,
+                              f);
 }
 
 ib_status_t ib_data_set_relative(
@@ -947,3 +1561,42 @@ ib_status_t ib_data_expand_test_str_ex(
         result
     );
 }
+
+ib_status_t ib_data_expand_template_create(
+    ib_mpool_t            *mp,
+    const char            *str,
+    size_t                 slen,
+    ib_expand_template_t **tmpl
+)
+{
+    return ib_expand_template_create(
+        mp,
+        str,
+        slen,
+        IB_VARIABLE_EXPANSION_PREFIX,
+        IB_VARIABLE_EXPANSION_POSTFIX,
+        expand_resolve_fn,
+        tmpl
+    );
+}
+
+ib_status_t ib_data_expand_template_str(
+    const ib_data_t             *data,
+    const ib_expand_template_t  *tmpl,
+    bool                         nul,
+    char                       **result,
+    size_t                      *result_len
+)
+{
+    assert(data != NULL);
+
+    return ib_expand_template_str(
+        data->mp,
+        tmpl,
+        nul,
+        expand_template_lookup_fn,
+        data,
+        result,
+        result_len
+    );
+}
@@ -39,6 +39,7 @@
 #include <ironbee/ip.h>
 #include <ironbee/module.h>
 #include <ironbee/mpool.h>
+#include <ironbee/pcre_cache.h>
 #include <ironbee/provider.h>
 #include <ironbee/server.h>
 #include <ironbee/state_notify.h>
@@ -82,6 +83,21 @@ typedef struct {
  */
 static ib_event_type_data_t ib_event_table[IB_STATE_EVENT_NUM];
 
+/**
+ * Default memory pool policies by role.
+ *
+ * All roles use the memory pool defaults; the role names label the pools
+ * in ib_mpool_analyze() reports.
+ */
+static const ib_mpool_policy_t
+ib_default_pool_policy[IB_ENGINE_POOL_ROLE_NUM] = {
+    [IB_ENGINE_POOL_ENGINE] = { "engine", 0, 0, false },
+    [IB_ENGINE_POOL_CONFIG] = { "config", 0, 0, false },
+    [IB_ENGINE_POOL_CONN]   = { "conn",   0, 0, false },
+    [IB_ENGINE_POOL_TX]     = { "tx",     0, 0, false },
+    [IB_ENGINE_POOL_TEMP]   = { "temp",   0, 0, false },
+};
+
 /**
  * Initialize the event table entry for @a event
  *
@@ -294,6 +310,9 @@ ib_status_t ib_initialize(void)
 
 ib_status_t ib_shutdown(void)
 {
+    /* Delete the key of the PCRE JIT stacks */
+    ib_pcre_cache_shutdown();
+
     /* Shut down the utility library */
     ib_util_shutdown();
 
@@ -306,7 +325,10 @@ ib_status_t ib_engine_create(ib_engine_t **pib, ib_server_t *server)
     ib_status_t rc;
 
     /* Create primary memory pool */
-    rc = ib_mpool_create(&pool, "engine", NULL);
+    rc = ib_mpool_create_policy(
+        &pool, "engine", NULL,
+        &ib_default_pool_policy[IB_ENGINE_POOL_ENGINE]
+    );
     if (rc != IB_OK) {
         rc = IB_EALLOC;
         goto failed;
@@ -319,19 +341,21 @@ ib_status_t ib_engine_create(ib_engine_t **pib, ib_server_t *server)
         goto failed;
     }
     (*pib)->mp = pool;
+    memcpy((*pib)->pool_policy, ib_default_pool_policy,
+           sizeof((*pib)->pool_policy));
 
     /* Create temporary memory pool */
-    rc = ib_mpool_create(&((*pib)->temp_mp),
-                         "temp",
-                         (*pib)->mp);
+    rc = ib_engine_pool_create(*pib, IB_ENGINE_POOL_TEMP,
+                               "temp", (*pib)->mp,
+                               &((*pib)->temp_mp));
     if (rc != IB_OK) {
         goto failed;
     }
 
     /* Create the config memory pool */
-    rc = ib_mpool_create(&((*pib)->config_mp),
-                         "config",
-                         (*pib)->mp);
+    rc = ib_engine_pool_create(*pib, IB_ENGINE_POOL_CONFIG,
+                               "config", (*pib)->mp,
+                               &((*pib)->config_mp));
     if (rc != IB_OK) {
         goto failed;
     }
@@ -433,6 +457,19 @@ ib_status_t ib_engine_create(ib_engine_t **pib, ib_server_t *server)
         goto failed;
     }
 
+    /* Create the shared PCRE pattern cache */
+    rc = ib_pcre_cache_create((*pib)->mp, &((*pib)->pcre_cache));
+    if (rc != IB_OK) {
+        goto failed;
+    }
+
+    /* Create the cache of compiled data list filters */
+    rc = ib_data_filter_cache_create((*pib)->mp, (*pib)->pcre_cache,
+                                     &((*pib)->data_filters));
+    if (rc != IB_OK) {
+        goto failed;
+    }
+
     /* Initialize the core static module. */
     /// @todo Probably want to do this in a less hard-coded manner.
     rc = ib_module_init(ib_core_module(), *pib);
@@ -534,6 +571,9 @@ ib_status_t ib_engine_config_finished(ib_engine_t *ib)
     ib->cfgparser = NULL;
     ib->cfg_state = CFG_FINISHED;
 
+    /* Patterns compiled from now on are not kept for the engine's life. */
+    ib_pcre_cache_close(ib->pcre_cache);
+
     /* Destroy the temporary memory pool. */
     ib_engine_pool_temp_destroy(ib);
 
@@ -579,6 +619,13 @@ ib_mpool_t *ib_engine_pool_main_get(const ib_engine_t *ib)
     return ib->mp;
 }
 
+ib_pcre_cache_t *ib_engine_pcre_cache(const ib_engine_t *ib)
+{
+    assert(ib != NULL);
+
+    return ib->pcre_cache;
+}
+
 ib_mpool_t *ib_engine_pool_config_get(const ib_engine_t *ib)
 {
     return ib->mp;
@@ -596,6 +643,50 @@ void ib_engine_pool_temp_destroy(ib_engine_t *ib)
     return;
 }
 
+const ib_mpool_policy_t *ib_engine_pool_policy_get(
+    const ib_engine_t     *ib,
+    ib_engine_pool_role_t  role)
+{
+    assert(ib != NULL);
+    assert(role < IB_ENGINE_POOL_ROLE_NUM);
+
+    return &(ib->pool_policy[role]);
+}
+
+ib_status_t ib_engine_pool_policy_set(
+    ib_engine_t             *ib,
+    ib_engine_pool_role_t    role,
+    const ib_mpool_policy_t *policy)
+{
+    assert(ib != NULL);
+    assert(policy != NULL);
+
+    if (role >= IB_ENGINE_POOL_ROLE_NUM) {
+        return IB_EINVAL;
+    }
+
+    ib->pool_policy[role].pagesize        = policy->pagesize;
+    ib->pool_policy[role].large_threshold = policy->large_threshold;
+    ib->pool_policy[role].huge_pages      = policy->huge_pages;
+
+    return IB_OK;
+}
+
+ib_status_t ib_engine_pool_create(
+    const ib_engine_t      *ib,
+    ib_engine_pool_role_t   role,
+    const char             *name,
+    ib_mpool_t             *parent,
+    ib_mpool_t            **pmp)
+{
+    assert(ib != NULL);
+    assert(role < IB_ENGINE_POOL_ROLE_NUM);
+    assert(pmp != NULL);
+
+    return ib_mpool_create_policy(pmp, name, parent,
+                                  &(ib->pool_policy[role]));
+}
+
 void ib_engine_pool_destroy(ib_engine_t *ib, ib_mpool_t *mp)
 {
     assert(ib != NULL);
@@ -663,11 +754,22 @@ void ib_engine_destroy(ib_engine_t *ib)
     ib_list_node_t *node;
     ib_module_t *cm = ib_core_module();
     ib_module_t *m;
+    ib_pcre_stats_t pcre_stats;
 
     if (ib == NULL) {
         return;
     }
 
+    ib_pcre_cache_stats(ib->pcre_cache, &pcre_stats);
+    ib_log_debug(ib,
+                 "PCRE cache: patterns=%zd jit=%zd lookups=%" PRIu64
+                 " hits=%" PRIu64 " failures=%" PRIu64
+                 " declined=%" PRIu64 " compile_usec=%" PRIu64,
+                 pcre_stats.patterns, pcre_stats.jit_patterns,
+                 pcre_stats.lookups, pcre_stats.hits,
+                 pcre_stats.failures, pcre_stats.declined,
+                 pcre_stats.compile_usec);
+
     /// @todo Destroy filters
 
     ib_log_debug3(ib, "Destroying configuration contexts...");
@@ -726,8 +828,8 @@ ib_status_t ib_conn_create(ib_engine_t *ib,
     char namebuf[64];
 
     /* Create a sub-pool for each connection and allocate from it */
-    /// @todo Need to tune the pool size
-    rc = ib_mpool_create(&pool, "conn", ib->mp);
+    rc = ib_engine_pool_create(ib, IB_ENGINE_POOL_CONN, "conn", ib->mp,
+                               &pool);
     if (rc != IB_OK) {
         ib_log_alert(ib,
             "Failed to create connection memory pool: %s",
@@ -763,6 +865,7 @@ ib_status_t ib_conn_create(ib_engine_t *ib,
                      ib_status_to_string(rc));
         return rc;
     }
+    ib_data_set_filter_cache((*pconn)->data, ib->data_filters);
 
     /* Create the per-module data data store. */
     rc = ib_array_create(&((*pconn)->module_data), pool, 16, 8);
@@ -889,9 +992,21 @@ ib_status_t ib_tx_generate_id(ib_tx_t *tx,
 {
     ib_uuid_t uuid;
     ib_status_t rc;
+    ib_core_cfg_t *corecfg = NULL;
     char *str;
 
-    rc = ib_uuid_create_v4(&uuid);
+    /* Neither generator takes a lock; see ib_uuid_create_v4_fast(). */
+    if (tx->ib != NULL) {
+        ib_context_module_config(ib_context_main(tx->ib),
+                                 ib_core_module(),
+                                 (void *)&corecfg);
+    }
+    if ( (corecfg != NULL) && (corecfg->tx_id_format == IB_TX_ID_SORTABLE) ) {
+        rc = ib_uuid_create_sortable(&uuid);
+    }
+    else {
+        rc = ib_uuid_create_v4_fast(&uuid);
+    }
     if (rc != IB_OK) {
         return rc;
     }
@@ -938,7 +1053,8 @@ ib_status_t ib_tx_create(ib_tx_t **ptx,
     /* Create a sub-pool from the connection memory pool for each
      * transaction and allocate from it
      */
-    rc = ib_mpool_create(&pool, "tx", conn->mp);
+    rc = ib_engine_pool_create(ib, IB_ENGINE_POOL_TX, "tx", conn->mp,
+                               &pool);
     if (rc != IB_OK) {
         ib_log_alert(ib,
             "Failed to create transaction memory pool: %s",
@@ -983,6 +1099,7 @@ ib_status_t ib_tx_create(ib_tx_t **ptx,
                         ib_status_to_string(rc));
         return rc;
     }
+    ib_data_set_filter_cache(tx->data, ib->data_filters);
 
     /* Create logevents */
     rc = ib_list_create(&tx->logevents, tx->mp);
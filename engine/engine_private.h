@@ -116,6 +116,8 @@ struct ib_engine_t {
     ib_mpool_t            *mp;              /**< Primary memory pool */
     ib_mpool_t            *config_mp;       /**< Config memory pool */
     ib_mpool_t            *temp_mp;         /**< Temp memory pool for config */
+    /** Memory pool policy by role */
+    ib_mpool_policy_t      pool_policy[IB_ENGINE_POOL_ROLE_NUM];
     ib_data_t             *data;            /**< Data fields */
     ib_context_t          *ectx;            /**< Engine configuration context */
     ib_context_t          *ctx;             /**< Main configuration context */
@@ -139,6 +141,8 @@ struct ib_engine_t {
     ib_hash_t             *tfns;            /**< Hash tracking transforms */
     ib_hash_t             *operators;       /**< Hash tracking operators */
     ib_hash_t             *actions;         /**< Hash tracking rules */
+    struct ib_pcre_cache_t *pcre_cache;     /**< Shared PCRE patterns */
+    ib_data_filter_cache_t *data_filters;   /**< Compiled list filters */
     ib_rule_engine_t      *rule_engine;     /**< Rule engine data */
     ib_list_t             *collection_managers; /**< List of managers */
     ib_log_logger_fn_t     logger_fn;       /**< Logger function. */
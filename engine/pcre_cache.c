@@ -0,0 +1,636 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee --- Shared PCRE Pattern Cache
+ */
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/pcre_cache.h>
+
+#include <ironbee/clock.h>
+#include <ironbee/hash.h>
+#include <ironbee/lock.h>
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Default starting size of a thread's JIT stack. */
+#define JIT_STACK_START_DEFAULT (32 * 1024)
+
+/** Default maximum size of a thread's JIT stack. */
+#define JIT_STACK_MAX_DEFAULT   (512 * 1024)
+
+/**
+ * Compiled pattern and its private data.
+ */
+typedef struct {
+    ib_pcre_t      cpatt;           /**< The compiled pattern */
+    bool           pcre_extra;      /**< Was @c cpatt.extra made by PCRE? */
+    int            jit_stack_start; /**< JIT stack start size */
+    int            jit_stack_max;   /**< JIT stack maximum size */
+} pcre_entry_t;
+
+struct ib_pcre_cache_t {
+    ib_mpool_t      *mp;            /**< Memory pool */
+    ib_hash_t       *hash;          /**< Patterns (pcre_entry_t) by key */
+    ib_lock_t        lock;          /**< Protects hash and stats */
+    bool             jit;           /**< Is JIT compilation enabled? */
+    bool             closed;        /**< Closed to new patterns? */
+    ib_pcre_stats_t  stats;         /**< Statistics */
+};
+
+#ifdef PCRE_HAVE_JIT
+/**
+ * A thread's JIT stack.
+ */
+typedef struct jit_thread_stack_t jit_thread_stack_t;
+struct jit_thread_stack_t {
+    pcre_jit_stack     *stack;      /**< The stack */
+    int                 max;        /**< Maximum size of @c stack */
+    jit_thread_stack_t *prev;       /**< Previous stack in jit_stacks */
+    jit_thread_stack_t *next;       /**< Next stack in jit_stacks */
+};
+
+/** Key of the thread's JIT stack. */
+static pthread_key_t   jit_stack_key;
+
+/**
+ * State of jit_stack_key: 0 if not created, 1 if created, -1 if creation
+ * failed.  Read without jit_stack_key_lock, and so only with
+ * __atomic_load_n().
+ */
+static int             jit_stack_key_state = 0;
+
+/**
+ * Stacks of all threads, so that ib_pcre_cache_shutdown() can free those
+ * of threads that are still alive.
+ */
+static jit_thread_stack_t *jit_stacks = NULL;
+
+/** Protects jit_stack_key and jit_stacks. */
+static pthread_mutex_t jit_stack_key_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Remove a thread's JIT stack from jit_stacks and free it.
+ *
+ * Call with jit_stack_key_lock held.
+ *
+ * @param[in] tstack The thread's stack
+ */
+static void jit_stack_release(jit_thread_stack_t *tstack)
+{
+    assert(tstack != NULL);
+
+    if (tstack->prev != NULL) {
+        tstack->prev->next = tstack->next;
+    }
+    else {
+        jit_stacks = tstack->next;
+    }
+    if (tstack->next != NULL) {
+        tstack->next->prev = tstack->prev;
+    }
+
+    if (tstack->stack != NULL) {
+        pcre_jit_stack_free(tstack->stack);
+    }
+    free(tstack);
+}
+
+/**
+ * Free a thread's JIT stack at thread exit.
+ *
+ * @param[in] data The thread's stack (jit_thread_stack_t)
+ */
+static void jit_stack_free(void *data)
+{
+    jit_thread_stack_t *tstack = (jit_thread_stack_t *)data;
+
+    if (tstack != NULL) {
+        pthread_mutex_lock(&jit_stack_key_lock);
+        jit_stack_release(tstack);
+        pthread_mutex_unlock(&jit_stack_key_lock);
+    }
+}
+
+/**
+ * Create the JIT stack thread key, if not already created.
+ *
+ * The key is created when the first JIT pattern is compiled, and again
+ * after ib_pcre_cache_shutdown() deleted it.
+ *
+ * @returns true iff the key exists.
+ */
+static bool jit_stack_key_create(void)
+{
+    int state = __atomic_load_n(&jit_stack_key_state, __ATOMIC_ACQUIRE);
+
+    if (state == 0) {
+        pthread_mutex_lock(&jit_stack_key_lock);
+        state = jit_stack_key_state;
+        if (state == 0) {
+            state =
+                (pthread_key_create(&jit_stack_key, jit_stack_free) == 0) ?
+                1 : -1;
+            __atomic_store_n(&jit_stack_key_state, state, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&jit_stack_key_lock);
+    }
+
+    return state == 1;
+}
+
+/**
+ * PCRE JIT stack callback: get the calling thread's JIT stack.
+ *
+ * The stack is created on first use, and replaced by a larger one when a
+ * pattern needs more than the current stack provides.  If no stack is
+ * available, PCRE falls back to the machine stack.
+ *
+ * @param[in] data The pattern's entry (pcre_entry_t)
+ *
+ * @returns The thread's JIT stack, or NULL.
+ */
+static pcre_jit_stack *jit_stack_get(void *data)
+{
+    const pcre_entry_t *entry = (const pcre_entry_t *)data;
+    jit_thread_stack_t *tstack;
+
+    if (__atomic_load_n(&jit_stack_key_state, __ATOMIC_ACQUIRE) != 1) {
+        return NULL;
+    }
+
+    tstack = (jit_thread_stack_t *)pthread_getspecific(jit_stack_key);
+    if ( (tstack != NULL) && (tstack->max >= entry->jit_stack_max) ) {
+        return tstack->stack;
+    }
+
+    if (tstack == NULL) {
+        tstack = calloc(1, sizeof(*tstack));
+        if (tstack == NULL) {
+            return NULL;
+        }
+        if (pthread_setspecific(jit_stack_key, tstack) != 0) {
+            free(tstack);
+            return NULL;
+        }
+
+        pthread_mutex_lock(&jit_stack_key_lock);
+        tstack->next = jit_stacks;
+        if (jit_stacks != NULL) {
+            jit_stacks->prev = tstack;
+        }
+        jit_stacks = tstack;
+        pthread_mutex_unlock(&jit_stack_key_lock);
+    }
+    else {
+        pcre_jit_stack_free(tstack->stack);
+        tstack->stack = NULL;
+        tstack->max = 0;
+    }
+
+    tstack->stack = pcre_jit_stack_alloc(entry->jit_stack_start,
+                                         entry->jit_stack_max);
+    if (tstack->stack != NULL) {
+        tstack->max = entry->jit_stack_max;
+    }
+    return tstack->stack;
+}
+#endif /* PCRE_HAVE_JIT */
+
+/**
+ * Free the PCRE data of a compiled pattern.
+ *
+ * @param[in] data The pattern's entry (pcre_entry_t)
+ */
+static void pcre_entry_destroy(void *data)
+{
+    assert(data != NULL);
+
+    pcre_entry_t *entry = (pcre_entry_t *)data;
+
+    if ( (entry->cpatt.extra != NULL) && entry->pcre_extra ) {
+#ifdef PCRE_HAVE_JIT
+        pcre_free_study(entry->cpatt.extra);
+#else
+        pcre_free(entry->cpatt.extra);
+#endif
+    }
+    entry->cpatt.extra = NULL;
+    if (entry->cpatt.code != NULL) {
+        pcre_free(entry->cpatt.code);
+        entry->cpatt.code = NULL;
+    }
+}
+
+/**
+ * Destroy a pattern cache's lock.
+ *
+ * @param[in] data The cache (ib_pcre_cache_t)
+ */
+static void pcre_cache_destroy(void *data)
+{
+    assert(data != NULL);
+
+    ib_pcre_cache_t *cache = (ib_pcre_cache_t *)data;
+
+    ib_lock_destroy(&cache->lock);
+}
+
+/**
+ * Compile a pattern into a new entry.
+ *
+ * @param[in] mp Memory pool for the entry
+ * @param[in] pattern NUL terminated pattern
+ * @param[in] params Compile parameters
+ * @param[in] jit Is JIT compilation enabled?
+ * @param[out] pentry New entry
+ * @param[out] errptr PCRE error message (may be NULL)
+ * @param[out] erroffset Error offset (may be NULL)
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a pattern fails to compile.
+ * - IB_EALLOC on allocation failure.
+ */
+static ib_status_t pcre_entry_create(ib_mpool_t *mp,
+                                     const char *pattern,
+                                     const ib_pcre_params_t *params,
+                                     bool jit,
+                                     pcre_entry_t **pentry,
+                                     const char **errptr,
+                                     int *erroffset)
+{
+    assert(mp != NULL);
+    assert(pattern != NULL);
+    assert(params != NULL);
+    assert(pentry != NULL);
+
+    pcre_entry_t *entry;
+    const char   *error = NULL;
+    int           offset = 0;
+    ib_status_t   rc;
+
+    entry = ib_mpool_calloc(mp, 1, sizeof(*entry));
+    if (entry == NULL) {
+        return IB_EALLOC;
+    }
+    entry->cpatt.pattern = ib_mpool_strdup(mp, pattern);
+    if (entry->cpatt.pattern == NULL) {
+        return IB_EALLOC;
+    }
+
+    entry->cpatt.code =
+        pcre_compile(pattern, params->options, &error, &offset, NULL);
+    if (entry->cpatt.code == NULL) {
+        if (errptr != NULL) {
+            *errptr = error;
+        }
+        if (erroffset != NULL) {
+            *erroffset = offset;
+        }
+        return IB_EINVAL;
+    }
+    rc = ib_mpool_cleanup_register(mp, pcre_entry_destroy, entry);
+    if (rc != IB_OK) {
+        pcre_free(entry->cpatt.code);
+        entry->cpatt.code = NULL;
+        return rc;
+    }
+
+#ifndef PCRE_HAVE_JIT
+    jit = false;
+#endif
+    jit = jit && params->jit && params->study;
+
+    /* Study data is optional; a failed study only costs speed. */
+    if (params->study) {
+#ifdef PCRE_HAVE_JIT
+        const int study_options = jit ? PCRE_STUDY_JIT_COMPILE : 0;
+#else
+        const int study_options = 0;
+#endif
+        error = NULL;
+        entry->cpatt.extra =
+            pcre_study(entry->cpatt.code, study_options, &error);
+        if (error != NULL) {
+            entry->cpatt.extra = NULL;
+        }
+        entry->pcre_extra = (entry->cpatt.extra != NULL);
+    }
+
+#ifdef PCRE_HAVE_JIT
+    if (jit && (entry->cpatt.extra != NULL)) {
+        int is_jit = 0;
+
+        if ( (pcre_fullinfo(entry->cpatt.code, entry->cpatt.extra,
+                            PCRE_INFO_JIT, &is_jit) == 0) &&
+             (is_jit == 1) )
+        {
+            entry->cpatt.is_jit = true;
+        }
+    }
+#endif
+
+    /* Limits are set in the extra data, which study may not create. */
+    if ( (params->match_limit != 0) || (params->match_limit_recursion != 0) ) {
+        if (entry->cpatt.extra == NULL) {
+            entry->cpatt.extra = ib_mpool_calloc(mp, 1, sizeof(pcre_extra));
+            if (entry->cpatt.extra == NULL) {
+                return IB_EALLOC;
+            }
+        }
+        if (params->match_limit != 0) {
+            entry->cpatt.extra->flags |= PCRE_EXTRA_MATCH_LIMIT;
+            entry->cpatt.extra->match_limit = params->match_limit;
+        }
+        if (params->match_limit_recursion != 0) {
+            entry->cpatt.extra->flags |= PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+            entry->cpatt.extra->match_limit_recursion =
+                params->match_limit_recursion;
+        }
+    }
+
+#ifdef PCRE_HAVE_JIT
+    if (entry->cpatt.is_jit) {
+        entry->jit_stack_start = (params->jit_stack_start != 0) ?
+            params->jit_stack_start : JIT_STACK_START_DEFAULT;
+        entry->jit_stack_max = (params->jit_stack_max != 0) ?
+            params->jit_stack_max : JIT_STACK_MAX_DEFAULT;
+        if (entry->jit_stack_start > entry->jit_stack_max) {
+            entry->jit_stack_start = entry->jit_stack_max;
+        }
+        jit_stack_key_create();
+        pcre_assign_jit_stack(entry->cpatt.extra, jit_stack_get, entry);
+    }
+#endif
+
+    pcre_fullinfo(entry->cpatt.code, entry->cpatt.extra,
+                  PCRE_INFO_SIZE, &entry->cpatt.code_size);
+    if (entry->pcre_extra) {
+        pcre_fullinfo(entry->cpatt.code, entry->cpatt.extra,
+                      PCRE_INFO_STUDYSIZE, &entry->cpatt.study_size);
+    }
+
+    *pentry = entry;
+    return IB_OK;
+}
+
+ib_status_t ib_pcre_cache_create(
+    ib_mpool_t       *mp,
+    ib_pcre_cache_t **cache
+)
+{
+    assert(mp != NULL);
+    assert(cache != NULL);
+
+    ib_pcre_cache_t *new_cache;
+    ib_status_t      rc;
+
+    new_cache = ib_mpool_calloc(mp, 1, sizeof(*new_cache));
+    if (new_cache == NULL) {
+        return IB_EALLOC;
+    }
+    new_cache->mp = mp;
+#ifdef PCRE_HAVE_JIT
+    new_cache->jit = true;
+#endif
+
+    rc = ib_hash_create(&new_cache->hash, mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_lock_init(&new_cache->lock);
+    if (rc != IB_OK) {
+        return IB_EUNKNOWN;
+    }
+    rc = ib_mpool_cleanup_register(mp, pcre_cache_destroy, new_cache);
+    if (rc != IB_OK) {
+        ib_lock_destroy(&new_cache->lock);
+        return rc;
+    }
+
+    *cache = new_cache;
+    return IB_OK;
+}
+
+void ib_pcre_cache_jit_set(
+    ib_pcre_cache_t *cache,
+    bool             enable
+)
+{
+    assert(cache != NULL);
+
+#ifdef PCRE_HAVE_JIT
+    cache->jit = enable;
+#endif
+}
+
+bool ib_pcre_cache_jit_enabled(
+    const ib_pcre_cache_t *cache
+)
+{
+    assert(cache != NULL);
+
+    return cache->jit;
+}
+
+void ib_pcre_cache_close(
+    ib_pcre_cache_t *cache
+)
+{
+    assert(cache != NULL);
+
+    ib_lock_lock(&cache->lock);
+    cache->closed = true;
+    ib_lock_unlock(&cache->lock);
+}
+
+ib_status_t ib_pcre_cache_compile(
+    ib_pcre_cache_t         *cache,
+    const char              *pattern,
+    const ib_pcre_params_t  *params,
+    const ib_pcre_t        **cpatt,
+    const char             **errptr,
+    int                     *erroffset
+)
+{
+    assert(cache != NULL);
+    assert(pattern != NULL);
+    assert(params != NULL);
+    assert(cpatt != NULL);
+
+    pcre_entry_t *entry;
+    char          prefix[128];
+    int           prefix_len;
+    size_t        pattern_len = strlen(pattern);
+    char         *key;
+    const char   *cache_key;
+    size_t        key_len;
+    ib_time_t     start;
+    ib_status_t   rc;
+
+    /* The key is the compile parameters followed by the pattern. */
+    prefix_len = snprintf(prefix, sizeof(prefix), "%d/%d/%d/%lu/%lu/%d/%d/",
+                          params->options,
+                          params->study ? 1 : 0,
+                          (params->jit && cache->jit) ? 1 : 0,
+                          params->match_limit,
+                          params->match_limit_recursion,
+                          params->jit_stack_start,
+                          params->jit_stack_max);
+    assert( (prefix_len > 0) && ((size_t)prefix_len < sizeof(prefix)) );
+    key_len = (size_t)prefix_len + pattern_len;
+    key = malloc(key_len);
+    if (key == NULL) {
+        return IB_EALLOC;
+    }
+    memcpy(key, prefix, prefix_len);
+    memcpy(key + prefix_len, pattern, pattern_len);
+
+    rc = ib_lock_lock(&cache->lock);
+    if (rc != IB_OK) {
+        free(key);
+        return rc;
+    }
+
+    ++cache->stats.lookups;
+    rc = ib_hash_get_ex(cache->hash, &entry, key, key_len);
+    if (rc == IB_OK) {
+        ++cache->stats.hits;
+        *cpatt = &entry->cpatt;
+        goto done;
+    }
+
+    /* Nothing is ever removed, so only configuration may add patterns. */
+    if (cache->closed) {
+        ++cache->stats.declined;
+        rc = IB_DECLINED;
+        goto done;
+    }
+
+    start = ib_clock_get_time();
+    rc = pcre_entry_create(cache->mp, pattern, params, cache->jit,
+                           &entry, errptr, erroffset);
+    cache->stats.compile_usec += ib_clock_get_time() - start;
+    if (rc != IB_OK) {
+        ++cache->stats.failures;
+        goto done;
+    }
+
+    /* The hash does not copy its keys. */
+    cache_key = ib_mpool_memdup(cache->mp, key, key_len);
+    if (cache_key == NULL) {
+        rc = IB_EALLOC;
+        goto done;
+    }
+    rc = ib_hash_set_ex(cache->hash, cache_key, key_len, entry);
+    if (rc != IB_OK) {
+        goto done;
+    }
+    ++cache->stats.patterns;
+    if (entry->cpatt.is_jit) {
+        ++cache->stats.jit_patterns;
+    }
+    *cpatt = &entry->cpatt;
+
+done:
+    ib_lock_unlock(&cache->lock);
+    free(key);
+    return rc;
+}
+
+void ib_pcre_cache_shutdown(void)
+{
+#ifdef PCRE_HAVE_JIT
+    pthread_mutex_lock(&jit_stack_key_lock);
+    if (jit_stack_key_state == 1) {
+        /* Deleting the key runs no destructors, so free every thread's
+         * stack here. */
+        pthread_key_delete(jit_stack_key);
+        while (jit_stacks != NULL) {
+            jit_stack_release(jit_stacks);
+        }
+    }
+    __atomic_store_n(&jit_stack_key_state, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&jit_stack_key_lock);
+#endif
+}
+
+ib_status_t ib_pcre_compile(
+    ib_mpool_t              *mp,
+    bool                     jit,
+    const char              *pattern,
+    const ib_pcre_params_t  *params,
+    const ib_pcre_t        **cpatt,
+    const char             **errptr,
+    int                     *erroffset
+)
+{
+    assert(mp != NULL);
+    assert(pattern != NULL);
+    assert(params != NULL);
+    assert(cpatt != NULL);
+
+    pcre_entry_t *entry;
+    ib_status_t   rc;
+
+    rc = pcre_entry_create(mp, pattern, params, jit,
+                           &entry, errptr, erroffset);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    *cpatt = &entry->cpatt;
+    return IB_OK;
+}
+
+int ib_pcre_exec(
+    const ib_pcre_t *cpatt,
+    const char      *subject,
+    size_t           subject_len,
+    int              options,
+    int             *ovector,
+    int              ovecsize
+)
+{
+    assert(cpatt != NULL);
+    assert(subject != NULL);
+
+    return pcre_exec(cpatt->code, cpatt->extra,
+                     subject, (int)subject_len,
+                     0, options, ovector, ovecsize);
+}
+
+void ib_pcre_cache_stats(
+    ib_pcre_cache_t *cache,
+    ib_pcre_stats_t *stats
+)
+{
+    assert(cache != NULL);
+    assert(stats != NULL);
+
+    ib_lock_lock(&cache->lock);
+    *stats = cache->stats;
+    ib_lock_unlock(&cache->lock);
+}
@@ -0,0 +1,422 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee --- Rule Body View
+ *
+ * The body and each transformed view are each kept in a single buffer
+ * which grows as data arrives, so that finishing the view needs no
+ * further copy.  A view's transformations read their input straight from
+ * the body buffer; bytes held back are simply left there until the next
+ * chunk.  Collection stops at the view's limit.
+ */
+
+#include "ironbee_config_auto.h"
+
+#include "rule_body_view_private.h"
+
+#include <ironbee/bytestr.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Initial size of a body or view buffer. */
+#define BODY_BUF_MIN_SIZE (4 * 1024)
+
+/**
+ * A buffer which grows as data is added.
+ *
+ * The data is allocated with malloc() and freed when the body view's
+ * memory pool is cleaned up.
+ */
+typedef struct {
+    uint8_t                *data;         /**< Buffer */
+    size_t                  dlen;         /**< Length of data */
+    size_t                  size;         /**< Allocated size of data */
+} body_buf_t;
+
+/**
+ * A transformed view of a body.
+ */
+typedef struct {
+    const ib_tfn_t         *tfn;          /**< Transformation */
+    body_buf_t              out;          /**< Transformed data */
+    size_t                  done;         /**< Body bytes transformed */
+} body_tfn_view_t;
+
+/**
+ * Body view.
+ */
+struct ib_rule_body_view_t {
+    ib_engine_t            *ib;           /**< IronBee engine */
+    ib_mpool_t             *mp;           /**< Memory pool */
+    body_buf_t              body;         /**< Body data */
+    body_tfn_view_t        *views;        /**< Transformed views */
+    size_t                  num_views;    /**< Number of views */
+    size_t                  limit;        /**< Body bytes kept; 0: all */
+    bool                    truncated;    /**< Was data dropped? */
+    bool                    finished;     /**< Has the view been finished? */
+};
+
+/**
+ * Add data to a buffer, growing it as needed.
+ *
+ * @param[in,out] buf Buffer to add to
+ * @param[in] data Data to add
+ * @param[in] dlen Length of @a data
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC on allocation failure.
+ */
+static ib_status_t body_buf_add(body_buf_t *buf,
+                                const uint8_t *data,
+                                size_t dlen)
+{
+    assert(buf != NULL);
+    assert( (data != NULL) || (dlen == 0) );
+
+    if (dlen > buf->size - buf->dlen) {
+        size_t   size = (buf->size < BODY_BUF_MIN_SIZE) ?
+                        BODY_BUF_MIN_SIZE : buf->size;
+        uint8_t *grown;
+
+        while (size - buf->dlen < dlen) {
+            if (size > SIZE_MAX / 2) {
+                size = buf->dlen + dlen;
+                break;
+            }
+            size *= 2;
+        }
+        grown = realloc(buf->data, size);
+        if (grown == NULL) {
+            return IB_EALLOC;
+        }
+        buf->data = grown;
+        buf->size = size;
+    }
+
+    if (dlen != 0) {
+        memcpy(buf->data + buf->dlen, data, dlen);
+        buf->dlen += dlen;
+    }
+
+    return IB_OK;
+}
+
+/**
+ * Make a byte string field which aliases a buffer.
+ *
+ * @param[in] mp Memory pool for allocations
+ * @param[in] buf Buffer
+ * @param[in] name Field name
+ * @param[in] nlen Length of @a name
+ * @param[out] field New field
+ *
+ * @returns Status code
+ */
+static ib_status_t body_buf_field(ib_mpool_t *mp,
+                                  const body_buf_t *buf,
+                                  const char *name,
+                                  size_t nlen,
+                                  ib_field_t **field)
+{
+    assert(mp != NULL);
+    assert(buf != NULL);
+    assert(name != NULL);
+    assert(field != NULL);
+
+    uint8_t *data = buf->data;
+
+    /* An empty body still has a buffer. */
+    if (data == NULL) {
+        data = ib_mpool_alloc(mp, 1);
+        if (data == NULL) {
+            return IB_EALLOC;
+        }
+    }
+
+    return ib_field_create_bytestr_alias(field, mp, name, nlen,
+                                         data, buf->dlen);
+}
+
+/**
+ * Free the buffers of a body view.
+ *
+ * Registered as a cleanup function of the view's memory pool.
+ *
+ * @param[in] data Body view
+ */
+static void body_view_cleanup(void *data)
+{
+    assert(data != NULL);
+
+    ib_rule_body_view_t *view = (ib_rule_body_view_t *)data;
+    size_t               n;
+
+    free(view->body.data);
+    for (n = 0;  n < view->num_views;  ++n) {
+        free(view->views[n].out.data);
+    }
+}
+
+/**
+ * Transform the body bytes a view has not transformed yet.
+ *
+ * Unless @a last is true, the bytes held back by the transformation are
+ * left for the next call.
+ *
+ * @param[in] body Body view
+ * @param[in,out] view Transformed view
+ * @param[in] mp Memory pool for the transformation's allocations
+ * @param[in] last Is this the end of the body?
+ *
+ * @returns Status code
+ */
+static ib_status_t body_tfn_view_update(ib_rule_body_view_t *body,
+                                        body_tfn_view_t *view,
+                                        ib_mpool_t *mp,
+                                        bool last)
+{
+    assert(body != NULL);
+    assert(view != NULL);
+    assert(mp != NULL);
+    assert(view->tfn->fn_holdback != NULL);
+
+    const ib_tfn_t     *tfn = view->tfn;
+    uint8_t            *data = body->body.data + view->done;
+    size_t              dlen = body->body.dlen - view->done;
+    ib_field_t         *in;
+    ib_field_t         *out;
+    const ib_bytestr_t *bs;
+    ib_flags_t          flags;
+    size_t              hold;
+    ib_status_t         rc;
+
+    if (dlen == 0) {
+        return IB_OK;
+    }
+
+    hold = last ? 0 : tfn->fn_holdback(data, dlen, tfn->fndata);
+    if (hold >= dlen) {
+        return IB_OK;
+    }
+
+    rc = ib_field_create_bytestr_alias(&in, mp, "body", 4,
+                                       data, dlen - hold);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = tfn->fn_execute(body->ib, mp, tfn->fndata, in, &out, &flags);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    if ( (out == NULL) || (out->type != IB_FTYPE_BYTESTR) ) {
+        return IB_EINVAL;
+    }
+    rc = ib_field_value(out, ib_ftype_bytestr_out(&bs));
+    if (rc != IB_OK) {
+        return rc;
+    }
+    if (bs == NULL) {
+        return IB_EINVAL;
+    }
+
+    rc = body_buf_add(&(view->out),
+                      ib_bytestr_const_ptr(bs), ib_bytestr_length(bs));
+    if (rc != IB_OK) {
+        return rc;
+    }
+    view->done += dlen - hold;
+
+    return IB_OK;
+}
+
+/**
+ * Transform the body bytes each view has not transformed yet.
+ *
+ * Transformations allocate from a temporary pool, as only their output
+ * data is kept.
+ *
+ * @param[in,out] body Body view
+ * @param[in] last Is this the end of the body?
+ *
+ * @returns Status code
+ */
+static ib_status_t body_views_update(ib_rule_body_view_t *body,
+                                     bool last)
+{
+    assert(body != NULL);
+
+    ib_mpool_t  *mp;
+    size_t       n;
+    ib_status_t  rc = IB_OK;
+
+    if (body->num_views == 0) {
+        return IB_OK;
+    }
+
+    rc = ib_mpool_create(&mp, "body view", body->mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    for (n = 0;  (n < body->num_views) && (rc == IB_OK);  ++n) {
+        rc = body_tfn_view_update(body, &(body->views[n]), mp, last);
+    }
+    ib_mpool_release(mp);
+
+    return rc;
+}
+
+ib_status_t ib_rule_body_view_create(
+    ib_engine_t                *ib,
+    ib_mpool_t                 *mp,
+    const ib_tfn_t * const     *tfns,
+    size_t                      num_tfns,
+    size_t                      limit,
+    ib_rule_body_view_t       **view)
+{
+    assert(ib != NULL);
+    assert(mp != NULL);
+    assert( (tfns != NULL) || (num_tfns == 0) );
+    assert(view != NULL);
+
+    ib_rule_body_view_t *body;
+    size_t               n;
+    ib_status_t          rc;
+
+    for (n = 0;  n < num_tfns;  ++n) {
+        if (tfns[n]->fn_holdback == NULL) {
+            return IB_EINVAL;
+        }
+    }
+
+    body = ib_mpool_calloc(mp, 1, sizeof(*body));
+    if (body == NULL) {
+        return IB_EALLOC;
+    }
+    body->ib = ib;
+    body->mp = mp;
+    body->limit = limit;
+
+    if (num_tfns != 0) {
+        body->views = ib_mpool_calloc(mp, num_tfns, sizeof(*body->views));
+        if (body->views == NULL) {
+            return IB_EALLOC;
+        }
+    }
+    for (n = 0;  n < num_tfns;  ++n) {
+        body->views[n].tfn = tfns[n];
+    }
+    body->num_views = num_tfns;
+
+    rc = ib_mpool_cleanup_register(mp, body_view_cleanup, body);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    *view = body;
+    return IB_OK;
+}
+
+ib_status_t ib_rule_body_view_append(
+    ib_rule_body_view_t        *view,
+    const uint8_t              *data,
+    size_t                      dlen)
+{
+    assert(view != NULL);
+    assert( (data != NULL) || (dlen == 0) );
+
+    ib_status_t  rc;
+
+    if (view->finished) {
+        return IB_EINVAL;
+    }
+    if ( (view->limit != 0) && (dlen > view->limit - view->body.dlen) ) {
+        dlen = view->limit - view->body.dlen;
+        view->truncated = true;
+    }
+    if (dlen == 0) {
+        return IB_OK;
+    }
+
+    /* The server's buffer only lives as long as the data event. */
+    rc = body_buf_add(&(view->body), data, dlen);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    return body_views_update(view, false);
+}
+
+ib_status_t ib_rule_body_view_finish(
+    ib_rule_body_view_t        *view,
+    const char                 *name,
+    size_t                      nlen,
+    ib_field_t                **body,
+    ib_field_t                **tfn_out)
+{
+    assert(view != NULL);
+    assert(name != NULL);
+    assert(body != NULL);
+    assert( (tfn_out != NULL) || (view->num_views == 0) );
+
+    size_t      n;
+    ib_status_t rc;
+
+    if (view->finished) {
+        return IB_EINVAL;
+    }
+    view->finished = true;
+
+    rc = body_views_update(view, true);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    rc = body_buf_field(view->mp, &(view->body), name, nlen, body);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    for (n = 0;  n < view->num_views;  ++n) {
+        rc = body_buf_field(view->mp, &(view->views[n].out), name, nlen,
+                            &(tfn_out[n]));
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    return IB_OK;
+}
+
+size_t ib_rule_body_view_length(
+    const ib_rule_body_view_t  *view)
+{
+    assert(view != NULL);
+
+    return view->body.dlen;
+}
+
+bool ib_rule_body_view_truncated(
+    const ib_rule_body_view_t  *view)
+{
+    assert(view != NULL);
+
+    return view->truncated;
+}
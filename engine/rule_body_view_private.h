@@ -0,0 +1,150 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+#ifndef _IB_RULE_BODY_VIEW_PRIVATE_H_
+#define _IB_RULE_BODY_VIEW_PRIVATE_H_
+
+/**
+ * @file
+ * @brief IronBee --- Rule Body View Private Declarations
+ *
+ * A body view collects a request or response body as it arrives, and
+ * applies a set of streamable transformations (those with a holdback
+ * function) to each chunk.  When the body is complete, the body and its
+ * transformed views are available as fields without transforming the
+ * whole body again.
+ *
+ * These definitions and routines are called by the rule engine and nowhere
+ * else.
+ */
+
+#include <ironbee/engine.h>
+#include <ironbee/field.h>
+#include <ironbee/mpool.h>
+#include <ironbee/transformation.h>
+#include <ironbee/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Body view.
+ */
+typedef struct ib_rule_body_view_t ib_rule_body_view_t;
+
+/**
+ * Create a body view.
+ *
+ * @param[in] ib IronBee engine
+ * @param[in] mp Memory pool for allocations (the transaction's)
+ * @param[in] tfns Streamable transformations to apply
+ * @param[in] num_tfns Number of transformations in @a tfns
+ * @param[in] limit Most body bytes to collect; 0 for no limit
+ * @param[out] view New body view
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EINVAL if a transformation has no holdback function.
+ *   - IB_EALLOC on allocation failure.
+ */
+ib_status_t ib_rule_body_view_create(
+    ib_engine_t                *ib,
+    ib_mpool_t                 *mp,
+    const ib_tfn_t * const     *tfns,
+    size_t                      num_tfns,
+    size_t                      limit,
+    ib_rule_body_view_t       **view);
+
+/**
+ * Append a chunk of body data to a body view.
+ *
+ * @a data is copied, and transformed by each of the view's
+ * transformations, except for any bytes which must be held back until
+ * the next chunk.  Data past the view's limit is dropped, and the view
+ * is marked as truncated.
+ *
+ * @param[in,out] view Body view
+ * @param[in] data Body data
+ * @param[in] dlen Length of @a data
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EINVAL if the view has been finished.
+ *   - IB_EALLOC on allocation failure.
+ *   - Errors returned by the transformations.
+ */
+ib_status_t ib_rule_body_view_append(
+    ib_rule_body_view_t        *view,
+    const uint8_t              *data,
+    size_t                      dlen);
+
+/**
+ * Finish a body view.
+ *
+ * Held back bytes are transformed, and the body and its transformed views
+ * are made into byte string fields named @a name.  A view can only be
+ * finished once.
+ *
+ * @param[in,out] view Body view
+ * @param[in] name Field name
+ * @param[in] nlen Length of @a name
+ * @param[out] body Body field
+ * @param[out] tfn_out Array of the transformed fields, one per
+ *                     transformation, in the order they were given.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EINVAL if the view has been finished.
+ *   - IB_EALLOC on allocation failure.
+ *   - Errors returned by the transformations.
+ */
+ib_status_t ib_rule_body_view_finish(
+    ib_rule_body_view_t        *view,
+    const char                 *name,
+    size_t                      nlen,
+    ib_field_t                **body,
+    ib_field_t                **tfn_out);
+
+/**
+ * Get the number of body bytes appended to a body view.
+ *
+ * @param[in] view Body view
+ *
+ * @returns Length of the body
+ */
+size_t ib_rule_body_view_length(
+    const ib_rule_body_view_t  *view);
+
+/**
+ * Has body data been dropped because of the view's limit?
+ *
+ * @param[in] view Body view
+ *
+ * @returns true if data has been dropped
+ */
+bool ib_rule_body_view_truncated(
+    const ib_rule_body_view_t  *view);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_RULE_BODY_VIEW_PRIVATE_H_ */
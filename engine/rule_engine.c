@@ -240,6 +240,52 @@ typedef struct {
     ib_num_t                result;      /**< Rule execution result */
 } rule_exec_stack_frame_t;
 
+/**
+ * Transformation cache entry.
+ *
+ * One entry is stored per (source field, transformation prefix) computed
+ * during the transaction.  The entry for the next shorter prefix of the
+ * same chain is linked via @c prev so that the whole chain can be logged.
+ */
+typedef struct tfn_cache_entry_t tfn_cache_entry_t;
+struct tfn_cache_entry_t {
+    const ib_tfn_t          *tfn;        /**< Last transformation of prefix */
+    const ib_field_t        *in;         /**< Input to @c tfn */
+    const ib_field_t        *out;        /**< Output of @c tfn */
+    const tfn_cache_entry_t *prev;       /**< Entry of shorter prefix */
+};
+
+/**
+ * Transformation cache keys are arrays of uintptr_t: the source field,
+ * three words of value fingerprint, then one word per transformation.
+ */
+#define TFN_CACHE_FP_LEN     (3)
+#define TFN_CACHE_KEY_HDR    (1 + TFN_CACHE_FP_LEN)
+#define TFN_CACHE_KEY_LEN(n) ((TFN_CACHE_KEY_HDR + (n)) * sizeof(uintptr_t))
+
+/**
+ * Prefilter cache entry: the key, followed by the prefilter's result.
+ */
+typedef struct {
+    const ib_rule_prefilter_t *prefilter;  /**< Prefilter */
+    const ib_field_t          *value;      /**< Value scanned */
+    size_t                     generation; /**< Generation of @c value */
+    const char                *data;       /**< Data of @c value */
+    size_t                     len;        /**< Length of @c data */
+} prefilter_cache_key_t;
+
+/**
+ * Per-transaction selection of a phase's context rules via the phase's
+ * target index.
+ */
+typedef struct {
+    const ib_rule_phase_index_t *index;      /**< Phase target index */
+    const ib_data_t             *data;       /**< Transaction data */
+    bool                        *selected;   /**< Per rule: run the rule */
+    bool                        *present;    /**< Per field: field exists */
+    size_t                       generation; /**< Data generation checked */
+} phase_select_t;
+
 /**
  * The rule engine uses recursion to walk through lists and chains.  These
  * define the limits of the recursion depth.
@@ -401,6 +447,26 @@ ib_status_t ib_rule_exec_create(ib_tx_t *tx,
         return rc;
     }
 
+    /* Create the transformation cache; without it tfns are always run */
+    rc = ib_hash_create(&(exec->tfn_cache), tx->mp);
+    if (rc != IB_OK) {
+        ib_rule_log_tx_warn(tx, "Failed to create transformation cache: %s",
+                            ib_status_to_string(rc));
+        exec->tfn_cache = NULL;
+    }
+
+    /* Create the prefilter cache; without it values are rescanned */
+    rc = ib_hash_create(&(exec->prefilter_cache), tx->mp);
+    if (rc != IB_OK) {
+        ib_rule_log_tx_warn(tx, "Failed to create prefilter cache: %s",
+                            ib_status_to_string(rc));
+        exec->prefilter_cache = NULL;
+    }
+
+    /* Bodies are collected once the transaction's context is known */
+    exec->request_body = NULL;
+    exec->response_body = NULL;
+
     /* Create the TX log object */
     rc = ib_rule_log_tx_create(exec, &(exec->tx_log));
     if (rc != IB_OK) {
@@ -735,25 +801,123 @@ static ib_status_t execute_tfn_single(const ib_rule_exec_t *rule_exec,
     return rc;
 }
 
+/**
+ * Compute the transformation cache fingerprint of a value.
+ *
+ * The fingerprint changes whenever the value of a field is replaced or
+ * modified in place, so that results cached for an old value are never
+ * returned for a new one.  It combines the field's generation with the
+ * value pointer and length; for lists, the generations of the members are
+ * folded in as well.  Dynamic fields and types which can't be
+ * fingerprinted are not cached.
+ *
+ * @param[in] value Value to fingerprint
+ * @param[out] fp Fingerprint (TFN_CACHE_FP_LEN words)
+ *
+ * @returns true if @a value can be cached, otherwise false
+ */
+static bool tfn_cache_fingerprint(const ib_field_t *value,
+                                  uintptr_t *fp)
+{
+    assert(value != NULL);
+    assert(fp != NULL);
+
+    if (ib_field_is_dynamic(value)) {
+        return false;
+    }
+    fp[0] = (uintptr_t)ib_field_generation(value);
+
+    switch (value->type) {
+    case IB_FTYPE_NULSTR: {
+        const char *s;
+        if (ib_field_value(value, ib_ftype_nulstr_out(&s)) != IB_OK) {
+            return false;
+        }
+        fp[1] = (uintptr_t)s;
+        fp[2] = 0;
+        return true;
+    }
+    case IB_FTYPE_BYTESTR: {
+        const ib_bytestr_t *bs;
+        if (ib_field_value(value, ib_ftype_bytestr_out(&bs)) != IB_OK) {
+            return false;
+        }
+        fp[1] = (uintptr_t)ib_bytestr_const_ptr(bs);
+        fp[2] = (uintptr_t)ib_bytestr_length(bs);
+        return true;
+    }
+    case IB_FTYPE_LIST: {
+        const ib_list_t      *list;
+        const ib_list_node_t *node;
+        uintptr_t             members;
+        if (ib_field_value(value, ib_ftype_list_out(&list)) != IB_OK) {
+            return false;
+        }
+        members = (uintptr_t)ib_list_elements(list);
+        IB_LIST_LOOP_CONST(list, node) {
+            const ib_field_t *member =
+                (const ib_field_t *)ib_list_node_data_const(node);
+            members = (members * 31) + (uintptr_t)member;
+            if (member != NULL) {
+                members = (members * 31) + ib_field_generation(member);
+            }
+        }
+        fp[1] = (uintptr_t)list;
+        fp[2] = members;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+ * Replay the transformations of a cached prefix into the execution log.
+ *
+ * @param[in] rule_exec The rule execution object
+ * @param[in] entry Cache entry of the prefix
+ */
+static void tfn_cache_log_replay(const ib_rule_exec_t *rule_exec,
+                                 const tfn_cache_entry_t *entry)
+{
+    if (entry->prev != NULL) {
+        tfn_cache_log_replay(rule_exec, entry->prev);
+    }
+    ib_rule_log_exec_tfn_add(rule_exec->exec_log, entry->tfn);
+    ib_rule_log_exec_tfn_fin(rule_exec->exec_log, entry->tfn,
+                             entry->in, entry->out, IB_OK);
+}
+
 /**
  * Execute list of transformations on a target.
  *
+ * Results are memoized in the transaction's transformation cache, keyed by
+ * the source field and transformation prefix.  The longest cached prefix of
+ * the target's transformations is reused, and only the remainder is run.
+ *
  * @param[in] rule_exec The rule execution object
+ * @param[in] ctarget Compiled target
  * @param[in] value Initial value of the target field
  * @param[out] result Pointer to field in which to store the result
  *
  * @returns Status code
  */
 static ib_status_t execute_tfns(const ib_rule_exec_t *rule_exec,
+                                const ib_rule_compiled_target_t *ctarget,
                                 const ib_field_t *value,
                                 const ib_field_t **result)
 {
-    ib_status_t          rc;
-    const ib_list_node_t *node = NULL;
-    const ib_field_t     *in_field;
-    ib_field_t           *out = NULL;
+    ib_status_t              rc;
+    const ib_field_t        *in_field;
+    ib_field_t              *out = NULL;
+    uintptr_t               *key = NULL;
+    const tfn_cache_entry_t *prev = NULL;
+    size_t                   ntfns;
+    size_t                   cached = 0;
+    size_t                   n;
 
     assert(rule_exec != NULL);
+    assert(ctarget != NULL);
     assert(result != NULL);
 
     /* No transformations?  Do nothing. */
@@ -761,21 +925,60 @@ static ib_status_t execute_tfns(const ib_rule_exec_t *rule_exec,
         *result = NULL;
         return IB_OK;
     }
-    else if (IB_LIST_ELEMENTS(rule_exec->target->tfn_list) == 0) {
+    ntfns = ctarget->num_tfns;
+    if (ntfns == 0) {
         *result = value;
         ib_rule_log_trace(rule_exec, "No transformations");
         return IB_OK;
     }
 
+    /* Look up the longest cached prefix of the transformation chain. */
+    if (rule_exec->tfn_cache != NULL) {
+        uintptr_t fp[TFN_CACHE_FP_LEN];
+
+        if (tfn_cache_fingerprint(value, fp)) {
+            key = ib_mpool_alloc(rule_exec->tx->mp, TFN_CACHE_KEY_LEN(ntfns));
+        }
+        if (key != NULL) {
+            key[0] = (uintptr_t)value;
+            memcpy(&key[1], fp, sizeof(fp));
+            for (n = 0;  n < ntfns;  ++n) {
+                key[TFN_CACHE_KEY_HDR + n] = (uintptr_t)ctarget->tfns[n];
+            }
+
+            for (cached = ntfns; cached > 0; --cached) {
+                rc = ib_hash_get_ex(rule_exec->tfn_cache, (void *)&prev,
+                                    key, TFN_CACHE_KEY_LEN(cached));
+                if (rc == IB_OK) {
+                    break;
+                }
+            }
+            ib_rule_log_tx_tfn_cache(rule_exec->tx_log, (cached != 0));
+        }
+    }
+
+    if (cached == 0) {
+        prev = NULL;
+        in_field = value;
+    }
+    else {
+        ib_rule_log_trace(rule_exec, "Reusing %zd of %zd transformations",
+                          cached, ntfns);
+        if (rule_exec->exec_log != NULL) {
+            tfn_cache_log_replay(rule_exec, prev);
+        }
+        in_field = prev->out;
+    }
+
     ib_rule_log_trace(rule_exec, "Executing %zd transformations",
-                      IB_LIST_ELEMENTS(rule_exec->target->tfn_list));
+                      ntfns - cached);
 
     /*
-     * Loop through all of the target's transformations.
+     * Loop through all of the target's uncached transformations.
      */
-    in_field = value;
-    IB_LIST_LOOP_CONST(rule_exec->target->tfn_list, node) {
-        const ib_tfn_t  *tfn = (const ib_tfn_t *)node->data;
+    for (n = cached;  n < ntfns;  ) {
+        const ib_tfn_t  *tfn = ctarget->tfns[n++];
+        tfn_cache_entry_t *entry;
 
         /* Run it */
         ib_rule_log_trace(rule_exec, "Executing transformation %s", tfn->name);
@@ -797,17 +1000,219 @@ static ib_status_t execute_tfns(const ib_rule_exec_t *rule_exec,
             return IB_EINVAL;
         }
 
+        /* Cache the result of this prefix; the key is shared by all
+         * prefixes of the chain, only the length differs. */
+        if ( (key != NULL) && (rc == IB_OK) ) {
+            entry = ib_mpool_alloc(rule_exec->tx->mp, sizeof(*entry));
+            if (entry == NULL) {
+                key = NULL;
+            }
+            else {
+                entry->tfn = tfn;
+                entry->in = in_field;
+                entry->out = out;
+                entry->prev = prev;
+                rc = ib_hash_set_ex(rule_exec->tfn_cache,
+                                    key, TFN_CACHE_KEY_LEN(n), entry);
+                if (rc != IB_OK) {
+                    key = NULL;
+                }
+                prev = entry;
+            }
+        }
+        else {
+            key = NULL;
+        }
+
         /* The output of the operator is now input for the next field op. */
         in_field = out;
     }
 
     /* The output of the final operator is the result */
-    *result = out;
+    *result = in_field;
 
     /* Done. */
     return IB_OK;
 }
 
+/**
+ * Seed the transformation cache with a result computed elsewhere.
+ *
+ * @param[in] rule_exec The rule execution object
+ * @param[in] value Source field
+ * @param[in] tfn Transformation applied to @a value
+ * @param[in] out Result of @a tfn
+ *
+ * @returns Status code
+ */
+static ib_status_t tfn_cache_seed(const ib_rule_exec_t *rule_exec,
+                                  const ib_field_t *value,
+                                  const ib_tfn_t *tfn,
+                                  const ib_field_t *out)
+{
+    assert(rule_exec != NULL);
+    assert(value != NULL);
+    assert(tfn != NULL);
+    assert(out != NULL);
+
+    tfn_cache_entry_t *entry;
+    uintptr_t         *key;
+    uintptr_t          fp[TFN_CACHE_FP_LEN];
+
+    if ( (rule_exec->tfn_cache == NULL) ||
+         (! tfn_cache_fingerprint(value, fp)) )
+    {
+        return IB_OK;
+    }
+
+    key = ib_mpool_alloc(rule_exec->tx->mp, TFN_CACHE_KEY_LEN(1));
+    entry = ib_mpool_alloc(rule_exec->tx->mp, sizeof(*entry));
+    if ( (key == NULL) || (entry == NULL) ) {
+        return IB_EALLOC;
+    }
+    key[0] = (uintptr_t)value;
+    memcpy(&key[1], fp, sizeof(fp));
+    key[TFN_CACHE_KEY_HDR] = (uintptr_t)tfn;
+    entry->tfn = tfn;
+    entry->in = value;
+    entry->out = out;
+    entry->prev = NULL;
+
+    return ib_hash_set_ex(rule_exec->tfn_cache,
+                          key, TFN_CACHE_KEY_LEN(1), entry);
+}
+
+/**
+ * Append body data to a transaction's body view.
+ *
+ * Nothing is kept unless the context's phase rules target the body.  The
+ * view is created with the first chunk, once the transaction's context is
+ * known.  Data past the context's body limit is dropped.
+ *
+ * @param[in] rule_exec The rule execution object
+ * @param[in] targets Body targets of the transaction's context
+ * @param[in,out] view Body view of the transaction
+ * @param[in] txdata Body data
+ *
+ * @returns Status code
+ */
+static ib_status_t body_view_append(const ib_rule_exec_t *rule_exec,
+                                    const ib_rule_body_targets_t *targets,
+                                    ib_rule_body_view_t **view,
+                                    const ib_txdata_t *txdata)
+{
+    assert(rule_exec != NULL);
+    assert(targets != NULL);
+    assert(view != NULL);
+    assert(txdata != NULL);
+
+    bool        truncated;
+    ib_status_t rc;
+
+    if (! targets->targeted) {
+        return IB_OK;
+    }
+
+    if (*view == NULL) {
+        rc = ib_rule_body_view_create(rule_exec->ib, rule_exec->tx->mp,
+                                      targets->tfns, targets->num_tfns,
+                                      targets->limit, view);
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    truncated = ib_rule_body_view_truncated(*view);
+    rc = ib_rule_body_view_append(*view, txdata->data, txdata->dlen);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    if (! truncated && ib_rule_body_view_truncated(*view)) {
+        ib_rule_log_tx_notice(rule_exec->tx,
+                              "Body collection limit of %zd bytes reached; "
+                              "phase rules will see a truncated body",
+                              targets->limit);
+    }
+
+    return IB_OK;
+}
+
+/**
+ * Finish a transaction's body view, and make it available to phase rules.
+ *
+ * The body is added to the transaction's data as @a name, and its
+ * transformed views are added to the transformation cache.
+ *
+ * @param[in] rule_exec The rule execution object
+ * @param[in] targets Body targets of the transaction's context
+ * @param[in,out] view Body view of the transaction
+ * @param[in] name Name of the body field
+ *
+ * @returns Status code
+ */
+static ib_status_t body_view_publish(const ib_rule_exec_t *rule_exec,
+                                     const ib_rule_body_targets_t *targets,
+                                     ib_rule_body_view_t **view,
+                                     const char *name)
+{
+    assert(rule_exec != NULL);
+    assert(targets != NULL);
+    assert(view != NULL);
+    assert(name != NULL);
+
+    ib_field_t  *body;
+    ib_field_t **tfn_out = NULL;
+    size_t       n;
+    ib_status_t  rc;
+
+    if (! targets->targeted) {
+        return IB_OK;
+    }
+
+    /* No body data: publish an empty body. */
+    if (*view == NULL) {
+        rc = ib_rule_body_view_create(rule_exec->ib, rule_exec->tx->mp,
+                                      targets->tfns, targets->num_tfns,
+                                      targets->limit, view);
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    if (targets->num_tfns != 0) {
+        tfn_out = ib_mpool_alloc(rule_exec->tx->mp,
+                                 targets->num_tfns * sizeof(*tfn_out));
+        if (tfn_out == NULL) {
+            return IB_EALLOC;
+        }
+    }
+    rc = ib_rule_body_view_finish(*view, name, strlen(name), &body, tfn_out);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_data_add(rule_exec->tx->data, body);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    for (n = 0;  n < targets->num_tfns;  ++n) {
+        rc = tfn_cache_seed(rule_exec, body, targets->tfns[n], tfn_out[n]);
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    ib_rule_log_tx_debug(rule_exec->tx,
+                         "Collected %zd bytes of %s%s "
+                         "with %zd streamed transformations",
+                         ib_rule_body_view_length(*view), name,
+                         ib_rule_body_view_truncated(*view) ?
+                             " (truncated)" : "",
+                         targets->num_tfns);
+
+    return IB_OK;
+}
+
 /**
  * Execute a single rule action
  *
@@ -844,21 +1249,23 @@ static ib_status_t execute_action(const ib_rule_exec_t *rule_exec,
  *
  * @param[in] rule_exec Rule execution object
  * @param[in] result Rule execution result
- * @param[in] actions List of actions to execute
+ * @param[in] actions Array of actions to execute
+ * @param[in] num_actions Number of actions in @a actions
  *
  * @returns Status code
  */
 static ib_status_t execute_action_list(const ib_rule_exec_t *rule_exec,
                                        ib_num_t result,
-                                       const ib_list_t *actions)
+                                       const ib_action_inst_t * const *actions,
+                                       size_t num_actions)
 {
     assert(rule_exec != NULL);
 
-    const ib_list_node_t *node = NULL;
     ib_status_t           rc = IB_OK;
     const char           *name;
+    size_t                n;
 
-    if (actions == NULL) {
+    if ( (actions == NULL) || (num_actions == 0) ) {
         return IB_OK;
     }
 
@@ -872,9 +1279,9 @@ static ib_status_t execute_action_list(const ib_rule_exec_t *rule_exec,
      * returns an error.  This needs further discussion to determine what the
      * correct behavior should be.
      */
-    IB_LIST_LOOP_CONST(actions, node) {
+    for (n = 0;  n < num_actions;  ++n) {
         ib_status_t       arc;     /* Action's return code */
-        const ib_action_inst_t *action = (const ib_action_inst_t *)node->data;
+        const ib_action_inst_t *action = actions[n];
 
         /* Execute the action */
         arc = execute_action(rule_exec, result, action);
@@ -956,11 +1363,14 @@ static void clear_target_fields(ib_rule_exec_t *rule_exec)
 
     ib_rule_log_trace(rule_exec, "Destroying target fields");
 
-    ib_data_remove(rule_exec->tx->data, "FIELD", NULL);
-    ib_data_remove(rule_exec->tx->data, "FIELD_TARGET", NULL);
-    ib_data_remove(rule_exec->tx->data, "FIELD_TFN", NULL);
-    ib_data_remove(rule_exec->tx->data, "FIELD_NAME", NULL);
-    ib_data_remove(rule_exec->tx->data, "FIELD_NAME_FULL", NULL);
+    ib_data_remove_id(rule_exec->tx->data, IB_DATA_FIELD_ID_FIELD, NULL);
+    ib_data_remove_id(rule_exec->tx->data, IB_DATA_FIELD_ID_FIELD_TARGET,
+                      NULL);
+    ib_data_remove_id(rule_exec->tx->data, IB_DATA_FIELD_ID_FIELD_TFN, NULL);
+    ib_data_remove_id(rule_exec->tx->data, IB_DATA_FIELD_ID_FIELD_NAME,
+                      NULL);
+    ib_data_remove_id(rule_exec->tx->data, IB_DATA_FIELD_ID_FIELD_NAME_FULL,
+                      NULL);
 
     return;
 }
@@ -1008,10 +1418,8 @@ static ib_status_t set_target_fields(ib_rule_exec_t *rule_exec,
     value = (const ib_field_t *)node->data;
 
     /* Create FIELD */
-    (void)ib_data_remove(tx->data, "FIELD", NULL);
-    trc = ib_data_add_named(tx->data,
-                            (ib_field_t *)value,
-                            IB_FIELD_NAME("FIELD"));
+    trc = ib_data_set_id(tx->data, IB_DATA_FIELD_ID_FIELD,
+                         (ib_field_t *)value);
     if (trc != IB_OK) {
         ib_rule_log_error(rule_exec,
                           "Failed to create FIELD: %s",
@@ -1021,10 +1429,8 @@ static ib_status_t set_target_fields(ib_rule_exec_t *rule_exec,
 
     /* Create FIELD_TFN */
     if (transformed != NULL) {
-        (void)ib_data_remove(tx->data, "FIELD_TFN", NULL);
-        trc = ib_data_add_named(tx->data,
-                                (ib_field_t *)value,
-                                IB_FIELD_NAME("FIELD_TFN"));
+        trc = ib_data_set_id(tx->data, IB_DATA_FIELD_ID_FIELD_TFN,
+                             (ib_field_t *)value);
         if (trc != IB_OK) {
             ib_rule_log_error(rule_exec,
                               "Failed to create FIELD_TFN: %s",
@@ -1035,7 +1441,8 @@ static ib_status_t set_target_fields(ib_rule_exec_t *rule_exec,
 
     /* Create FIELD_TARGET */
     if (target != NULL) {
-        trc = ib_data_get(tx->data, "FIELD_TARGET", &f);
+        trc = ib_data_get_id(tx->data, IB_DATA_FIELD_ID_FIELD_TARGET,
+                             IB_FIELD_NAME("FIELD_TARGET"), &f);
         if (trc == IB_ENOENT) {
             trc = ib_data_add_nulstr_ex(tx->data,
                                         IB_FIELD_NAME("FIELD_TARGET"),
@@ -1054,7 +1461,8 @@ static ib_status_t set_target_fields(ib_rule_exec_t *rule_exec,
     }
 
     /* Create FIELD_NAME */
-    trc = ib_data_get(tx->data, "FIELD_NAME", &f);
+    trc = ib_data_get_id(tx->data, IB_DATA_FIELD_ID_FIELD_NAME,
+                         IB_FIELD_NAME("FIELD_NAME"), &f);
     if (trc == IB_ENOENT) {
         trc = ib_data_add_bytestr_ex(tx->data,
                                      IB_FIELD_NAME("FIELD_NAME"),
@@ -1119,7 +1527,8 @@ static ib_status_t set_target_fields(ib_rule_exec_t *rule_exec,
     }
 
     /* Step 3: Update the FIELD_NAME_FULL field. */
-    trc = ib_data_get(tx->data, "FIELD_NAME_FULL", &f);
+    trc = ib_data_get_id(tx->data, IB_DATA_FIELD_ID_FIELD_NAME_FULL,
+                         IB_FIELD_NAME("FIELD_NAME_FULL"), &f);
     if (trc == IB_ENOENT) {
         trc = ib_data_add_bytestr_ex(tx->data,
                                      IB_FIELD_NAME("FIELD_NAME_FULL"),
@@ -1142,20 +1551,111 @@ static ib_status_t set_target_fields(ib_rule_exec_t *rule_exec,
     return rc;
 }
 
+/**
+ * Check a value against a rule's prefilter.
+ *
+ * The result of scanning a value is cached in the transaction, so that
+ * the value is scanned only once for all of the phase's rules.  The cache
+ * key includes the field's generation, so a value modified in place is
+ * scanned again.  Values which can't be fingerprinted are never filtered.
+ *
+ * @param[in] rule_exec The rule execution object
+ * @param[in] crule Compiled rule
+ * @param[in] value Value the operator is to be executed on
+ *
+ * @returns false if the rule's operator can not match @a value
+ */
+static bool prefilter_check(const ib_rule_exec_t *rule_exec,
+                            const ib_rule_compiled_t *crule,
+                            const ib_field_t *value)
+{
+    assert(rule_exec != NULL);
+    assert(crule != NULL);
+
+    prefilter_cache_key_t  key;
+    prefilter_cache_key_t *entry;
+    uint8_t               *result;
+    ib_status_t            rc;
+
+    if ( (crule->prefilter == NULL) ||
+         (value == NULL) ||
+         ib_field_is_dynamic(value) )
+    {
+        return true;
+    }
+
+    memset(&key, 0, sizeof(key));
+    key.prefilter = crule->prefilter;
+    key.value = value;
+    key.generation = ib_field_generation(value);
+    switch (value->type) {
+    case IB_FTYPE_NULSTR: {
+        const char *s;
+        if (ib_field_value(value, ib_ftype_nulstr_out(&s)) != IB_OK) {
+            return true;
+        }
+        key.data = s;
+        key.len = (s == NULL) ? 0 : strlen(s);
+        break;
+    }
+    case IB_FTYPE_BYTESTR: {
+        const ib_bytestr_t *bs;
+        if (ib_field_value(value, ib_ftype_bytestr_out(&bs)) != IB_OK) {
+            return true;
+        }
+        key.data = (const char *)ib_bytestr_const_ptr(bs);
+        key.len = ib_bytestr_length(bs);
+        break;
+    }
+    default:
+        return true;
+    }
+
+    if ( (rule_exec->prefilter_cache != NULL) &&
+         (ib_hash_get_ex(rule_exec->prefilter_cache, (void *)&entry,
+                         &key, sizeof(key)) == IB_OK) )
+    {
+        result = (uint8_t *)(entry + 1);
+    }
+    else {
+        entry = ib_mpool_alloc(rule_exec->tx->mp,
+                               sizeof(*entry) +
+                               IB_RULE_PREFILTER_RESULT_SIZE(key.prefilter));
+        if (entry == NULL) {
+            return true;
+        }
+        *entry = key;
+        result = (uint8_t *)(entry + 1);
+        rc = ib_rule_prefilter_scan(key.prefilter, key.data, key.len, result);
+        if (rc != IB_OK) {
+            return true;
+        }
+        if (rule_exec->prefilter_cache != NULL) {
+            ib_hash_set_ex(rule_exec->prefilter_cache,
+                           entry, sizeof(*entry), entry);
+        }
+    }
+
+    return IB_RULE_PREFILTER_TEST(result, crule->prefilter_slot);
+}
+
 /**
  * Execute a rule on a list of values
  *
  * @param[in] rule_exec Rule execution object
+ * @param[in] crule Compiled rule being executed
  * @param[in] value Field value to operate on
  * @param[in] recursion Recursion limit -- won't recurse if recursion is zero
  *
  * @returns Status code
  */
 static ib_status_t execute_operator(ib_rule_exec_t *rule_exec,
+                                    const ib_rule_compiled_t *crule,
                                     const ib_field_t *value,
                                     int recursion)
 {
     assert(rule_exec != NULL);
+    assert(crule != NULL);
     assert(rule_exec->rule != NULL);
     assert(rule_exec->rule->opinst != NULL);
     assert(rule_exec->target != NULL);
@@ -1266,7 +1766,7 @@ static ib_status_t execute_operator(ib_rule_exec_t *rule_exec,
             pushed = rule_exec_push_value(rule_exec, nvalue);
 
             /* Recursive call. */
-            rc = execute_operator(rule_exec, nvalue, recursion);
+            rc = execute_operator(rule_exec, crule, nvalue, recursion);
             if (rc != IB_OK) {
                 ib_rule_log_warn(rule_exec,
                                  "Error executing list element #%d: %s",
@@ -1281,7 +1781,8 @@ static ib_status_t execute_operator(ib_rule_exec_t *rule_exec,
 
     /* No recursion required, handle it here */
     else {
-        ib_list_t  *actions;
+        const ib_action_inst_t * const *actions;
+        size_t      num_actions;
         ib_num_t    result = 0;
         ib_status_t op_rc = IB_OK;
         ib_status_t act_rc = IB_OK;
@@ -1294,10 +1795,16 @@ static ib_status_t execute_operator(ib_rule_exec_t *rule_exec,
                               ib_status_to_string(rc));
         }
 
-        /* Execute the operator */
-        /* @todo remove the cast-away of the constness of value */
-        op_rc = ib_operator_execute(rule_exec, opinst,
-                                    (ib_field_t *)value, &result);
+        /* Execute the operator, unless the prefilter rules out a match */
+        if (! prefilter_check(rule_exec, crule, value)) {
+            ib_rule_log_trace(rule_exec, "Operator skipped by prefilter");
+            op_rc = IB_OK;
+        }
+        else {
+            /* @todo remove the cast-away of the constness of value */
+            op_rc = ib_operator_execute(rule_exec, opinst,
+                                        (ib_field_t *)value, &result);
+        }
         if (op_rc != IB_OK) {
             ib_rule_log_warn(rule_exec, "Operator returned an error: %s",
                              ib_status_to_string(op_rc));
@@ -1325,16 +1832,19 @@ static ib_status_t execute_operator(ib_rule_exec_t *rule_exec,
         }
         if (op_rc != IB_OK) {
             actions = NULL;
+            num_actions = 0;
         }
         else if (result != 0) {
-            actions = rule_exec->rule->true_actions;
+            actions = crule->true_actions;
+            num_actions = crule->num_true_actions;
         }
         else {
-            actions = rule_exec->rule->false_actions;
+            actions = crule->false_actions;
+            num_actions = crule->num_false_actions;
         }
 
         ib_rule_log_exec_add_result(rule_exec->exec_log, value, result);
-        act_rc = execute_action_list(rule_exec, result, actions);
+        act_rc = execute_action_list(rule_exec, result, actions, num_actions);
 
         /* Done. */
         clear_target_fields(rule_exec);
@@ -1353,20 +1863,24 @@ static ib_status_t execute_operator(ib_rule_exec_t *rule_exec,
  * Execute a single rule's operator on all target fields.
  *
  * @param[in] rule_exec Rule execution object
+ * @param[in] crule Compiled rule being executed
  *
  * @returns Status code
  */
-static ib_status_t execute_phase_rule_targets(ib_rule_exec_t *rule_exec)
+static ib_status_t execute_phase_rule_targets(ib_rule_exec_t *rule_exec,
+                                              const ib_rule_compiled_t *crule)
 {
     assert(rule_exec != NULL);
     assert(rule_exec->rule != NULL);
     assert(rule_exec->tx != NULL);
+    assert(crule != NULL);
+    assert(crule->rule == rule_exec->rule);
 
     ib_tx_t            *tx = rule_exec->tx;
     ib_rule_t          *rule = rule_exec->rule;
     ib_operator_inst_t *opinst = rule_exec->rule->opinst;
     ib_status_t         rc = IB_OK;
-    ib_list_node_t     *node = NULL;
+    size_t              tnum;
 
     /* Special case: External rules */
     if (ib_flags_all(rule->flags, IB_RULE_FLAG_EXTERNAL)) {
@@ -1396,14 +1910,14 @@ static ib_status_t execute_phase_rule_targets(ib_rule_exec_t *rule_exec)
 
     /* If this is a no-target rule (i.e. action), do nothing */
     if (ib_flags_all(rule->flags, IB_RULE_FLAG_NO_TGT)) {
-        assert(ib_list_elements(rule->target_fields) == 1);
+        assert(crule->num_targets == 1);
     }
     else {
-        assert(ib_list_elements(rule->target_fields) != 0);
+        assert(crule->num_targets != 0);
     }
 
     ib_rule_log_debug(rule_exec, "Operating on %zd fields.",
-                      ib_list_elements(rule->target_fields));
+                      (size_t)crule->num_targets);
 
     /*
      * Loop through all of the fields.
@@ -1412,8 +1926,9 @@ static ib_status_t execute_phase_rule_targets(ib_rule_exec_t *rule_exec)
      * returns an error.  This needs further discussion to determine what the
      * correct behavior should be.
      */
-    IB_LIST_LOOP(rule->target_fields, node) {
-        ib_rule_target_t   *target = (ib_rule_target_t *)node->data;
+    for (tnum = 0;  tnum < crule->num_targets;  ++tnum) {
+        const ib_rule_compiled_target_t *ctarget = &(crule->targets[tnum]);
+        ib_rule_target_t   *target = ctarget->target;
         assert(target != NULL);
         const char         *fname = target->field_name;
         assert(fname != NULL);
@@ -1427,7 +1942,8 @@ static ib_status_t execute_phase_rule_targets(ib_rule_exec_t *rule_exec)
         rule_exec_set_target(rule_exec, target);
 
         /* Get the field value */
-        getrc = ib_data_get(tx->data, fname, &value);
+        getrc = ib_data_get_id(tx->data, target->field_id,
+                               fname, target->field_nlen, &value);
         if (getrc == IB_ENOENT) {
             bool allow  =
                 ib_flags_all(opinst->op->flags, IB_OP_FLAG_ALLOW_NULL);
@@ -1460,7 +1976,7 @@ static ib_status_t execute_phase_rule_targets(ib_rule_exec_t *rule_exec)
 
         /* Execute the target transformations */
         if (value != NULL) {
-            rc = execute_tfns(rule_exec, value, &tfnvalue);
+            rc = execute_tfns(rule_exec, ctarget, value, &tfnvalue);
             if (rc != IB_OK) {
                 return rc;
             }
@@ -1504,7 +2020,7 @@ static ib_status_t execute_phase_rule_targets(ib_rule_exec_t *rule_exec)
                 lpushed = rule_exec_push_value(rule_exec, node_value);
 
 
-                rc = execute_operator(rule_exec, node_value,
+                rc = execute_operator(rule_exec, crule, node_value,
                                       MAX_LIST_RECURSION);
                 if (rc != IB_OK) {
                     ib_rule_log_error(rule_exec,
@@ -1519,7 +2035,8 @@ static ib_status_t execute_phase_rule_targets(ib_rule_exec_t *rule_exec)
         }
         else {
             ib_rule_log_trace(rule_exec, "calling exop on single target");
-            rc = execute_operator(rule_exec, tfnvalue, MAX_LIST_RECURSION);
+            rc = execute_operator(rule_exec, crule, tfnvalue,
+                                  MAX_LIST_RECURSION);
             if (rc != IB_OK) {
                 ib_rule_log_error(rule_exec,
                                   "Operator returned an error: %s",
@@ -1554,21 +2071,23 @@ static ib_status_t execute_phase_rule_targets(ib_rule_exec_t *rule_exec)
  * Execute a single phase rule, it's actions, and it's chained rules.
  *
  * @param[in] rule_exec Rule execution object
- * @param[in] rule Rule to execute
+ * @param[in] crule Compiled rule to execute
  * @param[in] recursion Recursion limit
  *
  * @returns Status code
  */
 static ib_status_t execute_phase_rule(ib_rule_exec_t *rule_exec,
-                                      const ib_rule_t *rule,
+                                      const ib_rule_compiled_t *crule,
                                       int recursion)
 {
     ib_status_t         rc = IB_OK;
     ib_status_t         trc;          /* Temporary status code */
 
     assert(rule_exec != NULL);
-    assert(rule != NULL);
-    assert(! rule->phase_meta->is_stream);
+    assert(crule != NULL);
+    assert(! crule->rule->phase_meta->is_stream);
+
+    const ib_rule_t    *rule = crule->rule;
 
 
     --recursion;
@@ -1595,7 +2114,7 @@ static ib_status_t execute_phase_rule(ib_rule_exec_t *rule_exec,
      * returns an error.  This needs further discussion to determine what the
      * correct behavior should be.
      */
-    trc = execute_phase_rule_targets(rule_exec);
+    trc = execute_phase_rule_targets(rule_exec, crule);
     if (trc != IB_OK) {
         rc = trc;
         goto cleanup;
@@ -1610,11 +2129,11 @@ static ib_status_t execute_phase_rule(ib_rule_exec_t *rule_exec,
      *
      * @note Chaining is currently done via recursion.
      */
-    if ( (rule_exec->result != 0) && (rule->chained_rule != NULL) ) {
+    if ( (rule_exec->result != 0) && (crule->chained != NULL) ) {
         ib_rule_log_debug(rule_exec,
                           "Chaining to rule \"%s\"",
                           ib_rule_id(rule->chained_rule));
-        trc = execute_phase_rule(rule_exec, rule->chained_rule, recursion);
+        trc = execute_phase_rule(rule_exec, crule->chained, recursion);
 
         if (trc != IB_OK) {
             ib_rule_log_error(rule_exec,
@@ -1792,59 +2311,407 @@ static ib_status_t inject_rules(const ib_engine_t *ib,
 }
 
 /**
- * Append context rules onto the rule execution object's phase rule list
- *
- * @param[in] ib IronBee engine
- * @param[in] phase_meta Phase meta data
- * @param[in] rule_list List of context rules to append
- * @param[in,out] rule_exec Rule execution object
+ * Sizes of the arrays of a compiled ruleset.
+ */
+typedef struct {
+    size_t                 rules;        /**< Number of rules */
+    size_t                 targets;      /**< Number of targets */
+    size_t                 tfns;         /**< Number of transformations */
+    size_t                 actions;      /**< Number of actions */
+} compile_sizes_t;
+
+/**
+ * Add the array sizes needed to compile a rule and its chain.
  *
- * @returns Status code
+ * @param[in] rule Rule to compile
+ * @param[in,out] sizes Array sizes
  */
-static ib_status_t append_context_rules(const ib_engine_t *ib,
-                                        const ib_rule_phase_meta_t *phase_meta,
-                                        const ib_list_t *rule_list,
-                                        ib_rule_exec_t *rule_exec)
+static void compile_count_rule(const ib_rule_t *rule,
+                               compile_sizes_t *sizes)
 {
-    assert(ib != NULL);
-    assert(phase_meta != NULL);
-    assert(rule_exec != NULL);
-    assert(rule_list != NULL);
-
-    const ib_list_node_t *node;
+    assert(sizes != NULL);
 
-    IB_LIST_LOOP_CONST(rule_list, node) {
-        const ib_rule_ctx_data_t *ctx_rule =
-            (const ib_rule_ctx_data_t *)node->data;
+    for ( ;  rule != NULL;  rule = rule->chained_rule) {
+        const ib_list_node_t *node;
 
-        if (rule_is_runnable(ctx_rule)) {
-            ib_list_push(rule_exec->phase_rules, ctx_rule->rule);
+        ++sizes->rules;
+        sizes->targets += ib_list_elements(rule->target_fields);
+        IB_LIST_LOOP_CONST(rule->target_fields, node) {
+            const ib_rule_target_t *target =
+                (const ib_rule_target_t *)node->data;
+            sizes->tfns += ib_list_elements(target->tfn_list);
         }
+        sizes->actions +=
+            ib_list_elements(rule->true_actions) +
+            ib_list_elements(rule->false_actions);
     }
-
-    return IB_OK;
 }
 
 /**
- * Run a set of phase rules.
+ * Create an empty compiled ruleset with room for @a sizes.
  *
- * @param[in] ib Engine.
- * @param[in,out] tx Transaction.
- * @param[in] event Event type.
- * @param[in] cbdata Callback data (actually phase_rule_cbdata_t).
+ * @param[in] mp Memory pool for allocations
+ * @param[in] sizes Array sizes
+ * @param[out] pset New compiled ruleset
  *
  * @returns
  *   - IB_OK on success.
- *   - IB_DECLINED if the httpd plugin declines to block the traffic.
+ *   - IB_EALLOC on allocation failure.
  */
-static ib_status_t run_phase_rules(ib_engine_t *ib,
-                                   ib_tx_t *tx,
-                                   ib_state_event_type_t event,
-                                   void *cbdata)
+static ib_status_t compile_set_create(ib_mpool_t *mp,
+                                      const compile_sizes_t *sizes,
+                                      ib_rule_compiled_set_t **pset)
 {
-    assert(ib != NULL);
-    assert(tx != NULL);
-    assert(tx->ctx != NULL);
+    assert(mp != NULL);
+    assert(sizes != NULL);
+    assert(pset != NULL);
+
+    ib_rule_compiled_set_t *set;
+
+    set = ib_mpool_calloc(mp, 1, sizeof(*set));
+    if (set == NULL) {
+        return IB_EALLOC;
+    }
+    set->rules =
+        ib_mpool_calloc(mp, sizes->rules + 1, sizeof(*set->rules));
+    set->targets =
+        ib_mpool_calloc(mp, sizes->targets + 1, sizeof(*set->targets));
+    set->tfns =
+        ib_mpool_calloc(mp, sizes->tfns + 1, sizeof(*set->tfns));
+    set->actions =
+        ib_mpool_calloc(mp, sizes->actions + 1, sizeof(*set->actions));
+    if ( (set->rules == NULL) || (set->targets == NULL) ||
+         (set->tfns == NULL) || (set->actions == NULL) )
+    {
+        return IB_EALLOC;
+    }
+
+    *pset = set;
+    return IB_OK;
+}
+
+/**
+ * Append a list of actions to a compiled ruleset's action array.
+ *
+ * @param[in,out] set Compiled ruleset
+ * @param[in] actions List of actions
+ * @param[out] num Number of actions appended
+ *
+ * @returns Start of the appended actions
+ */
+static const ib_action_inst_t * const *compile_actions(
+    ib_rule_compiled_set_t *set,
+    const ib_list_t *actions,
+    uint32_t *num)
+{
+    const ib_action_inst_t **first = &(set->actions[set->num_actions]);
+    const ib_list_node_t    *node;
+
+    *num = 0;
+    IB_LIST_LOOP_CONST(actions, node) {
+        set->actions[set->num_actions++] =
+            (const ib_action_inst_t *)node->data;
+        ++(*num);
+    }
+
+    return first;
+}
+
+/**
+ * Compile a rule, and its chain, into a compiled ruleset.
+ *
+ * Chained rules are appended to the ruleset's rules.  The ruleset must
+ * have been sized with compile_count_rule().
+ *
+ * @param[in,out] set Compiled ruleset
+ * @param[out] crule Slot in @a set for the compiled rule
+ * @param[in] rule Rule to compile
+ */
+static void compile_rule(ib_rule_compiled_set_t *set,
+                         ib_rule_compiled_t *crule,
+                         ib_rule_t *rule)
+{
+    assert(set != NULL);
+    assert(crule != NULL);
+    assert(rule != NULL);
+
+    for (;;) {
+        const ib_list_node_t *node;
+        ib_rule_compiled_t   *chained;
+
+        crule->rule = rule;
+        crule->targets = &(set->targets[set->num_targets]);
+        crule->num_targets = 0;
+        IB_LIST_LOOP_CONST(rule->target_fields, node) {
+            ib_rule_compiled_target_t *ctarget =
+                &(set->targets[set->num_targets++]);
+            const ib_list_node_t      *tnode;
+
+            ctarget->target = (ib_rule_target_t *)node->data;
+            ctarget->tfns = &(set->tfns[set->num_tfns]);
+            ctarget->num_tfns = 0;
+            IB_LIST_LOOP_CONST(ctarget->target->tfn_list, tnode) {
+                set->tfns[set->num_tfns++] = (const ib_tfn_t *)tnode->data;
+                ++ctarget->num_tfns;
+            }
+            ++crule->num_targets;
+        }
+        crule->true_actions = compile_actions(set, rule->true_actions,
+                                              &crule->num_true_actions);
+        crule->false_actions = compile_actions(set, rule->false_actions,
+                                               &crule->num_false_actions);
+
+        if (rule->chained_rule == NULL) {
+            crule->chained = NULL;
+            break;
+        }
+        chained = &(set->rules[set->num_rules++]);
+        crule->chained = chained;
+        crule = chained;
+        rule = rule->chained_rule;
+    }
+}
+
+/**
+ * Get the compiled form of an injected rule.
+ *
+ * Rules owned by a module when the context was closed are found in the
+ * context's compiled ruleset; any other rule is compiled in the
+ * transaction's memory pool.
+ *
+ * @param[in] rule_exec Rule execution object
+ * @param[in] rule Injected rule
+ * @param[out] crule Compiled rule
+ *
+ * @returns Status code
+ */
+static ib_status_t compiled_injected_rule(const ib_rule_exec_t *rule_exec,
+                                          const ib_rule_t *rule,
+                                          const ib_rule_compiled_t **crule)
+{
+    assert(rule_exec != NULL);
+    assert(rule != NULL);
+    assert(crule != NULL);
+
+    const ib_rule_compiled_set_t *compiled =
+        rule_exec->tx->ctx->rules->compiled;
+    ib_rule_compiled_set_t       *set;
+    compile_sizes_t               sizes = { 0, 0, 0, 0 };
+    ib_status_t                   rc;
+
+    if ( (compiled != NULL) && (compiled->by_rule != NULL) ) {
+        rc = ib_hash_get_ex(compiled->by_rule, (void *)crule,
+                            &rule, sizeof(rule));
+        if (rc == IB_OK) {
+            return IB_OK;
+        }
+    }
+
+    compile_count_rule(rule, &sizes);
+    rc = compile_set_create(rule_exec->tx->mp, &sizes, &set);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    set->num_rules = 1;
+    compile_rule(set, &(set->rules[0]), (ib_rule_t *)rule);
+    *crule = &(set->rules[0]);
+
+    return IB_OK;
+}
+
+/**
+ * Iterator over the rules of a phase: injected rules first, followed by
+ * the context's rules.
+ */
+typedef struct {
+    const ib_rule_exec_t     *rule_exec;  /**< Rule execution object */
+    const ib_list_node_t     *node;       /**< Next injected rule node */
+    const ib_rule_compiled_t *rules;      /**< Context rules */
+    size_t                    num_rules;  /**< Number of context rules */
+    size_t                    next;       /**< Next context rule */
+} phase_rule_iter_t;
+
+/**
+ * Initialize a phase rule iterator
+ *
+ * @param[in] rule_exec Rule execution object (with the injected rules)
+ * @param[in] ruleset_phase Context ruleset for the phase
+ * @param[out] iter Iterator to initialize
+ */
+static void phase_rule_iter_init(const ib_rule_exec_t *rule_exec,
+                                 const ib_ruleset_phase_t *ruleset_phase,
+                                 phase_rule_iter_t *iter)
+{
+    assert(rule_exec != NULL);
+    assert(ruleset_phase != NULL);
+    assert(iter != NULL);
+
+    iter->rule_exec = rule_exec;
+    iter->node = ib_list_first_const(rule_exec->phase_rules);
+    iter->rules = ruleset_phase->rules;
+    iter->num_rules = ruleset_phase->num_rules;
+    iter->next = 0;
+}
+
+/**
+ * Get the next rule from a phase rule iterator
+ *
+ * @param[in,out] iter Iterator
+ * @param[out] position Position of the rule in the context rules, or
+ *             SIZE_MAX for injected rules
+ *
+ * @returns The next compiled rule, or NULL when done
+ */
+static const ib_rule_compiled_t *phase_rule_iter_next(
+    phase_rule_iter_t *iter,
+    size_t *position)
+{
+    assert(iter != NULL);
+    assert(position != NULL);
+
+    while (iter->node != NULL) {
+        const ib_rule_t          *rule = (const ib_rule_t *)iter->node->data;
+        const ib_rule_compiled_t *crule;
+        ib_status_t               rc;
+
+        iter->node = ib_list_node_next_const(iter->node);
+        rc = compiled_injected_rule(iter->rule_exec, rule, &crule);
+        if (rc != IB_OK) {
+            ib_rule_log_tx_error(iter->rule_exec->tx,
+                                 "Rule engine: Failed to compile "
+                                 "injected rule \"%s\": %s",
+                                 ib_rule_id(rule), ib_status_to_string(rc));
+            continue;
+        }
+        *position = SIZE_MAX;
+        return crule;
+    }
+    if (iter->next < iter->num_rules) {
+        *position = iter->next;
+        return &(iter->rules[iter->next++]);
+    }
+
+    return NULL;
+}
+
+/**
+ * Mark the rules of target fields which have appeared in the data.
+ *
+ * Fields already known to be present are not looked up again.
+ *
+ * @param[in,out] select Rule selection
+ */
+static void phase_select_update(phase_select_t *select)
+{
+    assert(select != NULL);
+
+    const ib_rule_phase_index_t *index = select->index;
+    size_t                       fnum;
+
+    select->generation = ib_data_generation(select->data);
+
+    for (fnum = 0;  fnum < index->num_fields;  ++fnum) {
+        const ib_rule_target_index_t *field = &(index->fields[fnum]);
+        ib_field_t                   *value;
+        size_t                        rnum;
+
+        if (select->present[fnum]) {
+            continue;
+        }
+        if (ib_data_get_ex(select->data,
+                           field->name, field->nlen, &value) != IB_OK)
+        {
+            continue;
+        }
+        select->present[fnum] = true;
+        for (rnum = 0;  rnum < field->num_rules;  ++rnum) {
+            select->selected[field->rules[rnum]] = true;
+        }
+    }
+}
+
+/**
+ * Initialize a transaction's selection of a phase's context rules.
+ *
+ * @param[in] rule_exec Rule execution object
+ * @param[in] index Phase target index
+ * @param[out] select Rule selection
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC on allocation failure.
+ */
+static ib_status_t phase_select_init(const ib_rule_exec_t *rule_exec,
+                                     const ib_rule_phase_index_t *index,
+                                     phase_select_t *select)
+{
+    assert(rule_exec != NULL);
+    assert(index != NULL);
+    assert(select != NULL);
+
+    ib_mpool_t *mp = rule_exec->tx->mp;
+    size_t      num;
+
+    select->index = index;
+    select->data = rule_exec->tx->data;
+    select->selected = ib_mpool_calloc(mp, index->num_rules + 1, sizeof(bool));
+    select->present = ib_mpool_calloc(mp, index->num_fields + 1, sizeof(bool));
+    if ( (select->selected == NULL) || (select->present == NULL) ) {
+        return IB_EALLOC;
+    }
+
+    for (num = 0;  num < index->num_always;  ++num) {
+        select->selected[index->always[num]] = true;
+    }
+    phase_select_update(select);
+
+    return IB_OK;
+}
+
+/**
+ * Check if a context rule is selected to run.
+ *
+ * Rules executed earlier in the phase may have added fields, in which case
+ * the fields that were absent are looked up again.
+ *
+ * @param[in,out] select Rule selection
+ * @param[in] position Position of the rule in the phase's context rules
+ *
+ * @returns true if the rule should run, otherwise false
+ */
+static bool phase_select_rule(phase_select_t *select,
+                              size_t position)
+{
+    assert(select != NULL);
+    assert(position < select->index->num_rules);
+
+    if (ib_data_generation(select->data) != select->generation) {
+        phase_select_update(select);
+    }
+
+    return select->selected[position];
+}
+
+/**
+ * Run a set of phase rules.
+ *
+ * @param[in] ib Engine.
+ * @param[in,out] tx Transaction.
+ * @param[in] event Event type.
+ * @param[in] cbdata Callback data (actually phase_rule_cbdata_t).
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_DECLINED if the httpd plugin declines to block the traffic.
+ */
+static ib_status_t run_phase_rules(ib_engine_t *ib,
+                                   ib_tx_t *tx,
+                                   ib_state_event_type_t event,
+                                   void *cbdata)
+{
+    assert(ib != NULL);
+    assert(tx != NULL);
+    assert(tx->ctx != NULL);
     assert(tx->rule_exec != NULL);
     assert(cbdata != NULL);
 
@@ -1853,8 +2720,14 @@ static ib_status_t run_phase_rules(ib_engine_t *ib,
     const ib_ruleset_phase_t   *ruleset_phase;
     ib_rule_exec_t             *rule_exec = tx->rule_exec;
     const ib_list_t            *rules;
-    const ib_list_node_t       *node = NULL;
+    const ib_rule_compiled_t   *crule;
+    phase_rule_iter_t           iter;
     ib_status_t                 rc = IB_OK;
+    phase_select_t              select;
+    bool                        use_index = false;
+    size_t                      num_rules;
+    size_t                      position;
+    size_t                      skipped = 0;
 
     ruleset_phase = &(ctx->rules->ruleset.phases[meta->phase_num]);
     assert(ruleset_phase != NULL);
@@ -1867,6 +2740,21 @@ static ib_status_t run_phase_rules(ib_engine_t *ib,
                       meta->phase_num, phase_name(meta),
                       ib_list_elements(rules));
 
+    /* Publish a body collected for this and later phases */
+    if (meta->phase_num == PHASE_REQUEST_BODY) {
+        rc = body_view_publish(rule_exec, &(ctx->rules->request_body),
+                               &(rule_exec->request_body), "request_body");
+    }
+    else if (meta->phase_num == PHASE_RESPONSE_BODY) {
+        rc = body_view_publish(rule_exec, &(ctx->rules->response_body),
+                               &(rule_exec->response_body), "response_body");
+    }
+    if (rc != IB_OK) {
+        ib_rule_log_tx_error(tx, "Error publishing body field: %s",
+                             ib_status_to_string(rc));
+        rc = IB_OK;
+    }
+
     /* Allow (skip) this phase? */
     if (rule_allow(tx, meta, NULL, false)) {
         rc = IB_OK;
@@ -1906,20 +2794,27 @@ static ib_status_t run_phase_rules(ib_engine_t *ib,
     rule_exec->is_stream = false;
     ib_list_clear(rule_exec->phase_rules);
 
-    /* Invoke all of the rule injectors */
+    /* Invoke all of the rule injectors; the context's own rules are
+     * executed directly from the context's rule array. */
     rc = inject_rules(ib, meta, rule_exec);
     if (rc != IB_OK) {
         return IB_EINVAL;
     }
+    num_rules =
+        IB_LIST_ELEMENTS(rule_exec->phase_rules) + ruleset_phase->num_rules;
 
-    /* Add all of the enabled "normal" rules to the list */
-    rc = append_context_rules(ib, meta, rules, rule_exec);
-    if (rc != IB_OK) {
-        return IB_EINVAL;
+    /* Select the context rules which target fields that exist */
+    if (ruleset_phase->index != NULL) {
+        assert(ruleset_phase->index->num_rules == ruleset_phase->num_rules);
+        rc = phase_select_init(rule_exec, ruleset_phase->index, &select);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        use_index = true;
     }
 
     /* Walk through the rules & execute them */
-    if (IB_LIST_ELEMENTS(rule_exec->phase_rules) == 0) {
+    if (num_rules == 0) {
         ib_rule_log_tx_debug(tx,
                              "No rules for phase %d/\"%s\" in context \"%s\"",
                              meta->phase_num, phase_name(meta),
@@ -1930,7 +2825,7 @@ static ib_status_t run_phase_rules(ib_engine_t *ib,
     ib_rule_log_tx_debug(tx,
                          "Executing %zd rules for phase %d/\"%s\" "
                          "in context \"%s\"",
-                         IB_LIST_ELEMENTS(rule_exec->phase_rules),
+                         num_rules,
                          meta->phase_num, phase_name(meta),
                          ib_context_full_get(ctx));
 
@@ -1941,19 +2836,29 @@ static ib_status_t run_phase_rules(ib_engine_t *ib,
      * returns an error.  This needs further discussion to determine what the
      * correct behavior should be.
      */
-    IB_LIST_LOOP_CONST(rule_exec->phase_rules, node) {
-        const ib_rule_t *rule = (const ib_rule_t *)node->data;
+    phase_rule_iter_init(rule_exec, ruleset_phase, &iter);
+    while ( (crule = phase_rule_iter_next(&iter, &position)) != NULL) {
+        const ib_rule_t *rule = crule->rule;
         ib_status_t      rule_rc;
 
         assert(rule->meta.phase == meta->phase_num);
 
+        /* Skip context rules none of whose target fields exist */
+        if ( use_index &&
+             (position != SIZE_MAX) &&
+             (! phase_select_rule(&select, position)) )
+        {
+            ++skipped;
+            continue;
+        }
+
         /* Allow (skip) this phase? */
         if (rule_allow(tx, meta, rule, true)) {
             break;
         }
 
         /* Execute the rule, it's actions and chains */
-        rule_rc = execute_phase_rule(rule_exec, rule, MAX_CHAIN_RECURSION);
+        rule_rc = execute_phase_rule(rule_exec, crule, MAX_CHAIN_RECURSION);
 
         /* Handle declined return code. Did this block? */
         if (ib_tx_flags_isset(tx, IB_TX_BLOCK_IMMEDIATE) ) {
@@ -1979,6 +2884,13 @@ static ib_status_t run_phase_rules(ib_engine_t *ib,
         }
     }
 
+    if (skipped != 0) {
+        ib_rule_log_tx_debug(tx,
+                             "Skipped %zd rules for phase %d/\"%s\" "
+                             "whose target fields do not exist",
+                             skipped, meta->phase_num, phase_name(meta));
+    }
+
     if (ib_tx_flags_isset(tx, IB_TX_BLOCK_PHASE) ) {
         ib_rule_log_tx_debug(tx, "Rule resulted in phase block");
         rc = report_block_to_server(rule_exec);
@@ -2005,19 +2917,23 @@ finish:
  * Execute a single stream operator, and it's actions
  *
  * @param[in] rule_exec Rule execution object
+ * @param[in] crule Compiled rule being executed
  * @param[in] value Value to pass to the operator
  *
  * @returns Status code
  */
 static ib_status_t execute_stream_operator(ib_rule_exec_t *rule_exec,
+                                           const ib_rule_compiled_t *crule,
                                            ib_field_t *value)
 {
     assert(rule_exec != NULL);
     assert(rule_exec->rule != NULL);
+    assert(crule != NULL);
     assert(value != NULL);
 
     ib_status_t      rc;
-    const ib_list_t *actions;
+    const ib_action_inst_t * const *actions;
+    size_t           num_actions;
     const ib_rule_t *rule = rule_exec->rule;
     bool             pushed = rule_exec_push_value(rule_exec, value);
     ib_num_t         result = 0;
@@ -2065,16 +2981,19 @@ static ib_status_t execute_stream_operator(ib_rule_exec_t *rule_exec,
      */
     if (op_rc != IB_OK) {
         actions = NULL;
+        num_actions = 0;
     }
     else if (result != 0) {
-        actions = rule_exec->rule->true_actions;
+        actions = crule->true_actions;
+        num_actions = crule->num_true_actions;
     }
     else {
-        actions = rule_exec->rule->false_actions;
+        actions = crule->false_actions;
+        num_actions = crule->num_false_actions;
     }
 
     ib_rule_log_exec_add_result(rule_exec->exec_log, value, result);
-    act_rc = execute_action_list(rule_exec, result, actions);
+    act_rc = execute_action_list(rule_exec, result, actions, num_actions);
 
     if (act_rc != IB_OK) {
         ib_rule_log_error(rule_exec,
@@ -2100,11 +3019,13 @@ static ib_status_t execute_stream_operator(ib_rule_exec_t *rule_exec,
  * Execute a single stream txdata rule, and it's actions
  *
  * @param[in] rule_exec Rule execution object
+ * @param[in] crule Compiled rule being executed
  * @param[in,out] txdata Transaction data
  *
  * @returns Status code
  */
 static ib_status_t execute_stream_txdata_rule(ib_rule_exec_t *rule_exec,
+                                              const ib_rule_compiled_t *crule,
                                               ib_txdata_t *txdata)
 {
     ib_status_t    rc = IB_OK;
@@ -2137,7 +3058,7 @@ static ib_status_t execute_stream_txdata_rule(ib_rule_exec_t *rule_exec,
         return rc;
     }
 
-    rc = execute_stream_operator(rule_exec, value);
+    rc = execute_stream_operator(rule_exec, crule, value);
 
     return rc;
 }
@@ -2146,11 +3067,13 @@ static ib_status_t execute_stream_txdata_rule(ib_rule_exec_t *rule_exec,
  * Execute a single stream header rule, and it's actions
  *
  * @param[in] rule_exec Rule execution object
+ * @param[in] crule Compiled rule being executed
  * @param[in] header Parsed header
  *
  * @returns Status code
  */
 static ib_status_t execute_stream_header_rule(ib_rule_exec_t *rule_exec,
+                                              const ib_rule_compiled_t *crule,
                                               ib_parsed_header_t *header)
 {
     ib_status_t          rc = IB_OK;
@@ -2190,7 +3113,7 @@ static ib_status_t execute_stream_header_rule(ib_rule_exec_t *rule_exec,
             return rc;
         }
 
-        rc = execute_stream_operator(rule_exec, value);
+        rc = execute_stream_operator(rule_exec, crule, value);
     }
 
     return rc;
@@ -2228,7 +3151,10 @@ static ib_status_t run_stream_rules(ib_engine_t *ib,
     const ib_ruleset_phase_t *ruleset_phase =
         &(ctx->rules->ruleset.phases[meta->phase_num]);
     ib_list_t                *rules = ruleset_phase->rule_list;
-    const ib_list_node_t     *node = NULL;
+    const ib_rule_compiled_t *crule;
+    phase_rule_iter_t         iter;
+    size_t                    num_rules;
+    size_t                    position;
     ib_rule_exec_t           *rule_exec = tx->rule_exec;
     ib_status_t               rc;
 
@@ -2270,15 +3196,11 @@ static ib_status_t run_stream_rules(ib_engine_t *ib,
     if (rc != IB_OK) {
         return IB_EINVAL;
     }
-
-    /* Add all of the enabled "normal" rules to the list */
-    rc = append_context_rules(ib, meta, rules, rule_exec);
-    if (rc != IB_OK) {
-        return IB_EINVAL;
-    }
+    num_rules =
+        IB_LIST_ELEMENTS(rule_exec->phase_rules) + ruleset_phase->num_rules;
 
     /* Are there any rules?  If not, do a quick exit */
-    if (IB_LIST_ELEMENTS(rule_exec->phase_rules) == 0) {
+    if (num_rules == 0) {
         ib_rule_log_debug(rule_exec,
                           "No rules for stream %d/\"%s\" in context \"%s\"",
                           meta->phase_num, phase_name(meta),
@@ -2288,7 +3210,7 @@ static ib_status_t run_stream_rules(ib_engine_t *ib,
     ib_rule_log_debug(rule_exec,
                       "Executing %zd rules for stream %d/\"%s\" "
                       "in context \"%s\"",
-                      IB_LIST_ELEMENTS(rule_exec->phase_rules),
+                      num_rules,
                       meta->phase_num, phase_name(meta),
                       ib_context_full_get(ctx));
 
@@ -2299,8 +3221,9 @@ static ib_status_t run_stream_rules(ib_engine_t *ib,
      * returns an error.  This needs further discussion to determine what the
      * correct behavior should be.
      */
-    IB_LIST_LOOP_CONST(rule_exec->phase_rules, node) {
-        const ib_rule_t    *rule = (const ib_rule_t *)node->data;
+    phase_rule_iter_init(rule_exec, ruleset_phase, &iter);
+    while ( (crule = phase_rule_iter_next(&iter, &position)) != NULL) {
+        const ib_rule_t    *rule = crule->rule;
         ib_status_t         trc;
 
         /* Reset status */
@@ -2325,10 +3248,10 @@ static ib_status_t run_stream_rules(ib_engine_t *ib,
          * determine what the correct behavior should be.
          */
         if (txdata != NULL) {
-            rc = execute_stream_txdata_rule(rule_exec, txdata);
+            rc = execute_stream_txdata_rule(rule_exec, crule, txdata);
         }
         else if (header != NULL) {
-            rc = execute_stream_header_rule(rule_exec, header);
+            rc = execute_stream_header_rule(rule_exec, crule, header);
         }
         if (rc != IB_OK) {
             ib_rule_log_error(rule_exec, "Error executing rule: %s",
@@ -2406,7 +3329,25 @@ static ib_status_t run_stream_txdata_rules(ib_engine_t *ib,
         return IB_OK;
     }
     const ib_rule_phase_meta_t *meta = (const ib_rule_phase_meta_t *) cbdata;
-    ib_status_t rc;
+    ib_rule_exec_t *rule_exec = tx->rule_exec;
+    const ib_rule_context_t *ctx_rules = tx->ctx->rules;
+    ib_status_t rc = IB_OK;
+
+    /* Collect the body, and its streamed transformations, for the phase
+     * rules which target it. */
+    if (meta->phase_num == PHASE_STR_REQUEST_BODY) {
+        rc = body_view_append(rule_exec, &(ctx_rules->request_body),
+                              &(rule_exec->request_body), txdata);
+    }
+    else if (meta->phase_num == PHASE_STR_RESPONSE_BODY) {
+        rc = body_view_append(rule_exec, &(ctx_rules->response_body),
+                              &(rule_exec->response_body), txdata);
+    }
+    if (rc != IB_OK) {
+        ib_rule_log_tx_error(tx, "Error collecting body data: %s",
+                             ib_status_to_string(rc));
+    }
+
     rc = run_stream_rules(ib, tx, event, txdata, NULL, meta);
     return rc;
 }
@@ -2935,200 +3876,790 @@ ib_status_t ib_rule_engine_init(ib_engine_t *ib,
                      ib_status_to_string(rc));
         return rc;
     }
-
-    return IB_OK;
+
+    return IB_OK;
+}
+
+ib_status_t ib_rule_engine_ctx_open(ib_engine_t *ib,
+                                    ib_module_t *mod,
+                                    ib_context_t *ctx)
+{
+    ib_status_t rc;
+
+    /* If the rules are already initialized, do nothing */
+    if (ctx->rules != NULL) {
+        return IB_OK;
+    }
+
+    /* Create the rule engine object */
+    rc = create_rule_context(ib, ctx->mp, &(ctx->rules));
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Rule engine failed to initialize context rules: %s",
+                     ib_status_to_string(rc));
+        return rc;
+    }
+
+    /* Initialize the rule sets */
+    rc = init_ruleset(ib, ctx->mp, ctx->rules);
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Rule engine failed to initialize phase ruleset: %s",
+                     ib_status_to_string(rc));
+        return rc;
+    }
+
+    /* If this is a location context, import our parents context info */
+    if (ctx->ctype == IB_CTYPE_LOCATION) {
+        rc = import_rule_context(ctx, ctx->parent->rules, ctx->rules);
+        if (rc != IB_OK) {
+            ib_log_error(ib,
+                         "Rule engine failed to import from parent: %s",
+                         ib_status_to_string(rc));
+            return rc;
+        }
+    }
+
+    return IB_OK;
+}
+
+/**
+ * Enable/disable an individual rule
+ *
+ * @param[in] enable true:Enable, false:Disable
+ * @param[in,out] ctx_rule Context rule to enable/disable
+ */
+static void set_rule_enable(bool enable,
+                            ib_rule_ctx_data_t *ctx_rule)
+{
+    assert(ctx_rule != NULL);
+
+    if (enable) {
+        ib_flags_set(ctx_rule->flags, IB_RULECTX_FLAG_ENABLED);
+    }
+    else {
+        ib_flags_clear(ctx_rule->flags, IB_RULECTX_FLAG_ENABLED);
+    }
+    return;
+}
+
+/**
+ * Enable rules that match tag / id
+ *
+ * @param[in] ib IronBee engine
+ * @param[in] ctx Current IronBee context
+ * @param[in] match Enable match data
+ * @param[in] enable true:Enable, false:Disable
+ * @param[in,out] ctx_rule_list List of rules to search for matches to @a enable
+ *
+ * @returns Status code
+ */
+static ib_status_t enable_rules(ib_engine_t *ib,
+                                ib_context_t *ctx,
+                                const ib_rule_enable_t *match,
+                                bool enable,
+                                ib_list_t *ctx_rule_list)
+{
+    assert(ib != NULL);
+    assert(ctx != NULL);
+    assert(match != NULL);
+    assert(ctx_rule_list != NULL);
+
+    ib_list_node_t *node;
+    unsigned int    matches = 0;
+    const char     *name = enable ? "Enable" : "Disable";
+    const char     *lcname = enable ? "enable" : "disable";
+
+    switch (match->enable_type) {
+
+    case RULE_ENABLE_ALL :
+        IB_LIST_LOOP(ctx_rule_list, node) {
+            ib_rule_ctx_data_t *ctx_rule;
+            ctx_rule = (ib_rule_ctx_data_t *)ib_list_node_data(node);
+
+            ++matches;
+            set_rule_enable(enable, ctx_rule);
+            ib_cfg_log_debug2_ex(ib, match->file, match->lineno,
+                                 "%sd rule matched \"%s\" by ALL",
+                                 name, ib_rule_id(ctx_rule->rule));
+        }
+        if (matches == 0) {
+            ib_cfg_log_notice_ex(ib, match->file, match->lineno,
+                                 "No rules by ALL to %s",
+                                 match->enable_str);
+        }
+        else {
+            ib_cfg_log_debug_ex(ib, match->file, match->lineno,
+                                "%sd %u rules by ALL",
+                                name, matches);
+        }
+        return IB_OK;
+        break;
+
+    case RULE_ENABLE_ID :
+        /* Note: We return from the loop before because the rule
+         * IDs are unique */
+        ib_cfg_log_debug3_ex(ib, match->file, match->lineno,
+                             "Looking for rule with ID \"%s\" to %s",
+                             match->enable_str, lcname);
+        IB_LIST_LOOP(ctx_rule_list, node) {
+            ib_rule_ctx_data_t *ctx_rule;
+            bool matched;
+            ctx_rule = (ib_rule_ctx_data_t *)ib_list_node_data(node);
+
+            /* Match the rule ID, including children */
+            matched = ib_rule_id_match(ctx_rule->rule,
+                                       match->enable_str,
+                                       false,
+                                       true);
+            if (matched) {
+                set_rule_enable(enable, ctx_rule);
+                ib_cfg_log_debug2_ex(ib, match->file, match->lineno,
+                                     "%sd ID matched rule \"%s\"",
+                                     name, ib_rule_id(ctx_rule->rule));
+                return IB_OK;
+            }
+        }
+        ib_cfg_log_notice_ex(ib, match->file, match->lineno,
+                             "No rule with ID of \"%s\" to %s",
+                             match->enable_str, lcname);
+        return IB_ENOENT;
+        break;
+
+    case RULE_ENABLE_TAG :
+        ib_cfg_log_debug3_ex(ib, match->file, match->lineno,
+                             "Looking for rules with tag \"%s\" to %s",
+                             match->enable_str, lcname);
+        IB_LIST_LOOP(ctx_rule_list, node) {
+            ib_rule_ctx_data_t   *ctx_rule;
+            ib_rule_t            *rule;
+            bool                  matched;
+
+            ctx_rule = (ib_rule_ctx_data_t *)ib_list_node_data(node);
+            rule = ctx_rule->rule;
+
+            matched = ib_rule_tag_match(ctx_rule->rule,
+                                        match->enable_str,
+                                        false,
+                                        true);
+            if (matched) {
+                ++matches;
+                set_rule_enable(enable, ctx_rule);
+                ib_cfg_log_debug2_ex(ib, match->file, match->lineno,
+                                     "%s tag \"%s\" matched "
+                                     "rule \"%s\" from ctx=\"%s\"",
+                                     name,
+                                     match->enable_str,
+                                     ib_rule_id(rule),
+                                     ib_context_full_get(rule->ctx));
+            }
+        }
+        if (matches == 0) {
+            ib_cfg_log_notice_ex(ib, match->file, match->lineno,
+                                 "No rules with tag of \"%s\" to %s",
+                                 match->enable_str, lcname);
+        }
+        else {
+            ib_cfg_log_debug_ex(ib, match->file, match->lineno,
+                                "%s %u rules with tag of \"%s\"",
+                                name, matches, match->enable_str);
+        }
+        return IB_OK;
+        break;
+
+    default:
+        assert(0 && "Invalid rule enable type");
+
+    }
+
+    return IB_OK;
+}
+
+/**
+ * Target index entry under construction.
+ */
+typedef struct {
+    ib_rule_target_index_t  entry;       /**< The entry being built */
+    size_t                  last;        /**< Last rule position added */
+} target_index_build_t;
+
+/**
+ * Check if a rule must run even if none of its target fields exist.
+ *
+ * @param[in] rule Rule to check
+ *
+ * @returns true if the rule can not be indexed by its targets
+ */
+static bool rule_is_unindexed(const ib_rule_t *rule)
+{
+    assert(rule != NULL);
+
+    const ib_list_node_t *node;
+
+    if (ib_flags_any(rule->flags,
+                     IB_RULE_FLAG_EXTERNAL | IB_RULE_FLAG_NO_TGT)) {
+        return true;
+    }
+    if ( (rule->opinst == NULL) || (rule->opinst->op == NULL) ) {
+        return true;
+    }
+    if (ib_flags_any(rule->opinst->flags, IB_OPINST_FLAG_INVERT) ||
+        ib_flags_any(rule->opinst->op->flags, IB_OP_FLAG_ALLOW_NULL))
+    {
+        return true;
+    }
+    if (ib_list_elements(rule->target_fields) == 0) {
+        return true;
+    }
+    IB_LIST_LOOP_CONST(rule->target_fields, node) {
+        const ib_rule_target_t *target =
+            (const ib_rule_target_t *)node->data;
+
+        if ( (target->field_name == NULL) ||
+             (*target->field_name == '\0') ||
+             (*target->field_name == ':') )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Add a phase rule's targets to the target index under construction.
+ *
+ * On the first pass (@a fill false) entries are created and their rules
+ * counted; on the second pass the rule positions are stored.
+ *
+ * @param[in] mp Memory pool for allocations
+ * @param[in,out] hash Entries by field name
+ * @param[in,out] entries Entries, in order of creation
+ * @param[in] rule Rule to add
+ * @param[in] position Position of @a rule
+ * @param[in] fill false to count, true to store positions
+ *
+ * @returns Status code
+ */
+static ib_status_t index_rule_targets(ib_mpool_t *mp,
+                                      ib_hash_t *hash,
+                                      ib_list_t *entries,
+                                      const ib_rule_t *rule,
+                                      size_t position,
+                                      bool fill)
+{
+    const ib_list_node_t *node;
+    ib_status_t           rc;
+
+    IB_LIST_LOOP_CONST(rule->target_fields, node) {
+        const ib_rule_target_t *target =
+            (const ib_rule_target_t *)node->data;
+        const char             *marker = strchr(target->field_name, ':');
+        size_t                  nlen;
+        target_index_build_t   *build;
+
+        nlen = (marker == NULL) ?
+            strlen(target->field_name) :
+            (size_t)(marker - target->field_name);
+
+        rc = ib_hash_get_ex(hash, &build, target->field_name, nlen);
+        if (rc == IB_ENOENT) {
+            assert(! fill);
+            build = ib_mpool_calloc(mp, 1, sizeof(*build));
+            if (build == NULL) {
+                return IB_EALLOC;
+            }
+            build->entry.name = ib_mpool_memdup(mp, target->field_name, nlen);
+            if (build->entry.name == NULL) {
+                return IB_EALLOC;
+            }
+            build->entry.nlen = nlen;
+            build->last = SIZE_MAX;
+            rc = ib_hash_set_ex(hash, build->entry.name, nlen, build);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            rc = ib_list_push(entries, build);
+            if (rc != IB_OK) {
+                return rc;
+            }
+        }
+        else if (rc != IB_OK) {
+            return rc;
+        }
+
+        /* Only add the rule once, even if it targets a field twice */
+        if (build->last == position) {
+            continue;
+        }
+        build->last = position;
+        if (fill) {
+            build->entry.rules[build->entry.num_rules] = position;
+        }
+        ++build->entry.num_rules;
+    }
+
+    return IB_OK;
+}
+
+/**
+ * Compile a context's runnable phase rules, and the rules owned by
+ * modules, into a single array-backed ruleset.
+ *
+ * Each phase's rules are a contiguous slice of the ruleset's rules, with
+ * the chained rules after all of the phase slices.  Rules are only enabled
+ * or disabled while the context is being closed, so the ruleset is shared,
+ * unmodified, by all transactions in the context.
+ *
+ * @param[in] ctx Context being closed
+ * @param[in] owned_rules Rules owned by modules (ib_rule_t *)
+ *
+ * @returns Status code
+ */
+static ib_status_t compile_context_rules(ib_context_t *ctx,
+                                         const ib_list_t *owned_rules)
+{
+    assert(ctx != NULL);
+    assert(owned_rules != NULL);
+
+    ib_rule_compiled_set_t *set;
+    compile_sizes_t         sizes = { 0, 0, 0, 0 };
+    const ib_list_node_t   *node;
+    size_t                  num_top = 0;
+    size_t                  position;
+    int                     phase;
+    ib_status_t             rc;
+
+    /* Size the ruleset */
+    for (phase = (int)PHASE_NONE;
+         phase < (int)IB_RULE_PHASE_COUNT;
+         ++phase)
+    {
+        const ib_ruleset_phase_t *ruleset_phase =
+            &(ctx->rules->ruleset.phases[phase]);
+
+        IB_LIST_LOOP_CONST(ruleset_phase->rule_list, node) {
+            const ib_rule_ctx_data_t *ctx_rule =
+                (const ib_rule_ctx_data_t *)node->data;
+
+            if (rule_is_runnable(ctx_rule)) {
+                compile_count_rule(ctx_rule->rule, &sizes);
+                ++num_top;
+            }
+        }
+    }
+    IB_LIST_LOOP_CONST(owned_rules, node) {
+        compile_count_rule((const ib_rule_t *)node->data, &sizes);
+        ++num_top;
+    }
+
+    rc = compile_set_create(ctx->mp, &sizes, &set);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_hash_create(&set->by_rule, ctx->mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    /* Reserve the top-level rule slots; chained rules follow them */
+    set->num_rules = num_top;
+    position = 0;
+    for (phase = (int)PHASE_NONE;
+         phase < (int)IB_RULE_PHASE_COUNT;
+         ++phase)
+    {
+        ib_ruleset_phase_t *ruleset_phase =
+            &(ctx->rules->ruleset.phases[phase]);
+
+        ruleset_phase->rules = &(set->rules[position]);
+        ruleset_phase->num_rules = 0;
+        IB_LIST_LOOP_CONST(ruleset_phase->rule_list, node) {
+            const ib_rule_ctx_data_t *ctx_rule =
+                (const ib_rule_ctx_data_t *)node->data;
+
+            if (rule_is_runnable(ctx_rule)) {
+                compile_rule(set, &(set->rules[position++]), ctx_rule->rule);
+                ++ruleset_phase->num_rules;
+            }
+        }
+    }
+
+    /* Owned rules are only reachable through the rule lookup hash */
+    IB_LIST_LOOP_CONST(owned_rules, node) {
+        ib_rule_compiled_t *crule = &(set->rules[position++]);
+
+        compile_rule(set, crule, (ib_rule_t *)node->data);
+        rc = ib_hash_set_ex(set->by_rule,
+                            &crule->rule, sizeof(crule->rule), crule);
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+    assert(position == num_top);
+    assert(set->num_rules == sizes.rules);
+
+    ctx->rules->compiled = set;
+    return IB_OK;
+}
+
+/**
+ * Build the target index of a phase's rule array.
+ *
+ * @param[in] ib IronBee engine
+ * @param[in] ctx Context being closed
+ * @param[in,out] ruleset_phase Phase ruleset to index
+ *
+ * @returns Status code
+ */
+static ib_status_t build_phase_index(ib_engine_t *ib,
+                                     ib_context_t *ctx,
+                                     ib_ruleset_phase_t *ruleset_phase)
+{
+    assert(ib != NULL);
+    assert(ctx != NULL);
+    assert(ruleset_phase != NULL);
+
+    ib_mpool_t            *mp = ctx->mp;
+    ib_rule_phase_index_t *index;
+    ib_hash_t             *hash;
+    ib_list_t             *entries;
+    const ib_list_node_t  *node;
+    size_t                 position;
+    size_t                 num;
+    int                    pass;
+    ib_status_t            rc;
+
+    ruleset_phase->index = NULL;
+
+    index = ib_mpool_calloc(mp, 1, sizeof(*index));
+    if (index == NULL) {
+        return IB_EALLOC;
+    }
+    rc = ib_hash_create_nocase(&hash, mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_list_create(&entries, mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    /* Pass 0 counts, pass 1 stores rule positions */
+    for (pass = 0;  pass < 2;  ++pass) {
+        index->num_always = 0;
+        for (position = 0;  position < ruleset_phase->num_rules;  ++position) {
+            const ib_rule_t *rule = ruleset_phase->rules[position].rule;
+
+            if (rule_is_unindexed(rule)) {
+                if (pass != 0) {
+                    index->always[index->num_always] = position;
+                }
+                ++index->num_always;
+            }
+            else {
+                rc = index_rule_targets(mp, hash, entries, rule,
+                                        position, (pass != 0));
+                if (rc != IB_OK) {
+                    return rc;
+                }
+            }
+        }
+
+        if (pass != 0) {
+            break;
+        }
+
+        /* Allocate the position arrays */
+        index->num_rules = ruleset_phase->num_rules;
+        index->num_fields = ib_list_elements(entries);
+        index->always = ib_mpool_alloc(mp,
+                                       (index->num_always + 1) *
+                                       sizeof(*index->always));
+        index->fields = ib_mpool_alloc(mp,
+                                       (index->num_fields + 1) *
+                                       sizeof(*index->fields));
+        if ( (index->always == NULL) || (index->fields == NULL) ) {
+            return IB_EALLOC;
+        }
+        IB_LIST_LOOP_CONST(entries, node) {
+            target_index_build_t *build = (target_index_build_t *)node->data;
+
+            build->entry.rules = ib_mpool_alloc(mp,
+                                                build->entry.num_rules *
+                                                sizeof(*build->entry.rules));
+            if (build->entry.rules == NULL) {
+                return IB_EALLOC;
+            }
+            build->entry.num_rules = 0;
+            build->last = SIZE_MAX;
+        }
+    }
+
+    /* Copy the finished entries into the index */
+    num = 0;
+    IB_LIST_LOOP_CONST(entries, node) {
+        const target_index_build_t *build =
+            (const target_index_build_t *)node->data;
+        index->fields[num++] = build->entry;
+    }
+
+    ib_log_debug2(ib,
+                  "Indexed %zd rules for phase %d/\"%s\" in context \"%s\": "
+                  "%zd target fields, %zd unindexed rules",
+                  index->num_rules,
+                  ruleset_phase->phase_num,
+                  phase_name(ruleset_phase->phase_meta),
+                  ib_context_full_get(ctx),
+                  index->num_fields, index->num_always);
+
+    ruleset_phase->index = index;
+    return IB_OK;
+}
+
+/**
+ * Check if a rule's operator can be skipped by a prefilter.
+ *
+ * @param[in] rule Rule to check
+ *
+ * @returns true if the rule's operator is a regular expression
+ */
+static bool rule_is_prefilterable(const ib_rule_t *rule)
+{
+    assert(rule != NULL);
+
+    const ib_operator_inst_t *opinst = rule->opinst;
+
+    if (ib_flags_any(rule->flags, IB_RULE_FLAG_EXTERNAL)) {
+        return false;
+    }
+    if ( (opinst == NULL) || (opinst->op == NULL) ||
+         (opinst->params == NULL) )
+    {
+        return false;
+    }
+    if (! ib_flags_all(opinst->op->flags, IB_OP_FLAG_REGEX)) {
+        return false;
+    }
+    if (ib_flags_any(opinst->flags, IB_OPINST_FLAG_EXPAND)) {
+        return false;
+    }
+    return true;
 }
 
-ib_status_t ib_rule_engine_ctx_open(ib_engine_t *ib,
-                                    ib_module_t *mod,
-                                    ib_context_t *ctx)
+/**
+ * Build the regular expression prefilter of a phase's rule array.
+ *
+ * @param[in] ib IronBee engine
+ * @param[in] ctx Context being closed
+ * @param[in,out] ruleset_phase Phase ruleset to prefilter
+ *
+ * @returns Status code
+ */
+static ib_status_t build_phase_prefilter(ib_engine_t *ib,
+                                         ib_context_t *ctx,
+                                         ib_ruleset_phase_t *ruleset_phase)
 {
-    ib_status_t rc;
+    assert(ib != NULL);
+    assert(ctx != NULL);
+    assert(ruleset_phase != NULL);
 
-    /* If the rules are already initialized, do nothing */
-    if (ctx->rules != NULL) {
-        return IB_OK;
-    }
+    ib_rule_prefilter_t *prefilter;
+    size_t               position;
+    size_t               num_rules = 0;
+    ib_status_t          rc;
 
-    /* Create the rule engine object */
-    rc = create_rule_context(ib, ctx->mp, &(ctx->rules));
+    ruleset_phase->prefilter = NULL;
+
+    rc = ib_rule_prefilter_create(ctx->mp, &prefilter);
     if (rc != IB_OK) {
-        ib_log_error(ib,
-                     "Rule engine failed to initialize context rules: %s",
-                     ib_status_to_string(rc));
         return rc;
     }
 
-    /* Initialize the rule sets */
-    rc = init_ruleset(ib, ctx->mp, ctx->rules);
+    for (position = 0;  position < ruleset_phase->num_rules;  ++position) {
+        /* The rules are owned by the context's compiled ruleset */
+        ib_rule_compiled_t *crule =
+            (ib_rule_compiled_t *)&(ruleset_phase->rules[position]);
+
+        for (;  crule != NULL;  crule = (ib_rule_compiled_t *)crule->chained) {
+            ++num_rules;
+            if (! rule_is_prefilterable(crule->rule)) {
+                continue;
+            }
+            rc = ib_rule_prefilter_add(prefilter,
+                                       crule->rule->opinst->params,
+                                       &crule->prefilter_slot);
+            if (rc == IB_DECLINED) {
+                continue;
+            }
+            else if (rc != IB_OK) {
+                return rc;
+            }
+            crule->prefilter = prefilter;
+        }
+    }
+
+    if (ib_rule_prefilter_slots(prefilter) == 0) {
+        return IB_OK;
+    }
+    rc = ib_rule_prefilter_finish(prefilter);
     if (rc != IB_OK) {
-        ib_log_error(ib,
-                     "Rule engine failed to initialize phase ruleset: %s",
-                     ib_status_to_string(rc));
         return rc;
     }
 
-    /* If this is a location context, import our parents context info */
-    if (ctx->ctype == IB_CTYPE_LOCATION) {
-        rc = import_rule_context(ctx, ctx->parent->rules, ctx->rules);
-        if (rc != IB_OK) {
-            ib_log_error(ib,
-                         "Rule engine failed to import from parent: %s",
-                         ib_status_to_string(rc));
-            return rc;
-        }
-    }
+    ib_log_debug2(ib,
+                  "Prefiltering %zd of %zd rules for phase %d/\"%s\" "
+                  "in context \"%s\"",
+                  ib_rule_prefilter_slots(prefilter), num_rules,
+                  ruleset_phase->phase_num,
+                  phase_name(ruleset_phase->phase_meta),
+                  ib_context_full_get(ctx));
 
+    ruleset_phase->prefilter = prefilter;
     return IB_OK;
 }
 
 /**
- * Enable/disable an individual rule
+ * Add a target to the body targets it refers to, if any.
  *
- * @param[in] enable true:Enable, false:Disable
- * @param[in,out] ctx_rule Context rule to enable/disable
+ * @param[in] mp Memory pool for allocations
+ * @param[in] ctx_rules Context's rules
+ * @param[in] ctarget Compiled target
+ * @param[in] max_tfns Size of the body targets' tfn arrays
+ *
+ * @returns Status code
  */
-static void set_rule_enable(bool enable,
-                            ib_rule_ctx_data_t *ctx_rule)
+static ib_status_t add_body_target(ib_mpool_t *mp,
+                                   ib_rule_context_t *ctx_rules,
+                                   const ib_rule_compiled_target_t *ctarget,
+                                   size_t max_tfns)
 {
-    assert(ctx_rule != NULL);
+    assert(mp != NULL);
+    assert(ctx_rules != NULL);
+    assert(ctarget != NULL);
 
-    if (enable) {
-        ib_flags_set(ctx_rule->flags, IB_RULECTX_FLAG_ENABLED);
+    const char             *fname = ctarget->target->field_name;
+    ib_rule_body_targets_t *targets;
+    const ib_tfn_t         *tfn;
+    size_t                  n;
+
+    if (fname == NULL) {
+        return IB_OK;
+    }
+    else if (strcasecmp(fname, "request_body") == 0) {
+        targets = &(ctx_rules->request_body);
+    }
+    else if (strcasecmp(fname, "response_body") == 0) {
+        targets = &(ctx_rules->response_body);
     }
     else {
-        ib_flags_clear(ctx_rule->flags, IB_RULECTX_FLAG_ENABLED);
+        return IB_OK;
     }
-    return;
+    targets->targeted = true;
+
+    /* Only the first transformation can be applied as data arrives */
+    if (ctarget->num_tfns == 0) {
+        return IB_OK;
+    }
+    tfn = ctarget->tfns[0];
+    if (tfn->fn_holdback == NULL) {
+        return IB_OK;
+    }
+    for (n = 0;  n < targets->num_tfns;  ++n) {
+        if (targets->tfns[n] == tfn) {
+            return IB_OK;
+        }
+    }
+    if (targets->tfns == NULL) {
+        targets->tfns = ib_mpool_alloc(mp, max_tfns * sizeof(*targets->tfns));
+        if (targets->tfns == NULL) {
+            return IB_EALLOC;
+        }
+    }
+    assert(targets->num_tfns < max_tfns);
+    targets->tfns[targets->num_tfns++] = tfn;
+
+    return IB_OK;
 }
 
 /**
- * Enable rules that match tag / id
+ * Find the body fields targeted by a context's phase rules.
  *
  * @param[in] ib IronBee engine
- * @param[in] ctx Current IronBee context
- * @param[in] match Enable match data
- * @param[in] enable true:Enable, false:Disable
- * @param[in,out] ctx_rule_list List of rules to search for matches to @a enable
+ * @param[in] ctx Context being closed
+ * @param[in] limit Most body bytes to collect; 0 for no limit
  *
  * @returns Status code
  */
-static ib_status_t enable_rules(ib_engine_t *ib,
-                                ib_context_t *ctx,
-                                const ib_rule_enable_t *match,
-                                bool enable,
-                                ib_list_t *ctx_rule_list)
+static ib_status_t collect_body_targets(ib_engine_t *ib,
+                                        ib_context_t *ctx,
+                                        size_t limit)
 {
     assert(ib != NULL);
     assert(ctx != NULL);
-    assert(match != NULL);
-    assert(ctx_rule_list != NULL);
-
-    ib_list_node_t *node;
-    unsigned int    matches = 0;
-    const char     *name = enable ? "Enable" : "Disable";
-    const char     *lcname = enable ? "enable" : "disable";
-
-    switch (match->enable_type) {
 
-    case RULE_ENABLE_ALL :
-        IB_LIST_LOOP(ctx_rule_list, node) {
-            ib_rule_ctx_data_t *ctx_rule;
-            ctx_rule = (ib_rule_ctx_data_t *)ib_list_node_data(node);
+    ib_rule_context_t *ctx_rules = ctx->rules;
+    size_t             max_tfns;
+    int                phase;
+    ib_status_t        rc;
 
-            ++matches;
-            set_rule_enable(enable, ctx_rule);
-            ib_cfg_log_debug2_ex(ib, match->file, match->lineno,
-                                 "%sd rule matched \"%s\" by ALL",
-                                 name, ib_rule_id(ctx_rule->rule));
-        }
-        if (matches == 0) {
-            ib_cfg_log_notice_ex(ib, match->file, match->lineno,
-                                 "No rules by ALL to %s",
-                                 match->enable_str);
-        }
-        else {
-            ib_cfg_log_debug_ex(ib, match->file, match->lineno,
-                                "%sd %u rules by ALL",
-                                name, matches);
-        }
+    ctx_rules->request_body.targeted = false;
+    ctx_rules->request_body.tfns = NULL;
+    ctx_rules->request_body.num_tfns = 0;
+    ctx_rules->request_body.limit = limit;
+    ctx_rules->response_body = ctx_rules->request_body;
+    if (ctx_rules->compiled == NULL) {
         return IB_OK;
-        break;
+    }
+    max_tfns = ctx_rules->compiled->num_targets;
 
-    case RULE_ENABLE_ID :
-        /* Note: We return from the loop before because the rule
-         * IDs are unique */
-        ib_cfg_log_debug3_ex(ib, match->file, match->lineno,
-                             "Looking for rule with ID \"%s\" to %s",
-                             match->enable_str, lcname);
-        IB_LIST_LOOP(ctx_rule_list, node) {
-            ib_rule_ctx_data_t *ctx_rule;
-            bool matched;
-            ctx_rule = (ib_rule_ctx_data_t *)ib_list_node_data(node);
+    for (phase = (int)PHASE_NONE;
+         phase < (int)IB_RULE_PHASE_COUNT;
+         ++phase)
+    {
+        const ib_ruleset_phase_t *ruleset_phase =
+            &(ctx_rules->ruleset.phases[phase]);
+        size_t                    position;
 
-            /* Match the rule ID, including children */
-            matched = ib_rule_id_match(ctx_rule->rule,
-                                       match->enable_str,
-                                       false,
-                                       true);
-            if (matched) {
-                set_rule_enable(enable, ctx_rule);
-                ib_cfg_log_debug2_ex(ib, match->file, match->lineno,
-                                     "%sd ID matched rule \"%s\"",
-                                     name, ib_rule_id(ctx_rule->rule));
-                return IB_OK;
-            }
+        if ( (ruleset_phase->phase_meta == NULL) ||
+             ruleset_phase->phase_meta->is_stream )
+        {
+            continue;
         }
-        ib_cfg_log_notice_ex(ib, match->file, match->lineno,
-                             "No rule with ID of \"%s\" to %s",
-                             match->enable_str, lcname);
-        return IB_ENOENT;
-        break;
 
-    case RULE_ENABLE_TAG :
-        ib_cfg_log_debug3_ex(ib, match->file, match->lineno,
-                             "Looking for rules with tag \"%s\" to %s",
-                             match->enable_str, lcname);
-        IB_LIST_LOOP(ctx_rule_list, node) {
-            ib_rule_ctx_data_t   *ctx_rule;
-            ib_rule_t            *rule;
-            bool                  matched;
+        for (position = 0;  position < ruleset_phase->num_rules;  ++position) {
+            const ib_rule_compiled_t *crule;
 
-            ctx_rule = (ib_rule_ctx_data_t *)ib_list_node_data(node);
-            rule = ctx_rule->rule;
+            for (crule = &(ruleset_phase->rules[position]);
+                 crule != NULL;
+                 crule = crule->chained)
+            {
+                size_t t;
 
-            matched = ib_rule_tag_match(ctx_rule->rule,
-                                        match->enable_str,
-                                        false,
-                                        true);
-            if (matched) {
-                ++matches;
-                set_rule_enable(enable, ctx_rule);
-                ib_cfg_log_debug2_ex(ib, match->file, match->lineno,
-                                     "%s tag \"%s\" matched "
-                                     "rule \"%s\" from ctx=\"%s\"",
-                                     name,
-                                     match->enable_str,
-                                     ib_rule_id(rule),
-                                     ib_context_full_get(rule->ctx));
+                for (t = 0;  t < crule->num_targets;  ++t) {
+                    rc = add_body_target(ctx->mp, ctx_rules,
+                                         &(crule->targets[t]), max_tfns);
+                    if (rc != IB_OK) {
+                        return rc;
+                    }
+                }
             }
         }
-        if (matches == 0) {
-            ib_cfg_log_notice_ex(ib, match->file, match->lineno,
-                                 "No rules with tag of \"%s\" to %s",
-                                 match->enable_str, lcname);
-        }
-        else {
-            ib_cfg_log_debug_ex(ib, match->file, match->lineno,
-                                "%s %u rules with tag of \"%s\"",
-                                name, matches, match->enable_str);
-        }
-        return IB_OK;
-        break;
-
-    default:
-        assert(0 && "Invalid rule enable type");
+    }
 
+    if (ctx_rules->request_body.targeted) {
+        ib_log_debug2(ib,
+                      "Collecting request body in context \"%s\" "
+                      "with %zd streamed transformations",
+                      ib_context_full_get(ctx),
+                      ctx_rules->request_body.num_tfns);
+    }
+    if (ctx_rules->response_body.targeted) {
+        ib_log_debug2(ib,
+                      "Collecting response body in context \"%s\" "
+                      "with %zd streamed transformations",
+                      ib_context_full_get(ctx),
+                      ctx_rules->response_body.num_tfns);
     }
 
     return IB_OK;
@@ -3143,10 +4674,13 @@ ib_status_t ib_rule_engine_ctx_close(ib_engine_t *ib,
     assert(ctx != NULL);
 
     ib_list_t      *all_rules;
+    ib_list_t      *owned_rules;
     ib_list_node_t *node;
     ib_flags_t      skip_flags;
     ib_context_t   *main_ctx = ib_context_main(ib);
+    ib_core_cfg_t  *corecfg = NULL;
     ib_status_t     rc;
+    int             phase;
 
     /* Don't enable rules for non-location contexts */
     if (ctx->ctype != IB_CTYPE_LOCATION) {
@@ -3161,6 +4695,13 @@ ib_status_t ib_rule_engine_ctx_close(ib_engine_t *ib,
                      ib_status_to_string(rc));
         return rc;
     }
+    rc = ib_list_create(&owned_rules, ctx->mp);
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Rule engine failed to initialize owned rule list: %s",
+                     ib_status_to_string(rc));
+        return rc;
+    }
 
     /* Step 1: Unmark all rules in the context's rule list */
     IB_LIST_LOOP(ctx->rules->rule_list, node) {
@@ -3367,6 +4908,10 @@ ib_status_t ib_rule_engine_ctx_close(ib_engine_t *ib,
             }
         }
         if (owned) {
+            rc = ib_list_push(owned_rules, rule);
+            if (rc != IB_OK) {
+                return rc;
+            }
             continue;
         }
 
@@ -3398,6 +4943,65 @@ ib_status_t ib_rule_engine_ctx_close(ib_engine_t *ib,
                      ib_context_full_get(ctx));
     }
 
+    /* Step 8: Compile the rules, index the phase rules by target field
+     * and build the phases' prefilters */
+    rc = ib_context_module_config(ctx, ib_core_module(), (void *)&corecfg);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to get core module configuration: %s",
+                     ib_status_to_string(rc));
+        return rc;
+    }
+    rc = compile_context_rules(ctx, owned_rules);
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Failed to compile rules for context \"%s\": %s",
+                     ib_context_full_get(ctx),
+                     ib_status_to_string(rc));
+        return rc;
+    }
+    for (phase = (int)PHASE_NONE;
+         phase < (int)IB_RULE_PHASE_COUNT;
+         ++phase)
+    {
+        ib_ruleset_phase_t *ruleset_phase =
+            &(ctx->rules->ruleset.phases[phase]);
+
+        if ( (ruleset_phase->phase_meta == NULL) ||
+             ruleset_phase->phase_meta->is_stream )
+        {
+            continue;
+        }
+        rc = build_phase_index(ib, ctx, ruleset_phase);
+        if (rc != IB_OK) {
+            ib_log_error(ib,
+                         "Failed to index rules for phase %d "
+                         "in context \"%s\": %s",
+                         phase, ib_context_full_get(ctx),
+                         ib_status_to_string(rc));
+            return rc;
+        }
+        if (corecfg->rule_prefilter != 0) {
+            rc = build_phase_prefilter(ib, ctx, ruleset_phase);
+            if (rc != IB_OK) {
+                ib_log_error(ib,
+                             "Failed to build prefilter for phase %d "
+                             "in context \"%s\": %s",
+                             phase, ib_context_full_get(ctx),
+                             ib_status_to_string(rc));
+                return rc;
+            }
+        }
+    }
+
+    rc = collect_body_targets(ib, ctx, (size_t)corecfg->rule_body_limit);
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Failed to find body targets in context \"%s\": %s",
+                     ib_context_full_get(ctx),
+                     ib_status_to_string(rc));
+        return rc;
+    }
+
     ib_rule_log_flags_dump(ib, ctx);
 
     return IB_OK;
@@ -3897,6 +5501,8 @@ ib_status_t ib_rule_register(ib_engine_t *ib,
             return IB_EALLOC;
         }
         tgt->field_name = "NULL";
+        tgt->field_nlen = sizeof("NULL") - 1;
+        tgt->field_id = IB_DATA_FIELD_ID_NONE;
         tgt->target_str = "NULL";
         rc = ib_list_create(&(tgt->tfn_list), ib_rule_mpool(ib));
         if (rc != IB_OK) {
@@ -4409,6 +6015,19 @@ ib_status_t ib_rule_create_target(ib_engine_t *ib,
         return IB_EALLOC;
     }
 
+    /* Resolve the name once, rather than on every execution */
+    (*target)->field_nlen = strlen(name);
+    (*target)->field_id = ib_data_field_id(name, (*target)->field_nlen);
+
+    /* Pre-compile the list filter pattern (FIELD:/pattern/), if any */
+    rc = ib_data_filter_cache_add(ib->data_filters, name, strlen(name));
+    if (rc != IB_OK) {
+        ib_log_error(ib,
+                     "Error compiling filter of target \"%s\": %s",
+                     name, ib_status_to_string(rc));
+        return rc;
+    }
+
     /* Copy the original */
     if (str == NULL) {
         (*target)->target_str = NULL;
@@ -27,10 +27,16 @@
  * @author Nick LeRoy <nleroy@qualys.com>
  */
 
+#include <ironbee/action.h>
 #include <ironbee/clock.h>
+#include <ironbee/data.h>
+#include <ironbee/hash.h>
 #include <ironbee/rule_engine.h>
 #include <ironbee/types.h>
 
+#include "rule_body_view_private.h"
+#include "rule_prefilter_private.h"
+
 /**
  * Context-specific rule object.  This is the type of the objects
  * stored in the 'rule_list' field of ib_ruleset_phase_t.
@@ -40,14 +46,98 @@ typedef struct {
     ib_flags_t             flags;        /**< Rule flags (IB_RULECTX_FLAG_xx) */
 } ib_rule_ctx_data_t;
 
+/**
+ * Compiled rule target: a target and its transformations.
+ */
+typedef struct {
+    ib_rule_target_t        *target;     /**< The target */
+    const ib_tfn_t * const  *tfns;       /**< Transformations, in order */
+    size_t                   num_tfns;   /**< Number of transformations */
+} ib_rule_compiled_target_t;
+
+/**
+ * Compiled rule.
+ *
+ * The targets, transformations and actions of a rule are references into
+ * the flat arrays of the compiled ruleset which holds the rule, so that
+ * executing a phase walks a few dense arrays instead of the rule's lists.
+ */
+typedef struct ib_rule_compiled_t ib_rule_compiled_t;
+struct ib_rule_compiled_t {
+    ib_rule_t                        *rule;          /**< The rule itself */
+    const ib_rule_compiled_target_t  *targets;       /**< Targets */
+    const ib_action_inst_t * const   *true_actions;  /**< Actions if True */
+    const ib_action_inst_t * const   *false_actions; /**< Actions if False */
+    const ib_rule_compiled_t         *chained;       /**< Chained rule */
+    uint32_t                          num_targets;   /**< # of targets */
+    uint32_t                          num_true_actions;  /**< # True acts */
+    uint32_t                          num_false_actions; /**< # False acts */
+    const ib_rule_prefilter_t        *prefilter;     /**< Prefilter or NULL */
+    size_t                            prefilter_slot; /**< Prefilter slot */
+};
+
+/**
+ * Compiled ruleset of a context, built when the context is closed.
+ *
+ * The runnable rules of each phase are contiguous in rules, in phase
+ * order, followed by chained rules and by rules owned by other modules
+ * (which may be injected).
+ */
+typedef struct {
+    ib_rule_compiled_t         *rules;       /**< Compiled rules */
+    size_t                      num_rules;   /**< Number of rules */
+    ib_rule_compiled_target_t  *targets;     /**< Targets of all rules */
+    size_t                      num_targets; /**< Number of targets */
+    const ib_tfn_t            **tfns;        /**< Target transformations */
+    size_t                      num_tfns;    /**< Number of tfns */
+    const ib_action_inst_t    **actions;     /**< Rule actions */
+    size_t                      num_actions; /**< Number of actions */
+    ib_hash_t                  *by_rule;     /**< Owned rules by ib_rule_t* */
+} ib_rule_compiled_set_t;
+
+/**
+ * Target index entry: the rules of a phase that target a single field.
+ *
+ * Rule positions are indexes into the phase's rules array, in order.
+ */
+typedef struct {
+    const char            *name;         /**< Field name (no sub-field) */
+    size_t                 nlen;         /**< Length of name */
+    size_t                *rules;        /**< Positions of rules */
+    size_t                 num_rules;    /**< Number of positions in rules */
+} ib_rule_target_index_t;
+
+/**
+ * Index of a phase's rules by target field name.
+ *
+ * Built when the context is closed.  Rules that must run even if none of
+ * their target fields exist (external rules, no-target rules, inverted
+ * operators and operators which accept NULL fields) are in always.
+ */
+typedef struct {
+    size_t                  num_rules;   /**< Number of rules in rules */
+    size_t                 *always;      /**< Positions of unindexed rules */
+    size_t                  num_always;  /**< Number of positions in always */
+    ib_rule_target_index_t *fields;      /**< One entry per target field */
+    size_t                  num_fields;  /**< Number of entries in fields */
+} ib_rule_phase_index_t;
+
 /**
  * Ruleset for a single phase.
  *  rule_list is a list of pointers to ib_rule_ctx_data_t objects.
+ *  rules is the immutable array of the compiled runnable rules in
+ *  rule_list, built when the context is closed and shared by all
+ *  transactions.  If enabled, prefilter holds the literals required by
+ *  the phase's regular expression rules.
  */
 typedef struct {
     ib_rule_phase_num_t         phase_num;   /**< Phase number */
     const ib_rule_phase_meta_t *phase_meta;  /**< Rule phase meta-data */
     ib_list_t                  *rule_list;   /**< Rules to execute in phase */
+    const ib_rule_compiled_t   *rules;       /**< Runnable rules, in order */
+    size_t                      num_rules;   /**< Number of rules in rules */
+    ib_rule_phase_index_t      *index;       /**< Target index or NULL */
+    ib_rule_prefilter_t        *prefilter;   /**< Regex prefilter or NULL */
 } ib_ruleset_phase_t;
 
 /**
@@ -58,6 +148,21 @@ typedef struct {
     ib_ruleset_phase_t     phases[IB_RULE_PHASE_COUNT];
 } ib_ruleset_t;
 
+/**
+ * A body field targeted by a context's phase rules.
+ *
+ * The body is only collected if rules target it.  The first
+ * transformation of each such target is applied to the body as it
+ * arrives if it is streamable, so that phase rules find its result in the
+ * transformation cache.
+ */
+typedef struct {
+    bool                   targeted;     /**< Do any rules target the body? */
+    const ib_tfn_t       **tfns;         /**< Streamable first tfns */
+    size_t                 num_tfns;     /**< Number of tfns */
+    size_t                 limit;        /**< Bytes collected; 0: all */
+} ib_rule_body_targets_t;
+
 /**
  * Data on enable directives.
  */
@@ -73,11 +178,14 @@ typedef struct {
  */
 struct ib_rule_context_t {
     ib_ruleset_t           ruleset;      /**< Rules to exec */
+    ib_rule_compiled_set_t *compiled;    /**< Compiled rules (or NULL) */
     ib_list_t             *rule_list;    /**< All rules owned by context */
     ib_hash_t             *rule_hash;    /**< Hash of rules (by rule-id) */
     ib_list_t             *enable_list;  /**< Enable All/IDs/tags */
     ib_list_t             *disable_list; /**< All/IDs/tags disabled */
     ib_rule_parser_data_t  parser_data;  /**< Rule parser specific data */
+    ib_rule_body_targets_t request_body; /**< Request body targets */
+    ib_rule_body_targets_t response_body; /**< Response body targets */
 };
 
 /**
@@ -85,6 +193,8 @@ struct ib_rule_context_t {
  */
 struct ib_rule_target_t {
     const char            *field_name;    /**< The field name */
+    size_t                 field_nlen;    /**< Length of field_name */
+    ib_data_field_id_t     field_id;      /**< ID of field_name */
     const char            *target_str;    /**< The target string */
     ib_list_t             *tfn_list;      /**< List of transformations */
 };
@@ -574,6 +574,8 @@ ib_status_t ib_rule_log_exec_add_stream_tgt(ib_rule_log_exec_t *exec_log,
     strncpy(fname, field->name, field->nlen);
     *(fname + field->nlen) = '\0';
     target->field_name = fname;
+    target->field_nlen = field->nlen;
+    target->field_id = IB_DATA_FIELD_ID_NONE;
     target->tfn_list = NULL;
     target->target_str = NULL;
 
@@ -893,9 +895,18 @@ static void log_tx_end(
     const ib_rule_exec_t *rule_exec
 )
 {
-    if ( (ib_flags_all(rule_exec->tx_log->flags, IB_RULE_LOG_FLAG_TX)) &&
-         (!rule_exec->tx_log->empty_tx) )
+    const ib_rule_log_tx_t *tx_log = rule_exec->tx_log;
+
+    if ( (ib_flags_all(tx_log->flags, IB_RULE_LOG_FLAG_TX)) &&
+         (!tx_log->empty_tx) )
     {
+        if ( ib_flags_all(tx_log->flags, IB_RULE_LOG_FLAG_TFN) &&
+             ((tx_log->tfn_cache_hits + tx_log->tfn_cache_misses) != 0) )
+        {
+            rule_log_exec(rule_exec, "TFN_CACHE hits=%d misses=%d",
+                          tx_log->tfn_cache_hits,
+                          tx_log->tfn_cache_misses);
+        }
         rule_log_exec(rule_exec, "TX_END");
     }
     return;
@@ -1106,6 +1117,25 @@ void ib_rule_log_tx_event_end(
     return;
 }
 
+/* Count transformation cache lookups */
+void ib_rule_log_tx_tfn_cache(
+    ib_rule_log_tx_t *tx_log,
+    bool hit
+)
+{
+    if (tx_log == NULL) {
+        return;
+    }
+
+    if (hit) {
+        ++(tx_log->tfn_cache_hits);
+    }
+    else {
+        ++(tx_log->tfn_cache_misses);
+    }
+    return;
+}
+
 /* Log audit log file */
 static void log_audit(
     const ib_rule_exec_t *rule_exec
@@ -138,6 +138,8 @@ struct ib_rule_log_tx_t {
     bool                    empty_tx;    /**< Is this an empty transaction? */
     ib_rule_phase_num_t     cur_phase;   /**< Current phase # */
     const char             *phase_name;  /**< Name of current phase */
+    int                     tfn_cache_hits;   /**< # of tfn cache hits */
+    int                     tfn_cache_misses; /**< # of tfn cache misses */
 };
 
 /**
@@ -215,6 +217,18 @@ void ib_rule_log_tx_event_end(
     const ib_rule_exec_t       *rule_exec,
     ib_state_event_type_t       event);
 
+/**
+ * Count a transformation cache lookup
+ *
+ * @param[in,out] tx_log Rule transaction log object (or NULL)
+ * @param[in] hit true if a cached transformation prefix was reused
+ *
+ * @returns void
+ */
+void ib_rule_log_tx_tfn_cache(
+    ib_rule_log_tx_t           *tx_log,
+    bool                        hit);
+
 /**
  * Log start of phase
  *
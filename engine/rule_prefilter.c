@@ -0,0 +1,755 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee --- Rule Prefilter
+ *
+ * Literal extraction walks the pattern once, by recursive descent, and
+ * computes for each (sub)expression a set of literals at least one of
+ * which appears in every match:
+ *
+ * - A run of literal characters is a candidate set of one literal.
+ * - A group is a candidate set, unless its quantifier allows zero
+ *   repetitions.
+ * - A sequence's set is its best candidate set.
+ * - An alternation's set is the union of its branches' sets; if any
+ *   branch has no set, neither does the alternation.
+ *
+ * A set is usable only if all of its literals are at least
+ * IB_RULE_PREFILTER_MIN_LITERAL long, and the best set is the one with the
+ * longest shortest literal.  Anything not understood declines the whole
+ * pattern, so a missing literal can never cause a rule to be skipped.
+ */
+
+#include "ironbee_config_auto.h"
+
+#include "rule_prefilter_private.h"
+
+#include <ironbee/ahocorasick.h>
+#include <ironbee/hash.h>
+
+#include <assert.h>
+#include <ctype.h>
+#include <string.h>
+
+/**
+ * A literal in a prefilter, and the slots which require it.
+ */
+typedef struct {
+    size_t             *slots;        /**< Slots requiring the literal */
+    size_t              num_slots;    /**< Number of slots */
+    size_t              max_slots;    /**< Allocated size of @c slots */
+} prefilter_literal_t;
+
+/**
+ * Rule prefilter.
+ */
+struct ib_rule_prefilter_t {
+    ib_mpool_t         *mp;           /**< Memory pool */
+    ib_ac_t            *ac;           /**< Literal matcher */
+    ib_hash_t          *literals;     /**< Literal -> prefilter_literal_t */
+    size_t              num_slots;    /**< Number of slots */
+    bool                finished;     /**< Has the prefilter been finished? */
+};
+
+/**
+ * Literal extraction parser state.
+ */
+typedef struct {
+    ib_mpool_t         *mp;           /**< Memory pool */
+    const char         *p;            /**< Current position */
+    int                 depth;        /**< Group nesting depth */
+} extract_t;
+
+/**
+ * Set of literals; @c literals is NULL if there is no usable set.
+ */
+typedef struct {
+    ib_list_t          *literals;     /**< Literals (const char *) */
+    size_t              shortest;     /**< Length of the shortest literal */
+} literal_set_t;
+
+/** Deepest group nesting parsed. */
+#define EXTRACT_MAX_DEPTH 32
+
+static ib_status_t extract_alternation(extract_t *ex, literal_set_t *set);
+
+/**
+ * Replace @a best with @a candidate if the latter is better.
+ */
+static void literal_set_choose(literal_set_t *best,
+                               const literal_set_t *candidate)
+{
+    if (candidate->literals == NULL) {
+        return;
+    }
+    if ( (best->literals == NULL) ||
+         (candidate->shortest > best->shortest) ||
+         ( (candidate->shortest == best->shortest) &&
+           (ib_list_elements(candidate->literals) <
+            ib_list_elements(best->literals)) ) )
+    {
+        *best = *candidate;
+    }
+}
+
+/**
+ * End the current run of literal characters, making it a candidate.
+ */
+static ib_status_t extract_end_run(extract_t *ex,
+                                   char *run,
+                                   size_t *run_len,
+                                   literal_set_t *best)
+{
+    literal_set_t candidate;
+    ib_status_t   rc;
+    char         *literal;
+
+    if (*run_len < IB_RULE_PREFILTER_MIN_LITERAL) {
+        *run_len = 0;
+        return IB_OK;
+    }
+
+    literal = ib_mpool_memdup(ex->mp, run, *run_len + 1);
+    if (literal == NULL) {
+        return IB_EALLOC;
+    }
+    literal[*run_len] = '\0';
+
+    rc = ib_list_create(&candidate.literals, ex->mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_list_push(candidate.literals, literal);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    candidate.shortest = *run_len;
+    literal_set_choose(best, &candidate);
+
+    *run_len = 0;
+    return IB_OK;
+}
+
+/**
+ * Parse an optional quantifier.
+ *
+ * @param[in,out] ex Parser state
+ * @param[out] min Minimum repetitions; 1 if there is no quantifier
+ *
+ * @returns true if there was a quantifier
+ */
+static bool extract_quantifier(extract_t *ex, unsigned long *min)
+{
+    const char *p = ex->p;
+
+    switch (*p) {
+    case '?':
+    case '*':
+        *min = 0;
+        ++p;
+        break;
+    case '+':
+        *min = 1;
+        ++p;
+        break;
+    case '{':
+        /* {n}, {n,} and {n,m}; anything else is a literal '{' */
+        ++p;
+        if (! isdigit((unsigned char)*p)) {
+            *min = 1;
+            return false;
+        }
+        *min = 0;
+        while (isdigit((unsigned char)*p)) {
+            *min = (*min * 10) + (*p - '0');
+            if (*min > 0xffff) {
+                *min = 0xffff;
+            }
+            ++p;
+        }
+        if (*p == ',') {
+            ++p;
+            while (isdigit((unsigned char)*p)) {
+                ++p;
+            }
+        }
+        if (*p != '}') {
+            *min = 1;
+            return false;
+        }
+        ++p;
+        break;
+    default:
+        *min = 1;
+        return false;
+    }
+
+    /* Lazy and possessive suffixes */
+    if ( (*p == '?') || (*p == '+') ) {
+        ++p;
+    }
+    ex->p = p;
+    return true;
+}
+
+/**
+ * Skip a character class; @a ex is positioned after the opening '['.
+ */
+static ib_status_t extract_class(extract_t *ex)
+{
+    const char *p = ex->p;
+
+    if (*p == '^') {
+        ++p;
+    }
+    if (*p == ']') {
+        ++p;
+    }
+    while (*p != ']') {
+        if (*p == '\0') {
+            return IB_DECLINED;
+        }
+        else if (*p == '\\') {
+            if (*(p + 1) == '\0') {
+                return IB_DECLINED;
+            }
+            p += 2;
+        }
+        else if ( (*p == '[') && (*(p + 1) == ':') ) {
+            /* [:name:]; otherwise the '[' is just a member */
+            const char *end = p + 2;
+            while (isalpha((unsigned char)*end)) {
+                ++end;
+            }
+            p = ( (*end == ':') && (*(end + 1) == ']') ) ? end + 2 : p + 1;
+        }
+        else {
+            ++p;
+        }
+    }
+    ex->p = p + 1;
+    return IB_OK;
+}
+
+/**
+ * Parse the start of a group; @a ex is positioned after the '('.
+ *
+ * @param[in,out] ex Parser state
+ * @param[out] option_only Set if the group only sets options, e.g. (?i)
+ *
+ * @returns IB_OK, or IB_DECLINED if the group is not understood
+ */
+static ib_status_t extract_group_start(extract_t *ex, bool *option_only)
+{
+    const char *p = ex->p;
+
+    *option_only = false;
+    if (*p == '*') {
+        return IB_DECLINED;
+    }
+    if (*p != '?') {
+        return IB_OK;
+    }
+
+    ++p;
+    switch (*p) {
+    case ':':
+    case '>':
+    case '|':
+        ex->p = p + 1;
+        return IB_OK;
+    case 'P':
+        if (*(p + 1) != '<') {
+            return IB_DECLINED;
+        }
+        ++p;
+        /* fall through */
+    case '<':
+    case '\'':
+    {
+        char close = (*p == '\'') ? '\'' : '>';
+
+        /* Named group, but not a lookbehind */
+        ++p;
+        if (! (isalpha((unsigned char)*p) || (*p == '_')) ) {
+            return IB_DECLINED;
+        }
+        while (isalnum((unsigned char)*p) || (*p == '_')) {
+            ++p;
+        }
+        if (*p != close) {
+            return IB_DECLINED;
+        }
+        ex->p = p + 1;
+        return IB_OK;
+    }
+    default:
+        /* Option setting: (?imsJU-imsJU) and (?imsJU-imsJU:...) */
+        while (strchr("imsJU-", *p) != NULL) {
+            if (*p == '\0') {
+                return IB_DECLINED;
+            }
+            ++p;
+        }
+        if (*p == ')') {
+            *option_only = true;
+            ex->p = p + 1;
+            return IB_OK;
+        }
+        if (*p == ':') {
+            ex->p = p + 1;
+            return IB_OK;
+        }
+        return IB_DECLINED;
+    }
+}
+
+/**
+ * Parse an escape; @a ex is positioned after the '\'.
+ *
+ * @param[in,out] ex Parser state
+ * @param[out] literal The escaped character, or -1 if it is not a literal
+ *
+ * @returns IB_OK, or IB_DECLINED if the escape is not understood
+ */
+static ib_status_t extract_escape(extract_t *ex, int *literal)
+{
+    char c = *ex->p;
+
+    if (c == '\0') {
+        return IB_DECLINED;
+    }
+    ++ex->p;
+
+    if (! isalnum((unsigned char)c)) {
+        *literal = c;
+        return IB_OK;
+    }
+    switch (c) {
+    case 't': *literal = '\t';   return IB_OK;
+    case 'n': *literal = '\n';   return IB_OK;
+    case 'r': *literal = '\r';   return IB_OK;
+    case 'f': *literal = '\f';   return IB_OK;
+    case 'e': *literal = '\x1b'; return IB_OK;
+    case 'a': *literal = '\a';   return IB_OK;
+    default:
+        break;
+    }
+    if (strchr("dDwWsShHvVNRXbBAzZG", c) != NULL) {
+        *literal = -1;
+        return IB_OK;
+    }
+
+    /* Back references, \x, \p, \Q...\E and the rest */
+    return IB_DECLINED;
+}
+
+/**
+ * Parse a sequence, up to a '|', ')' or the end of the pattern.
+ */
+static ib_status_t extract_sequence(extract_t *ex, literal_set_t *best)
+{
+    ib_status_t rc;
+    char       *run;
+    size_t      run_len = 0;
+
+    best->literals = NULL;
+    best->shortest = 0;
+
+    run = ib_mpool_alloc(ex->mp, strlen(ex->p) + 1);
+    if (run == NULL) {
+        return IB_EALLOC;
+    }
+
+    while ( (*ex->p != '\0') && (*ex->p != '|') && (*ex->p != ')') ) {
+        unsigned long min;
+        int           literal = -1;
+        char          c = *ex->p++;
+
+        switch (c) {
+        case '(':
+        {
+            literal_set_t group;
+            bool          option_only;
+
+            rc = extract_end_run(ex, run, &run_len, best);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            rc = extract_group_start(ex, &option_only);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            if (option_only) {
+                continue;
+            }
+            if (++ex->depth > EXTRACT_MAX_DEPTH) {
+                return IB_DECLINED;
+            }
+            rc = extract_alternation(ex, &group);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            if (*ex->p != ')') {
+                return IB_DECLINED;
+            }
+            ++ex->p;
+            --ex->depth;
+            extract_quantifier(ex, &min);
+            if (min > 0) {
+                literal_set_choose(best, &group);
+            }
+            continue;
+        }
+        case '[':
+            rc = extract_class(ex);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            break;
+        case '\\':
+            rc = extract_escape(ex, &literal);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            break;
+        case '.':
+        case '^':
+        case '$':
+            break;
+        case '?':
+        case '*':
+        case '+':
+            /* Quantifier without anything to repeat */
+            return IB_DECLINED;
+        default:
+            literal = (unsigned char)c;
+            break;
+        }
+
+        /* Only ASCII is matched case-insensitively by the automaton. */
+        if ( (literal < 0) || (literal > 0x7f) ) {
+            rc = extract_end_run(ex, run, &run_len, best);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            extract_quantifier(ex, &min);
+            continue;
+        }
+
+        if (! extract_quantifier(ex, &min)) {
+            run[run_len++] = (char)literal;
+            continue;
+        }
+
+        /* A repeated character ends the run; include it if required. */
+        if (min > 0) {
+            run[run_len++] = (char)literal;
+        }
+        rc = extract_end_run(ex, run, &run_len, best);
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    return extract_end_run(ex, run, &run_len, best);
+}
+
+/**
+ * Parse an alternation, up to a ')' or the end of the pattern.
+ */
+static ib_status_t extract_alternation(extract_t *ex, literal_set_t *set)
+{
+    ib_status_t rc;
+
+    set->literals = NULL;
+    set->shortest = 0;
+
+    for (;;) {
+        literal_set_t branch;
+
+        rc = extract_sequence(ex, &branch);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        if (branch.literals == NULL) {
+            /* Keep parsing, so that errors are still found. */
+            while (*ex->p == '|') {
+                ++ex->p;
+                rc = extract_sequence(ex, &branch);
+                if (rc != IB_OK) {
+                    return rc;
+                }
+            }
+            set->literals = NULL;
+            return IB_OK;
+        }
+
+        if (set->literals == NULL) {
+            *set = branch;
+        }
+        else {
+            const ib_list_node_t *node;
+
+            IB_LIST_LOOP_CONST(branch.literals, node) {
+                rc = ib_list_push(set->literals, node->data);
+                if (rc != IB_OK) {
+                    return rc;
+                }
+            }
+            if (branch.shortest < set->shortest) {
+                set->shortest = branch.shortest;
+            }
+        }
+
+        if (*ex->p != '|') {
+            return IB_OK;
+        }
+        ++ex->p;
+    }
+}
+
+ib_status_t ib_rule_prefilter_literals(
+    ib_mpool_t                 *mp,
+    const char                 *pattern,
+    ib_list_t                  *literals)
+{
+    assert(mp != NULL);
+    assert(pattern != NULL);
+    assert(literals != NULL);
+
+    extract_t             ex;
+    literal_set_t         set;
+    const ib_list_node_t *node;
+    ib_status_t           rc;
+
+    ex.mp = mp;
+    ex.p = pattern;
+    ex.depth = 0;
+
+    rc = extract_alternation(&ex, &set);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    if (*ex.p != '\0') {
+        /* Unbalanced ')' */
+        return IB_DECLINED;
+    }
+    if (set.literals == NULL) {
+        return IB_DECLINED;
+    }
+
+    IB_LIST_LOOP_CONST(set.literals, node) {
+        rc = ib_list_push(literals, node->data);
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    return IB_OK;
+}
+
+ib_status_t ib_rule_prefilter_create(
+    ib_mpool_t                 *mp,
+    ib_rule_prefilter_t       **prefilter)
+{
+    assert(mp != NULL);
+    assert(prefilter != NULL);
+
+    ib_rule_prefilter_t *pf;
+    ib_status_t          rc;
+
+    pf = ib_mpool_calloc(mp, 1, sizeof(*pf));
+    if (pf == NULL) {
+        return IB_EALLOC;
+    }
+    pf->mp = mp;
+
+    rc = ib_ac_create(&pf->ac, IB_AC_FLAG_PARSER_NOCASE, mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_hash_create_nocase(&pf->literals, mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    *prefilter = pf;
+    return IB_OK;
+}
+
+/**
+ * Record that @a slot requires @a literal.
+ */
+static ib_status_t prefilter_add_literal(
+    ib_rule_prefilter_t        *pf,
+    const char                 *literal,
+    size_t                      slot)
+{
+    prefilter_literal_t *entry;
+    size_t               len = strlen(literal);
+    ib_status_t          rc;
+
+    rc = ib_hash_get_ex(pf->literals, &entry, literal, len);
+    if (rc == IB_ENOENT) {
+        entry = ib_mpool_calloc(pf->mp, 1, sizeof(*entry));
+        if (entry == NULL) {
+            return IB_EALLOC;
+        }
+        rc = ib_ac_add_pattern(pf->ac, literal, NULL, entry, len);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        rc = ib_hash_set_ex(pf->literals, literal, len, entry);
+    }
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    /* Slots are added in order, so a duplicate is always the last. */
+    if ( (entry->num_slots > 0) &&
+         (entry->slots[entry->num_slots - 1] == slot) )
+    {
+        return IB_OK;
+    }
+    if (entry->num_slots == entry->max_slots) {
+        size_t  max = (entry->max_slots == 0) ? 4 : entry->max_slots * 2;
+        size_t *slots = ib_mpool_alloc(pf->mp, max * sizeof(*slots));
+
+        if (slots == NULL) {
+            return IB_EALLOC;
+        }
+        if (entry->num_slots > 0) {
+            memcpy(slots, entry->slots, entry->num_slots * sizeof(*slots));
+        }
+        entry->slots = slots;
+        entry->max_slots = max;
+    }
+    entry->slots[entry->num_slots++] = slot;
+
+    return IB_OK;
+}
+
+ib_status_t ib_rule_prefilter_add(
+    ib_rule_prefilter_t        *prefilter,
+    const char                 *pattern,
+    size_t                     *slot)
+{
+    assert(prefilter != NULL);
+    assert(pattern != NULL);
+    assert(slot != NULL);
+
+    ib_list_t            *literals;
+    const ib_list_node_t *node;
+    ib_status_t           rc;
+
+    if (prefilter->finished) {
+        return IB_EINVAL;
+    }
+
+    rc = ib_list_create(&literals, prefilter->mp);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_rule_prefilter_literals(prefilter->mp, pattern, literals);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    IB_LIST_LOOP_CONST(literals, node) {
+        rc = prefilter_add_literal(prefilter,
+                                   (const char *)node->data,
+                                   prefilter->num_slots);
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    *slot = prefilter->num_slots++;
+    return IB_OK;
+}
+
+ib_status_t ib_rule_prefilter_finish(
+    ib_rule_prefilter_t        *prefilter)
+{
+    assert(prefilter != NULL);
+
+    ib_status_t rc;
+
+    if (prefilter->finished) {
+        return IB_OK;
+    }
+    rc = ib_ac_build_links(prefilter->ac);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    prefilter->finished = true;
+
+    return IB_OK;
+}
+
+size_t ib_rule_prefilter_slots(
+    const ib_rule_prefilter_t  *prefilter)
+{
+    assert(prefilter != NULL);
+
+    return prefilter->num_slots;
+}
+
+/**
+ * Set the slots of a found literal; ib_ac_scan() callback.
+ */
+static void prefilter_scan_fn(const void *data, void *cbdata)
+{
+    const prefilter_literal_t *entry = (const prefilter_literal_t *)data;
+    uint8_t                   *result = (uint8_t *)cbdata;
+    size_t                     n;
+
+    for (n = 0;  n < entry->num_slots;  ++n) {
+        size_t slot = entry->slots[n];
+        result[slot / 8] |= (uint8_t)(1 << (slot % 8));
+    }
+}
+
+ib_status_t ib_rule_prefilter_scan(
+    const ib_rule_prefilter_t  *prefilter,
+    const char                 *data,
+    size_t                      len,
+    uint8_t                    *result)
+{
+    assert(prefilter != NULL);
+    assert(result != NULL);
+
+    ib_status_t rc;
+
+    if (! prefilter->finished) {
+        return IB_EINVAL;
+    }
+
+    memset(result, 0, IB_RULE_PREFILTER_RESULT_SIZE(prefilter));
+    if ( (data == NULL) || (len == 0) || (prefilter->num_slots == 0) ) {
+        return IB_OK;
+    }
+
+    rc = ib_ac_scan(prefilter->ac, data, len, prefilter_scan_fn, result);
+    if (rc == IB_ENOENT) {
+        return IB_OK;
+    }
+    return rc;
+}
@@ -0,0 +1,163 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+#ifndef _IB_RULE_PREFILTER_PRIVATE_H_
+#define _IB_RULE_PREFILTER_PRIVATE_H_
+
+/**
+ * @file
+ * @brief IronBee --- Rule Prefilter Private Declarations
+ *
+ * A prefilter holds the literals required by the regular expressions of
+ * a phase's rules in a single Aho-Corasick automaton.  A value is scanned
+ * once, and a rule's expression only needs to be run if one of its
+ * literals was found.
+ *
+ * These definitions and routines are called by the rule engine and nowhere
+ * else.
+ */
+
+#include <ironbee/list.h>
+#include <ironbee/mpool.h>
+#include <ironbee/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Shortest literal worth prefiltering on. */
+#define IB_RULE_PREFILTER_MIN_LITERAL 3
+
+/**
+ * Rule prefilter.
+ */
+typedef struct ib_rule_prefilter_t ib_rule_prefilter_t;
+
+/**
+ * Extract the literals required by a regular expression.
+ *
+ * On success, any string which @a pattern matches contains at least one
+ * of the literals, ignoring case.  Only a conservative subset of the
+ * PCRE syntax is understood; patterns using anything else are declined.
+ *
+ * @param[in] mp Memory pool for allocations
+ * @param[in] pattern Regular expression
+ * @param[out] literals List to append the literals to (const char *)
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_DECLINED if no literals of at least
+ *     IB_RULE_PREFILTER_MIN_LITERAL characters are required.
+ *   - IB_EALLOC on allocation failure.
+ */
+ib_status_t ib_rule_prefilter_literals(
+    ib_mpool_t                 *mp,
+    const char                 *pattern,
+    ib_list_t                  *literals);
+
+/**
+ * Create an empty prefilter.
+ *
+ * @param[in] mp Memory pool for allocations
+ * @param[out] prefilter New prefilter
+ *
+ * @returns Status code
+ */
+ib_status_t ib_rule_prefilter_create(
+    ib_mpool_t                 *mp,
+    ib_rule_prefilter_t       **prefilter);
+
+/**
+ * Add a regular expression to a prefilter.
+ *
+ * @param[in,out] prefilter Prefilter
+ * @param[in] pattern Regular expression
+ * @param[out] slot Slot of @a pattern in the prefilter's results
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_DECLINED if @a pattern can't be prefiltered.
+ *   - IB_EINVAL if the prefilter has been finished.
+ *   - IB_EALLOC on allocation failure.
+ */
+ib_status_t ib_rule_prefilter_add(
+    ib_rule_prefilter_t        *prefilter,
+    const char                 *pattern,
+    size_t                     *slot);
+
+/**
+ * Finish a prefilter; no more expressions can be added.
+ *
+ * @param[in,out] prefilter Prefilter
+ *
+ * @returns Status code
+ */
+ib_status_t ib_rule_prefilter_finish(
+    ib_rule_prefilter_t        *prefilter);
+
+/**
+ * Get the number of slots of a prefilter.
+ *
+ * @param[in] prefilter Prefilter
+ *
+ * @returns Number of expressions added to @a prefilter
+ */
+size_t ib_rule_prefilter_slots(
+    const ib_rule_prefilter_t  *prefilter);
+
+/**
+ * Size, in bytes, of the result bitmap of @a prefilter.
+ */
+#define IB_RULE_PREFILTER_RESULT_SIZE(prefilter) \
+    ((ib_rule_prefilter_slots(prefilter) + 7) / 8)
+
+/**
+ * Test a slot of a result bitmap.
+ */
+#define IB_RULE_PREFILTER_TEST(result, slot) \
+    (((result)[(slot) / 8] & (1 << ((slot) % 8))) != 0)
+
+/**
+ * Scan a value with a finished prefilter.
+ *
+ * The slot of each expression whose literals were found is set in
+ * @a result, which must be IB_RULE_PREFILTER_RESULT_SIZE() bytes.  The
+ * prefilter is not modified, and may be used by several threads at once.
+ *
+ * @param[in] prefilter Prefilter
+ * @param[in] data Value to scan
+ * @param[in] len Length of @a data
+ * @param[out] result Result bitmap
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EINVAL if the prefilter has not been finished.
+ */
+ib_status_t ib_rule_prefilter_scan(
+    const ib_rule_prefilter_t  *prefilter,
+    const char                 *data,
+    size_t                      len,
+    uint8_t                    *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_RULE_PREFILTER_PRIVATE_H_ */
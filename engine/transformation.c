@@ -44,6 +44,16 @@ ib_status_t ib_tfn_register(ib_engine_t *ib,
                             ib_tfn_fn_t fn_execute,
                             ib_flags_t flags,
                             void *fndata)
+{
+    return ib_tfn_register_ex(ib, name, fn_execute, NULL, flags, fndata);
+}
+
+ib_status_t ib_tfn_register_ex(ib_engine_t *ib,
+                               const char *name,
+                               ib_tfn_fn_t fn_execute,
+                               ib_tfn_holdback_fn_t fn_holdback,
+                               ib_flags_t flags,
+                               void *fndata)
 {
     assert(ib != NULL);
     assert(name != NULL);
@@ -65,6 +75,7 @@ ib_status_t ib_tfn_register(ib_engine_t *ib,
     }
     tfn->name = name_copy;
     tfn->fn_execute = fn_execute;
+    tfn->fn_holdback = fn_holdback;
     tfn->tfn_flags = flags;
     tfn->fndata = fndata;
 
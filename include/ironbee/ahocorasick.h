@@ -83,6 +83,7 @@ typedef struct ib_ac_t ib_ac_t;
 typedef struct ib_ac_state_t ib_ac_state_t;
 typedef struct ib_ac_context_t ib_ac_context_t;
 typedef struct ib_ac_match_t ib_ac_match_t;
+typedef struct ib_ac_dfa_t ib_ac_dfa_t;
 
 typedef char ib_ac_char_t;
 
@@ -96,6 +97,9 @@ struct ib_ac_t {
     ib_ac_state_t *root;     /**< root of the direct tree */
 
     uint32_t pattern_cnt;   /**< number of patterns */
+
+    ib_ac_dfa_t *dfa;       /**< dense transition table, or NULL; see
+                                 ib_ac_build_dfa() */
 };
 
 /**
@@ -205,6 +209,28 @@ ib_status_t ib_ac_create(ib_ac_t **ac_tree,
  */
 ib_status_t ib_ac_build_links(ib_ac_t *ac_tree);
 
+/**
+ * Compiles the matcher into a dense transition table (a DFA)
+ *
+ * Once built, ib_ac_consume() and ib_ac_scan() take one table lookup per
+ * byte and never follow fail links.  Bytes are first mapped to classes:
+ * each byte used by a pattern has its own class and all other bytes share
+ * one, so a row of the table has one entry per class instead of 256.
+ *
+ * The table takes (states x classes) 32 bit entries.  If that is more than
+ * @a max_size bytes, it is not built and matching keeps using the trie.
+ *
+ * @param ac_tree the matcher; links must have been built
+ * @param max_size maximum size of the table in bytes, or 0 for no limit
+ *
+ * @returns
+ *   - IB_OK on success or if the table is already built.
+ *   - IB_DECLINED if the table would be larger than @a max_size.
+ *   - IB_EINVAL if the links of @a ac_tree have not been built.
+ *   - IB_EALLOC on allocation failure.
+ */
+ib_status_t ib_ac_build_dfa(ib_ac_t *ac_tree, size_t max_size);
+
 /**
  * adds a pattern into the trie
  *
@@ -244,6 +270,40 @@ ib_status_t ib_ac_consume(ib_ac_context_t *ac_ctx,
                           uint8_t flags,
                           ib_mpool_t *mp);
 
+/**
+ * Callback for ib_ac_scan()
+ *
+ * @param data the data associated with the matched pattern
+ * @param cbdata callback data passed to ib_ac_scan()
+ */
+typedef void (*ib_ac_scan_fn_t)(const void *data,
+                                void *cbdata);
+
+/**
+ * Report every pattern of the ac_tree matcher found in the given buffer.
+ *
+ * Unlike ib_ac_consume(), this neither allocates memory nor modifies the
+ * matcher, so a matcher may be scanned by several threads at once.  The
+ * links must have been built with ib_ac_build_links().  A pattern is
+ * reported once for each place it is found.
+ *
+ * @param ac_tree the matcher
+ * @param data pointer to the buffer to search in
+ * @param len the length of the data
+ * @param fn function to call with the data of each matched pattern
+ * @param cbdata callback data for @a fn
+ *
+ * @returns
+ *   - IB_OK if any pattern was found.
+ *   - IB_ENOENT if no pattern was found.
+ *   - IB_EINVAL if the links of @a ac_tree have not been built.
+ */
+ib_status_t ib_ac_scan(const ib_ac_t *ac_tree,
+                       const char *data,
+                       size_t len,
+                       ib_ac_scan_fn_t fn,
+                       void *cbdata);
+
 
 /** @} IronBeeUtilAhoCorasick */
 
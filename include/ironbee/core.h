@@ -55,6 +55,16 @@ extern "C" {
 /* Static module declarations */
 ib_module_t *ib_core_module(void);
 
+/**
+ * Transaction ID formats (TxIdFormat directive).
+ *
+ * @sa ib_tx_generate_id()
+ */
+typedef enum {
+    IB_TX_ID_RANDOM,                    /**< Random (version 4) UUID */
+    IB_TX_ID_SORTABLE                   /**< Time ordered UUID */
+} ib_tx_id_format_t;
+
 /**
  * Core configuration.
  */
@@ -95,9 +105,46 @@ struct ib_core_cfg_t {
     ib_num_t         rule_log_level;    /**< Rule execution logging level */
     const char      *rule_debug_str;    /**< Rule debug logging level */
     ib_num_t         rule_debug_level;  /**< Rule debug logging level */
+    ib_num_t         rule_prefilter;    /**< Prefilter regex rules? */
+    ib_num_t         rule_body_limit;   /**< Body bytes for rules; 0: all */
     ib_num_t         block_status;      /**< Status codes when blocking. */
+    ib_num_t         tx_id_format;      /**< ib_tx_id_format_t */
 };
 
+/**
+ * Asynchronous audit log writer metrics.
+ *
+ * @sa ib_core_audit_stats()
+ */
+typedef struct {
+    bool             async;             /**< Is the writer running? */
+    size_t           queue_size;        /**< Number of queue slots */
+    size_t           depth;             /**< Records currently queued */
+    size_t           depth_high_water;  /**< Largest depth seen */
+    uint64_t         queued;            /**< Records queued */
+    uint64_t         written;           /**< Records written */
+    uint64_t         dropped;           /**< Records dropped (queue full) */
+    uint64_t         blocked;           /**< Workers blocked (queue full) */
+    uint64_t         batches;           /**< Batches written */
+    uint64_t         errors;            /**< Records which failed to write */
+} ib_core_audit_stats_t;
+
+/**
+ * Get the asynchronous audit log writer metrics.
+ *
+ * If the writer is not running (AuditLogAsync is Off), @a stats is zeroed.
+ * The values are read without stopping the writer, so they are only
+ * approximately consistent with each other.
+ *
+ * @param[in] ib IronBee engine
+ * @param[out] stats Metrics
+ *
+ * @returns IB_OK, or IB_EUNKNOWN if the core module is not initialized.
+ */
+ib_status_t DLL_PUBLIC ib_core_audit_stats(
+    const ib_engine_t      *ib,
+    ib_core_audit_stats_t  *stats);
+
 
 /**
  * @} IronBeeCore
@@ -18,6 +18,7 @@
 #ifndef _IB_DATA_H_
 #define _IB_DATA_H_
 
+#include <ironbee/expand.h>
 #include <ironbee/field.h>
 #include <ironbee/mpool.h>
 #include <ironbee/types.h>
@@ -45,6 +46,82 @@ extern "C" {
  */
 typedef struct ib_data_t ib_data_t;
 
+/**
+ * Interned IDs of core field names.
+ *
+ * Every data store has a slot for each core field, kept in step with its
+ * hash of fields, so that a core field can be fetched by ID with
+ * ib_data_get_id() instead of hashing its name.  Names are matched case
+ * insensitively, as in the hash.  Other names have no ID and are only
+ * found through the hash.
+ */
+typedef enum {
+    IB_DATA_FIELD_ID_NONE = -1,               /**< Not a core field */
+    IB_DATA_FIELD_ID_ARGS,                    /**< ARGS */
+    IB_DATA_FIELD_ID_FLAGS,                   /**< FLAGS */
+    IB_DATA_FIELD_ID_FIELD,                   /**< FIELD */
+    IB_DATA_FIELD_ID_FIELD_TFN,               /**< FIELD_TFN */
+    IB_DATA_FIELD_ID_FIELD_TARGET,            /**< FIELD_TARGET */
+    IB_DATA_FIELD_ID_FIELD_NAME,              /**< FIELD_NAME */
+    IB_DATA_FIELD_ID_FIELD_NAME_FULL,         /**< FIELD_NAME_FULL */
+    IB_DATA_FIELD_ID_REQUEST_LINE,            /**< request_line */
+    IB_DATA_FIELD_ID_REQUEST_METHOD,          /**< request_method */
+    IB_DATA_FIELD_ID_REQUEST_PROTOCOL,        /**< request_protocol */
+    IB_DATA_FIELD_ID_REQUEST_URI,             /**< request_uri */
+    IB_DATA_FIELD_ID_REQUEST_URI_RAW,         /**< request_uri_raw */
+    IB_DATA_FIELD_ID_REQUEST_URI_SCHEME,      /**< request_uri_scheme */
+    IB_DATA_FIELD_ID_REQUEST_URI_USERNAME,    /**< request_uri_username */
+    IB_DATA_FIELD_ID_REQUEST_URI_PASSWORD,    /**< request_uri_password */
+    IB_DATA_FIELD_ID_REQUEST_URI_HOST,        /**< request_uri_host */
+    IB_DATA_FIELD_ID_REQUEST_HOST,            /**< request_host */
+    IB_DATA_FIELD_ID_REQUEST_URI_PORT,        /**< request_uri_port */
+    IB_DATA_FIELD_ID_REQUEST_URI_PATH,        /**< request_uri_path */
+    IB_DATA_FIELD_ID_REQUEST_URI_QUERY,       /**< request_uri_query */
+    IB_DATA_FIELD_ID_REQUEST_URI_FRAGMENT,    /**< request_uri_fragment */
+    IB_DATA_FIELD_ID_REQUEST_CONTENT_TYPE,    /**< request_content_type */
+    IB_DATA_FIELD_ID_REQUEST_FILENAME,        /**< request_filename */
+    IB_DATA_FIELD_ID_AUTH_TYPE,               /**< auth_type */
+    IB_DATA_FIELD_ID_AUTH_USERNAME,           /**< auth_username */
+    IB_DATA_FIELD_ID_AUTH_PASSWORD,           /**< auth_password */
+    IB_DATA_FIELD_ID_REQUEST_HEADERS,         /**< request_headers */
+    IB_DATA_FIELD_ID_REQUEST_COOKIES,         /**< request_cookies */
+    IB_DATA_FIELD_ID_REQUEST_URI_PARAMS,      /**< request_uri_params */
+    IB_DATA_FIELD_ID_REQUEST_BODY_PARAMS,     /**< request_body_params */
+    IB_DATA_FIELD_ID_REQUEST_BODY,            /**< request_body */
+    IB_DATA_FIELD_ID_RESPONSE_LINE,           /**< response_line */
+    IB_DATA_FIELD_ID_RESPONSE_PROTOCOL,       /**< response_protocol */
+    IB_DATA_FIELD_ID_RESPONSE_STATUS,         /**< response_status */
+    IB_DATA_FIELD_ID_RESPONSE_MESSAGE,        /**< response_message */
+    IB_DATA_FIELD_ID_RESPONSE_CONTENT_TYPE,   /**< response_content_type */
+    IB_DATA_FIELD_ID_RESPONSE_HEADERS,        /**< response_headers */
+    IB_DATA_FIELD_ID_RESPONSE_COOKIES,        /**< response_cookies */
+    IB_DATA_FIELD_ID_RESPONSE_BODY,           /**< response_body */
+    IB_DATA_FIELD_ID_SERVER_ADDR,             /**< server_addr */
+    IB_DATA_FIELD_ID_SERVER_PORT,             /**< server_port */
+    IB_DATA_FIELD_ID_REMOTE_ADDR,             /**< remote_addr */
+    IB_DATA_FIELD_ID_REMOTE_PORT,             /**< remote_port */
+    IB_DATA_FIELD_ID_COUNT                    /**< Number of core fields */
+} ib_data_field_id_t;
+
+/**
+ * Look up the ID of a field name.
+ *
+ * Only the part of @a name before any list filter marker (@c :) is
+ * considered, so @c ARGS:foo and @c ARGS:/^foo/ have the ID of @c ARGS.
+ * Resolve names once, e.g. when a rule is created, and use
+ * ib_data_get_id() at runtime.
+ *
+ * @param[in] name Name as byte string.
+ * @param[in] nlen Name length.
+ *
+ * @returns ID of the field, or IB_DATA_FIELD_ID_NONE if it is not a core
+ *          field.
+ */
+ib_data_field_id_t DLL_PUBLIC ib_data_field_id(
+    const char *name,
+    size_t      nlen
+);
+
 /**
  * Create new data store.
  *
@@ -59,6 +136,74 @@ ib_status_t DLL_PUBLIC ib_data_create(
     ib_data_t  **data
 );
 
+/**
+ * Compiled list filter cache.
+ *
+ * Holds the compiled regular expressions of list filter expressions, i.e.
+ * the @c pattern in @c FOO:/pattern/.  Filters are added at configuration
+ * time; at runtime the cache is only read, so one cache can be shared by
+ * all data stores without locking.
+ */
+typedef struct ib_data_filter_cache_t ib_data_filter_cache_t;
+
+/* Shared pattern cache; see ironbee/pcre_cache.h */
+struct ib_pcre_cache_t;
+
+/**
+ * Create a list filter cache.
+ *
+ * Filter patterns are compiled into, and shared with, @a pcre.
+ *
+ * @param[in]  mp    Memory pool to use.
+ * @param[in]  pcre  Shared pattern cache.
+ * @param[out] cache The new filter cache.
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_data_filter_cache_create(
+    ib_mpool_t              *mp,
+    struct ib_pcre_cache_t  *pcre,
+    ib_data_filter_cache_t **cache
+);
+
+/**
+ * Compile the list filter of a field name, if any, into @a cache.
+ *
+ * Names without a pattern filter are ignored.  The pattern is studied, and
+ * JIT compiled if PCRE supports it.  This is not thread safe and must only
+ * be called during configuration.
+ *
+ * @param[in] cache Filter cache.
+ * @param[in] name Field name, e.g. @c ARGS:/^foo/
+ * @param[in] nlen Length of @a name.
+ * @returns
+ * - IB_OK on success, or if @a name has no pattern filter.
+ * - IB_EINVAL if the filter is malformed or the pattern cannot compile.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_data_filter_cache_add(
+    ib_data_filter_cache_t *cache,
+    const char             *name,
+    size_t                  nlen
+);
+
+/**
+ * Set the list filter cache used by @a data.
+ *
+ * Pattern filters found in @a cache are not recompiled by ib_data_get_ex().
+ * Others, and all patterns without a filter cache, are compiled for each
+ * lookup and never added to the cache: only patterns known at
+ * configuration time are kept.
+ *
+ * @param[in] data Data.
+ * @param[in] cache Filter cache (or NULL for none).
+ */
+void DLL_PUBLIC ib_data_set_filter_cache(
+    ib_data_t                    *data,
+    const ib_data_filter_cache_t *cache
+);
+
 /**
  * Access data pool of @a data.
  *
@@ -210,6 +355,44 @@ ib_status_t DLL_PUBLIC ib_data_get_ex(
     ib_field_t      **pf
 );
 
+/**
+ * Get a data field, using the ID of its name if it has one.
+ *
+ * Behaves as ib_data_get_ex(), except that if @a id is not
+ * IB_DATA_FIELD_ID_NONE, the field (or, for a name with a list filter, the
+ * list) is taken from the slot for @a id rather than looked up by name.
+ *
+ * @param[in] data Data.
+ * @param[in] id ID of @a name from ib_data_field_id().
+ * @param[in] name Name as byte string
+ * @param[in] nlen Name length
+ * @param[out] pf Pointer where field is written.  Must not be NULL.
+ *
+ * @returns IB_OK on success or IB_ENOENT if the element is not found.
+ */
+ib_status_t DLL_PUBLIC ib_data_get_id(
+    const ib_data_t    *data,
+    ib_data_field_id_t  id,
+    const char         *name,
+    size_t              nlen,
+    ib_field_t        **pf
+);
+
+/**
+ * Get the generation of @a data.
+ *
+ * The generation changes whenever a top level field is added to or
+ * replaced in @a data, so a caller can tell whether lookups it made
+ * earlier may have changed.  Removals do not change the generation.
+ *
+ * @param[in] data Data.
+ *
+ * @returns Current generation.
+ */
+size_t DLL_PUBLIC ib_data_generation(
+    const ib_data_t *data
+);
+
 /**
  * Get all data fields from a data provider instance.
  *
@@ -348,6 +531,24 @@ ib_status_t ib_data_remove(
     ib_field_t **pf
 );
 
+/**
+ * Remove the core field with ID @a id.
+ *
+ * Behaves as ib_data_remove_ex() with the name of @a id, but without
+ * resolving the name.
+ *
+ * @param[in] data Data.
+ * @param[in] id ID of a core field; not IB_DATA_FIELD_ID_NONE.
+ * @param[out] pf Pointer where old field is written if non-NULL
+ *
+ * @returns IB_OK on success or IB_ENOENT if the field is not set.
+ */
+ib_status_t DLL_PUBLIC ib_data_remove_id(
+    ib_data_t           *data,
+    ib_data_field_id_t   id,
+    ib_field_t         **pf
+);
+
 /**
  * Set a data field.
  * @param[in] data Data.
@@ -363,6 +564,25 @@ ib_status_t DLL_PUBLIC ib_data_set(
     size_t      nlen
 );
 
+/**
+ * Set the core field with ID @a id.
+ *
+ * Behaves as ib_data_set() with the name of @a id, but without resolving
+ * the name.  Use it where the field being set is known when the code is
+ * written, e.g. the FIELD fields set for every rule target.
+ *
+ * @param[in] data Data.
+ * @param[in] id ID of a core field; not IB_DATA_FIELD_ID_NONE.
+ * @param[in] f Field to set to.
+ *
+ * @returns Status code.
+ */
+ib_status_t DLL_PUBLIC ib_data_set_id(
+    ib_data_t          *data,
+    ib_data_field_id_t  id,
+    ib_field_t         *f
+);
+
 /**
  * Set a relative data field value.
  *
@@ -468,6 +688,57 @@ ib_status_t DLL_PUBLIC ib_data_expand_test_str_ex(
     bool       *result
 );
 
+/**
+ * Compile a string into a template for ib_data_expand_template_str().
+ *
+ * Compile strings that are expanded repeatedly, such as action parameters,
+ * once at configuration time.  Names of core fields are resolved to their
+ * IDs (see ib_data_field_id()).
+ *
+ * @sa ib_expand_template_create()
+ *
+ * @param[in] mp Memory pool
+ * @param[in] str String to compile
+ * @param[in] slen Length of @a str
+ * @param[out] tmpl Compiled template
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC if a memory allocation failed.
+ */
+ib_status_t DLL_PUBLIC ib_data_expand_template_create(
+    ib_mpool_t            *mp,
+    const char            *str,
+    size_t                 slen,
+    ib_expand_template_t **tmpl
+);
+
+/**
+ * Expand a template from ib_data_expand_template_create() using @a data.
+ *
+ * The result is the same as that of ib_data_expand_str() without
+ * @a recurse on the string the template was compiled from.
+ *
+ * @sa ib_expand_template_str()
+ *
+ * @param[in] data Data
+ * @param[in] tmpl Template
+ * @param[in] nul Append a NUL byte to the end of @a result?
+ * @param[out] result Resulting string
+ * @param[out] result_len Length of @a result
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC if a memory allocation failed.
+ */
+ib_status_t DLL_PUBLIC ib_data_expand_template_str(
+    const ib_data_t             *data,
+    const ib_expand_template_t  *tmpl,
+    bool                         nul,
+    char                       **result,
+    size_t                      *result_len
+);
+
 /**
  * @} IronBeeEngineData
  */
@@ -32,6 +32,7 @@
 #include <ironbee/engine_types.h>
 #include <ironbee/field.h>
 #include <ironbee/hash.h>
+#include <ironbee/mpool.h>
 #include <ironbee/parsed_content.h>
 #include <ironbee/server.h>
 #include <ironbee/stream.h>
@@ -236,6 +237,72 @@ ib_mpool_t DLL_PUBLIC *ib_engine_pool_temp_get(const ib_engine_t *ib);
  */
 void DLL_PUBLIC ib_engine_pool_temp_destroy(ib_engine_t *ib);
 
+/**
+ * Memory pool roles.
+ *
+ * Each role has a memory pool policy (see ib_mpool_policy_t), which can be
+ * tuned with the MemPoolPolicy directive.
+ */
+typedef enum {
+    IB_ENGINE_POOL_ENGINE,   /**< Engine pool; see ib_engine_pool_main_get() */
+    IB_ENGINE_POOL_CONFIG,   /**< Config pools */
+    IB_ENGINE_POOL_CONN,     /**< Connection pools */
+    IB_ENGINE_POOL_TX,       /**< Transaction pools */
+    IB_ENGINE_POOL_TEMP,     /**< Temporary pool */
+    IB_ENGINE_POOL_ROLE_NUM  /**< Number of roles */
+} ib_engine_pool_role_t;
+
+/**
+ * Get the memory pool policy of a role.
+ *
+ * @param[in] ib   Engine handle
+ * @param[in] role Role
+ *
+ * @returns Policy of @a role
+ */
+const ib_mpool_policy_t DLL_PUBLIC *ib_engine_pool_policy_get(
+    const ib_engine_t     *ib,
+    ib_engine_pool_role_t  role);
+
+/**
+ * Set the memory pool policy of a role.
+ *
+ * The policy applies to pools of @a role created afterwards.  The engine,
+ * config, and temporary pools are created by ib_engine_create(), so only
+ * later pools of those roles, e.g., those of the configuration parser, are
+ * affected.  The role name of the policy is kept.
+ *
+ * @param[in] ib     Engine handle
+ * @param[in] role   Role
+ * @param[in] policy New policy; copied.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EINVAL if @a role is invalid.
+ */
+ib_status_t DLL_PUBLIC ib_engine_pool_policy_set(
+    ib_engine_t             *ib,
+    ib_engine_pool_role_t    role,
+    const ib_mpool_policy_t *policy);
+
+/**
+ * Create a memory pool for a role.
+ *
+ * @param[in]  ib     Engine handle
+ * @param[in]  role   Role; determines the pool's policy
+ * @param[in]  name   Name of the pool
+ * @param[in]  parent Parent pool
+ * @param[out] pmp    New pool
+ *
+ * @returns Status code, see ib_mpool_create_policy().
+ */
+ib_status_t DLL_PUBLIC ib_engine_pool_create(
+    const ib_engine_t      *ib,
+    ib_engine_pool_role_t   role,
+    const char             *name,
+    ib_mpool_t             *parent,
+    ib_mpool_t            **pmp);
+
 /**
  * Destroy a memory pool.
  *
@@ -696,6 +763,10 @@ void DLL_PUBLIC ib_conn_destroy(ib_conn_t *conn);
  * being created in other ways (e.g. in the tests), use this to generate the
  * TX's ID.
  *
+ * The format of the ID is set by the TxIdFormat directive of the main
+ * context of @a tx->ib: a random UUID (default) or one that sorts by
+ * time.  If @a tx->ib is NULL, a random UUID is used.
+ *
  * @param[in,out] tx Transaction to populate
  * @param[in] mp Memory pool to use.
  *
@@ -243,6 +243,115 @@ ib_status_t DLL_PUBLIC ib_expand_test_str_ex(const char *str,
                                              const char *suffix,
                                              bool *result);
 
+/**
+ * Compiled expansion template.
+ *
+ * A string split, once, into literal text and the names to expand.
+ * Expanding a template usually does no searching and builds the result
+ * with a single allocation.
+ *
+ * @sa ib_expand_template_create()
+ * @sa ib_expand_template_str()
+ */
+typedef struct ib_expand_template_t ib_expand_template_t;
+
+/**
+ * Function to resolve a name when a template is compiled.
+ *
+ * @param[in] name Key name
+ * @param[in] nlen Length of @a name
+ *
+ * @returns ID passed to the ib_expand_template_lookup_fn_t for @a name, or
+ *          -1 if it has none.
+ */
+typedef int (* ib_expand_resolve_fn_t)(const char *name,
+                                       size_t nlen);
+
+/**
+ * Function to lookup a key for expansion of a template.
+ *
+ * @param[in] data Object to look up data in
+ * @param[in] id ID of @a name from the ib_expand_resolve_fn_t, or -1
+ * @param[in] name Key name
+ * @param[in] nlen Length of @a name
+ * @param[out] pf Pointer to field from hash or NULL
+ *
+ * @returns IB_OK if successful; IB_ENOENT if not found
+ */
+typedef ib_status_t (* ib_expand_template_lookup_fn_t)(const void *data,
+                                                       int id,
+                                                       const char *name,
+                                                       size_t nlen,
+                                                       ib_field_t **pf);
+
+/**
+ * Compile @a str into an expansion template.
+ *
+ * Names are found as by ib_expand_str_gen_ex() without @a recurse.
+ *
+ * @param[in] mp Memory pool; @a str is copied into it
+ * @param[in] str String to compile
+ * @param[in] str_len Length of @a str
+ * @param[in] prefix Prefix string (e.g. "%{")
+ * @param[in] suffix Suffix string (e.g. "}")
+ * @param[in] resolve_fn Function to resolve each name to an ID, or NULL
+ * @param[out] tmpl Compiled template
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EINVAL if prefix or suffix is zero length.
+ *   - IB_EALLOC if a memory allocation failed.
+ */
+ib_status_t DLL_PUBLIC ib_expand_template_create(
+    ib_mpool_t              *mp,
+    const char              *str,
+    size_t                   str_len,
+    const char              *prefix,
+    const char              *suffix,
+    ib_expand_resolve_fn_t   resolve_fn,
+    ib_expand_template_t   **tmpl);
+
+/**
+ * Does @a tmpl have any names to expand?
+ *
+ * @param[in] tmpl Template
+ *
+ * @returns true if expanding @a tmpl may give something other than the
+ *          string it was compiled from.
+ */
+bool DLL_PUBLIC ib_expand_template_is_expandable(
+    const ib_expand_template_t *tmpl);
+
+/**
+ * Expand a compiled template.
+ *
+ * The result is the same as that of ib_expand_str_gen_ex() without
+ * @a recurse on the string the template was compiled from.  That includes
+ * expanding a name which a substituted value brings into the string: when
+ * the result has a prefix before its final literal text, the string is
+ * expanded by ib_expand_str_gen_ex() instead.
+ *
+ * @param[in] mp Memory pool for @a result
+ * @param[in] tmpl Template to expand
+ * @param[in] nul Append a NUL byte to the end of @a result?
+ * @param[in] lookup_fn Function to lookup a key in @a lookup_data
+ * @param[in] lookup_data Hash-like object in which to expand names
+ * @param[out] result Resulting string
+ * @param[out] result_len Length of @a result
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC if a memory allocation failed.
+ *   - Errors other than IB_ENOENT from @a lookup_fn.
+ */
+ib_status_t DLL_PUBLIC ib_expand_template_str(
+    ib_mpool_t                      *mp,
+    const ib_expand_template_t      *tmpl,
+    bool                             nul,
+    ib_expand_template_lookup_fn_t   lookup_fn,
+    const void                      *lookup_data,
+    char                           **result,
+    size_t                          *result_len);
 
 /** @} IronBeeUtilExpand */
 
@@ -935,6 +935,23 @@ int DLL_PUBLIC ib_field_is_dynamic(
      const ib_field_t *f
 );
 
+/**
+ * Get the generation of a field.
+ *
+ * The generation changes whenever the field's value is set, and whenever
+ * ib_field_mutable_value() hands out its value for modification.  It can
+ * be used to detect in-place changes to a field that keep the same value
+ * pointer.  Changes made through an alias of the field's storage, or to
+ * the members of a list value, do not change the generation.
+ *
+ * @param[in] f Field
+ *
+ * @returns Generation of @a f
+ */
+size_t DLL_PUBLIC ib_field_generation(
+    const ib_field_t *f
+);
+
 /**
  * Helper function for providing null terminated strings.
  *
@@ -157,6 +157,49 @@ uint32_t DLL_PUBLIC ib_hashfunc_djb2_nocase(
     uint32_t    randomizer
 );
 
+/**
+ * Seeded hash function that hashes 8 bytes at a time.
+ *
+ * This is the default hash function for ib_hash_create_open().  It is
+ * considerably faster than ib_hashfunc_djb2() for keys longer than a few
+ * bytes and mixes all bits of the key into all bits of the result, which
+ * the open addressing layout relies on.
+ *
+ * @sa ib_hashfunc_fast_nocase().
+ *
+ * @param[in] key        The key to hash.
+ * @param[in] key_length Length of @a key.
+ * @param[in] randomizer Value to randomize hash function.
+ *
+ * @returns Hash value of @a key.
+ */
+uint32_t DLL_PUBLIC ib_hashfunc_fast(
+    const void *key,
+    size_t      key_length,
+    uint32_t    randomizer
+);
+
+/**
+ * Seeded hash function that hashes 8 bytes at a time.  Case insensitive
+ * version.
+ *
+ * This is the default hash function for ib_hash_create_open_nocase().
+ * As with ib_hashequal_nocase(), only ASCII letters are downcased.
+ *
+ * @sa ib_hashfunc_fast().
+ *
+ * @param[in] key        The key to hash.
+ * @param[in] key_length Length of @a key.
+ * @param[in] randomizer Value to randomize hash function.
+ *
+ * @returns Hash value of @a key.
+ */
+uint32_t DLL_PUBLIC ib_hashfunc_fast_nocase(
+    const void *key,
+    size_t      key_length,
+    uint32_t    randomizer
+);
+
 /**
  * Byte for byte equality predicate.
  *
@@ -210,10 +253,71 @@ int DLL_PUBLIC ib_hashequal_nocase(
  */
 /*@{*/
 
+/**
+ * Hash table layouts.
+ *
+ * Both layouts provide the same behavior through the same functions; they
+ * differ only in performance.
+ *
+ * @sa ib_hash_create_layout()
+ */
+typedef enum {
+    /**
+     * Slots of linked lists of entries.
+     *
+     * Every entry is a separate allocation.  This is the layout of
+     * ib_hash_create_ex(), ib_hash_create() and ib_hash_create_nocase().
+     */
+    IB_HASH_LAYOUT_CHAINED,
+
+    /**
+     * Open addressing.
+     *
+     * Entries are stored in a single array with a parallel array of control
+     * bytes holding 7 bits of each hash value.  Lookups compare the control
+     * bytes of a group of 16 slots at once (with SSE2 where available),
+     * and only compare keys of slots whose control byte matches.  Lookups
+     * and inserts do not allocate and touch few cache lines, at the cost of
+     * needing a hash function whose low bits are well mixed, such as
+     * ib_hashfunc_fast().
+     */
+    IB_HASH_LAYOUT_OPEN
+} ib_hash_layout_t;
+
+/**
+ * Create a hash table with the given layout.
+ *
+ * @sa ib_hash_create_ex()
+ *
+ * @param[out] hash            The newly created hash table.
+ * @param[in]  pool            Memory pool to use.
+ * @param[in]  layout          Layout of the table.
+ * @param[in]  size            The initial number of slots in the hash
+ *                             table.  Must be a power of 2.
+ * @param[in]  hash_function   Hash function to use, e.g., ib_hashfunc_fast().
+ * @param[in]  equal_predicate Predicate to use for key equality.
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure.
+ * - IB_EINVAL if @a size is not a power of 2, or pointers are NULL.
+ */
+ib_status_t DLL_PUBLIC ib_hash_create_layout(
+    ib_hash_t          **hash,
+    ib_mpool_t          *pool,
+    ib_hash_layout_t     layout,
+    size_t               size,
+    ib_hash_function_t   hash_function,
+    ib_hash_equal_t      equal_predicate
+);
+
 /**
  * Create a hash table.
  *
+ * The table has the IB_HASH_LAYOUT_CHAINED layout.
+ *
  * @sa ib_hash_create()
+ * @sa ib_hash_create_layout()
  *
  * @param[out] hash            The newly created hash table.
  * @param[in]  pool            Memory pool to use.
@@ -271,6 +375,42 @@ ib_status_t DLL_PUBLIC ib_hash_create_nocase(
     ib_mpool_t  *pool
 );
 
+/**
+ * Create a hash table with the IB_HASH_LAYOUT_OPEN layout,
+ * ib_hashfunc_fast(), ib_hashequal_default(), and a default size.
+ *
+ * @sa ib_hash_create_layout()
+ *
+ * @param[out] hash The newly created hash table.
+ * @param[in]  pool Memory pool to use.
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_hash_create_open(
+    ib_hash_t  **hash,
+    ib_mpool_t  *pool
+);
+
+/**
+ * Create a hash table with the IB_HASH_LAYOUT_OPEN layout,
+ * ib_hashfunc_fast_nocase(), ib_hashequal_nocase(), and a default size.
+ *
+ * @sa ib_hash_create_layout()
+ *
+ * @param[out] hash The newly created hash table.
+ * @param[in]  pool Memory pool to use.
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_hash_create_open_nocase(
+    ib_hash_t  **hash,
+    ib_mpool_t  *pool
+);
+
 /*@}*/
 
 /**
@@ -29,6 +29,7 @@
 #include <ironbee/build.h>
 #include <ironbee/types.h>
 
+#include <stdbool.h>
 #include <string.h>
 
 #ifdef __cplusplus
@@ -75,6 +76,24 @@ extern "C" {
  * not optimal.  This trade-off can be somewhat tuned by setting the pagesize
  * for a memory pool.  Largely page sizes will mean higher runtime performance
  * and higher memory wastage.  The minimum pagesize is currently 1024.
+ * Allocations over 1024 bytes are passed to malloc(); pools with larger
+ * pages can raise this limit, see ib_mpool_policy_t.
+ *
+ * @section thread_cache Thread Cache
+ *
+ * Each thread keeps a bounded cache of free pages and pool structures.
+ * When a pool is destroyed or released, its pages are handed to the cache
+ * of the calling thread, and pools take pages from the cache of the thread
+ * allocating from them before calling malloc().  Destroyed pools are kept
+ * in the cache for reuse by ib_mpool_create().  This lets a short lived
+ * pool, such as a transaction's, reuse the memory of the last one without
+ * going through malloc() and free().  Only pools using malloc() and free()
+ * take part, and only pages of the default page size are cached.
+ *
+ * As a cache belongs to a single thread, using it needs no locking.  The
+ * cache is freed when its thread exits; ib_mpool_cache_flush() frees it
+ * earlier, and ib_mpool_cache_shutdown() frees those of all threads at
+ * shutdown.  See ib_mpool_cache_stats() for its counters.
  *
  * @section Valgrind
  *
@@ -176,6 +195,74 @@ ib_status_t DLL_PUBLIC ib_mpool_create_ex(
     ib_mpool_free_fn_t     free_fn
 );
 
+/**
+ * Memory pool policy.
+ *
+ * A policy tunes a pool for its role, e.g., a pool per transaction with
+ * many allocations of a few kilobytes.  Children created with
+ * ib_mpool_create() or ib_mpool_create_ex() inherit the page size, large
+ * allocation threshold, huge page backing, and role of their parent.
+ *
+ * @sa ib_mpool_create_policy()
+ */
+typedef struct ib_mpool_policy_t ib_mpool_policy_t;
+struct ib_mpool_policy_t {
+    /**
+     * Role of pool, e.g., "tx".
+     *
+     * Pools are aggregated by role in ib_mpool_analyze().  Not copied; must
+     * outlive the pool.  NULL means copy from parent.
+     */
+    const char *role;
+
+    /**
+     * Page size; 0 means copy from parent or use default.
+     *
+     * @sa ib_mpool_create_ex()
+     */
+    size_t pagesize;
+
+    /**
+     * Allocations larger than this are passed to malloc().
+     *
+     * Smaller allocations are taken from pages.  0 means the default of
+     * 1024.  It is at most the page size.
+     */
+    size_t large_threshold;
+
+    /**
+     * Back pages with huge pages.
+     *
+     * Pages are aligned to huge pages and transparent huge pages are
+     * requested, if the system supports it.  Only used with default
+     * malloc() and free() and pages of at least 2 MiB.
+     */
+    bool huge_pages;
+};
+
+/**
+ * Create a new memory pool with a policy.
+ *
+ * The pool uses the malloc and free functions of @a parent or the defaults.
+ *
+ * @param[out] pmp    Address which new pool is written
+ * @param[in]  name   Logical name of the pool (used in reports), can be NULL.
+ * @param[in]  parent Optional parent memory pool (or NULL)
+ * @param[in]  policy Policy of the pool.
+ *
+ * @returns
+ * - IB_OK     -- Success.
+ * - IB_EINVAL -- @a pmp or @a policy is NULL.
+ * - IB_EALLOC -- Allocation error.
+ * - Other     -- Locking failure, see ib_lock_lock().
+ */
+ib_status_t DLL_PUBLIC ib_mpool_create_policy(
+    ib_mpool_t              **pmp,
+    const char               *name,
+    ib_mpool_t               *parent,
+    const ib_mpool_policy_t  *policy
+);
+
 /**
  * Set the name of a memory pool.
  *
@@ -443,11 +530,59 @@ char DLL_PUBLIC *ib_mpool_debug_report(const ib_mpool_t *mp);
  * - Cleanups         -- Overhead for cleanup functions.
  * - Total            -- Aggregate of all of the above.
  *
+ * The report ends with the totals of @a mp and its descendants by role (see
+ * ib_mpool_policy_t), with fragmentation being waste / cost.
+ *
  * @param[in] mp Memory pool to analyze.
  * @returns Usage report.
  */
 char DLL_PUBLIC *ib_mpool_analyze(const ib_mpool_t *mp);
 
+/**
+ * Thread cache counters.
+ *
+ * @sa ib_mpool_cache_stats()
+ */
+typedef struct ib_mpool_cache_stats_t ib_mpool_cache_stats_t;
+struct ib_mpool_cache_stats_t {
+    size_t page_hits;        /**< Pages taken from the cache */
+    size_t page_misses;      /**< Pages allocated as the cache was empty */
+    size_t pages;            /**< Pages currently in the cache */
+    size_t pages_high_water; /**< Most pages ever in the cache */
+    size_t pool_hits;        /**< Pools taken from the cache */
+    size_t pool_misses;      /**< Pools allocated as the cache was empty */
+    size_t pools;            /**< Pools currently in the cache */
+    size_t pools_high_water; /**< Most pools ever in the cache */
+};
+
+/**
+ * Get the counters of the calling thread's cache.
+ *
+ * Counters are per-thread and are all zero for a thread that has not used
+ * a memory pool.
+ *
+ * @param[out] stats Counters.
+ */
+void DLL_PUBLIC ib_mpool_cache_stats(
+    ib_mpool_cache_stats_t *stats
+);
+
+/**
+ * Free the pages and pools in the calling thread's cache.
+ *
+ * Counters other than the current number of pages and pools are kept.
+ */
+void DLL_PUBLIC ib_mpool_cache_flush(void);
+
+/**
+ * Free the caches of all threads and delete the key of the thread caches.
+ *
+ * ib_util_shutdown() will call this.  Other threads must not use or destroy
+ * memory pools, or exit, while it runs.  Memory pools used afterwards
+ * create the key again.
+ */
+void DLL_PUBLIC ib_mpool_cache_shutdown(void);
+
 /** @} IronBeeUtilMemPool */
 
 #ifdef __cplusplus
@@ -0,0 +1,274 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+#ifndef _IB_PCRE_CACHE_H_
+#define _IB_PCRE_CACHE_H_
+
+#include <ironbee/engine_types.h>
+#include <ironbee/mpool.h>
+#include <ironbee/types.h>
+
+#include <pcre.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file
+ * @brief IronBee --- Shared PCRE Pattern Cache
+ */
+
+/**
+ * @defgroup IronBeeEnginePcreCache PCRE Pattern Cache
+ * @ingroup IronBeeEngine
+ *
+ * Compiled PCRE patterns shared by all regular expression users.
+ *
+ * Patterns are compiled, studied and (if enabled and available) JIT
+ * compiled once per pattern and compile parameters.  JIT compiled
+ * patterns run on a per-thread JIT stack, so shared patterns may be
+ * executed concurrently without any per-call stack allocation.
+ *
+ * @{
+ */
+
+/**
+ * PCRE pattern cache.
+ */
+typedef struct ib_pcre_cache_t ib_pcre_cache_t;
+
+/**
+ * Compile parameters.  All of the parameters are part of the cache key.
+ */
+typedef struct ib_pcre_params_t {
+    int            options;               /**< pcre_compile() options */
+    bool           study;                 /**< Study the pattern? */
+    bool           jit;                   /**< JIT compile, if enabled? */
+    unsigned long  match_limit;           /**< Match limit; 0: PCRE default */
+    unsigned long  match_limit_recursion; /**< Recursion limit; 0: default */
+    int            jit_stack_start;       /**< JIT stack start; 0: default */
+    int            jit_stack_max;         /**< JIT stack max; 0: default */
+} ib_pcre_params_t;
+
+/**
+ * Compiled pattern.
+ *
+ * Cached patterns are shared and must not be modified.
+ */
+typedef struct ib_pcre_t {
+    const char    *pattern;               /**< Pattern text */
+    pcre          *code;                  /**< Compiled pattern */
+    pcre_extra    *extra;                 /**< Study data & limits, or NULL */
+    size_t         code_size;             /**< Size of @c code */
+    size_t         study_size;            /**< Size of the study data */
+    bool           is_jit;                /**< Is the pattern JIT compiled? */
+} ib_pcre_t;
+
+/**
+ * Pattern cache statistics.
+ */
+typedef struct ib_pcre_stats_t {
+    uint64_t       lookups;               /**< Number of cache lookups */
+    uint64_t       hits;                  /**< Number of cache hits */
+    uint64_t       failures;              /**< Number of failed compiles */
+    uint64_t       compile_usec;          /**< Total compile time (usec) */
+    uint64_t       declined;              /**< Misses after closing */
+    size_t         patterns;              /**< Number of cached patterns */
+    size_t         jit_patterns;          /**< Number of JIT patterns */
+} ib_pcre_stats_t;
+
+/**
+ * Create a pattern cache.
+ *
+ * The cache, and the patterns in it, are destroyed with @a mp.
+ *
+ * @param[in] mp Memory pool
+ * @param[out] cache New pattern cache
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure.
+ * - IB_EUNKNOWN if the cache's lock cannot be created.
+ */
+ib_status_t DLL_PUBLIC ib_pcre_cache_create(
+    ib_mpool_t       *mp,
+    ib_pcre_cache_t **cache
+);
+
+/**
+ * Get the pattern cache of an engine.
+ *
+ * @param[in] ib IronBee engine
+ *
+ * @returns The engine's pattern cache
+ */
+ib_pcre_cache_t DLL_PUBLIC *ib_engine_pcre_cache(const ib_engine_t *ib);
+
+/**
+ * Enable or disable JIT compilation of patterns added to @a cache.
+ *
+ * JIT compilation is enabled by default, if PCRE supports it.  Patterns
+ * already in the cache are not affected.
+ *
+ * @param[in] cache Pattern cache
+ * @param[in] enable Enable JIT compilation?
+ */
+void DLL_PUBLIC ib_pcre_cache_jit_set(
+    ib_pcre_cache_t *cache,
+    bool             enable
+);
+
+/**
+ * Is JIT compilation enabled for @a cache?
+ *
+ * @param[in] cache Pattern cache
+ *
+ * @returns true if JIT is enabled and supported by PCRE.
+ */
+bool DLL_PUBLIC ib_pcre_cache_jit_enabled(
+    const ib_pcre_cache_t *cache
+);
+
+/**
+ * Close @a cache to new patterns.
+ *
+ * Patterns are never removed from a cache, and live as long as its memory
+ * pool.  The engine closes its cache when configuration is finished, so
+ * that patterns seen at runtime can not grow it without bound; they must
+ * be compiled with ib_pcre_compile() into a pool of the caller's instead.
+ *
+ * @param[in] cache Pattern cache
+ */
+void DLL_PUBLIC ib_pcre_cache_close(
+    ib_pcre_cache_t *cache
+);
+
+/**
+ * Get a compiled pattern from @a cache, compiling it if needed.
+ *
+ * Lookups and additions are serialized by a lock of the cache, so this is
+ * meant for configuration time.  Once the cache is closed (see
+ * ib_pcre_cache_close()), patterns already in it are still found, but
+ * others are not compiled.
+ *
+ * @param[in] cache Pattern cache
+ * @param[in] pattern NUL terminated pattern
+ * @param[in] params Compile parameters
+ * @param[out] cpatt Compiled pattern
+ * @param[out] errptr PCRE error message on compile failure (may be NULL)
+ * @param[out] erroffset Error offset on compile failure (may be NULL)
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a pattern fails to compile.
+ * - IB_EALLOC on allocation failure.
+ * - IB_DECLINED if @a pattern is not cached and @a cache is closed.
+ */
+ib_status_t DLL_PUBLIC ib_pcre_cache_compile(
+    ib_pcre_cache_t         *cache,
+    const char              *pattern,
+    const ib_pcre_params_t  *params,
+    const ib_pcre_t        **cpatt,
+    const char             **errptr,
+    int                     *erroffset
+);
+
+/**
+ * Free the JIT stacks of all threads and delete the key of the per-thread
+ * JIT stacks.
+ *
+ * ib_shutdown() will call this.  Other threads must not match patterns, or
+ * exit, while it runs.  JIT patterns compiled afterwards create the key
+ * again.
+ */
+void DLL_PUBLIC ib_pcre_cache_shutdown(void);
+
+/**
+ * Compile a pattern without caching it.
+ *
+ * The pattern is destroyed with @a mp.  It is JIT compiled only if both
+ * @a jit and @a params ask for it; pass ib_pcre_cache_jit_enabled() of the
+ * engine's cache as @a jit so that the RegexJit setting is honored.
+ *
+ * @param[in] mp Memory pool
+ * @param[in] jit Is JIT compilation enabled?
+ * @param[in] pattern NUL terminated pattern
+ * @param[in] params Compile parameters
+ * @param[out] cpatt Compiled pattern
+ * @param[out] errptr PCRE error message on compile failure (may be NULL)
+ * @param[out] erroffset Error offset on compile failure (may be NULL)
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a pattern fails to compile.
+ * - IB_EALLOC on allocation failure.
+ */
+ib_status_t DLL_PUBLIC ib_pcre_compile(
+    ib_mpool_t              *mp,
+    bool                     jit,
+    const char              *pattern,
+    const ib_pcre_params_t  *params,
+    const ib_pcre_t        **cpatt,
+    const char             **errptr,
+    int                     *erroffset
+);
+
+/**
+ * Execute a compiled pattern with pcre_exec().
+ *
+ * @param[in] cpatt Compiled pattern
+ * @param[in] subject Subject string
+ * @param[in] subject_len Length of @a subject
+ * @param[in] options pcre_exec() options
+ * @param[out] ovector Match vector (may be NULL if @a ovecsize is 0)
+ * @param[in] ovecsize Size of @a ovector
+ *
+ * @returns The pcre_exec() return value.
+ */
+int DLL_PUBLIC ib_pcre_exec(
+    const ib_pcre_t *cpatt,
+    const char      *subject,
+    size_t           subject_len,
+    int              options,
+    int             *ovector,
+    int              ovecsize
+);
+
+/**
+ * Get statistics of @a cache.
+ *
+ * @param[in] cache Pattern cache
+ * @param[out] stats Statistics
+ */
+void DLL_PUBLIC ib_pcre_cache_stats(
+    ib_pcre_cache_t *cache,
+    ib_pcre_stats_t *stats
+);
+
+/**
+ * @} IronBeeEnginePcreCache
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_PCRE_CACHE_H_ */
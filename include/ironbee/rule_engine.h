@@ -28,6 +28,7 @@
 #include <ironbee/action.h>
 #include <ironbee/build.h>
 #include <ironbee/config.h>
+#include <ironbee/expand.h>
 #include <ironbee/operator.h>
 #include <ironbee/rule_defs.h>
 #include <ironbee/types.h>
@@ -56,6 +57,10 @@ typedef struct {
     const char            *chain_id;        /**< Rule's chain ID */
     const char            *msg;             /**< Rule message */
     const char            *data;            /**< Rule logdata */
+    /** Compiled @c msg if IB_RULEMD_FLAG_EXPAND_MSG is set, or NULL */
+    const ib_expand_template_t *msg_template;
+    /** Compiled @c data if IB_RULEMD_FLAG_EXPAND_DATA is set, or NULL */
+    const ib_expand_template_t *data_template;
     ib_list_t             *tags;            /**< Rule tags */
     ib_rule_phase_num_t    phase;           /**< Phase number */
     uint8_t                severity;        /**< Rule severity */
@@ -118,10 +123,20 @@ struct ib_rule_exec_t {
     ib_list_t              *rule_stack;  /**< Stack of rules */
 
     /* List of all rules to run during the current phase. */
-    ib_list_t              *phase_rules; /**< List of ib_rule_t */
+    ib_list_t              *phase_rules; /**< Injected rules (ib_rule_t) */
 
     /* Stack of values for the FIELD* targets */
     ib_list_t              *value_stack; /**< Stack of values */
+
+    /* Transformation results, keyed by source field & tfn prefix */
+    ib_hash_t              *tfn_cache;   /**< Transformation result cache */
+
+    /* Prefilter results, keyed by prefilter & value */
+    ib_hash_t              *prefilter_cache; /**< Prefilter result cache */
+
+    /* Bodies collected for phase rules, with their transformed views */
+    struct ib_rule_body_view_t *request_body;  /**< Request body or NULL */
+    struct ib_rule_body_view_t *response_body; /**< Response body or NULL */
 };
 
 /**
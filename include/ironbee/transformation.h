@@ -61,6 +61,26 @@ typedef ib_status_t (*ib_tfn_fn_t)(ib_engine_t *ib,
                                    ib_field_t **data_out,
                                    ib_flags_t *pflags);
 
+/**
+ * Transformation holdback function.
+ *
+ * A transformation which can be applied to data a chunk at a time
+ * provides a holdback function.  Given the data seen so far, it returns
+ * the number of trailing bytes whose transformation depends on data which
+ * has not arrived yet.  Transforming the rest of the data now, and the
+ * held back bytes along with the next chunk, gives the same result as
+ * transforming all of the data at once.
+ *
+ * @param[in] data Data
+ * @param[in] dlen Length of @a data
+ * @param[in] fndata Transformation function data (config)
+ *
+ * @returns Number of bytes to hold back
+ */
+typedef size_t (*ib_tfn_holdback_fn_t)(const uint8_t *data,
+                                       size_t dlen,
+                                       void *fndata);
+
 /** @cond Internal */
 
 /* Transformation flags */
@@ -73,6 +93,7 @@ typedef ib_status_t (*ib_tfn_fn_t)(ib_engine_t *ib,
 struct ib_tfn_t {
     const char         *name;              /**< Tfn name */
     ib_tfn_fn_t         fn_execute;        /**< Tfn execute function */
+    ib_tfn_holdback_fn_t fn_holdback;      /**< Holdback or NULL */
     ib_flags_t          tfn_flags;         /**< Tfn flags */
     void               *fndata;            /**< Tfn function data */
 };
@@ -109,6 +130,26 @@ ib_status_t DLL_PUBLIC ib_tfn_register(ib_engine_t *ib,
                                        ib_flags_t flags,
                                        void *fndata);
 
+/**
+ * Create and register a new transformation (extended version).
+ *
+ * @param ib Engine handle
+ * @param name Transformation name
+ * @param fn_execute Transformation execute function
+ * @param fn_holdback Holdback function if the transformation can be
+ *                    applied to data a chunk at a time, otherwise NULL
+ * @param flags Transformation flags
+ * @param fndata Transformation function data
+ *
+ * @returns Status code
+ */
+ib_status_t DLL_PUBLIC ib_tfn_register_ex(ib_engine_t *ib,
+                                          const char *name,
+                                          ib_tfn_fn_t fn_execute,
+                                          ib_tfn_holdback_fn_t fn_holdback,
+                                          ib_flags_t flags,
+                                          void *fndata);
+
 /**
  * Lookup a transformation by name (extended version).
  *
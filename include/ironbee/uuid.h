@@ -65,7 +65,9 @@ ib_status_t DLL_PUBLIC ib_uuid_initialize(void);
 /**
  * Shutdown UUID library.
  *
- * ib_util_shutdown() will call this.
+ * ib_util_shutdown() will call this.  It also frees the UUID generators of
+ * all threads and deletes the key of the per-thread generators, so other
+ * threads must not make UUIDs, or exit, while it runs.
  */
 ib_status_t DLL_PUBLIC ib_uuid_shutdown(void);
 
@@ -105,6 +107,43 @@ ib_status_t DLL_PUBLIC ib_uuid_bin_to_ascii(
  */
 ib_status_t DLL_PUBLIC ib_uuid_create_v4(ib_uuid_t *uuid);
 
+/**
+ * Creates a new, random, v4 uuid without taking a lock.
+ *
+ * Each thread has its own generator, seeded from @c /dev/urandom the first
+ * time the thread makes a UUID and again in a child after @c fork().  The
+ * generator is fast but not cryptographically strong: use this for
+ * identifiers that must be unique, not for secrets.
+ *
+ * @param uuid Pointer to allocated ib_uuid_t to store result in.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EINVAL if @a uuid is NULL.
+ *   - IB_EALLOC if the thread's generator could not be created.
+ */
+ib_status_t DLL_PUBLIC ib_uuid_create_v4_fast(ib_uuid_t *uuid);
+
+/**
+ * Creates a new uuid that sorts by creation time, without taking a lock.
+ *
+ * The uuid has the layout of a version 7 uuid: the first 48 bits are the
+ * time in milliseconds since the epoch, followed by a 44 bit per-thread
+ * counter and a 30 bit per-thread tag.  Both the tag and the counter's
+ * start are random, so two threads or processes only make the same UUID if
+ * they draw the same tag and their counters meet in the same millisecond.
+ * UUIDs made in different milliseconds sort (as bytes or strings) in the
+ * order they were made.
+ *
+ * @param uuid Pointer to allocated ib_uuid_t to store result in.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EINVAL if @a uuid is NULL.
+ *   - IB_EALLOC if the thread's generator could not be created.
+ */
+ib_status_t DLL_PUBLIC ib_uuid_create_sortable(ib_uuid_t *uuid);
+
 /** @} IronBeeUtilUUID */
 
 
@@ -65,6 +65,13 @@
 #define AC_MINOR           1
 #define AC_DATE            20110812
 
+/**
+ * Largest dense transition table to build for a pm or pmf pattern set.
+ *
+ * Larger pattern sets are matched with the trie.  See ib_ac_build_dfa().
+ */
+#define AC_DFA_MAX_SIZE    (16 * 1024 * 1024)
+
 typedef struct modac_cfg_t modac_cfg_t;
 typedef struct modac_cpatt_t modac_cpatt_t;
 
@@ -81,6 +88,26 @@ struct modac_provider_data_t {
 /* Instantiate a module global configuration. */
 typedef struct modac_provider_data_t modac_provider_data_t;
 
+/**
+ * Module configuration.
+ *
+ * Only the copy in the main context is used; the module is context
+ * independent.
+ */
+struct modac_cfg_t {
+    /**
+     * Compiled pm and pmf pattern sets (ib_ac_t *) by key.
+     *
+     * Each pattern set is compiled once, into the engine main memory pool,
+     * and shared by every rule of every context that uses it.  Keys are
+     * built by modac_dictionary_key() and modac_file_dictionary_key().
+     */
+    ib_hash_t *dictionaries;
+};
+
+/** Global configuration; copied into the main context. */
+static modac_cfg_t modac_global_cfg = { NULL };
+
 /**
  * Workspace data stored per rule per transaction in tx.
  *
@@ -511,6 +538,216 @@ static ib_status_t readfile(const ib_engine_t *ib,
     return IB_OK;
 }
 
+/**
+ * Get the compiled pattern set cache, creating it if needed.
+ *
+ * @param[in] ib IronBee engine.
+ * @param[out] dictionaries The cache.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - Other on failure.
+ */
+static ib_status_t modac_dictionaries(ib_engine_t *ib,
+                                      ib_hash_t **dictionaries)
+{
+    assert(ib != NULL);
+    assert(dictionaries != NULL);
+
+    ib_status_t rc;
+    modac_cfg_t *cfg;
+
+    rc = ib_context_module_config(ib_context_main(ib),
+                                  IB_MODULE_STRUCT_PTR,
+                                  (void *)&cfg);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    if (cfg->dictionaries == NULL) {
+        rc = ib_hash_create(&cfg->dictionaries, ib_engine_pool_main_get(ib));
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    *dictionaries = cfg->dictionaries;
+    return IB_OK;
+}
+
+/**
+ * Build the cache key of an inline (pm) pattern set.
+ *
+ * @param[in] mp Memory pool to allocate the key from.
+ * @param[in] flags AC flags the patterns are compiled with.
+ * @param[in] patterns The operator argument.
+ *
+ * @returns The key, or NULL on allocation failure.
+ */
+static const char *modac_dictionary_key(ib_mpool_t *mp,
+                                        uint8_t flags,
+                                        const char *patterns)
+{
+    size_t len = strlen(patterns) + 16;
+    char *key = (char *)ib_mpool_alloc(mp, len);
+
+    if (key != NULL) {
+        snprintf(key, len, "pm:%u:%s", flags, patterns);
+    }
+    return key;
+}
+
+/**
+ * Find a pattern file and build the cache key of its pattern set.
+ *
+ * The file is found as readfile() finds it.  The key is made of the
+ * flags, modification time, size and canonical path of the file, so that
+ * different names of the same file share a pattern set but a file that
+ * changed between configurations does not.
+ *
+ * @param[in] ib IronBee engine.
+ * @param[in] ctx Configuration context; may be NULL.
+ * @param[in] mp Memory pool to allocate from.
+ * @param[in] flags AC flags the patterns are compiled with.
+ * @param[in] filename Name of the pattern file.
+ * @param[out] path Canonical path of the file.
+ * @param[out] key The key.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_ENOENT if the file does not exist.
+ *   - IB_EALLOC on allocation failure.
+ */
+static ib_status_t modac_file_dictionary_key(const ib_engine_t *ib,
+                                             const ib_context_t *ctx,
+                                             ib_mpool_t *mp,
+                                             uint8_t flags,
+                                             const char *filename,
+                                             const char **path,
+                                             const char **key)
+{
+    struct stat file_stat;
+    char *real;
+    char *buf;
+    size_t len;
+
+    if (stat(filename, &file_stat) != 0) {
+        const char *cwd = (ctx == NULL) ? NULL : ib_context_config_cwd(ctx);
+        if (cwd == NULL) {
+            ib_log_error(ib, "Failed to find pattern file \"%s\": %s",
+                         filename, strerror(errno));
+            return IB_ENOENT;
+        }
+        filename = ib_util_path_join(mp, cwd, filename);
+        if (filename == NULL) {
+            return IB_EALLOC;
+        }
+        if (stat(filename, &file_stat) != 0) {
+            ib_log_error(ib, "Failed to find pattern file \"%s\": %s",
+                         filename, strerror(errno));
+            return IB_ENOENT;
+        }
+    }
+
+    real = realpath(filename, NULL);
+    if (real == NULL) {
+        ib_log_error(ib, "Failed to resolve pattern file \"%s\": %s",
+                     filename, strerror(errno));
+        return IB_ENOENT;
+    }
+    *path = ib_mpool_strdup(mp, real);
+    free(real);
+    if (*path == NULL) {
+        return IB_EALLOC;
+    }
+
+    len = strlen(*path) + 64;
+    buf = (char *)ib_mpool_alloc(mp, len);
+    if (buf == NULL) {
+        return IB_EALLOC;
+    }
+    snprintf(buf, len, "pmf:%u:%jd:%jd:%s",
+             flags,
+             (intmax_t)file_stat.st_mtime,
+             (intmax_t)file_stat.st_size,
+             *path);
+    *key = buf;
+
+    return IB_OK;
+}
+
+/**
+ * Look up a compiled pattern set.
+ *
+ * @param[in] ib IronBee engine.
+ * @param[in] key Key of the pattern set.
+ * @param[out] ac The compiled pattern set.
+ *
+ * @returns
+ *   - IB_OK if found.
+ *   - IB_ENOENT if not yet compiled.
+ *   - Other on failure.
+ */
+static ib_status_t modac_dictionary_get(ib_engine_t *ib,
+                                        const char *key,
+                                        ib_ac_t **ac)
+{
+    ib_status_t rc;
+    ib_hash_t *dictionaries;
+
+    rc = modac_dictionaries(ib, &dictionaries);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    rc = ib_hash_get(dictionaries, ac, key);
+    if (rc == IB_OK) {
+        ib_log_debug(ib, "Sharing compiled AC patterns %s", key);
+    }
+    return rc;
+}
+
+/**
+ * Finish compiling a pattern set and add it to the cache.
+ *
+ * @param[in] ib IronBee engine.
+ * @param[in] key Key of the pattern set.
+ * @param[in] ac The pattern set; patterns have been added.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - Other on failure.
+ */
+static ib_status_t modac_dictionary_add(ib_engine_t *ib,
+                                        const char *key,
+                                        ib_ac_t *ac)
+{
+    ib_status_t rc;
+    ib_hash_t *dictionaries;
+
+    rc = ib_ac_build_links(ac);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    rc = ib_ac_build_dfa(ac, AC_DFA_MAX_SIZE);
+    if ( (rc != IB_OK) && (rc != IB_DECLINED) ) {
+        return rc;
+    }
+
+    rc = modac_dictionaries(ib, &dictionaries);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    key = ib_mpool_strdup(ib_engine_pool_main_get(ib), key);
+    if (key == NULL) {
+        return IB_EALLOC;
+    }
+
+    return ib_hash_set(dictionaries, key, ac);
+}
+
 static ib_status_t pmf_operator_create(ib_engine_t *ib,
                                        ib_context_t *ctx,
                                        const ib_rule_t *rule,
@@ -525,6 +762,8 @@ static ib_status_t pmf_operator_create(ib_engine_t *ib,
     char* file = NULL;
     char* line = NULL;
     size_t pattern_file_len = strlen(pattern_file);
+    const char *path;
+    const char *key;
 
     /* Escaped directive and length. */
     char *pattern_file_unescaped;
@@ -551,11 +790,27 @@ static ib_status_t pmf_operator_create(ib_engine_t *ib,
         return rc;
     }
 
-    /* Populate file. This data must be free'ed. */
-    rc = readfile(ib, ctx, pool, pattern_file_unescaped, &file);
+    rc = modac_file_dictionary_key(ib, ctx, pool, 0, pattern_file_unescaped,
+                                   &path, &key);
 
     free(pattern_file_unescaped);
 
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    rc = modac_dictionary_get(ib, key, &ac);
+    if (rc == IB_OK) {
+        op_inst->data = ac;
+        return IB_OK;
+    }
+    else if (rc != IB_ENOENT) {
+        return rc;
+    }
+
+    /* Populate file. This data must be free'ed. */
+    rc = readfile(ib, ctx, pool, path, &file);
+
     if (rc != IB_OK) {
         if (file != NULL) {
             free(file);
@@ -564,7 +819,7 @@ static ib_status_t pmf_operator_create(ib_engine_t *ib,
         return rc;
     }
 
-    rc = ib_ac_create(&ac, 0, pool);
+    rc = ib_ac_create(&ac, 0, ib_engine_pool_main_get(ib));
 
     if (rc != IB_OK) {
         free(file);
@@ -605,16 +860,15 @@ static ib_status_t pmf_operator_create(ib_engine_t *ib,
         }
     }
 
-    rc = ib_ac_build_links(ac);
+    free(file);
 
+    rc = modac_dictionary_add(ib, key, ac);
     if (rc != IB_OK) {
-        free(file);
         return rc;
     }
 
     op_inst->data = ac;
 
-    free(file);
     return IB_OK;
 }
 
@@ -631,9 +885,25 @@ static ib_status_t pm_operator_create(ib_engine_t *ib,
 
     const size_t pattern_len = strlen(pattern);
     size_t tok_buffer_sz = pattern_len+1;
-    char* tok_buffer = malloc(tok_buffer_sz);
+    char* tok_buffer;
     char* tok;
+    const char *key;
 
+    key = modac_dictionary_key(pool, 0, pattern);
+    if (key == NULL) {
+        return IB_EALLOC;
+    }
+
+    rc = modac_dictionary_get(ib, key, &ac);
+    if (rc == IB_OK) {
+        op_inst->data = ac;
+        return IB_OK;
+    }
+    else if (rc != IB_ENOENT) {
+        return rc;
+    }
+
+    tok_buffer = malloc(tok_buffer_sz);
     if (tok_buffer == NULL ) {
         return IB_EALLOC;
     }
@@ -647,7 +917,7 @@ static ib_status_t pm_operator_create(ib_engine_t *ib,
 
     memcpy(tok_buffer, pattern, tok_buffer_sz);
 
-    rc = ib_ac_create(&ac, 0, pool);
+    rc = ib_ac_create(&ac, 0, ib_engine_pool_main_get(ib));
 
     if (rc != IB_OK) {
         free(tok_buffer);
@@ -666,16 +936,15 @@ static ib_status_t pm_operator_create(ib_engine_t *ib,
         }
     }
 
-    rc = ib_ac_build_links(ac);
+    free(tok_buffer);
 
+    rc = modac_dictionary_add(ib, key, ac);
     if (rc != IB_OK) {
-        free(tok_buffer);
         return rc;
     }
 
     op_inst->data = ac;
 
-    free(tok_buffer);
     return IB_OK;
 }
 
@@ -879,7 +1148,7 @@ static ib_status_t modac_init(ib_engine_t *ib,
 IB_MODULE_INIT(
     IB_MODULE_HEADER_DEFAULTS,            /**< Default metadata */
     MODULE_NAME_STR,                      /**< Module name */
-    IB_MODULE_CONFIG_NULL,                /* Global config data */
+    IB_MODULE_CONFIG(&modac_global_cfg),  /**< Global config data */
     NULL,                                 /**< Configuration field map */
     NULL,                                 /**< Config directive map */
     modac_init,                           /**< Initialize function */
@@ -23,7 +23,7 @@
  *
  * Provides a single directive:
  * @code
- * FastAutomata <path>
+ * FastAutomata <path> [Map=On|Off] [Populate=On|Off]
  * @endcode
  *
  * @c FastAutomata is context independent and must occur at most once in
@@ -33,6 +33,12 @@
  * rules into a set of scripts which creates the automata (see
  * fast/fast.html).
  *
+ * By default, the automata is mapped read-only and shared between all
+ * processes which load it, rather than read into private memory (Map=Off).
+ * Populate=On prefaults the whole mapping at load time so that the first
+ * transactions do not take page faults.  A mapped automata must be replaced
+ * by renaming a new file over it, never by rewriting it in place.
+ *
  * In general, @c EOTHER is used to indicate IronBee related failures and
  * @c EINVAL is used to indicate IronAutomata related failures.
  *
@@ -50,6 +56,8 @@
 #include <ironbee/rule_engine.h>
 
 #include <assert.h>
+#include <string.h>
+#include <strings.h>
 
 /** Module name. */
 #define MODULE_NAME        fast
@@ -115,7 +123,12 @@ struct fast_search_t
     /** List to add eligible rules to. */
     ib_list_t *rule_list;
 
-    /** Rules already added by pointer.  No data. */
+    /**
+     * Rules already added by pointer.  No data.
+     *
+     * If NULL, rules are added to @c rule_list without checking; used for
+     * collection entries which are merged afterwards.
+     */
     ib_hash_t *rule_set;
 };
 
@@ -171,6 +184,23 @@ static const char *c_bytestring_separator = " ";
 /** String to separate different keys, bytestring or collection entries. */
 static const char *c_data_separator = "\n";
 
+/**
+ * Number of collection entries to execute together.
+ *
+ * Each entry is a separate stream of ia_eudoxus_execute_batch().
+ */
+#define FAST_BATCH_SIZE 32
+
+/* Documented in definition below. */
+static
+ia_eudoxus_command_t fast_eudoxus_callback(
+    ia_eudoxus_t  *eudoxus,
+    const char    *output,
+    size_t         output_length,
+    const uint8_t *input_location,
+    void          *callback_data
+);
+
 /* Helper functions */
 
 /**
@@ -229,6 +259,57 @@ fast_config_t *fast_get_config(
     return config;
 }
 
+/**
+ * Add @a rule to the rules to inject unless already added.
+ *
+ * @param[in] search Search state; @c rule_list and @c rule_set updated.
+ * @param[in] rule   Rule to add.
+ * @return
+ * - IB_OK on success.
+ * - Other on IronBee failure.
+ */
+static
+ib_status_t fast_add_rule(
+    fast_search_t   *search,
+    const ib_rule_t *rule
+)
+{
+    assert(search            != NULL);
+    assert(search->rule_list != NULL);
+    assert(rule              != NULL);
+
+    ib_status_t rc;
+
+    if (search->rule_set != NULL) {
+        void *dummy_value;
+        rc = ib_hash_get_ex(
+            search->rule_set,
+            &dummy_value,
+            &rule,
+            sizeof(rule)
+        );
+        if (rc == IB_OK) {
+            /* Rule already added. */
+            return IB_OK;
+        }
+        if (rc != IB_ENOENT) {
+            return rc;
+        }
+
+        rc = ib_hash_set_ex(
+            search->rule_set,
+            &rule,
+            sizeof(rule),
+            (void *)1
+        );
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
+    return ib_list_push(search->rule_list, (void *)rule);
+}
+
 /**
  * Feed data to the automata.
  *
@@ -351,9 +432,16 @@ ib_status_t fast_feed_data_bytestring(
 /**
  * Feed a collection of byte strings from an @ref ib_data_t to automata.
  *
+ * Each entry is fed to its own execution as
+ * data separator, name, collection separator, value, data separator.
+ * Entries are executed FAST_BATCH_SIZE at a time with
+ * ia_eudoxus_execute_batch() so that their automata accesses overlap.  Rules
+ * found are added to @a search in entry order, as if the entries had been
+ * executed one after the other.
+ *
  * @param[in] ib          IronBee engine; used for logging.
- * @param[in] eudoxus     Eudoxus engine; used for ia_eudoxus_error().
- * @param[in] state       Current Eudoxus execution state; updated.
+ * @param[in] search      Search state; rules found are added.
+ * @param[in] mp          Memory pool for temporary allocations.
  * @param[in] data        Data source.
  * @param[in] collection  Collection to feed.
  * @return
@@ -364,24 +452,32 @@ ib_status_t fast_feed_data_bytestring(
 static
 ib_status_t fast_feed_data_collection(
     const ib_engine_t             *ib,
-    const ia_eudoxus_t            *eudoxus,
-    ia_eudoxus_state_t            *state,
+    fast_search_t                 *search,
+    ib_mpool_t                    *mp,
     const ib_data_t               *data,
     const fast_collection_spec_t  *collection
 )
 {
-    assert(ib         != NULL);
-    assert(eudoxus    != NULL);
-    assert(state      != NULL);
-    assert(data       != NULL);
-    assert(collection != NULL);
-
+    assert(ib              != NULL);
+    assert(search          != NULL);
+    assert(search->runtime != NULL);
+    assert(mp              != NULL);
+    assert(data            != NULL);
+    assert(collection      != NULL);
+
+    ia_eudoxus_t         *eudoxus = search->runtime->eudoxus;
+    size_t                data_separator_length = strlen(c_data_separator);
+    size_t                separator_length = strlen(collection->separator);
     ib_field_t           *field;
     const ib_list_t      *subfields;
     const ib_list_node_t *node;
     const ib_field_t     *subfield;
     const ib_bytestr_t   *bs;
     ib_status_t           rc;
+    ia_eudoxus_result_t   irc;
+    ia_eudoxus_stream_t   streams[FAST_BATCH_SIZE];
+    fast_search_t         searches[FAST_BATCH_SIZE];
+    size_t                num_streams = 0;
 
     rc = ib_data_get(data, collection->name, &field);
     if (rc == IB_ENOENT) {
@@ -417,74 +513,142 @@ ib_status_t fast_feed_data_collection(
         return IB_EOTHER;
     }
 
-    IB_LIST_LOOP_CONST(subfields, node) {
-        subfield = (const ib_field_t *)ib_list_node_data_const(node);
-        assert(subfield != NULL);
-
-        rc = ib_field_value_type(
-            subfield,
-            ib_ftype_bytestr_out(&bs),
-            IB_FTYPE_BYTESTR
-        );
-        if (rc != IB_OK) {
-            ib_log_error(
-                ib,
-                "fast: Error loading data subfield %s of %s: %s",
-                subfield->name,
-                collection->name,
-                ib_status_to_string(rc)
+    node = ib_list_first_const(subfields);
+    while (node != NULL) {
+        /* Set up the next batch. */
+        for (
+            num_streams = 0;
+            num_streams < FAST_BATCH_SIZE && node != NULL;
+            ++num_streams, node = ib_list_node_next_const(node)
+        ) {
+            ia_eudoxus_stream_t *stream = &streams[num_streams];
+            uint8_t             *input;
+            uint8_t             *p;
+            size_t               value_length;
+
+            subfield = (const ib_field_t *)ib_list_node_data_const(node);
+            assert(subfield != NULL);
+
+            rc = ib_field_value_type(
+                subfield,
+                ib_ftype_bytestr_out(&bs),
+                IB_FTYPE_BYTESTR
             );
-            return IB_EOTHER;
-        }
+            if (rc != IB_OK) {
+                ib_log_error(
+                    ib,
+                    "fast: Error loading data subfield %s of %s: %s",
+                    subfield->name,
+                    collection->name,
+                    ib_status_to_string(rc)
+                );
+                rc = IB_EOTHER;
+                goto done;
+            }
+            value_length = ib_bytestr_const_ptr(bs) == NULL ?
+                0 : ib_bytestr_size(bs);
+
+            stream->input_length =
+                2 * data_separator_length + subfield->nlen +
+                separator_length + value_length;
+            input = ib_mpool_alloc(mp, stream->input_length);
+            if (input == NULL) {
+                ib_log_error(ib, "fast: Error allocating entry input.");
+                rc = IB_EOTHER;
+                goto done;
+            }
+            p = input;
+            memcpy(p, c_data_separator, data_separator_length);
+            p += data_separator_length;
+            memcpy(p, subfield->name, subfield->nlen);
+            p += subfield->nlen;
+            memcpy(p, collection->separator, separator_length);
+            p += separator_length;
+            if (value_length > 0) {
+                memcpy(p, ib_bytestr_const_ptr(bs), value_length);
+                p += value_length;
+            }
+            memcpy(p, c_data_separator, data_separator_length);
+            stream->input = input;
 
-        rc = fast_feed(
-            ib,
-            eudoxus,
-            state,
-            (const uint8_t *)subfield->name,
-            subfield->nlen
-        );
-        if (rc != IB_OK) {
-            return rc;
-        }
+            searches[num_streams] = *search;
+            searches[num_streams].rule_set = NULL;
+            rc = ib_list_create(&searches[num_streams].rule_list, mp);
+            if (rc != IB_OK) {
+                ib_log_error(
+                    ib,
+                    "fast: Error creating entry rule list: %s",
+                    ib_status_to_string(rc)
+                );
+                rc = IB_EOTHER;
+                goto done;
+            }
 
-        rc = fast_feed(
-            ib,
-            eudoxus,
-            state,
-            (const uint8_t *)collection->separator,
-            strlen(collection->separator)
-        );
-        if (rc != IB_OK) {
-            return rc;
+            irc = ia_eudoxus_create_state(
+                &stream->state,
+                eudoxus,
+                fast_eudoxus_callback,
+                &searches[num_streams]
+            );
+            if (irc != IA_EUDOXUS_OK) {
+                ib_log_error(
+                    ib,
+                    "fast: Error creating state: %s",
+                    fast_eudoxus_error(eudoxus)
+                );
+                rc = IB_EINVAL;
+                goto done;
+            }
         }
 
-        if (ib_bytestr_const_ptr(bs) != NULL && ib_bytestr_size(bs) > 0) {
-            rc = fast_feed(
+        irc = ia_eudoxus_execute_batch(streams, num_streams);
+        for (size_t i = 0; irc == IA_EUDOXUS_OK && i < num_streams; ++i) {
+            irc = streams[i].result;
+        }
+        if (irc != IA_EUDOXUS_OK) {
+            ib_log_error(
                 ib,
-                eudoxus,
-                state,
-                ib_bytestr_const_ptr(bs),
-                ib_bytestr_size(bs)
+                "fast: Eudoxus Execution Failure: %s",
+                fast_eudoxus_error(eudoxus)
             );
-            if (rc != IB_OK) {
-                return rc;
+            rc = IB_EINVAL;
+            goto done;
+        }
+
+        /* Merge in entry order. */
+        for (size_t i = 0; i < num_streams; ++i) {
+            const ib_list_node_t *rule_node;
+
+            IB_LIST_LOOP_CONST(searches[i].rule_list, rule_node) {
+                rc = fast_add_rule(
+                    search,
+                    (const ib_rule_t *)ib_list_node_data_const(rule_node)
+                );
+                if (rc != IB_OK) {
+                    ib_log_error(
+                        ib,
+                        "fast: Error adding rule: %s",
+                        ib_status_to_string(rc)
+                    );
+                    rc = IB_EOTHER;
+                    goto done;
+                }
             }
         }
 
-        rc = fast_feed(
-            ib,
-            eudoxus,
-            state,
-            (const uint8_t *)c_data_separator,
-            strlen(c_data_separator)
-        );
-        if (rc != IB_OK) {
-            return rc;
+        for (size_t i = 0; i < num_streams; ++i) {
+            ia_eudoxus_destroy_state(streams[i].state);
         }
+        num_streams = 0;
     }
 
-    return IB_OK;
+    rc = IB_OK;
+
+done:
+    for (size_t i = 0; i < num_streams; ++i) {
+        ia_eudoxus_destroy_state(streams[i].state);
+    }
+    return rc;
 }
 
 /**
@@ -495,7 +659,12 @@ ib_status_t fast_feed_data_collection(
  * functioning automata execution.  It can be combined with other feed
  * functions.
  *
+ * Bytestrings are fed to @a state; each collection entry is fed to a
+ * separate state (see fast_feed_data_collection()).
+ *
  * @param[in] ib          IronBee engine.
+ * @param[in] search      Search state of @a state; rules found are added.
+ * @param[in] mp          Memory pool for temporary allocations.
  * @param[in] eudoxus     Eudoxus engine.
  * @param[in] state       Eudoxus execution state; updated.
  * @param[in] data        Data source.
@@ -509,6 +678,8 @@ ib_status_t fast_feed_data_collection(
 static
 ib_status_t fast_feed_phase(
     const ib_engine_t             *ib,
+    fast_search_t                 *search,
+    ib_mpool_t                    *mp,
     const ia_eudoxus_t            *eudoxus,
     ia_eudoxus_state_t            *state,
     const ib_data_t               *data,
@@ -517,6 +688,8 @@ ib_status_t fast_feed_phase(
 )
 {
     assert(ib          != NULL);
+    assert(search      != NULL);
+    assert(mp          != NULL);
     assert(eudoxus     != NULL);
     assert(state       != NULL);
     assert(data        != NULL);
@@ -572,8 +745,8 @@ ib_status_t fast_feed_phase(
     ) {
         rc = fast_feed_data_collection(
             ib,
-            eudoxus,
-            state,
+            search,
+            mp,
             data,
             collection
         );
@@ -617,7 +790,6 @@ ia_eudoxus_command_t fast_eudoxus_callback(
     assert(search->runtime   != NULL);
     assert(search->rule_exec != NULL);
     assert(search->rule_list != NULL);
-    assert(search->rule_set  != NULL);
 
     uint32_t         index;
     const ib_rule_t *rule;
@@ -665,45 +837,11 @@ ia_eudoxus_command_t fast_eudoxus_callback(
         }
     }
 
-    /* Check/mark if already added. */
-    {
-        void *dummy_value;
-        rc = ib_hash_get_ex(
-            search->rule_set,
-            &dummy_value,
-            output,
-            output_length
-        );
-        if (rc == IB_OK) {
-            /* Rule already added. */
-            return IA_EUDOXUS_CMD_CONTINUE;
-        }
-        if (rc != IB_ENOENT) {
-            /* Error. */
-            ia_eudoxus_set_error_printf(
-                eudoxus,
-                "Unexpected error reading from rule set hash: %s",
-                ib_status_to_string(rc)
-            );
-            return IA_EUDOXUS_CMD_ERROR;
-        }
-    }
-
-    rc = ib_hash_set_ex(search->rule_set, output, output_length, (void *)1);
+    rc = fast_add_rule(search, rule);
     if (rc != IB_OK) {
         ia_eudoxus_set_error_printf(
             eudoxus,
-            "Unexpected error writing to rule set hash: %s",
-            ib_status_to_string(rc)
-        );
-        return IA_EUDOXUS_CMD_ERROR;
-    }
-
-    rc = ib_list_push(search->rule_list, (void *)rule);
-    if (rc != IB_OK) {
-         ia_eudoxus_set_error_printf(
-             eudoxus,
-             "Error pushing rule onto rule list: %s",
+            "Error adding rule: %s",
             ib_status_to_string(rc)
         );
         return IA_EUDOXUS_CMD_ERROR;
@@ -913,6 +1051,8 @@ ib_status_t fast_rule_injection(
     /* fast_feed_phase() will handle logging errors. */
     rc = fast_feed_phase(
         ib,
+        &search,
+        tmp_mp,
         runtime->eudoxus,
         state,
         data,
@@ -991,12 +1131,58 @@ ib_status_t fast_rule_injection_request_body(
     );
 }
 
+/**
+ * Parse an On/Off value of a @c FastAutomata option.
+ *
+ * @param[in]  cp     Configuration parser; used for logging.
+ * @param[in]  param  Option, for logging.
+ * @param[in]  value  Value to parse.
+ * @param[out] result Parsed value.
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EINVAL if @a value is neither On nor Off; will emit log message.
+ **/
+static
+ib_status_t fast_parse_on_off(
+    ib_cfgparser_t *cp,
+    const char     *param,
+    const char     *value,
+    bool           *result
+)
+{
+    assert(cp     != NULL);
+    assert(param  != NULL);
+    assert(value  != NULL);
+    assert(result != NULL);
+
+    if (strcasecmp(value, "On") == 0) {
+        *result = true;
+    }
+    else if (strcasecmp(value, "Off") == 0) {
+        *result = false;
+    }
+    else {
+        ib_cfg_log_error(
+            cp,
+            "fast: Invalid value for FastAutomata option \"%s\".",
+            param
+        );
+        return IB_EINVAL;
+    }
+
+    return IB_OK;
+}
+
 /**
  * Called when @c FastAutomata directive appears in configuration.
  *
+ * The first parameter is the path to the automata, followed by optional
+ * @c Map and @c Populate options.
+ *
  * @param[in] cp     Configuration parsed; used for logging.
  * @param[in] name   Name; ignored.
- * @param[in] p1     Path to automata.
+ * @param[in] vars   Path to automata and options.
  * @param[in] cbdata Ignored.
  *
  * @returns
@@ -1008,10 +1194,10 @@ ib_status_t fast_rule_injection_request_body(
  **/
 static
 ib_status_t fast_dir_fast_automata(
-    ib_cfgparser_t *cp,
-    const char     *name,
-    const char     *p1,
-    void           *cbdata
+    ib_cfgparser_t  *cp,
+    const char      *name,
+    const ib_list_t *vars,
+    void            *cbdata
 )
 {
 /* These macros are local to this function. */
@@ -1032,18 +1218,22 @@ ib_status_t fast_dir_fast_automata(
     assert(cp->ib != NULL);
     assert(cp->mp != NULL);
     assert(name   != NULL);
-    assert(p1     != NULL);
+    assert(vars   != NULL);
 
-    ib_engine_t         *ib;
-    ib_mpool_t          *mp;
-    ib_mpool_t          *cfg_mp;
-    fast_runtime_t      *runtime;
-    fast_config_t       *config;
-    ia_eudoxus_result_t  irc;
-    ib_status_t          rc;
-    const uint8_t       *data;
-    size_t               data_size;
-    uint32_t             index_size;
+    const ib_list_node_t *node;
+    const char           *p1;
+    bool                  map      = true;
+    bool                  populate = false;
+    ib_engine_t          *ib;
+    ib_mpool_t           *mp;
+    ib_mpool_t           *cfg_mp;
+    fast_runtime_t       *runtime;
+    fast_config_t        *config;
+    ia_eudoxus_result_t   irc;
+    ib_status_t           rc;
+    const uint8_t        *data;
+    size_t                data_size;
+    uint32_t              index_size;
 
     ib     = cp->ib;
     mp     = ib_engine_pool_main_get(ib);
@@ -1052,6 +1242,50 @@ ib_status_t fast_dir_fast_automata(
 
     assert(config != NULL);
 
+    node = ib_list_first_const(vars);
+    if (node == NULL || node->data == NULL) {
+        ib_cfg_log_error(cp, "fast: FastAutomata requires a path.");
+        return IB_EINVAL;
+    }
+    p1 = (const char *)node->data;
+
+    while ((node = ib_list_node_next_const(node)) != NULL) {
+        const char *param = (const char *)node->data;
+        const char *value = strchr(param, '=');
+        size_t      nlen;
+
+        if (value == NULL) {
+            ib_cfg_log_error(
+                cp,
+                "fast: %s: Invalid FastAutomata option \"%s\".",
+                p1,
+                param
+            );
+            return IB_EINVAL;
+        }
+        nlen = value - param;
+        ++value;
+
+        if (nlen == 3 && strncasecmp(param, "Map", nlen) == 0) {
+            rc = fast_parse_on_off(cp, param, value, &map);
+        }
+        else if (nlen == 8 && strncasecmp(param, "Populate", nlen) == 0) {
+            rc = fast_parse_on_off(cp, param, value, &populate);
+        }
+        else {
+            ib_cfg_log_error(
+                cp,
+                "fast: %s: Unknown FastAutomata option \"%s\".",
+                p1,
+                param
+            );
+            rc = IB_EINVAL;
+        }
+        if (rc != IB_OK) {
+            return rc;
+        }
+    }
+
     if (config->runtime != NULL) {
         ib_cfg_log_error(
             cp,
@@ -1069,7 +1303,16 @@ ib_status_t fast_dir_fast_automata(
     }
 
     /* Load Automata */
-    irc = ia_eudoxus_create_from_path(&runtime->eudoxus, p1);
+    if (map) {
+        irc = ia_eudoxus_create_from_path_mapped(
+            &runtime->eudoxus,
+            p1,
+            populate
+        );
+    }
+    else {
+        irc = ia_eudoxus_create_from_path(&runtime->eudoxus, p1);
+    }
     if (irc != IA_EUDOXUS_OK) {
         /* Note: ia_eudoxus_error() will not work as runtime->eudoxus
          * did not finish construction. */
@@ -1257,7 +1500,7 @@ static fast_config_t g_fast_config = {NULL};
 
 #ifndef DOXYGEN_SKIP
 static IB_DIRMAP_INIT_STRUCTURE(fast_directive_map) = {
-    IB_DIRMAP_INIT_PARAM1(
+    IB_DIRMAP_INIT_LIST(
         "FastAutomata",
         fast_dir_fast_automata,
         NULL
@@ -26,6 +26,7 @@
 
 #include "lua/ironbee.h"
 #include "lua_common_private.h"
+#include "lua_private.h"
 
 #include <ironbee/array.h>
 #include <ironbee/cfgmap.h>
@@ -54,6 +55,7 @@
 #endif
 #include <inttypes.h>
 
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -73,6 +75,21 @@ IB_MODULE_DECLARE();
 typedef struct modlua_runtime_t modlua_runtime_t;
 typedef struct modlua_cfg_t modlua_cfg_t;
 typedef struct modlua_lua_cbdata_t modlua_lua_cbdata_t;
+typedef struct modlua_thread_pool_t modlua_thread_pool_t;
+typedef struct modlua_thread_cache_t modlua_thread_cache_t;
+
+/**
+ * Maximum number of idle Lua threads kept by each OS thread.
+ */
+#define MODLUA_THREAD_CACHE_SIZE 16
+
+/**
+ * Maximum number of idle Lua threads kept in the shared pool.
+ *
+ * Threads released while both the OS thread's cache and the shared pool
+ * are full are joined and left to the GC.
+ */
+#define MODLUA_THREAD_POOL_SIZE 256
 
 /**
  * Callback type for functions executed protected by global lock.
@@ -107,14 +124,55 @@ struct modlua_lua_cbdata_t {
     ib_module_t *module; /**< The module object for this Lua module. */
 };
 
+/**
+ * Idle Lua threads kept by one OS thread.
+ *
+ * Only the owning OS thread takes threads from or returns threads to the
+ * cache, so it does so without locking. The cache is also linked into
+ * the pool's list of caches so that its counters can be read and its
+ * threads reclaimed when the OS thread exits.
+ */
+struct modlua_thread_cache_t {
+    modlua_thread_pool_t  *pool;   /**< Owning pool. */
+    lua_State             *threads[MODLUA_THREAD_CACHE_SIZE]; /**< Idle. */
+    size_t                 len;    /**< Number of idle threads. */
+    uint64_t               hits;   /**< Acquires served. Owner writes. */
+    modlua_thread_cache_t *prev;   /**< Previous cache. Under pool lock. */
+    modlua_thread_cache_t *next;   /**< Next cache. Under pool lock. */
+};
+
+/**
+ * Pool of idle Lua threads.
+ *
+ * Threads in the pool remain anchored in the global Lua state, so they
+ * are not collected. Each OS thread first uses its own cache, found
+ * through @c key, which takes no lock. The shared part of the pool,
+ * protected by @c lock, is only used when that cache is empty or full,
+ * and the global Lua lock only when the shared part is too.
+ */
+struct modlua_thread_pool_t {
+    ib_engine_t           *ib;           /**< Engine. Used for logging. */
+    pthread_key_t          key;          /**< This OS thread's cache. */
+    ib_lock_t              lock;         /**< Protects the fields below. */
+    modlua_thread_cache_t *caches;       /**< Caches of live OS threads. */
+    lua_State             *threads[MODLUA_THREAD_POOL_SIZE]; /**< Idle. */
+    size_t                 len;          /**< Number of idle threads. */
+    uint64_t               retired_hits; /**< Hits of exited OS threads. */
+    uint64_t               shared_hits;  /**< Acquires served here. */
+    uint64_t               creates;      /**< Acquires that created. */
+    uint64_t               joins;        /**< Releases that joined. */
+    uint64_t               lock_waits;   /**< Contended locks. Atomic. */
+};
+
 /**
  * Global module configuration.
  */
 struct modlua_cfg_t {
-    char               *pkg_path;  /**< Package path Lua Configuration. */
-    char               *pkg_cpath; /**< Cpath Lua Configuration. */
-    lua_State          *L;         /**< Lua runtime stack. */
-    ib_lock_t          *L_lck;     /**< Lua runtime stack lock. */
+    char                 *pkg_path;    /**< Package path Lua Configuration. */
+    char                 *pkg_cpath;   /**< Cpath Lua Configuration. */
+    lua_State            *L;           /**< Lua runtime stack. */
+    ib_lock_t            *L_lck;       /**< Lua runtime stack lock. */
+    modlua_thread_pool_t *thread_pool; /**< Idle Lua threads. */
 };
 
 /* Instantiate a module global configuration. */
@@ -122,7 +180,8 @@ static modlua_cfg_t modlua_global_cfg = {
     NULL, /* pkg_path */
     NULL, /* pkg_cpath */
     NULL,
-    NULL
+    NULL,
+    NULL  /* thread_pool */
 };
 
 ib_status_t modlua_rule_driver(
@@ -209,6 +268,31 @@ static ib_status_t modlua_runtime_set(
     return IB_OK;
 }
 
+/**
+ * Lock @a lock, counting it in the thread pool's waits if it is contended.
+ *
+ * @param[in] lock Lock to acquire.
+ *
+ * @returns Result of ib_lock_lock().
+ */
+static ib_status_t modlua_lock(ib_lock_t *lock)
+{
+    assert(lock);
+
+    modlua_thread_pool_t *pool = modlua_global_cfg.thread_pool;
+
+    /* ib_lock_t is a pthread mutex; only a failed try is a real wait. */
+    if (pthread_mutex_trylock(lock) == 0) {
+        return IB_OK;
+    }
+
+    if (pool != NULL) {
+        __atomic_add_fetch(&pool->lock_waits, 1, __ATOMIC_RELAXED);
+    }
+
+    return ib_lock_lock(lock);
+}
+
 /**
  * This will use module lock to atomically call @a fn.
  *
@@ -236,7 +320,7 @@ static ib_status_t call_in_critical_section(ib_engine_t *ib,
     /* Return code form critical call. */
     ib_status_t critical_rc;
 
-    ib_rc  = ib_lock_lock(modlua_global_cfg.L_lck);
+    ib_rc  = modlua_lock(modlua_global_cfg.L_lck);
     /* Report semop error and return. */
     if (ib_rc != IB_OK) {
         ib_log_error(ib, "Failed to lock Lua context.");
@@ -262,6 +346,268 @@ static ib_status_t call_in_critical_section(ib_engine_t *ib,
     return critical_rc;
 }
 
+/**
+ * Return the calling OS thread's Lua thread cache, creating it if needed.
+ *
+ * @param[in] pool Thread pool.
+ *
+ * @returns The cache or NULL if it could not be created, in which case
+ *          the caller uses the shared pool only.
+ */
+static modlua_thread_cache_t *modlua_thread_cache_get(
+    modlua_thread_pool_t *pool)
+{
+    assert(pool);
+
+    modlua_thread_cache_t *cache;
+
+    cache = pthread_getspecific(pool->key);
+    if (cache != NULL) {
+        return cache;
+    }
+
+    cache = calloc(1, sizeof(*cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->pool = pool;
+
+    if (modlua_lock(&pool->lock) != IB_OK) {
+        free(cache);
+        return NULL;
+    }
+    if (pthread_setspecific(pool->key, cache) != 0) {
+        ib_lock_unlock(&pool->lock);
+        free(cache);
+        return NULL;
+    }
+    cache->next = pool->caches;
+    if (pool->caches != NULL) {
+        pool->caches->prev = cache;
+    }
+    pool->caches = cache;
+    ib_lock_unlock(&pool->lock);
+
+    return cache;
+}
+
+/**
+ * Destroy an OS thread's Lua thread cache when that OS thread exits.
+ *
+ * Idle threads move to the shared pool; any that do not fit are joined.
+ * The cache's hits are kept in the pool's totals.
+ *
+ * @param[in] data The @ref modlua_thread_cache_t of the exiting OS thread.
+ */
+static void modlua_thread_cache_destroy(void *data)
+{
+    assert(data);
+
+    modlua_thread_cache_t *cache = (modlua_thread_cache_t *)data;
+    modlua_thread_pool_t  *pool  = cache->pool;
+
+    if (modlua_lock(&pool->lock) != IB_OK) {
+        return;
+    }
+
+    if (cache->prev != NULL) {
+        cache->prev->next = cache->next;
+    }
+    else {
+        pool->caches = cache->next;
+    }
+    if (cache->next != NULL) {
+        cache->next->prev = cache->prev;
+    }
+    pool->retired_hits += cache->hits;
+
+    while (cache->len > 0 && pool->len < MODLUA_THREAD_POOL_SIZE) {
+        pool->threads[pool->len++] = cache->threads[--cache->len];
+    }
+    pool->joins += cache->len;
+
+    ib_lock_unlock(&pool->lock);
+
+    while (cache->len > 0) {
+        call_in_critical_section(
+            pool->ib,
+            &ib_lua_join_thread,
+            &cache->threads[--cache->len]);
+    }
+
+    free(cache);
+}
+
+/**
+ * Take a Lua thread from the thread pool, creating one if it is empty.
+ *
+ * The calling OS thread's cache is tried first, then the shared pool.
+ *
+ * @param[in] ib IronBee engine. Used for logging.
+ * @param[out] L The acquired Lua thread.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - Errors from locking or from ib_lua_new_thread().
+ */
+static ib_status_t modlua_thread_acquire(ib_engine_t *ib, lua_State **L)
+{
+    assert(ib);
+    assert(L);
+    assert(modlua_global_cfg.thread_pool);
+
+    modlua_thread_pool_t  *pool = modlua_global_cfg.thread_pool;
+    modlua_thread_cache_t *cache;
+    ib_status_t rc;
+
+    cache = modlua_thread_cache_get(pool);
+    if (cache != NULL && cache->len > 0) {
+        *L = cache->threads[--cache->len];
+        /* Only this OS thread writes hits; the store is for readers. */
+        __atomic_store_n(&cache->hits, cache->hits + 1, __ATOMIC_RELAXED);
+        return IB_OK;
+    }
+
+    rc = modlua_lock(&pool->lock);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to lock Lua thread pool.");
+        return rc;
+    }
+
+    if (pool->len > 0) {
+        *L = pool->threads[--pool->len];
+        ++pool->shared_hits;
+        return ib_lock_unlock(&pool->lock);
+    }
+
+    ++pool->creates;
+    rc = ib_lock_unlock(&pool->lock);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to unlock Lua thread pool.");
+        return rc;
+    }
+
+    /* Pool is empty. Atomically create a new Lua stack. */
+    return call_in_critical_section(ib, &ib_lua_new_thread, L);
+}
+
+/**
+ * Return a Lua thread acquired by modlua_thread_acquire() to the pool.
+ *
+ * The thread goes to the calling OS thread's cache, or to the shared pool
+ * if that is full. If both are full the thread is joined instead.
+ *
+ * @param[in] ib IronBee engine. Used for logging.
+ * @param[in,out] L The Lua thread to release.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - Errors from locking or from ib_lua_join_thread().
+ */
+static ib_status_t modlua_thread_release(ib_engine_t *ib, lua_State **L)
+{
+    assert(ib);
+    assert(L);
+    assert(*L);
+    assert(modlua_global_cfg.thread_pool);
+
+    modlua_thread_pool_t  *pool = modlua_global_cfg.thread_pool;
+    modlua_thread_cache_t *cache;
+    ib_status_t rc;
+
+    /* Discard anything a previous user left on the stack. */
+    lua_settop(*L, 0);
+
+    cache = modlua_thread_cache_get(pool);
+    if (cache != NULL && cache->len < MODLUA_THREAD_CACHE_SIZE) {
+        cache->threads[cache->len++] = *L;
+        return IB_OK;
+    }
+
+    rc = modlua_lock(&pool->lock);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to lock Lua thread pool.");
+        return rc;
+    }
+
+    if (pool->len < MODLUA_THREAD_POOL_SIZE) {
+        pool->threads[pool->len++] = *L;
+        return ib_lock_unlock(&pool->lock);
+    }
+
+    ++pool->joins;
+    rc = ib_lock_unlock(&pool->lock);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to unlock Lua thread pool.");
+        return rc;
+    }
+
+    /* Pool is full. Atomically destroy the Lua stack. */
+    return call_in_critical_section(ib, &ib_lua_join_thread, L);
+}
+
+/**
+ * Sum the counters of @a pool and of all its caches.
+ *
+ * @param[in] pool Thread pool.
+ * @param[out] stats Counters.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - Errors from locking.
+ */
+static ib_status_t modlua_thread_pool_read(
+    modlua_thread_pool_t       *pool,
+    modlua_thread_pool_stats_t *stats)
+{
+    assert(pool);
+    assert(stats);
+
+    const modlua_thread_cache_t *cache;
+    ib_status_t rc;
+
+    rc = ib_lock_lock(&pool->lock);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    stats->local_hits  = pool->retired_hits;
+    stats->shared_hits = pool->shared_hits;
+    stats->creates     = pool->creates;
+    stats->joins       = pool->joins;
+    stats->lock_waits  = __atomic_load_n(&pool->lock_waits, __ATOMIC_RELAXED);
+    stats->idle        = pool->len;
+    for (cache = pool->caches; cache != NULL; cache = cache->next) {
+        stats->local_hits += __atomic_load_n(&cache->hits, __ATOMIC_RELAXED);
+    }
+
+    return ib_lock_unlock(&pool->lock);
+}
+
+ib_status_t modlua_thread_pool_stats(
+    ib_engine_t                *ib,
+    modlua_thread_pool_stats_t *stats)
+{
+    assert(ib);
+    assert(stats);
+
+    ib_status_t rc;
+    ib_module_t *module;
+    const modlua_cfg_t *cfg;
+
+    /* Go through the engine so that the loaded module's pool is read. */
+    rc = ib_engine_module_get(ib, MODULE_NAME_STR, &module);
+    if (rc != IB_OK) {
+        return IB_ENOENT;
+    }
+    cfg = (const modlua_cfg_t *)module->gcdata;
+    if (cfg == NULL || cfg->thread_pool == NULL) {
+        return IB_ENOENT;
+    }
+
+    return modlua_thread_pool_read(cfg->thread_pool, stats);
+}
+
 /**
  * Create a near-empty module structure.
  *
@@ -1449,8 +1795,8 @@ static ib_status_t modlua_null(
     modlua_lua_cbdata = (modlua_lua_cbdata_t *)cbdata;
     module = modlua_lua_cbdata->module;
 
-    /* Since there is  no connection Lua stack, we make a new one. */
-    rc = call_in_critical_section(ib, &ib_lua_new_thread, &L);
+    /* Since there is  no connection Lua stack, we borrow one. */
+    rc = modlua_thread_acquire(ib, &L);
     if (rc != IB_OK) {
         ib_log_alert(ib, "Failed to allocate new Lua thread.");
         return rc;
@@ -1487,9 +1833,9 @@ static ib_status_t modlua_null(
         /* Do not return. We must join the Lua thread. */
     }
 
-    join_rc = call_in_critical_section(ib, &ib_lua_join_thread, &L);
+    join_rc = modlua_thread_release(ib, &L);
     if (join_rc != IB_OK) {
-        ib_log_alert(ib, "Failed to join created Lua thread.");
+        ib_log_alert(ib, "Failed to release Lua thread.");
 
         /* If there is no other error, return the join error. */
         if (rc == IB_OK) {
@@ -2184,7 +2530,7 @@ static ib_status_t modlua_conn_init_lua_runtime(ib_engine_t *ib,
         return IB_EALLOC;
     }
 
-    rc = call_in_critical_section(ib, &ib_lua_new_thread, &modlua_runtime->L);
+    rc = modlua_thread_acquire(ib, &modlua_runtime->L);
     if (rc != IB_OK) {
         ib_log_alert(ib, "Failed to allocate new Lua thread for connection.");
         return rc;
@@ -2247,8 +2593,8 @@ static ib_status_t modlua_conn_fini_lua_runtime(ib_engine_t *ib,
         return IB_EOTHER;
     }
 
-    /* Atomically destroy the Lua stack */
-    rc = call_in_critical_section(ib, &ib_lua_join_thread, &modlua_runtime->L);
+    /* Return the Lua stack to the pool for the next connection. */
+    rc = modlua_thread_release(ib, &modlua_runtime->L);
 
     return rc;
 }
@@ -2276,10 +2622,11 @@ static ib_status_t rules_lua_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
 }
 
 /**
- * @brief Call the rule named @a func_name on a new Lua stack.
- * @details This will atomically create and destroy a lua_State*
- *          allowing for concurrent execution of @a func_name
- *          by a ib_lua_func_eval(ib_engine_t*, ib_txt_t*, const char*).
+ * @brief Call the rule named @a func_name on a Lua stack.
+ * @details The rule is run on the per-connection Lua stack, which is only
+ *          ever used by the thread processing that connection, so no
+ *          lock is taken. If the connection has no Lua stack one is
+ *          borrowed from the thread pool for the duration of the call.
  *
  * @param[in,out] rule_exec Rule execution environment
  * @param[in] func_name The Lua function name to call.
@@ -2297,13 +2644,28 @@ static ib_status_t ib_lua_func_eval_r(const ib_rule_exec_t *rule_exec,
 
     ib_engine_t *ib = rule_exec->ib;
     ib_tx_t *tx = rule_exec->tx;
-    int result_int;
+    int result_int = 0;
     ib_status_t ib_rc;
+    ib_status_t release_rc;
     lua_State *L;
+    modlua_runtime_t *modlua_runtime = NULL;
 
-    /* Atomically create a new Lua stack */
-    ib_rc = call_in_critical_section(ib, &ib_lua_new_thread, &L);
+    if (tx->conn != NULL) {
+        ib_rc = modlua_runtime_get(tx->conn, &modlua_runtime);
+        if (ib_rc != IB_OK) {
+            modlua_runtime = NULL;
+        }
+    }
 
+    if (modlua_runtime != NULL && modlua_runtime->L != NULL) {
+        L = modlua_runtime->L;
+        ib_rc = ib_lua_func_eval_int(
+            rule_exec, ib, tx, L, func_name, &result_int);
+        *result = result_int;
+        return ib_rc;
+    }
+
+    ib_rc = modlua_thread_acquire(ib, &L);
     if (ib_rc != IB_OK) {
         return ib_rc;
     }
@@ -2314,13 +2676,12 @@ static ib_status_t ib_lua_func_eval_r(const ib_rule_exec_t *rule_exec,
     /* Convert the passed in integer type to an ib_num_t. */
     *result = result_int;
 
-    if (ib_rc != IB_OK) {
-        return ib_rc;
+    /* Always hand the stack back, even if the rule failed. */
+    release_rc = modlua_thread_release(ib, &L);
+    if (ib_rc == IB_OK) {
+        ib_rc = release_rc;
     }
 
-    /* Atomically destroy the Lua stack */
-    ib_rc = call_in_critical_section(ib, &ib_lua_join_thread, &L);
-
     return ib_rc;
 }
 
@@ -2558,6 +2919,26 @@ static ib_status_t modlua_init(ib_engine_t *ib,
         return rc;
     }
 
+    /* Pool of idle Lua threads, shared by all copies of the config. */
+    modlua_global_cfg.thread_pool =
+        calloc(1, sizeof(*modlua_global_cfg.thread_pool));
+    if (modlua_global_cfg.thread_pool == NULL) {
+        ib_log_error(ib, "Failed to allocate lua thread pool.");
+        return IB_EALLOC;
+    }
+    modlua_global_cfg.thread_pool->ib = ib;
+    rc = ib_lock_init(&modlua_global_cfg.thread_pool->lock);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to initialize lua thread pool lock.");
+        return rc;
+    }
+    if (pthread_key_create(&modlua_global_cfg.thread_pool->key,
+                           &modlua_thread_cache_destroy) != 0)
+    {
+        ib_log_error(ib, "Failed to create lua thread cache key.");
+        return IB_EUNKNOWN;
+    }
+
     /* Set up rule support. */
     rc = rules_lua_init(ib, m, cbdata);
     if (rc != IB_OK) {
@@ -2770,10 +3151,37 @@ static IB_DIRMAP_INIT_STRUCTURE(modlua_directive_map) = {
 };
 
 /**
- * Destroy global lock and Lua state.
+ * Destroy global lock, thread pool and Lua state.
  */
 static ib_status_t modlua_fini(ib_engine_t *ib, ib_module_t *m, void *cbdata) {
 
+    if (modlua_global_cfg.thread_pool != NULL) {
+        modlua_thread_pool_t *pool = modlua_global_cfg.thread_pool;
+        modlua_thread_pool_stats_t stats;
+
+        if (modlua_thread_pool_read(pool, &stats) == IB_OK) {
+            ib_log_info(
+                ib,
+                "Lua thread pool: local_hits=%" PRIu64
+                " shared_hits=%" PRIu64 " creates=%" PRIu64
+                " joins=%" PRIu64 " lock_waits=%" PRIu64,
+                stats.local_hits, stats.shared_hits, stats.creates,
+                stats.joins, stats.lock_waits);
+        }
+
+        /* No more destructor calls; free the caches of live OS threads.
+         * Cached and pooled threads are collected by lua_close(). */
+        pthread_key_delete(pool->key);
+        while (pool->caches != NULL) {
+            modlua_thread_cache_t *cache = pool->caches;
+            pool->caches = cache->next;
+            free(cache);
+        }
+        ib_lock_destroy(&pool->lock);
+        free(pool);
+        modlua_global_cfg.thread_pool = NULL;
+    }
+
     ib_lock_destroy(modlua_global_cfg.L_lck);
     free(modlua_global_cfg.L_lck);
     modlua_global_cfg.L_lck = NULL;
@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+#ifndef _IB_MODULES_LUA_PRIVATE_H_
+#define _IB_MODULES_LUA_PRIVATE_H_
+
+/**
+ * @file
+ * @brief IronBee --- LUA Module private interface
+ *
+ * Exposed for testing and diagnostics only.
+ */
+
+#include <ironbee/engine.h>
+#include <ironbee/types.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Lua thread pool counters.
+ *
+ * All counts are totals since the Lua module was initialized.
+ */
+typedef struct modlua_thread_pool_stats_t {
+    uint64_t local_hits;  /**< Acquires served by the OS thread's cache. */
+    uint64_t shared_hits; /**< Acquires served by the shared pool. */
+    uint64_t creates;     /**< Acquires that created a new Lua thread. */
+    uint64_t joins;       /**< Releases that joined the Lua thread. */
+    uint64_t lock_waits;  /**< Times a pool or Lua lock was contended. */
+    size_t   idle;        /**< Idle Lua threads in the shared pool. */
+} modlua_thread_pool_stats_t;
+
+/**
+ * Read the Lua thread pool counters of the Lua module loaded into @a ib.
+ *
+ * @param[in] ib IronBee engine with the Lua module loaded.
+ * @param[out] stats Counters.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_ENOENT if the Lua module is not loaded or not initialized.
+ *   - Errors from locking.
+ */
+ib_status_t modlua_thread_pool_stats(
+    ib_engine_t                *ib,
+    modlua_thread_pool_stats_t *stats
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IB_MODULES_LUA_PRIVATE_H_ */
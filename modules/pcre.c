@@ -33,6 +33,7 @@
 #include <ironbee/module.h>
 #include <ironbee/mpool.h>
 #include <ironbee/operator.h>
+#include <ironbee/pcre_cache.h>
 #include <ironbee/provider.h>
 #include <ironbee/rule_engine.h>
 #include <ironbee/util.h>
@@ -55,12 +56,10 @@
 /* How many matches will PCRE find and populate. */
 #define MATCH_MAX 10
 
-/* PCRE can use an independent stack or the machine stack.
- * If PCRE_JIT_STACK is true (conditional on PCRE_HAVE_JIT being true)
- * then pcrejit will use an independent stack. If PCRE_JIT_STACK is not
- * defined then the machine stack will be used.  */
+/* JIT compiled patterns run on a per-thread JIT stack provided by the
+ * engine's pattern cache.  Unless configured, the stack sizes are derived
+ * from the match recursion limit. */
 #ifdef PCRE_HAVE_JIT
-#define PCRE_JIT_STACK
 const int PCRE_JIT_STACK_START_MULT = 32;
 const int PCRE_JIT_STACK_MAX_MULT   = 512;
 #endif
@@ -100,24 +99,56 @@ typedef struct modpcre_cfg_t {
  * Internal representation of PCRE compiled patterns.
  */
 typedef struct modpcre_cpat_data_t {
-    pcre                *cpatt;           /**< Compiled pattern */
-    size_t               cpatt_sz;        /**< Size of cpatt. */
-    pcre_extra          *edata;           /**< PCRE Study data */
-    size_t               study_data_sz;   /**< Size of edata->study_data. */
+    const pcre          *cpatt;           /**< Compiled pattern (shared) */
+    const pcre_extra    *edata;           /**< Study data & limits, or NULL */
     const char          *patt;            /**< Regex pattern text */
     bool                 is_dfa;          /**< Is this a DFA? */
     bool                 is_jit;          /**< Is this JIT compiled? */
-    int                  jit_stack_start; /**< Starting JIT stack size */
-    int                  jit_stack_max;   /**< Max JIT stack size */
     int                  dfa_ws_size;     /**< Size of DFA workspace */
 } modpcre_cpat_data_t;
 
+/**
+ * DFA workspace slot.
+ *
+ * Each DFA rule ID is assigned a slot when its operator is created; the
+ * slot locates the rule's workspace in the per-transaction workspace slab.
+ */
+typedef struct modpcre_dfa_slot_t {
+    size_t               index;           /**< Slot index */
+    size_t               offset;          /**< Workspace offset in slab */
+    int                  wscount;         /**< Size of the workspace */
+} modpcre_dfa_slot_t;
+
+/**
+ * Module data.
+ */
+typedef struct modpcre_data_t {
+    ib_hash_t           *dfa_slots;       /**< DFA slots by rule ID */
+    size_t               num_dfa_slots;   /**< Number of DFA slots */
+    size_t               dfa_ws_total;    /**< Total size of DFA workspaces */
+} modpcre_data_t;
+
+/**
+ * Per-transaction scratch storage.
+ *
+ * Operators run one at a time in a transaction, so they share the
+ * ovector.  DFA workspaces persist for the whole transaction so that
+ * matches can be restarted on the next chunk of a stream.
+ */
+typedef struct modpcre_tx_data_t {
+    int                  ovector[3 * MATCH_MAX]; /**< Match vector */
+    int                 *dfa_slab;        /**< DFA workspaces or NULL */
+    bool                *dfa_started;     /**< Per-slot: workspace in use? */
+    size_t               num_dfa_slots;   /**< Number of slots in slab */
+} modpcre_tx_data_t;
+
 /**
  * PCRE and DFA rule data types are an alias for the compiled pattern structure.
  */
 typedef struct modpcre_rule_data_t {
     modpcre_cpat_data_t *cpdata;          /**< Compiled pattern data */
     const char          *id;              /**< ID for DFA rules */
+    const modpcre_dfa_slot_t *dfa_slot;   /**< Workspace slot for DFA rules */
 } modpcre_rule_data_t;
 
 /* Instantiate a module global configuration. */
@@ -161,234 +192,86 @@ static ib_status_t pcre_compile_internal(ib_engine_t *ib,
     assert(pcpdata != NULL);
     assert(patt != NULL);
 
-    /* Pattern data structure we'll create */
     modpcre_cpat_data_t *cpdata;
+    const ib_pcre_t *shared;
+    ib_pcre_params_t params;
+    ib_status_t rc;
 
-    /* Compiled pattern. */
-    pcre *cpatt = NULL;
-
-    /* Compiled pattern size. Used to copy cpatt. */
-    size_t cpatt_sz;
-
-    /* Extra data structure. This contains the study_data pointer. */
-    pcre_extra *edata = NULL;
-
-    /* Size of edata->study_data. */
-    size_t study_data_sz;
-
-    /* How cpatt is produced. */
-    const int compile_flags = PCRE_DOTALL | PCRE_DOLLAR_ENDONLY;
-
-    /* Are we using JIT? */
-    bool use_jit = !is_dfa;
-
+    /* DFA patterns are neither JIT compiled nor limited. */
+    memset(&params, 0, sizeof(params));
+    params.options = PCRE_DOTALL | PCRE_DOLLAR_ENDONLY;
+    params.study = (config->study != 0);
+    params.jit = (! is_dfa) && (config->use_jit != 0);
+    if (! is_dfa) {
+        params.match_limit = (unsigned long)config->match_limit;
+        params.match_limit_recursion =
+            (unsigned long)config->match_limit_recursion;
+    }
 #ifdef PCRE_HAVE_JIT
-    if (config->use_jit == 0) {
-        use_jit = false;
+    if (params.jit) {
+        params.jit_stack_start = (config->jit_stack_start != 0) ?
+            (int)config->jit_stack_start :
+            PCRE_JIT_STACK_START_MULT * (int)config->match_limit_recursion;
+        params.jit_stack_max = (config->jit_stack_max != 0) ?
+            (int)config->jit_stack_max :
+            PCRE_JIT_STACK_MAX_MULT * (int)config->match_limit_recursion;
     }
+#endif
 
-    /* Do we want to be using JIT? */
-    const bool want_jit = use_jit;
-#else
-    use_jit = false;
-#endif /* PCRE_HAVE_JIT */
-
-    cpatt = pcre_compile(patt, compile_flags, errptr, erroffset, NULL);
-
-    if (*errptr != NULL) {
+    /* Patterns are compiled once and shared through the engine's cache.
+     * Once configuration is finished, new patterns go into @a pool. */
+    *errptr = NULL;
+    rc = ib_pcre_cache_compile(ib_engine_pcre_cache(ib), patt, &params,
+                               &shared, errptr, erroffset);
+    if (rc == IB_DECLINED) {
+        rc = ib_pcre_compile(pool,
+                             ib_pcre_cache_jit_enabled(
+                                 ib_engine_pcre_cache(ib)),
+                             patt, &params,
+                             &shared, errptr, erroffset);
+    }
+    if (rc == IB_EINVAL) {
         ib_log_error(ib, "PCRE compile error for \"%s\": %s at offset %d",
                      patt, *errptr, *erroffset);
-        return IB_EINVAL;
-    }
-
-    if (config->study) {
-        if (use_jit) {
-#ifdef PCRE_HAVE_JIT
-            edata = pcre_study(cpatt, PCRE_STUDY_JIT_COMPILE, errptr);
-            if (*errptr != NULL)  {
-                pcre_free(cpatt);
-                use_jit = false;
-                ib_log_warning(ib, "PCRE-JIT study failed: %s", *errptr);
-            }
-#endif
-        }
-        else {
-            edata = pcre_study(cpatt, 0, errptr);
-            if (*errptr != NULL)  {
-                pcre_free(cpatt);
-                ib_log_error(ib, "PCRE study failed: %s", *errptr);
-            }
-        }
-    }
-    else if (use_jit) {
-        ib_log_warning(ib, "PCRE: Disabling JIT because study disabled");
-        use_jit = false;
-    }
-
-#ifdef PCRE_HAVE_JIT
-    /* The check to see if JIT compilation was a success changed in 8.20RC1
-       now uses pcre_fullinfo see doc/pcrejit.3 */
-    if (use_jit) {
-        int rc;
-        int pcre_jit_ret;
-
-        rc = pcre_fullinfo(cpatt, edata, PCRE_INFO_JIT, &pcre_jit_ret);
-        if (rc != 0) {
-            ib_log_error(ib, "PCRE-JIT failed to get pcre_fullinfo");
-            use_jit = false;
-        }
-        else if (pcre_jit_ret != 1) {
-            ib_log_info(ib, "PCRE-JIT compiler does not support: %s", patt);
-            use_jit = false;
-        }
-        else { /* Assume pcre_jit_ret == 1. */
-            /* Do nothing */
-        }
-    }
-    if (want_jit && !use_jit) {
-        ib_log_info(ib, "Falling back to normal PCRE");
+        return rc;
     }
-#endif /*PCRE_HAVE_JIT*/
-
-    /* Compute the size of the populated values of cpatt. */
-    pcre_fullinfo(cpatt, edata, PCRE_INFO_SIZE, &cpatt_sz);
-    if (edata != NULL) {
-        pcre_fullinfo(cpatt, edata, PCRE_INFO_STUDYSIZE, &study_data_sz);
+    else if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to compile pattern \"%s\": %s",
+                     patt, ib_status_to_string(rc));
+        return rc;
     }
-    else {
-        study_data_sz = 0;
+    if (params.jit && ib_pcre_cache_jit_enabled(ib_engine_pcre_cache(ib)) &&
+        (! shared->is_jit))
+    {
+        ib_log_info(ib, "PCRE-JIT not used for: %s", patt);
     }
 
-    /**
-     * Below is only allocation and copy operations to pass the PCRE results
-     * back to the output variable cpdata.
-     */
-
     cpdata = (modpcre_cpat_data_t *)ib_mpool_calloc(pool, sizeof(*cpdata), 1);
     if (cpdata == NULL) {
-        pcre_free(cpatt);
-        pcre_free(edata);
         ib_log_error(ib,
                      "Failed to allocate cpdata of size: %zd",
                      sizeof(*cpdata));
         return IB_EALLOC;
     }
-
+    cpdata->cpatt = shared->code;
+    cpdata->edata = shared->extra;
+    cpdata->patt = shared->pattern;
     cpdata->is_dfa = is_dfa;
-    cpdata->is_jit = use_jit;
-    cpdata->cpatt_sz = cpatt_sz;
-    cpdata->study_data_sz = study_data_sz;
-
-    /* Copy pattern. */
-    cpdata->patt = ib_mpool_strdup(pool, patt);
-    if (cpdata->patt == NULL) {
-        pcre_free(cpatt);
-        pcre_free(edata);
-        ib_log_error(ib, "Failed to duplicate pattern string: %s", patt);
-        return IB_EALLOC;
-    }
-
-    /* Copy compiled pattern. */
-    cpdata->cpatt = ib_mpool_memdup(pool, cpatt, cpatt_sz);
-    pcre_free(cpatt);
-    if (cpdata->cpatt == NULL) {
-        pcre_free(edata);
-        ib_log_error(ib, "Failed to duplicate pattern of size: %zd", cpatt_sz);
-        return IB_EALLOC;
-    }
-    ib_log_debug(ib, "PCRE copied cpatt @ %p -> %p (%zd bytes)",
-                 (void *)cpatt, (void *)cpdata->cpatt, cpatt_sz);
-
-    /* Copy extra data (study data). */
-    if (edata != NULL) {
-
-        /* Copy edata. */
-        cpdata->edata = ib_mpool_memdup(pool, edata, sizeof(*edata));
-        if (cpdata->edata == NULL) {
-            pcre_free(edata);
-            ib_log_error(ib, "Failed to duplicate edata.");
-            return IB_EALLOC;
-        }
-
-        /* Copy edata->study_data. */
-        if (edata->study_data != NULL) {
-            cpdata->edata->study_data =
-                ib_mpool_memdup(pool, edata->study_data, study_data_sz);
-
-            if (cpdata->edata->study_data == NULL) {
-                ib_log_error(ib, "Failed to study data of size: %zd",
-                             study_data_sz);
-                pcre_free(edata);
-                return IB_EALLOC;
-            }
-        }
-        pcre_free(edata);
-    }
-    else {
-        cpdata->edata = ib_mpool_calloc(pool, 1, sizeof(*edata));
-        if (cpdata->edata == NULL) {
-            pcre_free(edata);
-            ib_log_error(ib, "Failed to allocate edata.");
-            return IB_EALLOC;
-        }
-    }
-
-    /* Set the PCRE limits for non-DFA patterns */
-    if (! is_dfa) {
-        cpdata->edata->flags |=
-            (PCRE_EXTRA_MATCH_LIMIT | PCRE_EXTRA_MATCH_LIMIT_RECURSION);
-        cpdata->edata->match_limit =
-            (unsigned long)config->match_limit;
-        cpdata->edata->match_limit_recursion =
-            (unsigned long)config->match_limit_recursion;
-        cpdata->dfa_ws_size = 0;
-    }
-    else {
-        cpdata->edata->match_limit = 0U;
-        cpdata->edata->match_limit_recursion = 0U;
-        cpdata->dfa_ws_size = (int)config->dfa_workspace_size;
-    }
-
-    /* Set stack limits for JIT */
-    if (cpdata->is_jit) {
-#ifdef PCRE_HAVE_JIT
-        if (config->jit_stack_start == 0U) {
-            cpdata->jit_stack_start =
-                PCRE_JIT_STACK_START_MULT * config->match_limit_recursion;
-        }
-        else {
-            cpdata->jit_stack_start = (int)config->jit_stack_start;
-        }
-        if (config->jit_stack_max == 0U) {
-            cpdata->jit_stack_max =
-                PCRE_JIT_STACK_MAX_MULT * config->match_limit_recursion;
-        }
-        else {
-            cpdata->jit_stack_max = (int)config->jit_stack_max;
-        }
-#endif
-    }
-    else {
-        cpdata->jit_stack_start = 0;
-        cpdata->jit_stack_max = 0;
-    }
+    cpdata->is_jit = shared->is_jit;
+    cpdata->dfa_ws_size = is_dfa ? (int)config->dfa_workspace_size : 0;
 
     ib_log_trace(ib,
                  "Compiled pcre pattern \"%s\": "
-                 "cpatt=%p edata=%p limit=%ld rlimit=%ld study=%p "
-                 "dfa=%s dfa-ws-sz=%d "
-                 "jit=%s jit-stack: start=%d max=%d",
+                 "cpatt=%p (%zd bytes) edata=%p (%zd bytes study) "
+                 "dfa=%s dfa-ws-sz=%d jit=%s",
                  patt,
-                 (void *)cpdata->cpatt,
-                 (void *)cpdata->edata,
-                 cpdata->edata->match_limit,
-                 cpdata->edata->match_limit_recursion,
-                 cpdata->edata->study_data,
+                 (const void *)cpdata->cpatt,
+                 shared->code_size,
+                 (const void *)cpdata->edata,
+                 shared->study_size,
                  cpdata->is_dfa ? "yes" : "no",
                  cpdata->dfa_ws_size,
-                 cpdata->is_jit ? "yes" : "no",
-                 cpdata->jit_stack_start,
-                 cpdata->jit_stack_max);
+                 cpdata->is_jit ? "yes" : "no");
     *pcpdata = cpdata;
 
     return IB_OK;
@@ -477,7 +360,6 @@ static ib_status_t modpcre_compile(ib_provider_t *mpr,
  *
  * @returns
  *   - IB_OK on success.
- *   - IB_EALLOC on memory allocation failures.
  *   - IB_ENOENT if a match was not found.
  *   - IB_EINVAL if an unexpected error is returned by @c pcre_exec.
  */
@@ -496,20 +378,11 @@ static ib_status_t modpcre_match_compiled(ib_provider_t *mpr,
     assert(cpdata->is_dfa == false);
 
     int ec;
-    const int ovector_sz = 30;
-    int *ovector;
-
-
-    ovector = (int *)malloc(ovector_sz*sizeof(*ovector));
-    if (ovector == NULL) {
-        return IB_EALLOC;
-    }
+    int ovector[3 * MATCH_MAX];
 
     ec = pcre_exec(cpdata->cpatt, cpdata->edata,
                    (const char *)data, dlen,
-                   0, 0, ovector, ovector_sz);
-
-    free(ovector);
+                   0, 0, ovector, 3 * MATCH_MAX);
 
     if (ec >= 0) {
         return IB_OK;
@@ -639,6 +512,7 @@ static ib_status_t pcre_operator_create(ib_engine_t *ib,
     }
     rule_data->cpdata = cpdata;
     rule_data->id = NULL;           /* Not needed for rx rules */
+    rule_data->dfa_slot = NULL;
 
     /* Rule data is an alias for the compiled pattern data */
     op_inst->data = rule_data;
@@ -661,6 +535,43 @@ static ib_status_t pcre_operator_destroy(ib_operator_inst_t *op_inst)
     return IB_OK;
 }
 
+/**
+ * Get or create the per-transaction scratch storage.
+ *
+ * @param[in] tx Transaction
+ * @param[out] tx_data Scratch storage
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC on allocation failure.
+ */
+static ib_status_t get_tx_data(ib_tx_t *tx,
+                               modpcre_tx_data_t **tx_data)
+{
+    assert(tx != NULL);
+    assert(tx->mp != NULL);
+    assert(tx_data != NULL);
+
+    ib_status_t rc;
+
+    rc = ib_tx_get_module_data(tx, IB_MODULE_STRUCT_PTR, (void **)tx_data);
+    if ( (rc == IB_OK) && (*tx_data != NULL) ) {
+        return IB_OK;
+    }
+
+    *tx_data = ib_mpool_calloc(tx->mp, 1, sizeof(**tx_data));
+    if (*tx_data == NULL) {
+        return IB_EALLOC;
+    }
+
+    rc = ib_tx_set_module_data(tx, IB_MODULE_STRUCT_PTR, *tx_data);
+    if (rc != IB_OK) {
+        *tx_data = NULL;
+    }
+
+    return rc;
+}
+
 /**
  * Set the matches into the given field name as .0, .1, .2 ... .9.
  *
@@ -773,26 +684,18 @@ static ib_status_t pcre_operator_execute(const ib_rule_exec_t *rule_exec,
     int matches;
     ib_status_t ib_rc;
     const int ovecsize = 3 * MATCH_MAX;
-    int *ovector = (int *)malloc(ovecsize*sizeof(*ovector));
+    int *ovector;
+    modpcre_tx_data_t *tx_data;
     const char *subject = NULL;
     size_t subject_len = 0;
     const ib_bytestr_t *bytestr;
     modpcre_rule_data_t *rule_data = (modpcre_rule_data_t *)data;
-    pcre_extra *edata = NULL;
-#ifdef PCRE_JIT_STACK
-    pcre_jit_stack *jit_stack = NULL;
-#endif
 
     assert(rule_data->cpdata->is_dfa == false);
 
-    if (ovector==NULL) {
-        return IB_EALLOC;
-    }
-
     if (field->type == IB_FTYPE_NULSTR) {
         ib_rc = ib_field_value(field, ib_ftype_nulstr_out(&subject));
         if (ib_rc != IB_OK) {
-            free(ovector);
             return ib_rc;
         }
 
@@ -803,7 +706,6 @@ static ib_status_t pcre_operator_execute(const ib_rule_exec_t *rule_exec,
     else if (field->type == IB_FTYPE_BYTESTR) {
         ib_rc = ib_field_value(field, ib_ftype_bytestr_out(&bytestr));
         if (ib_rc != IB_OK) {
-            free(ovector);
             return ib_rc;
         }
 
@@ -813,10 +715,16 @@ static ib_status_t pcre_operator_execute(const ib_rule_exec_t *rule_exec,
         }
     }
     else {
-        free(ovector);
         return IB_EINVAL;
     }
 
+    /* Use the transaction's match vector */
+    ib_rc = get_tx_data(rule_exec->tx, &tx_data);
+    if (ib_rc != IB_OK) {
+        return ib_rc;
+    }
+    ovector = tx_data->ovector;
+
     if (subject == NULL) {
         subject     = "";
     }
@@ -837,36 +745,9 @@ static ib_status_t pcre_operator_execute(const ib_rule_exec_t *rule_exec,
         }
     }
 
-    if (rule_data->cpdata->is_jit) {
-#ifdef PCRE_JIT_STACK
-        jit_stack = pcre_jit_stack_alloc(rule_data->cpdata->jit_stack_start,
-                                         rule_data->cpdata->jit_stack_max);
-        if (jit_stack == NULL) {
-            ib_rule_log_debug(rule_exec,
-                              "Failed to allocate a jit stack for a "
-                              "jit-compiled rule.  "
-                              "Not using jit for this call.");
-        }
-        /* If the study data is NULL or size zero, don't use it. */
-        else if (rule_data->cpdata->study_data_sz > 0) {
-            edata = rule_data->cpdata->edata;
-        }
-        if (edata != NULL) {
-            pcre_assign_jit_stack(edata, NULL, jit_stack);
-        }
-#else
-        edata = NULL;
-#endif
-    }
-    else if (rule_data->cpdata->study_data_sz > 0) {
-        edata = rule_data->cpdata->edata;
-    }
-    else {
-        edata = NULL;
-    }
-
+    /* JIT patterns run on the calling thread's JIT stack. */
     matches = pcre_exec(rule_data->cpdata->cpatt,
-                        edata,
+                        rule_data->cpdata->edata,
                         subject,
                         subject_len,
                         0, /* Starting offset. */
@@ -874,12 +755,6 @@ static ib_status_t pcre_operator_execute(const ib_rule_exec_t *rule_exec,
                         ovector,
                         ovecsize);
 
-#ifdef PCRE_JIT_STACK
-    if (jit_stack != NULL) {
-        pcre_jit_stack_free(jit_stack);
-    }
-#endif
-
     if (matches > 0) {
         if (ib_flags_all(rule_exec->rule->flags, IB_RULE_FLAG_CAPTURE)) {
             pcre_set_matches(rule_exec, ovector, matches, subject);
@@ -913,7 +788,6 @@ static ib_status_t pcre_operator_execute(const ib_rule_exec_t *rule_exec,
         *result = 0;
     }
 
-    free(ovector);
     return ib_rc;
 }
 
@@ -964,6 +838,56 @@ static ib_status_t dfa_id_set(const ib_rule_t *rule,
     return IB_OK;
 }
 
+/**
+ * Assign the workspace slot of a DFA rule.
+ *
+ * Rules with the same ID share a slot, and thus a workspace, within a
+ * transaction.
+ *
+ * @param[in] m PCRE module.
+ * @param[in,out] rule_data DFA rule object, with its ID set.
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC on memory failure.
+ */
+static ib_status_t dfa_slot_set(const ib_module_t *m,
+                                modpcre_rule_data_t *rule_data)
+{
+    assert(m != NULL);
+    assert(m->data != NULL);
+    assert(rule_data != NULL);
+    assert(rule_data->id != NULL);
+
+    modpcre_data_t *mod_data = (modpcre_data_t *)m->data;
+    modpcre_dfa_slot_t *slot;
+    ib_status_t rc;
+
+    rc = ib_hash_get(mod_data->dfa_slots, &slot, rule_data->id);
+    if (rc == IB_OK) {
+        rule_data->dfa_slot = slot;
+        return IB_OK;
+    }
+
+    slot = ib_mpool_alloc(ib_hash_pool(mod_data->dfa_slots), sizeof(*slot));
+    if (slot == NULL) {
+        return IB_EALLOC;
+    }
+    slot->index = mod_data->num_dfa_slots;
+    slot->offset = mod_data->dfa_ws_total;
+    slot->wscount = rule_data->cpdata->dfa_ws_size;
+
+    rc = ib_hash_set(mod_data->dfa_slots, rule_data->id, slot);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    ++mod_data->num_dfa_slots;
+    mod_data->dfa_ws_total += (size_t)slot->wscount;
+
+    rule_data->dfa_slot = slot;
+    return IB_OK;
+}
+
 /**
  * @brief Create the PCRE operator.
  * @param[in] ib The IronBee engine (unused)
@@ -1041,6 +965,12 @@ static ib_status_t dfa_operator_create(ib_engine_t *ib,
                      ib_status_to_string(rc));
         return rc;
     }
+    rc = dfa_slot_set(module, rule_data);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Error assigning workspace for DFA: %s",
+                     ib_status_to_string(rc));
+        return rc;
+    }
     ib_log_debug(ib, "Compiled DFA id=\"%s\" operator pattern \"%s\" @ %p",
                  rule_data->id, pattern, (void *)cpdata->cpatt);
 
@@ -1049,150 +979,63 @@ static ib_status_t dfa_operator_create(ib_engine_t *ib,
 }
 
 /**
- * Get or create an ib_hash_t inside of @c tx for storing dfa rule data.
+ * Get the workspace of a DFA rule from the per-transaction slab.
  *
- * The hash is stored at the key @c HASH_NAME_STR.
- *
- * @param[in] tx The transaction containing @c tx->data which holds
- *            the @a rule_data object.
- * @param[out] hash The fetched or created rule data hash. This is set
- *             to NULL on failure.
- *
- * @return
- *   - IB_OK on success.
- *   - IB_EALLOC on allocation failure
- */
-static ib_status_t get_or_create_rule_data_hash(ib_tx_t *tx,
-                                                ib_hash_t **hash)
-{
-    assert(tx);
-    assert(tx->mp);
-
-    ib_status_t rc;
-
-    /* Get or create the hash that contains the rule data. */
-    rc = ib_tx_get_module_data(tx, IB_MODULE_STRUCT_PTR, (void **)hash);
-    if ( (rc == IB_OK) && (*hash != NULL) ) {
-        ib_log_debug2_tx(tx, "Found rule data hash in tx.");
-        return IB_OK;
-    }
-
-    ib_log_debug2_tx(tx, "Rule data hash did not exist in tx.");
-
-    rc = ib_hash_create(hash, tx->mp);
-    if (rc != IB_OK) {
-        ib_log_debug2_tx(tx, "Failed to create hash: %s",
-                         ib_status_to_string(rc));
-        return rc;
-    }
-
-    rc = ib_tx_set_module_data(tx, IB_MODULE_STRUCT_PTR, *hash);
-    if (rc != IB_OK) {
-        ib_log_debug2_tx(tx, "Failed to store hash: %s",
-                         ib_status_to_string(rc));
-        *hash = NULL;
-    }
-
-    ib_log_debug2_tx(tx, "Returning rule hash at %p.", *hash);
-
-    return rc;
-
-}
-
-struct dfa_workspace_t {
-    int *workspace;
-    int wscount;
-};
-typedef struct dfa_workspace_t dfa_workspace_t;
-
-/**
- * Create the per-transaction data for use with the dfa operator.
+ * The slab holds the workspaces of all DFA rules and is allocated on
+ * first use in a transaction.
  *
- * @param[in,out] tx Transaction to store the value in.
- * @param[in] cpatt_data Compiled pattern data
- * @param[in] id The operator identifier used to get it's workspace.
- * @param[out] workspace Created.
+ * @param[in] tx Transaction
+ * @param[in] slot DFA workspace slot of the rule
+ * @param[out] workspace The rule's workspace
+ * @param[out] started Was the workspace already in use in @a tx?
  *
  * @returns
  *   - IB_OK on success.
  *   - IB_EALLOC on an allocation error.
+ *   - IB_EINVAL if @a slot was created after the transaction started.
  */
-static ib_status_t alloc_dfa_tx_data(ib_tx_t *tx,
-                                     const modpcre_cpat_data_t *cpatt_data,
-                                     const char *id,
-                                     dfa_workspace_t **workspace)
+static ib_status_t get_dfa_workspace(ib_tx_t *tx,
+                                     const modpcre_dfa_slot_t *slot,
+                                     int **workspace,
+                                     bool *started)
 {
-    assert(tx);
-    assert(tx->mp);
-    assert(id);
-    assert(workspace);
-
-    ib_hash_t *hash;
+    assert(tx != NULL);
+    assert(tx->mp != NULL);
+    assert(slot != NULL);
+    assert(workspace != NULL);
+    assert(started != NULL);
+
+    const modpcre_data_t *mod_data =
+        (const modpcre_data_t *)(IB_MODULE_STRUCT_PTR)->data;
+    modpcre_tx_data_t *tx_data;
     ib_status_t rc;
-    dfa_workspace_t *ws;
-    size_t size;
 
-    *workspace = NULL;
-    rc = get_or_create_rule_data_hash(tx, &hash);
+    rc = get_tx_data(tx, &tx_data);
     if (rc != IB_OK) {
         return rc;
     }
 
-    ws = (dfa_workspace_t *)ib_mpool_alloc(tx->mp, sizeof(*ws));
-    if (ws == NULL) {
-        return IB_EALLOC;
-    }
-
-    ws->wscount = cpatt_data->dfa_ws_size;
-    size = sizeof(*(ws->workspace)) * (ws->wscount);
-    ws->workspace = (int *)ib_mpool_alloc(tx->mp, size);
-    if (ws->workspace == NULL) {
-        return IB_EALLOC;
-    }
-
-    rc = ib_hash_set(hash, id, ws);
-    if (rc == IB_OK) {
-        *workspace = ws;
+    if (tx_data->dfa_slab == NULL) {
+        tx_data->dfa_slab = ib_mpool_alloc(
+            tx->mp, mod_data->dfa_ws_total * sizeof(*tx_data->dfa_slab));
+        tx_data->dfa_started = ib_mpool_calloc(
+            tx->mp, mod_data->num_dfa_slots, sizeof(*tx_data->dfa_started));
+        if ( (tx_data->dfa_slab == NULL) || (tx_data->dfa_started == NULL) ) {
+            tx_data->dfa_slab = NULL;
+            return IB_EALLOC;
+        }
+        tx_data->num_dfa_slots = mod_data->num_dfa_slots;
     }
 
-    return rc;
-}
-
-/**
- * Return the per-transaction data for use with the dfa operator.
- *
- * @param[in,out] tx Transaction to store the value in.
- * @param[in] id The operator identifier used to get it's workspace.
- * @param[out] workspace Retrieved.
- *
- * @returns
- *   - IB_OK on success.
- *   - IB_ENOENT if the structure does not exist. Call alloc_dfa_tx_data then.
- *   - IB_EALLOC on an allocation error.
- */
-static ib_status_t get_dfa_tx_data(ib_tx_t *tx,
-                                   const char *id,
-                                   dfa_workspace_t **workspace)
-{
-    assert(tx);
-    assert(tx->mp);
-    assert(id);
-    assert(workspace);
-
-    ib_hash_t *hash;
-    ib_status_t rc;
-
-    rc = get_or_create_rule_data_hash(tx, &hash);
-    if (rc != IB_OK) {
-        return rc;
+    if (slot->index >= tx_data->num_dfa_slots) {
+        return IB_EINVAL;
     }
 
-    rc = ib_hash_get(hash, workspace, id);
-    if (rc != IB_OK) {
-        *workspace = NULL;
-    }
+    *workspace = tx_data->dfa_slab + slot->offset;
+    *started = tx_data->dfa_started[slot->index];
+    tx_data->dfa_started[slot->index] = true;
 
-    return rc;
+    return IB_OK;
 }
 
 /**
@@ -1223,25 +1066,21 @@ static ib_status_t dfa_operator_execute(const ib_rule_exec_t *rule_exec,
     ib_status_t ib_rc;
     const int ovecsize = 3 * MATCH_MAX;
     modpcre_rule_data_t *rule_data = (modpcre_rule_data_t *)data;
+    modpcre_tx_data_t *tx_data;
     int *ovector;
     const char *subject;
     size_t subject_len;
     const ib_bytestr_t *bytestr;
-    dfa_workspace_t *dfa_workspace;
-    const char *id = ib_rule_id(rule_exec->rule);
+    int *dfa_workspace;
+    bool started;
     int options; /* dfa exec options. */
 
     assert(rule_data->cpdata->is_dfa == true);
-
-    ovector = (int *)malloc(ovecsize*sizeof(*ovector));
-    if (ovector==NULL) {
-        return IB_EALLOC;
-    }
+    assert(rule_data->dfa_slot != NULL);
 
     if (field->type == IB_FTYPE_NULSTR) {
         ib_rc = ib_field_value(field, ib_ftype_nulstr_out(&subject));
         if (ib_rc != IB_OK) {
-            free(ovector);
             return ib_rc;
         }
 
@@ -1250,7 +1089,6 @@ static ib_status_t dfa_operator_execute(const ib_rule_exec_t *rule_exec,
     else if (field->type == IB_FTYPE_BYTESTR) {
         ib_rc = ib_field_value(field, ib_ftype_bytestr_out(&bytestr));
         if (ib_rc != IB_OK) {
-            free(ovector);
             return ib_rc;
         }
 
@@ -1258,7 +1096,6 @@ static ib_status_t dfa_operator_execute(const ib_rule_exec_t *rule_exec,
         subject = (const char *) ib_bytestr_const_ptr(bytestr);
     }
     else {
-        free(ovector);
         return IB_EINVAL;
     }
 
@@ -1278,34 +1115,33 @@ static ib_status_t dfa_operator_execute(const ib_rule_exec_t *rule_exec,
         }
     }
 
-    /* Get the per-tx workspace data for this rule data id. */
-    ib_rc = get_dfa_tx_data(tx, id, &dfa_workspace);
-    if (ib_rc == IB_ENOENT) {
-        options = PCRE_PARTIAL_SOFT;
-
-        ib_rc = alloc_dfa_tx_data(tx, rule_data->cpdata, id, &dfa_workspace);
-        if (ib_rc != IB_OK) {
-            free(ovector);
-            ib_rule_log_error(rule_exec,
-                              "Error creating tx storage for dfa operator: %s",
-                              ib_status_to_string(ib_rc));
-            return ib_rc;
-        }
+    /* Get the per-tx match vector and the workspace for this rule id. */
+    ib_rc = get_tx_data(tx, &tx_data);
+    if (ib_rc != IB_OK) {
+        ib_rule_log_error(rule_exec,
+                          "Error creating tx storage for dfa operator: %s",
+                          ib_status_to_string(ib_rc));
+        return ib_rc;
+    }
+    ovector = tx_data->ovector;
 
-        ib_rule_log_debug(rule_exec, "Created DFA workspace at %p.",
-                          dfa_workspace);
+    ib_rc = get_dfa_workspace(tx, rule_data->dfa_slot,
+                              &dfa_workspace, &started);
+    if (ib_rc != IB_OK) {
+        ib_rule_log_error(rule_exec,
+                          "Error fetching dfa data for dfa operator: %s",
+                          ib_status_to_string(ib_rc));
+        return ib_rc;
     }
-    else if (ib_rc == IB_OK) {
+    if (started) {
         options = PCRE_PARTIAL_SOFT | PCRE_DFA_RESTART;
         ib_rule_log_debug(rule_exec, "Reusing existing DFA workspace %p.",
                           dfa_workspace);
     }
     else {
-        free(ovector);
-        ib_rule_log_error(rule_exec,
-                          "Error fetching dfa data for dfa operator: %s",
-                          ib_status_to_string(ib_rc));
-        return ib_rc;
+        options = PCRE_PARTIAL_SOFT;
+        ib_rule_log_debug(rule_exec, "Using new DFA workspace at %p.",
+                          dfa_workspace);
     }
 
     /* Actually do the DFA match. */
@@ -1317,8 +1153,8 @@ static ib_status_t dfa_operator_execute(const ib_rule_exec_t *rule_exec,
                             options,
                             ovector,
                             ovecsize,
-                            dfa_workspace->workspace,
-                            dfa_workspace->wscount);
+                            dfa_workspace,
+                            rule_data->dfa_slot->wscount);
 
     if (matches >= 0) {
         ib_rc = IB_OK;
@@ -1355,7 +1191,6 @@ static ib_status_t dfa_operator_execute(const ib_rule_exec_t *rule_exec,
         *result = 0;
     }
 
-    free(ovector);
     return ib_rc;
 }
 
@@ -1610,6 +1445,19 @@ static ib_status_t modpcre_init(ib_engine_t *ib,
     assert(ib != NULL);
     assert(m != NULL);
     ib_status_t rc;
+    modpcre_data_t *mod_data;
+
+    /* Create the module data, holding the DFA workspace slots. */
+    mod_data = ib_mpool_calloc(ib_engine_pool_main_get(ib),
+                               1, sizeof(*mod_data));
+    if (mod_data == NULL) {
+        return IB_EALLOC;
+    }
+    rc = ib_hash_create(&mod_data->dfa_slots, ib_engine_pool_main_get(ib));
+    if (rc != IB_OK) {
+        return rc;
+    }
+    m->data = mod_data;
 
     /* Register as a matcher provider. */
     rc = ib_provider_register(ib,
@@ -1632,7 +1480,8 @@ static ib_status_t modpcre_init(ib_engine_t *ib,
     /* Register operators. */
     ib_operator_register(ib,
                          "pcre",
-                         (IB_OP_FLAG_PHASE | IB_OP_FLAG_CAPTURE),
+                         (IB_OP_FLAG_PHASE | IB_OP_FLAG_CAPTURE |
+                          IB_OP_FLAG_REGEX),
                          pcre_operator_create,
                          NULL,
                          pcre_operator_destroy,
@@ -1643,7 +1492,8 @@ static ib_status_t modpcre_init(ib_engine_t *ib,
     /* An alias of pcre. The same callbacks are registered. */
     ib_operator_register(ib,
                          "rx",
-                         (IB_OP_FLAG_PHASE | IB_OP_FLAG_CAPTURE),
+                         (IB_OP_FLAG_PHASE | IB_OP_FLAG_CAPTURE |
+                          IB_OP_FLAG_REGEX),
                          pcre_operator_create,
                          NULL,
                          pcre_operator_destroy,
@@ -25,11 +25,10 @@
 #include <ironbee/collection_manager.h>
 #include <ironbee/module.h>
 #include <ironbee/mpool.h>
+#include <ironbee/pcre_cache.h>
 #include <ironbee/string.h>
 #include <ironbee/util.h>
 
-#include <pcre.h>
-
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -40,7 +39,7 @@
 
 /** File system persistence parameter parsing data */
 typedef struct {
-    const pcre   *key_pcre;          /**< Compiled PCRE to match key=[name] */
+    const ib_pcre_t *key_pcre;       /**< Compiled PCRE to match key=[name] */
     const ib_collection_manager_t *manager; /**< Collection manager */
 } mod_persist_param_data_t;
 static mod_persist_param_data_t mod_persist_param_data = { NULL, NULL };
@@ -155,9 +154,9 @@ static ib_status_t mod_persist_register_fn(
         const char *value;
         size_t      value_len;
 
-        pcre_rc = pcre_exec(mod_persist_param_data.key_pcre, NULL,
-                            nodestr, strlen(nodestr),
-                            0, 0, ovector, ovecsize);
+        pcre_rc = ib_pcre_exec(mod_persist_param_data.key_pcre,
+                               nodestr, strlen(nodestr),
+                               0, ovector, ovecsize);
         if (pcre_rc < 0) {
             return IB_DECLINED;
         }
@@ -502,8 +501,13 @@ static ib_status_t mod_persist_init(
     assert(module != NULL);
 
     const char *key_pattern = "^(?i)(key|expire)=(.+)$";
-    const int compile_flags = PCRE_DOTALL | PCRE_DOLLAR_ENDONLY;
-    pcre *compiled;
+    const ib_pcre_params_t params = {
+        PCRE_DOTALL | PCRE_DOLLAR_ENDONLY,  /* options */
+        true,                               /* study */
+        true,                               /* jit */
+        0, 0, 0, 0                          /* limits & JIT stack */
+    };
+    const ib_pcre_t *compiled;
     const char *error;
     int eoff;
     ib_status_t rc;
@@ -525,8 +529,9 @@ static ib_status_t mod_persist_init(
     }
 
     /* Compile the patterns */
-    compiled = pcre_compile(key_pattern, compile_flags, &error, &eoff, NULL);
-    if (compiled == NULL) {
+    rc = ib_pcre_cache_compile(ib_engine_pcre_cache(ib), key_pattern, &params,
+                               &compiled, &error, &eoff);
+    if (rc != IB_OK) {
         ib_log_error(ib, "Failed to compile pattern \"%s\"", key_pattern);
         return IB_EUNKNOWN;
     }
@@ -540,9 +545,8 @@ static ib_status_t mod_persist_fini(ib_engine_t *ib,
                                     ib_module_t *m,
                                     void *cbdata)
 {
-    if (mod_persist_param_data.key_pcre != NULL) {
-        pcre_free((pcre *)mod_persist_param_data.key_pcre);
-    }
+    /* The pattern is owned by the engine's pattern cache */
+    mod_persist_param_data.key_pcre = NULL;
 
     return IB_OK;
 }
@@ -620,8 +620,23 @@ static ib_status_t parse_modifier(ib_cfgparser_t *cp,
             return rc;
         }
         if (expand) {
+            ib_expand_template_t *tmpl;
+
+            rc = ib_data_expand_template_create(ib_rule_mpool(cp->ib),
+                                                value, strlen(value),
+                                                &tmpl);
+            if (rc != IB_OK) {
+                ib_cfg_log_error(cp, "Failed to compile message: %s",
+                                 ib_status_to_string(rc));
+                return rc;
+            }
+            rule->meta.msg_template = tmpl;
             rule->meta.flags |= IB_RULEMD_FLAG_EXPAND_MSG;
         }
+        else {
+            /* Don't keep the template of an earlier msg modifier. */
+            rule->meta.msg_template = NULL;
+        }
         return IB_OK;
     }
 
@@ -635,8 +650,23 @@ static ib_status_t parse_modifier(ib_cfgparser_t *cp,
             return rc;
         }
         if (expand) {
+            ib_expand_template_t *tmpl;
+
+            rc = ib_data_expand_template_create(ib_rule_mpool(cp->ib),
+                                                value, strlen(value),
+                                                &tmpl);
+            if (rc != IB_OK) {
+                ib_cfg_log_error(cp, "Failed to compile logdata: %s",
+                                 ib_status_to_string(rc));
+                return rc;
+            }
+            rule->meta.data_template = tmpl;
             rule->meta.flags |= IB_RULEMD_FLAG_EXPAND_DATA;
         }
+        else {
+            /* Don't keep the template of an earlier logdata modifier. */
+            rule->meta.data_template = NULL;
+        }
         return IB_OK;
     }
 
@@ -27,6 +27,8 @@
 #include "user_agent_private.h"
 
 #include <ironbee/bytestr.h>
+#include <ironbee/cfgmap.h>
+#include <ironbee/config.h>
 #include <ironbee/engine.h>
 #include <ironbee/field.h>
 #include <ironbee/hash.h>
@@ -43,6 +45,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 
 #include <sys/types.h>
 
@@ -55,6 +58,31 @@ IB_MODULE_DECLARE();
 
 static const modua_match_ruleset_t *modua_match_ruleset = NULL;
 
+/* Default number of user agents to cache */
+#define MODUA_CACHE_SIZE_DEFAULT 4096
+
+/**
+ * Module configuration.
+ *
+ * The cache is shared by the whole engine, so only the main context's
+ * configuration is used.
+ */
+typedef struct modua_cfg_t {
+    ib_num_t  cache_size;       /**< Agents to cache; 0 disables the cache */
+} modua_cfg_t;
+
+/* Instantiate a module global configuration. */
+static modua_cfg_t modua_global_cfg = {
+    MODUA_CACHE_SIZE_DEFAULT    /* cache_size */
+};
+
+/**
+ * Module data.
+ */
+typedef struct modua_data_t {
+    modua_cache_t *cache;       /**< Parsed agents, or NULL */
+} modua_data_t;
+
 /**
  * Skip spaces, return pointer to first non-space.
  *
@@ -368,14 +396,18 @@ static ib_status_t modua_store_field(ib_engine_t *ib,
  * Attempt to tokenize the user agent string passed in, storing the
  * result in the DPI associated with the transaction.
  *
+ * Parsed agents are cached, keyed by the agent string.
+ *
  * @param[in] ib IronBee object
  * @param[in,out] tx Transaction object
+ * @param[in] mod_data Module data
  * @param[in] bs Byte string containing the agent string
  *
  * @returns Status code
  */
 static ib_status_t modua_agent_fields(ib_engine_t *ib,
                                       ib_tx_t *tx,
+                                      const modua_data_t *mod_data,
                                       const ib_bytestr_t *bs)
 {
     const modua_match_rule_t *rule = NULL;
@@ -383,10 +415,12 @@ static ib_status_t modua_agent_fields(ib_engine_t *ib,
     char                     *product = NULL;
     char                     *platform = NULL;
     char                     *extra = NULL;
+    modua_agent_t             parsed;
     char                     *agent;
     char                     *buf;
     size_t                    len;
-    ib_status_t               rc;
+    size_t                    agent_len;
+    ib_status_t               rc = IB_ENOENT;
 
     /* Get the length of the byte string */
     len = ib_bytestr_length(bs);
@@ -412,15 +446,53 @@ static ib_status_t modua_agent_fields(ib_engine_t *ib,
         return IB_EALLOC;
     }
 
-    /* Parse the user agent string */
-    rc = modua_parse_uastring(buf, &product, &platform, &extra);
+    agent_len = strlen(agent);
+
+    /* Look for it in the cache */
+    if (mod_data->cache != NULL) {
+        rc = modua_cache_get(mod_data->cache, tx->mp,
+                             agent, agent_len, &parsed);
+        if (rc == IB_OK) {
+            ib_log_debug_tx(tx, "Found user agent in cache");
+            product = parsed.product;
+            platform = parsed.platform;
+            extra = parsed.extra;
+            rule = parsed.rule;
+        }
+        else if (rc != IB_ENOENT) {
+            ib_log_error_tx(tx, "Failed to look up user agent in cache: %s",
+                            ib_status_to_string(rc));
+            return rc;
+        }
+    }
+
     if (rc != IB_OK) {
-        ib_log_debug_tx(tx, "Failed to parse User Agent string '%s'", agent);
-        return IB_OK;
+        /* Parse the user agent string */
+        rc = modua_parse_uastring(buf, &product, &platform, &extra);
+        if (rc != IB_OK) {
+            ib_log_debug_tx(tx, "Failed to parse User Agent string '%s'",
+                            agent);
+            return IB_OK;
+        }
+
+        /* Categorize the parsed string */
+        rule = modua_match_cat_rules(product, platform, extra);
+
+        /* Cache it; the strings of the agent are all in buf */
+        if (mod_data->cache != NULL) {
+            parsed.product = product;
+            parsed.platform = platform;
+            parsed.extra = extra;
+            parsed.rule = rule;
+            rc = modua_cache_put(mod_data->cache, agent, agent_len,
+                                 buf, agent_len + 1, &parsed);
+            if (rc != IB_OK) {
+                ib_log_notice_tx(tx, "Failed to cache user agent: %s",
+                                 ib_status_to_string(rc));
+            }
+        }
     }
 
-    /* Categorize the parsed string */
-    rule = modua_match_cat_rules(product, platform, extra);
     if (rule == NULL) {
         ib_log_debug_tx(tx, "No rule matched" );
     }
@@ -488,7 +560,7 @@ static ib_status_t modua_agent_fields(ib_engine_t *ib,
  * @param[in] ib IronBee object
  * @param[in,out] tx Transaction.
  * @param[in] event Event type
- * @param[in] data Callback data (not used)
+ * @param[in] data Callback data (modua_data_t)
  *
  * @returns Status code
  */
@@ -501,6 +573,7 @@ static ib_status_t modua_user_agent(ib_engine_t *ib,
     assert(tx != NULL);
     assert(tx->data != NULL);
     assert(event == request_header_finished_event);
+    assert(data != NULL);
 
     ib_field_t         *req_agent = NULL;
     ib_status_t         rc = IB_OK;
@@ -549,7 +622,7 @@ static ib_status_t modua_user_agent(ib_engine_t *ib,
     }
 
     /* Finally, split it up & store the components */
-    rc = modua_agent_fields(ib, tx, bs);
+    rc = modua_agent_fields(ib, tx, (const modua_data_t *)data, bs);
     return rc;
 }
 
@@ -714,11 +787,20 @@ static ib_status_t modua_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
     ib_status_t  rc;
     modua_match_rule_t *failed_rule;
     unsigned int failed_frule_num;
+    modua_data_t *mod_data;
+
+    /* Create the module data; filled in when the main context closes */
+    mod_data = ib_mpool_calloc(ib_engine_pool_main_get(ib),
+                               1, sizeof(*mod_data));
+    if (mod_data == NULL) {
+        return IB_EALLOC;
+    }
+    m->data = mod_data;
 
     /* Register the user agent callback */
     rc = ib_hook_tx_register(ib, request_header_finished_event,
                              modua_user_agent,
-                             NULL);
+                             mod_data);
     if (rc != IB_OK) {
         ib_log_error(ib, "Hook register returned %s", ib_status_to_string(rc));
     }
@@ -753,19 +835,129 @@ static ib_status_t modua_init(ib_engine_t *ib, ib_module_t *m, void *cbdata)
     return IB_OK;
 }
 
+/**
+ * Called when a context is closed.
+ *
+ * Once the main context is closed, the configuration is complete: create
+ * the user agent cache, as configured.
+ *
+ * @param[in] ib IronBee object
+ * @param[in] m Module object
+ * @param[in] ctx Context being closed
+ * @param[in] cbdata (unused)
+ *
+ * @returns Status code
+ */
+static ib_status_t modua_ctx_close(ib_engine_t *ib,
+                                   ib_module_t *m,
+                                   ib_context_t *ctx,
+                                   void *cbdata)
+{
+    assert(ib != NULL);
+    assert(m != NULL);
+    assert(m->data != NULL);
+
+    modua_data_t *mod_data = (modua_data_t *)m->data;
+    ib_mpool_t *mp = ib_engine_pool_main_get(ib);
+    modua_cfg_t *config;
+    ib_status_t rc;
+
+    if (ctx != ib_context_main(ib)) {
+        return IB_OK;
+    }
+
+    rc = ib_context_module_config(ctx, m, (void *)&config);
+    if (rc != IB_OK) {
+        ib_log_error(ib, "Failed to get %s module configuration: %s",
+                     MODULE_NAME_STR, ib_status_to_string(rc));
+        return rc;
+    }
+
+    if ( (config->cache_size > 0) && (mod_data->cache == NULL) ) {
+        rc = modua_cache_create(mp, (size_t)config->cache_size,
+                                &mod_data->cache);
+        if (rc != IB_OK) {
+            ib_log_error(ib, "Failed to create user agent cache: %s",
+                         ib_status_to_string(rc));
+            return rc;
+        }
+        ib_log_debug(ib, "Caching up to %" PRId64 " user agents",
+                     config->cache_size);
+    }
+
+    return IB_OK;
+}
+
+/**
+ * Handle the UserAgentCacheSize directive.
+ *
+ * @param[in] cp Config parser
+ * @param[in] name Directive name
+ * @param[in] p1 Number of agents to cache; 0 disables the cache
+ * @param[in] cbdata Callback data (unused)
+ *
+ * @returns Status code
+ */
+static ib_status_t modua_dir_cache_size(ib_cfgparser_t *cp,
+                                        const char *name,
+                                        const char *p1,
+                                        void *cbdata)
+{
+    assert(cp != NULL);
+    assert(name != NULL);
+    assert(p1 != NULL);
+
+    ib_status_t rc;
+    ib_num_t value;
+
+    rc = ib_string_to_num(p1, 0, &value);
+    if ( (rc != IB_OK) || (value < 0) ) {
+        ib_cfg_log_error(cp, "Invalid value \"%s\" for \"%s\"", p1, name);
+        return IB_EINVAL;
+    }
+
+    rc = ib_context_set_num(ib_context_main(cp->ib),
+                            MODULE_NAME_STR ".cache_size",
+                            value);
+    if (rc != IB_OK) {
+        ib_cfg_log_error(cp, "Failed to set \"%s\": %s",
+                         name, ib_status_to_string(rc));
+    }
+    return rc;
+}
+
+static IB_CFGMAP_INIT_STRUCTURE(modua_config_map) = {
+    IB_CFGMAP_INIT_ENTRY(
+        MODULE_NAME_STR ".cache_size",
+        IB_FTYPE_NUM,
+        modua_cfg_t,
+        cache_size
+    ),
+    IB_CFGMAP_INIT_LAST
+};
+
+static IB_DIRMAP_INIT_STRUCTURE(modua_directive_map) = {
+    IB_DIRMAP_INIT_PARAM1(
+        "UserAgentCacheSize",
+        modua_dir_cache_size,
+        NULL
+    ),
+    IB_DIRMAP_INIT_LAST
+};
+
 IB_MODULE_INIT(
     IB_MODULE_HEADER_DEFAULTS,      /* Default metadata */
     MODULE_NAME_STR,                /* Module name */
-    IB_MODULE_CONFIG_NULL,          /* Global config data */
-    NULL,                           /* Module config map */
-    NULL,                           /* Module directive map */
+    IB_MODULE_CONFIG(&modua_global_cfg), /* Global config data */
+    modua_config_map,               /* Module config map */
+    modua_directive_map,            /* Module directive map */
     modua_init,                     /* Initialize function */
     NULL,                           /* Callback data */
     NULL,                           /* Finish function */
     NULL,                           /* Callback data */
     NULL,                           /* Context open function */
     NULL,                           /* Callback data */
-    NULL,                           /* Context close function */
+    modua_ctx_close,                /* Context close function */
     NULL,                           /* Callback data */
     NULL,                           /* Context destroy function */
     NULL                            /* Callback data */
@@ -0,0 +1,438 @@
+/*****************************************************************************
+ * Licensed to Qualys, Inc. (QUALYS) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * QUALYS licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ ****************************************************************************/
+
+/**
+ * @file
+ * @brief IronBee --- User Agent Cache
+ *
+ * A bounded LRU cache of parsed user agents.  The cache is split into
+ * shards by the hash of the user agent; each shard has its own lock, hash
+ * table and LRU list, and holds an equal part of the entries.  Entries are
+ * allocated with malloc() so that evicted entries can be freed.
+ */
+
+#include "user_agent_private.h"
+
+#include <ironbee/hash.h>
+#include <ironbee/lock.h>
+#include <ironbee/mpool.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Maximum number of shards */
+#define MODUA_CACHE_SHARDS 16
+
+/* Offset of a NULL string of an agent */
+#define MODUA_CACHE_NONE SIZE_MAX
+
+typedef struct modua_cache_entry_t modua_cache_entry_t;
+
+/* Cache entry.  The user agent is followed by the parsed buffer. */
+struct modua_cache_entry_t {
+    modua_cache_entry_t      *next;         /**< Next in hash bucket */
+    modua_cache_entry_t      *lru_prev;     /**< More recently used */
+    modua_cache_entry_t      *lru_next;     /**< Less recently used */
+    uint32_t                  hash;         /**< Hash of the user agent */
+    size_t                    ualen;        /**< Length of user agent */
+    size_t                    buflen;       /**< Length of parsed buffer */
+    size_t                    product;      /**< Offset of product */
+    size_t                    platform;     /**< Offset of platform */
+    size_t                    extra;        /**< Offset of extra */
+    const modua_match_rule_t *rule;         /**< Matching rule, or NULL */
+    char                      data[];       /**< User agent, then buffer */
+};
+
+/* Cache shard */
+typedef struct modua_cache_shard_t {
+    ib_lock_t                 lock;         /**< Protects the shard */
+    modua_cache_entry_t     **buckets;      /**< Hash buckets */
+    size_t                    mask;         /**< Number of buckets - 1 */
+    modua_cache_entry_t      *lru_head;     /**< Most recently used */
+    modua_cache_entry_t      *lru_tail;     /**< Least recently used */
+    size_t                    count;        /**< Number of entries */
+    size_t                    capacity;     /**< Maximum entries */
+} modua_cache_shard_t;
+
+struct modua_cache_t {
+    modua_cache_shard_t      *shards;       /**< Shards */
+    size_t                    num_shards;   /**< Shard count; a power of 2 */
+    uint32_t                  randomizer;   /**< Hash randomizer */
+};
+
+/**
+ * Get the shard of a hash value.
+ *
+ * The low bits pick the bucket in a shard, so use the high bits.
+ *
+ * @param[in] cache Cache
+ * @param[in] hash Hash value
+ *
+ * @returns Shard
+ */
+static modua_cache_shard_t *modua_cache_shard(const modua_cache_t *cache,
+                                              uint32_t hash)
+{
+    return &cache->shards[(hash >> 24) & (cache->num_shards - 1)];
+}
+
+/**
+ * Find an entry in a shard.  The shard must be locked.
+ *
+ * @param[in] shard Shard
+ * @param[in] hash Hash of @a ua
+ * @param[in] ua User agent
+ * @param[in] ualen Length of @a ua
+ *
+ * @returns Entry, or NULL if not found
+ */
+static modua_cache_entry_t *modua_cache_find(const modua_cache_shard_t *shard,
+                                             uint32_t hash,
+                                             const char *ua,
+                                             size_t ualen)
+{
+    modua_cache_entry_t *entry;
+
+    for (entry = shard->buckets[hash & shard->mask];
+         entry != NULL;
+         entry = entry->next)
+    {
+        if ( (entry->hash == hash) &&
+             (entry->ualen == ualen) &&
+             (memcmp(entry->data, ua, ualen) == 0) )
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Remove an entry from the LRU list of a shard.
+ *
+ * @param[in,out] shard Shard
+ * @param[in,out] entry Entry
+ */
+static void modua_cache_lru_unlink(modua_cache_shard_t *shard,
+                                   modua_cache_entry_t *entry)
+{
+    if (entry->lru_prev != NULL) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    }
+    else {
+        shard->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next != NULL) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    }
+    else {
+        shard->lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+/**
+ * Add an entry to the front of the LRU list of a shard.
+ *
+ * @param[in,out] shard Shard
+ * @param[in,out] entry Entry
+ */
+static void modua_cache_lru_push(modua_cache_shard_t *shard,
+                                 modua_cache_entry_t *entry)
+{
+    entry->lru_prev = NULL;
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head != NULL) {
+        shard->lru_head->lru_prev = entry;
+    }
+    else {
+        shard->lru_tail = entry;
+    }
+    shard->lru_head = entry;
+}
+
+/**
+ * Evict the least recently used entry of a shard.
+ *
+ * @param[in,out] shard Shard
+ */
+static void modua_cache_evict(modua_cache_shard_t *shard)
+{
+    modua_cache_entry_t *entry = shard->lru_tail;
+    modua_cache_entry_t **pnext;
+
+    assert(entry != NULL);
+
+    for (pnext = &shard->buckets[entry->hash & shard->mask];
+         *pnext != entry;
+         pnext = &(*pnext)->next)
+    {
+        assert(*pnext != NULL);
+    }
+    *pnext = entry->next;
+
+    modua_cache_lru_unlink(shard, entry);
+    --shard->count;
+    free(entry);
+}
+
+/**
+ * Destroy a cache: free all of its entries and its locks.
+ *
+ * @param[in] data Cache (modua_cache_t *)
+ */
+static void modua_cache_destroy(void *data)
+{
+    modua_cache_t *cache = (modua_cache_t *)data;
+    size_t n;
+
+    for (n = 0; n < cache->num_shards; ++n) {
+        modua_cache_shard_t *shard = &cache->shards[n];
+
+        while (shard->lru_tail != NULL) {
+            modua_cache_evict(shard);
+        }
+        ib_lock_destroy(&shard->lock);
+    }
+}
+
+/**
+ * Convert a string of an agent to an offset in its buffer.
+ *
+ * @param[in] buf Buffer
+ * @param[in] str String in @a buf, or NULL
+ *
+ * @returns Offset of @a str, or MODUA_CACHE_NONE
+ */
+static size_t modua_cache_offset(const char *buf, const char *str)
+{
+    return (str == NULL) ? MODUA_CACHE_NONE : (size_t)(str - buf);
+}
+
+/**
+ * Convert an offset in a buffer to a string of an agent.
+ *
+ * @param[in] buf Buffer
+ * @param[in] offset Offset from modua_cache_offset()
+ *
+ * @returns String, or NULL
+ */
+static char *modua_cache_string(char *buf, size_t offset)
+{
+    return (offset == MODUA_CACHE_NONE) ? NULL : buf + offset;
+}
+
+ib_status_t modua_cache_create(ib_mpool_t *mp,
+                               size_t size,
+                               modua_cache_t **cache)
+{
+    assert(mp != NULL);
+    assert(size > 0);
+    assert(cache != NULL);
+
+    modua_cache_t *new_cache;
+    size_t num_shards = 1;
+    size_t per_shard;
+    size_t extra;
+    size_t num_buckets = 1;
+    size_t n;
+    ib_status_t rc;
+
+    /* Don't make shards so small that the LRU order becomes meaningless. */
+    while ( (num_shards < MODUA_CACHE_SHARDS) && (num_shards * 64 < size) ) {
+        num_shards *= 2;
+    }
+    per_shard = size / num_shards;
+    extra = size % num_shards;
+    while (num_buckets < per_shard + 1) {
+        num_buckets *= 2;
+    }
+
+    new_cache = ib_mpool_calloc(mp, 1, sizeof(*new_cache));
+    if (new_cache == NULL) {
+        return IB_EALLOC;
+    }
+    new_cache->shards = ib_mpool_calloc(mp, num_shards,
+                                        sizeof(*new_cache->shards));
+    if (new_cache->shards == NULL) {
+        return IB_EALLOC;
+    }
+    new_cache->randomizer = (uint32_t)clock();
+
+    for (n = 0; n < num_shards; ++n) {
+        modua_cache_shard_t *shard = &new_cache->shards[n];
+
+        shard->buckets = ib_mpool_calloc(mp, num_buckets,
+                                         sizeof(*shard->buckets));
+        if (shard->buckets == NULL) {
+            return IB_EALLOC;
+        }
+        shard->mask = num_buckets - 1;
+        shard->capacity = per_shard + ((n < extra) ? 1 : 0);
+
+        rc = ib_lock_init(&shard->lock);
+        if (rc != IB_OK) {
+            while (n-- > 0) {
+                ib_lock_destroy(&new_cache->shards[n].lock);
+            }
+            return IB_EUNKNOWN;
+        }
+        new_cache->num_shards = n + 1;
+    }
+
+    rc = ib_mpool_cleanup_register(mp, modua_cache_destroy, new_cache);
+    if (rc != IB_OK) {
+        modua_cache_destroy(new_cache);
+        return rc;
+    }
+
+    *cache = new_cache;
+    return IB_OK;
+}
+
+ib_status_t modua_cache_get(modua_cache_t *cache,
+                            ib_mpool_t *mp,
+                            const char *ua,
+                            size_t ualen,
+                            modua_agent_t *agent)
+{
+    assert(cache != NULL);
+    assert(mp != NULL);
+    assert(ua != NULL);
+    assert(agent != NULL);
+
+    uint32_t hash = ib_hashfunc_fast(ua, ualen, cache->randomizer);
+    modua_cache_shard_t *shard = modua_cache_shard(cache, hash);
+    modua_cache_entry_t *entry;
+    ib_status_t rc;
+    char *buf;
+
+    rc = ib_lock_lock(&shard->lock);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    entry = modua_cache_find(shard, hash, ua, ualen);
+    if (entry == NULL) {
+        ib_lock_unlock(&shard->lock);
+        return IB_ENOENT;
+    }
+
+    /* Copy it out while it can't be evicted. */
+    buf = ib_mpool_memdup(mp, entry->data + ualen, entry->buflen);
+    if (buf == NULL) {
+        ib_lock_unlock(&shard->lock);
+        return IB_EALLOC;
+    }
+    agent->product = modua_cache_string(buf, entry->product);
+    agent->platform = modua_cache_string(buf, entry->platform);
+    agent->extra = modua_cache_string(buf, entry->extra);
+    agent->rule = entry->rule;
+
+    if (shard->lru_head != entry) {
+        modua_cache_lru_unlink(shard, entry);
+        modua_cache_lru_push(shard, entry);
+    }
+
+    ib_lock_unlock(&shard->lock);
+    return IB_OK;
+}
+
+ib_status_t modua_cache_put(modua_cache_t *cache,
+                            const char *ua,
+                            size_t ualen,
+                            const char *buf,
+                            size_t buflen,
+                            const modua_agent_t *agent)
+{
+    assert(cache != NULL);
+    assert(ua != NULL);
+    assert(buf != NULL);
+    assert(agent != NULL);
+
+    uint32_t hash = ib_hashfunc_fast(ua, ualen, cache->randomizer);
+    modua_cache_shard_t *shard = modua_cache_shard(cache, hash);
+    modua_cache_entry_t *entry;
+    ib_status_t rc;
+
+    /* Build the entry before taking the lock. */
+    entry = malloc(sizeof(*entry) + ualen + buflen);
+    if (entry == NULL) {
+        return IB_EALLOC;
+    }
+    entry->hash = hash;
+    entry->ualen = ualen;
+    entry->buflen = buflen;
+    entry->product = modua_cache_offset(buf, agent->product);
+    entry->platform = modua_cache_offset(buf, agent->platform);
+    entry->extra = modua_cache_offset(buf, agent->extra);
+    entry->rule = agent->rule;
+    memcpy(entry->data, ua, ualen);
+    memcpy(entry->data + ualen, buf, buflen);
+
+    rc = ib_lock_lock(&shard->lock);
+    if (rc != IB_OK) {
+        free(entry);
+        return rc;
+    }
+
+    /* Another transaction may have added it since our lookup. */
+    if (modua_cache_find(shard, hash, ua, ualen) != NULL) {
+        ib_lock_unlock(&shard->lock);
+        free(entry);
+        return IB_OK;
+    }
+
+    if (shard->count >= shard->capacity) {
+        modua_cache_evict(shard);
+    }
+    entry->next = shard->buckets[hash & shard->mask];
+    shard->buckets[hash & shard->mask] = entry;
+    modua_cache_lru_push(shard, entry);
+    ++shard->count;
+
+    ib_lock_unlock(&shard->lock);
+    return IB_OK;
+}
+
+size_t modua_cache_num_shards(const modua_cache_t *cache)
+{
+    assert(cache != NULL);
+
+    return cache->num_shards;
+}
+
+size_t modua_cache_count(modua_cache_t *cache)
+{
+    assert(cache != NULL);
+
+    size_t count = 0;
+    size_t n;
+
+    for (n = 0; n < cache->num_shards; ++n) {
+        modua_cache_shard_t *shard = &cache->shards[n];
+
+        if (ib_lock_lock(&shard->lock) == IB_OK) {
+            count += shard->count;
+            ib_lock_unlock(&shard->lock);
+        }
+    }
+    return count;
+}
@@ -25,6 +25,7 @@
  * @author Nick LeRoy <nleroy@qualys.com>
  */
 
+#include <ironbee/mpool.h>
 #include <ironbee/types.h>
 
 #include <string.h> /* size_t */
@@ -109,4 +110,102 @@ ib_status_t modua_ruleset_init(modua_match_rule_t **failed_rule,
  */
 const modua_match_ruleset_t *modua_ruleset_get(void);
 
+/* Parsed and categorized user agent */
+typedef struct modua_agent_s {
+    char                     *product;   /**< Product, or NULL */
+    char                     *platform;  /**< Platform, or NULL */
+    char                     *extra;     /**< Extra, or NULL */
+    const modua_match_rule_t *rule;      /**< Matching rule, or NULL */
+} modua_agent_t;
+
+/**
+ * Cache of parsed user agents, keyed by the raw user agent string.
+ *
+ * The cache holds a bounded number of agents, evicting the least recently
+ * used.  It is split into independently locked shards, so that it may be
+ * shared by all transactions.
+ */
+typedef struct modua_cache_t modua_cache_t;
+
+/**
+ * Create a cache.
+ *
+ * The cache is destroyed with @a mp.
+ *
+ * @param[in] mp Memory pool
+ * @param[in] size Maximum number of agents to hold (non-zero)
+ * @param[out] cache New cache
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC on allocation failure.
+ *   - IB_EUNKNOWN if a lock cannot be created.
+ */
+ib_status_t modua_cache_create(ib_mpool_t *mp,
+                               size_t size,
+                               modua_cache_t **cache);
+
+/**
+ * Look up a user agent in the cache.
+ *
+ * On a hit, the parsed agent is copied into @a mp.
+ *
+ * @param[in] cache Cache
+ * @param[in] mp Memory pool for @a agent's strings
+ * @param[in] ua Raw user agent string
+ * @param[in] ualen Length of @a ua
+ * @param[out] agent Parsed agent
+ *
+ * @returns
+ *   - IB_OK on a hit.
+ *   - IB_ENOENT on a miss.
+ *   - IB_EALLOC on allocation failure.
+ */
+ib_status_t modua_cache_get(modua_cache_t *cache,
+                            ib_mpool_t *mp,
+                            const char *ua,
+                            size_t ualen,
+                            modua_agent_t *agent);
+
+/**
+ * Add a parsed user agent to the cache.
+ *
+ * The strings of @a agent must all be in @a buf, which is copied.
+ *
+ * @param[in] cache Cache
+ * @param[in] ua Raw user agent string
+ * @param[in] ualen Length of @a ua
+ * @param[in] buf Buffer holding the strings of @a agent
+ * @param[in] buflen Length of @a buf
+ * @param[in] agent Parsed agent
+ *
+ * @returns
+ *   - IB_OK on success.
+ *   - IB_EALLOC on allocation failure.
+ */
+ib_status_t modua_cache_put(modua_cache_t *cache,
+                            const char *ua,
+                            size_t ualen,
+                            const char *buf,
+                            size_t buflen,
+                            const modua_agent_t *agent);
+
+/**
+ * Get the number of shards of a cache.
+ *
+ * @param[in] cache Cache
+ *
+ * @returns Number of shards
+ */
+size_t modua_cache_num_shards(const modua_cache_t *cache);
+
+/**
+ * Get the number of user agents in a cache.
+ *
+ * @param[in] cache Cache
+ *
+ * @returns Number of user agents held
+ */
+size_t modua_cache_count(modua_cache_t *cache);
+
 #endif /* _IB_MODULE_USER_AGENT_PRIVATE_H_ */
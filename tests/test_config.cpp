@@ -116,3 +116,51 @@ TEST_F(TestConfig, unloadable_module)
 {
     ASSERT_NE(IB_OK, config("LoadModule doesnt_exist.so", 1));
 }
+
+TEST_F(TestConfig, mempoolpolicy)
+{
+    const ib_mpool_policy_t *policy;
+
+    ASSERT_IB_OK(
+        config("MemPoolPolicy tx PageSize=16384 LargeThreshold=8192"));
+    policy = ib_engine_pool_policy_get(ib_engine, IB_ENGINE_POOL_TX);
+    ASSERT_STREQ("tx", policy->role);
+    ASSERT_EQ(16384U, policy->pagesize);
+    ASSERT_EQ(8192U, policy->large_threshold);
+    ASSERT_FALSE(policy->huge_pages);
+
+    ASSERT_IB_OK(config("MemPoolPolicy conn HugePages=On"));
+    policy = ib_engine_pool_policy_get(ib_engine, IB_ENGINE_POOL_CONN);
+    ASSERT_STREQ("conn", policy->role);
+    ASSERT_EQ(0U, policy->pagesize);
+    ASSERT_TRUE(policy->huge_pages);
+}
+
+TEST_F(TestConfig, mempoolpolicy_invalid)
+{
+    ASSERT_NE(IB_OK, config("MemPoolPolicy"));
+    ASSERT_NE(IB_OK, config("MemPoolPolicy engine PageSize=16384"));
+    ASSERT_NE(IB_OK, config("MemPoolPolicy tx PageSize"));
+    ASSERT_NE(IB_OK, config("MemPoolPolicy tx PageSize=big"));
+    ASSERT_NE(IB_OK, config("MemPoolPolicy tx HugePages=maybe"));
+    ASSERT_NE(IB_OK, config("MemPoolPolicy tx Bogus=1", 1));
+}
+
+TEST_F(TestConfig, auditlogasync)
+{
+    ASSERT_IB_OK(config("AuditLogAsync On"));
+    ASSERT_IB_OK(config("AuditLogAsync On QueueSize=100 Overflow=Drop"));
+    ASSERT_IB_OK(config("AuditLogAsync on overflow=block sync=on"));
+    ASSERT_IB_OK(config("AuditLogAsync Off"));
+}
+
+TEST_F(TestConfig, auditlogasync_invalid)
+{
+    ASSERT_NE(IB_OK, config("AuditLogAsync"));
+    ASSERT_NE(IB_OK, config("AuditLogAsync Maybe"));
+    ASSERT_NE(IB_OK, config("AuditLogAsync On QueueSize"));
+    ASSERT_NE(IB_OK, config("AuditLogAsync On QueueSize=0"));
+    ASSERT_NE(IB_OK, config("AuditLogAsync On Overflow=Spill"));
+    ASSERT_NE(IB_OK, config("AuditLogAsync On Sync=Maybe"));
+    ASSERT_NE(IB_OK, config("AuditLogAsync On Bogus=1", 1));
+}
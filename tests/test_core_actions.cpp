@@ -129,3 +129,18 @@ TEST_F(CoreActionTest, integration) {
     ib_field_value(f, ib_ftype_num_out(&n));
     ASSERT_EQ(1, n);
 }
+
+/**
+ * Rules are only skipped while none of their target fields exist.
+ */
+TEST_F(CoreActionTest, targetIndex) {
+    ib_field_t *f;
+    ib_num_t n;
+
+    ASSERT_EQ(IB_ENOENT, ib_data_get(ib_conn->tx->data, "r1", &f));
+
+    ASSERT_EQ(IB_OK, ib_data_get(ib_conn->tx->data, "r3", &f));
+    ASSERT_EQ(IB_FTYPE_NUM, f->type);
+    ib_field_value(f, ib_ftype_num_out(&n));
+    ASSERT_EQ(1, n);
+}
@@ -0,0 +1,271 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee --- Core context selection tests
+//////////////////////////////////////////////////////////////////////////////
+
+#include "gtest/gtest.h"
+#include "base_fixture.h"
+
+#include <ironbee/clock.h>
+#include <ironbee/context_selection.h>
+#include <ironbee/site.h>
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+class CoreContextSelectionTest : public BaseFixture
+{
+public:
+    /**
+     * Start a configuration.
+     */
+    static void configStart(std::ostringstream &config)
+    {
+        config << "LogLevel 1\n"
+               << "SensorId B9C1B52B-C24A-4309-B9F9-0EF4CD577A3E\n"
+               << "SensorName UnitTesting\n"
+               << "SensorHostname unit-testing.sensor.tld\n"
+               << "AuditEngine Off\n";
+    }
+
+    /**
+     * Add a site with a generated site ID.
+     */
+    static void configSite(std::ostringstream &config,
+                           size_t num,
+                           const std::string &body)
+    {
+        char id[64];
+
+        snprintf(id, sizeof(id), "AAAABBBB-1111-2222-3333-%012zu", num);
+        config << "<Site site" << num << ">\n"
+               << "SiteId " << id << "\n"
+               << body
+               << "</Site>\n";
+    }
+
+    /**
+     * Select the context for a transaction.
+     */
+    ib_context_t *select(ib_conn_t *conn,
+                         const char *hostname,
+                         const char *path)
+    {
+        ib_tx_t *tx;
+        ib_context_t *ctx;
+
+        if (ib_tx_create(&tx, conn, NULL) != IB_OK) {
+            throw std::runtime_error("Failed to create transaction.");
+        }
+        tx->hostname = hostname;
+        tx->path = path;
+        if (ib_ctxsel_select_context(ib_engine, conn, tx, &ctx) != IB_OK) {
+            throw std::runtime_error("Failed to select context.");
+        }
+        ib_tx_destroy(tx);
+        return ctx;
+    }
+
+    /**
+     * Describe a context as "site path", or "main".
+     */
+    static std::string describe(const ib_context_t *ctx)
+    {
+        const ib_site_t *site;
+        const ib_site_location_t *location;
+
+        if ( (ib_context_site_get(ctx, &site) != IB_OK) ||
+             (site == NULL) )
+        {
+            return "main";
+        }
+        if ( (ib_context_location_get(ctx, &location) != IB_OK) ||
+             (location == NULL) )
+        {
+            return site->name;
+        }
+        return std::string(site->name) + " " + location->path;
+    }
+};
+
+TEST_F(CoreContextSelectionTest, hosts)
+{
+    std::ostringstream config;
+    ib_conn_t *conn;
+
+    configStart(config);
+    configSite(config, 0, "Hostname www.example.com\n");
+    configSite(config, 1, "Hostname *.example.com\n"
+                          "Hostname example.org\n");
+    configSite(config, 2, "Hostname *example.net\n");
+    configSite(config, 3, "Hostname *\n");
+    configureIronBeeByString(config.str());
+    conn = buildIronBeeConnection();
+
+    ASSERT_EQ("site0 /", describe(select(conn, "www.example.com", "/")));
+    ASSERT_EQ("site0 /", describe(select(conn, "WWW.Example.COM", "/")));
+    ASSERT_EQ("site1 /", describe(select(conn, "a.b.example.com", "/")));
+    ASSERT_EQ("site3 /", describe(select(conn, "example.com", "/")));
+    ASSERT_EQ("site1 /", describe(select(conn, "EXAMPLE.org", "/")));
+    ASSERT_EQ("site3 /", describe(select(conn, "www.example.org", "/")));
+    ASSERT_EQ("site2 /", describe(select(conn, "badexample.net", "/")));
+    ASSERT_EQ("site2 /", describe(select(conn, "example.net", "/")));
+    ASSERT_EQ("site3 /", describe(select(conn, "", "/")));
+
+    ib_conn_destroy(conn);
+}
+
+TEST_F(CoreContextSelectionTest, order)
+{
+    std::ostringstream config;
+    ib_conn_t *conn;
+
+    /* The first matching site wins, even if a later one matches better. */
+    configStart(config);
+    configSite(config, 0, "Hostname *.example.com\n"
+                          "<Location /api>\n</Location>\n");
+    configSite(config, 1, "Hostname www.example.com\n");
+    configSite(config, 2, "Hostname www.example.com\n"
+                          "Service *:8080\n");
+    configureIronBeeByString(config.str());
+    conn = buildIronBeeConnection();
+
+    ASSERT_EQ("site0 /", describe(select(conn, "www.example.com", "/")));
+    ASSERT_EQ("site0 /api",
+              describe(select(conn, "www.example.com", "/api/v1")));
+    ASSERT_EQ("main", describe(select(conn, "www.example.org", "/")));
+
+    ib_conn_destroy(conn);
+}
+
+TEST_F(CoreContextSelectionTest, locations)
+{
+    std::ostringstream config;
+    ib_conn_t *conn;
+
+    /* The first matching location wins, not the longest. */
+    configStart(config);
+    configSite(config, 0, "Hostname www.example.com\n"
+                          "<Location /a/b>\n</Location>\n"
+                          "<Location /a>\n</Location>\n"
+                          "<Location /a/b/c>\n</Location>\n"
+                          "<Location /x>\n</Location>\n");
+    configureIronBeeByString(config.str());
+    conn = buildIronBeeConnection();
+
+    ASSERT_EQ("site0 /a/b",
+              describe(select(conn, "www.example.com", "/a/b")));
+    ASSERT_EQ("site0 /a/b",
+              describe(select(conn, "www.example.com", "/a/b/c/d")));
+    ASSERT_EQ("site0 /a", describe(select(conn, "www.example.com", "/abc")));
+    ASSERT_EQ("site0 /x", describe(select(conn, "www.example.com", "/xyz")));
+    ASSERT_EQ("site0 /", describe(select(conn, "www.example.com", "/b")));
+    ASSERT_EQ("site0 /", describe(select(conn, "www.example.com", "")));
+
+    ib_conn_destroy(conn);
+}
+
+TEST_F(CoreContextSelectionTest, services)
+{
+    std::ostringstream config;
+    ib_conn_t *conn;
+    ib_context_t *ctx;
+
+    configStart(config);
+    configSite(config, 0, "Hostname *\n"
+                          "Service *:8080\n");
+    configSite(config, 1, "Hostname www.example.com\n"
+                          "Service 1.0.0.1:80\n");
+    configSite(config, 2, "Hostname *\n");
+    configureIronBeeByString(config.str());
+    conn = buildIronBeeConnection();
+
+    ASSERT_IB_OK(ib_ctxsel_select_context(ib_engine, conn, NULL, &ctx));
+    ASSERT_EQ("site1", describe(ctx));
+    ASSERT_EQ("site1 /", describe(select(conn, "www.example.com", "/")));
+    ASSERT_EQ("site2 /", describe(select(conn, "example.com", "/")));
+
+    conn->local_port = 8080;
+    ASSERT_IB_OK(ib_ctxsel_select_context(ib_engine, conn, NULL, &ctx));
+    ASSERT_EQ("site0", describe(ctx));
+    ASSERT_EQ("site0 /", describe(select(conn, "www.example.com", "/")));
+
+    ib_conn_destroy(conn);
+}
+
+/**
+ * Selection micro-benchmark: the time to select a site should not grow
+ * with the number of sites.
+ */
+TEST_F(CoreContextSelectionTest, selectionBenchmark)
+{
+    const size_t num_sites = 3000;
+    const size_t iterations = 20000;
+    std::ostringstream config;
+    ib_conn_t *conn;
+    ib_tx_t *tx;
+    ib_context_t *ctx = NULL;
+    ib_time_t first_usec;
+    ib_time_t last_usec;
+    ib_time_t start;
+    char last_host[64];
+    char last_site[64];
+
+    configStart(config);
+    for (size_t n = 0;  n < num_sites;  ++n) {
+        std::ostringstream body;
+
+        body << "Hostname site" << n << ".example.com\n"
+             << "Hostname *.site" << n << ".example.com\n"
+             << "<Location /api>\n</Location>\n";
+        configSite(config, n, body.str());
+    }
+    configureIronBeeByString(config.str());
+    conn = buildIronBeeConnection();
+    ASSERT_IB_OK(ib_tx_create(&tx, conn, NULL));
+    tx->path = "/api/v1/items";
+
+    tx->hostname = "www.site0.example.com";
+    start = ib_clock_get_time();
+    for (size_t i = 0;  i < iterations;  ++i) {
+        ASSERT_IB_OK(ib_ctxsel_select_context(ib_engine, conn, tx, &ctx));
+    }
+    first_usec = ib_clock_get_time() - start;
+    ASSERT_EQ("site0 /api", describe(ctx));
+
+    snprintf(last_host, sizeof(last_host),
+             "www.site%zu.example.com", num_sites - 1);
+    snprintf(last_site, sizeof(last_site), "site%zu /api", num_sites - 1);
+    tx->hostname = last_host;
+    start = ib_clock_get_time();
+    for (size_t i = 0;  i < iterations;  ++i) {
+        ASSERT_IB_OK(ib_ctxsel_select_context(ib_engine, conn, tx, &ctx));
+    }
+    last_usec = ib_clock_get_time() - start;
+    ASSERT_EQ(last_site, describe(ctx));
+
+    std::cout << num_sites << " sites, " << iterations << " selections:"
+              << " first site " << first_usec << "us,"
+              << " last site " << last_usec << "us" << std::endl;
+
+    ib_tx_destroy(tx);
+    ib_conn_destroy(conn);
+}
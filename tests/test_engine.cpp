@@ -29,13 +29,18 @@
 #include <ironbee/field.h>
 #include <ironbee/state_notify.h>
 #include <ironbee/bytestr.h>
+#include <ironbee/core.h>
 #include <ironbee/transformation.h>
 #include <ironbee/provider.h>
+#include <ironbee/pcre_cache.h>
 
 #include "config-parser.h"
 #include "ibtest_util.hpp"
 #include "engine_private.h"
 
+#include <cctype>
+#include <string>
+
 /// @test Test ironbee library - ib_engine_create()
 TEST(TestIronBee, test_engine_create_null_server)
 {
@@ -399,3 +404,442 @@ TEST(TestIronBee, test_data_pcre)
 
     ibtest_engine_destroy(ib);
 }
+
+// Test pattern matching a field with a pre-compiled filter.
+TEST(TestIronBee, test_data_filter_cache)
+{
+    ib_engine_t *ib;
+    ib_data_t *data;
+    ib_data_filter_cache_t *cache;
+    ib_field_t *list_field;
+    ib_field_t *out_field;
+    ib_list_t *list;
+    ib_list_t *out_list;
+    ib_field_t *field1;
+    ib_field_t *field2;
+    ib_num_t num1 = 1;
+    ib_num_t num2 = 2;
+    ib_pcre_stats_t before;
+    ib_pcre_stats_t after;
+
+    ibtest_engine_create(&ib);
+
+    ASSERT_IB_OK(
+        ib_data_filter_cache_create(ib_engine_pool_main_get(ib),
+                                    ib_engine_pcre_cache(ib),
+                                    &cache));
+    ASSERT_TRUE(cache);
+
+    /* Names without a pattern are accepted and ignored. */
+    ASSERT_IB_OK(ib_data_filter_cache_add(cache, IB_FIELD_NAME("ARGV")));
+    ASSERT_IB_OK(ib_data_filter_cache_add(cache, IB_FIELD_NAME("ARGV:foo")));
+
+    /* Bad patterns are rejected. */
+    ASSERT_EQ(IB_EINVAL,
+              ib_data_filter_cache_add(cache, IB_FIELD_NAME("ARGV:/(/")));
+    ASSERT_EQ(IB_EINVAL,
+              ib_data_filter_cache_add(cache, IB_FIELD_NAME("ARGV/:x/")));
+
+    ASSERT_IB_OK(ib_data_filter_cache_add(cache, IB_FIELD_NAME("ARGV:/2$/")));
+
+    ASSERT_EQ(IB_OK, ib_data_create(ib_engine_pool_main_get(ib), &data));
+    ASSERT_TRUE(data);
+    ib_data_set_filter_cache(data, cache);
+
+    ASSERT_IB_OK(
+        ib_field_create(&field1, ib_data_pool(data), "field1", 6, IB_FTYPE_NUM, &num1));
+    ASSERT_IB_OK(
+        ib_field_create(&field2, ib_data_pool(data), "field2", 6, IB_FTYPE_NUM, &num2));
+    ASSERT_IB_OK(ib_data_add_list(data, "ARGV", &list_field));
+    ASSERT_IB_OK(ib_field_value(list_field, &list));
+    ASSERT_IB_OK(ib_list_push(list, field1));
+    ASSERT_IB_OK(ib_list_push(list, field2));
+
+    /* Cached pattern. */
+    ASSERT_IB_OK(ib_data_get(data, "ARGV:/2$/", &out_field));
+    ASSERT_IB_OK(ib_field_value(out_field, &out_list));
+    ASSERT_EQ(1U, IB_LIST_ELEMENTS(out_list));
+    out_field = (ib_field_t *) IB_LIST_FIRST(out_list)->data;
+    ASSERT_FALSE(memcmp(out_field->name, field2->name, field2->nlen));
+
+    /* Uncached pattern still works, and is not added to the shared cache. */
+    ib_pcre_cache_stats(ib_engine_pcre_cache(ib), &before);
+    ASSERT_IB_OK(ib_data_get(data, "ARGV:/field/", &out_field));
+    ASSERT_IB_OK(ib_field_value(out_field, &out_list));
+    ASSERT_EQ(2U, IB_LIST_ELEMENTS(out_list));
+    ib_pcre_cache_stats(ib_engine_pcre_cache(ib), &after);
+    ASSERT_EQ(before.lookups, after.lookups);
+    ASSERT_EQ(before.patterns, after.patterns);
+
+    ibtest_engine_destroy(ib);
+}
+
+TEST(TestIronBee, test_data_field_id)
+{
+    ib_engine_t *ib;
+    ib_data_t *data;
+    ib_field_t *list_field;
+    ib_field_t *num_field;
+    ib_field_t *out_field;
+    ib_list_t *list;
+    ib_list_t *out_list;
+    ib_field_t *field1;
+    ib_field_t *field2;
+    ib_num_t num1 = 1;
+    ib_num_t num2 = 2;
+    ib_data_field_id_t id;
+
+    ibtest_engine_create(&ib);
+
+    /* Core names resolve regardless of case and list filters. */
+    ASSERT_EQ(IB_DATA_FIELD_ID_ARGS, ib_data_field_id(IB_FIELD_NAME("ARGS")));
+    ASSERT_EQ(IB_DATA_FIELD_ID_ARGS, ib_data_field_id(IB_FIELD_NAME("args")));
+    ASSERT_EQ(IB_DATA_FIELD_ID_ARGS,
+              ib_data_field_id(IB_FIELD_NAME("ARGS:/^a/")));
+    ASSERT_EQ(IB_DATA_FIELD_ID_REQUEST_HEADERS,
+              ib_data_field_id(IB_FIELD_NAME("REQUEST_HEADERS:Host")));
+    ASSERT_EQ(IB_DATA_FIELD_ID_REMOTE_PORT,
+              ib_data_field_id(IB_FIELD_NAME("remote_port")));
+    ASSERT_EQ(IB_DATA_FIELD_ID_NONE,
+              ib_data_field_id(IB_FIELD_NAME("ARGSX")));
+    ASSERT_EQ(IB_DATA_FIELD_ID_NONE,
+              ib_data_field_id(IB_FIELD_NAME("request")));
+    ASSERT_EQ(IB_DATA_FIELD_ID_NONE,
+              ib_data_field_id(IB_FIELD_NAME("request_uri_pork")));
+
+    ASSERT_EQ(IB_OK, ib_data_create(ib_engine_pool_main_get(ib), &data));
+    ASSERT_TRUE(data);
+
+    /* Not yet added. */
+    id = ib_data_field_id(IB_FIELD_NAME("ARGS"));
+    ASSERT_EQ(IB_ENOENT,
+              ib_data_get_id(data, id, IB_FIELD_NAME("ARGS"), &out_field));
+
+    ASSERT_IB_OK(
+        ib_field_create(&field1, ib_data_pool(data), "field1", 6, IB_FTYPE_NUM, &num1));
+    ASSERT_IB_OK(
+        ib_field_create(&field2, ib_data_pool(data), "field2", 6, IB_FTYPE_NUM, &num2));
+    ASSERT_IB_OK(ib_data_add_list(data, "args", &list_field));
+    ASSERT_IB_OK(ib_field_value(list_field, &list));
+    ASSERT_IB_OK(ib_list_push(list, field1));
+    ASSERT_IB_OK(ib_list_push(list, field2));
+
+    /* Same field by ID as by name. */
+    ASSERT_IB_OK(ib_data_get_id(data, id, IB_FIELD_NAME("ARGS"), &out_field));
+    ASSERT_EQ(list_field, out_field);
+
+    /* Subfields and filters through the ID. */
+    id = ib_data_field_id(IB_FIELD_NAME("ARGS:field1"));
+    ASSERT_IB_OK(
+        ib_data_get_id(data, id, IB_FIELD_NAME("ARGS:field1"), &out_field));
+    ASSERT_IB_OK(ib_field_value(out_field, &out_list));
+    ASSERT_EQ(1U, IB_LIST_ELEMENTS(out_list));
+    ASSERT_EQ(field1, IB_LIST_FIRST(out_list)->data);
+
+    id = ib_data_field_id(IB_FIELD_NAME("ARGS:/2$/"));
+    ASSERT_IB_OK(
+        ib_data_get_id(data, id, IB_FIELD_NAME("ARGS:/2$/"), &out_field));
+    ASSERT_IB_OK(ib_field_value(out_field, &out_list));
+    ASSERT_EQ(1U, IB_LIST_ELEMENTS(out_list));
+    ASSERT_EQ(field2, IB_LIST_FIRST(out_list)->data);
+
+    /* Replacing and removing are seen through the ID. */
+    id = IB_DATA_FIELD_ID_FIELD_NAME;
+    ASSERT_IB_OK(ib_data_add_num(data, "FIELD_NAME", 5, &num_field));
+    ASSERT_IB_OK(
+        ib_data_get_id(data, id, IB_FIELD_NAME("FIELD_NAME"), &out_field));
+    ASSERT_EQ(num_field, out_field);
+    ASSERT_IB_OK(ib_data_set(data, field1, IB_FIELD_NAME("FIELD_NAME")));
+    ASSERT_IB_OK(
+        ib_data_get_id(data, id, IB_FIELD_NAME("FIELD_NAME"), &out_field));
+    ASSERT_EQ(field1, out_field);
+    ASSERT_IB_OK(ib_data_remove(data, "field_name", NULL));
+    ASSERT_EQ(IB_ENOENT,
+              ib_data_get_id(data, id, IB_FIELD_NAME("FIELD_NAME"),
+                             &out_field));
+
+    /* Setting and removing by ID are seen through the name. */
+    id = IB_DATA_FIELD_ID_FIELD_TFN;
+    ASSERT_IB_OK(ib_data_set_id(data, id, field2));
+    ASSERT_IB_OK(ib_data_get(data, "field_tfn", &out_field));
+    ASSERT_EQ(field2, out_field);
+    ASSERT_IB_OK(ib_data_remove_id(data, id, &out_field));
+    ASSERT_EQ(field2, out_field);
+    ASSERT_EQ(IB_ENOENT, ib_data_get(data, "FIELD_TFN", &out_field));
+    ASSERT_EQ(IB_ENOENT, ib_data_remove_id(data, id, NULL));
+
+    /* Dynamic names fall back to the hash. */
+    ASSERT_IB_OK(ib_data_add_num(data, "my_var", 7, &num_field));
+    ASSERT_IB_OK(ib_data_get_id(data, IB_DATA_FIELD_ID_NONE,
+                                IB_FIELD_NAME("my_var"), &out_field));
+    ASSERT_EQ(num_field, out_field);
+
+    ibtest_engine_destroy(ib);
+}
+
+TEST(TestIronBee, test_data_field_id_all)
+{
+    static const char *names[] = {
+        "ARGS", "FLAGS", "FIELD", "FIELD_TFN", "FIELD_TARGET", "FIELD_NAME",
+        "FIELD_NAME_FULL", "request_line", "request_method",
+        "request_protocol", "request_uri", "request_uri_raw",
+        "request_uri_scheme", "request_uri_username", "request_uri_password",
+        "request_uri_host", "request_host", "request_uri_port",
+        "request_uri_path", "request_uri_query", "request_uri_fragment",
+        "request_content_type", "request_filename", "auth_type",
+        "auth_username", "auth_password", "request_headers",
+        "request_cookies", "request_uri_params", "request_body_params",
+        "request_body", "response_line", "response_protocol",
+        "response_status", "response_message", "response_content_type",
+        "response_headers", "response_cookies", "response_body",
+        "server_addr", "server_port", "remote_addr", "remote_port"
+    };
+
+    ASSERT_EQ(size_t(IB_DATA_FIELD_ID_COUNT),
+              sizeof(names) / sizeof(names[0]));
+
+    /* Every core name resolves to its own ID, in either case. */
+    for (int id = 0; id < IB_DATA_FIELD_ID_COUNT; ++id) {
+        std::string name(names[id]);
+        std::string upper(name);
+
+        for (size_t i = 0; i < upper.length(); ++i) {
+            upper[i] = toupper(upper[i]);
+        }
+        EXPECT_EQ(id, ib_data_field_id(name.data(), name.length())) << name;
+        EXPECT_EQ(id, ib_data_field_id(upper.data(), upper.length()))
+            << upper;
+        EXPECT_EQ(IB_DATA_FIELD_ID_NONE,
+                  ib_data_field_id(name.data(), name.length() - 1))
+            << name;
+    }
+}
+
+TEST(TestIronBee, test_data_expand_template)
+{
+    ib_engine_t *ib;
+    ib_data_t *data;
+    ib_field_t *list_field;
+    ib_field_t *field;
+    ib_list_t *list;
+    ib_expand_template_t *tmpl;
+    const char *text = "%{REMOTE_PORT}:%{my_var}:%{ARGS:a}:%{missing}";
+    char *result;
+    size_t len;
+
+    ibtest_engine_create(&ib);
+    ASSERT_IB_OK(ib_data_create(ib_engine_pool_main_get(ib), &data));
+
+    ASSERT_IB_OK(
+        ib_data_expand_template_create(ib_engine_pool_main_get(ib),
+                                       text, strlen(text), &tmpl));
+    ASSERT_TRUE(ib_expand_template_is_expandable(tmpl));
+
+    /* Nothing there yet. */
+    ASSERT_IB_OK(ib_data_expand_template_str(data, tmpl, true, &result, &len));
+    ASSERT_STREQ(":::", result);
+    ASSERT_EQ(3U, len);
+
+    /* Fields added after the template was created are found. */
+    ASSERT_IB_OK(ib_data_add_num(data, "remote_port", 8080, NULL));
+    ASSERT_IB_OK(ib_data_add_nulstr(data, "my_var", "%{REMOTE_PORT}", NULL));
+    ASSERT_IB_OK(ib_data_add_list(data, "ARGS", &list_field));
+    ASSERT_IB_OK(ib_field_value(list_field, &list));
+    ASSERT_IB_OK(
+        ib_field_create(&field, ib_data_pool(data), IB_FIELD_NAME("a"),
+                        IB_FTYPE_NULSTR, ib_ftype_nulstr_in("x")));
+    ASSERT_IB_OK(ib_list_push(list, field));
+
+    /* Names in values are expanded, as by ib_data_expand_str(). */
+    ASSERT_IB_OK(ib_data_expand_template_str(data, tmpl, true, &result, &len));
+    ASSERT_STREQ("8080:8080:x:", result);
+    ASSERT_EQ(strlen(result), len);
+    ASSERT_IB_OK(ib_data_expand_str(data, text, false, &result));
+    ASSERT_STREQ("8080:8080:x:", result);
+
+    ibtest_engine_destroy(ib);
+}
+
+TEST(TestIronBee, test_engine_pool_policy)
+{
+    ib_engine_t *ib;
+    ib_mpool_policy_t policy;
+    ib_mpool_t *mp;
+    char *report;
+
+    ibtest_engine_create(&ib);
+
+    policy = *ib_engine_pool_policy_get(ib, IB_ENGINE_POOL_TX);
+    ASSERT_STREQ("tx", policy.role);
+
+    /* The role name is kept. */
+    policy.role = "other";
+    policy.pagesize = 16384;
+    policy.large_threshold = 8192;
+    ASSERT_IB_OK(ib_engine_pool_policy_set(ib, IB_ENGINE_POOL_TX, &policy));
+    ASSERT_STREQ("tx", ib_engine_pool_policy_get(ib, IB_ENGINE_POOL_TX)->role);
+    ASSERT_EQ(16384U,
+              ib_engine_pool_policy_get(ib, IB_ENGINE_POOL_TX)->pagesize);
+    ASSERT_EQ(IB_EINVAL,
+              ib_engine_pool_policy_set(ib, IB_ENGINE_POOL_ROLE_NUM, &policy));
+
+    ASSERT_IB_OK(ib_engine_pool_create(ib, IB_ENGINE_POOL_TX, "test_tx",
+                                       ib_engine_pool_main_get(ib), &mp));
+    ASSERT_TRUE(ib_mpool_alloc(mp, 6000));
+
+    report = ib_mpool_analyze(ib_engine_pool_main_get(ib));
+    ASSERT_TRUE(report);
+    ASSERT_TRUE(strstr(report, "\n  engine ") != NULL);
+    ASSERT_TRUE(strstr(report, "\n  config ") != NULL);
+    ASSERT_TRUE(strstr(report, "\n  tx ") != NULL);
+    free(report);
+
+    ib_mpool_destroy(mp);
+    ibtest_engine_destroy(ib);
+}
+
+TEST(TestIronBee, test_engine_audit_async)
+{
+    ib_engine_t *ib;
+    ib_core_audit_stats_t stats;
+    const char *cfgbuf =
+        "LogLevel 4\n"
+        "SensorId B9C1B52B-C24A-4309-B9F9-0EF4CD577A3E\n"
+        "SensorName UnitTesting\n"
+        "SensorHostname unit-testing.sensor.tld\n"
+        "AuditEngine Off\n"
+        "AuditLogAsync On QueueSize=100 Overflow=Drop\n"
+        "<Site *>\n"
+        "  Hostname *\n"
+        "</Site>\n";
+
+    ibtest_engine_create(&ib);
+    ASSERT_IB_OK(ib_core_audit_stats(ib, &stats));
+    ASSERT_FALSE(stats.async);
+
+    /* The writer starts when the main context is closed. */
+    ibtest_engine_config_buf(ib, cfgbuf, strlen(cfgbuf), "test.conf", 1);
+    ASSERT_IB_OK(ib_core_audit_stats(ib, &stats));
+    ASSERT_TRUE(stats.async);
+    ASSERT_EQ(128U, stats.queue_size);
+    ASSERT_EQ(0U, stats.depth);
+    ASSERT_EQ(0U, stats.queued);
+    ASSERT_EQ(0U, stats.dropped);
+
+    ibtest_engine_destroy(ib);
+}
+
+TEST(TestIronBee, test_pcre_cache)
+{
+    ib_engine_t *ib;
+    ib_pcre_cache_t *cache;
+    ib_pcre_stats_t before;
+    ib_pcre_stats_t after;
+    const ib_pcre_t *cpatt1;
+    const ib_pcre_t *cpatt2;
+    const ib_pcre_t *cpatt3;
+    const char *error = NULL;
+    int eoff = 0;
+    int ovector[9];
+    ib_pcre_params_t params;
+    ib_pcre_params_t nostudy;
+
+    ibtest_engine_create(&ib);
+
+    cache = ib_engine_pcre_cache(ib);
+    ASSERT_TRUE(cache);
+    ib_pcre_cache_stats(cache, &before);
+
+    memset(&params, 0, sizeof(params));
+    params.options = PCRE_DOTALL;
+    params.study = true;
+    params.jit = true;
+    nostudy = params;
+    nostudy.study = false;
+
+    /* The same pattern and parameters share one compiled pattern. */
+    ASSERT_IB_OK(ib_pcre_cache_compile(cache, "^a(b+)c$", &params,
+                                       &cpatt1, &error, &eoff));
+    ASSERT_IB_OK(ib_pcre_cache_compile(cache, "^a(b+)c$", &params,
+                                       &cpatt2, &error, &eoff));
+    ASSERT_EQ(cpatt1, cpatt2);
+    ASSERT_STREQ("^a(b+)c$", cpatt1->pattern);
+    ASSERT_LT(0U, cpatt1->code_size);
+
+    /* Different parameters are a different pattern. */
+    ASSERT_IB_OK(ib_pcre_cache_compile(cache, "^a(b+)c$", &nostudy,
+                                       &cpatt3, &error, &eoff));
+    ASSERT_NE(cpatt1, cpatt3);
+
+    /* Bad patterns are reported, and not cached. */
+    ASSERT_EQ(IB_EINVAL, ib_pcre_cache_compile(cache, "(", &params,
+                                               &cpatt2, &error, &eoff));
+    ASSERT_TRUE(error);
+
+    ASSERT_EQ(2, ib_pcre_exec(cpatt1, "abbbc", 5, 0, ovector, 9));
+    ASSERT_EQ(1, ovector[2]);
+    ASSERT_EQ(4, ovector[3]);
+    ASSERT_EQ(PCRE_ERROR_NOMATCH, ib_pcre_exec(cpatt3, "ac", 2, 0, NULL, 0));
+
+    ib_pcre_cache_stats(cache, &after);
+    ASSERT_EQ(before.lookups + 4, after.lookups);
+    ASSERT_EQ(before.hits + 1, after.hits);
+    ASSERT_EQ(before.failures + 1, after.failures);
+    ASSERT_EQ(before.patterns + 2, after.patterns);
+
+    /* A closed cache still finds its patterns, but adds no more. */
+    ib_pcre_cache_close(cache);
+    ASSERT_IB_OK(ib_pcre_cache_compile(cache, "^a(b+)c$", &params,
+                                       &cpatt2, &error, &eoff));
+    ASSERT_EQ(cpatt1, cpatt2);
+    ASSERT_EQ(IB_DECLINED, ib_pcre_cache_compile(cache, "^x$", &params,
+                                                 &cpatt2, &error, &eoff));
+    ib_pcre_cache_stats(cache, &before);
+    ASSERT_EQ(after.lookups + 2, before.lookups);
+    ASSERT_EQ(after.declined + 1, before.declined);
+    ASSERT_EQ(after.patterns, before.patterns);
+
+    ibtest_engine_destroy(ib);
+}
+
+TEST(TestIronBee, test_pcre_compile_jit_off)
+{
+    ib_engine_t *ib;
+    ib_pcre_cache_t *cache;
+    const ib_pcre_t *cpatt;
+    const char *error = NULL;
+    int eoff = 0;
+    ib_pcre_params_t params;
+
+    ibtest_engine_create(&ib);
+
+    cache = ib_engine_pcre_cache(ib);
+    ASSERT_TRUE(cache);
+
+    memset(&params, 0, sizeof(params));
+    params.options = PCRE_DOTALL;
+    params.study = true;
+    params.jit = true;
+
+    /* With RegexJit Off, patterns compiled outside the cache are not JIT
+     * compiled either. */
+    ib_pcre_cache_jit_set(cache, false);
+    ASSERT_IB_OK(ib_pcre_compile(ib_engine_pool_main_get(ib),
+                                 ib_pcre_cache_jit_enabled(cache),
+                                 "^a(b+)c$", &params,
+                                 &cpatt, &error, &eoff));
+    ASSERT_FALSE(cpatt->is_jit);
+    ASSERT_EQ(2, ib_pcre_exec(cpatt, "abbbc", 5, 0, NULL, 0));
+
+#ifdef PCRE_HAVE_JIT
+    ib_pcre_cache_jit_set(cache, true);
+    ASSERT_IB_OK(ib_pcre_compile(ib_engine_pool_main_get(ib),
+                                 ib_pcre_cache_jit_enabled(cache),
+                                 "^a(b+)c$", &params,
+                                 &cpatt, &error, &eoff));
+    ASSERT_TRUE(cpatt->is_jit);
+    ASSERT_EQ(2, ib_pcre_exec(cpatt, "abbbc", 5, 0, NULL, 0));
+#endif
+
+    ibtest_engine_destroy(ib);
+}
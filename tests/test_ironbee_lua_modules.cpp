@@ -32,6 +32,7 @@ extern "C" {
 #include <lauxlib.h>
 #include <lua.h>
 #include <lualib.h>
+#include "modules/lua_private.h"
 }
 
 /**
@@ -143,3 +144,27 @@ TEST_F(IronBeeLuaModules, test_site_directive){
     ASSERT_TRUE(field1_val);
     ASSERT_STREQ("param2", field1_val);
 }
+
+TEST_F(IronBeeLuaModules, test_thread_reuse){
+    modlua_thread_pool_stats_t before;
+    modlua_thread_pool_stats_t after;
+    ib_conn_t *conn;
+
+    /* Return a connection's Lua thread to this OS thread's cache. */
+    conn = buildIronBeeConnection();
+    ib_state_notify_conn_closed(ib_engine, conn);
+    ib_conn_destroy(conn);
+
+    ASSERT_EQ(IB_OK, modlua_thread_pool_stats(ib_engine, &before));
+
+    /* The next connection reuses it without creating or locking. */
+    conn = buildIronBeeConnection();
+    ASSERT_EQ(IB_OK, modlua_thread_pool_stats(ib_engine, &after));
+    ib_state_notify_conn_closed(ib_engine, conn);
+    ib_conn_destroy(conn);
+
+    EXPECT_LT(before.local_hits, after.local_hits);
+    EXPECT_EQ(before.shared_hits, after.shared_hits);
+    EXPECT_EQ(before.creates, after.creates);
+    EXPECT_EQ(0UL, after.lock_waits);
+}
@@ -226,3 +226,51 @@ TEST_F(AhoCorasickModuleTest, test_pmf_rule)
     // This time we should succeed.
     ASSERT_TRUE(result);
 }
+
+TEST_F(AhoCorasickModuleTest, test_shared_patterns)
+{
+    ib_rule_t *rule;
+    ib_operator_inst_t *pmf1 = NULL;
+    ib_operator_inst_t *pmf2 = NULL;
+    ib_operator_inst_t *pm1 = NULL;
+    ib_operator_inst_t *pm2 = NULL;
+    ib_operator_inst_t *pm3 = NULL;
+
+    ASSERT_IB_OK(ib_rule_create(ib_engine,
+                                ib_context_engine(ib_engine),
+                                __FILE__,
+                                __LINE__,
+                                true,
+                                &rule));
+    rule->meta.id = "fake-id";
+
+    // The same pattern file is compiled once.
+    ASSERT_IB_OK(ib_operator_inst_create(ib_engine, NULL, rule,
+                                         IB_OP_FLAG_PHASE,
+                                         "pmf", "ahocorasick.patterns",
+                                         IB_OPINST_FLAG_NONE, &pmf1));
+    ASSERT_IB_OK(ib_operator_inst_create(ib_engine, NULL, rule,
+                                         IB_OP_FLAG_PHASE,
+                                         "pmf", "./ahocorasick.patterns",
+                                         IB_OPINST_FLAG_NONE, &pmf2));
+    ASSERT_TRUE(pmf1->data != NULL);
+    ASSERT_EQ(pmf1->data, pmf2->data);
+
+    // So are the same inline patterns, but not different ones.
+    ASSERT_IB_OK(ib_operator_inst_create(ib_engine, NULL, rule,
+                                         IB_OP_FLAG_PHASE,
+                                         "pm", "string1 string2",
+                                         IB_OPINST_FLAG_NONE, &pm1));
+    ASSERT_IB_OK(ib_operator_inst_create(ib_engine, NULL, rule,
+                                         IB_OP_FLAG_PHASE,
+                                         "pm", "string1 string2",
+                                         IB_OPINST_FLAG_NONE, &pm2));
+    ASSERT_IB_OK(ib_operator_inst_create(ib_engine, NULL, rule,
+                                         IB_OP_FLAG_PHASE,
+                                         "pm", "string1 string3",
+                                         IB_OPINST_FLAG_NONE, &pm3));
+    ASSERT_TRUE(pm1->data != NULL);
+    ASSERT_EQ(pm1->data, pm2->data);
+    ASSERT_NE(pm1->data, pm3->data);
+    ASSERT_NE(pmf1->data, pm1->data);
+}
@@ -0,0 +1,352 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee --- User Agent Module Tests
+//////////////////////////////////////////////////////////////////////////////
+
+#include "gtest/gtest.h"
+#include "gtest/gtest-spi.h"
+#include "base_fixture.h"
+#include "simple_fixture.hpp"
+
+extern "C" {
+#include "user_agent_private.h"
+}
+
+#include <ironbee/data.h>
+#include <ironbee/field.h>
+#include <ironbee/list.h>
+#include <ironbee/mpool.h>
+
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * Tests of the cache of parsed user agents.
+ */
+class UserAgentCacheTest : public SimpleFixture
+{
+public:
+    /**
+     * Add an agent to @a cache.
+     *
+     * The agent's product is @a ua, its platform "platform" and it has no
+     * extra; its rule is @a rule.
+     */
+    void put(modua_cache_t *cache,
+             const std::string& ua,
+             const modua_match_rule_t *rule = NULL)
+    {
+        std::string buf = ua + '\0' + "platform" + '\0';
+        modua_agent_t agent;
+
+        agent.product = &buf[0];
+        agent.platform = &buf[ua.length() + 1];
+        agent.extra = NULL;
+        agent.rule = rule;
+        ASSERT_EQ(IB_OK, modua_cache_put(cache, ua.data(), ua.length(),
+                                         buf.data(), buf.length(), &agent));
+    }
+
+    //! True if @a ua is in @a cache.
+    bool has(modua_cache_t *cache, const std::string& ua)
+    {
+        modua_agent_t agent;
+
+        return modua_cache_get(cache, MemPool(), ua.data(), ua.length(),
+                               &agent) == IB_OK;
+    }
+
+    //! The @a n th generated user agent.
+    static std::string agent(size_t n)
+    {
+        std::ostringstream ua;
+        ua << "Mozilla/5.0 (X11; Linux x86_64) Agent/" << n;
+        return ua.str();
+    }
+};
+
+TEST_F(UserAgentCacheTest, HitReturnsSameFields)
+{
+    const modua_match_ruleset_t *ruleset;
+    modua_match_rule_t *failed_rule;
+    unsigned int failed_frule_num;
+    modua_cache_t *cache;
+    modua_agent_t agent;
+    const std::string ua = "Mozilla/5.0 (X11; Linux x86_64) Firefox/20.0";
+    char buf[] = "Mozilla/5.0\0X11; Linux x86_64\0Firefox/20.0";
+
+    ASSERT_EQ(IB_OK, modua_ruleset_init(&failed_rule, &failed_frule_num));
+    ruleset = modua_ruleset_get();
+    ASSERT_TRUE(ruleset != NULL);
+    ASSERT_LT(0U, ruleset->num_rules);
+
+    ASSERT_EQ(IB_OK, modua_cache_create(MemPool(), 16, &cache));
+    ASSERT_EQ(IB_ENOENT, modua_cache_get(cache, MemPool(),
+                                         ua.data(), ua.length(), &agent));
+
+    agent.product = buf;
+    agent.platform = buf + 12;
+    agent.extra = buf + 30;
+    agent.rule = &ruleset->rules[1];
+    ASSERT_EQ(IB_OK, modua_cache_put(cache, ua.data(), ua.length(),
+                                     buf, sizeof(buf), &agent));
+
+    /* The hit is a copy of what was put. */
+    memset(&agent, 0, sizeof(agent));
+    memset(buf, 'x', sizeof(buf));
+    ASSERT_EQ(IB_OK, modua_cache_get(cache, MemPool(),
+                                     ua.data(), ua.length(), &agent));
+    EXPECT_EQ(std::string("Mozilla/5.0"), agent.product);
+    EXPECT_EQ(std::string("X11; Linux x86_64"), agent.platform);
+    EXPECT_EQ(std::string("Firefox/20.0"), agent.extra);
+    EXPECT_EQ(&ruleset->rules[1], agent.rule);
+
+    /* Missing parts stay missing. */
+    put(cache, "Bare");
+    ASSERT_EQ(IB_OK, modua_cache_get(cache, MemPool(), "Bare", 4, &agent));
+    EXPECT_EQ(std::string("Bare"), agent.product);
+    EXPECT_EQ(std::string("platform"), agent.platform);
+    EXPECT_TRUE(agent.extra == NULL);
+    EXPECT_TRUE(agent.rule == NULL);
+
+    /* Only the exact agent hits. */
+    EXPECT_FALSE(has(cache, ua.substr(0, ua.length() - 1)));
+    EXPECT_FALSE(has(cache, ua + " "));
+}
+
+TEST_F(UserAgentCacheTest, ShardSplit)
+{
+    modua_cache_t *cache;
+
+    /* Shards hold at least 64 agents, and there are at most 16. */
+    ASSERT_EQ(IB_OK, modua_cache_create(MemPool(), 1, &cache));
+    EXPECT_EQ(1U, modua_cache_num_shards(cache));
+    ASSERT_EQ(IB_OK, modua_cache_create(MemPool(), 64, &cache));
+    EXPECT_EQ(1U, modua_cache_num_shards(cache));
+    ASSERT_EQ(IB_OK, modua_cache_create(MemPool(), 65, &cache));
+    EXPECT_EQ(2U, modua_cache_num_shards(cache));
+    ASSERT_EQ(IB_OK, modua_cache_create(MemPool(), 1000, &cache));
+    EXPECT_EQ(16U, modua_cache_num_shards(cache));
+    ASSERT_EQ(IB_OK, modua_cache_create(MemPool(), 100000, &cache));
+    EXPECT_EQ(16U, modua_cache_num_shards(cache));
+}
+
+TEST_F(UserAgentCacheTest, CapacityBound)
+{
+    static const size_t sizes[] = { 1, 64, 100, 1000 };
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+        modua_cache_t *cache;
+        size_t size = sizes[i];
+
+        ASSERT_EQ(IB_OK, modua_cache_create(MemPool(), size, &cache));
+        for (size_t n = 0; n < size * 20; ++n) {
+            put(cache, agent(n));
+            ASSERT_GE(size, modua_cache_count(cache));
+        }
+
+        /* Every shard is full by now; the latest agent is always held. */
+        EXPECT_EQ(size, modua_cache_count(cache));
+        EXPECT_TRUE(has(cache, agent(size * 20 - 1)));
+
+        /* Adding an agent again does not add an entry. */
+        put(cache, agent(size * 20 - 1));
+        EXPECT_EQ(size, modua_cache_count(cache));
+    }
+}
+
+TEST_F(UserAgentCacheTest, LruEviction)
+{
+    modua_cache_t *cache;
+    const size_t size = 64;
+
+    /* A single shard, so eviction order is exact. */
+    ASSERT_EQ(IB_OK, modua_cache_create(MemPool(), size, &cache));
+    ASSERT_EQ(1U, modua_cache_num_shards(cache));
+
+    for (size_t n = 0; n < size; ++n) {
+        put(cache, agent(n));
+    }
+    ASSERT_EQ(size, modua_cache_count(cache));
+
+    /* Use the even agents, then add as many new agents as there are odd
+     * ones: all of the odd agents, and only they, are evicted. */
+    for (size_t n = 0; n < size; n += 2) {
+        ASSERT_TRUE(has(cache, agent(n)));
+    }
+    for (size_t n = size; n < size + size / 2; ++n) {
+        put(cache, agent(n));
+    }
+    for (size_t n = 0; n < size; ++n) {
+        EXPECT_EQ(n % 2 == 0, has(cache, agent(n))) << agent(n);
+    }
+    for (size_t n = size; n < size + size / 2; ++n) {
+        EXPECT_TRUE(has(cache, agent(n))) << agent(n);
+    }
+
+    /* The least recently used agent goes next. */
+    put(cache, agent(1000));
+    EXPECT_FALSE(has(cache, agent(0)));
+    EXPECT_TRUE(has(cache, agent(2)));
+}
+
+/**
+ * Tests of the user agent module, with and without its cache.
+ */
+class UserAgentModuleTest : public BaseFixture
+{
+public:
+    //! Fields of the UA collection of a transaction, by name.
+    typedef std::map<std::string, std::string> ua_fields_t;
+
+    /**
+     * Configure the engine.
+     *
+     * @param[in] cache_size Value of UserAgentCacheSize.
+     */
+    void configure(size_t cache_size)
+    {
+        std::ostringstream config;
+
+        config << "LogLevel 1\n"
+               << "LoadModule \"ibmod_htp.so\"\n"
+               << "LoadModule \"ibmod_user_agent.so\"\n"
+               << "UserAgentCacheSize " << cache_size << "\n"
+               << "SensorId B9C1B52B-C24A-4309-B9F9-0EF4CD577A3E\n"
+               << "SensorName UnitTesting\n"
+               << "SensorHostname unit-testing.sensor.tld\n"
+               << "AuditEngine Off\n"
+               << "Set parser \"htp\"\n"
+               << "<Site test-site>\n"
+               << "SiteId AAAABBBB-1111-2222-3333-000000000000\n"
+               << "Hostname *\n"
+               << "</Site>\n";
+
+        configureIronBeeByString(config.str());
+    }
+
+    //! Send a request with user agent @a ua; return its UA fields.
+    ua_fields_t request(const std::string& ua)
+    {
+        ua_fields_t fields;
+        ib_conn_t *conn = buildIronBeeConnection();
+        ib_field_t *f;
+        const ib_list_t *list;
+        const ib_list_node_t *node;
+
+        sendDataIn(conn,
+                   "GET / HTTP/1.1\r\n"
+                   "Host: UnitTest\r\n"
+                   "User-Agent: " + ua + "\r\n"
+                   "\r\n");
+        EXPECT_TRUE(conn->tx != NULL);
+        if ( (conn->tx != NULL) &&
+             (ib_data_get(conn->tx->data, "UA", &f) == IB_OK) &&
+             (ib_field_value(f, ib_ftype_list_out(&list)) == IB_OK) )
+        {
+            IB_LIST_LOOP_CONST(list, node) {
+                const ib_field_t *member =
+                    (const ib_field_t *)ib_list_node_data_const(node);
+                const char *value;
+
+                if (ib_field_value(member,
+                                   ib_ftype_nulstr_out(&value)) == IB_OK)
+                {
+                    fields[std::string(member->name, member->nlen)] = value;
+                }
+            }
+        }
+
+        ib_state_notify_conn_closed(ib_engine, conn);
+
+        return fields;
+    }
+};
+
+/**
+ * User agents covering the rule table, plus generated variants.
+ */
+static std::vector<std::string> test_agents()
+{
+    static const char *agents[] = {
+        "Mozilla/5.0 (X11; Linux x86_64; rv:20.0) Gecko/20100101 "
+        "Firefox/20.0",
+        "Mozilla/5.0 (Windows NT 6.1; WOW64) AppleWebKit/537.31 "
+        "(KHTML, like Gecko) Chrome/26.0.1410.64 Safari/537.31",
+        "Mozilla/4.0 (compatible; MSIE 8.0; Windows NT 6.1; Trident/4.0)",
+        "Mozilla/5.0 (compatible; Yahoo! Slurp; "
+        "http://help.yahoo.com/help/us/ysearch/slurp)",
+        "msnbot/2.0b (+http://search.msn.com/msnbot.htm)",
+        "NewsGator/3.0 (http://www.newsgator.com; 1 subscribers)",
+        "SimplePie/1.2 (Feed Parser; http://simplepie.org) Build/20100112",
+        "Wget/1.13.4 (linux-gnu)",
+        "curl/7.29.0",
+        "Opera/9.80 (Macintosh; Intel Mac OS X 10.8.3) Presto/2.12.388 "
+        "Version/12.15",
+        "NoProduct",
+        ""
+    };
+    std::vector<std::string> result;
+
+    for (size_t i = 0; i < sizeof(agents) / sizeof(*agents); ++i) {
+        result.push_back(agents[i]);
+        for (size_t n = 0; n < 3; ++n) {
+            std::ostringstream variant;
+            variant << agents[i] << " Extra/" << n;
+            result.push_back(variant.str());
+        }
+    }
+
+    return result;
+}
+
+TEST_F(UserAgentModuleTest, CachedMatchesUncached)
+{
+    std::vector<std::string> agents = test_agents();
+    size_t categorized = 0;
+
+    /* The first request of an agent misses, so the agent is parsed and
+     * categorized rule by rule; the second hits.  Both must give the same
+     * fields. */
+    configure(4096);
+    for (size_t i = 0; i < agents.size(); ++i) {
+        ua_fields_t uncached = request(agents[i]);
+        ua_fields_t cached = request(agents[i]);
+
+        EXPECT_TRUE(uncached == cached) << agents[i];
+        categorized += uncached.count("category");
+    }
+
+    /* Some agents were categorized. */
+    EXPECT_LT(0U, categorized);
+}
+
+TEST_F(UserAgentModuleTest, NoCache)
+{
+    std::vector<std::string> agents = test_agents();
+
+    configure(0);
+    for (size_t i = 0; i < agents.size(); ++i) {
+        EXPECT_TRUE(request(agents[i]) == request(agents[i])) << agents[i];
+    }
+}
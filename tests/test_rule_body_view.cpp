@@ -0,0 +1,270 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee --- Rule body view tests
+//////////////////////////////////////////////////////////////////////////////
+
+#include "gtest/gtest.h"
+#include "base_fixture.h"
+
+#include "rule_body_view_private.h"
+
+#include <ironbee/bytestr.h>
+#include <ironbee/transformation.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class TestRuleBodyView : public BaseFixture
+{
+public:
+    /**
+     * Look up a transformation by name.
+     */
+    const ib_tfn_t *tfn(const char *name)
+    {
+        ib_tfn_t *t;
+
+        if (ib_tfn_lookup(ib_engine, name, &t) != IB_OK) {
+            throw std::runtime_error("Failed to look up transformation.");
+        }
+        return t;
+    }
+
+    /**
+     * Get the value of a byte string field.
+     */
+    static std::string value(const ib_field_t *f)
+    {
+        const ib_bytestr_t *bs;
+
+        if (ib_field_value(f, ib_ftype_bytestr_out(&bs)) != IB_OK) {
+            throw std::runtime_error("Failed to get field value.");
+        }
+        return std::string((const char *)ib_bytestr_const_ptr(bs),
+                           ib_bytestr_length(bs));
+    }
+
+    /**
+     * Transform @a data all at once with the transformation @a name.
+     */
+    std::string whole(const char *name, const std::string &data)
+    {
+        ib_mpool_t *mp = ib_engine_pool_main_get(ib_engine);
+        ib_field_t *in;
+        ib_field_t *out;
+        ib_flags_t flags;
+
+        if (ib_field_create_bytestr_alias(&in, mp, "body", 4,
+                                          (uint8_t *)data.data(),
+                                          data.length()) != IB_OK ||
+            ib_tfn_transform(ib_engine, mp, tfn(name), in, &out, &flags)
+                != IB_OK)
+        {
+            throw std::runtime_error("Failed to transform.");
+        }
+        return value(out);
+    }
+
+    /**
+     * Stream @a chunks through a body view with the transformation
+     * @a name, checking that the body is their concatenation.
+     */
+    std::string streamed(const char *name,
+                         const std::vector<std::string> &chunks)
+    {
+        ib_mpool_t *mp = ib_engine_pool_main_get(ib_engine);
+        const ib_tfn_t *tfns[1] = { tfn(name) };
+        ib_rule_body_view_t *view;
+        ib_field_t *body;
+        ib_field_t *out[1];
+        std::string all;
+
+        if (ib_rule_body_view_create(ib_engine, mp, tfns, 1, 0, &view)
+            != IB_OK)
+        {
+            throw std::runtime_error("Failed to create body view.");
+        }
+        for (size_t n = 0;  n < chunks.size();  ++n) {
+            if (ib_rule_body_view_append(view,
+                                         (const uint8_t *)chunks[n].data(),
+                                         chunks[n].length()) != IB_OK)
+            {
+                throw std::runtime_error("Failed to append to body view.");
+            }
+            all += chunks[n];
+        }
+        if (ib_rule_body_view_finish(view, "body", 4, &body, out) != IB_OK) {
+            throw std::runtime_error("Failed to finish body view.");
+        }
+        EXPECT_EQ(all, value(body));
+        EXPECT_EQ(all.length(), ib_rule_body_view_length(view));
+        return value(out[0]);
+    }
+
+    /**
+     * Stream @a data split at every position, and compare with
+     * transforming it all at once.
+     */
+    void checkSplits(const char *name, const std::string &data)
+    {
+        std::string expected = whole(name, data);
+
+        for (size_t i = 0;  i <= data.length();  ++i) {
+            for (size_t j = i;  j <= data.length();  ++j) {
+                std::vector<std::string> chunks;
+
+                chunks.push_back(data.substr(0, i));
+                chunks.push_back(data.substr(i, j - i));
+                chunks.push_back(data.substr(j));
+                ASSERT_EQ(expected, streamed(name, chunks))
+                    << name << " of \"" << data << "\" split at "
+                    << i << ", " << j;
+            }
+        }
+    }
+};
+
+TEST_F(TestRuleBodyView, holdback)
+{
+    ASSERT_TRUE(tfn("urlDecode")->fn_holdback != NULL);
+    ASSERT_TRUE(tfn("lowercase")->fn_holdback != NULL);
+    ASSERT_TRUE(tfn("removeWhitespace")->fn_holdback != NULL);
+    ASSERT_TRUE(tfn("compressWhitespace")->fn_holdback == NULL);
+    ASSERT_TRUE(tfn("htmlEntityDecode")->fn_holdback == NULL);
+
+    const ib_tfn_t *url = tfn("urlDecode");
+    ASSERT_EQ(0U, url->fn_holdback((const uint8_t *)"abc", 3, NULL));
+    ASSERT_EQ(1U, url->fn_holdback((const uint8_t *)"abc%", 4, NULL));
+    ASSERT_EQ(2U, url->fn_holdback((const uint8_t *)"abc%4", 5, NULL));
+    ASSERT_EQ(0U, url->fn_holdback((const uint8_t *)"abc%41", 6, NULL));
+}
+
+TEST_F(TestRuleBodyView, urlDecode)
+{
+    std::vector<std::string> chunks;
+
+    chunks.push_back("a=%3Cscr");
+    chunks.push_back("ipt%");
+    chunks.push_back("3e+x%2");
+    chunks.push_back("0y");
+    ASSERT_EQ("a=<script> x y", streamed("urlDecode", chunks));
+
+    checkSplits("urlDecode", "a%41b%4g%%41%+%4");
+    checkSplits("urlDecode", "%%%41%4%");
+}
+
+TEST_F(TestRuleBodyView, bytewise)
+{
+    checkSplits("lowercase", "SeLeCt * FrOm");
+    checkSplits("removeWhitespace", " a b\t\nc ");
+}
+
+TEST_F(TestRuleBodyView, views)
+{
+    ib_mpool_t *mp = ib_engine_pool_main_get(ib_engine);
+    const ib_tfn_t *tfns[2] = { tfn("urlDecode"), tfn("lowercase") };
+    ib_rule_body_view_t *view;
+    ib_field_t *body;
+    ib_field_t *out[2];
+
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_create(ib_engine, mp, tfns, 2, 0, &view));
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_append(view, (const uint8_t *)"A%4", 3));
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_append(view, (const uint8_t *)"2B", 2));
+    ASSERT_EQ(IB_OK, ib_rule_body_view_finish(view, "body", 4, &body, out));
+    ASSERT_EQ("A%42B", value(body));
+    ASSERT_EQ("ABB", value(out[0]));
+    ASSERT_EQ("a%42b", value(out[1]));
+
+    /* Finished */
+    ASSERT_EQ(IB_EINVAL,
+              ib_rule_body_view_append(view, (const uint8_t *)"x", 1));
+    ASSERT_EQ(IB_EINVAL,
+              ib_rule_body_view_finish(view, "body", 4, &body, out));
+
+    /* Empty body */
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_create(ib_engine, mp, tfns, 2, 0, &view));
+    ASSERT_EQ(IB_OK, ib_rule_body_view_finish(view, "body", 4, &body, out));
+    ASSERT_EQ("", value(body));
+    ASSERT_EQ("", value(out[0]));
+    ASSERT_EQ("", value(out[1]));
+
+    /* Only streamable transformations */
+    tfns[1] = tfn("htmlEntityDecode");
+    ASSERT_EQ(IB_EINVAL,
+              ib_rule_body_view_create(ib_engine, mp, tfns, 2, 0, &view));
+}
+
+TEST_F(TestRuleBodyView, large)
+{
+    std::vector<std::string> chunks;
+    std::string all;
+
+    /* Grow the buffers several times. */
+    for (size_t n = 0;  n < 1000;  ++n) {
+        chunks.push_back("Chunk%2");
+        chunks.push_back("0of%20body%");
+        chunks.push_back("21 ");
+    }
+    for (size_t n = 0;  n < chunks.size();  ++n) {
+        all += chunks[n];
+    }
+    ASSERT_EQ(whole("urlDecode", all), streamed("urlDecode", chunks));
+}
+
+TEST_F(TestRuleBodyView, limit)
+{
+    ib_mpool_t *mp = ib_engine_pool_main_get(ib_engine);
+    const ib_tfn_t *tfns[1] = { tfn("urlDecode") };
+    ib_rule_body_view_t *view;
+    ib_field_t *body;
+    ib_field_t *out[1];
+
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_create(ib_engine, mp, tfns, 1, 8, &view));
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_append(view, (const uint8_t *)"a%41", 4));
+    ASSERT_FALSE(ib_rule_body_view_truncated(view));
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_append(view, (const uint8_t *)"b%4", 3));
+    ASSERT_FALSE(ib_rule_body_view_truncated(view));
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_append(view, (const uint8_t *)"2cdef", 5));
+    ASSERT_TRUE(ib_rule_body_view_truncated(view));
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_append(view, (const uint8_t *)"ghi", 3));
+    ASSERT_EQ(8U, ib_rule_body_view_length(view));
+    ASSERT_EQ(IB_OK, ib_rule_body_view_finish(view, "body", 4, &body, out));
+    ASSERT_EQ("a%41b%42", value(body));
+    ASSERT_EQ("aAbB", value(out[0]));
+
+    /* Exactly at the limit */
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_create(ib_engine, mp, tfns, 1, 3, &view));
+    ASSERT_EQ(IB_OK,
+              ib_rule_body_view_append(view, (const uint8_t *)"abc", 3));
+    ASSERT_FALSE(ib_rule_body_view_truncated(view));
+    ASSERT_EQ(IB_OK, ib_rule_body_view_finish(view, "body", 4, &body, out));
+    ASSERT_EQ("abc", value(body));
+}
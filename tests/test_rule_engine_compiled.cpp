@@ -0,0 +1,472 @@
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee --- Compiled ruleset tests
+//////////////////////////////////////////////////////////////////////////////
+
+#include "gtest/gtest.h"
+#include "base_fixture.h"
+
+#include "ibtest_util.hpp"
+#include "engine_private.h"
+#include "rule_engine_private.h"
+#include <ironbee/action.h>
+#include <ironbee/bytestr.h>
+#include <ironbee/clock.h>
+#include <ironbee/data.h>
+#include <ironbee/list.h>
+#include <ironbee/rule_defs.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/**
+ * Test the array-backed ruleset built when a context is closed.
+ */
+class RuleCompiledTest : public BaseFixture
+{
+public:
+    /**
+     * Configure the engine with @a num_rules generated request header rules.
+     *
+     * Every tenth rule has a chained rule.
+     */
+    void configureRules(size_t num_rules)
+    {
+        std::ostringstream config;
+
+        config << "LogLevel 1\n"
+               << "LoadModule \"ibmod_htp.so\"\n"
+               << "LoadModule \"ibmod_pcre.so\"\n"
+               << "LoadModule \"ibmod_rules.so\"\n"
+               << "SensorId B9C1B52B-C24A-4309-B9F9-0EF4CD577A3E\n"
+               << "SensorName UnitTesting\n"
+               << "SensorHostname unit-testing.sensor.tld\n"
+               << "AuditEngine Off\n"
+               << "Set parser \"htp\"\n"
+               << "<Site test-site>\n"
+               << "SiteId AAAABBBB-1111-2222-3333-000000000000\n"
+               << "Hostname *\n";
+        for (size_t n = 0;  n < num_rules;  ++n) {
+            config << "Rule REQUEST_HEADERS:X-" << n
+                   << ".t:lowercase().t:trim() ARGS @streq \"v" << n << "\""
+                   << " id:" << n << " phase:REQUEST_HEADER"
+                   << " setvar:r" << n << "=1"
+                   << ((n % 10 == 0) ? " chain" : "") << "\n";
+            if (n % 10 == 0) {
+                config << "Rule REQUEST_METHOD @streq \"GET\""
+                       << " setvar:c" << n << "=1\n";
+            }
+        }
+        config << "</Site>\n";
+
+        configureIronBeeByString(config.str());
+    }
+
+    /**
+     * Find the first location context.
+     */
+    ib_context_t *locationContext()
+    {
+        const ib_list_node_t *node;
+
+        IB_LIST_LOOP_CONST(ib_engine->contexts, node) {
+            ib_context_t *ctx = (ib_context_t *)node->data;
+            if (ib_context_type(ctx) == IB_CTYPE_LOCATION) {
+                return ctx;
+            }
+        }
+        return NULL;
+    }
+};
+
+/// Check that a compiled rule mirrors its rule's lists.
+static void checkCompiledRule(const ib_rule_compiled_t *crule)
+{
+    const ib_list_node_t *node;
+    size_t                n;
+
+    ASSERT_TRUE(crule->rule != NULL);
+    ASSERT_EQ(ib_list_elements(crule->rule->target_fields),
+              (size_t)crule->num_targets);
+    n = 0;
+    IB_LIST_LOOP_CONST(crule->rule->target_fields, node) {
+        const ib_rule_compiled_target_t *ctarget = &(crule->targets[n++]);
+        const ib_list_node_t            *tnode;
+        size_t                           t = 0;
+
+        ASSERT_EQ(node->data, ctarget->target);
+        ASSERT_EQ(ib_list_elements(ctarget->target->tfn_list),
+                  ctarget->num_tfns);
+        IB_LIST_LOOP_CONST(ctarget->target->tfn_list, tnode) {
+            ASSERT_EQ(tnode->data, ctarget->tfns[t++]);
+        }
+    }
+    ASSERT_EQ(ib_list_elements(crule->rule->true_actions),
+              (size_t)crule->num_true_actions);
+    n = 0;
+    IB_LIST_LOOP_CONST(crule->rule->true_actions, node) {
+        ASSERT_EQ(node->data, crule->true_actions[n++]);
+    }
+    ASSERT_EQ(ib_list_elements(crule->rule->false_actions),
+              (size_t)crule->num_false_actions);
+
+    if (crule->rule->chained_rule == NULL) {
+        ASSERT_TRUE(crule->chained == NULL);
+    }
+    else {
+        ASSERT_TRUE(crule->chained != NULL);
+        ASSERT_EQ(crule->rule->chained_rule, crule->chained->rule);
+        checkCompiledRule(crule->chained);
+    }
+}
+
+/// Action which overwrites the bytes of the field @c s in place.
+static ib_status_t mutateAction(const ib_rule_exec_t *rule_exec,
+                                void                 *,
+                                ib_flags_t            ,
+                                void                 *)
+{
+    ib_field_t   *f;
+    ib_bytestr_t *bs;
+    ib_status_t   rc;
+
+    rc = ib_data_get(rule_exec->tx->data, "s", &f);
+    if (rc != IB_OK) {
+        return rc;
+    }
+    rc = ib_field_mutable_value(f, ib_ftype_bytestr_mutable_out(&bs));
+    if (rc != IB_OK) {
+        return rc;
+    }
+    memcpy(ib_bytestr_ptr(bs), "XYZ", 3);
+
+    return IB_OK;
+}
+
+TEST_F(RuleCompiledTest, layout)
+{
+    ib_context_t *ctx;
+    const ib_ruleset_phase_t *ruleset_phase;
+    const ib_list_node_t *node;
+    size_t n = 0;
+
+    configureRules(50);
+    ctx = locationContext();
+    ASSERT_TRUE(ctx != NULL);
+    ASSERT_TRUE(ctx->rules->compiled != NULL);
+
+    ruleset_phase = &(ctx->rules->ruleset.phases[PHASE_REQUEST_HEADER]);
+    ASSERT_EQ(50U, ruleset_phase->num_rules);
+    IB_LIST_LOOP_CONST(ruleset_phase->rule_list, node) {
+        const ib_rule_ctx_data_t *ctx_rule =
+            (const ib_rule_ctx_data_t *)node->data;
+
+        ASSERT_LT(n, ruleset_phase->num_rules);
+        ASSERT_EQ(ctx_rule->rule, ruleset_phase->rules[n].rule);
+        checkCompiledRule(&(ruleset_phase->rules[n]));
+        ++n;
+    }
+    ASSERT_EQ(n, ruleset_phase->num_rules);
+
+    /* 50 top-level rules plus 5 chained rules */
+    ASSERT_EQ(55U, ctx->rules->compiled->num_rules);
+}
+
+/// Sum of targets, transformations and actions, walking the rule lists.
+static size_t walkLists(const ib_ruleset_phase_t *ruleset_phase)
+{
+    const ib_list_node_t *node;
+    size_t                sum = 0;
+
+    IB_LIST_LOOP_CONST(ruleset_phase->rule_list, node) {
+        const ib_rule_ctx_data_t *ctx_rule =
+            (const ib_rule_ctx_data_t *)node->data;
+        const ib_list_node_t     *tnode;
+
+        IB_LIST_LOOP_CONST(ctx_rule->rule->target_fields, tnode) {
+            const ib_rule_target_t *target =
+                (const ib_rule_target_t *)tnode->data;
+            const ib_list_node_t   *fnode;
+
+            IB_LIST_LOOP_CONST(target->tfn_list, fnode) {
+                sum += (fnode->data != NULL);
+            }
+            ++sum;
+        }
+        IB_LIST_LOOP_CONST(ctx_rule->rule->true_actions, tnode) {
+            sum += (tnode->data != NULL);
+        }
+    }
+    return sum;
+}
+
+/// Sum of targets, transformations and actions, walking the arrays.
+static size_t walkCompiled(const ib_ruleset_phase_t *ruleset_phase)
+{
+    size_t sum = 0;
+
+    for (size_t n = 0;  n < ruleset_phase->num_rules;  ++n) {
+        const ib_rule_compiled_t *crule = &(ruleset_phase->rules[n]);
+
+        for (size_t t = 0;  t < crule->num_targets;  ++t) {
+            const ib_rule_compiled_target_t *ctarget = &(crule->targets[t]);
+
+            for (size_t f = 0;  f < ctarget->num_tfns;  ++f) {
+                sum += (ctarget->tfns[f] != NULL);
+            }
+            ++sum;
+        }
+        for (size_t a = 0;  a < crule->num_true_actions;  ++a) {
+            sum += (crule->true_actions[a] != NULL);
+        }
+    }
+    return sum;
+}
+
+/**
+ * Traversal micro-benchmark: compare walking a phase's rules through the
+ * linked lists with walking the compiled arrays.
+ */
+TEST_F(RuleCompiledTest, traversalBenchmark)
+{
+    const size_t num_rules = 2000;
+    const size_t iterations = 200;
+    ib_context_t *ctx;
+    const ib_ruleset_phase_t *ruleset_phase;
+    ib_time_t start;
+    ib_time_t list_usec;
+    ib_time_t array_usec;
+    size_t list_sum = 0;
+    size_t array_sum = 0;
+
+    configureRules(num_rules);
+    ctx = locationContext();
+    ASSERT_TRUE(ctx != NULL);
+    ruleset_phase = &(ctx->rules->ruleset.phases[PHASE_REQUEST_HEADER]);
+    ASSERT_EQ(num_rules, ruleset_phase->num_rules);
+
+    start = ib_clock_get_time();
+    for (size_t i = 0;  i < iterations;  ++i) {
+        list_sum += walkLists(ruleset_phase);
+    }
+    list_usec = ib_clock_get_time() - start;
+
+    start = ib_clock_get_time();
+    for (size_t i = 0;  i < iterations;  ++i) {
+        array_sum += walkCompiled(ruleset_phase);
+    }
+    array_usec = ib_clock_get_time() - start;
+
+    ASSERT_EQ(list_sum, array_sum);
+
+    std::cout << "Rule traversal (" << num_rules << " rules x "
+              << iterations << "): "
+              << "lists " << (list_usec * 1000.0 / (num_rules * iterations))
+              << " ns/rule, "
+              << "arrays " << (array_usec * 1000.0 / (num_rules * iterations))
+              << " ns/rule" << std::endl;
+}
+
+TEST_F(RuleCompiledTest, prefilter)
+{
+    ib_context_t *ctx;
+    const ib_ruleset_phase_t *ruleset_phase;
+    const ib_rule_compiled_t *crule;
+
+    configureIronBeeByString(
+        "LogLevel 1\n"
+        "LoadModule \"ibmod_htp.so\"\n"
+        "LoadModule \"ibmod_pcre.so\"\n"
+        "LoadModule \"ibmod_rules.so\"\n"
+        "SensorId B9C1B52B-C24A-4309-B9F9-0EF4CD577A3E\n"
+        "SensorName UnitTesting\n"
+        "SensorHostname unit-testing.sensor.tld\n"
+        "AuditEngine Off\n"
+        "Set parser \"htp\"\n"
+        "RulePrefilter On\n"
+        "<Site test-site>\n"
+        "SiteId AAAABBBB-1111-2222-3333-000000000000\n"
+        "Hostname *\n"
+        "Rule ARGS @rx \"union\\s+select\" id:1 phase:REQUEST_HEADER chain\n"
+        "Rule ARGS @rx \"<script\" setvar:a=1\n"
+        "Rule ARGS @rx \"\\d+\" id:2 phase:REQUEST_HEADER setvar:b=1\n"
+        "Rule ARGS !@rx \"etc/passwd\" id:3 phase:REQUEST_HEADER setvar:c=1\n"
+        "Rule ARGS @streq \"select\" id:4 phase:REQUEST_HEADER setvar:d=1\n"
+        "</Site>\n");
+    ctx = locationContext();
+    ASSERT_TRUE(ctx != NULL);
+
+    ruleset_phase = &(ctx->rules->ruleset.phases[PHASE_REQUEST_HEADER]);
+    ASSERT_TRUE(ruleset_phase->prefilter != NULL);
+    ASSERT_EQ(3U, ib_rule_prefilter_slots(ruleset_phase->prefilter));
+    ASSERT_EQ(4U, ruleset_phase->num_rules);
+
+    crule = &(ruleset_phase->rules[0]);
+    ASSERT_EQ(ruleset_phase->prefilter, crule->prefilter);
+    ASSERT_EQ(0U, crule->prefilter_slot);
+    ASSERT_TRUE(crule->chained != NULL);
+    ASSERT_EQ(ruleset_phase->prefilter, crule->chained->prefilter);
+    ASSERT_EQ(1U, crule->chained->prefilter_slot);
+
+    /* Patterns without literals are always run */
+    ASSERT_TRUE(ruleset_phase->rules[1].prefilter == NULL);
+    ASSERT_EQ(ruleset_phase->prefilter, ruleset_phase->rules[2].prefilter);
+    ASSERT_EQ(2U, ruleset_phase->rules[2].prefilter_slot);
+    ASSERT_TRUE(ruleset_phase->rules[3].prefilter == NULL);
+}
+
+TEST_F(RuleCompiledTest, bodyTargets)
+{
+    ib_context_t *ctx;
+    const ib_rule_body_targets_t *targets;
+    ib_tfn_t *url_decode;
+    ib_tfn_t *lowercase;
+
+    configureIronBeeByString(
+        "LogLevel 1\n"
+        "LoadModule \"ibmod_htp.so\"\n"
+        "LoadModule \"ibmod_pcre.so\"\n"
+        "LoadModule \"ibmod_rules.so\"\n"
+        "SensorId B9C1B52B-C24A-4309-B9F9-0EF4CD577A3E\n"
+        "SensorName UnitTesting\n"
+        "SensorHostname unit-testing.sensor.tld\n"
+        "AuditEngine Off\n"
+        "Set parser \"htp\"\n"
+        "<Site test-site>\n"
+        "SiteId AAAABBBB-1111-2222-3333-000000000000\n"
+        "Hostname *\n"
+        "Rule REQUEST_BODY.t:urlDecode() @rx \"<script\" "
+        "id:1 phase:REQUEST setvar:a=1\n"
+        "Rule request_body.t:urlDecode().t:lowercase() @rx \"select\" "
+        "id:2 phase:REQUEST setvar:b=1\n"
+        "Rule REQUEST_BODY.t:lowercase() @rx \"union\" "
+        "id:3 phase:POSTPROCESS setvar:c=1\n"
+        "Rule REQUEST_BODY.t:compressWhitespace() @rx \"a b\" "
+        "id:4 phase:REQUEST setvar:d=1\n"
+        "Rule RESPONSE_BODY @rx \"error\" "
+        "id:5 phase:RESPONSE setvar:e=1\n"
+        "</Site>\n");
+    ctx = locationContext();
+    ASSERT_TRUE(ctx != NULL);
+    ASSERT_EQ(IB_OK, ib_tfn_lookup(ib_engine, "urlDecode", &url_decode));
+    ASSERT_EQ(IB_OK, ib_tfn_lookup(ib_engine, "lowercase", &lowercase));
+
+    /* Only the distinct, streamable first transformations are collected */
+    targets = &(ctx->rules->request_body);
+    ASSERT_TRUE(targets->targeted);
+    ASSERT_EQ(2U, targets->num_tfns);
+    ASSERT_EQ(url_decode, targets->tfns[0]);
+    ASSERT_EQ(lowercase, targets->tfns[1]);
+
+    targets = &(ctx->rules->response_body);
+    ASSERT_TRUE(targets->targeted);
+    ASSERT_EQ(0U, targets->num_tfns);
+
+    ASSERT_FALSE(ib_context_main(ib_engine)->rules->request_body.targeted);
+}
+
+TEST_F(RuleCompiledTest, tfnCacheInPlaceMutation)
+{
+    ib_conn_t  *conn;
+    ib_field_t *f;
+
+    ASSERT_EQ(IB_OK, ib_action_register(ib_engine, "mutate",
+                                        IB_ACT_FLAG_NONE,
+                                        NULL, NULL,
+                                        NULL, NULL,
+                                        mutateAction, NULL));
+    configureIronBeeByString(
+        "LogLevel 1\n"
+        "LoadModule \"ibmod_htp.so\"\n"
+        "LoadModule \"ibmod_rules.so\"\n"
+        "SensorId B9C1B52B-C24A-4309-B9F9-0EF4CD577A3E\n"
+        "SensorName UnitTesting\n"
+        "SensorHostname unit-testing.sensor.tld\n"
+        "AuditEngine Off\n"
+        "Set parser \"htp\"\n"
+        "<Site test-site>\n"
+        "SiteId AAAABBBB-1111-2222-3333-000000000000\n"
+        "Hostname *\n"
+        "Rule REQUEST_METHOD @streq \"GET\" "
+        "id:1 phase:REQUEST_HEADER setvar:s=abc\n"
+        "Rule s.t:lowercase() @streq \"abc\" "
+        "id:2 phase:REQUEST_HEADER mutate\n"
+        "Rule s.t:lowercase() @streq \"xyz\" "
+        "id:3 phase:REQUEST_HEADER setvar:hit=1\n"
+        "</Site>\n");
+
+    conn = buildIronBeeConnection();
+    sendDataIn(conn,
+               "GET / HTTP/1.1\r\n"
+               "Host: UnitTest\r\n"
+               "\r\n");
+    ASSERT_TRUE(conn->tx != NULL);
+
+    /* Rule 3 must see the new value, not the result cached by rule 2. */
+    ASSERT_EQ(IB_OK, ib_data_get(conn->tx->data, "hit", &f));
+
+    ib_state_notify_conn_closed(ib_engine, conn);
+}
+
+TEST_F(RuleCompiledTest, prefilterInPlaceMutation)
+{
+    ib_conn_t  *conn;
+    ib_field_t *f;
+
+    ASSERT_EQ(IB_OK, ib_action_register(ib_engine, "mutate",
+                                        IB_ACT_FLAG_NONE,
+                                        NULL, NULL,
+                                        NULL, NULL,
+                                        mutateAction, NULL));
+    configureIronBeeByString(
+        "LogLevel 1\n"
+        "LoadModule \"ibmod_htp.so\"\n"
+        "LoadModule \"ibmod_pcre.so\"\n"
+        "LoadModule \"ibmod_rules.so\"\n"
+        "SensorId B9C1B52B-C24A-4309-B9F9-0EF4CD577A3E\n"
+        "SensorName UnitTesting\n"
+        "SensorHostname unit-testing.sensor.tld\n"
+        "AuditEngine Off\n"
+        "Set parser \"htp\"\n"
+        "RulePrefilter On\n"
+        "<Site test-site>\n"
+        "SiteId AAAABBBB-1111-2222-3333-000000000000\n"
+        "Hostname *\n"
+        "Rule REQUEST_METHOD @streq \"GET\" "
+        "id:1 phase:REQUEST_HEADER setvar:s=abc\n"
+        "Rule s @rx \"abc\" "
+        "id:2 phase:REQUEST_HEADER mutate\n"
+        "Rule s @rx \"XYZ\" "
+        "id:3 phase:REQUEST_HEADER setvar:hit=1\n"
+        "</Site>\n");
+
+    conn = buildIronBeeConnection();
+    sendDataIn(conn,
+               "GET / HTTP/1.1\r\n"
+               "Host: UnitTest\r\n"
+               "\r\n");
+    ASSERT_TRUE(conn->tx != NULL);
+
+    /* Rule 3 must be checked against the new value, not skipped by the
+     * prefilter result cached for the old one by rule 2. */
+    ASSERT_EQ(IB_OK, ib_data_get(conn->tx->data, "hit", &f));
+
+    ib_state_notify_conn_closed(ib_engine, conn);
+}
@@ -0,0 +1,190 @@
+//////////////////////////////////////////////////////////////////////////////
+// Licensed to Qualys, Inc. (QUALYS) under one or more
+// contributor license agreements.  See the NOTICE file distributed with
+// this work for additional information regarding copyright ownership.
+// QUALYS licenses this file to You under the Apache License, Version 2.0
+// (the "License"); you may not use this file except in compliance with
+// the License.  You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//////////////////////////////////////////////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////
+/// @file
+/// @brief IronBee --- Rule prefilter tests
+//////////////////////////////////////////////////////////////////////////////
+
+#include "ironbee_config_auto.h"
+
+#include <ironbee/util.h>
+
+#include "rule_prefilter_private.h"
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+class TestRulePrefilter : public ::testing::Test
+{
+public:
+    TestRulePrefilter()
+    {
+        ib_status_t rc;
+
+        ib_util_initialize();
+
+        rc = ib_mpool_create(&m_pool, NULL, NULL);
+        if (rc != IB_OK) {
+            throw std::runtime_error("Failed to create mpool.");
+        }
+    }
+
+    ~TestRulePrefilter()
+    {
+        ib_mpool_destroy(m_pool);
+        ib_util_shutdown();
+    }
+
+    /**
+     * Extract the literals of @a pattern, sorted and joined by spaces.
+     *
+     * Returns "-" if the pattern is declined.
+     */
+    std::string literals(const char *pattern)
+    {
+        ib_list_t *list;
+        const ib_list_node_t *node;
+        std::vector<std::string> found;
+        std::string result;
+        ib_status_t rc;
+
+        rc = ib_list_create(&list, m_pool);
+        if (rc != IB_OK) {
+            throw std::runtime_error("Failed to create list.");
+        }
+        rc = ib_rule_prefilter_literals(m_pool, pattern, list);
+        if (rc == IB_DECLINED) {
+            return "-";
+        }
+        if (rc != IB_OK) {
+            throw std::runtime_error("Failed to extract literals.");
+        }
+        IB_LIST_LOOP_CONST(list, node) {
+            found.push_back((const char *)node->data);
+        }
+        std::sort(found.begin(), found.end());
+        for (size_t n = 0;  n < found.size();  ++n) {
+            result += (n == 0 ? "" : " ") + found[n];
+        }
+        return result;
+    }
+
+protected:
+    ib_mpool_t* m_pool;
+};
+
+TEST_F(TestRulePrefilter, literals)
+{
+    ASSERT_EQ("select", literals("select"));
+    ASSERT_EQ("select", literals("\\bunion\\s+select\\b"));
+    ASSERT_EQ("select", literals("^(?i)select\\s"));
+    ASSERT_EQ("<script", literals("<script[^>]*>"));
+    ASSERT_EQ("etc/passwd", literals("etc/passwd"));
+    ASSERT_EQ("/etc/passwd", literals("/etc/passwd"));
+    ASSERT_EQ("../", literals("\\.\\./"));
+    ASSERT_EQ("exec xp_", literals("(?:exec|xp_)\\w+"));
+    ASSERT_EQ("alert onload", literals("(onload|alert)\\s*\\("));
+    ASSERT_EQ("abcd", literals("abcde?fg"));
+    ASSERT_EQ("abcd", literals("abcd+efg"));
+    ASSERT_EQ("aaaab", literals("aaaab{2,}c"));
+    ASSERT_EQ("a{b}c", literals("a{b}c"));
+    ASSERT_EQ("[[:alpha:]]", literals("\\[\\[:alpha:\\]\\][[:digit:]]"));
+    ASSERT_EQ("bar foo", literals("(?<name>foo|bar)x"));
+    ASSERT_EQ("bbbb", literals("(?:aaa)?bbbb"));
+    ASSERT_EQ("tab\there", literals("tab\\there"));
+}
+
+TEST_F(TestRulePrefilter, declined)
+{
+    // Too short
+    ASSERT_EQ("-", literals("ab"));
+    ASSERT_EQ("-", literals("a.b.c"));
+    ASSERT_EQ("-", literals("\\d+"));
+    // A branch without literals
+    ASSERT_EQ("-", literals("foo|\\d+"));
+    ASSERT_EQ("-", literals("(foo|)x"));
+    // Optional
+    ASSERT_EQ("-", literals("(?:abcdef)*"));
+    ASSERT_EQ("-", literals("abc?"));
+    // Unsupported syntax
+    ASSERT_EQ("-", literals("foo(?=bar)"));
+    ASSERT_EQ("-", literals("foo(?<!bar)"));
+    ASSERT_EQ("-", literals("(foo)\\1bar"));
+    ASSERT_EQ("-", literals("\\x41BCDEF"));
+    ASSERT_EQ("-", literals("\\QABC\\E"));
+    ASSERT_EQ("-", literals("(?x) f o o"));
+    ASSERT_EQ("-", literals("(*UTF8)foobar"));
+    // Malformed
+    ASSERT_EQ("-", literals("(foobar"));
+    ASSERT_EQ("-", literals("foobar)"));
+    ASSERT_EQ("-", literals("[foobar"));
+    ASSERT_EQ("-", literals("*foobar"));
+}
+
+TEST_F(TestRulePrefilter, scan)
+{
+    ib_rule_prefilter_t *pf;
+    size_t slot;
+    uint8_t result[2];
+
+    ASSERT_EQ(IB_OK, ib_rule_prefilter_create(m_pool, &pf));
+    ASSERT_EQ(IB_OK, ib_rule_prefilter_add(pf, "union\\s+select", &slot));
+    ASSERT_EQ(0UL, slot);
+    ASSERT_EQ(IB_DECLINED, ib_rule_prefilter_add(pf, "\\d+", &slot));
+    ASSERT_EQ(IB_OK, ib_rule_prefilter_add(pf, "(?:select|insert)\\s", &slot));
+    ASSERT_EQ(1UL, slot);
+    ASSERT_EQ(IB_OK, ib_rule_prefilter_add(pf, "<script", &slot));
+    ASSERT_EQ(2UL, slot);
+    for (size_t n = 3;  n < 10;  ++n) {
+        std::string pattern = "literal" + std::string(1, 'a' + n);
+        ASSERT_EQ(IB_OK,
+                  ib_rule_prefilter_add(pf, pattern.c_str(), &slot));
+        ASSERT_EQ(n, slot);
+    }
+    ASSERT_EQ(10UL, ib_rule_prefilter_slots(pf));
+    ASSERT_EQ(2UL, IB_RULE_PREFILTER_RESULT_SIZE(pf));
+
+    ASSERT_EQ(IB_EINVAL, ib_rule_prefilter_scan(pf, "x", 1, result));
+    ASSERT_EQ(IB_OK, ib_rule_prefilter_finish(pf));
+    ASSERT_EQ(IB_EINVAL, ib_rule_prefilter_add(pf, "foobar", &slot));
+
+    const char *data = "1 UNION SELECT 2";
+    ASSERT_EQ(IB_OK, ib_rule_prefilter_scan(pf, data, strlen(data), result));
+    ASSERT_TRUE(IB_RULE_PREFILTER_TEST(result, 0));
+    ASSERT_TRUE(IB_RULE_PREFILTER_TEST(result, 1));
+    ASSERT_FALSE(IB_RULE_PREFILTER_TEST(result, 2));
+
+    data = "<ScRiPt>literalj</script>";
+    ASSERT_EQ(IB_OK, ib_rule_prefilter_scan(pf, data, strlen(data), result));
+    ASSERT_FALSE(IB_RULE_PREFILTER_TEST(result, 0));
+    ASSERT_FALSE(IB_RULE_PREFILTER_TEST(result, 1));
+    ASSERT_TRUE(IB_RULE_PREFILTER_TEST(result, 2));
+    for (size_t n = 3;  n < 9;  ++n) {
+        ASSERT_FALSE(IB_RULE_PREFILTER_TEST(result, n));
+    }
+    ASSERT_TRUE(IB_RULE_PREFILTER_TEST(result, 9));
+
+    data = "nothing to see here";
+    ASSERT_EQ(IB_OK, ib_rule_prefilter_scan(pf, data, strlen(data), result));
+    ASSERT_EQ(0, result[0]);
+    ASSERT_EQ(0, result[1]);
+}
@@ -31,7 +31,11 @@
 #include "gtest/gtest.h"
 #include "gtest/gtest-spi.h"
 
+#include <algorithm>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 class TestIBUtilAhoCorasick : public ::testing::Test
 {
@@ -411,8 +415,9 @@ TEST_F(TestIBUtilAhoCorasick, ib_ac_consume_multiple_common_prefix)
     );
     ASSERT_EQ(IB_OK, rc);
 
+    /* Expen, pen, Expensive, sive and ve */
     ASSERT_TRUE(ac_mctx.match_list);
-    ASSERT_EQ(4UL, ib_list_elements(ac_mctx.match_list));
+    ASSERT_EQ(5UL, ib_list_elements(ac_mctx.match_list));
 }
 
 /// @test Check the list of matches
@@ -547,3 +552,215 @@ TEST_F(TestIBUtilAhoCorasick, ib_ac_consume_contained_patterns)
     ASSERT_TRUE(ac_mctx.match_list != NULL);
     ASSERT_EQ(9UL, ib_list_elements(ac_mctx.match_list));
 }
+
+/// Count the matches of @a text against @a patterns with ib_ac_consume().
+static size_t consume_count(ib_mpool_t *mp,
+                            const char * const *patterns,
+                            size_t num_patterns,
+                            const char *text)
+{
+    ib_ac_t *ac_tree = NULL;
+    ib_ac_context_t ac_mctx;
+
+    if (ib_ac_create(&ac_tree, 0, mp) != IB_OK) {
+        return 0;
+    }
+    for (size_t n = 0;  n < num_patterns;  ++n) {
+        ib_ac_add_pattern(ac_tree, patterns[n], NULL,
+                          (void *)patterns[n], 0);
+    }
+    ib_ac_build_links(ac_tree);
+    ib_ac_init_ctx(&ac_mctx, ac_tree);
+    ib_ac_consume(&ac_mctx, text, strlen(text),
+                  IB_AC_FLAG_CONSUME_DOLIST | IB_AC_FLAG_CONSUME_MATCHALL,
+                  mp);
+
+    return (ac_mctx.match_list == NULL) ?
+        0 : ib_list_elements(ac_mctx.match_list);
+}
+
+/// @test Check matches that are only reachable through the fail chain
+TEST_F(TestIBUtilAhoCorasick, ib_ac_consume_fail_chain)
+{
+    /* "cX" is found through the fail state of "bc" */
+    const char *patterns1[] = { "abcX", "bcY", "cX" };
+    ASSERT_EQ(2UL, consume_count(m_pool, patterns1, 3, "abcX"));
+
+    /* The fail state of "abc" must be "bc", even if "bc" can't go
+     * anywhere "abc" can't */
+    const char *patterns2[] = { "abcX", "bcX", "cY" };
+    ASSERT_EQ(1UL, consume_count(m_pool, patterns2, 3, "abcY"));
+
+    /* "bc" is found inside "abcd", whose "abc" state is not an output */
+    const char *patterns3[] = { "abcd", "bc" };
+    ASSERT_EQ(1UL, consume_count(m_pool, patterns3, 2, "abcx"));
+}
+
+/// Collect ib_ac_scan() matches.
+static void scan_collect(const void *data, void *cbdata)
+{
+    std::string *matches = reinterpret_cast<std::string *>(cbdata);
+
+    matches->append(reinterpret_cast<const char *>(data));
+    matches->append(" ");
+}
+
+/// @test Check ib_ac_scan()
+TEST_F(TestIBUtilAhoCorasick, ib_ac_scan)
+{
+    ib_status_t rc;
+    ib_ac_t *ac_tree = NULL;
+    std::string matches;
+
+    rc = ib_ac_create(&ac_tree, IB_AC_FLAG_PARSER_NOCASE, m_pool);
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_EQ(IB_OK, ib_ac_add_pattern(ac_tree, "he", NULL, (void *)"he", 0));
+    ASSERT_EQ(IB_OK, ib_ac_add_pattern(ac_tree, "she", NULL, (void *)"she", 0));
+    ASSERT_EQ(IB_OK, ib_ac_add_pattern(ac_tree, "his", NULL, (void *)"his", 0));
+    ASSERT_EQ(IB_OK,
+              ib_ac_add_pattern(ac_tree, "hers", NULL, (void *)"hers", 0));
+
+    /* Links must be built first */
+    ASSERT_EQ(IB_EINVAL,
+              ib_ac_scan(ac_tree, "shershis", 8, scan_collect, &matches));
+    ASSERT_EQ(IB_OK, ib_ac_build_links(ac_tree));
+
+    ASSERT_EQ(IB_OK,
+              ib_ac_scan(ac_tree, "sHeRsHiS", 8, scan_collect, &matches));
+    ASSERT_EQ("she he hers his ", matches);
+
+    /* Scanning does not change the matcher; a second scan is the same */
+    matches.clear();
+    ASSERT_EQ(IB_OK,
+              ib_ac_scan(ac_tree, "sHeRsHiS", 8, scan_collect, &matches));
+    ASSERT_EQ("she he hers his ", matches);
+
+    matches.clear();
+    ASSERT_EQ(IB_ENOENT,
+              ib_ac_scan(ac_tree, "xyzzy", 5, scan_collect, &matches));
+    ASSERT_TRUE(matches.empty());
+}
+
+/// Build a matcher for @a patterns, with a DFA if @a dfa.
+static ib_ac_t *build(ib_mpool_t *mp,
+                      uint8_t flags,
+                      const std::vector<std::string> &patterns,
+                      bool dfa)
+{
+    ib_ac_t *ac_tree = NULL;
+
+    if (ib_ac_create(&ac_tree, flags, mp) != IB_OK) {
+        throw std::runtime_error("Failed to create matcher.");
+    }
+    for (size_t n = 0;  n < patterns.size();  ++n) {
+        ib_ac_add_pattern(ac_tree, patterns[n].c_str(), NULL,
+                          (void *)patterns[n].c_str(), 0);
+    }
+    if (ib_ac_build_links(ac_tree) != IB_OK ||
+        (dfa && ib_ac_build_dfa(ac_tree, 0) != IB_OK))
+    {
+        throw std::runtime_error("Failed to build matcher.");
+    }
+    return ac_tree;
+}
+
+/// Describe the matches of @a text, consumed in chunks of @a chunk.
+static std::string consume_matches(ib_mpool_t *mp,
+                                   ib_ac_t *ac_tree,
+                                   const std::string &text,
+                                   size_t chunk)
+{
+    ib_ac_context_t ac_mctx;
+    const ib_list_node_t *node;
+    std::ostringstream out;
+
+    ib_ac_init_ctx(&ac_mctx, ac_tree);
+    for (size_t n = 0;  n < text.length();  n += chunk) {
+        ib_ac_consume(&ac_mctx, text.data() + n,
+                      std::min(chunk, text.length() - n),
+                      IB_AC_FLAG_CONSUME_DOLIST | IB_AC_FLAG_CONSUME_MATCHALL,
+                      mp);
+    }
+    if (ac_mctx.match_list != NULL) {
+        IB_LIST_LOOP_CONST(ac_mctx.match_list, node) {
+            const ib_ac_match_t *mt =
+                (const ib_ac_match_t *)ib_list_node_data_const(node);
+            out << std::string(mt->pattern, mt->pattern_len)
+                << "@" << mt->offset << " ";
+        }
+    }
+    return out.str();
+}
+
+/// @test Check that the DFA matches exactly as the trie does
+TEST_F(TestIBUtilAhoCorasick, ib_ac_build_dfa)
+{
+    std::vector<std::string> patterns;
+    std::string text;
+
+    /* Overlapping patterns over a small alphabet, plus some binary. */
+    srand(17);
+    for (size_t n = 0;  n < 300;  ++n) {
+        std::string p;
+        size_t len = 1 + rand() % 6;
+        for (size_t i = 0;  i < len;  ++i) {
+            p += (char)("abcdAB\xe9" "0"[rand() % 8]);
+        }
+        patterns.push_back(p);
+    }
+    for (size_t n = 0;  n < 2000;  ++n) {
+        text += (char)("abcdeABCD\xe9\xc9" "0 "[rand() % 13]);
+    }
+
+    for (int nocase = 0;  nocase < 2;  ++nocase) {
+        uint8_t flags = nocase ? IB_AC_FLAG_PARSER_NOCASE : 0;
+        ib_ac_t *trie = build(m_pool, flags, patterns, false);
+        ib_ac_t *dfa = build(m_pool, flags, patterns, true);
+        std::string scanned_trie;
+        std::string scanned_dfa;
+
+        ASSERT_TRUE(trie->dfa == NULL);
+        ASSERT_TRUE(dfa->dfa != NULL);
+
+        std::string expected = consume_matches(m_pool, trie, text, 7);
+        ASSERT_FALSE(expected.empty());
+        ASSERT_EQ(expected, consume_matches(m_pool, dfa, text, 7));
+        ASSERT_EQ(expected, consume_matches(m_pool, dfa, text, 1));
+        ASSERT_EQ(expected, consume_matches(m_pool, dfa, text, text.length()));
+
+        ASSERT_EQ(IB_OK, ib_ac_scan(trie, text.data(), text.length(),
+                                    scan_collect, &scanned_trie));
+        ASSERT_EQ(IB_OK, ib_ac_scan(dfa, text.data(), text.length(),
+                                    scan_collect, &scanned_dfa));
+        ASSERT_EQ(scanned_trie, scanned_dfa);
+    }
+}
+
+/// @test Check ib_ac_build_dfa() limits and errors
+TEST_F(TestIBUtilAhoCorasick, ib_ac_build_dfa_limits)
+{
+    ib_ac_t *ac_tree = NULL;
+    ib_ac_context_t ac_mctx;
+
+    ASSERT_EQ(IB_EINVAL, ib_ac_build_dfa(NULL, 0));
+
+    ASSERT_EQ(IB_OK, ib_ac_create(&ac_tree, 0, m_pool));
+    ASSERT_EQ(IB_OK, ib_ac_add_pattern(ac_tree, "he", NULL, NULL, 0));
+    ASSERT_EQ(IB_OK, ib_ac_add_pattern(ac_tree, "she", NULL, NULL, 0));
+    ASSERT_EQ(IB_EINVAL, ib_ac_build_dfa(ac_tree, 0));
+    ASSERT_EQ(IB_OK, ib_ac_build_links(ac_tree));
+
+    /* 6 states x 4 classes x 4 bytes */
+    ASSERT_EQ(IB_DECLINED, ib_ac_build_dfa(ac_tree, 95));
+    ASSERT_TRUE(ac_tree->dfa == NULL);
+    ASSERT_EQ(IB_OK, ib_ac_build_dfa(ac_tree, 96));
+    ASSERT_TRUE(ac_tree->dfa != NULL);
+    ASSERT_EQ(IB_OK, ib_ac_build_dfa(ac_tree, 96));
+
+    /* First match only */
+    ib_ac_init_ctx(&ac_mctx, ac_tree);
+    ASSERT_EQ(IB_OK, ib_ac_consume(&ac_mctx, "xshex", 5, 0, m_pool));
+    ASSERT_EQ(4UL, ac_mctx.processed);
+    ASSERT_EQ(IB_ENOENT, ib_ac_consume(&ac_mctx, "x", 1, 0, m_pool));
+    ASSERT_EQ(5UL, ac_mctx.processed);
+}
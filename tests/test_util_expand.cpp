@@ -35,6 +35,8 @@
 #include <ironbee/bytestr.h>
 #include <ironbee/hash.h>
 
+#include <cctype>
+#include <cstring>
 #include <stdexcept>
 #include <string>
 
@@ -72,6 +74,7 @@ public:
             { "Key6", IB_FTYPE_NUM,     NULL,     -1 },
             { "Ref1", IB_FTYPE_NULSTR,  "Key1",    0 },
             { "Ref2", IB_FTYPE_NULSTR,  "Key",     0 },
+            { "Ref3", IB_FTYPE_NULSTR,  "%{Key1}", 0 },
             { NULL,   IB_FTYPE_GENERIC, NULL,      0 },
         };
         ib_status_t rc;
@@ -506,3 +509,167 @@ TEST_F(TestIBUtilExpandTestStr, test_expand_test_str)
     RunTest(__LINE__, "text:${Key1}",     "${", "}",  true);
     RunTest(__LINE__, "text:%{Key2}",     "%{", "}",  true);
 }
+
+class TestIBUtilExpandTemplate : public TestIBUtilExpand
+{
+public:
+    /* Resolve "KeyN" to N, and everything else to -1. */
+    static int Resolve(const char *name, size_t nlen)
+    {
+        if ( (nlen == 4) && (strncmp(name, "Key", 3) == 0) &&
+             isdigit(name[3]) )
+        {
+            return name[3] - '0';
+        }
+        return -1;
+    }
+
+    static ib_status_t Lookup(const void *data,
+                              int id,
+                              const char *name,
+                              size_t nlen,
+                              ib_field_t **pf)
+    {
+        if (id != Resolve(name, nlen)) {
+            throw std::logic_error("Name resolved to the wrong ID.");
+        }
+        return ib_hash_get_ex((const ib_hash_t *)data, pf, name, nlen);
+    }
+
+    std::string ExpandTemplate(const char *text,
+                               const char *prefix,
+                               const char *suffix)
+    {
+        ib_expand_template_t *tmpl;
+        char *result;
+        size_t len;
+        ib_status_t rc;
+
+        rc = ib_expand_template_create(MemPool(), text, strlen(text),
+                                       prefix, suffix, Resolve, &tmpl);
+        if (rc != IB_OK) {
+            throw std::runtime_error("Failed to create template.");
+        }
+        rc = ib_expand_template_str(MemPool(), tmpl, false,
+                                    Lookup, m_hash, &result, &len);
+        if (rc != IB_OK) {
+            throw std::runtime_error("Failed to expand template.");
+        }
+        return std::string(result, len);
+    }
+
+    /* A template must expand exactly as ib_expand_str() without recursion */
+    void RunTest(ib_num_t lineno,
+                 const char *text,
+                 const char *prefix,
+                 const char *suffix)
+    {
+        char *expected;
+        ib_status_t rc;
+
+        rc = ::ib_expand_str(MemPool(), text, prefix, suffix, false,
+                             m_hash, &expected);
+        ASSERT_EQ(IB_OK, rc);
+        EXPECT_EQ(expected, ExpandTemplate(text, prefix, suffix))
+            << "Test defined on line " << lineno << " failed";
+    }
+};
+
+TEST_F(TestIBUtilExpandTemplate, test_template_errors)
+{
+    ib_expand_template_t *tmpl;
+
+    ASSERT_EQ(IB_EINVAL,
+              ib_expand_template_create(MemPool(), "%{foo}", 6, "", "}",
+                                        NULL, &tmpl));
+    ASSERT_EQ(IB_EINVAL,
+              ib_expand_template_create(MemPool(), "%{foo}", 6, "%{", "",
+                                        NULL, &tmpl));
+}
+
+TEST_F(TestIBUtilExpandTemplate, test_template_expand)
+{
+    RunTest(__LINE__, "",                 "%{", "}");
+    RunTest(__LINE__, "simple text",      "%{", "}");
+    RunTest(__LINE__, "text:%{Key1}",     "%{", "}");
+    RunTest(__LINE__, "text:%{Key1}",     "$(", ")");
+    RunTest(__LINE__, "text:<<Key1>>",    "<<", ">>");
+    RunTest(__LINE__, "%{Key1}:%{Key2}==%{Key3}", "%{", "}");
+    RunTest(__LINE__, "%{Key4}-%{Key6}+%{Key5}",  "%{", "}");
+    RunTest(__LINE__, "%{}",              "%{", "}");
+    RunTest(__LINE__, "%{}%{",            "%{", "}");
+    RunTest(__LINE__, "%{}}",             "%{", "}");
+    RunTest(__LINE__, "%%{Key1}",         "%{", "}");
+    RunTest(__LINE__, "%{%{DNE}",         "%{", "}");
+    RunTest(__LINE__, "%{%{Key1}}",       "%{", "}");
+    RunTest(__LINE__, "%{%{Ref2}2}",      "%{", "}");
+    RunTest(__LINE__, "text:%{Key11}",    "%{", "}");
+    RunTest(__LINE__, "%{Key9}",          "%{", "}");
+}
+
+TEST_F(TestIBUtilExpandTemplate, test_template_norecurse)
+{
+    /* Names brought in by values are expanded, as by ib_expand_str(). */
+    ASSERT_EQ("Key1", ExpandTemplate("%{Ref1}", "%{", "}"));
+    ASSERT_EQ("Value1", ExpandTemplate("%{Ref3}", "%{", "}"));
+    RunTest(__LINE__, "%{Ref3}",          "%{", "}");
+    RunTest(__LINE__, "a%{Ref3}b%{Key2}", "%{", "}");
+    RunTest(__LINE__, "%{Ref3}%{",        "%{", "}");
+    RunTest(__LINE__, "%{Key1}%{Ref3}",   "%{", "}");
+    RunTest(__LINE__, "%%{Ref2}{1}",      "%{", "}");
+    RunTest(__LINE__, "%%{DNE}{Key1}",    "%{", "}");
+    RunTest(__LINE__, "%%{}{Key2}",       "%{", "}");
+    RunTest(__LINE__, "%{Ref2}1}",        "%{", "}");
+    RunTest(__LINE__, "<<<Key1>>",        "<<", ">>");
+    RunTest(__LINE__, "<<<<Key1>>>>",     "<<", ">>");
+}
+
+TEST_F(TestIBUtilExpandTemplate, test_template_many_refs)
+{
+    std::string text;
+    std::string expected;
+
+    for (int n = 0; n < 20; ++n) {
+        text += "%{Key1}.%{Key4}";
+        expected += "Value1.0";
+    }
+    ASSERT_EQ(expected, ExpandTemplate(text.c_str(), "%{", "}"));
+}
+
+TEST_F(TestIBUtilExpandTemplate, test_template_nul)
+{
+    ib_expand_template_t *tmpl;
+    char *result;
+    size_t len;
+
+    ASSERT_EQ(IB_OK,
+              ib_expand_template_create(MemPool(), "a%{Key2}b", 9, "%{", "}",
+                                        Resolve, &tmpl));
+    ASSERT_EQ(IB_OK,
+              ib_expand_template_str(MemPool(), tmpl, true, Lookup, m_hash,
+                                     &result, &len));
+    ASSERT_EQ(8UL, len);
+    ASSERT_STREQ("aValue2b", result);
+}
+
+TEST_F(TestIBUtilExpandTemplate, test_template_is_expandable)
+{
+    ib_expand_template_t *tmpl;
+
+    ASSERT_EQ(IB_OK,
+              ib_expand_template_create(MemPool(), "text", 4, "%{", "}",
+                                        NULL, &tmpl));
+    ASSERT_FALSE(ib_expand_template_is_expandable(tmpl));
+    ASSERT_EQ(IB_OK,
+              ib_expand_template_create(MemPool(), "%{text", 6, "%{", "}",
+                                        NULL, &tmpl));
+    ASSERT_FALSE(ib_expand_template_is_expandable(tmpl));
+    ASSERT_EQ(IB_OK,
+              ib_expand_template_create(MemPool(), "%{}", 3, "%{", "}",
+                                        NULL, &tmpl));
+    ASSERT_TRUE(ib_expand_template_is_expandable(tmpl));
+    ASSERT_EQ(IB_OK,
+              ib_expand_template_create(MemPool(), "a%{Key1}", 8, "%{", "}",
+                                        NULL, &tmpl));
+    ASSERT_TRUE(ib_expand_template_is_expandable(tmpl));
+}
@@ -531,3 +531,50 @@ TEST_F(TestIBUtilField, AliasBytestr)
     ASSERT_EQ(0, memcmp(s2,
                         ib_bytestr_const_ptr(obs), ib_bytestr_length(obs)) );
 }
+
+TEST_F(TestIBUtilField, Generation)
+{
+    ib_field_t *f;
+    ib_field_t *member;
+    ib_bytestr_t *bs;
+    const ib_bytestr_t *obs;
+    size_t gen;
+    ib_status_t rc;
+
+    rc = ib_field_create(&f, MemPool(), IB_FIELD_NAME("foo"),
+                         IB_FTYPE_BYTESTR, NULL);
+    ASSERT_EQ(IB_OK, rc);
+    rc = ib_bytestr_dup_nulstr(&bs, MemPool(), "abc");
+    ASSERT_EQ(IB_OK, rc);
+
+    /* Setting the value changes the generation. */
+    gen = ib_field_generation(f);
+    rc = ib_field_setv(f, bs);
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_NE(gen, ib_field_generation(f));
+
+    /* Reading does not. */
+    gen = ib_field_generation(f);
+    rc = ib_field_value(f, ib_ftype_bytestr_out(&obs));
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_EQ(gen, ib_field_generation(f));
+
+    /* In-place modification keeps the pointer but changes the generation. */
+    rc = ib_field_mutable_value(f, ib_ftype_bytestr_mutable_out(&bs));
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_EQ(obs, bs);
+    memcpy(ib_bytestr_ptr(bs), "xyz", 3);
+    ASSERT_NE(gen, ib_field_generation(f));
+
+    /* Adding to a list changes the list's generation. */
+    rc = ib_field_create(&f, MemPool(), IB_FIELD_NAME("list"),
+                         IB_FTYPE_LIST, NULL);
+    ASSERT_EQ(IB_OK, rc);
+    rc = ib_field_create(&member, MemPool(), IB_FIELD_NAME("member"),
+                         IB_FTYPE_NULSTR, ib_ftype_nulstr_in("a"));
+    ASSERT_EQ(IB_OK, rc);
+    gen = ib_field_generation(f);
+    rc = ib_field_list_add(f, member);
+    ASSERT_EQ(IB_OK, rc);
+    ASSERT_NE(gen, ib_field_generation(f));
+}
@@ -31,9 +31,15 @@
 #include "gtest/gtest-spi.h"
 #include "simple_fixture.hpp"
 
+#include <ironbee/clock.h>
 #include <ironbee/mpool.h>
 
+#include <algorithm>
+#include <iostream>
+#include <sstream>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 class TestIBUtilHash : public SimpleFixture
 {
@@ -437,3 +443,255 @@ TEST_F(TestIBUtilHash, bad_size) {
         ib_hashequal_default
     ));
 }
+
+//! Key @a prefix followed by @a n.
+static std::string numbered_key(const std::string& prefix, int n)
+{
+    std::ostringstream key;
+    key << prefix << n;
+    return key.str();
+}
+
+TEST_F(TestIBUtilHash, test_hashfunc_fast)
+{
+    static const char key1[] = "Request-Headers:Content-Type";
+    static const char key2[] = "request-headers:CONTENT-TYPE";
+
+    EXPECT_EQ(
+        ib_hashfunc_fast_nocase(key1, sizeof(key1) - 1, 17),
+        ib_hashfunc_fast_nocase(key2, sizeof(key2) - 1, 17)
+    );
+    EXPECT_NE(
+        ib_hashfunc_fast(key1, sizeof(key1) - 1, 17),
+        ib_hashfunc_fast(key2, sizeof(key2) - 1, 17)
+    );
+    EXPECT_NE(
+        ib_hashfunc_fast(key1, sizeof(key1) - 1, 17),
+        ib_hashfunc_fast(key1, sizeof(key1) - 1, 23)
+    );
+
+    // Only ASCII letters are downcased, as by ib_hashequal_nocase().
+    EXPECT_EQ(
+        ib_hashfunc_fast_nocase("[@\\]", 4, 17),
+        ib_hashfunc_fast_nocase("[@\\]", 4, 17)
+    );
+    EXPECT_NE(
+        ib_hashfunc_fast_nocase("[", 1, 17),
+        ib_hashfunc_fast_nocase("{", 1, 17)
+    );
+    EXPECT_NE(
+        ib_hashfunc_fast_nocase("\xc0", 1, 17),
+        ib_hashfunc_fast_nocase("\xe0", 1, 17)
+    );
+
+    // Trailing NULs are part of the key.
+    EXPECT_NE(
+        ib_hashfunc_fast("a", 1, 17),
+        ib_hashfunc_fast("a\0", 2, 17)
+    );
+}
+
+TEST_F(TestIBUtilHash, test_hash_open)
+{
+    ib_hash_t  *hash = NULL;
+    const char *val  = NULL;
+
+    ASSERT_EQ(IB_OK, ib_hash_create_open_nocase(&hash, MemPool()));
+    ASSERT_EQ(IB_OK, ib_hash_set(hash, "Key", (void *)"value"));
+    ASSERT_EQ(IB_OK, ib_hash_set(hash, "Other", (void *)"other"));
+    EXPECT_EQ(2UL, ib_hash_size(hash));
+
+    EXPECT_EQ(IB_OK, ib_hash_get(hash, &val, "kEY"));
+    EXPECT_STREQ("value", val);
+    EXPECT_EQ(IB_OK, ib_hash_get_ex(hash, &val, "OTHER", 5));
+    EXPECT_STREQ("other", val);
+    EXPECT_EQ(IB_ENOENT, ib_hash_get(hash, &val, "Ke"));
+    EXPECT_FALSE(val);
+
+    ASSERT_EQ(IB_OK, ib_hash_set(hash, "KEY", (void *)"value2"));
+    EXPECT_EQ(2UL, ib_hash_size(hash));
+    EXPECT_EQ(IB_OK, ib_hash_get(hash, &val, "key"));
+    EXPECT_STREQ("value2", val);
+
+    EXPECT_EQ(IB_OK, ib_hash_remove(hash, &val, "key"));
+    EXPECT_STREQ("value2", val);
+    EXPECT_EQ(1UL, ib_hash_size(hash));
+    EXPECT_EQ(IB_ENOENT, ib_hash_get(hash, &val, "key"));
+    EXPECT_EQ(IB_ENOENT, ib_hash_remove(hash, NULL, "key"));
+}
+
+TEST_F(TestIBUtilHash, test_hash_open_collision_delete)
+{
+    ib_hash_t  *hash = NULL;
+    const char *val  = NULL;
+    std::vector<std::string> keys;
+
+    // Every key in the same group, so the probe passes deleted slots.
+    ASSERT_EQ(IB_OK, ib_hash_create_layout(
+        &hash,
+        MemPool(),
+        IB_HASH_LAYOUT_OPEN,
+        16,
+        test_hash_delete_hashfunc,
+        ib_hashequal_default
+    ));
+
+    for (int i = 0; i < 40; ++i) {
+        keys.push_back(std::string(1, 'a' + (i % 26)) + char('0' + i / 26));
+    }
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(IB_OK, ib_hash_set(
+            hash, keys[i].c_str(), (void *)keys[i].c_str()
+        ));
+    }
+    EXPECT_EQ(keys.size(), ib_hash_size(hash));
+
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        ASSERT_EQ(IB_OK, ib_hash_set(hash, keys[i].c_str(), NULL));
+    }
+    EXPECT_EQ(keys.size() / 2, ib_hash_size(hash));
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (i % 2 == 0) {
+            EXPECT_EQ(IB_ENOENT, ib_hash_get(hash, &val, keys[i].c_str()));
+        }
+        else {
+            EXPECT_EQ(IB_OK, ib_hash_get(hash, &val, keys[i].c_str()));
+            EXPECT_EQ(keys[i].c_str(), val);
+        }
+    }
+}
+
+TEST_F(TestIBUtilHash, test_hash_open_churn)
+{
+    ib_hash_t *hash = NULL;
+    ib_list_t *list = NULL;
+    std::vector<std::string> keys;
+
+    ASSERT_EQ(IB_OK, ib_hash_create_open(&hash, MemPool()));
+
+    for (int i = 0; i < 2000; ++i) {
+        keys.push_back(numbered_key("key", i));
+    }
+
+    // Repeatedly fill and drain, leaving deleted slots behind.
+    for (int round = 0; round < 5; ++round) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            ASSERT_EQ(IB_OK, ib_hash_set(
+                hash, keys[i].c_str(), (void *)keys[i].c_str()
+            ));
+        }
+        EXPECT_EQ(keys.size(), ib_hash_size(hash));
+        for (size_t i = 0; i < keys.size(); ++i) {
+            char *val = NULL;
+            ASSERT_EQ(IB_OK, ib_hash_get(hash, &val, keys[i].c_str()));
+            ASSERT_EQ(keys[i].c_str(), val);
+        }
+        for (size_t i = round % 2; i < keys.size(); i += 2) {
+            ASSERT_EQ(IB_OK, ib_hash_remove(hash, NULL, keys[i].c_str()));
+        }
+        EXPECT_EQ(keys.size() / 2, ib_hash_size(hash));
+    }
+
+    ASSERT_EQ(IB_OK, ib_list_create(&list, MemPool()));
+    ASSERT_EQ(IB_OK, ib_hash_get_all(hash, list));
+    EXPECT_EQ(keys.size() / 2, ib_list_elements(list));
+
+    ib_hash_clear(hash);
+    EXPECT_EQ(0UL, ib_hash_size(hash));
+    ASSERT_EQ(IB_OK, ib_list_create(&list, MemPool()));
+    EXPECT_EQ(IB_ENOENT, ib_hash_get_all(hash, list));
+    for (size_t i = 0; i < keys.size(); ++i) {
+        char *val = NULL;
+        ASSERT_EQ(IB_ENOENT, ib_hash_get(hash, &val, keys[i].c_str()));
+    }
+}
+
+/**
+ * Time inserting and looking up @a num_keys keys in a case insensitive
+ * hash of the given layout.
+ *
+ * Keys are field names as in the transaction data.  Every fourth lookup
+ * misses.  About 5M lookups are done regardless of @a num_keys.
+ */
+static void benchmark_layout(size_t num_keys, bool open)
+{
+    static const char *prefixes[] = {
+        "request_headers:", "ARGS:", "tx:", "response_headers:"
+    };
+    const size_t lookups = 5000000;
+    const size_t rounds = std::max(lookups / num_keys, size_t(1));
+    std::vector<std::string> keys;
+    std::vector<std::string> misses;
+    ib_mpool_t *mp;
+    ib_hash_t  *hash = NULL;
+    ib_time_t   start;
+    ib_time_t   insert_usec;
+    ib_time_t   lookup_usec;
+    size_t      found = 0;
+
+    for (size_t i = 0; i < num_keys; ++i) {
+        keys.push_back(
+            numbered_key(prefixes[i % 4] + std::string("Field-"), i)
+        );
+        misses.push_back(
+            numbered_key(prefixes[i % 4] + std::string("Missing-"), i)
+        );
+    }
+
+    ASSERT_EQ(IB_OK, ib_mpool_create(&mp, "benchmark", NULL));
+    if (open) {
+        ASSERT_EQ(IB_OK, ib_hash_create_open_nocase(&hash, mp));
+    }
+    else {
+        ASSERT_EQ(IB_OK, ib_hash_create_nocase(&hash, mp));
+    }
+
+    start = ib_clock_get_time();
+    for (size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(IB_OK, ib_hash_set_ex(
+            hash, keys[i].data(), keys[i].length(), (void *)&keys[i]
+        ));
+    }
+    insert_usec = ib_clock_get_time() - start;
+
+    start = ib_clock_get_time();
+    for (size_t n = 0; n < rounds; ++n) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            const std::string& key = (i % 4 == 3) ? misses[i] : keys[i];
+            void *val;
+            if (
+                ib_hash_get_ex(hash, &val, key.data(), key.length()) ==
+                IB_OK
+            ) {
+                ++found;
+            }
+        }
+    }
+    lookup_usec = ib_clock_get_time() - start;
+
+    EXPECT_EQ(rounds * (keys.size() - keys.size() / 4), found);
+    std::cout << (open ? "open:    " : "chained: ")
+              << keys.size() << " keys: inserts "
+              << insert_usec << "us, "
+              << rounds * keys.size() << " lookups "
+              << lookup_usec / 1000 << "ms" << std::endl;
+
+    ib_mpool_destroy(mp);
+}
+
+/**
+ * Lookup micro-benchmark of the chained and open addressing layouts.
+ *
+ * 256 keys is a large transaction data store; the larger sizes show how
+ * the layouts scale once the table no longer fits in cache.
+ */
+TEST_F(TestIBUtilHash, benchmark)
+{
+    static const size_t sizes[] = { 64, 256, 4096, 100000 };
+
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i) {
+        benchmark_layout(sizes[i], false);
+        benchmark_layout(sizes[i], true);
+    }
+}
@@ -839,3 +839,311 @@ TEST(TestMpool, ReleaseComplex)
     ASSERT_EQ(g_malloc_calls, g_free_calls);
     ASSERT_EQ(g_malloc_bytes, g_free_bytes);
 }
+
+TEST(TestMpool, ThreadCache)
+{
+    ib_mpool_cache_stats_t before;
+    ib_mpool_cache_stats_t after;
+
+    ib_mpool_cache_flush();
+    ib_mpool_cache_stats(&before);
+    EXPECT_EQ(0U, before.pages);
+    EXPECT_EQ(0U, before.pools);
+
+    ib_mpool_t* mp = NULL;
+    ASSERT_EQ(IB_OK, ib_mpool_create(&mp, "thread_cache", NULL));
+
+    // Destroying a child hands its page and itself to the cache.
+    ib_mpool_t* child = NULL;
+    ASSERT_EQ(IB_OK, ib_mpool_create(&child, "thread_cache_child", mp));
+    EXPECT_TRUE(ib_mpool_alloc(child, 100));
+    ib_mpool_destroy(child);
+
+    ib_mpool_cache_stats(&after);
+    EXPECT_EQ(1U, after.pages);
+    EXPECT_EQ(1U, after.pools);
+    EXPECT_LE(1U, after.pages_high_water);
+    EXPECT_LE(1U, after.pools_high_water);
+
+    // The next child reuses both.
+    ASSERT_EQ(IB_OK, ib_mpool_create(&child, "thread_cache_child2", mp));
+    EXPECT_TRUE(ib_mpool_alloc(child, 100));
+    EXPECT_VALID(mp);
+
+    ib_mpool_cache_stats(&after);
+    EXPECT_EQ(0U, after.pages);
+    EXPECT_EQ(0U, after.pools);
+    EXPECT_EQ(before.page_hits + 1, after.page_hits);
+    EXPECT_EQ(before.pool_hits + 1, after.pool_hits);
+
+    // Releasing a child hands its pages to the cache but keeps the child
+    // on its parent.
+    ib_mpool_release(child);
+    EXPECT_VALID(mp);
+
+    ib_mpool_cache_stats(&after);
+    EXPECT_EQ(1U, after.pages);
+    EXPECT_EQ(0U, after.pools);
+
+    ASSERT_EQ(IB_OK, ib_mpool_create(&child, "thread_cache_child3", mp));
+    EXPECT_TRUE(ib_mpool_alloc(child, 100));
+    EXPECT_VALID(mp);
+
+    ib_mpool_cache_stats(&after);
+    EXPECT_EQ(0U, after.pages);
+    EXPECT_EQ(before.page_hits + 2, after.page_hits);
+    EXPECT_EQ(before.pool_hits + 1, after.pool_hits);
+
+    ib_mpool_destroy(mp);
+
+    ib_mpool_cache_stats(&after);
+    EXPECT_LT(0U, after.pages);
+    EXPECT_EQ(2U, after.pools);
+
+    // Flushing frees the cache but keeps the counters.
+    ib_mpool_cache_flush();
+    ib_mpool_cache_stats(&after);
+    EXPECT_EQ(0U, after.pages);
+    EXPECT_EQ(0U, after.pools);
+    EXPECT_EQ(before.page_hits + 2, after.page_hits);
+    EXPECT_LE(2U, after.pools_high_water);
+}
+
+TEST(TestMpool, ThreadCacheShutdown)
+{
+    ib_mpool_cache_stats_t stats;
+
+    ib_mpool_t* mp = NULL;
+    ASSERT_EQ(IB_OK, ib_mpool_create(&mp, "thread_cache_shutdown", NULL));
+    EXPECT_TRUE(ib_mpool_alloc(mp, 100));
+    ib_mpool_destroy(mp);
+    ib_mpool_cache_stats(&stats);
+    EXPECT_LT(0U, stats.pools);
+
+    // Shutdown frees the cache, counters and all.
+    ib_mpool_cache_shutdown();
+    ib_mpool_cache_stats(&stats);
+    EXPECT_EQ(0U, stats.pools);
+    EXPECT_EQ(0U, stats.pool_hits);
+    EXPECT_EQ(0U, stats.pools_high_water);
+
+    // Pools used afterwards get a new cache.
+    ASSERT_EQ(IB_OK, ib_mpool_create(&mp, "thread_cache_shutdown2", NULL));
+    EXPECT_TRUE(ib_mpool_alloc(mp, 100));
+    ib_mpool_destroy(mp);
+    ib_mpool_cache_stats(&stats);
+    EXPECT_EQ(1U, stats.pools);
+}
+
+namespace {
+
+void fill_cache_and_wait(boost::barrier& filled, boost::barrier& shut_down)
+{
+    ib_mpool_cache_stats_t stats;
+    ib_mpool_t* mp = NULL;
+
+    ASSERT_EQ(IB_OK, ib_mpool_create(&mp, "live_thread", NULL));
+    EXPECT_TRUE(ib_mpool_alloc(mp, 100));
+    ib_mpool_destroy(mp);
+    ib_mpool_cache_stats(&stats);
+    EXPECT_LT(0U, stats.pools);
+
+    filled.wait();
+    shut_down.wait();
+
+    // This thread's cache was freed by the main thread.
+    ib_mpool_cache_stats(&stats);
+    EXPECT_EQ(0U, stats.pools);
+}
+
+}
+
+TEST(TestMpool, ThreadCacheShutdownLiveThread)
+{
+    boost::barrier filled(2);
+    boost::barrier shut_down(2);
+
+    boost::thread thread(
+        boost::bind(
+            fill_cache_and_wait,
+            boost::ref(filled),
+            boost::ref(shut_down)
+        )
+    );
+
+    filled.wait();
+    ib_mpool_cache_shutdown();
+    shut_down.wait();
+    thread.join();
+}
+
+TEST(TestMpool, ThreadCacheCustomMalloc)
+{
+    reset_test();
+
+    ib_mpool_cache_stats_t before;
+    ib_mpool_cache_stats_t after;
+
+    ib_mpool_cache_flush();
+    ib_mpool_cache_stats(&before);
+
+    ib_mpool_t* mp = NULL;
+    ASSERT_EQ(IB_OK, ib_mpool_create_ex(&mp, "thread_cache_custom", NULL, 0,
+                                        &test_malloc, &test_free));
+    EXPECT_TRUE(ib_mpool_alloc(mp, 100));
+    ib_mpool_destroy(mp);
+
+    // Pools with their own malloc and free do not use the cache.
+    ib_mpool_cache_stats(&after);
+    EXPECT_EQ(0U, after.pages);
+    EXPECT_EQ(0U, after.pools);
+    EXPECT_EQ(before.page_misses, after.page_misses);
+    ASSERT_EQ(g_malloc_calls, g_free_calls);
+    ASSERT_EQ(g_malloc_bytes, g_free_bytes);
+}
+
+TEST(TestMpool, PolicyMediumAllocations)
+{
+    ib_mpool_policy_t policy;
+    memset(&policy, 0, sizeof(policy));
+    policy.role            = "medium";
+    policy.pagesize        = 16384;
+    policy.large_threshold = 8192;
+
+    ib_mpool_t* mp = NULL;
+    ASSERT_EQ(IB_OK, ib_mpool_create_policy(&mp, "policy", NULL, &policy));
+    ASSERT_TRUE(mp);
+
+    // Allocations up to the threshold come from pages, so can be written in
+    // full; larger ones are still large allocations.
+    for (size_t size = 1000; size <= 12000; size += 500) {
+        char* p = reinterpret_cast<char*>(ib_mpool_alloc(mp, size));
+        ASSERT_TRUE(p);
+        memset(p, 'x', size);
+        EXPECT_VALID(mp);
+    }
+
+    // Children inherit the policy.
+    ib_mpool_t* child = NULL;
+    ASSERT_EQ(IB_OK, ib_mpool_create(&child, "policy_child", mp));
+    for (size_t i = 0; i < 10; ++i) {
+        char* p = reinterpret_cast<char*>(ib_mpool_alloc(child, 5000));
+        ASSERT_TRUE(p);
+        memset(p, 'y', 5000);
+    }
+    EXPECT_VALID(mp);
+
+    char* report = ib_mpool_analyze(mp);
+    ASSERT_TRUE(report);
+    string s(report);
+    free(report);
+    EXPECT_NE(string::npos, s.find("Roles:\n"));
+    EXPECT_NE(string::npos, s.find("  medium       pools=     2"));
+
+    ib_mpool_release(child);
+    EXPECT_VALID(mp);
+    ib_mpool_clear(mp);
+    EXPECT_VALID(mp);
+    EXPECT_TRUE(ib_mpool_alloc(mp, 8000));
+    ib_mpool_destroy(mp);
+
+    // Threshold is limited to the page size.
+    policy.pagesize        = 4096;
+    policy.large_threshold = 1000000;
+    ASSERT_EQ(IB_OK, ib_mpool_create_policy(&mp, "policy", NULL, &policy));
+    char* p = reinterpret_cast<char*>(ib_mpool_alloc(mp, 4096));
+    ASSERT_TRUE(p);
+    memset(p, 'z', 4096);
+    p = reinterpret_cast<char*>(ib_mpool_alloc(mp, 5000));
+    ASSERT_TRUE(p);
+    memset(p, 'z', 5000);
+    EXPECT_VALID(mp);
+    ib_mpool_destroy(mp);
+
+    EXPECT_EQ(IB_EINVAL, ib_mpool_create_policy(&mp, "policy", NULL, NULL));
+}
+
+TEST(TestMpool, PolicyRoles)
+{
+    ib_mpool_policy_t policy;
+    memset(&policy, 0, sizeof(policy));
+
+    ib_mpool_t* root = NULL;
+    policy.role = "root";
+    ASSERT_EQ(IB_OK, ib_mpool_create_policy(&root, "root", NULL, &policy));
+
+    ib_mpool_t* a = NULL;
+    ib_mpool_t* b = NULL;
+    ib_mpool_t* c = NULL;
+    policy.role     = "leaf";
+    policy.pagesize = 8192;
+    ASSERT_EQ(IB_OK, ib_mpool_create_policy(&a, "a", root, &policy));
+    ASSERT_EQ(IB_OK, ib_mpool_create_policy(&b, "b", root, &policy));
+    ASSERT_EQ(IB_OK, ib_mpool_create(&c, "c", a));
+    EXPECT_TRUE(ib_mpool_alloc(a, 100));
+    EXPECT_TRUE(ib_mpool_alloc(c, 100));
+
+    char* report = ib_mpool_analyze(root);
+    ASSERT_TRUE(report);
+    string s(report);
+    free(report);
+    EXPECT_NE(string::npos, s.find("  root         pools=     1"));
+    EXPECT_NE(string::npos, s.find("  leaf         pools=     3"));
+
+    ib_mpool_destroy(root);
+}
+
+TEST(TestMpool, PolicyHugePages)
+{
+    ib_mpool_policy_t policy;
+    memset(&policy, 0, sizeof(policy));
+    policy.pagesize        = 2 * 1024 * 1024;
+    policy.large_threshold = 64 * 1024;
+    policy.huge_pages      = true;
+
+    // Whether or not the system supports huge pages, the pool works.
+    ib_mpool_t* mp = NULL;
+    ASSERT_EQ(IB_OK, ib_mpool_create_policy(&mp, "huge", NULL, &policy));
+    for (size_t i = 0; i < 100; ++i) {
+        char* p = reinterpret_cast<char*>(ib_mpool_alloc(mp, 60000));
+        ASSERT_TRUE(p);
+        memset(p, 'h', 60000);
+    }
+    EXPECT_VALID(mp);
+    ib_mpool_destroy(mp);
+}
+
+TEST(TestMpool, ThreadCachePageSizes)
+{
+    ib_mpool_cache_stats_t before;
+    ib_mpool_cache_stats_t after;
+
+    ib_mpool_cache_flush();
+    ib_mpool_cache_stats(&before);
+
+    ib_mpool_policy_t policy;
+    memset(&policy, 0, sizeof(policy));
+    policy.pagesize = 16384;
+
+    ib_mpool_t* mp = NULL;
+    ASSERT_EQ(IB_OK, ib_mpool_create_policy(&mp, "big", NULL, &policy));
+    EXPECT_TRUE(ib_mpool_alloc(mp, 100));
+    ib_mpool_destroy(mp);
+
+    ASSERT_EQ(IB_OK, ib_mpool_create(&mp, "small", NULL));
+    EXPECT_TRUE(ib_mpool_alloc(mp, 100));
+
+    // A pool with different pages does not take the cached page.
+    ib_mpool_cache_stats(&after);
+    EXPECT_EQ(1U, after.pages);
+    EXPECT_EQ(before.page_hits, after.page_hits);
+    ib_mpool_destroy(mp);
+
+    ASSERT_EQ(IB_OK, ib_mpool_create_policy(&mp, "big2", NULL, &policy));
+    EXPECT_TRUE(ib_mpool_alloc(mp, 100));
+    ib_mpool_cache_stats(&after);
+    EXPECT_EQ(before.page_hits + 1, after.page_hits);
+    ib_mpool_destroy(mp);
+
+    ib_mpool_cache_flush();
+}
@@ -24,12 +24,20 @@
 
 #include "ironbee_config_auto.h"
 
+#include <ironbee/clock.h>
 #include <ironbee/uuid.h>
 
 #include "gtest/gtest.h"
 #include "gtest/gtest-spi.h"
 
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
 #include <string.h>
+#include <unistd.h>
 
 namespace OSSPUUID {
 #include <uuid.h>
@@ -124,3 +132,204 @@ TEST(TestIBUtilUUID, random)
     free(str);
     ib_uuid_shutdown();
 }
+
+TEST(TestIBUtilUUID, fast)
+{
+    std::vector<std::string> ids;
+    ib_uuid_t uuid;
+    ib_uuid_t uuid2;
+    char str[UUID_LEN_STR+1];
+
+    ib_uuid_initialize();
+
+    for (int i = 0; i < 10000; ++i) {
+        ASSERT_EQ(IB_OK, ib_uuid_create_v4_fast(&uuid));
+        ASSERT_EQ(0x40, uuid.byte[6] & 0xf0);
+        ASSERT_EQ(0x80, uuid.byte[8] & 0xc0);
+
+        ASSERT_EQ(IB_OK, ib_uuid_bin_to_ascii(str, &uuid));
+        ASSERT_EQ(IB_OK, ib_uuid_ascii_to_bin(&uuid2, str));
+        ASSERT_EQ(0, memcmp(&uuid, &uuid2, UUID_LEN_BIN));
+        ids.push_back(str);
+    }
+
+    std::sort(ids.begin(), ids.end());
+    ASSERT_TRUE(std::adjacent_find(ids.begin(), ids.end()) == ids.end());
+    ASSERT_EQ(IB_EINVAL, ib_uuid_create_v4_fast(NULL));
+
+    ib_uuid_shutdown();
+}
+
+TEST(TestIBUtilUUID, sortable)
+{
+    std::vector<std::string> ids;
+    ib_uuid_t uuid;
+    char str[UUID_LEN_STR+1];
+
+    ib_uuid_initialize();
+
+    /* IDs made in different milliseconds sort in creation order. */
+    for (int i = 0; i < 5; ++i) {
+        ASSERT_EQ(IB_OK, ib_uuid_create_sortable(&uuid));
+        ASSERT_EQ(0x70, uuid.byte[6] & 0xf0);
+        ASSERT_EQ(0x80, uuid.byte[8] & 0xc0);
+        ASSERT_EQ(IB_OK, ib_uuid_bin_to_ascii(str, &uuid));
+        ids.push_back(str);
+        usleep(2000);
+    }
+    ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+
+    /* IDs made in the same millisecond are still unique. */
+    for (int i = 0; i < 10000; ++i) {
+        ASSERT_EQ(IB_OK, ib_uuid_create_sortable(&uuid));
+        ASSERT_EQ(IB_OK, ib_uuid_bin_to_ascii(str, &uuid));
+        ids.push_back(str);
+    }
+    std::sort(ids.begin(), ids.end());
+    ASSERT_TRUE(std::adjacent_find(ids.begin(), ids.end()) == ids.end());
+
+    ib_uuid_shutdown();
+}
+
+namespace {
+
+/** UUIDs made by each thread of the contention benchmark. */
+const size_t c_uuids_per_thread = 50000;
+
+/** Contention benchmark thread. */
+struct uuid_thread_t {
+    ib_status_t (*create)(ib_uuid_t *);
+    std::vector<ib_uuid_t> uuids;
+    ib_status_t rc;
+};
+
+extern "C" void *uuid_thread(void *arg)
+{
+    uuid_thread_t *t = static_cast<uuid_thread_t *>(arg);
+
+    t->rc = IB_OK;
+    t->uuids.resize(c_uuids_per_thread);
+    for (size_t i = 0; i < c_uuids_per_thread && t->rc == IB_OK; ++i) {
+        t->rc = t->create(&t->uuids[i]);
+    }
+
+    return NULL;
+}
+
+bool uuid_less(const ib_uuid_t &a, const ib_uuid_t &b)
+{
+    return memcmp(&a, &b, sizeof(a)) < 0;
+}
+
+bool uuid_equal(const ib_uuid_t &a, const ib_uuid_t &b)
+{
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+/**
+ * Make UUIDs with @a create on @a num_threads threads at once.
+ *
+ * @returns Time taken in microseconds.
+ */
+ib_time_t run_uuid_threads(ib_status_t (*create)(ib_uuid_t *),
+                           size_t num_threads)
+{
+    std::vector<uuid_thread_t> threads(num_threads);
+    std::vector<pthread_t> handles(num_threads);
+    std::vector<ib_uuid_t> all;
+    ib_time_t start = ib_clock_get_time();
+    ib_time_t elapsed;
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads[i].create = create;
+        EXPECT_EQ(0, pthread_create(&handles[i], NULL, uuid_thread,
+                                    &threads[i]));
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        pthread_join(handles[i], NULL);
+    }
+    elapsed = ib_clock_get_time() - start;
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        EXPECT_EQ(IB_OK, threads[i].rc);
+        all.insert(all.end(), threads[i].uuids.begin(),
+                   threads[i].uuids.end());
+    }
+    std::sort(all.begin(), all.end(), uuid_less);
+    EXPECT_TRUE(
+        std::adjacent_find(all.begin(), all.end(), uuid_equal) == all.end()
+    );
+
+    return elapsed;
+}
+
+}
+
+/// Sortable UUIDs made on many threads at once never collide, and each
+/// thread's counter starts at a random value.
+TEST(TestIBUtilUUID, sortable_threads)
+{
+    static const size_t num_threads = 16;
+    std::vector<uuid_thread_t> threads(num_threads);
+    std::vector<pthread_t> handles(num_threads);
+    std::vector<ib_uuid_t> all;
+    std::vector<uint64_t> starts;
+
+    ib_uuid_initialize();
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads[i].create = ib_uuid_create_sortable;
+        ASSERT_EQ(0, pthread_create(&handles[i], NULL, uuid_thread,
+                                    &threads[i]));
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        pthread_join(handles[i], NULL);
+    }
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        const ib_uuid_t &first = threads[i].uuids.front();
+        uint64_t start = first.byte[6] & 0x0f;
+
+        ASSERT_EQ(IB_OK, threads[i].rc);
+        start = (start << 8) | first.byte[7];
+        for (size_t b = 12; b < 16; ++b) {
+            start = (start << 8) | first.byte[b];
+        }
+        starts.push_back(start);
+        all.insert(all.end(), threads[i].uuids.begin(),
+                   threads[i].uuids.end());
+    }
+
+    std::sort(starts.begin(), starts.end());
+    EXPECT_TRUE(std::adjacent_find(starts.begin(), starts.end()) ==
+                starts.end());
+
+    std::sort(all.begin(), all.end(), uuid_less);
+    EXPECT_TRUE(
+        std::adjacent_find(all.begin(), all.end(), uuid_equal) == all.end()
+    );
+
+    ib_uuid_shutdown();
+}
+
+/// Contention benchmark: UUIDs from the shared, locked generator vs. the
+/// per-thread generators, on increasing numbers of threads.
+TEST(TestIBUtilUUID, contention)
+{
+    ib_uuid_initialize();
+
+    for (size_t num_threads = 1; num_threads <= 8; num_threads *= 2) {
+        ib_time_t locked = run_uuid_threads(ib_uuid_create_v4, num_threads);
+        ib_time_t fast = run_uuid_threads(ib_uuid_create_v4_fast,
+                                          num_threads);
+        ib_time_t sortable = run_uuid_threads(ib_uuid_create_sortable,
+                                              num_threads);
+
+        std::cout << num_threads << " threads x " << c_uuids_per_thread
+                  << " UUIDs: locked v4 " << locked << "us,"
+                  << " per-thread v4 " << fast << "us,"
+                  << " sortable " << sortable << "us" << std::endl;
+    }
+
+    ib_uuid_shutdown();
+}
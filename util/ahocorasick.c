@@ -31,7 +31,10 @@
 
 #include "ahocorasick_private.h"
 
+#include <assert.h>
 #include <ctype.h>
+#include <stdbool.h>
+#include <stdlib.h>
 
 /*------ Aho - Corasick ------*/
 
@@ -267,65 +270,6 @@ static void ib_ac_link_outputs(ib_ac_t *ac_tree,
     return;
 }
 
-/**
- * Remove unuseful failure links to skip using an invalid transition
- *
- * @param ac_tree the matcher that holds the patterns
- * @param state the state where it should start (it's used recursively)
- *
- */
-static void ib_ac_unlink_unuseful(ib_ac_t *ac_tree,
-                               ib_ac_state_t *state)
-{
-    ib_ac_state_t *child = NULL;
-    ib_ac_state_t *fail_state = NULL;
-    ib_ac_state_t *found = NULL;
-
-    for (child = state->child;
-         child != NULL;
-         child = child->sibling)
-    {
-        if (child->fail == NULL ||
-            child->fail->child == NULL ||
-            child->child == NULL)
-        {
-            continue;
-        }
-
-        for (fail_state = child->fail->child;
-             fail_state != ac_tree->root && fail_state != NULL;
-             fail_state = fail_state->sibling)
-        {
-            found = ib_ac_child_for_code(child, fail_state->letter);
-            if (found == NULL) {
-                break;
-            }
-        }
-
-        if (found != NULL) {
-            /* There's no transition in the fail state that will
-             * success, since the fail state doesn't have any letter not
-             * present at the goto() of the main state. So let's
-             * change the fail state to parent. Consider that this is
-             * different to the output links (they'll still valid) */
-             child->fail = ac_tree->root;
-
-             /* printf("Removing invalid fails\n"); */
-        }
-    }
-
-    for (child = state->child;
-         child != NULL;
-         child = child->sibling)
-    {
-        if (child->child != NULL) {
-            ib_ac_unlink_unuseful(ac_tree, child);
-        }
-    }
-
-    return;
-}
-
 /**
  * Add items to the bintree for fast goto() transitions. Recursive calls
  *
@@ -519,9 +463,19 @@ static ib_status_t ib_ac_link_fail_states(ib_ac_t *ac_tree)
 
         state->fail = ac_tree->root;
 
+        /* The fail state is the longest proper suffix in the tree; follow
+         * the parent's fail chain until one can take this letter. */
         if (state->parent != ac_tree->root) {
-            goto_state = ib_ac_child_for_code(state->parent->fail,
-                                             state->letter);
+            ib_ac_state_t *fail_state = state->parent->fail;
+
+            for (;;) {
+                goto_state = ib_ac_child_for_code(fail_state,
+                                                  state->letter);
+                if ( (goto_state != NULL) || (fail_state == ac_tree->root) ) {
+                    break;
+                }
+                fail_state = fail_state->fail;
+            }
             if (goto_state != NULL) {
                 state->fail = goto_state;
             }
@@ -541,10 +495,6 @@ static ib_status_t ib_ac_link_fail_states(ib_ac_t *ac_tree)
     /* Link common outputs of subpatterns present in the branch*/
     ib_ac_link_outputs(ac_tree, ac_tree->root);
 
-    /* Unlink invalid fail transitions. This guarantees that there will
-     * be at least one letter with transition in each fail state*/
-    ib_ac_unlink_unuseful(ac_tree, ac_tree->root);
-
     if (ac_tree->root->child != NULL) {
         ib_ac_build_bintree(ac_tree, ac_tree->root);
     }
@@ -611,6 +561,154 @@ ib_status_t ib_ac_build_links(ib_ac_t *ac_tree)
     return IB_OK;
 }
 
+/**
+ * Does a state produce any output when entered?
+ *
+ * @param state the state
+ *
+ * @returns true if @a state is an output or links to one
+ */
+static inline bool ib_ac_has_output(const ib_ac_state_t *state)
+{
+    return (state->flags & IB_AC_FLAG_STATE_OUTPUT) ||
+           (state->outputs != NULL);
+}
+
+ib_status_t ib_ac_build_dfa(ib_ac_t *ac_tree, size_t max_size)
+{
+    ib_ac_dfa_t *dfa;
+    ib_ac_state_t **bfs = NULL;
+    ib_ac_state_t *state;
+    ib_ac_state_t *child;
+    bool used[256] = { false };
+    size_t num_states;
+    size_t head;
+    size_t tail;
+    size_t i;
+    uint32_t index;
+    int c;
+
+    if (ac_tree == NULL) {
+        return IB_EINVAL;
+    }
+    if ((ac_tree->flags & IB_AC_FLAG_PARSER_COMPILED) == 0) {
+        return IB_EINVAL;
+    }
+    if (ac_tree->dfa != NULL) {
+        return IB_OK;
+    }
+
+    /* Count the states with a preorder walk of the trie, noting the bytes
+     * the patterns use. */
+    num_states = 0;
+    state = ac_tree->root;
+    while (state != NULL) {
+        ++num_states;
+        if (state != ac_tree->root) {
+            used[(uint8_t)state->letter] = true;
+        }
+        if (state->child != NULL) {
+            state = state->child;
+            continue;
+        }
+        while ( (state != ac_tree->root) && (state->sibling == NULL) ) {
+            state = state->parent;
+        }
+        state = (state == ac_tree->root) ? NULL : state->sibling;
+    }
+
+    dfa = (ib_ac_dfa_t *)ib_mpool_calloc(ac_tree->mp, 1, sizeof(*dfa));
+    if (dfa == NULL) {
+        return IB_EALLOC;
+    }
+
+    /* Each used byte is a class of its own; the rest share class 0. */
+    dfa->num_classes = 1;
+    for (c = 0; c < 256; ++c) {
+        if (used[c]) {
+            dfa->classes[c] = dfa->num_classes++;
+        }
+    }
+    if (ac_tree->flags & IB_AC_FLAG_PARSER_NOCASE) {
+        for (c = 0; c < 256; ++c) {
+            dfa->classes[c] = dfa->classes[(uint8_t)tolower(c)];
+        }
+    }
+
+    if (num_states > UINT32_MAX / dfa->num_classes) {
+        return IB_DECLINED;
+    }
+    if ( (max_size != 0) &&
+         (num_states * dfa->num_classes > max_size / sizeof(uint32_t)) )
+    {
+        return IB_DECLINED;
+    }
+    dfa->num_states = num_states;
+
+    dfa->next = (uint32_t *)ib_mpool_alloc(
+        ac_tree->mp, num_states * dfa->num_classes * sizeof(uint32_t));
+    dfa->states = (ib_ac_state_t **)ib_mpool_alloc(
+        ac_tree->mp, num_states * sizeof(ib_ac_state_t *));
+    bfs = (ib_ac_state_t **)malloc(num_states * sizeof(ib_ac_state_t *));
+    if ( (dfa->next == NULL) || (dfa->states == NULL) || (bfs == NULL) ) {
+        free(bfs);
+        return IB_EALLOC;
+    }
+
+    /* Breadth first order, so that fail states come before their users. */
+    bfs[0] = ac_tree->root;
+    for (head = 0, tail = 1;  head < tail;  ++head) {
+        for (child = bfs[head]->child;  child != NULL;  child = child->sibling)
+        {
+            bfs[tail++] = child;
+        }
+    }
+    assert(tail == num_states);
+
+    /* Number states with output first. */
+    index = 0;
+    for (i = 0; i < num_states; ++i) {
+        if (ib_ac_has_output(bfs[i])) {
+            bfs[i]->index = index++;
+        }
+    }
+    dfa->output_rows = index * dfa->num_classes;
+    for (i = 0; i < num_states; ++i) {
+        if (! ib_ac_has_output(bfs[i])) {
+            bfs[i]->index = index++;
+        }
+        dfa->states[bfs[i]->index] = bfs[i];
+    }
+    dfa->root_row = ac_tree->root->index * dfa->num_classes;
+
+    /* A state goes where its fail state goes, except for its children. */
+    for (i = 0; i < num_states; ++i) {
+        uint32_t *row;
+
+        state = bfs[i];
+        row = dfa->next + state->index * dfa->num_classes;
+        if (state == ac_tree->root) {
+            for (c = 0; c < (int)dfa->num_classes; ++c) {
+                row[c] = dfa->root_row;
+            }
+        }
+        else {
+            memcpy(row,
+                   dfa->next + state->fail->index * dfa->num_classes,
+                   dfa->num_classes * sizeof(uint32_t));
+        }
+        for (child = state->child;  child != NULL;  child = child->sibling) {
+            row[dfa->classes[(uint8_t)child->letter]] =
+                child->index * dfa->num_classes;
+        }
+    }
+
+    free(bfs);
+    ac_tree->dfa = dfa;
+
+    return IB_OK;
+}
+
 /**
  * Wrapper for the callback call
  *
@@ -635,6 +733,131 @@ static void ib_ac_do_callback(ib_ac_context_t *ac_ctx,
     return;
 }
 
+/**
+ * Report a match of the pattern of @a state
+ *
+ * @param ac_ctx the matching context
+ * @param state the state where a pattern match (output) is found
+ * @param flags options to use while matching
+ * @param mp memory pool to use for the match list
+ *
+ * @returns Status code
+ */
+static ib_status_t ib_ac_report(ib_ac_context_t *ac_ctx,
+                                ib_ac_state_t *state,
+                                uint8_t flags,
+                                ib_mpool_t *mp)
+{
+    ++state->match_cnt;
+    ++ac_ctx->match_cnt;
+
+    if (flags & IB_AC_FLAG_CONSUME_DOCALLBACK)
+    {
+        ib_ac_do_callback(ac_ctx, state);
+    }
+
+    if (flags & IB_AC_FLAG_CONSUME_DOLIST)
+    {
+        ib_ac_match_t *mt = NULL;
+
+        /* If list is not created yet, create it */
+        if (ac_ctx->match_list == NULL)
+        {
+            ib_status_t rc;
+            rc = ib_list_create(&ac_ctx->match_list, mp);
+            if (rc != IB_OK) {
+                return rc;
+            }
+        }
+
+        mt = (ib_ac_match_t *)ib_mpool_calloc(mp, 1, sizeof(ib_ac_match_t));
+        if (mt == NULL) {
+            return IB_EALLOC;
+        }
+
+        mt->pattern = state->pattern;
+        mt->data = state->data;
+        mt->pattern_len = state->level + 1;
+        mt->offset = ac_ctx->processed - (state->level + 1);
+        mt->relative_offset = ac_ctx->current_offset - (state->level + 1);
+
+        return ib_list_enqueue(ac_ctx->match_list, (void *) mt);
+    }
+
+    return IB_OK;
+}
+
+/**
+ * ib_ac_consume() using the dense transition table of the matcher
+ *
+ * @param ac_ctx pointer to the matching context
+ * @param data pointer to the buffer to search in
+ * @param len the length of the data
+ * @param flags options to use while matching
+ * @param mp memory pool to use
+ *
+ * @returns Status code
+ */
+static ib_status_t ib_ac_dfa_consume(ib_ac_context_t *ac_ctx,
+                                     const char *data,
+                                     size_t len,
+                                     uint8_t flags,
+                                     ib_mpool_t *mp)
+{
+    const ib_ac_dfa_t *dfa = ac_ctx->ac_tree->dfa;
+    const uint8_t *start = (const uint8_t *)data;
+    const uint8_t *end = start + len;
+    const uint8_t *p;
+    size_t processed = ac_ctx->processed;
+    uint32_t row = ac_ctx->current->index * dfa->num_classes;
+    bool found = false;
+
+    for (p = start; p < end; ++p) {
+        ib_ac_state_t *state;
+        ib_ac_state_t *outs;
+
+        row = dfa->next[row + dfa->classes[*p]];
+        if (row >= dfa->output_rows) {
+            continue;
+        }
+
+        state = dfa->states[row / dfa->num_classes];
+        ac_ctx->current = state;
+        ac_ctx->processed = processed + (p - start) + 1;
+        ac_ctx->current_offset = (p - start) + 1;
+
+        if (state->flags & IB_AC_FLAG_STATE_OUTPUT) {
+            ib_status_t rc = ib_ac_report(ac_ctx, state, flags, mp);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            found = true;
+
+            if ( !(flags & IB_AC_FLAG_CONSUME_MATCHALL)) {
+                return IB_OK;
+            }
+        }
+
+        for (outs = state->outputs; outs != NULL; outs = outs->outputs) {
+            ib_status_t rc = ib_ac_report(ac_ctx, outs, flags, mp);
+            if (rc != IB_OK) {
+                return rc;
+            }
+            found = true;
+
+            if ( !(flags & IB_AC_FLAG_CONSUME_MATCHALL)) {
+                return IB_OK;
+            }
+        }
+    }
+
+    ac_ctx->current = dfa->states[row / dfa->num_classes];
+    ac_ctx->processed = processed + len;
+    ac_ctx->current_offset = len;
+
+    return found ? IB_OK : IB_ENOENT;
+}
+
 /**
  * Search patterns of the ac_tree matcher in the given buffer using a
  * matching context. The matching context stores offsets used to process
@@ -677,6 +900,10 @@ ib_status_t ib_ac_consume(ib_ac_context_t *ac_ctx,
         ac_ctx->current = ac_tree->root;
     }
 
+    if (ac_tree->dfa != NULL) {
+        return ib_ac_dfa_consume(ac_ctx, data, len, flags, mp);
+    }
+
     state = ac_ctx->current;
     end = data + len;
 
@@ -694,104 +921,41 @@ ib_status_t ib_ac_consume(ib_ac_context_t *ac_ctx,
             fgoto = ib_ac_bintree_goto(state, letter);
 
             if (fgoto != NULL) {
+                ib_ac_state_t *outs = NULL;
+
+                ac_ctx->current = fgoto;
+                state = fgoto;
 
                 if (fgoto->flags & IB_AC_FLAG_STATE_OUTPUT) {
+                    ib_status_t rc = ib_ac_report(ac_ctx, fgoto, flags, mp);
+                    if (rc != IB_OK) {
+                        return rc;
+                    }
                     flag_match = 1;
 
-                    ++fgoto->match_cnt;
-                    ++ac_ctx->match_cnt;
-
-                    ac_ctx->current = fgoto;
-                    state = fgoto;
-
-                    if (flags & IB_AC_FLAG_CONSUME_DOCALLBACK)
+                    if ( !(flags & IB_AC_FLAG_CONSUME_MATCHALL))
                     {
-                        ib_ac_do_callback(ac_ctx, state);
+                        return IB_OK;
                     }
+                }
 
-                    if (flags & IB_AC_FLAG_CONSUME_DOLIST)
-                    {
-                        /* If list is not created yet, create it */
-                        if (ac_ctx->match_list == NULL)
-                        {
-                            ib_status_t rc;
-                            rc = ib_list_create(&ac_ctx->match_list, mp);
-                            if (rc != IB_OK) {
-                                return rc;
-                            }
-                        }
-
-                        ib_ac_match_t *mt = NULL;
-                        mt = (ib_ac_match_t *)ib_mpool_calloc(mp,
-                                          1, sizeof(ib_ac_match_t));
-                        if (mt == NULL) {
-                            return IB_EALLOC;
-                        }
-
-                        mt->pattern = state->pattern;
-                        mt->data = state->data;
-                        mt->pattern_len = state->level + 1;
-                        mt->offset = ac_ctx->processed - (fgoto->level + 1);
-                        mt->relative_offset = ac_ctx->current_offset -
-                                                         (fgoto->level + 1);
-
-                        ib_list_enqueue(ac_ctx->match_list, (void *) mt);
+                /* These are subpatterns of the current walked branch that
+                 * are present as independent patterns in the tree; they
+                 * match even if the current state is not an output. */
+                for (outs = fgoto->outputs;
+                     outs != NULL;
+                     outs = outs->outputs)
+                {
+                    ib_status_t rc = ib_ac_report(ac_ctx, outs, flags, mp);
+                    if (rc != IB_OK) {
+                        return rc;
                     }
+                    flag_match = 1;
 
                     if ( !(flags & IB_AC_FLAG_CONSUME_MATCHALL))
                     {
                         return IB_OK;
                     }
-
-                    ib_ac_state_t *outs = NULL;
-
-                    for (outs = state->outputs;
-                         outs != NULL;
-                         outs = outs->outputs)
-                    {
-                        /* This are subpatterns of the current walked branch
-                         * that are present as independent patterns as well
-                         * in the tree */
-
-                        ++outs->match_cnt;
-                        ++ac_ctx->match_cnt;
-
-                        if (flags & IB_AC_FLAG_CONSUME_DOCALLBACK)
-                        {
-                            ib_ac_do_callback(ac_ctx, outs);
-                        }
-
-                        if (flags & IB_AC_FLAG_CONSUME_DOLIST)
-                        {
-                            /* If list is not created yet, create it */
-                            if (ac_ctx->match_list == NULL)
-                            {
-                                ib_status_t rc;
-                                rc = ib_list_create(&ac_ctx->match_list, mp);
-                                if (rc != IB_OK) {
-                                    return rc;
-                                }
-                            }
-
-                            ib_ac_match_t *mt = NULL;
-                            mt = (ib_ac_match_t *)ib_mpool_calloc(mp,
-                                              1, sizeof(ib_ac_match_t));
-                            if (mt == NULL) {
-                                return IB_EALLOC;
-                            }
-
-                            mt->pattern = outs->pattern;
-                            mt->data = state->data;
-                            mt->pattern_len = outs->level + 1;
-                            mt->offset =
-                                ac_ctx->processed - (outs->level + 1);
-                            mt->relative_offset = ac_ctx->current_offset -
-                                                         (outs->level + 1);
-
-                            ib_list_enqueue(ac_ctx->match_list,
-                                            (void *) mt);
-                        }
-                    }
                 }
             }
             else {
@@ -824,3 +988,86 @@ ib_status_t ib_ac_consume(ib_ac_context_t *ac_ctx,
 
     return IB_ENOENT;
 }
+
+ib_status_t ib_ac_scan(const ib_ac_t *ac_tree,
+                       const char *data,
+                       size_t len,
+                       ib_ac_scan_fn_t fn,
+                       void *cbdata)
+{
+    const ib_ac_state_t *state;
+    const char *end;
+    bool found = false;
+
+    if ( (ac_tree == NULL) || (fn == NULL) ) {
+        return IB_EINVAL;
+    }
+    if ((ac_tree->flags & IB_AC_FLAG_PARSER_COMPILED) == 0) {
+        return IB_EINVAL;
+    }
+    if (ac_tree->root->child == NULL) {
+        return IB_ENOENT;
+    }
+
+    if (ac_tree->dfa != NULL) {
+        const ib_ac_dfa_t *dfa = ac_tree->dfa;
+        const uint8_t *p = (const uint8_t *)data;
+        uint32_t row = dfa->root_row;
+
+        for (end = data + len;  p < (const uint8_t *)end;  ++p) {
+            row = dfa->next[row + dfa->classes[*p]];
+            if (row >= dfa->output_rows) {
+                continue;
+            }
+            state = dfa->states[row / dfa->num_classes];
+            if (state->flags & IB_AC_FLAG_STATE_OUTPUT) {
+                fn(state->data, cbdata);
+            }
+            for (state = state->outputs;
+                 state != NULL;
+                 state = state->outputs)
+            {
+                fn(state->data, cbdata);
+            }
+            found = true;
+        }
+
+        return found ? IB_OK : IB_ENOENT;
+    }
+
+    state = ac_tree->root;
+    end = data + len;
+    while (data < end) {
+        ib_ac_char_t letter = (unsigned char)*data++;
+        const ib_ac_state_t *fgoto;
+        const ib_ac_state_t *outs;
+
+        if (ac_tree->flags & IB_AC_FLAG_PARSER_NOCASE) {
+            letter = tolower(letter);
+        }
+
+        /* Follow the fail states until a transition succeeds */
+        for (;;) {
+            fgoto = ib_ac_bintree_goto((ib_ac_state_t *)state, letter);
+            if ( (fgoto != NULL) || (state == ac_tree->root) ) {
+                break;
+            }
+            state = state->fail;
+        }
+        if (fgoto == NULL) {
+            continue;
+        }
+        state = fgoto;
+
+        if (state->flags & IB_AC_FLAG_STATE_OUTPUT) {
+            fn(state->data, cbdata);
+            found = true;
+        }
+        for (outs = state->outputs;  outs != NULL;  outs = outs->outputs) {
+            fn(outs->data, cbdata);
+            found = true;
+        }
+    }
+
+    return found ? IB_OK : IB_ENOENT;
+}
@@ -63,6 +63,24 @@ struct ib_ac_state_t {
     ib_ac_callback_t   callback;  /**< callback function for matches */
     void              *data;   /**< callback (or match entry) extra params */
 
+    uint32_t           index;     /**< row of this state in the DFA */
+};
+
+/**
+ * Dense transition table built by ib_ac_build_dfa()
+ *
+ * Entries of @c next are row offsets (state index times @c num_classes)
+ * so that a transition is a single lookup.  States with output are
+ * numbered first; a row offset below @c output_rows has output.
+ */
+struct ib_ac_dfa_t {
+    uint8_t            classes[256]; /**< class of each input byte */
+    uint32_t           num_classes;  /**< number of classes */
+    uint32_t           num_states;   /**< number of states */
+    uint32_t           output_rows;  /**< row offsets below have output */
+    uint32_t           root_row;     /**< row offset of the root */
+    uint32_t          *next;         /**< transitions; rows of classes */
+    ib_ac_state_t    **states;       /**< states by index */
 };
 
 /**
@@ -41,6 +41,55 @@
 
 #define NUM_BUF_LEN 64
 
+/**
+ * Number of names of a template expanded without allocating.
+ */
+#define TEMPLATE_STACK_REFS 8
+
+/**
+ * Segment of an expansion template: literal text and the name after it.
+ */
+typedef struct {
+    const char *literal;     /**< Literal text */
+    size_t      literal_len; /**< Length of @c literal */
+    const char *name;        /**< Name to expand or NULL if none */
+    size_t      name_len;    /**< Length of @c name */
+    int         id;          /**< ID of @c name from the resolve function */
+} template_segment_t;
+
+/* See ib_expand_template_t */
+struct ib_expand_template_t {
+    template_segment_t *segments;     /**< Segments */
+    size_t              num_segments; /**< Number of @c segments */
+    size_t              num_refs;     /**< Number of segments with names */
+    size_t              literal_len;  /**< Sum of literal lengths */
+    const char         *str;          /**< String compiled */
+    size_t              str_len;      /**< Length of @c str */
+    const char         *prefix;       /**< Prefix string */
+    size_t              pre_len;      /**< Length of @c prefix */
+    const char         *suffix;       /**< Suffix string */
+    bool                overlaps;     /**< Can @c prefix overlap itself? */
+    ib_expand_resolve_fn_t resolve_fn; /**< Resolve function or NULL */
+};
+
+/**
+ * Lookup for the ib_expand_str_gen_ex() fallback of a template.
+ */
+typedef struct {
+    const ib_expand_template_t     *tmpl;        /**< Template */
+    ib_expand_template_lookup_fn_t  lookup_fn;   /**< Template lookup */
+    const void                     *lookup_data; /**< Data for lookup_fn */
+} template_fallback_t;
+
+/**
+ * Value of a name expanded in a template.
+ */
+typedef struct {
+    const char *ptr;                 /**< Value */
+    size_t      len;                 /**< Length of @c ptr */
+    char        num[NUM_BUF_LEN+1];  /**< Storage for numeric values */
+} template_value_t;
+
 /**
  * Join two memory blocks into a single buffer
  *
@@ -148,33 +197,21 @@ static ib_status_t join3(ib_mpool_t *mp,
 }
 
 /**
- * Join a field with strings before and after it
+ * Get the string to replace a name with from its field.
  *
- * @param[in] mp Memory pool
- * @param[in] f Field to join
- * @param[in] iptr Pointer to initial string
- * @param[in] ilen Length of @a iptr
- * @param[in] fptr Pointer to final string
- * @param[in] flen Length of @a fptr
- * @param[in] nul true if NUL byte should be tacked on, false if not
- * @param[out] out Pointer to output block
- * @param[out] olen Length of the output block
+ * @param[in] f Field
+ * @param[in] numbuf Buffer of NUM_BUF_LEN+1 bytes for numeric values
+ * @param[out] ptr Pointer to the string; not NUL terminated
+ * @param[out] len Length of @a ptr
  *
  * @returns status code
  */
-static ib_status_t join_parts(ib_mpool_t *mp,
-                              const ib_field_t *f,
-                              const char *iptr,
-                              size_t ilen,
-                              const char *fptr,
-                              size_t flen,
-                              bool nul,
-                              char **out,
-                              size_t *olen)
+static ib_status_t field_to_str(const ib_field_t *f,
+                                char *numbuf,
+                                const char **ptr,
+                                size_t *len)
 {
     ib_status_t rc;
-    char numbuf[NUM_BUF_LEN+1]; /* Buffer used to convert number to str */
-    assert(NUM_BUF_LEN <= 256);
 
     switch(f->type) {
     case IB_FTYPE_NULSTR:
@@ -185,13 +222,8 @@ static ib_status_t join_parts(ib_mpool_t *mp,
         if (rc != IB_OK) {
             return rc;
         }
-        size_t slen = strlen(s);
-        rc = join3(mp,
-                   iptr, ilen,
-                   s, slen,
-                   fptr, flen,
-                   nul,
-                   out, olen);
+        *ptr = s;
+        *len = strlen(s);
         break;
     }
 
@@ -203,13 +235,8 @@ static ib_status_t join_parts(ib_mpool_t *mp,
         if (rc != IB_OK) {
             return rc;
         }
-        rc = join3(mp,
-                   iptr, ilen,
-                   (const char *)ib_bytestr_const_ptr(bs),
-                   ib_bytestr_length(bs),
-                   fptr, flen,
-                   nul,
-                   out, olen);
+        *ptr = (const char *)ib_bytestr_const_ptr(bs);
+        *len = ib_bytestr_length(bs);
         break;
     }
 
@@ -222,12 +249,8 @@ static ib_status_t join_parts(ib_mpool_t *mp,
             return rc;
         }
         snprintf(numbuf, NUM_BUF_LEN, "%"PRId64, n);
-        rc = join3(mp,
-                   iptr, ilen,
-                   numbuf, strlen(numbuf),
-                   fptr, flen,
-                   nul,
-                   out, olen);
+        *ptr = numbuf;
+        *len = strlen(numbuf);
         break;
     }
 
@@ -245,22 +268,66 @@ static ib_status_t join_parts(ib_mpool_t *mp,
 
         node = ib_list_first_const(list);
         if (node == NULL) {
-            rc = join2(mp, iptr, ilen, fptr, flen, nul, out, olen);
+            *ptr = "";
+            *len = 0;
             break;
         }
 
         element = (const ib_field_t *)ib_list_node_data_const(node);
-        rc = join_parts(mp, element, iptr, ilen, fptr, flen, nul, out, olen);
-        break;
+        return field_to_str(element, numbuf, ptr, len);
     }
 
     default:
         /* Something else: replace with "" */
-        rc = join2(mp, iptr, ilen, fptr, flen, nul, out, olen);
+        *ptr = "";
+        *len = 0;
         break;
     }
 
-    return rc;
+    return IB_OK;
+}
+
+/**
+ * Join a field with strings before and after it
+ *
+ * @param[in] mp Memory pool
+ * @param[in] f Field to join
+ * @param[in] iptr Pointer to initial string
+ * @param[in] ilen Length of @a iptr
+ * @param[in] fptr Pointer to final string
+ * @param[in] flen Length of @a fptr
+ * @param[in] nul true if NUL byte should be tacked on, false if not
+ * @param[out] out Pointer to output block
+ * @param[out] olen Length of the output block
+ *
+ * @returns status code
+ */
+static ib_status_t join_parts(ib_mpool_t *mp,
+                              const ib_field_t *f,
+                              const char *iptr,
+                              size_t ilen,
+                              const char *fptr,
+                              size_t flen,
+                              bool nul,
+                              char **out,
+                              size_t *olen)
+{
+    ib_status_t rc;
+    char numbuf[NUM_BUF_LEN+1]; /* Buffer used to convert number to str */
+    const char *s;
+    size_t slen;
+
+    rc = field_to_str(f, numbuf, &s, &slen);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    return join3(mp,
+                 iptr, ilen,
+                 s, slen,
+                 fptr, flen,
+                 nul,
+                 out, olen);
 }
 
 /*
@@ -603,3 +670,343 @@ ib_status_t ib_expand_test_str_ex(const char *str,
     *result = true;
     return IB_OK;
 }
+
+/**
+ * Split a string into template segments.
+ *
+ * @param[in] str String
+ * @param[in] str_len Length of @a str
+ * @param[in] prefix Prefix string
+ * @param[in] pre_len Length of @a prefix
+ * @param[in] suffix Suffix string
+ * @param[in] suf_len Length of @a suffix
+ * @param[in] resolve_fn Function to resolve names, or NULL
+ * @param[out] segments Segments, or NULL to only count them
+ *
+ * @returns Number of segments
+ */
+static size_t template_split(const char *str,
+                             size_t str_len,
+                             const char *prefix,
+                             size_t pre_len,
+                             const char *suffix,
+                             size_t suf_len,
+                             ib_expand_resolve_fn_t resolve_fn,
+                             template_segment_t *segments)
+{
+    const char *cur = str;
+    const char *end = str + str_len;
+    size_t      num = 0;
+
+    while (1) {
+        const char *pre;
+        const char *suf = NULL;
+
+        pre = ib_strstr_ex(cur, end - cur, prefix, pre_len);
+        if (pre != NULL) {
+            suf = ib_strstr_ex(pre + pre_len,
+                               end - (pre + pre_len),
+                               suffix,
+                               suf_len);
+        }
+
+        /* No more names: the rest is literal. */
+        if (suf == NULL) {
+            if (segments != NULL) {
+                segments[num].literal = cur;
+                segments[num].literal_len = end - cur;
+                segments[num].name = NULL;
+                segments[num].name_len = 0;
+                segments[num].id = -1;
+            }
+            return num + 1;
+        }
+
+        if (segments != NULL) {
+            template_segment_t *seg = &segments[num];
+            size_t namelen = suf - (pre + pre_len);
+
+            seg->literal = cur;
+            seg->literal_len = pre - cur;
+            /* Zero length names expand to "" */
+            seg->name = (namelen == 0) ? NULL : pre + pre_len;
+            seg->name_len = namelen;
+            seg->id = -1;
+            if ( (seg->name != NULL) && (resolve_fn != NULL) ) {
+                seg->id = resolve_fn(seg->name, seg->name_len);
+            }
+        }
+        ++num;
+        cur = suf + suf_len;
+    }
+}
+
+/*
+ * Compile a string into an expansion template.  See expand.h.
+ */
+ib_status_t ib_expand_template_create(ib_mpool_t *mp,
+                                      const char *str,
+                                      size_t str_len,
+                                      const char *prefix,
+                                      const char *suffix,
+                                      ib_expand_resolve_fn_t resolve_fn,
+                                      ib_expand_template_t **tmpl)
+{
+    assert(mp != NULL);
+    assert(str != NULL);
+    assert(prefix != NULL);
+    assert(suffix != NULL);
+    assert(tmpl != NULL);
+
+    ib_expand_template_t *new_tmpl;
+    const char *copy;
+    size_t pre_len;
+    size_t suf_len;
+    size_t i;
+
+    /* Validate prefix and suffix */
+    if ( (*prefix == '\0') || (*suffix == '\0') ) {
+        return IB_EINVAL;
+    }
+    pre_len = strlen(prefix);
+    suf_len = strlen(suffix);
+
+    new_tmpl = ib_mpool_calloc(mp, 1, sizeof(*new_tmpl));
+    if (new_tmpl == NULL) {
+        return IB_EALLOC;
+    }
+    copy = ib_mpool_memdup(mp, str, str_len);
+    if ( (copy == NULL) && (str_len != 0) ) {
+        return IB_EALLOC;
+    }
+    if (copy == NULL) {
+        copy = "";
+    }
+    new_tmpl->str = copy;
+    new_tmpl->str_len = str_len;
+    new_tmpl->prefix = ib_mpool_strdup(mp, prefix);
+    new_tmpl->suffix = ib_mpool_strdup(mp, suffix);
+    if ( (new_tmpl->prefix == NULL) || (new_tmpl->suffix == NULL) ) {
+        return IB_EALLOC;
+    }
+    new_tmpl->pre_len = pre_len;
+    new_tmpl->resolve_fn = resolve_fn;
+
+    /* Does the prefix start with its own end (e.g. "<<")? */
+    for (i = 1; i < pre_len; ++i) {
+        if (memcmp(prefix, prefix + i, pre_len - i) == 0) {
+            new_tmpl->overlaps = true;
+            break;
+        }
+    }
+
+    new_tmpl->num_segments = template_split(copy, str_len,
+                                            prefix, pre_len,
+                                            suffix, suf_len,
+                                            resolve_fn, NULL);
+    new_tmpl->segments = ib_mpool_alloc(
+        mp,
+        new_tmpl->num_segments * sizeof(*new_tmpl->segments)
+    );
+    if (new_tmpl->segments == NULL) {
+        return IB_EALLOC;
+    }
+    template_split(copy, str_len,
+                   prefix, pre_len,
+                   suffix, suf_len,
+                   resolve_fn, new_tmpl->segments);
+
+    for (i = 0; i < new_tmpl->num_segments; ++i) {
+        new_tmpl->literal_len += new_tmpl->segments[i].literal_len;
+        if (new_tmpl->segments[i].name != NULL) {
+            ++new_tmpl->num_refs;
+        }
+    }
+
+    *tmpl = new_tmpl;
+    return IB_OK;
+}
+
+/*
+ * Does a template have names to expand?  See expand.h.
+ */
+bool ib_expand_template_is_expandable(const ib_expand_template_t *tmpl)
+{
+    assert(tmpl != NULL);
+
+    /* A zero length name is replaced even though it has no value. */
+    return tmpl->num_segments > 1;
+}
+
+/**
+ * Lookup function for the ib_expand_str_gen_ex() fallback of a template.
+ *
+ * @param[in] data Fallback lookup (template_fallback_t)
+ * @param[in] key Key to lookup
+ * @param[in] keylen Length of @a key
+ * @param[out] pf Pointer to output field.
+ *
+ * @returns Return values from the template lookup function
+ */
+static ib_status_t template_fallback_lookup(const void *data,
+                                            const char *key,
+                                            size_t keylen,
+                                            ib_field_t **pf)
+{
+    assert(data != NULL);
+    assert(key != NULL);
+    assert(pf != NULL);
+
+    const template_fallback_t *fallback = (const template_fallback_t *)data;
+    int id = -1;
+
+    if (fallback->tmpl->resolve_fn != NULL) {
+        id = fallback->tmpl->resolve_fn(key, keylen);
+    }
+    return fallback->lookup_fn(fallback->lookup_data, id, key, keylen, pf);
+}
+
+/**
+ * Would ib_expand_str_gen_ex() expand a substituted value again?
+ *
+ * ib_expand_str_gen_ex() searches the whole string again after each
+ * name is replaced.  That finds the same names as the template unless a
+ * prefix appears in the result before the final literal: in a value, or
+ * across the ends of values and literals.  A prefix which can overlap
+ * itself may also appear across a value and the next name, so those are
+ * always expanded the slow way.
+ *
+ * @param[in] tmpl Template
+ * @param[in] buf Template expansion
+ * @param[in] len Length of @a buf
+ *
+ * @returns true if @a buf may differ from ib_expand_str_gen_ex()
+ */
+static bool template_needs_rescan(const ib_expand_template_t *tmpl,
+                                  const char *buf,
+                                  size_t len)
+{
+    size_t tail_len;
+    size_t search_len;
+
+    if (tmpl->num_segments == 1) {
+        return false;
+    }
+    if (tmpl->overlaps) {
+        return true;
+    }
+
+    /* Search for a prefix starting before the final literal. */
+    tail_len = tmpl->segments[tmpl->num_segments - 1].literal_len;
+    search_len = len - tail_len + tmpl->pre_len - 1;
+    if (search_len > len) {
+        search_len = len;
+    }
+    return ib_strstr_ex(buf, search_len,
+                        tmpl->prefix, tmpl->pre_len) != NULL;
+}
+
+/*
+ * Expand a compiled template.  See expand.h.
+ */
+ib_status_t ib_expand_template_str(ib_mpool_t *mp,
+                                   const ib_expand_template_t *tmpl,
+                                   bool nul,
+                                   ib_expand_template_lookup_fn_t lookup_fn,
+                                   const void *lookup_data,
+                                   char **result,
+                                   size_t *result_len)
+{
+    assert(mp != NULL);
+    assert(tmpl != NULL);
+    assert(lookup_fn != NULL);
+    assert(result != NULL);
+    assert(result_len != NULL);
+
+    ib_status_t rc;
+    template_value_t stack_values[TEMPLATE_STACK_REFS];
+    template_value_t *values = stack_values;
+    size_t len = tmpl->literal_len;
+    size_t ref = 0;
+    size_t i;
+    char *buf;
+    char *p;
+
+    if (tmpl->num_refs > TEMPLATE_STACK_REFS) {
+        values = ib_mpool_alloc(mp, tmpl->num_refs * sizeof(*values));
+        if (values == NULL) {
+            return IB_EALLOC;
+        }
+    }
+
+    /* Look up every name first to size the result. */
+    for (i = 0; i < tmpl->num_segments; ++i) {
+        const template_segment_t *seg = &tmpl->segments[i];
+        template_value_t *value;
+        ib_field_t *f;
+
+        if (seg->name == NULL) {
+            continue;
+        }
+        value = &values[ref++];
+        value->ptr = "";
+        value->len = 0;
+
+        rc = lookup_fn(lookup_data, seg->id, seg->name, seg->name_len, &f);
+        if (rc == IB_ENOENT) {
+            continue;
+        }
+        else if (rc != IB_OK) {
+            return rc;
+        }
+
+        rc = field_to_str(f, value->num, &value->ptr, &value->len);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        len += value->len;
+    }
+
+    buf = (char *)ib_mpool_alloc(mp, len + (nul ? 1 : 0));
+    if (buf == NULL) {
+        return IB_EALLOC;
+    }
+
+    p = buf;
+    ref = 0;
+    for (i = 0; i < tmpl->num_segments; ++i) {
+        const template_segment_t *seg = &tmpl->segments[i];
+
+        memcpy(p, seg->literal, seg->literal_len);
+        p += seg->literal_len;
+        if (seg->name != NULL) {
+            const template_value_t *value = &values[ref++];
+            if (value->len > 0) {
+                memcpy(p, value->ptr, value->len);
+                p += value->len;
+            }
+        }
+    }
+    assert((size_t)(p - buf) == len);
+    if (nul) {
+        *p = '\0';
+    }
+
+    /* Rare: expand as ib_expand_str_gen_ex() would, searching again. */
+    if (template_needs_rescan(tmpl, buf, len)) {
+        template_fallback_t fallback;
+
+        fallback.tmpl = tmpl;
+        fallback.lookup_fn = lookup_fn;
+        fallback.lookup_data = lookup_data;
+        return ib_expand_str_gen_ex(mp, tmpl->str, tmpl->str_len,
+                                    tmpl->prefix, tmpl->suffix,
+                                    nul, false,
+                                    template_fallback_lookup, &fallback,
+                                    result, result_len);
+    }
+
+    *result = buf;
+    *result_len = len;
+    return IB_OK;
+}
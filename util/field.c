@@ -54,6 +54,7 @@ struct ib_field_val_t {
     void                 *cbdata_set;    /**< Data passed to fn_get. */
     void                 *pval;          /**< Address where value is stored */
     ib_field_val_union_t  u;             /**< Union of value types */
+    size_t                generation;    /**< Bumped when value may change */
 };
 
 const char *ib_field_type_name(
@@ -823,6 +824,7 @@ ib_status_t ib_field_make_static(
     f->val->fn_set     = NULL;
     f->val->cbdata_get = NULL;
     f->val->cbdata_set = NULL;
+    ++f->val->generation;
 
     ib_field_util_log_debug("FIELD_MAKE_STATIC", f);
 
@@ -839,7 +841,7 @@ ib_status_t ib_field_setv_no_copy(
     }
 
     *(void **)(f->val->pval) = mutable_in_pval;
-
+    ++f->val->generation;
 
     return IB_OK;
 }
@@ -863,6 +865,8 @@ ib_status_t ib_field_setv_ex(
 {
     ib_status_t rc;
 
+    ++f->val->generation;
+
     if (ib_field_is_dynamic(f)) {
         if (f->val->fn_set == NULL) {
             return IB_EINVAL;
@@ -1059,6 +1063,9 @@ ib_status_t ib_field_mutable_value(
         return IB_ENOENT;
     }
 
+    /* The caller may change the value in place. */
+    ++f->val->generation;
+
     if (f->type == IB_FTYPE_NUM || f->type == IB_FTYPE_FLOAT)
     {
         *(void**)mutable_out_pval = f->val->pval;
@@ -1094,6 +1101,11 @@ int ib_field_is_dynamic(const ib_field_t *f)
     return f->val->pval == NULL ? 1 : 0;
 }
 
+size_t ib_field_generation(const ib_field_t *f)
+{
+    return f->val->generation;
+}
+
 ib_status_t ib_field_convert(
     ib_mpool_t        *mp,
     const ib_ftype_t   desired_type,
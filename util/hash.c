@@ -34,6 +34,10 @@
 #include <string.h>
 #include <time.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* Internal Declarations */
 
 /**
@@ -50,6 +54,25 @@
  **/
 #define IB_HASH_INITIAL_SIZE 16
 
+/**
+ * Number of slots in a group of an open addressing hash.
+ *
+ * A group is probed with a single 16 byte comparison of its control bytes.
+ **/
+#define IB_HASH_GROUP_WIDTH 16
+
+/** Control byte of an empty slot of an open addressing hash. */
+#define IB_HASH_CTRL_EMPTY ((uint8_t)0x80)
+
+/**
+ * Control byte of a deleted slot of an open addressing hash.
+ *
+ * Lookups continue past deleted slots but stop at empty ones.  Full slots
+ * have the low 7 bits of their hash value as their control byte, so the
+ * high bit distinguishes full slots from empty and deleted ones.
+ **/
+#define IB_HASH_CTRL_DELETED ((uint8_t)0xfe)
+
 /**
  * See ib_hash_entry_t()
  */
@@ -81,6 +104,9 @@ struct ib_hash_entry_t {
  *
  * The end of the sequence is indicated by @c current_entry being NULL.
  * Any iterator is invalidated by any mutating operation on the hash.
+ *
+ * For an open addressing hash, @c slot_index is the index of the next
+ * slot to look at and @c next_entry is unused.
  **/
 struct ib_hash_iterator_t {
     /** Hash table we are iterating through. */
@@ -101,13 +127,30 @@ struct ib_hash_t {
     ib_hash_function_t   hash_function;
     /** Key equality predicate. */
     ib_hash_equal_t      equal_predicate;
+    /** Layout. */
+    ib_hash_layout_t     layout;
     /**
-     * Slots.
+     * Slots (IB_HASH_LAYOUT_CHAINED).
      *
      * Each slot holds a (possibly empty) linked list of ib_hash_entry_t's,
      * all of which have the same hash value.
      **/
     ib_hash_entry_t    **slots;
+    /**
+     * Control bytes (IB_HASH_LAYOUT_OPEN).
+     *
+     * One per entry of @c entries: IB_HASH_CTRL_EMPTY,
+     * IB_HASH_CTRL_DELETED, or the low 7 bits of the hash value of a full
+     * slot.
+     **/
+    uint8_t             *ctrl;
+    /** Entries (IB_HASH_LAYOUT_OPEN); @c next_entry is unused. */
+    ib_hash_entry_t     *entries;
+    /**
+     * Number of empty slots that may be filled before growing
+     * (IB_HASH_LAYOUT_OPEN).
+     **/
+    size_t               growth_left;
     /** Maximum slot index. */
     size_t               max_slot;
     /** Memory pool. */
@@ -224,6 +267,145 @@ static char ib_hash_tolower(
     char c
 );
 
+/**
+ * Find the slots of a group whose control byte is @a c.
+ *
+ * @param[in] ctrl First control byte of the group.
+ * @param[in] c    Control byte to look for.
+ *
+ * @returns Mask with bit @c i set if @a ctrl[i] is @a c.
+ */
+inline
+static uint32_t ib_hash_group_match(
+    const uint8_t *ctrl,
+    uint8_t        c
+);
+
+/**
+ * Find the empty and deleted slots of a group.
+ *
+ * @param[in] ctrl First control byte of the group.
+ *
+ * @returns Mask with bit @c i set if slot @c i is empty or deleted.
+ */
+inline
+static uint32_t ib_hash_group_match_free(
+    const uint8_t *ctrl
+);
+
+/**
+ * Allocate the slots of an open addressing hash.
+ *
+ * Sets @c ctrl, @c entries, @c max_slot and @c growth_left of @a hash.
+ * All slots are empty.
+ *
+ * @param[in,out] hash     Hash table.
+ * @param[in]     capacity Number of slots; a power of 2 and a multiple of
+ *                         IB_HASH_GROUP_WIDTH.
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure.
+ */
+static ib_status_t ib_hash_open_alloc(
+    ib_hash_t *hash,
+    size_t     capacity
+);
+
+/**
+ * Search for an entry in an open addressing hash.
+ *
+ * @param[in] hash       Hash table.
+ * @param[in] key        Key to search for.
+ * @param[in] key_length Length of @a key.
+ * @param[in] hash_value Hash value of @a key.
+ *
+ * @returns Hash entry if found and NULL otherwise.
+ */
+static ib_hash_entry_t *ib_hash_open_find(
+    const ib_hash_t *hash,
+    const void      *key,
+    size_t           key_length,
+    uint32_t         hash_value
+);
+
+/**
+ * Find the first empty or deleted slot in the probe sequence for
+ * @a hash_value.
+ *
+ * @param[in] hash       Hash table.
+ * @param[in] hash_value Hash value.
+ *
+ * @returns Index of slot.
+ */
+static size_t ib_hash_open_find_free(
+    const ib_hash_t *hash,
+    uint32_t         hash_value
+);
+
+/**
+ * Rebuild an open addressing hash, dropping deleted slots and growing it
+ * if it is more than half full.
+ *
+ * @param[in,out] hash Hash table.
+ *
+ * @returns
+ * - IB_OK on success.
+ * - IB_EALLOC on allocation failure.
+ */
+static ib_status_t ib_hash_open_rehash(
+    ib_hash_t *hash
+);
+
+/**
+ * Set value of @a key in an open addressing hash.
+ *
+ * @sa ib_hash_set_ex()
+ */
+static ib_status_t ib_hash_open_set(
+    ib_hash_t  *hash,
+    const void *key,
+    size_t      key_length,
+    void       *value
+);
+
+/**
+ * Downcase the ASCII letters of 8 bytes at once.
+ *
+ * Agrees with ib_hash_tolower(), which leaves non-ASCII bytes alone.
+ *
+ * @param[in] w Bytes to downcase.
+ * @return Downcased @a w.
+ */
+inline
+static uint64_t ib_hash_tolower_word(
+    uint64_t w
+);
+
+/**
+ * Mix 8 bytes of key into the state of ib_hashfunc_fast().
+ *
+ * @param[in] state State.
+ * @param[in] w     Key bytes.
+ * @return New state.
+ */
+inline
+static uint64_t ib_hash_fast_mix(
+    uint64_t state,
+    uint64_t w
+);
+
+/**
+ * Final avalanche of the state of ib_hashfunc_fast().
+ *
+ * @param[in] state State.
+ * @return Hash value.
+ */
+inline
+static uint32_t ib_hash_fast_final(
+    uint64_t state
+);
+
 /* End Internal Declarations */
 
 /* Internal Definitions */
@@ -276,15 +458,20 @@ ib_status_t ib_hash_find_entry(
 
     hash_value = hash->hash_function(key, key_length, hash->randomizer);
 
-    /* hash->max_slot+1 is a power of 2 */
-    current_slot = hash->slots[hash_value & hash->max_slot];
-    current_entry = ib_hash_find_htentry(
-        hash,
-        current_slot,
-        key,
-        key_length,
-        hash_value
-    );
+    if (hash->layout == IB_HASH_LAYOUT_OPEN) {
+        current_entry = ib_hash_open_find(hash, key, key_length, hash_value);
+    }
+    else {
+        /* hash->max_slot+1 is a power of 2 */
+        current_slot = hash->slots[hash_value & hash->max_slot];
+        current_entry = ib_hash_find_htentry(
+            hash,
+            current_slot,
+            key,
+            key_length,
+            hash_value
+        );
+    }
     if (current_entry == NULL) {
         *hash_entry = NULL;
         return IB_ENOENT;
@@ -315,6 +502,20 @@ void ib_hash_next(
 ) {
     assert(iterator != NULL);
 
+    if (iterator->hash->layout == IB_HASH_LAYOUT_OPEN) {
+        const ib_hash_t *hash = iterator->hash;
+
+        iterator->current_entry = NULL;
+        while (iterator->slot_index <= hash->max_slot) {
+            size_t i = iterator->slot_index++;
+            if ((hash->ctrl[i] & 0x80) == 0) {
+                iterator->current_entry = &(hash->entries[i]);
+                return;
+            }
+        }
+        return;
+    }
+
     iterator->current_entry = iterator->next_entry;
     while (! iterator->current_entry) {
         if (iterator->slot_index > iterator->hash->max_slot) {
@@ -402,6 +603,318 @@ static char ib_hash_tolower(
     return s_table[(unsigned int)c];
 }
 
+#ifdef __SSE2__
+
+inline
+static uint32_t ib_hash_group_match(
+    const uint8_t *ctrl,
+    uint8_t        c
+)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(group, _mm_set1_epi8((char)c))
+    );
+}
+
+inline
+static uint32_t ib_hash_group_match_free(
+    const uint8_t *ctrl
+)
+{
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_loadu_si128((const __m128i *)ctrl)
+    );
+}
+
+#else
+
+inline
+static uint32_t ib_hash_group_match(
+    const uint8_t *ctrl,
+    uint8_t        c
+)
+{
+    uint32_t mask = 0;
+
+    for (int i = 0; i < IB_HASH_GROUP_WIDTH; ++i) {
+        mask |= (uint32_t)(ctrl[i] == c) << i;
+    }
+
+    return mask;
+}
+
+inline
+static uint32_t ib_hash_group_match_free(
+    const uint8_t *ctrl
+)
+{
+    uint32_t mask = 0;
+
+    for (int i = 0; i < IB_HASH_GROUP_WIDTH; ++i) {
+        mask |= (uint32_t)(ctrl[i] >> 7) << i;
+    }
+
+    return mask;
+}
+
+#endif
+
+ib_status_t ib_hash_open_alloc(
+    ib_hash_t *hash,
+    size_t     capacity
+)
+{
+    assert(hash != NULL);
+    assert(capacity % IB_HASH_GROUP_WIDTH == 0);
+
+    uint8_t         *ctrl;
+    ib_hash_entry_t *entries;
+
+    ctrl = (uint8_t *)ib_mpool_alloc(hash->pool, capacity);
+    if (ctrl == NULL) {
+        return IB_EALLOC;
+    }
+    entries = (ib_hash_entry_t *)ib_mpool_alloc(
+        hash->pool,
+        capacity * sizeof(*entries)
+    );
+    if (entries == NULL) {
+        return IB_EALLOC;
+    }
+    memset(ctrl, IB_HASH_CTRL_EMPTY, capacity);
+
+    hash->ctrl        = ctrl;
+    hash->entries     = entries;
+    hash->max_slot    = capacity - 1;
+    /* Keep the load at most 7/8 so that every probe finds an empty slot. */
+    hash->growth_left = capacity - capacity / 8;
+
+    return IB_OK;
+}
+
+ib_hash_entry_t *ib_hash_open_find(
+    const ib_hash_t *hash,
+    const void      *key,
+    size_t           key_length,
+    uint32_t         hash_value
+)
+{
+    assert(hash != NULL);
+    assert(key  != NULL);
+
+    size_t  group_mask = hash->max_slot / IB_HASH_GROUP_WIDTH;
+    size_t  group      = (hash_value >> 7) & group_mask;
+    uint8_t h2         = hash_value & 0x7f;
+
+    /* Triangular probing visits every group as the count is a power of 2. */
+    for (size_t step = 1; ; ++step) {
+        const uint8_t *ctrl = hash->ctrl + group * IB_HASH_GROUP_WIDTH;
+        uint32_t       mask = ib_hash_group_match(ctrl, h2);
+
+        while (mask != 0) {
+            ib_hash_entry_t *entry = &(hash->entries[
+                group * IB_HASH_GROUP_WIDTH + __builtin_ctz(mask)
+            ]);
+            if (
+                entry->hash_value == hash_value &&
+                hash->equal_predicate(
+                    key,        key_length,
+                    entry->key, entry->key_length
+                )
+            ) {
+                return entry;
+            }
+            mask &= mask - 1;
+        }
+
+        if (ib_hash_group_match(ctrl, IB_HASH_CTRL_EMPTY) != 0) {
+            return NULL;
+        }
+
+        group = (group + step) & group_mask;
+    }
+}
+
+size_t ib_hash_open_find_free(
+    const ib_hash_t *hash,
+    uint32_t         hash_value
+)
+{
+    assert(hash != NULL);
+
+    size_t group_mask = hash->max_slot / IB_HASH_GROUP_WIDTH;
+    size_t group      = (hash_value >> 7) & group_mask;
+
+    for (size_t step = 1; ; ++step) {
+        uint32_t mask = ib_hash_group_match_free(
+            hash->ctrl + group * IB_HASH_GROUP_WIDTH
+        );
+
+        if (mask != 0) {
+            return group * IB_HASH_GROUP_WIDTH + __builtin_ctz(mask);
+        }
+
+        group = (group + step) & group_mask;
+    }
+}
+
+ib_status_t ib_hash_open_rehash(
+    ib_hash_t *hash
+)
+{
+    assert(hash != NULL);
+
+    ib_status_t      rc;
+    uint8_t         *old_ctrl     = hash->ctrl;
+    ib_hash_entry_t *old_entries  = hash->entries;
+    size_t           old_capacity = hash->max_slot + 1;
+    size_t           capacity     = old_capacity;
+
+    /* Only grow if not mostly deleted slots. */
+    if (hash->size >= old_capacity / 2) {
+        capacity *= 2;
+    }
+
+    /* On failure, ib_hash_open_alloc() leaves hash unchanged. */
+    rc = ib_hash_open_alloc(hash, capacity);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if ((old_ctrl[i] & 0x80) == 0) {
+            size_t j = ib_hash_open_find_free(
+                hash,
+                old_entries[i].hash_value
+            );
+            hash->ctrl[j]    = old_ctrl[i];
+            hash->entries[j] = old_entries[i];
+        }
+    }
+    hash->growth_left -= hash->size;
+
+    return IB_OK;
+}
+
+ib_status_t ib_hash_open_set(
+    ib_hash_t  *hash,
+    const void *key,
+    size_t      key_length,
+    void       *value
+)
+{
+    assert(hash != NULL);
+    assert(key  != NULL);
+
+    uint32_t         hash_value;
+    ib_hash_entry_t *entry;
+    size_t           i;
+
+    hash_value = hash->hash_function(key, key_length, hash->randomizer);
+    entry = ib_hash_open_find(hash, key, key_length, hash_value);
+
+    if (entry != NULL) {
+        if (value != NULL) {
+            entry->value = value;
+            return IB_OK;
+        }
+
+        /* Delete.  If the group has an empty slot, no probe continues past
+         * it, so the slot can be made empty rather than deleted. */
+        i = entry - hash->entries;
+        if (
+            ib_hash_group_match(
+                hash->ctrl + (i & ~(size_t)(IB_HASH_GROUP_WIDTH - 1)),
+                IB_HASH_CTRL_EMPTY
+            ) != 0
+        ) {
+            hash->ctrl[i] = IB_HASH_CTRL_EMPTY;
+            ++hash->growth_left;
+        }
+        else {
+            hash->ctrl[i] = IB_HASH_CTRL_DELETED;
+        }
+        entry->value = NULL;
+        --hash->size;
+
+        return IB_OK;
+    }
+
+    /* Not found and value == NULL: no changes are needed. */
+    if (value == NULL) {
+        return IB_OK;
+    }
+
+    i = ib_hash_open_find_free(hash, hash_value);
+    if (hash->growth_left == 0 && hash->ctrl[i] == IB_HASH_CTRL_EMPTY) {
+        ib_status_t rc = ib_hash_open_rehash(hash);
+        if (rc != IB_OK) {
+            return rc;
+        }
+        i = ib_hash_open_find_free(hash, hash_value);
+    }
+    if (hash->ctrl[i] == IB_HASH_CTRL_EMPTY) {
+        --hash->growth_left;
+    }
+
+    hash->ctrl[i] = hash_value & 0x7f;
+    entry = &(hash->entries[i]);
+    entry->hash_value = hash_value;
+    entry->key        = key;
+    entry->key_length = key_length;
+    entry->value      = value;
+    entry->next_entry = NULL;
+    ++hash->size;
+
+    return IB_OK;
+}
+
+inline
+static uint64_t ib_hash_tolower_word(
+    uint64_t w
+)
+{
+    static const uint64_t ones  = UINT64_C(0x0101010101010101);
+    static const uint64_t highs = UINT64_C(0x8080808080808080);
+
+    /* Per byte, without carries: high bit set if >= 'A' and if > 'Z'. */
+    uint64_t low7  = w & ~highs;
+    uint64_t ge_a  = low7 + ones * (0x80 - 'A');
+    uint64_t gt_z  = low7 + ones * (0x80 - 'Z' - 1);
+    uint64_t upper = ge_a & ~gt_z & ~w & highs;
+
+    /* 0x80 >> 2 == 'a' - 'A' */
+    return w | (upper >> 2);
+}
+
+inline
+static uint64_t ib_hash_fast_mix(
+    uint64_t state,
+    uint64_t w
+)
+{
+    state ^= w;
+    state *= UINT64_C(0x9e3779b97f4a7c15);
+
+    return state ^ (state >> 29);
+}
+
+inline
+static uint32_t ib_hash_fast_final(
+    uint64_t state
+)
+{
+    state ^= state >> 33;
+    state *= UINT64_C(0xff51afd7ed558ccd);
+    state ^= state >> 33;
+    state *= UINT64_C(0xc4ceb9fe1a85ec53);
+    state ^= state >> 33;
+
+    return (uint32_t)state;
+}
+
 /* End Internal Definitions */
 
 uint32_t ib_hashfunc_djb2(
@@ -438,6 +951,56 @@ uint32_t ib_hashfunc_djb2_nocase(
     return hash;
 }
 
+uint32_t ib_hashfunc_fast(
+    const void *key,
+    size_t      key_length,
+    uint32_t    randomizer
+) {
+    assert(key != NULL);
+
+    const uint8_t *key_s = (const uint8_t *)key;
+    uint64_t       state = randomizer;
+    uint64_t       w;
+
+    state = ib_hash_fast_mix(state, key_length);
+    for (; key_length >= 8; key_length -= 8, key_s += 8) {
+        memcpy(&w, key_s, 8);
+        state = ib_hash_fast_mix(state, w);
+    }
+    if (key_length > 0) {
+        w = 0;
+        memcpy(&w, key_s, key_length);
+        state = ib_hash_fast_mix(state, w);
+    }
+
+    return ib_hash_fast_final(state);
+}
+
+uint32_t ib_hashfunc_fast_nocase(
+    const void *key,
+    size_t      key_length,
+    uint32_t    randomizer
+) {
+    assert(key != NULL);
+
+    const uint8_t *key_s = (const uint8_t *)key;
+    uint64_t       state = randomizer;
+    uint64_t       w;
+
+    state = ib_hash_fast_mix(state, key_length);
+    for (; key_length >= 8; key_length -= 8, key_s += 8) {
+        memcpy(&w, key_s, 8);
+        state = ib_hash_fast_mix(state, ib_hash_tolower_word(w));
+    }
+    if (key_length > 0) {
+        w = 0;
+        memcpy(&w, key_s, key_length);
+        state = ib_hash_fast_mix(state, ib_hash_tolower_word(w));
+    }
+
+    return ib_hash_fast_final(state);
+}
+
 int ib_hashequal_default(
     const void *a,
     size_t      a_length,
@@ -461,12 +1024,28 @@ int ib_hashequal_nocase(
 
     const unsigned char *a_s = (const unsigned char *)a;
     const unsigned char *b_s = (const unsigned char *)b;
+    size_t               i   = 0;
 
     if (a_length != b_length) {
         return 0;
     }
 
-    for (size_t i = 0; i < a_length; ++i) {
+    /* Compare 8 bytes at a time, downcasing only if they differ. */
+    for (; i + 8 <= a_length; i += 8) {
+        uint64_t a_w;
+        uint64_t b_w;
+
+        memcpy(&a_w, a_s + i, 8);
+        memcpy(&b_w, b_s + i, 8);
+        if (
+            a_w != b_w &&
+            ib_hash_tolower_word(a_w) != ib_hash_tolower_word(b_w)
+        ) {
+            return 0;
+        }
+    }
+
+    for (; i < a_length; ++i) {
         if (ib_hash_tolower(a_s[i]) != ib_hash_tolower(b_s[i])) {
             return 0;
         }
@@ -475,9 +1054,10 @@ int ib_hashequal_nocase(
     return 1;
 }
 
-ib_status_t ib_hash_create_ex(
+ib_status_t ib_hash_create_layout(
     ib_hash_t          **hash,
     ib_mpool_t          *pool,
+    ib_hash_layout_t     layout,
     size_t               size,
     ib_hash_function_t   hash_function,
     ib_hash_equal_t      equal_predicate
@@ -487,6 +1067,7 @@ ib_status_t ib_hash_create_ex(
     assert(size > 0);
 
     ib_hash_t *new_hash = NULL;
+    ib_status_t rc;
 
     if (hash == NULL) {
         return IB_EINVAL;
@@ -514,30 +1095,67 @@ ib_status_t ib_hash_create_ex(
         return IB_EALLOC;
     }
 
-    ib_hash_entry_t **slots = (ib_hash_entry_t **)ib_mpool_calloc(
-        pool,
-        size + 1,
-        sizeof(*slots)
-    );
-    if (slots == NULL) {
-        *hash = NULL;
-        return IB_EALLOC;
-    }
-
     new_hash->hash_function   = hash_function;
     new_hash->equal_predicate = equal_predicate;
-    new_hash->max_slot        = size-1;
-    new_hash->slots           = slots;
+    new_hash->layout          = layout;
+    new_hash->slots           = NULL;
+    new_hash->ctrl            = NULL;
+    new_hash->entries         = NULL;
+    new_hash->growth_left     = 0;
     new_hash->pool            = pool;
     new_hash->free            = NULL;
     new_hash->size            = 0;
     new_hash->randomizer      = (uint32_t)clock();
 
+    if (layout == IB_HASH_LAYOUT_OPEN) {
+        rc = ib_hash_open_alloc(
+            new_hash,
+            size < IB_HASH_GROUP_WIDTH ? IB_HASH_GROUP_WIDTH : size
+        );
+        if (rc != IB_OK) {
+            *hash = NULL;
+            return rc;
+        }
+    }
+    else {
+        ib_hash_entry_t **slots = (ib_hash_entry_t **)ib_mpool_calloc(
+            pool,
+            size + 1,
+            sizeof(*slots)
+        );
+        if (slots == NULL) {
+            *hash = NULL;
+            return IB_EALLOC;
+        }
+        new_hash->max_slot = size-1;
+        new_hash->slots    = slots;
+    }
+
     *hash = new_hash;
 
     return IB_OK;
 }
 
+ib_status_t ib_hash_create_ex(
+    ib_hash_t          **hash,
+    ib_mpool_t          *pool,
+    size_t               size,
+    ib_hash_function_t   hash_function,
+    ib_hash_equal_t      equal_predicate
+) {
+    assert(hash != NULL);
+    assert(pool != NULL);
+
+    return ib_hash_create_layout(
+        hash,
+        pool,
+        IB_HASH_LAYOUT_CHAINED,
+        size,
+        hash_function,
+        equal_predicate
+    );
+}
+
 ib_status_t ib_hash_create(
     ib_hash_t  **hash,
     ib_mpool_t  *pool
@@ -570,6 +1188,40 @@ ib_status_t ib_hash_create_nocase(
     );
 }
 
+ib_status_t ib_hash_create_open(
+    ib_hash_t  **hash,
+    ib_mpool_t  *pool
+) {
+    assert(hash != NULL);
+    assert(pool != NULL);
+
+    return ib_hash_create_layout(
+        hash,
+        pool,
+        IB_HASH_LAYOUT_OPEN,
+        IB_HASH_INITIAL_SIZE,
+        ib_hashfunc_fast,
+        ib_hashequal_default
+    );
+}
+
+ib_status_t ib_hash_create_open_nocase(
+    ib_hash_t  **hash,
+    ib_mpool_t  *pool
+) {
+    assert(hash != NULL);
+    assert(pool != NULL);
+
+    return ib_hash_create_layout(
+        hash,
+        pool,
+        IB_HASH_LAYOUT_OPEN,
+        IB_HASH_INITIAL_SIZE,
+        ib_hashfunc_fast_nocase,
+        ib_hashequal_nocase
+    );
+}
+
 ib_mpool_t *ib_hash_pool(
     const ib_hash_t *hash
 ) {
@@ -679,6 +1331,10 @@ ib_status_t ib_hash_set_ex(
     /* Points to pointer that points to current_entry */
     ib_hash_entry_t **current_entry_handle  = NULL;
 
+    if (hash->layout == IB_HASH_LAYOUT_OPEN) {
+        return ib_hash_open_set(hash, key, key_length, value);
+    }
+
     hash_value = hash->hash_function(key, key_length, hash->randomizer);
     slot_index = (hash_value & hash->max_slot);
 
@@ -780,6 +1436,15 @@ ib_status_t ib_hash_set(
 void ib_hash_clear(ib_hash_t *hash) {
     assert(hash != NULL);
 
+    if (hash->layout == IB_HASH_LAYOUT_OPEN) {
+        size_t capacity = hash->max_slot + 1;
+
+        memset(hash->ctrl, IB_HASH_CTRL_EMPTY, capacity);
+        hash->growth_left = capacity - capacity / 8;
+        hash->size        = 0;
+        return;
+    }
+
     for (size_t i = 0; i <= hash->max_slot; ++i) {
         if (hash->slots[i] != NULL) {
             ib_hash_entry_t *current_entry;
@@ -35,7 +35,12 @@
 #include <valgrind/memcheck.h>
 #endif
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 #include <assert.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -142,6 +147,50 @@ static char s_zero_length_buffer[1];
  **/
 #define IB_MPOOL_TRACK_ZERO_SIZE 5
 
+/**
+ * Maximum number of bytes of pages kept in a thread's page cache.
+ *
+ * Pages of destroyed and released pools are handed to a cache belonging to
+ * the calling thread, and taken from it by pools that need a page before
+ * going to malloc.  Only pages of pools using malloc() and free() are
+ * cached.  Pages beyond this limit are freed.  Setting this to zero disables
+ * the page cache.
+ *
+ * @sa ib_mpool_cache_stats()
+ **/
+#define IB_MPOOL_CACHE_MAX_BYTES (1024 * 1024)
+
+/**
+ * Number of different page sizes a thread's page cache holds.
+ *
+ * Pools with different roles may use different page sizes; each page size
+ * in the cache uses one bin.  Pages of other sizes are freed.
+ *
+ * @sa IB_MPOOL_CACHE_MAX_BYTES
+ **/
+#define IB_MPOOL_CACHE_NUM_BINS 4
+
+/**
+ * Maximum number of pool structures kept in a thread's pool cache.
+ *
+ * Destroyed pools using malloc() and free() are kept for reuse by
+ * ib_mpool_create_ex().  Setting this to zero disables the pool cache.
+ *
+ * @sa IB_MPOOL_CACHE_MAX_BYTES
+ **/
+#define IB_MPOOL_CACHE_MAX_POOLS 64
+
+/**
+ * Size of a huge page in bytes.
+ *
+ * Pages of pools with huge page backing are aligned to this size and, if
+ * the system supports it, advised to be backed by transparent huge pages.
+ * Only page sizes that are a multiple of this benefit.
+ *
+ * @sa ib_mpool_policy_t
+ **/
+#define IB_MPOOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
 /**@}*/
 
 /* Basic Sanity Check -- Otherwise track number calculation fails. */
@@ -149,6 +198,29 @@ static char s_zero_length_buffer[1];
     #error "IB_MPOOL_NUM_TRACKS - IB_MPOOL_TRACK_ZERO_SIZE > 32"
 #endif
 
+/**
+ * The medium track.
+ *
+ * Allocations too large for the last track but no larger than the large
+ * allocation threshold of the pool are taken from pages on this track.  It
+ * behaves as any other track, except that its limit is the threshold.  It
+ * is always empty for pools whose threshold is the default.
+ *
+ * @sa ib_mpool_policy_t
+ **/
+#define IB_MPOOL_MEDIUM_TRACK IB_MPOOL_NUM_TRACKS
+
+/**
+ * The number of tracks including the medium track.
+ **/
+#define IB_MPOOL_ALL_TRACKS (IB_MPOOL_NUM_TRACKS + 1)
+
+/* Huge page backing needs aligned allocation and madvise(). */
+#if defined(HAVE_POSIX_MEMALIGN) && defined(HAVE_MADVISE) && \
+    defined(MADV_HUGEPAGE)
+#define IB_MPOOL_HAVE_HUGE_PAGES
+#endif
+
 /* Structures */
 
 /** See struct ib_mpool_page_t */
@@ -333,6 +405,31 @@ struct ib_mpool_t
      **/
     ib_mpool_free_fn_t free_fn;
 
+    /**
+     * Allocations larger than this are large allocations.
+     *
+     * At least the limit of the last track and at most what fits in a page.
+     * Allocations between the two are taken from the medium track.  Set by
+     * ib_mpool_create_policy() or inherited from the parent.
+     **/
+    size_t large_threshold;
+
+    /**
+     * Back pages with huge pages?
+     *
+     * Set by ib_mpool_create_policy() or inherited from the parent.  Only
+     * honored for pools using malloc() and free().
+     **/
+    bool huge_pages;
+
+    /**
+     * The role of the pool, or NULL.
+     *
+     * Pools with the same role are aggregated by ib_mpool_analyze().  Set by
+     * ib_mpool_create_policy() or inherited from the parent.  Not copied.
+     **/
+    const char *role;
+
     /**
      * Number of bytes allocated.
      *
@@ -389,11 +486,11 @@ struct ib_mpool_t
      *
      * @sa ib_mpool_t
      **/
-    ib_mpool_page_t         *tracks[IB_MPOOL_NUM_TRACKS];
+    ib_mpool_page_t         *tracks[IB_MPOOL_ALL_TRACKS];
     /**
      * End of tracks.
      **/
-    ib_mpool_page_t        *tracks_end[IB_MPOOL_NUM_TRACKS];
+    ib_mpool_page_t        *tracks_end[IB_MPOOL_ALL_TRACKS];
     /**
      * Singly linked list of pointers page for large allocations.
      *
@@ -494,12 +591,33 @@ struct ib_mpool_t
 #define IB_MPOOL_TRACK_SIZE(track_num) \
     (1 << (IB_MPOOL_TRACK_ZERO_SIZE + (track_num)))
 
+/**
+ * The maximum size of an allocation for a page of track @a track_num of
+ * @a mp, including the medium track.
+ *
+ * @param[in] mp        Memory pool.
+ * @param[in] track_num Track number.
+ * @return Maximum size of allocation for track @a track_num.
+ */
+static
+size_t ib_mpool_track_size(const ib_mpool_t *mp, size_t track_num)
+{
+    assert(mp != NULL);
+    assert(track_num < IB_MPOOL_ALL_TRACKS);
+
+    if (track_num == IB_MPOOL_MEDIUM_TRACK) {
+        return mp->large_threshold;
+    }
+
+    return IB_MPOOL_TRACK_SIZE(track_num);
+}
+
 /**
  * Calculate the track number for an allocation of size @a size.
  *
  * @param[in] size Size of allocation in bytes.
- * @returns Track number to allocate from or IB_MPOOL_NUM_TRACKS if a large
- *          allocation.
+ * @returns Track number to allocate from or IB_MPOOL_NUM_TRACKS, i.e.,
+ *          IB_MPOOL_MEDIUM_TRACK, if too large for the last track.
  **/
 static
 size_t ib_mpool_track_number(size_t size)
@@ -588,16 +706,468 @@ void ib_mpool_remove_child_from_parent(const ib_mpool_t *child)
 
 /**@}*/
 
+/**
+ * @name Thread cache.
+ *
+ * Each thread has a cache of free pages and pool structures.  Pools hand
+ * their pages to the cache of the thread that destroys or releases them and
+ * take pages from the cache of the thread that allocates from them.  As a
+ * cache is only ever used by its own thread, no locking is needed.
+ */
+/**@{*/
+
+/**
+ * Free pages of one page size in a thread's cache.
+ **/
+typedef struct ib_mpool_cache_bin_t
+{
+    /** Page size of pages in this bin; meaningless if @c pages is NULL. */
+    size_t           pagesize;
+    /** Singly linked list of free pages. */
+    ib_mpool_page_t *pages;
+} ib_mpool_cache_bin_t;
+
+/**
+ * A thread's cache of free pages and pools.
+ **/
+typedef struct ib_mpool_thread_cache_t
+{
+    /** Free pages by page size. */
+    ib_mpool_cache_bin_t    bins[IB_MPOOL_CACHE_NUM_BINS];
+    /** Bytes of pages in @c bins. */
+    size_t                  bytes;
+    /** Singly linked list of free pools. */
+    ib_mpool_t             *pools;
+    /** Counters, including the current number of pages and pools. */
+    ib_mpool_cache_stats_t  stats;
+    /** Previous cache in s_thread_caches. */
+    struct ib_mpool_thread_cache_t *prev;
+    /** Next cache in s_thread_caches. */
+    struct ib_mpool_thread_cache_t *next;
+} ib_mpool_thread_cache_t;
+
+/** Key of the thread's cache. */
+static pthread_key_t   s_thread_cache_key;
+
+/**
+ * State of s_thread_cache_key: 0 if not created, 1 if created, -1 if
+ * creation failed.  Read without s_thread_cache_key_lock, and so only
+ * with __atomic_load_n().
+ */
+static int             s_thread_cache_key_state = 0;
+
+/**
+ * Caches of all threads, so that ib_mpool_cache_shutdown() can free those
+ * of threads that are still alive.
+ */
+static ib_mpool_thread_cache_t *s_thread_caches = NULL;
+
+/** Protects s_thread_cache_key and s_thread_caches. */
+static pthread_mutex_t s_thread_cache_key_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Free the pages and pools of a thread's cache.
+ *
+ * Called at thread exit and by ib_mpool_cache_flush().
+ *
+ * @param[in] cache Cache to empty.
+ **/
+static
+void ib_mpool_thread_cache_empty(ib_mpool_thread_cache_t *cache)
+{
+    assert(cache != NULL);
+
+    for (size_t bin_num = 0; bin_num < IB_MPOOL_CACHE_NUM_BINS; ++bin_num) {
+        IB_MPOOL_FOREACH(ib_mpool_page_t, mpage, cache->bins[bin_num].pages) {
+            free(mpage);
+        }
+        cache->bins[bin_num].pages = NULL;
+    }
+    IB_MPOOL_FOREACH(ib_mpool_t, pool, cache->pools) {
+        free(pool);
+    }
+    cache->bytes       = 0;
+    cache->pools       = NULL;
+    cache->stats.pages = 0;
+    cache->stats.pools = 0;
+
+    return;
+}
+
+/**
+ * Remove a thread's cache from s_thread_caches, empty and free it.
+ *
+ * Call with s_thread_cache_key_lock held.
+ *
+ * @param[in] cache Cache to free.
+ **/
+static
+void ib_mpool_thread_cache_release(ib_mpool_thread_cache_t *cache)
+{
+    assert(cache != NULL);
+
+    if (cache->prev != NULL) {
+        cache->prev->next = cache->next;
+    }
+    else {
+        s_thread_caches = cache->next;
+    }
+    if (cache->next != NULL) {
+        cache->next->prev = cache->prev;
+    }
+
+    ib_mpool_thread_cache_empty(cache);
+    free(cache);
+
+    return;
+}
+
+/**
+ * Free a thread's cache at thread exit.
+ *
+ * @param[in] data The thread's cache (ib_mpool_thread_cache_t).
+ **/
+static
+void ib_mpool_thread_cache_free(void *data)
+{
+    ib_mpool_thread_cache_t *cache = (ib_mpool_thread_cache_t *)data;
+
+    if (cache != NULL) {
+        pthread_mutex_lock(&s_thread_cache_key_lock);
+        ib_mpool_thread_cache_release(cache);
+        pthread_mutex_unlock(&s_thread_cache_key_lock);
+    }
+
+    return;
+}
+
+/**
+ * Create the thread cache key, if not already created.
+ *
+ * The key is created on first use, and again on the first use after
+ * ib_mpool_cache_shutdown() deleted it.
+ *
+ * @return true iff the key exists.
+ **/
+static
+bool ib_mpool_thread_cache_key_create(void)
+{
+    int state = __atomic_load_n(&s_thread_cache_key_state, __ATOMIC_ACQUIRE);
+
+    if (state == 0) {
+        pthread_mutex_lock(&s_thread_cache_key_lock);
+        state = s_thread_cache_key_state;
+        if (state == 0) {
+            state = (
+                pthread_key_create(
+                    &s_thread_cache_key, ib_mpool_thread_cache_free
+                ) == 0
+            ) ? 1 : -1;
+            __atomic_store_n(&s_thread_cache_key_state, state,
+                             __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&s_thread_cache_key_lock);
+    }
+
+    return state == 1;
+}
+
+/**
+ * Get the calling thread's cache.
+ *
+ * @param[in] create Create the cache if the thread does not have one?
+ * @return The thread's cache or NULL if it has none or on allocation error.
+ **/
+static
+ib_mpool_thread_cache_t *ib_mpool_thread_cache(bool create)
+{
+    ib_mpool_thread_cache_t *cache;
+
+    if (! ib_mpool_thread_cache_key_create()) {
+        return NULL;
+    }
+
+    cache = (ib_mpool_thread_cache_t *)pthread_getspecific(s_thread_cache_key);
+    if (cache == NULL && create) {
+        cache = (ib_mpool_thread_cache_t *)calloc(1, sizeof(*cache));
+        if (cache == NULL) {
+            return NULL;
+        }
+        if (pthread_setspecific(s_thread_cache_key, cache) != 0) {
+            free(cache);
+            return NULL;
+        }
+
+        pthread_mutex_lock(&s_thread_cache_key_lock);
+        cache->next = s_thread_caches;
+        if (s_thread_caches != NULL) {
+            s_thread_caches->prev = cache;
+        }
+        s_thread_caches = cache;
+        pthread_mutex_unlock(&s_thread_cache_key_lock);
+    }
+
+    return cache;
+}
+
+/**
+ * Can the pages of @a mp be cached?
+ *
+ * @param[in] mp Memory pool.
+ * @return true iff @a mp uses malloc() and free() and not huge pages.
+ **/
+static
+bool ib_mpool_pages_cacheable(const ib_mpool_t *mp)
+{
+    assert(mp != NULL);
+
+    return
+        IB_MPOOL_CACHE_MAX_BYTES > 0 &&
+        ! mp->huge_pages             &&
+        mp->malloc_fn == &malloc     &&
+        mp->free_fn   == &free;
+}
+
+/**
+ * Find the bin of the calling thread's cache for pages of @a pagesize.
+ *
+ * @param[in] cache    Thread cache.
+ * @param[in] pagesize Page size.
+ * @param[in] claim    Claim an empty bin if no bin has @a pagesize?
+ * @return Bin or NULL if none.
+ **/
+static
+ib_mpool_cache_bin_t *ib_mpool_thread_cache_bin(
+    ib_mpool_thread_cache_t *cache,
+    size_t                   pagesize,
+    bool                     claim
+)
+{
+    assert(cache != NULL);
+
+    ib_mpool_cache_bin_t *empty = NULL;
+
+    for (size_t bin_num = 0; bin_num < IB_MPOOL_CACHE_NUM_BINS; ++bin_num) {
+        ib_mpool_cache_bin_t *bin = &(cache->bins[bin_num]);
+        if (bin->pages == NULL) {
+            if (empty == NULL) {
+                empty = bin;
+            }
+        }
+        else if (bin->pagesize == pagesize) {
+            return bin;
+        }
+    }
+
+    if (claim && empty != NULL) {
+        empty->pagesize = pagesize;
+        return empty;
+    }
+
+    return NULL;
+}
+
+/**
+ * Can a pool with the given functions be cached?
+ *
+ * @param[in] malloc_fn Malloc function of pool.
+ * @param[in] free_fn   Free function of pool.
+ * @return true iff @a malloc_fn is malloc() and @a free_fn is free().
+ **/
+static
+bool ib_mpool_pool_cacheable(
+    ib_mpool_malloc_fn_t malloc_fn,
+    ib_mpool_free_fn_t   free_fn
+)
+{
+    return
+        IB_MPOOL_CACHE_MAX_POOLS > 0 &&
+        malloc_fn == &malloc         &&
+        free_fn   == &free;
+}
+
+/**
+ * Take a page of @a pagesize from the calling thread's cache.
+ *
+ * @param[in] pagesize Page size.
+ * @return Uninitialized page or NULL if the cache has none.
+ **/
+static
+ib_mpool_page_t *ib_mpool_thread_cache_take_page(size_t pagesize)
+{
+    ib_mpool_thread_cache_t *cache = ib_mpool_thread_cache(true);
+    ib_mpool_cache_bin_t    *bin;
+    ib_mpool_page_t         *mpage;
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    bin = ib_mpool_thread_cache_bin(cache, pagesize, false);
+    if (bin == NULL) {
+        ++cache->stats.page_misses;
+        return NULL;
+    }
+
+    mpage = bin->pages;
+    bin->pages = mpage->next;
+    cache->bytes -= pagesize;
+    --cache->stats.pages;
+    ++cache->stats.page_hits;
+
+    return mpage;
+}
+
+/**
+ * Give a list of pages of @a pagesize to the calling thread's cache.
+ *
+ * Pages that do not fit in the cache are freed.
+ *
+ * @param[in] pages    Singly linked list of pages.
+ * @param[in] pagesize Page size of @a pages.
+ **/
+static
+void ib_mpool_thread_cache_give_pages(
+    ib_mpool_page_t *pages,
+    size_t           pagesize
+)
+{
+    ib_mpool_thread_cache_t *cache;
+    ib_mpool_cache_bin_t    *bin = NULL;
+
+    if (pages == NULL) {
+        return;
+    }
+
+    cache = ib_mpool_thread_cache(true);
+    if (cache != NULL) {
+        bin = ib_mpool_thread_cache_bin(cache, pagesize, true);
+    }
+    IB_MPOOL_FOREACH(ib_mpool_page_t, mpage, pages) {
+        if (
+            bin == NULL ||
+            cache->bytes + pagesize > IB_MPOOL_CACHE_MAX_BYTES
+        ) {
+            free(mpage);
+        }
+        else {
+            mpage->next = bin->pages;
+            bin->pages = mpage;
+            cache->bytes += pagesize;
+            ++cache->stats.pages;
+        }
+    }
+
+    if (cache != NULL && cache->stats.pages > cache->stats.pages_high_water) {
+        cache->stats.pages_high_water = cache->stats.pages;
+    }
+
+    return;
+}
+
+/**
+ * Take a pool from the calling thread's cache.
+ *
+ * @return Uninitialized pool or NULL if the cache is empty.
+ **/
+static
+ib_mpool_t *ib_mpool_thread_cache_take_pool(void)
+{
+    ib_mpool_thread_cache_t *cache = ib_mpool_thread_cache(true);
+    ib_mpool_t              *mp;
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    if (cache->pools == NULL) {
+        ++cache->stats.pool_misses;
+        return NULL;
+    }
+
+    mp = cache->pools;
+    cache->pools = mp->next;
+    --cache->stats.pools;
+    ++cache->stats.pool_hits;
+
+    return mp;
+}
+
+/**
+ * Give a pool to the calling thread's cache.
+ *
+ * The pool is freed if it does not fit in the cache.
+ *
+ * @param[in] mp Pool to give.  All of its memory must already be freed.
+ **/
+static
+void ib_mpool_thread_cache_give_pool(ib_mpool_t *mp)
+{
+    assert(mp != NULL);
+
+    ib_mpool_thread_cache_t *cache = ib_mpool_thread_cache(true);
+
+    if (cache == NULL || cache->stats.pools >= IB_MPOOL_CACHE_MAX_POOLS) {
+        free(mp);
+        return;
+    }
+
+    mp->next = cache->pools;
+    cache->pools = mp;
+    ++cache->stats.pools;
+    if (cache->stats.pools > cache->stats.pools_high_water) {
+        cache->stats.pools_high_water = cache->stats.pools;
+    }
+
+    return;
+}
+
+/**@}*/
+
 /**
  * @name Helper functions for managing internal memory.
  */
 /**@{*/
 
+/**
+ * Allocate a new page.
+ *
+ * Pages of pools with huge page backing are aligned to
+ * IB_MPOOL_HUGE_PAGE_SIZE and advised to use transparent huge pages.
+ *
+ * @param[in] mp Memory pool to allocate page for.
+ * @return Uninitialized page or NULL on allocation error.
+ **/
+static
+ib_mpool_page_t *ib_mpool_allocate_page(
+    const ib_mpool_t *mp
+)
+{
+    assert(mp != NULL);
+
+    const size_t size = sizeof(ib_mpool_page_t) + mp->pagesize - 1;
+
+#ifdef IB_MPOOL_HAVE_HUGE_PAGES
+    if (mp->huge_pages) {
+        void *mem = NULL;
+
+        if (posix_memalign(&mem, IB_MPOOL_HUGE_PAGE_SIZE, size) != 0) {
+            return NULL;
+        }
+        /* Advice only; on failure the page is backed by normal pages. */
+        madvise(mem, size, MADV_HUGEPAGE);
+
+        return (ib_mpool_page_t *)mem;
+    }
+#endif
+
+    return (ib_mpool_page_t *)mp->malloc_fn(size);
+}
+
 /**
  * Acquire a new page.
  *
- * Pops a page from the free list if available or allocates a new page if
- * not.  The page returned should be considered uninitialized.
+ * Pops a page from the free list if available, then from the thread cache,
+ * and allocates a new page if neither has one.  The page returned should be
+ * considered uninitialized.
  *
  * @param[in] mp Memory pool to acquire page for.
  * @return Uninitialized page or NULL on allocation error.
@@ -616,7 +1186,12 @@ ib_mpool_page_t *ib_mpool_acquire_page(
         mp->free_pages = mp->free_pages->next;
     }
     else {
-        mpage = mp->malloc_fn(sizeof(ib_mpool_page_t) + mp->pagesize - 1);
+        if (ib_mpool_pages_cacheable(mp)) {
+            mpage = ib_mpool_thread_cache_take_page(mp->pagesize);
+        }
+        if (mpage == NULL) {
+            mpage = ib_mpool_allocate_page(mp);
+        }
     }
 
 #ifdef IB_MPOOL_VALGRIND
@@ -984,8 +1559,8 @@ bool ib_mpool_debug_report_helper(
     IMR_PRINTF("  free_children          = %p\n",  mp->free_children);
 
     IMR_PRINTF("%s", "Tracks:\n");
-    for (size_t track_num = 0; track_num < IB_MPOOL_NUM_TRACKS; ++track_num) {
-        size_t track_size = IB_MPOOL_TRACK_SIZE(track_num);
+    for (size_t track_num = 0; track_num < IB_MPOOL_ALL_TRACKS; ++track_num) {
+        size_t track_size = ib_mpool_track_size(mp, track_num);
         IMR_PRINTF("  %2zd (<= %5zd):\n", track_num, track_size);
         IB_MPOOL_FOREACH(
             const ib_mpool_page_t, mpage,
@@ -1196,8 +1771,8 @@ bool ib_mpool_analyze_helper(
     free(path);
 
     IMR_PRINTF("%s", "Tracks:\n");
-    for (size_t track_num = 0; track_num < IB_MPOOL_NUM_TRACKS; ++track_num) {
-        size_t track_size = IB_MPOOL_TRACK_SIZE(track_num);
+    for (size_t track_num = 0; track_num < IB_MPOOL_ALL_TRACKS; ++track_num) {
+        size_t track_size = ib_mpool_track_size(mp, track_num);
         size_t track_cost = 0;
         size_t track_use  = 0;
         IB_MPOOL_FOREACH(
@@ -1339,8 +1914,220 @@ failure:
     return false;
 }
 
+/** Maximum number of roles reported by ib_mpool_analyze(). */
+#define IB_MPOOL_ANALYZE_MAX_ROLES 16
+
+/**
+ * Usage of all pools with one role.
+ *
+ * @sa ib_mpool_analyze_roles()
+ **/
+typedef struct ib_mpool_role_usage_t
+{
+    /** Role or NULL for pools without one. */
+    const char *role;
+    /** Number of pools, including free children. */
+    size_t pools;
+    /** Memory returned to client. */
+    size_t use;
+    /** Memory allocated, including mpool overhead. */
+    size_t cost;
+    /** Memory allocated and waiting for reuse. */
+    size_t free;
+} ib_mpool_role_usage_t;
+
+/**
+ * Add usage of @a mp and its descendants to @a roles.
+ *
+ * Pools whose role does not fit in @a roles are not counted.
+ *
+ * @param[in]     mp        Memory pool.
+ * @param[in,out] roles     Usage by role; IB_MPOOL_ANALYZE_MAX_ROLES long.
+ * @param[in,out] num_roles Number of entries of @a roles in use.
+ **/
+static
+void ib_mpool_analyze_roles(
+    const ib_mpool_t      *mp,
+    ib_mpool_role_usage_t *roles,
+    size_t                *num_roles
+)
+{
+    assert(mp        != NULL);
+    assert(roles     != NULL);
+    assert(num_roles != NULL);
+
+    const size_t unit_page_cost =
+        mp->pagesize + sizeof(ib_mpool_page_t) - 1;
+    ib_mpool_role_usage_t *usage = NULL;
+
+    for (size_t i = 0; i < *num_roles; ++i) {
+        if (
+            roles[i].role == mp->role ||
+            (roles[i].role != NULL && mp->role != NULL &&
+             strcmp(roles[i].role, mp->role) == 0)
+        ) {
+            usage = &(roles[i]);
+            break;
+        }
+    }
+    if (usage == NULL && *num_roles < IB_MPOOL_ANALYZE_MAX_ROLES) {
+        usage = &(roles[*num_roles]);
+        ++*num_roles;
+        memset(usage, 0, sizeof(*usage));
+        usage->role = mp->role;
+    }
+
+    if (usage != NULL) {
+        ++usage->pools;
+        for (
+            size_t track_num = 0;
+            track_num < IB_MPOOL_ALL_TRACKS;
+            ++track_num
+        ) {
+            IB_MPOOL_FOREACH(
+                const ib_mpool_page_t, mpage,
+                mp->tracks[track_num]
+            ) {
+                usage->cost += unit_page_cost;
+                usage->use  += mpage->used;
+            }
+        }
+        IB_MPOOL_FOREACH(
+            const ib_mpool_pointer_page_t, ppage,
+            mp->large_allocations
+        ) {
+            usage->cost += sizeof(ib_mpool_pointer_page_t);
+            usage->use  += ppage->next_pointer * sizeof(void *);
+        }
+        IB_MPOOL_FOREACH(const ib_mpool_cleanup_t, cleanup, mp->cleanups) {
+            usage->cost += sizeof(ib_mpool_cleanup_t);
+            usage->use  += sizeof(ib_mpool_cleanup_t);
+        }
+        usage->cost += mp->large_allocation_inuse;
+        usage->use  += mp->large_allocation_inuse;
+
+        IB_MPOOL_FOREACH(const ib_mpool_page_t, mpage, mp->free_pages) {
+            usage->free += unit_page_cost;
+        }
+        IB_MPOOL_FOREACH(
+            const ib_mpool_pointer_page_t, ppage,
+            mp->free_pointer_pages
+        ) {
+            usage->free += sizeof(ib_mpool_pointer_page_t);
+        }
+        IB_MPOOL_FOREACH(
+            const ib_mpool_cleanup_t, cleanup,
+            mp->free_cleanups
+        ) {
+            usage->free += sizeof(ib_mpool_cleanup_t);
+        }
+    }
+
+    IB_MPOOL_FOREACH(const ib_mpool_t, free_child, mp->free_children) {
+        ib_mpool_analyze_roles(free_child, roles, num_roles);
+    }
+    IB_MPOOL_FOREACH(const ib_mpool_t, child, mp->children) {
+        ib_mpool_analyze_roles(child, roles, num_roles);
+    }
+
+    return;
+}
+
+/**
+ * Add per role usage of @a mp and its descendants to @a report.
+ *
+ * Fragmentation is the share of the cost that is not in use, i.e., the
+ * unused tails of pages and pointer pages.
+ *
+ * @sa ib_mpool_analyze()
+ *
+ * @param[in] mp     Memory pool to report on.
+ * @param[in] report Report to append to.
+ * @return true iff success.
+ */
+static
+bool ib_mpool_analyze_roles_report(
+    const ib_mpool_t  *mp,
+    ib_mpool_report_t *report
+)
+{
+    assert(mp     != NULL);
+    assert(report != NULL);
+
+    ib_mpool_role_usage_t roles[IB_MPOOL_ANALYZE_MAX_ROLES];
+    size_t                num_roles = 0;
+
+    ib_mpool_analyze_roles(mp, roles, &num_roles);
+
+    IMR_PRINTF("%s", "Roles:\n");
+    for (size_t i = 0; i < num_roles; ++i) {
+        const ib_mpool_role_usage_t *usage = &(roles[i]);
+        IMR_PRINTF(
+            "  %-12s pools=%6zd use=%12zd cost=%12zd waste=%12zd "
+            "free=%12zd fragmentation=%4.1f%%\n",
+            (usage->role != NULL ? usage->role : "(none)"),
+            usage->pools, usage->use, usage->cost,
+            usage->cost - usage->use, usage->free,
+            (usage->cost == 0 ?
+                0.0 : 100*(double)(usage->cost - usage->use) / usage->cost)
+        );
+    }
+
+    return true;
+
+failure:
+    return false;
+}
+
 #undef IMR_PRINTF
 
+/**
+ * Set the large allocation threshold, huge page backing, and role of @a mp.
+ *
+ * The threshold is limited to what fits in a page and huge pages are only
+ * used if the pool uses malloc() and free() and its pages are at least
+ * IB_MPOOL_HUGE_PAGE_SIZE.  Must be called before @a mp allocates.
+ *
+ * @param[in] mp              Memory pool.
+ * @param[in] large_threshold Large allocation threshold or 0 for default.
+ * @param[in] huge_pages      Back pages with huge pages?
+ * @param[in] role            Role or NULL.
+ **/
+static
+void ib_mpool_set_policy(
+    ib_mpool_t *mp,
+    size_t      large_threshold,
+    bool        huge_pages,
+    const char *role
+)
+{
+    assert(mp != NULL);
+
+    const size_t min_threshold = IB_MPOOL_TRACK_SIZE(IB_MPOOL_NUM_TRACKS - 1);
+    const size_t max_threshold = mp->pagesize - 2*IB_MPOOL_REDZONE_SIZE;
+
+    if (large_threshold > max_threshold) {
+        large_threshold = max_threshold;
+    }
+    if (large_threshold < min_threshold) {
+        large_threshold = min_threshold;
+    }
+    mp->large_threshold = large_threshold;
+
+    mp->huge_pages =
+        huge_pages                              &&
+        mp->pagesize  >= IB_MPOOL_HUGE_PAGE_SIZE &&
+        mp->malloc_fn == &malloc                 &&
+        mp->free_fn   == &free;
+#ifndef IB_MPOOL_HAVE_HUGE_PAGES
+    mp->huge_pages = false;
+#endif
+
+    mp->role = role;
+
+    return;
+}
+
 /* End Internal */
 
 /**
@@ -1440,9 +2227,14 @@ ib_status_t ib_mpool_create_ex(
         assert(mp->large_allocation_inuse == 0);
     }
     else {
-        mp = (ib_mpool_t *)malloc_fn(sizeof(**pmp));
+        if (ib_mpool_pool_cacheable(malloc_fn, free_fn)) {
+            mp = ib_mpool_thread_cache_take_pool();
+        }
         if (mp == NULL) {
-            return IB_EALLOC;
+            mp = (ib_mpool_t *)malloc_fn(sizeof(**pmp));
+            if (mp == NULL) {
+                return IB_EALLOC;
+            }
         }
         memset(mp, 0, sizeof(**pmp));
     }
@@ -1460,6 +2252,15 @@ ib_status_t ib_mpool_create_ex(
     mp->large_allocation_inuse = 0;
     mp->parent                 = parent;
 
+    if (parent != NULL) {
+        ib_mpool_set_policy(
+            mp, parent->large_threshold, parent->huge_pages, parent->role
+        );
+    }
+    else {
+        ib_mpool_set_policy(mp, 0, false, NULL);
+    }
+
     rc = ib_mpool_setname(mp, name);
     if (rc != IB_OK) {
         return rc;
@@ -1496,6 +2297,34 @@ failure:
     return rc;
 }
 
+ib_status_t ib_mpool_create_policy(
+    ib_mpool_t               **pmp,
+    const char                *name,
+    ib_mpool_t                *parent,
+    const ib_mpool_policy_t   *policy
+)
+{
+    ib_status_t rc;
+
+    if (pmp == NULL || policy == NULL) {
+        return IB_EINVAL;
+    }
+
+    rc = ib_mpool_create_ex(pmp, name, parent, policy->pagesize, NULL, NULL);
+    if (rc != IB_OK) {
+        return rc;
+    }
+
+    ib_mpool_set_policy(
+        *pmp,
+        policy->large_threshold,
+        policy->huge_pages,
+        (policy->role != NULL ? policy->role : (*pmp)->role)
+    );
+
+    return IB_OK;
+}
+
 ib_status_t ib_mpool_setname(
     ib_mpool_t *mp,
     const char *name
@@ -1564,8 +2393,12 @@ void *ib_mpool_alloc(
     size_t actual_size = size;
 
     size_t track_number = ib_mpool_track_number(actual_size);
-    if (track_number < IB_MPOOL_NUM_TRACKS) {
-        /* Small allocation */
+    /* Anything too large for the last track is for the medium track, as
+     * long as it is within the large allocation threshold.
+     */
+    if (track_number < IB_MPOOL_NUM_TRACKS || size <= mp->large_threshold) {
+        assert(track_number <= IB_MPOOL_MEDIUM_TRACK);
+        /* Small or medium allocation */
         /* Need to make sure we leave red zone at end. */
         actual_size += IB_MPOOL_REDZONE_SIZE;
         if (mp->tracks[track_number] == NULL ||
@@ -1653,7 +2486,7 @@ void ib_mpool_clear(
     ib_mpool_free_large_allocations(mp);
     ib_mpool_setname(mp, NULL);
 
-    for (size_t track_num = 0; track_num < IB_MPOOL_NUM_TRACKS; ++track_num) {
+    for (size_t track_num = 0; track_num < IB_MPOOL_ALL_TRACKS; ++track_num) {
         if (mp->tracks[track_num] != NULL) {
             assert(mp->tracks_end[track_num] != NULL);
 #ifdef IB_MPOOL_VALGRIND
@@ -1708,10 +2541,18 @@ void ib_mpool_destroy(
     ib_mpool_t *mp
 )
 {
+    bool cache_pages = ib_mpool_pages_cacheable(mp);
+
     ib_mpool_call_cleanups(mp);
     ib_mpool_free_large_allocations(mp);
 
-    for (size_t track_num = 0; track_num < IB_MPOOL_NUM_TRACKS; ++track_num) {
+    for (size_t track_num = 0; track_num < IB_MPOOL_ALL_TRACKS; ++track_num) {
+        if (cache_pages) {
+            ib_mpool_thread_cache_give_pages(
+                mp->tracks[track_num], mp->pagesize
+            );
+            continue;
+        }
         IB_MPOOL_FOREACH(ib_mpool_page_t, mpage, mp->tracks[track_num]) {
             mp->free_fn(mpage);
         }
@@ -1725,8 +2566,13 @@ void ib_mpool_destroy(
         mp->free_fn(cleanup);
     }
 
-    IB_MPOOL_FOREACH(ib_mpool_page_t, mpage, mp->free_pages) {
-        mp->free_fn(mpage);
+    if (cache_pages) {
+        ib_mpool_thread_cache_give_pages(mp->free_pages, mp->pagesize);
+    }
+    else {
+        IB_MPOOL_FOREACH(ib_mpool_page_t, mpage, mp->free_pages) {
+            mp->free_fn(mpage);
+        }
     }
 
     IB_MPOOL_FOREACH(ib_mpool_pointer_page_t, ppage, mp->free_pointer_pages) {
@@ -1763,7 +2609,12 @@ void ib_mpool_destroy(
         mp->free_fn(mp->name);
     }
 
-    mp->free_fn(mp);
+    if (ib_mpool_pool_cacheable(mp->malloc_fn, mp->free_fn)) {
+        ib_mpool_thread_cache_give_pool(mp);
+    }
+    else {
+        mp->free_fn(mp);
+    }
 
 #ifdef IB_MPOOL_VALGRIND
     /* Check existence so we don't double destroy free children's pools. */
@@ -1796,6 +2647,12 @@ void ib_mpool_release(
         ib_mpool_release(child);
     }
 
+    /* Hand pages to the thread cache rather than idling on a free child. */
+    if (ib_mpool_pages_cacheable(mp)) {
+        ib_mpool_thread_cache_give_pages(mp->free_pages, mp->pagesize);
+        mp->free_pages = NULL;
+    }
+
     ib_lock_lock(&(mp->parent->lock));
 
     /* Remove from parent child list. */
@@ -1920,10 +2777,10 @@ ib_status_t ib_mpool_validate(
     /* Validate use of each page */
     for (
         size_t track_num = 0;
-        track_num < IB_MPOOL_NUM_TRACKS;
+        track_num < IB_MPOOL_ALL_TRACKS;
         ++track_num
     ) {
-        size_t track_size = IB_MPOOL_TRACK_SIZE(track_num);
+        size_t track_size = ib_mpool_track_size(mp, track_num);
         IB_MPOOL_FOREACH(ib_mpool_page_t, mpage, mp->tracks[track_num]) {
             /* If the page is not the first in the track then its remaining
              * memory must be less than the appropriate size: i.e., too small
@@ -2004,7 +2861,7 @@ ib_status_t ib_mpool_validate(
         size_t inuse = mp->large_allocation_inuse;
         for (
             size_t track_num = 0;
-            track_num < IB_MPOOL_NUM_TRACKS;
+            track_num < IB_MPOOL_ALL_TRACKS;
             ++track_num
         ) {
             IB_MPOOL_FOREACH(ib_mpool_page_t, mpage, mp->tracks[track_num]) {
@@ -2047,7 +2904,7 @@ ib_status_t ib_mpool_validate(
     VALIDATE_END(ib_mpool_t, mp->children, mp->children_end, "children");
     for (
         size_t track_num = 0;
-        track_num < IB_MPOOL_NUM_TRACKS;
+        track_num < IB_MPOOL_ALL_TRACKS;
         ++track_num
     ) {
         VALIDATE_END(
@@ -2102,7 +2959,7 @@ ib_status_t ib_mpool_validate(
         }
         for (
             size_t track_num = 0;
-            track_num < IB_MPOOL_NUM_TRACKS;
+            track_num < IB_MPOOL_ALL_TRACKS;
             ++track_num
         ) {
             if (free_child->tracks[track_num] != NULL) {
@@ -2188,6 +3045,9 @@ char *ib_mpool_analyze(
     ib_mpool_report_init(&report);
 
     bool result = ib_mpool_analyze_helper(mp, &report);
+    if (result) {
+        result = ib_mpool_analyze_roles_report(mp, &report);
+    }
 
     if (result) {
         report_text = ib_mpool_report_convert(&report);
@@ -2224,6 +3084,52 @@ char *ib_mpool_debug_report(
  * do not directly touch mp.
  */
 
+void ib_mpool_cache_stats(
+    ib_mpool_cache_stats_t *stats
+)
+{
+    assert(stats != NULL);
+
+    const ib_mpool_thread_cache_t *cache = ib_mpool_thread_cache(false);
+
+    if (cache == NULL) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    else {
+        *stats = cache->stats;
+    }
+
+    return;
+}
+
+void ib_mpool_cache_flush(void)
+{
+    ib_mpool_thread_cache_t *cache = ib_mpool_thread_cache(false);
+
+    if (cache != NULL) {
+        ib_mpool_thread_cache_empty(cache);
+    }
+
+    return;
+}
+
+void ib_mpool_cache_shutdown(void)
+{
+    pthread_mutex_lock(&s_thread_cache_key_lock);
+    if (s_thread_cache_key_state == 1) {
+        /* Deleting the key runs no destructors, so free every thread's
+         * cache here. */
+        pthread_key_delete(s_thread_cache_key);
+        while (s_thread_caches != NULL) {
+            ib_mpool_thread_cache_release(s_thread_caches);
+        }
+    }
+    __atomic_store_n(&s_thread_cache_key_state, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&s_thread_cache_key_lock);
+
+    return;
+}
+
 void *ib_mpool_calloc(
     ib_mpool_t *mp,
     size_t      nelem,
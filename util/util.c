@@ -25,6 +25,7 @@
 
 #include <ironbee/util.h>
 
+#include <ironbee/mpool.h>
 #include <ironbee/uuid.h>
 
 #ifdef HAVE_LIBCURL
@@ -263,6 +264,7 @@ ib_status_t ib_util_initialize(void)
 void ib_util_shutdown(void)
 {
     ib_uuid_shutdown();
+    ib_mpool_cache_shutdown();
 
 #ifdef HAVE_LIBCURL
     curl_global_cleanup();
@@ -26,12 +26,18 @@
 
 #include <ironbee/uuid.h>
 
+#include <ironbee/clock.h>
 #include <ironbee/lock.h>
 
 #include <uuid.h>
 
 #include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 /*
  * These are initialized by ib_uuid_init();
@@ -42,6 +48,259 @@
 static ib_lock_t  g_uuid_lock;
 uuid_t           *g_ossp_uuid;
 
+/**
+ * Per-thread UUID generator.
+ *
+ * Used by ib_uuid_create_v4_fast() and ib_uuid_create_sortable() so that
+ * threads never share state or take a lock to make a UUID.
+ */
+typedef struct ib_uuid_thread_gen_t ib_uuid_thread_gen_t;
+struct ib_uuid_thread_gen_t {
+    uint64_t  s[2];       /**< xorshift128+ state */
+    uint32_t  tag;        /**< Random tag for sortable UUIDs */
+    uint64_t  counter;    /**< Next count for sortable UUIDs; random start */
+    unsigned  generation; /**< Value of s_uuid_fork_generation at seeding */
+    ib_uuid_thread_gen_t *prev; /**< Previous generator in s_uuid_gens */
+    ib_uuid_thread_gen_t *next; /**< Next generator in s_uuid_gens */
+};
+
+/** Key of the thread's generator. */
+static pthread_key_t   s_uuid_gen_key;
+
+/**
+ * State of s_uuid_gen_key: 0 if not created, 1 if created, -1 if creation
+ * failed.  Read without s_uuid_gen_key_lock, and so only with
+ * __atomic_load_n().
+ */
+static int             s_uuid_gen_key_state = 0;
+
+/**
+ * Generators of all threads, so that ib_uuid_shutdown() can free those of
+ * threads that are still alive.
+ */
+static ib_uuid_thread_gen_t *s_uuid_gens = NULL;
+
+/** Protects s_uuid_gen_key and s_uuid_gens. */
+static pthread_mutex_t s_uuid_gen_key_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Was ib_uuid_atfork_child() registered? */
+static bool            s_uuid_atfork_registered = false;
+
+/**
+ * Incremented in the child after fork().
+ *
+ * A generator seeded before the fork would otherwise make the same UUIDs
+ * in parent and child.
+ */
+static volatile unsigned s_uuid_fork_generation = 0;
+
+/** Invalidate the generators of the child after fork(). */
+static void ib_uuid_atfork_child(void)
+{
+    ++s_uuid_fork_generation;
+}
+
+/**
+ * Remove a thread's generator from s_uuid_gens and free it.
+ *
+ * Call with s_uuid_gen_key_lock held.
+ *
+ * @param[in] gen Generator to free.
+ */
+static void ib_uuid_thread_gen_release(ib_uuid_thread_gen_t *gen)
+{
+    assert(gen != NULL);
+
+    if (gen->prev != NULL) {
+        gen->prev->next = gen->next;
+    }
+    else {
+        s_uuid_gens = gen->next;
+    }
+    if (gen->next != NULL) {
+        gen->next->prev = gen->prev;
+    }
+
+    free(gen);
+}
+
+/**
+ * Free a thread's generator at thread exit.
+ *
+ * @param[in] data The thread's generator (ib_uuid_thread_gen_t).
+ */
+static void ib_uuid_thread_gen_free(void *data)
+{
+    ib_uuid_thread_gen_t *gen = (ib_uuid_thread_gen_t *)data;
+
+    if (gen != NULL) {
+        pthread_mutex_lock(&s_uuid_gen_key_lock);
+        ib_uuid_thread_gen_release(gen);
+        pthread_mutex_unlock(&s_uuid_gen_key_lock);
+    }
+}
+
+/**
+ * Create s_uuid_gen_key, if not already created.
+ *
+ * The key is created on first use, and again on the first use after
+ * ib_uuid_shutdown() deleted it.
+ *
+ * @returns true iff the key exists.
+ */
+static bool ib_uuid_gen_key_create(void)
+{
+    int state = __atomic_load_n(&s_uuid_gen_key_state, __ATOMIC_ACQUIRE);
+
+    if (state == 0) {
+        pthread_mutex_lock(&s_uuid_gen_key_lock);
+        state = s_uuid_gen_key_state;
+        if (state == 0) {
+            state = (
+                pthread_key_create(&s_uuid_gen_key, ib_uuid_thread_gen_free)
+                == 0
+            ) ? 1 : -1;
+            if ( (state == 1) && ! s_uuid_atfork_registered ) {
+                pthread_atfork(NULL, NULL, ib_uuid_atfork_child);
+                s_uuid_atfork_registered = true;
+            }
+            __atomic_store_n(&s_uuid_gen_key_state, state, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&s_uuid_gen_key_lock);
+    }
+
+    return state == 1;
+}
+
+/**
+ * SplitMix64; used to expand seed material.
+ *
+ * @param[in,out] x State.
+ * @returns Next value.
+ */
+static uint64_t ib_uuid_splitmix64(uint64_t *x)
+{
+    uint64_t z = (*x += UINT64_C(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
+/**
+ * Next value of a thread's xorshift128+ generator.
+ *
+ * @param[in,out] gen Generator.
+ * @returns Next value.
+ */
+static uint64_t ib_uuid_thread_gen_next(ib_uuid_thread_gen_t *gen)
+{
+    uint64_t s1 = gen->s[0];
+    const uint64_t s0 = gen->s[1];
+
+    gen->s[0] = s0;
+    s1 ^= s1 << 23;
+    gen->s[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+
+    return gen->s[1] + s0;
+}
+
+/**
+ * Seed @a gen from the system's random source.
+ *
+ * If /dev/urandom can not be read, the time and the addresses of the
+ * generator and the thread are used instead.
+ *
+ * @param[out] gen Generator to seed.
+ */
+static void ib_uuid_thread_gen_seed(ib_uuid_thread_gen_t *gen)
+{
+    uint64_t seed[3] = { 0, 0, 0 };
+    uint64_t x;
+    bool     seeded = false;
+    int      fd;
+
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd >= 0) {
+        seeded = (read(fd, seed, sizeof(seed)) == (ssize_t)sizeof(seed));
+        close(fd);
+    }
+
+    x = seed[0] ^ seed[1] ^ seed[2];
+    if (! seeded) {
+        x ^= (uint64_t)ib_clock_get_time();
+        x ^= (uint64_t)(uintptr_t)gen << 16;
+        x ^= (uint64_t)getpid() << 32;
+        x ^= (uint64_t)(uintptr_t)pthread_self();
+    }
+
+    gen->s[0] = seed[0] ^ ib_uuid_splitmix64(&x);
+    gen->s[1] = seed[1] ^ ib_uuid_splitmix64(&x);
+    if ( (gen->s[0] | gen->s[1]) == 0) {
+        gen->s[1] = 1;
+    }
+    gen->tag = (uint32_t)(seed[2] ^ ib_uuid_splitmix64(&x));
+    /* A random start keeps two generators that drew the same tag from
+     * making the same UUIDs in the same millisecond. */
+    gen->counter = ib_uuid_thread_gen_next(gen);
+    gen->generation = s_uuid_fork_generation;
+}
+
+/**
+ * Get the calling thread's generator, creating it if needed.
+ *
+ * @returns The generator or NULL on error.
+ */
+static ib_uuid_thread_gen_t *ib_uuid_thread_gen(void)
+{
+    ib_uuid_thread_gen_t *gen;
+
+    if (! ib_uuid_gen_key_create()) {
+        return NULL;
+    }
+
+    gen = (ib_uuid_thread_gen_t *)pthread_getspecific(s_uuid_gen_key);
+    if (gen == NULL) {
+        gen = (ib_uuid_thread_gen_t *)calloc(1, sizeof(*gen));
+        if (gen == NULL) {
+            return NULL;
+        }
+        if (pthread_setspecific(s_uuid_gen_key, gen) != 0) {
+            free(gen);
+            return NULL;
+        }
+        ib_uuid_thread_gen_seed(gen);
+
+        pthread_mutex_lock(&s_uuid_gen_key_lock);
+        gen->next = s_uuid_gens;
+        if (s_uuid_gens != NULL) {
+            s_uuid_gens->prev = gen;
+        }
+        s_uuid_gens = gen;
+        pthread_mutex_unlock(&s_uuid_gen_key_lock);
+    }
+    else if (gen->generation != s_uuid_fork_generation) {
+        ib_uuid_thread_gen_seed(gen);
+    }
+
+    return gen;
+}
+
+/**
+ * Store @a v in @a n bytes of @a p, most significant byte first.
+ *
+ * @param[out] p Where to store.
+ * @param[in] v Value.
+ * @param[in] n Number of bytes.
+ */
+static void ib_uuid_store_be(uint8_t *p, uint64_t v, size_t n)
+{
+    while (n > 0) {
+        --n;
+        p[n] = (uint8_t)v;
+        v >>= 8;
+    }
+}
+
 ib_status_t ib_uuid_initialize(void)
 {
     ib_status_t rc;
@@ -62,6 +321,18 @@ ib_status_t ib_uuid_shutdown(void)
     rc = ib_lock_destroy(&g_uuid_lock);
     uuid_destroy(g_ossp_uuid);
 
+    /* Deleting the key runs no destructors, so free every thread's
+     * generator here. */
+    pthread_mutex_lock(&s_uuid_gen_key_lock);
+    if (s_uuid_gen_key_state == 1) {
+        pthread_key_delete(s_uuid_gen_key);
+        while (s_uuid_gens != NULL) {
+            ib_uuid_thread_gen_release(s_uuid_gens);
+        }
+    }
+    __atomic_store_n(&s_uuid_gen_key_state, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&s_uuid_gen_key_lock);
+
     return rc;
 }
 
@@ -125,45 +396,24 @@ ib_status_t ib_uuid_bin_to_ascii(
     const ib_uuid_t *uuid
 )
 {
-    uuid_rc_t uuid_rc;
-    size_t uuid_len = UUID_LEN_STR+1;
-    ib_status_t rc = IB_OK;
+    static const char hex[] = "0123456789abcdef";
+    size_t i;
 
     if (uuid == NULL || str == NULL) {
         return IB_EINVAL;
     }
 
-    rc = ib_lock_lock(&g_uuid_lock);
-    if (rc != IB_OK) {
-        return rc;
-    }
-
-    uuid_rc = uuid_import(g_ossp_uuid, UUID_FMT_BIN, uuid, UUID_LEN_BIN);
-    if (uuid_rc == UUID_RC_MEM) {
-        rc = IB_EALLOC;
-        goto finish;
-    }
-    else if (uuid_rc != UUID_RC_OK) {
-        rc = IB_EINVAL;
-        goto finish;
-    }
-
-    uuid_rc = uuid_export(g_ossp_uuid, UUID_FMT_STR, (void *)&str, &uuid_len);
-    if (uuid_rc == UUID_RC_MEM) {
-        rc = IB_EALLOC;
-        goto finish;
-    }
-    else if (uuid_rc != UUID_RC_OK || uuid_len != UUID_LEN_STR+1) {
-        rc = IB_EOTHER;
-        goto finish;
-    }
-
-finish:
-    if (ib_lock_unlock(&g_uuid_lock) != IB_OK) {
-        return IB_EOTHER;
+    /* Formatted here rather than by OSSP UUID to avoid g_uuid_lock. */
+    for (i = 0; i < UUID_LEN_BIN; ++i) {
+        if (i == 4 || i == 6 || i == 8 || i == 10) {
+            *str++ = '-';
+        }
+        *str++ = hex[uuid->byte[i] >> 4];
+        *str++ = hex[uuid->byte[i] & 0x0f];
     }
+    *str = '\0';
 
-    return rc;
+    return IB_OK;
 }
 
 ib_status_t ib_uuid_create_v4(ib_uuid_t *uuid)
@@ -206,3 +456,57 @@ finish:
 
     return rc;
 }
+
+ib_status_t ib_uuid_create_v4_fast(ib_uuid_t *uuid)
+{
+    ib_uuid_thread_gen_t *gen;
+
+    if (uuid == NULL) {
+        return IB_EINVAL;
+    }
+
+    gen = ib_uuid_thread_gen();
+    if (gen == NULL) {
+        return IB_EALLOC;
+    }
+
+    ib_uuid_store_be(&uuid->byte[0], ib_uuid_thread_gen_next(gen), 8);
+    ib_uuid_store_be(&uuid->byte[8], ib_uuid_thread_gen_next(gen), 8);
+
+    /* Version 4, variant 10. */
+    uuid->byte[6] = (uuid->byte[6] & 0x0f) | 0x40;
+    uuid->byte[8] = (uuid->byte[8] & 0x3f) | 0x80;
+
+    return IB_OK;
+}
+
+ib_status_t ib_uuid_create_sortable(ib_uuid_t *uuid)
+{
+    ib_uuid_thread_gen_t *gen;
+    ib_timeval_t tv;
+    uint64_t msec;
+    uint64_t count;
+
+    if (uuid == NULL) {
+        return IB_EINVAL;
+    }
+
+    gen = ib_uuid_thread_gen();
+    if (gen == NULL) {
+        return IB_EALLOC;
+    }
+
+    ib_clock_gettimeofday(&tv);
+    msec = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    count = gen->counter++;
+
+    /* 48 bit time, version 7, 12 bits of count, variant 10, 30 bit tag,
+     * 32 bits of count. */
+    ib_uuid_store_be(&uuid->byte[0], msec, 6);
+    ib_uuid_store_be(&uuid->byte[6], 0x7000 | ((count >> 32) & 0x0fff), 2);
+    ib_uuid_store_be(&uuid->byte[8],
+                     UINT32_C(0x80000000) | (gen->tag & 0x3fffffff), 4);
+    ib_uuid_store_be(&uuid->byte[12], count, 4);
+
+    return IB_OK;
+}